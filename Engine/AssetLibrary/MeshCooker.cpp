@@ -0,0 +1,320 @@
+#include "MeshCooker.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+
+namespace inl {
+namespace asset {
+
+
+namespace {
+
+// Cooked model container: header, submesh table, then vertices and indices of each submesh, then the instances.
+constexpr char CONTAINER_MAGIC[4] = { 'I', 'M', 'S', 'H' };
+constexpr uint32_t CONTAINER_VERSION = 3;
+constexpr size_t DATA_ALIGNMENT = 16;
+
+struct ContainerHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t submeshCount;
+	uint32_t instanceCount;
+	uint32_t reserved;
+	uint64_t instanceOffset;
+	uint64_t sourceStamp;
+};
+
+struct ContainerSubmesh {
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+};
+
+
+size_t AlignUp(size_t offset) {
+	return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+}
+
+template <class T>
+uint64_t Append(std::vector<uint8_t>& output, const std::vector<T>& data) {
+	size_t offset = AlignUp(output.size());
+	output.resize(offset + data.size() * sizeof(T));
+	if (!data.empty()) {
+		memcpy(output.data() + offset, data.data(), data.size() * sizeof(T));
+	}
+	return offset;
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+// MeshCooker
+//------------------------------------------------------------------------------
+
+std::vector<uint8_t> MeshCooker::Cook(std::vector<Submesh> submeshes, const std::vector<CookedInstance>& instances, uint64_t sourceStamp) {
+	for (const auto& instance : instances) {
+		if (instance.submeshID >= submeshes.size()) {
+			throw std::invalid_argument("Instance refers to a submesh that does not exist.");
+		}
+	}
+	for (auto& submesh : submeshes) {
+		if (submesh.indices.size() % 3 != 0) {
+			throw std::invalid_argument("Index count not divisible by 3. Must be triangles.");
+		}
+		for (uint32_t index : submesh.indices) {
+			if (index >= submesh.vertices.size()) {
+				throw std::invalid_argument("Indices over-index the vertices.");
+			}
+		}
+		OptimizeVertexCache(submesh.indices, submesh.vertices.size());
+		OptimizeVertexFetch(submesh.vertices, submesh.indices);
+	}
+
+	std::vector<uint8_t> result(sizeof(ContainerHeader) + submeshes.size() * sizeof(ContainerSubmesh));
+	ContainerHeader header;
+	memcpy(header.magic, CONTAINER_MAGIC, sizeof(header.magic));
+	header.version = CONTAINER_VERSION;
+	header.vertexStride = sizeof(CookedVertex);
+	header.submeshCount = (uint32_t)submeshes.size();
+	header.instanceCount = (uint32_t)instances.size();
+	header.reserved = 0;
+	header.sourceStamp = sourceStamp;
+
+	for (size_t i = 0; i < submeshes.size(); ++i) {
+		ContainerSubmesh entry;
+		entry.vertexCount = (uint32_t)submeshes[i].vertices.size();
+		entry.indexCount = (uint32_t)submeshes[i].indices.size();
+		entry.vertexOffset = Append(result, submeshes[i].vertices);
+		entry.indexOffset = Append(result, submeshes[i].indices);
+		memcpy(result.data() + sizeof(ContainerHeader) + i * sizeof(ContainerSubmesh), &entry, sizeof(entry));
+	}
+
+	header.instanceOffset = Append(result, instances);
+	memcpy(result.data(), &header, sizeof(header));
+
+	return result;
+}
+
+
+// Tipsify: fans around a vertex, then continues with a vertex that is likely still in the cache.
+// Sander, Nehab, Barczak: Fast Triangle Reordering for Vertex Locality and Reduced Overdraw, 2007.
+void MeshCooker::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Triangles of each vertex.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t index : indices) {
+		++liveTriangles[index];
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+		}
+	}
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	int64_t fanning = 0;
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a) {
+			uint32_t triangle = adjacency[a];
+			if (isEmitted[triangle]) {
+				continue;
+			}
+			for (int k = 0; k < 3; ++k) {
+				uint32_t v = indices[triangle * 3 + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+				if (time - cacheTime[v] > cacheSize) {
+					cacheTime[v] = time++;
+				}
+			}
+			isEmitted[triangle] = true;
+		}
+
+		// The candidate that is most likely in the cache after its remaining triangles are emitted.
+		fanning = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (liveTriangles[v] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+				priority = time - cacheTime[v];
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+
+		// Dead end: go back to a recently used vertex, or the next one in the input order.
+		while (fanning < 0 && !deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[v] > 0) {
+				fanning = v;
+			}
+		}
+		while (fanning < 0 && cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0) {
+				fanning = (int64_t)cursor;
+			}
+			++cursor;
+		}
+	}
+
+	indices = std::move(result);
+}
+
+
+void MeshCooker::OptimizeVertexFetch(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices) {
+	constexpr uint32_t unused = ~uint32_t(0);
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<CookedVertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = (uint32_t)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices = std::move(reordered);
+}
+
+
+float MeshCooker::AverageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize) {
+	if (indices.size() < 3) {
+		return 0.0f;
+	}
+
+	std::vector<bool> isCached(vertexCount, false);
+	std::deque<uint32_t> cache;
+	size_t misses = 0;
+	for (uint32_t index : indices) {
+		if (isCached[index]) {
+			continue;
+		}
+		++misses;
+		cache.push_back(index);
+		isCached[index] = true;
+		if (cache.size() > cacheSize) {
+			isCached[cache.front()] = false;
+			cache.pop_front();
+		}
+	}
+
+	return float(misses) / float(indices.size() / 3);
+}
+
+
+//------------------------------------------------------------------------------
+// CookedModel
+//------------------------------------------------------------------------------
+
+CookedModel CookedModel::Parse(const void* data, size_t size) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+	ContainerHeader header;
+	if (size < sizeof(header)) {
+		throw std::runtime_error("Cooked model is truncated.");
+	}
+	memcpy(&header, bytes, sizeof(header));
+	if (memcmp(header.magic, CONTAINER_MAGIC, sizeof(header.magic)) != 0) {
+		throw std::runtime_error("Not a cooked model.");
+	}
+	if (header.version != CONTAINER_VERSION || header.vertexStride != sizeof(CookedVertex)) {
+		throw std::runtime_error("Cooked model was made by a different version of the cooker.");
+	}
+	if (header.submeshCount > (size - sizeof(header)) / sizeof(ContainerSubmesh)) {
+		throw std::runtime_error("Cooked model is truncated.");
+	}
+
+	CookedModel result;
+	result.m_sourceStamp = header.sourceStamp;
+	for (uint32_t i = 0; i < header.submeshCount; ++i) {
+		ContainerSubmesh entry;
+		memcpy(&entry, bytes + sizeof(header) + i * sizeof(ContainerSubmesh), sizeof(entry));
+
+		uint64_t vertexBytes = uint64_t(entry.vertexCount) * sizeof(CookedVertex);
+		uint64_t indexBytes = uint64_t(entry.indexCount) * sizeof(uint32_t);
+		bool isInside = entry.vertexOffset <= size && vertexBytes <= size - entry.vertexOffset
+			&& entry.indexOffset <= size && indexBytes <= size - entry.indexOffset;
+		if (!isInside || entry.vertexOffset % DATA_ALIGNMENT != 0 || entry.indexOffset % DATA_ALIGNMENT != 0) {
+			throw std::runtime_error("Cooked model submesh table is corrupted.");
+		}
+
+		// The buffers are drawn as they are, indices out of range would read past the vertex buffer.
+		const uint32_t* indices = reinterpret_cast<const uint32_t*>(bytes + entry.indexOffset);
+		if (entry.indexCount % 3 != 0) {
+			throw std::runtime_error("Cooked model indices are not triangles.");
+		}
+		for (uint32_t index = 0; index < entry.indexCount; ++index) {
+			if (indices[index] >= entry.vertexCount) {
+				throw std::runtime_error("Cooked model indices over-index the vertices.");
+			}
+		}
+
+		CookedSubmesh submesh;
+		submesh.vertices = reinterpret_cast<const CookedVertex*>(bytes + entry.vertexOffset);
+		submesh.vertexCount = entry.vertexCount;
+		submesh.indices = indices;
+		submesh.indexCount = entry.indexCount;
+		result.m_submeshes.push_back(submesh);
+	}
+
+	uint64_t instanceBytes = uint64_t(header.instanceCount) * sizeof(CookedInstance);
+	if (header.instanceOffset > size || instanceBytes > size - header.instanceOffset || header.instanceOffset % DATA_ALIGNMENT != 0) {
+		throw std::runtime_error("Cooked model instance table is corrupted.");
+	}
+	result.m_instances = reinterpret_cast<const CookedInstance*>(bytes + header.instanceOffset);
+	result.m_instanceCount = header.instanceCount;
+	for (uint32_t i = 0; i < header.instanceCount; ++i) {
+		if (result.m_instances[i].submeshID >= header.submeshCount) {
+			throw std::runtime_error("Cooked model instance table is corrupted.");
+		}
+	}
+
+	return result;
+}
+
+
+CookedModel CookedModel::Load(const std::string& path) {
+	exc::MemoryMappedFile file(path);
+	CookedModel result = Parse(file.Data(), file.Size());
+	result.m_file = std::move(file);
+	return result;
+}
+
+
+} // namespace asset
+} // namespace inl
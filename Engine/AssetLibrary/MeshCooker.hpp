@@ -0,0 +1,102 @@
+#pragma once
+
+#include <BaseLibrary/Platform/MemoryMappedFile.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace inl {
+namespace asset {
+
+
+/// <summary> Vertex of cooked meshes, in the layout of the vertex buffer. </summary>
+struct CookedVertex {
+	float position[3];
+	float normal[3];
+	float texCoord[2];
+};
+
+
+/// <summary> One submesh of a cooked model. The pointers point into the cooked data. </summary>
+struct CookedSubmesh {
+	const CookedVertex* vertices;
+	uint32_t vertexCount;
+	const uint32_t* indices;
+	uint32_t indexCount;
+};
+
+
+/// <summary> A submesh placed in a cooked model. Several instances may share a submesh. </summary>
+struct CookedInstance {
+	uint32_t submeshID;
+	/// <summary> Column-major matrix that transforms the submesh's vertices into the model's space. </summary>
+	float transform[16];
+};
+
+
+/// <summary>
+/// A cooked model's submeshes and instances, parsed from memory or mapped from a file.
+/// The vertices and indices can be fed to the vertex and index buffers without conversion.
+/// </summary>
+class CookedModel {
+public:
+	CookedModel() = default;
+	CookedModel(CookedModel&&) = default;
+	CookedModel& operator=(CookedModel&&) = default;
+
+	/// <summary> Parses a cooked model. The data is not copied, it must outlive the object. </summary>
+	/// <remarks> Every index is checked against the vertex count, so the buffers are safe to draw. </remarks>
+	/// <exception cref="std::runtime_error"> If the data is not a valid cooked model. </exception>
+	static CookedModel Parse(const void* data, size_t size);
+	/// <summary> Maps a cooked model file. </summary>
+	/// <exception cref="std::runtime_error"> If the file can't be opened or is not a valid cooked model. </exception>
+	static CookedModel Load(const std::string& path);
+
+	unsigned SubmeshCount() const { return (unsigned)m_submeshes.size(); }
+	const CookedSubmesh& GetSubmesh(unsigned submeshID) const { return m_submeshes[submeshID]; }
+	unsigned InstanceCount() const { return m_instanceCount; }
+	const CookedInstance& GetInstance(unsigned instanceID) const { return m_instances[instanceID]; }
+	/// <summary> The stamp of the source given to the cooker, see <see cref="MeshCooker::Cook"/>. </summary>
+	uint64_t GetSourceStamp() const { return m_sourceStamp; }
+private:
+	exc::MemoryMappedFile m_file;
+	std::vector<CookedSubmesh> m_submeshes;
+	const CookedInstance* m_instances = nullptr;
+	uint32_t m_instanceCount = 0;
+	uint64_t m_sourceStamp = 0;
+};
+
+
+/// <summary>
+/// Writes post-processed submeshes into the cooked model format, with the indices reordered for the GPU's vertex cache.
+/// </summary>
+class MeshCooker {
+public:
+	struct Submesh {
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+public:
+	/// <summary> Optimizes the submeshes and serializes them with their instances. Vertices that are not referenced are dropped. </summary>
+	/// <param name="sourceStamp"> Stored in the cooked model, so a loader can tell that the source changed since it was cooked. </param>
+	/// <exception cref="std::invalid_argument"> If the indices are not triangles or over-index the vertices,
+	///		or an instance refers to a submesh that does not exist. </exception>
+	static std::vector<uint8_t> Cook(std::vector<Submesh> submeshes, const std::vector<CookedInstance>& instances = {}, uint64_t sourceStamp = 0);
+
+	/// <summary> Reorders the triangles so that they reuse recently transformed vertices. Uses the Tipsify algorithm. </summary>
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = DEFAULT_CACHE_SIZE);
+	/// <summary> Reorders the vertices in the order the triangles first use them, and drops the unused ones. </summary>
+	static void OptimizeVertexFetch(std::vector<CookedVertex>& vertices, std::vector<uint32_t>& indices);
+	/// <summary> Average number of vertices transformed per triangle with a FIFO cache of the given size. </summary>
+	static float AverageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned cacheSize = DEFAULT_CACHE_SIZE);
+
+	static constexpr unsigned DEFAULT_CACHE_SIZE = 16;
+};
+
+
+} // namespace asset
+} // namespace inl
@@ -1,4 +1,5 @@
 #include "Model.hpp"
+#include "MeshCooker.hpp"
 
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
@@ -7,31 +8,6 @@
 namespace inl {
 namespace asset {
 
-// count of nodes that contain at least one mesh
-static unsigned FilledNodeCount(const aiNode* node) {
-	unsigned result = 0;
-	if (node->mNumMeshes > 0) {
-		result++;
-	}
-	for (unsigned i = 0; i < node->mNumChildren; i++) {
-		result += FilledNodeCount(node->mChildren[i]);
-	}
-	return result;
-}
-
-static const aiNode* GetFirstFilledNode(const aiNode* node) {
-	if (node->mNumMeshes > 0) {
-		return node;
-	}
-	for (unsigned i = 0; i < node->mNumChildren; i++) {
-		const aiNode* match = GetFirstFilledNode(node->mChildren[i]);
-		if (match != nullptr) {
-			return match;
-		}
-	}
-	return nullptr;
-}
-
 static mathfu::Matrix<float, 4, 4> GetAbsoluteTransform(const aiNode* node) {
 	const auto& m = node->mTransformation;
 	// this constructor expects elements to be in column-major order
@@ -46,6 +22,20 @@ static mathfu::Matrix<float, 4, 4> GetAbsoluteTransform(const aiNode* node) {
 }
 
 
+// Lists the meshes of the node and its descendants with the nodes' transforms.
+static void CollectInstances(const aiNode* node, std::vector<ModelInstance>& instances) {
+	if (node->mNumMeshes > 0) {
+		mathfu::Matrix<float, 4, 4> transform = GetAbsoluteTransform(node);
+		for (unsigned i = 0; i < node->mNumMeshes; i++) {
+			instances.push_back({ node->mMeshes[i], transform });
+		}
+	}
+	for (unsigned i = 0; i < node->mNumChildren; i++) {
+		CollectInstances(node->mChildren[i], instances);
+	}
+}
+
+
 mathfu::Vector4f GetAxis(AxisDir dir) {
 	switch (dir) {
 	case AxisDir::POS_X:
@@ -75,9 +65,8 @@ Model::Model() :
 
 Model::Model(const std::string & filename) {
 	m_importer.reset(new Assimp::Importer);
-	// "aiProcess_OptimizeGraph" will collapse nodes if possible.
-	// This flag is used to have ideally all submeshes in a single node.
-	m_scene = m_importer->ReadFile(filename, aiProcessPreset_TargetRealtime_Quality | aiProcess_OptimizeGraph);
+	// Nodes are not collapsed, meshes that several nodes refer to are kept as instances.
+	m_scene = m_importer->ReadFile(filename, aiProcessPreset_TargetRealtime_Quality);
 
 	if (m_scene == nullptr) {
 		const std::string msg(m_importer->GetErrorString());
@@ -88,14 +77,20 @@ Model::Model(const std::string & filename) {
 		throw std::runtime_error("Model was loaded successfully but it does not contain any meshes!");
 	}
 
-	if (FilledNodeCount(m_scene->mRootNode) > 1) {
-		throw std::runtime_error("Model contains more than one mesh containing nodes. Only single noded models are supported at this time.");
-	}
-	// Find the single node that contains meshes.
-	const aiNode* node = GetFirstFilledNode(m_scene->mRootNode);
+	CollectInstances(m_scene->mRootNode, m_instances);
 
-	m_transform = GetAbsoluteTransform(node);
-	m_invTrTransform = m_transform.Inverse().Transpose();
+	// Bake the transform of submeshes that are placed once, they look the same as before instancing.
+	std::vector<unsigned> instanceCounts(m_scene->mNumMeshes, 0);
+	for (const auto& instance : m_instances) {
+		instanceCounts[instance.submeshID]++;
+	}
+	m_submeshTransforms.assign(m_scene->mNumMeshes, mathfu::Matrix<float, 4, 4>::Identity());
+	for (auto& instance : m_instances) {
+		if (instanceCounts[instance.submeshID] == 1) {
+			m_submeshTransforms[instance.submeshID] = instance.transform;
+			instance.transform = mathfu::Matrix<float, 4, 4>::Identity();
+		}
+	}
 }
 
 
@@ -105,6 +100,11 @@ unsigned Model::SubmeshCount() const {
 }
 
 
+const std::vector<ModelInstance>& Model::GetInstances() const {
+	return m_instances;
+}
+
+
 std::vector<unsigned> Model::GetIndices(unsigned submeshID) const {
 	unsigned meshCount = m_scene->mNumMeshes;
 	assert(submeshID < meshCount);
@@ -127,5 +127,38 @@ std::vector<unsigned> Model::GetIndices(unsigned submeshID) const {
 
 
 
+std::vector<uint8_t> Model::Cook(CoordSysLayout cSysLayout, uint64_t sourceStamp) const {
+	using gxeng::Position;
+	using gxeng::Normal;
+	using gxeng::TexCoord;
+
+	std::vector<MeshCooker::Submesh> submeshes(SubmeshCount());
+	for (unsigned submeshID = 0; submeshID < SubmeshCount(); submeshID++) {
+		auto vertices = GetVertices<Position<0>, Normal<0>, TexCoord<0>>(submeshID, cSysLayout);
+		auto& submesh = submeshes[submeshID];
+		submesh.vertices.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			const auto& vertex = vertices[i];
+			CookedVertex& cooked = submesh.vertices[i];
+			cooked.position[0] = vertex.position.x(); cooked.position[1] = vertex.position.y(); cooked.position[2] = vertex.position.z();
+			cooked.normal[0] = vertex.normal.x(); cooked.normal[1] = vertex.normal.y(); cooked.normal[2] = vertex.normal.z();
+			cooked.texCoord[0] = vertex.texCoord.x(); cooked.texCoord[1] = vertex.texCoord.y();
+		}
+		submesh.indices = GetIndices(submeshID);
+	}
+
+	std::vector<CookedInstance> instances(m_instances.size());
+	for (size_t i = 0; i < m_instances.size(); i++) {
+		instances[i].submeshID = m_instances[i].submeshID;
+		for (int element = 0; element < 16; element++) {
+			instances[i].transform[element] = m_instances[i].transform[element];
+		}
+	}
+
+	return MeshCooker::Cook(std::move(submeshes), instances, sourceStamp);
+}
+
+
+
 } // namespace asset
 } // namespace inl
@@ -23,6 +23,13 @@ struct CoordSysLayout {
 	AxisDir x, y, z;
 };
 
+/// <summary> A submesh placed in the model by a node of its hierarchy. </summary>
+struct ModelInstance {
+	unsigned submeshID;
+	/// <summary> Transforms the vertices of the submesh, as returned by <see cref="Model::GetVertices"/>, into the model's space. </summary>
+	mathfu::Matrix4x4f transform;
+};
+
 class Model {
 public:
 	Model();
@@ -30,11 +37,21 @@ public:
 
 	unsigned SubmeshCount() const;
 
+	/// <summary> The submeshes placed by the nodes of the model, in the order of the hierarchy. A submesh may be placed several times. </summary>
+	/// <remarks> Submeshes that are placed once have their node's transform baked into their vertices, and an identity transform.
+	///		The vertices of the others stay in their own space so that they can be shared, each instance has its node's transform. </remarks>
+	const std::vector<ModelInstance>& GetInstances() const;
+
 	template <typename... AttribT>
 	std::vector<gxeng::Vertex<AttribT...>> GetVertices(unsigned submeshID, CoordSysLayout cSysLayout = {AxisDir::POS_X, AxisDir::POS_Y, AxisDir::POS_Z}) const;
 
 	std::vector<unsigned> GetIndices(unsigned submeshID) const;
 
+	/// <summary> Transforms all submeshes and writes them with their instances in the cooked format, which loads without the importer.
+	///		See <see cref="MeshCooker"/> and <see cref="CookedModel"/>. The submeshes must have normals and texture coordinates. </summary>
+	/// <param name="sourceStamp"> Identifies the version of the source file, see <see cref="CookedModel::GetSourceStamp"/>. </param>
+	std::vector<uint8_t> Cook(CoordSysLayout cSysLayout = {AxisDir::POS_X, AxisDir::POS_Y, AxisDir::POS_Z}, uint64_t sourceStamp = 0) const;
+
 protected:
 	// It is cleary stated in the documentation that an imporer instance will keep ownership
 	// of the imported scene. This is fine. But seems like an importer can only store one scene
@@ -42,8 +59,8 @@ protected:
 	std::shared_ptr<Assimp::Importer> m_importer; 
 	const aiScene* m_scene;
 	
-	mathfu::Matrix<float, 4, 4> m_transform;
-	mathfu::Matrix<float, 4, 4> m_invTrTransform;
+	std::vector<mathfu::Matrix<float, 4, 4>> m_submeshTransforms; // Baked into the vertices.
+	std::vector<ModelInstance> m_instances;
 
 private:
 	
@@ -63,7 +80,7 @@ inline std::vector<gxeng::Vertex<AttribT...>> Model::GetVertices(unsigned submes
 	result.reserve(mesh->mNumVertices);
 
 	const mathfu::Matrix4x4f posTransform =
-		m_transform *
+		m_submeshTransforms[submeshID] *
 		(mathfu::Matrix4x4f(GetAxis(csys.x), GetAxis(csys.y), GetAxis(csys.z), mathfu::Vector4f(0, 0, 0, 1)).Transpose());
 
 	const mathfu::Matrix4x4f normalTransform = posTransform.Inverse().Transpose();
@@ -0,0 +1,755 @@
+#include "TextureCooker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+
+namespace inl {
+namespace asset {
+
+
+namespace {
+
+// Cooked texture container: header, mip table, then the mips' data.
+constexpr char CONTAINER_MAGIC[4] = { 'I', 'T', 'E', 'X' };
+constexpr uint32_t CONTAINER_VERSION = 2;
+constexpr size_t DATA_ALIGNMENT = 16;
+constexpr int MAX_MIP_COUNT = 32;
+
+struct ContainerHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t compression;
+	uint32_t mipCount;
+	uint64_t sourceStamp;
+};
+
+struct ContainerMip {
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+
+// Calls func(firstRow, lastRow) for bands of rows, on multiple threads if there is enough work.
+template <class Func>
+void ForEachBand(size_t rowCount, size_t pixelsPerRow, Func func) {
+	size_t threadCount = std::min({ size_t(std::max(1u, std::thread::hardware_concurrency())),
+									rowCount * pixelsPerRow / TextureCooker::MIN_PIXELS_PER_THREAD,
+									rowCount });
+	if (threadCount <= 1) {
+		func(size_t(0), rowCount);
+		return;
+	}
+
+	// The first band is processed on this thread.
+	size_t rowsPerBand = (rowCount + threadCount - 1) / threadCount;
+	std::vector<std::future<void>> bands;
+	for (size_t firstRow = rowsPerBand; firstRow < rowCount; firstRow += rowsPerBand) {
+		bands.push_back(std::async(std::launch::async, func, firstRow, std::min(rowCount, firstRow + rowsPerBand)));
+	}
+	func(size_t(0), rowsPerBand);
+	for (auto& band : bands) {
+		band.get();
+	}
+}
+
+
+//------------------------------------------------------------------------------
+// Mip generation
+//------------------------------------------------------------------------------
+
+TextureCooker::MipLevel DownsampleBox(const TextureCooker::MipLevel& source) {
+	TextureCooker::MipLevel result;
+	result.width = std::max(1u, source.width / 2);
+	result.height = std::max(1u, source.height / 2);
+	result.pixels.resize(size_t(result.width) * result.height * 4);
+
+	const size_t srcPitch = size_t(source.width) * 4;
+	ForEachBand(result.height, result.width, [&](size_t firstRow, size_t lastRow) {
+		for (size_t y = firstRow; y < lastRow; ++y) {
+			const uint8_t* row0 = source.pixels.data() + std::min<size_t>(2 * y, source.height - 1) * srcPitch;
+			const uint8_t* row1 = source.pixels.data() + std::min<size_t>(2 * y + 1, source.height - 1) * srcPitch;
+			uint8_t* dst = result.pixels.data() + y * result.width * 4;
+			for (size_t x = 0; x < result.width; ++x) {
+				size_t x0 = 2 * x * 4;
+				size_t x1 = std::min<size_t>(2 * x + 1, source.width - 1) * 4;
+				for (int c = 0; c < 4; ++c) {
+					dst[x * 4 + c] = uint8_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+				}
+			}
+		}
+	});
+
+	return result;
+}
+
+
+// Kaiser windowed sinc, halving the resolution. The taps are the 8 source pixels around the center of the target pixel.
+constexpr int KAISER_TAPS = 8;
+
+double BesselI0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 20; ++k) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+std::array<float, KAISER_TAPS> KaiserWeights() {
+	constexpr double pi = 3.14159265358979323846;
+	constexpr double beta = 4.0;
+	constexpr double support = KAISER_TAPS / 2;
+
+	std::array<float, KAISER_TAPS> weights;
+	double sum = 0.0;
+	for (int i = 0; i < KAISER_TAPS; ++i) {
+		double distance = i - KAISER_TAPS / 2 + 0.5; // In source pixels, -3.5 to 3.5.
+		double t = distance / 2;
+		double sinc = std::sin(pi * t) / (pi * t);
+		double r = distance / support;
+		double window = BesselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / BesselI0(beta);
+		weights[i] = float(sinc * window);
+		sum += weights[i];
+	}
+	for (auto& weight : weights) {
+		weight = float(weight / sum);
+	}
+	return weights;
+}
+
+TextureCooker::MipLevel DownsampleKaiser(const TextureCooker::MipLevel& source) {
+	static const std::array<float, KAISER_TAPS> weights = KaiserWeights();
+
+	TextureCooker::MipLevel result;
+	result.width = std::max(1u, source.width / 2);
+	result.height = std::max(1u, source.height / 2);
+	result.pixels.resize(size_t(result.width) * result.height * 4);
+
+	// Horizontal pass into floats, dimensions of 1 are not filtered.
+	std::vector<float> horizontal(size_t(result.width) * source.height * 4);
+	ForEachBand(source.height, result.width, [&](size_t firstRow, size_t lastRow) {
+		for (size_t y = firstRow; y < lastRow; ++y) {
+			const uint8_t* src = source.pixels.data() + y * source.width * 4;
+			float* dst = horizontal.data() + y * result.width * 4;
+			if (source.width == 1) {
+				for (int c = 0; c < 4; ++c) {
+					dst[c] = src[c];
+				}
+				continue;
+			}
+			for (ptrdiff_t x = 0; x < (ptrdiff_t)result.width; ++x) {
+				float sum[4] = { 0, 0, 0, 0 };
+				for (int i = 0; i < KAISER_TAPS; ++i) {
+					ptrdiff_t sx = std::min<ptrdiff_t>(std::max<ptrdiff_t>(2 * x + i - KAISER_TAPS / 2 + 1, 0), source.width - 1);
+					for (int c = 0; c < 4; ++c) {
+						sum[c] += weights[i] * src[sx * 4 + c];
+					}
+				}
+				for (int c = 0; c < 4; ++c) {
+					dst[x * 4 + c] = sum[c];
+				}
+			}
+		}
+	});
+
+	// Vertical pass, whole rows at a time.
+	const size_t rowSize = size_t(result.width) * 4;
+	ForEachBand(result.height, result.width, [&](size_t firstRow, size_t lastRow) {
+		std::vector<float> sum(rowSize);
+		for (size_t y = firstRow; y < lastRow; ++y) {
+			if (source.height == 1) {
+				std::copy(horizontal.begin(), horizontal.begin() + rowSize, sum.begin());
+			}
+			else {
+				std::fill(sum.begin(), sum.end(), 0.0f);
+				for (int i = 0; i < KAISER_TAPS; ++i) {
+					ptrdiff_t sy = std::min<ptrdiff_t>(std::max<ptrdiff_t>(2 * ptrdiff_t(y) + i - KAISER_TAPS / 2 + 1, 0), source.height - 1);
+					const float* src = horizontal.data() + sy * rowSize;
+					const float weight = weights[i];
+					for (size_t j = 0; j < rowSize; ++j) {
+						sum[j] += weight * src[j];
+					}
+				}
+			}
+			uint8_t* dst = result.pixels.data() + y * rowSize;
+			for (size_t j = 0; j < rowSize; ++j) {
+				dst[j] = uint8_t(std::min(std::max(sum[j] + 0.5f, 0.0f), 255.0f));
+			}
+		}
+	});
+
+	return result;
+}
+
+
+//------------------------------------------------------------------------------
+// Block compression
+//------------------------------------------------------------------------------
+
+struct Block {
+	uint8_t pixels[16][4];
+};
+
+void FetchBlock(const TextureCooker::MipLevel& image, uint32_t blockX, uint32_t blockY, Block& block) {
+	for (uint32_t y = 0; y < 4; ++y) {
+		uint32_t sy = std::min(blockY * 4 + y, image.height - 1);
+		for (uint32_t x = 0; x < 4; ++x) {
+			uint32_t sx = std::min(blockX * 4 + x, image.width - 1);
+			memcpy(block.pixels[y * 4 + x], image.pixels.data() + (size_t(sy) * image.width + sx) * 4, 4);
+		}
+	}
+}
+
+void StoreBlock(TextureCooker::MipLevel& image, uint32_t blockX, uint32_t blockY, const Block& block) {
+	for (uint32_t y = 0; y < 4 && blockY * 4 + y < image.height; ++y) {
+		for (uint32_t x = 0; x < 4 && blockX * 4 + x < image.width; ++x) {
+			memcpy(image.pixels.data() + (size_t(blockY * 4 + y) * image.width + blockX * 4 + x) * 4, block.pixels[y * 4 + x], 4);
+		}
+	}
+}
+
+
+// Endpoints on the diagonal of the bounding box that follows the colors' correlation with the first channel.
+void FitEndpoints(const Block& block, int channelCount, int endpoints[2][4]) {
+	int minimum[4] = { 255, 255, 255, 255 };
+	int maximum[4] = { 0, 0, 0, 0 };
+	int center[4] = { 0, 0, 0, 0 };
+	for (const auto& pixel : block.pixels) {
+		for (int c = 0; c < channelCount; ++c) {
+			minimum[c] = std::min(minimum[c], int(pixel[c]));
+			maximum[c] = std::max(maximum[c], int(pixel[c]));
+			center[c] += pixel[c];
+		}
+	}
+
+	int covariance[4] = { 0, 0, 0, 0 };
+	for (const auto& pixel : block.pixels) {
+		int first = pixel[0] * 16 - center[0];
+		for (int c = 1; c < channelCount; ++c) {
+			covariance[c] += first * (pixel[c] * 16 - center[c]);
+		}
+	}
+
+	for (int c = 0; c < channelCount; ++c) {
+		// Inset the box a little, the extremes are usually outliers.
+		int inset = (maximum[c] - minimum[c]) / 16;
+		endpoints[0][c] = maximum[c] - inset;
+		endpoints[1][c] = minimum[c] + inset;
+		if (covariance[c] < 0) {
+			std::swap(endpoints[0][c], endpoints[1][c]);
+		}
+	}
+}
+
+template <int ChannelCount>
+int NearestIndex(const uint8_t* pixel, const int (*palette)[4], int paletteSize) {
+	int bestIndex = 0;
+	int bestError = INT32_MAX;
+	for (int i = 0; i < paletteSize; ++i) {
+		int error = 0;
+		for (int c = 0; c < ChannelCount; ++c) {
+			int diff = int(pixel[c]) - palette[i][c];
+			error += diff * diff;
+		}
+		if (error < bestError) {
+			bestError = error;
+			bestIndex = i;
+		}
+	}
+	return bestIndex;
+}
+
+
+uint16_t To565(const int color[4]) {
+	int r = (color[0] * 31 + 127) / 255;
+	int g = (color[1] * 63 + 127) / 255;
+	int b = (color[2] * 31 + 127) / 255;
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+void From565(uint16_t value, int color[4]) {
+	int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+	color[3] = 255;
+}
+
+void Bc1Palette(uint16_t color0, uint16_t color1, int palette[4][4]) {
+	From565(color0, palette[0]);
+	From565(color1, palette[1]);
+	for (int c = 0; c < 3; ++c) {
+		if (color0 > color1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = color0 > color1 ? 255 : 0;
+}
+
+void EncodeBc1(const Block& block, uint8_t* output) {
+	int endpoints[2][4];
+	FitEndpoints(block, 3, endpoints);
+	uint16_t color0 = To565(endpoints[0]);
+	uint16_t color1 = To565(endpoints[1]);
+
+	// The four color mode needs color0 > color1.
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int palette[4][4];
+		Bc1Palette(color0, color1, palette);
+		for (int i = 0; i < 16; ++i) {
+			indices |= uint32_t(NearestIndex<3>(block.pixels[i], palette, 4)) << (2 * i);
+		}
+	}
+
+	output[0] = uint8_t(color0);
+	output[1] = uint8_t(color0 >> 8);
+	output[2] = uint8_t(color1);
+	output[3] = uint8_t(color1 >> 8);
+	memcpy(output + 4, &indices, 4);
+}
+
+void DecodeBc1(const uint8_t* input, Block& block) {
+	uint16_t color0 = uint16_t(input[0] | (input[1] << 8));
+	uint16_t color1 = uint16_t(input[2] | (input[3] << 8));
+	uint32_t indices;
+	memcpy(&indices, input + 4, 4);
+
+	int palette[4][4];
+	Bc1Palette(color0, color1, palette);
+	for (int i = 0; i < 16; ++i) {
+		const int* color = palette[(indices >> (2 * i)) & 3];
+		for (int c = 0; c < 4; ++c) {
+			block.pixels[i][c] = uint8_t(color[c]);
+		}
+	}
+}
+
+
+void Bc4Palette(int value0, int value1, int palette[8][4]) {
+	palette[0][0] = value0;
+	palette[1][0] = value1;
+	if (value0 > value1) {
+		for (int i = 2; i < 8; ++i) {
+			palette[i][0] = ((8 - i) * value0 + (i - 1) * value1) / 7;
+		}
+	}
+	else {
+		for (int i = 2; i < 6; ++i) {
+			palette[i][0] = ((6 - i) * value0 + (i - 1) * value1) / 5;
+		}
+		palette[6][0] = 0;
+		palette[7][0] = 255;
+	}
+}
+
+// A single channel of the block, used for the alpha of BC3 and both channels of BC5.
+void EncodeBc4(const Block& block, int channel, uint8_t* output) {
+	int minimum = 255, maximum = 0;
+	for (const auto& pixel : block.pixels) {
+		minimum = std::min(minimum, int(pixel[channel]));
+		maximum = std::max(maximum, int(pixel[channel]));
+	}
+
+	uint64_t indices = 0;
+	if (minimum != maximum) {
+		int palette[8][4];
+		Bc4Palette(maximum, minimum, palette);
+		for (int i = 0; i < 16; ++i) {
+			uint8_t value = block.pixels[i][channel];
+			indices |= uint64_t(NearestIndex<1>(&value, palette, 8)) << (3 * i);
+		}
+	}
+
+	output[0] = uint8_t(maximum);
+	output[1] = uint8_t(minimum);
+	for (int i = 0; i < 6; ++i) {
+		output[2 + i] = uint8_t(indices >> (8 * i));
+	}
+}
+
+void DecodeBc4(const uint8_t* input, int channel, Block& block) {
+	int palette[8][4];
+	Bc4Palette(input[0], input[1], palette);
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; ++i) {
+		indices |= uint64_t(input[2 + i]) << (8 * i);
+	}
+	for (int i = 0; i < 16; ++i) {
+		block.pixels[i][channel] = uint8_t(palette[(indices >> (3 * i)) & 7][0]);
+	}
+}
+
+
+// BC7 mode 6: a single subset, 7 bit RGBA endpoints with a shared low bit each, 4 bit indices.
+constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+class BitWriter {
+public:
+	explicit BitWriter(uint8_t* output) : m_output(output) { memset(output, 0, 16); }
+	void Write(uint32_t value, int bitCount) {
+		for (int i = 0; i < bitCount; ++i, ++m_position) {
+			m_output[m_position / 8] |= uint8_t(((value >> i) & 1) << (m_position % 8));
+		}
+	}
+private:
+	uint8_t* m_output;
+	int m_position = 0;
+};
+
+class BitReader {
+public:
+	explicit BitReader(const uint8_t* input) : m_input(input) {}
+	uint32_t Read(int bitCount) {
+		uint32_t value = 0;
+		for (int i = 0; i < bitCount; ++i, ++m_position) {
+			value |= uint32_t((m_input[m_position / 8] >> (m_position % 8)) & 1) << i;
+		}
+		return value;
+	}
+private:
+	const uint8_t* m_input;
+	int m_position = 0;
+};
+
+// Picks the shared bit that reproduces the endpoint better.
+void QuantizeBc7Endpoint(const int endpoint[4], int quantized[4], int& pBit) {
+	int bestError = INT32_MAX;
+	for (int p = 0; p < 2; ++p) {
+		int error = 0;
+		int candidate[4];
+		for (int c = 0; c < 4; ++c) {
+			candidate[c] = std::min(std::max((endpoint[c] - p + 1) / 2, 0), 127);
+			int diff = ((candidate[c] << 1) | p) - endpoint[c];
+			error += diff * diff;
+		}
+		if (error < bestError) {
+			bestError = error;
+			pBit = p;
+			std::copy(candidate, candidate + 4, quantized);
+		}
+	}
+}
+
+void Bc7Palette(const int endpoints[2][4], int palette[16][4]) {
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 4; ++c) {
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * endpoints[0][c] + BC7_WEIGHTS[i] * endpoints[1][c] + 32) >> 6;
+		}
+	}
+}
+
+void EncodeBc7(const Block& block, uint8_t* output) {
+	int endpoints[2][4];
+	FitEndpoints(block, 4, endpoints);
+
+	int quantized[2][4];
+	int pBits[2];
+	for (int e = 0; e < 2; ++e) {
+		QuantizeBc7Endpoint(endpoints[e], quantized[e], pBits[e]);
+		for (int c = 0; c < 4; ++c) {
+			endpoints[e][c] = (quantized[e][c] << 1) | pBits[e];
+		}
+	}
+
+	int palette[16][4];
+	Bc7Palette(endpoints, palette);
+	int indices[16];
+	for (int i = 0; i < 16; ++i) {
+		indices[i] = NearestIndex<4>(block.pixels[i], palette, 16);
+	}
+
+	// The highest bit of the first index is implicitly zero, swap the endpoints if it's set.
+	if (indices[0] >= 8) {
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pBits[0], pBits[1]);
+		for (auto& index : indices) {
+			index = 15 - index;
+		}
+	}
+
+	BitWriter writer(output);
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; ++c) {
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+	writer.Write(pBits[0], 1);
+	writer.Write(pBits[1], 1);
+	writer.Write(indices[0], 3);
+	for (int i = 1; i < 16; ++i) {
+		writer.Write(indices[i], 4);
+	}
+}
+
+void DecodeBc7(const uint8_t* input, Block& block) {
+	BitReader reader(input);
+	if (reader.Read(7) != (1 << 6)) {
+		throw std::runtime_error("Only mode 6 BC7 blocks can be decoded.");
+	}
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; ++c) {
+		endpoints[0][c] = reader.Read(7) << 1;
+		endpoints[1][c] = reader.Read(7) << 1;
+	}
+	int pBit0 = reader.Read(1), pBit1 = reader.Read(1);
+	for (int c = 0; c < 4; ++c) {
+		endpoints[0][c] |= pBit0;
+		endpoints[1][c] |= pBit1;
+	}
+
+	int palette[16][4];
+	Bc7Palette(endpoints, palette);
+	for (int i = 0; i < 16; ++i) {
+		const int* color = palette[reader.Read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; ++c) {
+			block.pixels[i][c] = uint8_t(color[c]);
+		}
+	}
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+// TextureCooker
+//------------------------------------------------------------------------------
+
+std::vector<uint8_t> TextureCooker::Cook(const uint8_t* pixels, uint32_t width, uint32_t height, int channelCount, size_t bytesPerRow, const Options& options) {
+	if (channelCount < 1 || channelCount > 4) {
+		throw std::invalid_argument("Images must have 1 to 4 channels.");
+	}
+	if (width == 0 || height == 0) {
+		throw std::invalid_argument("Image is empty.");
+	}
+	if (options.compression != eTextureCompression::NONE && (width % 4 != 0 || height % 4 != 0)) {
+		throw std::invalid_argument("Size of block compressed textures must be a multiple of 4.");
+	}
+
+	// Expand to RGBA, single channel images become grayscale.
+	MipLevel image{ width, height, std::vector<uint8_t>(size_t(width) * height * 4) };
+	size_t srcPitch = bytesPerRow > 0 ? bytesPerRow : size_t(width) * channelCount;
+	ForEachBand(height, width, [&](size_t firstRow, size_t lastRow) {
+		for (size_t y = firstRow; y < lastRow; ++y) {
+			const uint8_t* src = pixels + y * srcPitch;
+			uint8_t* dst = image.pixels.data() + y * width * 4;
+			for (size_t x = 0; x < width; ++x, src += channelCount, dst += 4) {
+				dst[0] = src[0];
+				dst[1] = channelCount == 1 ? src[0] : src[1];
+				dst[2] = channelCount == 1 ? src[0] : channelCount == 2 ? 0 : src[2];
+				dst[3] = channelCount == 4 ? src[3] : 255;
+			}
+		}
+	});
+
+	std::vector<MipLevel> mips = GenerateMips(std::move(image), options.filter, options.maxMipCount);
+
+	// Header and mip table.
+	std::vector<uint8_t> result(sizeof(ContainerHeader) + mips.size() * sizeof(ContainerMip));
+	ContainerHeader header;
+	memcpy(header.magic, CONTAINER_MAGIC, sizeof(header.magic));
+	header.version = CONTAINER_VERSION;
+	header.compression = (uint32_t)options.compression;
+	header.mipCount = (uint32_t)mips.size();
+	header.sourceStamp = options.sourceStamp;
+	memcpy(result.data(), &header, sizeof(header));
+
+	for (size_t level = 0; level < mips.size(); ++level) {
+		std::vector<uint8_t> data = options.compression == eTextureCompression::NONE
+			? std::move(mips[level].pixels)
+			: Compress(mips[level], options.compression);
+
+		ContainerMip mip;
+		mip.width = mips[level].width;
+		mip.height = mips[level].height;
+		mip.rowPitch = (uint32_t)GetRowPitch(options.compression, mip.width);
+		mip.reserved = 0;
+		mip.offset = (result.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+		mip.size = data.size();
+		memcpy(result.data() + sizeof(ContainerHeader) + level * sizeof(ContainerMip), &mip, sizeof(mip));
+
+		result.resize(mip.offset);
+		result.insert(result.end(), data.begin(), data.end());
+	}
+
+	return result;
+}
+
+
+auto TextureCooker::GenerateMips(MipLevel image, eMipFilter filter, int maxMipCount) -> std::vector<MipLevel> {
+	std::vector<MipLevel> mips;
+	mips.push_back(std::move(image));
+	while ((maxMipCount <= 0 || (int)mips.size() < maxMipCount) && (mips.back().width > 1 || mips.back().height > 1)) {
+		mips.push_back(filter == eMipFilter::KAISER ? DownsampleKaiser(mips.back()) : DownsampleBox(mips.back()));
+	}
+	return mips;
+}
+
+
+std::vector<uint8_t> TextureCooker::Compress(const MipLevel& image, eTextureCompression compression) {
+	if (compression == eTextureCompression::NONE) {
+		return image.pixels;
+	}
+
+	const uint32_t blocksX = (image.width + 3) / 4;
+	const uint32_t blocksY = (image.height + 3) / 4;
+	const size_t blockSize = GetBlockSizeInBytes(compression);
+	std::vector<uint8_t> result(blockSize * blocksX * blocksY);
+
+	ForEachBand(blocksY, size_t(blocksX) * 16, [&](size_t firstRow, size_t lastRow) {
+		Block block;
+		for (size_t by = firstRow; by < lastRow; ++by) {
+			for (uint32_t bx = 0; bx < blocksX; ++bx) {
+				FetchBlock(image, bx, (uint32_t)by, block);
+				uint8_t* output = result.data() + (by * blocksX + bx) * blockSize;
+				switch (compression) {
+					case eTextureCompression::BC1: EncodeBc1(block, output); break;
+					case eTextureCompression::BC3: EncodeBc4(block, 3, output); EncodeBc1(block, output + 8); break;
+					case eTextureCompression::BC5: EncodeBc4(block, 0, output); EncodeBc4(block, 1, output + 8); break;
+					case eTextureCompression::BC7: EncodeBc7(block, output); break;
+					default: break;
+				}
+			}
+		}
+	});
+
+	return result;
+}
+
+
+auto TextureCooker::Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, eTextureCompression compression) -> MipLevel {
+	MipLevel result{ width, height, std::vector<uint8_t>(size_t(width) * height * 4) };
+	if (compression == eTextureCompression::NONE) {
+		memcpy(result.pixels.data(), blocks, result.pixels.size());
+		return result;
+	}
+
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const size_t blockSize = GetBlockSizeInBytes(compression);
+
+	Block block;
+	for (uint32_t by = 0; by < blocksY; ++by) {
+		for (uint32_t bx = 0; bx < blocksX; ++bx) {
+			const uint8_t* input = blocks + (size_t(by) * blocksX + bx) * blockSize;
+			switch (compression) {
+				case eTextureCompression::BC1: DecodeBc1(input, block); break;
+				case eTextureCompression::BC3: DecodeBc1(input + 8, block); DecodeBc4(input, 3, block); break;
+				case eTextureCompression::BC5:
+					DecodeBc4(input, 0, block);
+					DecodeBc4(input + 8, 1, block);
+					for (auto& pixel : block.pixels) {
+						pixel[2] = 0;
+						pixel[3] = 255;
+					}
+					break;
+				case eTextureCompression::BC7: DecodeBc7(input, block); break;
+				default: break;
+			}
+			StoreBlock(result, bx, by, block);
+		}
+	}
+
+	return result;
+}
+
+
+size_t TextureCooker::GetBlockSizeInBytes(eTextureCompression compression) {
+	switch (compression) {
+		case eTextureCompression::NONE: return 4;
+		case eTextureCompression::BC1: return 8;
+		case eTextureCompression::BC3:
+		case eTextureCompression::BC5:
+		case eTextureCompression::BC7: return 16;
+	}
+	return 0;
+}
+
+
+size_t TextureCooker::GetRowPitch(eTextureCompression compression, uint32_t width) {
+	uint32_t blocks = compression == eTextureCompression::NONE ? width : (width + 3) / 4;
+	return blocks * GetBlockSizeInBytes(compression);
+}
+
+
+uint32_t TextureCooker::GetRowCount(eTextureCompression compression, uint32_t height) {
+	return compression == eTextureCompression::NONE ? height : (height + 3) / 4;
+}
+
+
+//------------------------------------------------------------------------------
+// CookedTexture
+//------------------------------------------------------------------------------
+
+CookedTexture CookedTexture::Parse(const void* data, size_t size) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+	ContainerHeader header;
+	if (size < sizeof(header)) {
+		throw std::runtime_error("Cooked texture is truncated.");
+	}
+	memcpy(&header, bytes, sizeof(header));
+	if (memcmp(header.magic, CONTAINER_MAGIC, sizeof(header.magic)) != 0) {
+		throw std::runtime_error("Not a cooked texture.");
+	}
+	if (header.version != CONTAINER_VERSION) {
+		throw std::runtime_error("Cooked texture was made by a different version of the cooker.");
+	}
+	if (header.compression > (uint32_t)eTextureCompression::BC7 || header.mipCount < 1 || header.mipCount > MAX_MIP_COUNT) {
+		throw std::runtime_error("Cooked texture header is corrupted.");
+	}
+	if (size < sizeof(header) + header.mipCount * sizeof(ContainerMip)) {
+		throw std::runtime_error("Cooked texture is truncated.");
+	}
+
+	CookedTexture result;
+	result.m_data = bytes;
+	result.m_compression = (eTextureCompression)header.compression;
+	result.m_sourceStamp = header.sourceStamp;
+	for (uint32_t level = 0; level < header.mipCount; ++level) {
+		ContainerMip mip;
+		memcpy(&mip, bytes + sizeof(header) + level * sizeof(ContainerMip), sizeof(mip));
+
+		bool isConsistent = mip.rowPitch == TextureCooker::GetRowPitch(result.m_compression, mip.width)
+			&& mip.size == uint64_t(mip.rowPitch) * TextureCooker::GetRowCount(result.m_compression, mip.height);
+		if (!isConsistent || mip.offset > size || mip.size > size - mip.offset) {
+			throw std::runtime_error("Cooked texture mip table is corrupted.");
+		}
+		result.m_mips.push_back({ mip.width, mip.height, mip.rowPitch, mip.offset, mip.size });
+	}
+
+	return result;
+}
+
+
+CookedTexture CookedTexture::Load(const std::string& path) {
+	exc::MemoryMappedFile file(path);
+	CookedTexture result = Parse(file.Data(), file.Size());
+	result.m_file = std::move(file);
+	return result;
+}
+
+
+} // namespace asset
+} // namespace inl
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <BaseLibrary/Platform/MemoryMappedFile.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace inl {
+namespace asset {
+
+
+/// <summary> Storage format of cooked textures. Mirrors gxeng::eTextureCompression. </summary>
+enum class eTextureCompression : uint32_t {
+	NONE, // 8 bit RGBA
+	BC1, // RGB, 4 bits per pixel
+	BC3, // RGBA, 8 bits per pixel
+	BC5, // Two channels (normal maps), 8 bits per pixel
+	BC7, // RGBA, 8 bits per pixel, better quality than BC3
+};
+
+
+enum class eMipFilter {
+	BOX,
+	KAISER,
+};
+
+
+/// <summary> Location of one mip level inside a cooked texture. </summary>
+struct CookedMip {
+	uint32_t width;
+	uint32_t height;
+	/// <summary> Pitch of the rows, rows of 4x4 blocks for compressed textures. Rows are tightly packed. </summary>
+	uint32_t rowPitch;
+	uint64_t offset;
+	uint64_t size;
+};
+
+
+/// <summary>
+/// A cooked texture's mip levels, parsed from memory or mapped from a file.
+/// The mips are in the layout the GPU uses, they can be uploaded without conversion.
+/// </summary>
+class CookedTexture {
+public:
+	CookedTexture() = default;
+	CookedTexture(CookedTexture&&) = default;
+	CookedTexture& operator=(CookedTexture&&) = default;
+
+	/// <summary> Parses a cooked texture. The data is not copied, it must outlive the object. </summary>
+	/// <exception cref="std::runtime_error"> If the data is not a valid cooked texture. </exception>
+	static CookedTexture Parse(const void* data, size_t size);
+	/// <summary> Maps a cooked texture file. Only the mips that are read get paged in. </summary>
+	/// <exception cref="std::runtime_error"> If the file can't be opened or is not a valid cooked texture. </exception>
+	static CookedTexture Load(const std::string& path);
+
+	eTextureCompression GetCompression() const { return m_compression; }
+	uint32_t GetWidth() const { return m_mips.empty() ? 0 : m_mips[0].width; }
+	uint32_t GetHeight() const { return m_mips.empty() ? 0 : m_mips[0].height; }
+	int GetMipCount() const { return (int)m_mips.size(); }
+	/// <summary> The stamp of the source given to the cooker, see <see cref="TextureCooker::Options::sourceStamp"/>. </summary>
+	uint64_t GetSourceStamp() const { return m_sourceStamp; }
+
+	const CookedMip& GetMip(int level) const { return m_mips[level]; }
+	const uint8_t* GetMipData(int level) const { return m_data + m_mips[level].offset; }
+private:
+	exc::MemoryMappedFile m_file;
+	const uint8_t* m_data = nullptr;
+	eTextureCompression m_compression = eTextureCompression::NONE;
+	uint64_t m_sourceStamp = 0;
+	std::vector<CookedMip> m_mips;
+};
+
+
+/// <summary>
+/// Prepares images offline for fast loading: generates the mip chain and compresses it into blocks.
+/// </summary>
+/// <remarks>
+/// Mip levels and blocks are processed in bands of rows on multiple threads.
+/// The encoders fit the endpoints to the bounding box of the block's colors,
+/// BC7 uses mode 6 only. This is fast and the quality is close to that of slower encoders for most textures.
+/// </remarks>
+class TextureCooker {
+public:
+	struct Options {
+		eTextureCompression compression = eTextureCompression::BC1;
+		eMipFilter filter = eMipFilter::BOX;
+		/// <summary> Zero for the full chain down to 1x1. </summary>
+		int maxMipCount = 0;
+		/// <summary> Stored in the cooked texture, so a loader can tell that the source changed since it was cooked. </summary>
+		uint64_t sourceStamp = 0;
+	};
+
+	/// <summary> An uncompressed RGBA8 image, rows are tightly packed. </summary>
+	struct MipLevel {
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;
+	};
+
+public:
+	/// <summary> Cooks an 8 bit image of 1 to 4 channels into the cooked texture container. </summary>
+	/// <param name="bytesPerRow"> Pitch of the image rows, zero if they are tightly packed. </param>
+	/// <exception cref="std::invalid_argument"> If the size of a compressed texture is not a multiple of 4. </exception>
+	static std::vector<uint8_t> Cook(const uint8_t* pixels, uint32_t width, uint32_t height, int channelCount, size_t bytesPerRow, const Options& options);
+
+	/// <summary> Downsamples the RGBA8 image until 1x1 or the requested number of levels. The first level is the image itself. </summary>
+	static std::vector<MipLevel> GenerateMips(MipLevel image, eMipFilter filter, int maxMipCount = 0);
+
+	/// <summary> Compresses an RGBA8 image into rows of 4x4 blocks. Partial blocks at the edges repeat the last pixels. </summary>
+	static std::vector<uint8_t> Compress(const MipLevel& image, eTextureCompression compression);
+	/// <summary> Decodes blocks written by <see cref="Compress"/> back to RGBA8, used to validate the cooked textures. </summary>
+	/// <remarks> BC5 is decoded into the red and green channels. Only mode 6 of BC7 is supported. </remarks>
+	static MipLevel Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, eTextureCompression compression);
+
+	/// <summary> Size of a 4x4 block, or of a pixel for uncompressed textures. </summary>
+	static size_t GetBlockSizeInBytes(eTextureCompression compression);
+	/// <summary> Size of a row of pixels, or of a row of blocks for compressed textures. </summary>
+	static size_t GetRowPitch(eTextureCompression compression, uint32_t width);
+	static uint32_t GetRowCount(eTextureCompression compression, uint32_t height);
+
+	/// <summary> Images with fewer pixels are processed on the calling thread. </summary>
+	static constexpr size_t MIN_PIXELS_PER_THREAD = 64 * 1024;
+};
+
+
+} // namespace asset
+} // namespace inl
@@ -1,6 +1,7 @@
 #include "RingAllocationEngine.hpp"
 
 #include <cassert>
+#include <stdexcept>
 
 namespace exc {
 
@@ -65,13 +66,14 @@ size_t RingAllocationEngine::Allocate(size_t allocationSize) {
 		allocStartIndex = 0;
 	}
 
-	// check if first and last cell of allocation is free
-	// if they are, then the whole range of the allocation is free
+	// check if the whole range of the allocation is free
+	// checking only the first and last cell is not enough: after wrapping around
+	// to the beginning, the range may span over every live allocation
 	{
-		bool lastFree = m_container.At(allocStartIndex + allocationSize-1) == eCellState::FREE;
-		bool firstFree = m_container.At(allocStartIndex) == eCellState::FREE;
-		if (!lastFree || !firstFree) {
-			throw std::bad_alloc();
+		for (size_t i = 0; i < allocationSize; i++) {
+			if (m_container.At(allocStartIndex + i) != eCellState::FREE) {
+				throw std::bad_alloc();
+			}
 		}
 	}
 
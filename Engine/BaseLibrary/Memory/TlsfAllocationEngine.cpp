@@ -0,0 +1,245 @@
+#include "TlsfAllocationEngine.hpp"
+#include "../BitOperations.hpp"
+
+#include <cassert>
+#include <new>
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace exc {
+
+
+TlsfAllocationEngine::TlsfAllocationEngine(size_t poolSize)
+	: m_poolSize(poolSize)
+{
+	if (poolSize == 0 || poolSize >= INVALID) {
+		throw std::invalid_argument("Pool size must be non-zero and fit in 32 bits.");
+	}
+	Reset();
+}
+
+
+size_t TlsfAllocationEngine::Allocate(size_t allocationSize) {
+	if (allocationSize == 0) {
+		throw std::invalid_argument("Allocation size should be non-zero.");
+	}
+	if (allocationSize > m_freeSize) {
+		throw std::bad_alloc();
+	}
+
+	uint32_t size = (uint32_t)allocationSize;
+	int fl, sl;
+	if (!FindFreeList(size, fl, sl)) {
+		throw std::bad_alloc();
+	}
+
+	uint32_t blockIndex = m_freeLists[fl][sl];
+	assert(blockIndex != INVALID);
+	RemoveFree(blockIndex);
+
+	// Split off the remainder as a new free block.
+	if (m_blocks[blockIndex].size > size) {
+		uint32_t remainderIndex = NewBlock();
+		Block& block = m_blocks[blockIndex];
+		Block& remainder = m_blocks[remainderIndex];
+		remainder.offset = block.offset + size;
+		remainder.size = block.size - size;
+		remainder.prevPhysical = blockIndex;
+		remainder.nextPhysical = block.nextPhysical;
+		if (block.nextPhysical != INVALID) {
+			m_blocks[block.nextPhysical].prevPhysical = remainderIndex;
+		}
+		block.nextPhysical = remainderIndex;
+		block.size = size;
+		InsertFree(remainderIndex);
+	}
+
+	Block& block = m_blocks[blockIndex];
+	block.free = false;
+	m_freeSize -= block.size;
+	m_allocations.insert({ block.offset, blockIndex });
+
+	return block.offset;
+}
+
+
+void TlsfAllocationEngine::Deallocate(size_t index) {
+	auto it = m_allocations.find((uint32_t)index);
+	if (index >= m_poolSize || it == m_allocations.end()) {
+		throw std::invalid_argument("There is no allocation at given index.");
+	}
+	uint32_t blockIndex = it->second;
+	m_allocations.erase(it);
+
+	m_freeSize += m_blocks[blockIndex].size;
+
+	// Merge with the free neighbours.
+	uint32_t nextIndex = m_blocks[blockIndex].nextPhysical;
+	if (nextIndex != INVALID && m_blocks[nextIndex].free) {
+		RemoveFree(nextIndex);
+		Block& block = m_blocks[blockIndex];
+		const Block& next = m_blocks[nextIndex];
+		block.size += next.size;
+		block.nextPhysical = next.nextPhysical;
+		if (next.nextPhysical != INVALID) {
+			m_blocks[next.nextPhysical].prevPhysical = blockIndex;
+		}
+		DeleteBlock(nextIndex);
+	}
+	uint32_t prevIndex = m_blocks[blockIndex].prevPhysical;
+	if (prevIndex != INVALID && m_blocks[prevIndex].free) {
+		RemoveFree(prevIndex);
+		Block& prev = m_blocks[prevIndex];
+		const Block& block = m_blocks[blockIndex];
+		prev.size += block.size;
+		prev.nextPhysical = block.nextPhysical;
+		if (block.nextPhysical != INVALID) {
+			m_blocks[block.nextPhysical].prevPhysical = prevIndex;
+		}
+		DeleteBlock(blockIndex);
+		blockIndex = prevIndex;
+	}
+
+	InsertFree(blockIndex);
+}
+
+
+void TlsfAllocationEngine::Reset() {
+	m_blocks.clear();
+	m_unusedBlocks.clear();
+	m_allocations.clear();
+	m_flBitmap = 0;
+	std::fill(std::begin(m_slBitmaps), std::end(m_slBitmaps), 0);
+	for (auto& lists : m_freeLists) {
+		std::fill(std::begin(lists), std::end(lists), INVALID);
+	}
+	m_freeSize = 0;
+	m_freeBlockCount = 0;
+
+	uint32_t blockIndex = NewBlock();
+	Block& block = m_blocks[blockIndex];
+	block.offset = 0;
+	block.size = (uint32_t)m_poolSize;
+	block.prevPhysical = INVALID;
+	block.nextPhysical = INVALID;
+	InsertFree(blockIndex);
+	m_freeSize = m_poolSize;
+}
+
+
+size_t TlsfAllocationEngine::GetLargestFreeBlock() const {
+	if (m_flBitmap == 0) {
+		return 0;
+	}
+
+	// The largest block is in the highest non-empty list, but that list is not sorted.
+	int fl = 31 - CountLeadingZeros(m_flBitmap);
+	int sl = 31 - CountLeadingZeros(m_slBitmaps[fl]);
+	size_t largest = 0;
+	for (uint32_t blockIndex = m_freeLists[fl][sl]; blockIndex != INVALID; blockIndex = m_blocks[blockIndex].nextFree) {
+		largest = std::max<size_t>(largest, m_blocks[blockIndex].size);
+	}
+	return largest;
+}
+
+
+void TlsfAllocationEngine::Mapping(uint32_t size, int& fl, int& sl) {
+	int log2 = 31 - CountLeadingZeros(size);
+	if (log2 < SL_LOG2) {
+		fl = 0;
+		sl = (int)size;
+	}
+	else {
+		fl = log2 - SL_LOG2 + 1;
+		sl = (int)((size >> (log2 - SL_LOG2)) ^ (1u << SL_LOG2));
+	}
+}
+
+
+bool TlsfAllocationEngine::FindFreeList(uint32_t size, int& fl, int& sl) const {
+	// Round the size up to the next list boundary, so that any block in the found list fits.
+	int log2 = 31 - CountLeadingZeros(size);
+	if (log2 >= SL_LOG2) {
+		uint64_t rounded = uint64_t(size) + (uint64_t(1) << (log2 - SL_LOG2)) - 1;
+		if (rounded >= INVALID) {
+			return false;
+		}
+		size = (uint32_t)rounded;
+	}
+	Mapping(size, fl, sl);
+
+	uint32_t slMap = m_slBitmaps[fl] & (~0u << sl);
+	if (slMap == 0) {
+		uint32_t flMap = fl + 1 < 32 ? m_flBitmap & (~0u << (fl + 1)) : 0;
+		if (flMap == 0) {
+			return false;
+		}
+		fl = CountTrailingZeros(flMap);
+		slMap = m_slBitmaps[fl];
+	}
+	sl = CountTrailingZeros(slMap);
+	return true;
+}
+
+
+uint32_t TlsfAllocationEngine::NewBlock() {
+	if (!m_unusedBlocks.empty()) {
+		uint32_t blockIndex = m_unusedBlocks.back();
+		m_unusedBlocks.pop_back();
+		return blockIndex;
+	}
+	m_blocks.push_back({});
+	return (uint32_t)m_blocks.size() - 1;
+}
+
+
+void TlsfAllocationEngine::DeleteBlock(uint32_t blockIndex) {
+	m_unusedBlocks.push_back(blockIndex);
+}
+
+
+void TlsfAllocationEngine::InsertFree(uint32_t blockIndex) {
+	Block& block = m_blocks[blockIndex];
+	int fl, sl;
+	Mapping(block.size, fl, sl);
+
+	block.free = true;
+	block.prevFree = INVALID;
+	block.nextFree = m_freeLists[fl][sl];
+	if (block.nextFree != INVALID) {
+		m_blocks[block.nextFree].prevFree = blockIndex;
+	}
+	m_freeLists[fl][sl] = blockIndex;
+	m_flBitmap |= 1u << fl;
+	m_slBitmaps[fl] |= 1u << sl;
+	++m_freeBlockCount;
+}
+
+
+void TlsfAllocationEngine::RemoveFree(uint32_t blockIndex) {
+	Block& block = m_blocks[blockIndex];
+	int fl, sl;
+	Mapping(block.size, fl, sl);
+
+	if (block.prevFree != INVALID) {
+		m_blocks[block.prevFree].nextFree = block.nextFree;
+	}
+	else {
+		m_freeLists[fl][sl] = block.nextFree;
+	}
+	if (block.nextFree != INVALID) {
+		m_blocks[block.nextFree].prevFree = block.prevFree;
+	}
+	if (m_freeLists[fl][sl] == INVALID) {
+		m_slBitmaps[fl] &= ~(1u << sl);
+		if (m_slBitmaps[fl] == 0) {
+			m_flBitmap &= ~(1u << fl);
+		}
+	}
+	block.free = false;
+	--m_freeBlockCount;
+}
+
+
+} // namespace exc
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+
+namespace exc {
+
+
+/// <summary>
+/// Two-level segregated fit allocator for variable sized ranges.
+/// Allocation and deallocation are O(1).
+///
+/// This class will not allocate the actual objects, it only
+/// administrates the object positions and sizes.
+/// </summary>
+class TlsfAllocationEngine {
+	// How it works:
+	// Free blocks are sorted into lists by size. The first level divides sizes into powers of two,
+	// the second level divides each power of two into SL_COUNT linear ranges. Bitmaps tell which lists
+	// are non-empty, so the smallest list that surely fits a request is found by bit scans.
+	// Adjacent free blocks are merged on deallocation, so each block knows its physical neighbours.
+	static constexpr uint32_t INVALID = ~uint32_t(0);
+	static constexpr int SL_LOG2 = 4;
+	static constexpr int SL_COUNT = 1 << SL_LOG2;
+	static constexpr int FL_COUNT = 32 - SL_LOG2 + 1;
+
+	struct Block {
+		uint32_t offset;
+		uint32_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+public:
+	/// <summary>
+	/// Initialize an allocator of specified size.
+	/// </summary>
+	/// <param name="poolSize">The number of available slots in the pool.</param>
+	/// <exception cref="std::invalid_argument"> If pool size is zero or does not fit 32 bits. </exception>
+	TlsfAllocationEngine(size_t poolSize);
+
+	/// <summary> Allocates a contiguous range of slots. </summary>
+	/// <returns> The starting index of the allocated range. </returns>
+	/// <exception cref="std::bad_alloc"> Thrown if there is no free range large enough. </exception>
+	/// <exception cref="std::invalid_argument"> If allocation size is zero. </exception>
+	size_t Allocate(size_t allocationSize);
+
+	/// <summary> Deallocates the range starting at index. </summary>
+	/// <exception cref="std::invalid_argument"> Thrown if there is no allocation starting at index. </exception>
+	void Deallocate(size_t index);
+
+	/// <summary> Clears all allocations. </summary>
+	void Reset();
+
+	size_t Size() const { return m_poolSize; }
+	size_t GetFreeSize() const { return m_freeSize; }
+	/// <summary> Size of the largest range that can be allocated right now. </summary>
+	size_t GetLargestFreeBlock() const;
+	size_t GetFreeBlockCount() const { return m_freeBlockCount; }
+	size_t GetAllocationCount() const { return m_allocations.size(); }
+private:
+	static void Mapping(uint32_t size, int& fl, int& sl);
+	bool FindFreeList(uint32_t size, int& fl, int& sl) const;
+
+	uint32_t NewBlock();
+	void DeleteBlock(uint32_t blockIndex);
+	void InsertFree(uint32_t blockIndex);
+	void RemoveFree(uint32_t blockIndex);
+private:
+	size_t m_poolSize;
+	size_t m_freeSize;
+	size_t m_freeBlockCount;
+
+	std::vector<Block> m_blocks;
+	std::vector<uint32_t> m_unusedBlocks;
+	std::unordered_map<uint32_t, uint32_t> m_allocations; // offset -> block index
+
+	uint32_t m_flBitmap;
+	uint32_t m_slBitmaps[FL_COUNT];
+	uint32_t m_freeLists[FL_COUNT][SL_COUNT];
+};
+
+
+} // namespace exc
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace exc {
+
+
+/// <summary>
+/// Read-only view of a whole file's contents, paged in by the operating system on demand.
+/// </summary>
+/// <remarks>
+/// The file can't be replaced or deleted while it's mapped, close it first.
+/// </remarks>
+class MemoryMappedFile {
+public:
+	MemoryMappedFile() = default;
+	/// <exception cref="std::runtime_error"> If the file does not exist or can't be mapped. </exception>
+	explicit MemoryMappedFile(const std::string& path);
+	MemoryMappedFile(const MemoryMappedFile&) = delete;
+	MemoryMappedFile(MemoryMappedFile&& rhs);
+	MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+	MemoryMappedFile& operator=(MemoryMappedFile&& rhs);
+	~MemoryMappedFile();
+
+	void Close();
+
+	bool IsOpen() const { return m_isOpen; }
+	/// <summary> Null for empty files. </summary>
+	const uint8_t* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+private:
+	bool m_isOpen = false;
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	void* m_file = nullptr; // Native handles.
+	void* m_mapping = nullptr;
+};
+
+
+} // namespace exc
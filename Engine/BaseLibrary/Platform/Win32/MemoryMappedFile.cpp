@@ -0,0 +1,88 @@
+#include "../MemoryMappedFile.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <stdexcept>
+#include <utility>
+
+
+namespace exc {
+
+
+MemoryMappedFile::MemoryMappedFile(const std::string& path) {
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Could not open file for mapping.");
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Could not get size of mapped file.");
+	}
+
+	// Empty files can't be mapped, but they are valid nonetheless.
+	if (size.QuadPart > 0) {
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == NULL) {
+			CloseHandle(file);
+			throw std::runtime_error("Could not create file mapping.");
+		}
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Could not map view of file.");
+		}
+		m_mapping = mapping;
+		m_data = static_cast<const uint8_t*>(view);
+	}
+
+	m_file = file;
+	m_size = (size_t)size.QuadPart;
+	m_isOpen = true;
+}
+
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& rhs) {
+	*this = std::move(rhs);
+}
+
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& rhs) {
+	Close();
+	std::swap(m_isOpen, rhs.m_isOpen);
+	std::swap(m_data, rhs.m_data);
+	std::swap(m_size, rhs.m_size);
+	std::swap(m_file, rhs.m_file);
+	std::swap(m_mapping, rhs.m_mapping);
+	return *this;
+}
+
+
+MemoryMappedFile::~MemoryMappedFile() {
+	Close();
+}
+
+
+void MemoryMappedFile::Close() {
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != nullptr) {
+		CloseHandle(m_file);
+	}
+	m_isOpen = false;
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+
+
+} // namespace exc
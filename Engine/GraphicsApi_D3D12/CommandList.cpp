@@ -163,9 +163,11 @@ D3D12_TEXTURE_COPY_LOCATION CopyCommandList::CreateTextureCopyLocation(gxapi::IR
 			{
 				footprint.Depth = description.depth;
 				footprint.Format = native_cast(description.format);
-				footprint.Height = description.height;
-				footprint.Width = (UINT)description.width; // narrowing conversion!
-				size_t rowSize = size_t(GetFormatSizeInBytes(description.format)*description.width);
+				// Block compressed footprints cover whole blocks, even for mip levels smaller than a block.
+				unsigned blockSize = GetFormatBlockSize(description.format);
+				footprint.Height = (description.height + blockSize - 1) / blockSize * blockSize;
+				footprint.Width = (UINT)((description.width + blockSize - 1) / blockSize * blockSize); // narrowing conversion!
+				size_t rowSize = size_t(GetFormatRowSizeInBytes(description.format, description.width));
 				size_t alignement = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
 				footprint.RowPitch = static_cast<UINT>(rowSize + (alignement - rowSize % alignement) % alignement);
 			}
@@ -211,6 +213,22 @@ void ComputeCommandList::Dispatch(size_t numThreadGroupsX, size_t numThreadGroup
 }
 
 
+void ComputeCommandList::ExecuteIndirect(gxapi::ICommandSignature* commandSignature,
+										 unsigned maxCommandCount,
+										 gxapi::IResource* argumentBuffer,
+										 uint64_t argumentBufferOffset,
+										 gxapi::IResource* countBuffer,
+										 uint64_t countBufferOffset)
+{
+	m_native->ExecuteIndirect(native_cast(commandSignature),
+							  maxCommandCount,
+							  native_cast(argumentBuffer),
+							  argumentBufferOffset,
+							  native_cast(countBuffer),
+							  countBufferOffset);
+}
+
+
 // set graphics root signature stuff
 void ComputeCommandList::SetComputeRootConstant(unsigned parameterIndex, unsigned destOffset, uint32_t value) {
 	m_native->SetComputeRoot32BitConstant(parameterIndex, value, destOffset);
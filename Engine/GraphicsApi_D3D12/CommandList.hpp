@@ -102,6 +102,13 @@ public:
 	// draw
 	void Dispatch(size_t dimx, size_t dimy = 1, size_t dimz = 1) override;
 
+	void ExecuteIndirect(gxapi::ICommandSignature* commandSignature,
+						 unsigned maxCommandCount,
+						 gxapi::IResource* argumentBuffer,
+						 uint64_t argumentBufferOffset,
+						 gxapi::IResource* countBuffer = nullptr,
+						 uint64_t countBufferOffset = 0) override;
+
 	// set compute root signature stuff
 	void SetComputeRootConstant(unsigned parameterIndex, unsigned destOffset, uint32_t value) override;
 	void SetComputeRootConstants(unsigned parameterIndex, unsigned destOffset, unsigned numValues, const uint32_t* value) override;
@@ -4,6 +4,8 @@
 #include "CommandAllocator.hpp"
 #include "CommandList.hpp"
 #include "DescriptorHeap.hpp"
+#include "Heap.hpp"
+#include "CommandSignature.hpp"
 #include "NativeCast.hpp"
 #include "ExceptionExpansions.hpp"
 
@@ -12,6 +14,7 @@
 #include "d3dx12.h"
 
 #include <stdexcept>
+#include <cstddef>
 #include <cassert>
 #include <vector>
 #include <array>
@@ -109,6 +112,49 @@ gxapi::IResource* GraphicsApi::CreateCommittedResource(gxapi::HeapProperties hea
 }
 
 
+gxapi::IHeap* GraphicsApi::CreateHeap(gxapi::HeapDesc desc) {
+	ComPtr<ID3D12Heap> native;
+
+	D3D12_HEAP_DESC nativeDesc = native_cast(desc);
+	ThrowIfFailed(m_device->CreateHeap(&nativeDesc, IID_PPV_ARGS(&native)));
+
+	return new Heap{ native, desc };
+}
+
+
+gxapi::IResource* GraphicsApi::CreatePlacedResource(gxapi::IHeap* heap,
+													uint64_t heapOffset,
+													gxapi::ResourceDesc desc,
+													gxapi::eResourceState initialState,
+													gxapi::ClearValue* clearValue) {
+	ComPtr<ID3D12Resource> native;
+
+	D3D12_RESOURCE_DESC nativeResourceDesc = native_cast(desc);
+
+	D3D12_CLEAR_VALUE* pNativeClearValue = nullptr;
+	D3D12_CLEAR_VALUE nativeClearValue;
+	if (clearValue != nullptr) {
+		nativeClearValue = native_cast(*clearValue);
+		pNativeClearValue = &nativeClearValue;
+	}
+
+	ThrowIfFailed(m_device->CreatePlacedResource(native_cast(heap), heapOffset, &nativeResourceDesc, native_cast(initialState), pNativeClearValue, IID_PPV_ARGS(&native)));
+
+	return new Resource{ native };
+}
+
+
+gxapi::ResourceAllocationInfo GraphicsApi::GetResourceAllocationInfo(gxapi::ResourceDesc desc) {
+	D3D12_RESOURCE_DESC nativeDesc = native_cast(desc);
+	D3D12_RESOURCE_ALLOCATION_INFO nativeInfo = m_device->GetResourceAllocationInfo(0, 1, &nativeDesc);
+
+	gxapi::ResourceAllocationInfo result;
+	result.sizeInBytes = nativeInfo.SizeInBytes;
+	result.alignment = nativeInfo.Alignment;
+	return result;
+}
+
+
 gxapi::IRootSignature* GraphicsApi::CreateRootSignature(gxapi::RootSignatureDesc desc) {
 	ComPtr<ID3D12RootSignature> native;
 
@@ -247,8 +293,8 @@ gxapi::IPipelineState* GraphicsApi::CreateGraphicsPipelineState(const gxapi::Gra
 	nativeDesc.SampleDesc.Count = desc.multisampleCount;
 	nativeDesc.SampleDesc.Quality = desc.multisampleQuality;
 	nativeDesc.NodeMask = 0;
-	nativeDesc.CachedPSO.CachedBlobSizeInBytes = 0;
-	nativeDesc.CachedPSO.pCachedBlob = nullptr;
+	nativeDesc.CachedPSO.CachedBlobSizeInBytes = desc.cachedBlobSize;
+	nativeDesc.CachedPSO.pCachedBlob = desc.cachedBlob;
 	nativeDesc.Flags = desc.addDebugInfo ? D3D12_PIPELINE_STATE_FLAG_TOOL_DEBUG : D3D12_PIPELINE_STATE_FLAG_NONE;
 
 
@@ -260,8 +306,8 @@ gxapi::IPipelineState* GraphicsApi::CreateGraphicsPipelineState(const gxapi::Gra
 
 gxapi::IPipelineState* GraphicsApi::CreateComputePipelineState(const gxapi::ComputePipelineStateDesc& desc) {
 	D3D12_COMPUTE_PIPELINE_STATE_DESC nativeDesc;
-	nativeDesc.CachedPSO.CachedBlobSizeInBytes = 0;
-	nativeDesc.CachedPSO.pCachedBlob = nullptr;
+	nativeDesc.CachedPSO.CachedBlobSizeInBytes = desc.cachedBlobSize;
+	nativeDesc.CachedPSO.pCachedBlob = desc.cachedBlob;
 	nativeDesc.CS.pShaderBytecode = desc.cs.shaderByteCode;
 	nativeDesc.CS.BytecodeLength = desc.cs.sizeOfByteCode;
 	nativeDesc.Flags = desc.addDebugInfo ? D3D12_PIPELINE_STATE_FLAG_TOOL_DEBUG : D3D12_PIPELINE_STATE_FLAG_NONE;
@@ -285,6 +331,37 @@ gxapi::IDescriptorHeap* GraphicsApi::CreateDescriptorHeap(gxapi::DescriptorHeapD
 }
 
 
+// The engine writes argument buffers with the gxapi layouts, they must be the same as the native ones.
+static_assert(sizeof(gxapi::DrawArguments) == sizeof(D3D12_DRAW_ARGUMENTS));
+static_assert(sizeof(gxapi::DrawIndexedArguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+static_assert(sizeof(gxapi::DispatchArguments) == sizeof(D3D12_DISPATCH_ARGUMENTS));
+static_assert(sizeof(gxapi::VertexBufferViewArguments) == sizeof(D3D12_VERTEX_BUFFER_VIEW));
+static_assert(sizeof(gxapi::IndexBufferViewArguments) == sizeof(D3D12_INDEX_BUFFER_VIEW));
+static_assert(offsetof(gxapi::IndexBufferViewArguments, format) == offsetof(D3D12_INDEX_BUFFER_VIEW, Format));
+static_assert(int(gxapi::eFormat::R16_UINT) == DXGI_FORMAT_R16_UINT && int(gxapi::eFormat::R32_UINT) == DXGI_FORMAT_R32_UINT);
+
+
+gxapi::ICommandSignature* GraphicsApi::CreateCommandSignature(const gxapi::CommandSignatureDesc& desc, gxapi::IRootSignature* rootSignature) {
+	ComPtr<ID3D12CommandSignature> native;
+
+	std::vector<D3D12_INDIRECT_ARGUMENT_DESC> nativeArguments;
+	nativeArguments.reserve(desc.arguments.size());
+	for (const auto& argument : desc.arguments) {
+		nativeArguments.push_back(native_cast(argument));
+	}
+
+	D3D12_COMMAND_SIGNATURE_DESC nativeDesc;
+	nativeDesc.ByteStride = desc.byteStride;
+	nativeDesc.NumArgumentDescs = (UINT)nativeArguments.size();
+	nativeDesc.pArgumentDescs = nativeArguments.data();
+	nativeDesc.NodeMask = 0;
+
+	ThrowIfFailed(m_device->CreateCommandSignature(&nativeDesc, native_cast(rootSignature), IID_PPV_ARGS(&native)), "While creating command signature");
+
+	return new CommandSignature{ native };
+}
+
+
 void GraphicsApi::CreateConstantBufferView(gxapi::ConstantBufferViewDesc desc,
 										   gxapi::DescriptorHandle destination)
 {
@@ -486,7 +563,7 @@ gxapi::IFence * GraphicsApi::CreateFence(uint64_t initialValue)
 }
 
 
-void GraphicsApi::MakeResident(const std::vector<gxapi::IResource*>& objects) {
+void GraphicsApi::MakeResident(const std::vector<gxapi::IPageable*>& objects) {
 	if (objects.size() == 0) {
 		return;
 	}
@@ -502,7 +579,7 @@ void GraphicsApi::MakeResident(const std::vector<gxapi::IResource*>& objects) {
 }
 
 
-void GraphicsApi::Evict(const std::vector<gxapi::IResource*>& objects) {
+void GraphicsApi::Evict(const std::vector<gxapi::IPageable*>& objects) {
 	if (objects.size() == 0) {
 		return;
 	}
@@ -32,6 +32,13 @@ public:
 											  gxapi::ResourceDesc desc,
 											  gxapi::eResourceState initialState,
 											  gxapi::ClearValue* clearValue = nullptr) override;
+	gxapi::IHeap* CreateHeap(gxapi::HeapDesc desc) override;
+	gxapi::IResource* CreatePlacedResource(gxapi::IHeap* heap,
+										   uint64_t heapOffset,
+										   gxapi::ResourceDesc desc,
+										   gxapi::eResourceState initialState,
+										   gxapi::ClearValue* clearValue = nullptr) override;
+	gxapi::ResourceAllocationInfo GetResourceAllocationInfo(gxapi::ResourceDesc desc) override;
 
 
 	// Pipeline and binding
@@ -41,6 +48,7 @@ public:
 	gxapi::IPipelineState* CreateComputePipelineState(const gxapi::ComputePipelineStateDesc& desc) override;
 
 	gxapi::IDescriptorHeap* CreateDescriptorHeap(gxapi::DescriptorHeapDesc desc) override;
+	gxapi::ICommandSignature* CreateCommandSignature(const gxapi::CommandSignatureDesc& desc, gxapi::IRootSignature* rootSignature) override;
 
 
 	void CreateConstantBufferView(gxapi::ConstantBufferViewDesc desc,
@@ -99,8 +107,8 @@ public:
 	// Misc
 	gxapi::IFence* CreateFence(uint64_t initialValue) override;
 
-	void MakeResident(const std::vector<gxapi::IResource*>& objects) override;
-	void Evict(const std::vector<gxapi::IResource*>& objects) override;
+	void MakeResident(const std::vector<gxapi::IPageable*>& objects) override;
+	void Evict(const std::vector<gxapi::IPageable*>& objects) override;
 
 	// Debug
 	void ReportLiveObjects() const override;
@@ -411,6 +411,11 @@ gxapi::ShaderProgramBinary GxapiManager::CompileShaderFromFile(const std::string
 }
 
 
+std::string GxapiManager::GetShaderCompilerVersion() const {
+	return "d3dcompiler_" + std::to_string(D3D_COMPILER_VERSION);
+}
+
+
 const char* GxapiManager::GetTarget(gxapi::eShaderType type) {
 	switch (type)
 	{
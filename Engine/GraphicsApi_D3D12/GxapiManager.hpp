@@ -34,6 +34,8 @@ public:
 													 gxapi::eShaderCompileFlags flags,
 													 const std::vector<gxapi::ShaderMacroDefinition>& macros) override;
 
+	std::string GetShaderCompilerVersion() const override;
+
 protected:
 	static const char* GetTarget(gxapi::eShaderType type);
 	static gxapi::ShaderProgramBinary ConvertShaderOutput(HRESULT hr, ID3DBlob* code, ID3DBlob* error);
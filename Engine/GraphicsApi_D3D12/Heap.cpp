@@ -0,0 +1,24 @@
+#include "Heap.hpp"
+
+
+namespace inl {
+namespace gxapi_dx12 {
+
+
+Heap::Heap(ComPtr<ID3D12Heap>& native, gxapi::HeapDesc desc)
+	: m_native{ native }, m_desc(desc)
+{}
+
+
+gxapi::HeapDesc Heap::GetDesc() const {
+	return m_desc;
+}
+
+
+ID3D12Heap* Heap::GetNative() {
+	return m_native.Get();
+}
+
+
+} // namespace gxapi_dx12
+} // namespace inl
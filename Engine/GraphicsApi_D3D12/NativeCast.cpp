@@ -102,6 +102,15 @@ ID3D12RootSignature* native_cast(gxapi::IRootSignature* source) {
 }
 
 
+ID3D12CommandSignature* native_cast(gxapi::ICommandSignature* source) {
+	if (source == nullptr) {
+		return nullptr;
+	}
+
+	return static_cast<CommandSignature*>(source)->GetNative();
+}
+
+
 ID3D12DescriptorHeap* native_cast(gxapi::IDescriptorHeap* source) {
 	if (source == nullptr) {
 		return nullptr;
@@ -111,6 +120,27 @@ ID3D12DescriptorHeap* native_cast(gxapi::IDescriptorHeap* source) {
 }
 
 
+ID3D12Heap* native_cast(gxapi::IHeap* source) {
+	if (source == nullptr) {
+		return nullptr;
+	}
+
+	return static_cast<Heap*>(source)->GetNative();
+}
+
+
+ID3D12Pageable* native_cast(gxapi::IPageable* source) {
+	if (source == nullptr) {
+		return nullptr;
+	}
+
+	if (auto resource = dynamic_cast<gxapi::IResource*>(source)) {
+		return native_cast(resource);
+	}
+	return native_cast(dynamic_cast<gxapi::IHeap*>(source));
+}
+
+
 ID3D12Fence* native_cast(gxapi::IFence * source) {
 	if (source == nullptr) {
 		return nullptr;
@@ -605,6 +635,30 @@ DXGI_FORMAT native_cast(gxapi::eFormat source) {
 		return DXGI_FORMAT_R8_SINT;
 	case gxapi::eFormat::A8_UNORM:
 		return DXGI_FORMAT_A8_UNORM;
+	case gxapi::eFormat::BC1_TYPELESS:
+		return DXGI_FORMAT_BC1_TYPELESS;
+	case gxapi::eFormat::BC1_UNORM:
+		return DXGI_FORMAT_BC1_UNORM;
+	case gxapi::eFormat::BC1_UNORM_SRGB:
+		return DXGI_FORMAT_BC1_UNORM_SRGB;
+	case gxapi::eFormat::BC3_TYPELESS:
+		return DXGI_FORMAT_BC3_TYPELESS;
+	case gxapi::eFormat::BC3_UNORM:
+		return DXGI_FORMAT_BC3_UNORM;
+	case gxapi::eFormat::BC3_UNORM_SRGB:
+		return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case gxapi::eFormat::BC5_TYPELESS:
+		return DXGI_FORMAT_BC5_TYPELESS;
+	case gxapi::eFormat::BC5_UNORM:
+		return DXGI_FORMAT_BC5_UNORM;
+	case gxapi::eFormat::BC5_SNORM:
+		return DXGI_FORMAT_BC5_SNORM;
+	case gxapi::eFormat::BC7_TYPELESS:
+		return DXGI_FORMAT_BC7_TYPELESS;
+	case gxapi::eFormat::BC7_UNORM:
+		return DXGI_FORMAT_BC7_UNORM;
+	case gxapi::eFormat::BC7_UNORM_SRGB:
+		return DXGI_FORMAT_BC7_UNORM_SRGB;
 
 	default:
 		assert(false);
@@ -1024,6 +1078,33 @@ D3D12_RESOURCE_BARRIER_TYPE native_cast(gxapi::eResourceBarrierType source) {
 }
 
 
+D3D12_INDIRECT_ARGUMENT_TYPE native_cast(gxapi::eIndirectArgumentType source) {
+	switch (source) {
+		case gxapi::eIndirectArgumentType::DRAW:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+		case gxapi::eIndirectArgumentType::DRAW_INDEXED:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+		case gxapi::eIndirectArgumentType::DISPATCH:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+		case gxapi::eIndirectArgumentType::VERTEX_BUFFER_VIEW:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+		case gxapi::eIndirectArgumentType::INDEX_BUFFER_VIEW:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+		case gxapi::eIndirectArgumentType::CONSTANT:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+		case gxapi::eIndirectArgumentType::CONSTANT_BUFFER_VIEW:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+		case gxapi::eIndirectArgumentType::SHADER_RESOURCE_VIEW:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_SHADER_RESOURCE_VIEW;
+		case gxapi::eIndirectArgumentType::UNORDERED_ACCESS_VIEW:
+			return D3D12_INDIRECT_ARGUMENT_TYPE_UNORDERED_ACCESS_VIEW;
+		default:
+			assert(false);
+			return D3D12_INDIRECT_ARGUMENT_TYPE(0);
+	}
+}
+
+
 //---------------
 //FLAGS
 
@@ -1238,7 +1319,7 @@ D3D12_RESOURCE_DESC native_cast(gxapi::ResourceDesc source) {
 		result.SampleDesc.Count = 1;
 		result.SampleDesc.Quality = 0;
 		result.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-		result.Flags = D3D12_RESOURCE_FLAG_NONE; //TODO (?)
+		result.Flags = native_cast(source.bufferDesc.flags);
 	}
 	else if (source.type == gxapi::eResourceType::TEXTURE) {
 		const auto& tex = source.textureDesc;
@@ -1262,6 +1343,36 @@ D3D12_RESOURCE_DESC native_cast(gxapi::ResourceDesc source) {
 }
 
 
+D3D12_INDIRECT_ARGUMENT_DESC native_cast(gxapi::IndirectArgumentDesc source) {
+	D3D12_INDIRECT_ARGUMENT_DESC result = {};
+
+	result.Type = native_cast(source.type);
+	switch (source.type) {
+		case gxapi::eIndirectArgumentType::VERTEX_BUFFER_VIEW:
+			result.VertexBuffer.Slot = source.slot;
+			break;
+		case gxapi::eIndirectArgumentType::CONSTANT:
+			result.Constant.RootParameterIndex = source.slot;
+			result.Constant.DestOffsetIn32BitValues = source.destOffsetIn32BitValues;
+			result.Constant.Num32BitValuesToSet = source.num32BitValues;
+			break;
+		case gxapi::eIndirectArgumentType::CONSTANT_BUFFER_VIEW:
+			result.ConstantBufferView.RootParameterIndex = source.slot;
+			break;
+		case gxapi::eIndirectArgumentType::SHADER_RESOURCE_VIEW:
+			result.ShaderResourceView.RootParameterIndex = source.slot;
+			break;
+		case gxapi::eIndirectArgumentType::UNORDERED_ACCESS_VIEW:
+			result.UnorderedAccessView.RootParameterIndex = source.slot;
+			break;
+		default:
+			break;
+	}
+
+	return result;
+}
+
+
 D3D12_STATIC_SAMPLER_DESC native_cast(gxapi::StaticSamplerDesc source) {
 	D3D12_STATIC_SAMPLER_DESC result;
 
@@ -1306,6 +1417,18 @@ D3D12_DESCRIPTOR_HEAP_DESC native_cast(gxapi::DescriptorHeapDesc source) {
 }
 
 
+D3D12_HEAP_DESC native_cast(gxapi::HeapDesc source) {
+	D3D12_HEAP_DESC result;
+
+	result.SizeInBytes = source.sizeInBytes;
+	result.Properties = native_cast(source.properties);
+	result.Alignment = source.alignment;
+	result.Flags = native_cast(source.flags);
+
+	return result;
+}
+
+
 D3D12_BLEND_DESC native_cast(gxapi::BlendState source) {
 	D3D12_BLEND_DESC result;
 
@@ -1981,6 +2104,8 @@ D3D12_RESOURCE_BARRIER native_cast(gxapi::ResourceBarrier source) {
 			native.Flags = native_cast(source.transition.splitMode);
 			break;
 		case gxapi::eResourceBarrierType::ALIASING:
+			native.Aliasing.pResourceBefore = native_cast(source.aliasing.resourceBefore);
+			native.Aliasing.pResourceAfter = native_cast(source.aliasing.resourceAfter);
 			break;
 		case gxapi::eResourceBarrierType::UAV:
 			native.UAV.pResource = native_cast(source.uav.resource);
@@ -2153,6 +2278,30 @@ gxapi::eFormat native_cast(DXGI_FORMAT source) {
 		return gxapi::eFormat::R8_SINT;
 	case DXGI_FORMAT_A8_UNORM:
 		return gxapi::eFormat::A8_UNORM;
+	case DXGI_FORMAT_BC1_TYPELESS:
+		return gxapi::eFormat::BC1_TYPELESS;
+	case DXGI_FORMAT_BC1_UNORM:
+		return gxapi::eFormat::BC1_UNORM;
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return gxapi::eFormat::BC1_UNORM_SRGB;
+	case DXGI_FORMAT_BC3_TYPELESS:
+		return gxapi::eFormat::BC3_TYPELESS;
+	case DXGI_FORMAT_BC3_UNORM:
+		return gxapi::eFormat::BC3_UNORM;
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		return gxapi::eFormat::BC3_UNORM_SRGB;
+	case DXGI_FORMAT_BC5_TYPELESS:
+		return gxapi::eFormat::BC5_TYPELESS;
+	case DXGI_FORMAT_BC5_UNORM:
+		return gxapi::eFormat::BC5_UNORM;
+	case DXGI_FORMAT_BC5_SNORM:
+		return gxapi::eFormat::BC5_SNORM;
+	case DXGI_FORMAT_BC7_TYPELESS:
+		return gxapi::eFormat::BC7_TYPELESS;
+	case DXGI_FORMAT_BC7_UNORM:
+		return gxapi::eFormat::BC7_UNORM;
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return gxapi::eFormat::BC7_UNORM_SRGB;
 	default:
 		assert(false);
 		break;
@@ -2292,6 +2441,7 @@ gxapi::ResourceDesc native_cast(D3D12_RESOURCE_DESC source) {
 
 	if (result.type == gxapi::eResourceType::BUFFER) {
 		result.bufferDesc.sizeInBytes = source.Width;
+		result.bufferDesc.flags = native_cast(source.Flags);
 	}
 	else if (result.type == gxapi::eResourceType::TEXTURE) {
 		result.textureDesc = gxapi::TextureDesc{
@@ -5,7 +5,9 @@
 #include "CommandAllocator.hpp"
 #include "CommandQueue.hpp"
 #include "RootSignature.hpp"
+#include "CommandSignature.hpp"
 #include "DescriptorHeap.hpp"
+#include "Heap.hpp"
 #include "CommandList.hpp"
 #include "Fence.hpp"
 #include "../GraphicsApi_LL/Common.hpp"
@@ -48,8 +50,14 @@ ID3D12GraphicsCommandList* native_cast(gxapi::IGraphicsCommandList* source);
 
 ID3D12RootSignature* native_cast(gxapi::IRootSignature* source);
 
+ID3D12CommandSignature* native_cast(gxapi::ICommandSignature* source);
+
 ID3D12DescriptorHeap* native_cast(gxapi::IDescriptorHeap* source);
 
+ID3D12Heap* native_cast(gxapi::IHeap* source);
+
+ID3D12Pageable* native_cast(gxapi::IPageable* source);
+
 ID3D12Fence* native_cast(gxapi::IFence* source);
 
 ID3D12CommandQueue* native_cast(gxapi::ICommandQueue* source);
@@ -122,6 +130,8 @@ D3D12_RESOURCE_BARRIER_FLAGS native_cast(gxapi::eResourceBarrierSplit source);
 
 D3D12_RESOURCE_BARRIER_TYPE native_cast(gxapi::eResourceBarrierType source);
 
+D3D12_INDIRECT_ARGUMENT_TYPE native_cast(gxapi::eIndirectArgumentType source);
+
 //---------------
 //FLAGS
 D3D12_RESOURCE_FLAGS native_cast(gxapi::eResourceFlags source);
@@ -158,10 +168,14 @@ D3D12_RESOURCE_DESC native_cast(gxapi::ResourceDesc source);
 
 D3D12_STATIC_SAMPLER_DESC native_cast(gxapi::StaticSamplerDesc source);
 
+D3D12_INDIRECT_ARGUMENT_DESC native_cast(gxapi::IndirectArgumentDesc source);
+
 D3D12_COMMAND_QUEUE_DESC native_cast(gxapi::CommandQueueDesc source);
 
 D3D12_DESCRIPTOR_HEAP_DESC native_cast(gxapi::DescriptorHeapDesc source);
 
+D3D12_HEAP_DESC native_cast(gxapi::HeapDesc source);
+
 D3D12_BLEND_DESC native_cast(gxapi::BlendState source);
 
 D3D12_RENDER_TARGET_BLEND_DESC native_cast(gxapi::RenderTargetBlendState source);
@@ -1,4 +1,5 @@
 #include "PipelineState.hpp"
+#include "ExceptionExpansions.hpp"
 
 namespace inl {
 namespace gxapi_dx12 {
@@ -12,5 +13,14 @@ ID3D12PipelineState* PipelineState::GetNative() {
 }
 
 
+std::vector<uint8_t> PipelineState::GetCachedBlob() const {
+	ComPtr<ID3DBlob> blob;
+	ThrowIfFailed(m_native->GetCachedBlob(&blob), "While getting cached PSO blob");
+
+	const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+	return std::vector<uint8_t>(data, data + blob->GetBufferSize());
+}
+
+
 } // namespace gxapi_dx12
 } // namespace inl
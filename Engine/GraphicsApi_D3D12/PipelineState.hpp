@@ -18,6 +18,8 @@ public:
 	PipelineState(ComPtr<ID3D12PipelineState> native);
 	ID3D12PipelineState* GetNative();
 
+	std::vector<uint8_t> GetCachedBlob() const override;
+
 private:
 	ComPtr<ID3D12PipelineState> m_native;
 };
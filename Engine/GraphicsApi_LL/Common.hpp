@@ -160,21 +160,21 @@ enum class eFormat {
 	//R8G8_B8G8_UNORM = 68,
 	//G8R8_G8B8_UNORM = 69,
 
-	//BC1_TYPELESS = 70,
-	//BC1_UNORM = 71,
-	//BC1_UNORM_SRGB = 72,
+	BC1_TYPELESS = 70,
+	BC1_UNORM = 71,
+	BC1_UNORM_SRGB = 72,
 	//BC2_TYPELESS = 73,
 	//BC2_UNORM = 74,
 	//BC2_UNORM_SRGB = 75,
-	//BC3_TYPELESS = 76,
-	//BC3_UNORM = 77,
-	//BC3_UNORM_SRGB = 78,
+	BC3_TYPELESS = 76,
+	BC3_UNORM = 77,
+	BC3_UNORM_SRGB = 78,
 	//BC4_TYPELESS = 79,
 	//BC4_UNORM = 80,
 	//BC4_SNORM = 81,
-	//BC5_TYPELESS = 82,
-	//BC5_UNORM = 83,
-	//BC5_SNORM = 84,
+	BC5_TYPELESS = 82,
+	BC5_UNORM = 83,
+	BC5_SNORM = 84,
 
 	//B5G6R5_UNORM = 85,
 	//B5G5R5A1_UNORM = 86,
@@ -188,9 +188,9 @@ enum class eFormat {
 	//BC6H_TYPELESS = 94,
 	//BC6H_UF16 = 95,
 	//BC6H_SF16 = 96,
-	//BC7_TYPELESS = 97,
-	//BC7_UNORM = 98,
-	//BC7_UNORM_SRGB = 99,
+	BC7_TYPELESS = 97,
+	BC7_UNORM = 98,
+	BC7_UNORM_SRGB = 99,
 	//AYUV = 100,
 	//Y410 = 101,
 	//Y416 = 102,
@@ -507,6 +507,18 @@ enum class eResourceBarrierType {
 	UAV,
 };
 
+enum class eIndirectArgumentType {
+	DRAW,
+	DRAW_INDEXED,
+	DISPATCH,
+	VERTEX_BUFFER_VIEW,
+	INDEX_BUFFER_VIEW,
+	CONSTANT,
+	CONSTANT_BUFFER_VIEW,
+	SHADER_RESOURCE_VIEW,
+	UNORDERED_ACCESS_VIEW,
+};
+
 //------------------------------------------------------------------------------
 // Bitflag enumerations
 //------------------------------------------------------------------------------
@@ -716,6 +728,7 @@ struct BufferDesc {
 	BufferDesc() = default;
 
 	uint64_t sizeInBytes;
+	eResourceFlags flags = eResourceFlags::NONE;
 };
 
 struct TextureDesc {
@@ -746,7 +759,7 @@ struct ResourceDesc {
 	BufferDesc bufferDesc;
 	//};
 
-	static inline ResourceDesc Buffer(uint64_t sizeInBytes);
+	static inline ResourceDesc Buffer(uint64_t sizeInBytes, eResourceFlags flags = eResourceFlags::NONE);
 	static inline ResourceDesc Texture1D(uint64_t width, eFormat format, eResourceFlags flags = eResourceFlags::NONE,
 		uint16_t mipLevels = 1, uint32_t multisampleCount = 1, uint32_t multisampleQuality = 0,
 		uint64_t alignment = 0, eTextureLayout layout = eTextureLayout::UNKNOWN);
@@ -840,6 +853,23 @@ struct CommandListDesc {
 };
 
 
+struct HeapDesc {
+	HeapDesc() = default;
+	HeapDesc(uint64_t sizeInBytes, HeapProperties properties, eHeapFlags flags, uint64_t alignment = 0)
+		: sizeInBytes(sizeInBytes), properties(properties), alignment(alignment), flags(flags) {}
+	uint64_t sizeInBytes;
+	HeapProperties properties;
+	uint64_t alignment; // 0 means the default 64KiB
+	eHeapFlags flags;
+};
+
+
+struct ResourceAllocationInfo {
+	uint64_t sizeInBytes;
+	uint64_t alignment;
+};
+
+
 struct DescriptorHeapDesc {
 	DescriptorHeapDesc() = default;
 	DescriptorHeapDesc(eDescriptorHeapType type, size_t numDescriptors, bool isShaderVisible)
@@ -1087,6 +1117,10 @@ struct GraphicsPipelineStateDesc {
 	unsigned multisampleQuality;
 
 	bool addDebugInfo;
+
+	// From IPipelineState::GetCachedBlob of an equal pipeline state, creation fails if the driver doesn't accept it.
+	const void* cachedBlob = nullptr;
+	size_t cachedBlobSize = 0;
 };
 
 struct ComputePipelineStateDesc {
@@ -1099,6 +1133,10 @@ struct ComputePipelineStateDesc {
 	IRootSignature* rootSignature;
 	ShaderByteCodeDesc cs;
 	bool addDebugInfo;
+
+	// From IPipelineState::GetCachedBlob of an equal pipeline state, creation fails if the driver doesn't accept it.
+	const void* cachedBlob = nullptr;
+	size_t cachedBlobSize = 0;
 };
 
 struct DescriptorRange {
@@ -1324,6 +1362,55 @@ struct RootSignatureDesc {
 };
 
 
+// indirect execution
+
+struct IndirectArgumentDesc {
+	eIndirectArgumentType type;
+	unsigned slot = 0; // Vertex buffer slot, or root parameter index for constants and views.
+	unsigned destOffsetIn32BitValues = 0; // Constants only.
+	unsigned num32BitValues = 0; // Constants only.
+};
+
+struct CommandSignatureDesc {
+	unsigned byteStride; // Size of one command in the argument buffer, at least the size of its arguments.
+	std::vector<IndirectArgumentDesc> arguments; // In the order they follow each other in a command.
+};
+
+// Layouts of the arguments in argument buffers, written by the CPU or by shaders.
+struct DrawArguments {
+	uint32_t vertexCountPerInstance;
+	uint32_t instanceCount;
+	uint32_t startVertexLocation;
+	uint32_t startInstanceLocation;
+};
+
+struct DrawIndexedArguments {
+	uint32_t indexCountPerInstance;
+	uint32_t instanceCount;
+	uint32_t startIndexLocation;
+	int32_t baseVertexLocation;
+	uint32_t startInstanceLocation;
+};
+
+struct DispatchArguments {
+	uint32_t threadGroupCountX;
+	uint32_t threadGroupCountY;
+	uint32_t threadGroupCountZ;
+};
+
+struct VertexBufferViewArguments {
+	uint64_t gpuVirtualAddress;
+	uint32_t sizeInBytes;
+	uint32_t strideInBytes;
+};
+
+struct IndexBufferViewArguments {
+	uint64_t gpuVirtualAddress;
+	uint32_t sizeInBytes;
+	eFormat format; // R16_UINT or R32_UINT.
+};
+
+
 
 // buffer views
 
@@ -1584,11 +1671,20 @@ struct UavBarrier : public ResourceBarrierTag {
 	IResource* resource;
 };
 
+/// <summary> Makes a placed resource usable after another one that shares its memory.
+///		Null resources mean any placed resource. </summary>
+struct AliasingBarrier : public ResourceBarrierTag {
+	AliasingBarrier(IResource* resourceBefore = nullptr, IResource* resourceAfter = nullptr) : resourceBefore(resourceBefore), resourceAfter(resourceAfter) {}
+	IResource* resourceBefore;
+	IResource* resourceAfter;
+};
+
 struct ResourceBarrier {
 	eResourceBarrierType type;
 	union {
 		TransitionBarrier transition;
 		UavBarrier uav;
+		AliasingBarrier aliasing;
 	};
 	ResourceBarrier() {}
 	ResourceBarrier(const ResourceBarrier& rhs) {
@@ -1602,6 +1698,10 @@ struct ResourceBarrier {
 		type = eResourceBarrierType::UAV;
 		uav = rhs;
 	}
+	ResourceBarrier(const AliasingBarrier& rhs) {
+		type = eResourceBarrierType::ALIASING;
+		aliasing = rhs;
+	}
 
 	ResourceBarrier& operator=(const ResourceBarrier& rhs) {
 		memcpy(this, &rhs, sizeof(*this));
@@ -1618,6 +1718,11 @@ struct ResourceBarrier {
 		uav = rhs;
 		return *this;
 	}
+	ResourceBarrier& operator=(const AliasingBarrier& rhs) {
+		type = eResourceBarrierType::ALIASING;
+		aliasing = rhs;
+		return *this;
+	}
 };
 
 
@@ -1625,10 +1730,11 @@ struct ResourceBarrier {
 // User helper functions
 //------------------------------------------------------------------------------
 
-inline ResourceDesc ResourceDesc::Buffer(uint64_t sizeInBytes) {
+inline ResourceDesc ResourceDesc::Buffer(uint64_t sizeInBytes, eResourceFlags flags) {
 	ResourceDesc desc;
 	desc.type = eResourceType::BUFFER;
 	desc.bufferDesc.sizeInBytes = sizeInBytes;
+	desc.bufferDesc.flags = flags;
 	return desc;
 }
 
@@ -1999,6 +2105,58 @@ inline unsigned GetFormatSizeInBytes(eFormat format) {
 }
 
 
+/// <summary> Block compressed formats are stored in blocks of 4x4 pixels, the others pixel by pixel. </summary>
+inline unsigned GetFormatBlockSize(eFormat format) {
+	switch (format) {
+		case eFormat::BC1_TYPELESS:
+		case eFormat::BC1_UNORM:
+		case eFormat::BC1_UNORM_SRGB:
+		case eFormat::BC3_TYPELESS:
+		case eFormat::BC3_UNORM:
+		case eFormat::BC3_UNORM_SRGB:
+		case eFormat::BC5_TYPELESS:
+		case eFormat::BC5_UNORM:
+		case eFormat::BC5_SNORM:
+		case eFormat::BC7_TYPELESS:
+		case eFormat::BC7_UNORM:
+		case eFormat::BC7_UNORM_SRGB:
+			return 4;
+		default:
+			return 1;
+	}
+}
+
+
+/// <summary> Size of a 4x4 block for block compressed formats, size of a pixel for others. </summary>
+inline unsigned GetFormatBlockSizeInBytes(eFormat format) {
+	switch (format) {
+		case eFormat::BC1_TYPELESS:
+		case eFormat::BC1_UNORM:
+		case eFormat::BC1_UNORM_SRGB:
+			return 8;
+		case eFormat::BC3_TYPELESS:
+		case eFormat::BC3_UNORM:
+		case eFormat::BC3_UNORM_SRGB:
+		case eFormat::BC5_TYPELESS:
+		case eFormat::BC5_UNORM:
+		case eFormat::BC5_SNORM:
+		case eFormat::BC7_TYPELESS:
+		case eFormat::BC7_UNORM:
+		case eFormat::BC7_UNORM_SRGB:
+			return 16;
+		default:
+			return GetFormatSizeInBytes(format);
+	}
+}
+
+
+/// <summary> Size of a row of pixels, or of a row of blocks for block compressed formats. </summary>
+inline uint64_t GetFormatRowSizeInBytes(eFormat format, uint64_t width) {
+	unsigned blockSize = GetFormatBlockSize(format);
+	return (width + blockSize - 1) / blockSize * GetFormatBlockSizeInBytes(format);
+}
+
+
 } // namespace gxapi
 } // namespace inl
 
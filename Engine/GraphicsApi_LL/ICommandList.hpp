@@ -8,6 +8,7 @@ namespace inl {
 namespace gxapi {
 
 class IDescriptorHeap;
+class ICommandSignature;
 
 class ICommandList {
 public:
@@ -83,6 +84,16 @@ public:
 	// draw
 	virtual void Dispatch(size_t dimx, size_t dimy = 1, size_t dimz = 1) = 0;
 
+	/// <summary> Executes commands whose arguments are read from a buffer on the GPU. </summary>
+	/// <param name="countBuffer"> If not null, the number of commands is the smaller of the
+	///		uint32 at the offset in this buffer and maxCommandCount. </param>
+	virtual void ExecuteIndirect(ICommandSignature* commandSignature,
+								 unsigned maxCommandCount,
+								 IResource* argumentBuffer,
+								 uint64_t argumentBufferOffset,
+								 IResource* countBuffer = nullptr,
+								 uint64_t countBufferOffset = 0) = 0;
+
 	// set compute root signature stuff
 	virtual void SetComputeRootConstant(unsigned parameterIndex, unsigned destOffset, uint32_t value) = 0;
 	virtual void SetComputeRootConstants(unsigned parameterIndex, unsigned destOffset, unsigned numValues, const uint32_t* value) = 0;
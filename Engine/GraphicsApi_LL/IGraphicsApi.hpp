@@ -13,10 +13,13 @@ class ICommandAllocator;
 
 class IFence;
 
+class IPageable;
 class IResource;
+class IHeap;
 
 class IRootSignature;
 class IPipelineState;
+class ICommandSignature;
 class IDescriptorHeap;
 
 
@@ -38,12 +41,21 @@ public:
 											   ResourceDesc desc,
 											   eResourceState initialState,
 											   ClearValue* clearValue = nullptr) = 0;
+	virtual IHeap* CreateHeap(HeapDesc desc) = 0;
+	virtual IResource* CreatePlacedResource(IHeap* heap,
+											uint64_t heapOffset,
+											ResourceDesc desc,
+											eResourceState initialState,
+											ClearValue* clearValue = nullptr) = 0;
+	virtual ResourceAllocationInfo GetResourceAllocationInfo(ResourceDesc desc) = 0;
 
 	// Pipeline and binding
 	virtual IRootSignature* CreateRootSignature(RootSignatureDesc desc) = 0;
 	virtual IPipelineState* CreateGraphicsPipelineState(const GraphicsPipelineStateDesc& desc) = 0;
 	virtual gxapi::IPipelineState* CreateComputePipelineState(const gxapi::ComputePipelineStateDesc& desc) = 0;
 	virtual IDescriptorHeap* CreateDescriptorHeap(DescriptorHeapDesc) = 0;
+	/// <summary> The root signature may only be null if the commands don't change root arguments. </summary>
+	virtual ICommandSignature* CreateCommandSignature(const CommandSignatureDesc& desc, IRootSignature* rootSignature) = 0;
 
 	// Views
 	virtual void CreateConstantBufferView(ConstantBufferViewDesc desc,
@@ -104,8 +116,8 @@ public:
 	// Misc
 	virtual IFence* CreateFence(uint64_t initialValue) = 0;
 
-	virtual void MakeResident(const std::vector<gxapi::IResource*>& objects) = 0;
-	virtual void Evict(const std::vector<gxapi::IResource*>& objects) = 0;
+	virtual void MakeResident(const std::vector<gxapi::IPageable*>& objects) = 0;
+	virtual void Evict(const std::vector<gxapi::IPageable*>& objects) = 0;
 
 	// Debug
 	virtual void ReportLiveObjects() const = 0;
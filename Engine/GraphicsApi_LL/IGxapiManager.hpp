@@ -51,6 +51,9 @@ public:
 													  gxapi::eShaderType type,
 													  eShaderCompileFlags flags,
 													  const std::vector<ShaderMacroDefinition>& macros) = 0;
+
+	// Identifies the shader compiler, binaries are only compatible between the same versions.
+	virtual std::string GetShaderCompilerVersion() const = 0;
 };
 
 
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Common.hpp"
+#include "IPageable.hpp"
+
+
+namespace inl {
+namespace gxapi {
+
+
+/// <summary>
+/// A block of GPU memory that placed resources can be created in.
+/// </summary>
+class IHeap : public IPageable {
+public:
+	virtual ~IHeap() = default;
+
+	virtual HeapDesc GetDesc() const = 0;
+};
+
+
+} // namespace gxapi
+} // namespace inl
@@ -0,0 +1,19 @@
+#pragma once
+
+
+namespace inl {
+namespace gxapi {
+
+
+/// <summary>
+/// An object the GPU can page in and out of its memory, a resource or a heap.
+/// Placed resources are paged with their heap, only the heap can be made resident or evicted.
+/// </summary>
+class IPageable {
+public:
+	virtual ~IPageable() = default;
+};
+
+
+} // namespace gxapi
+} // namespace inl
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 namespace inl {
 namespace gxapi {
 
@@ -7,6 +10,8 @@ class IPipelineState {
 public:
 	virtual ~IPipelineState() = default;
 
+	/// <summary> The driver's compiled form of the pipeline state, pass it in the desc to create it faster next time. </summary>
+	virtual std::vector<uint8_t> GetCachedBlob() const = 0;
 };
 
 }
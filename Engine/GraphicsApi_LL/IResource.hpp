@@ -1,11 +1,12 @@
 #pragma once
 
 #include "Common.hpp"
+#include "IPageable.hpp"
 
 namespace inl {
 namespace gxapi {
 
-class IResource {
+class IResource : public IPageable {
 public:
 	virtual ~IResource() = default;
 
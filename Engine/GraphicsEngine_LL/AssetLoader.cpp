@@ -0,0 +1,220 @@
+#include "AssetLoader.hpp"
+
+#include <BaseLibrary/ThreadName.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+
+namespace inl {
+namespace gxeng {
+
+
+AssetLoader::AssetLoader(unsigned workerCount) {
+	if (workerCount == 0) {
+		// Leave a core for the thread that renders.
+		workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	for (unsigned i = 0; i < workerCount; ++i) {
+		m_workers.push_back(std::thread(&AssetLoader::WorkerThreadFunc, this));
+	}
+}
+
+
+AssetLoader::~AssetLoader() {
+	{
+		std::lock_guard<std::mutex> lkg(m_mutex);
+		m_runThreads = false;
+		m_taskCv.notify_all();
+	}
+	// Stages that are running can't be interrupted. They finish and queue the next stage of their request.
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+
+	// Nothing is going to run the remaining stages, handles that outlive the loader see their loads cancelled.
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	while (!m_tasks.empty()) {
+		CancelRequest(*m_tasks.top().request);
+		m_tasks.pop();
+	}
+	for (auto& request : m_decoded) {
+		CancelRequest(*request);
+	}
+	for (auto& request : m_uploading) {
+		CancelRequest(*request);
+	}
+	m_inFlightCount = 0;
+	m_decoded.clear();
+	m_uploading.clear();
+}
+
+
+void AssetLoader::Update() {
+	std::vector<std::shared_ptr<Request>> decoded;
+	{
+		std::lock_guard<std::mutex> lkg(m_mutex);
+		decoded.swap(m_decoded);
+	}
+	std::sort(decoded.begin(), decoded.end(), [](const std::shared_ptr<Request>& lhs, const std::shared_ptr<Request>& rhs) {
+		return lhs->priority != rhs->priority ? lhs->priority > rhs->priority : lhs->sequence < rhs->sequence;
+	});
+
+	std::vector<std::shared_ptr<Request>> uploading;
+	for (auto& request : decoded) {
+		if (request->state.load() != eLoadState::DECODED) {
+			continue; // Cancelled.
+		}
+		try {
+			request->upload();
+		}
+		catch (...) {
+			request->error = std::current_exception();
+			request->state = eLoadState::FAILED;
+			continue;
+		}
+		eLoadState expected = eLoadState::DECODED;
+		if (request->state.compare_exchange_strong(expected, eLoadState::UPLOADING)) {
+			uploading.push_back(std::move(request));
+		}
+	}
+
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	m_uploading.insert(m_uploading.end(), uploading.begin(), uploading.end());
+
+	auto finished = std::remove_if(m_uploading.begin(), m_uploading.end(), [](const std::shared_ptr<Request>& request) {
+		if (request->state.load() != eLoadState::UPLOADING) {
+			return true; // Cancelled.
+		}
+		if (!request->isUploaded()) {
+			return false;
+		}
+		eLoadState expected = eLoadState::UPLOADING;
+		request->state.compare_exchange_strong(expected, eLoadState::READY);
+		return true;
+	});
+	m_uploading.erase(finished, m_uploading.end());
+}
+
+
+void AssetLoader::Flush() {
+	while (true) {
+		Update();
+
+		std::unique_lock<std::mutex> lk(m_mutex);
+		if (m_inFlightCount == 0 && m_decoded.empty()) {
+			break;
+		}
+		m_decodedCv.wait(lk, [this] { return m_inFlightCount == 0 || !m_decoded.empty(); });
+	}
+}
+
+
+size_t AssetLoader::GetPendingCount() const {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	return m_inFlightCount + m_decoded.size() + m_uploading.size();
+}
+
+
+bool AssetLoader::Task::operator<(const Task& rhs) const {
+	if (request->priority != rhs.request->priority) {
+		return request->priority < rhs.request->priority;
+	}
+	if (stage != rhs.stage) {
+		return stage < rhs.stage;
+	}
+	return request->sequence > rhs.request->sequence;
+}
+
+
+void AssetLoader::Enqueue(std::shared_ptr<Request> request) {
+	std::unique_lock<std::mutex> lk(m_mutex);
+	request->sequence = m_nextSequence++;
+	++m_inFlightCount;
+	PushTask({ std::move(request), 0 }, lk);
+}
+
+
+void AssetLoader::PushTask(Task task, std::unique_lock<std::mutex>& lock) {
+	assert(lock.owns_lock());
+	m_tasks.push(std::move(task));
+	m_taskCv.notify_one();
+}
+
+
+void AssetLoader::WorkerThreadFunc() {
+	SetCurrentThreadName("Asset Loader Thread");
+
+	std::unique_lock<std::mutex> lk(m_mutex);
+	while (true) {
+		m_taskCv.wait(lk, [this] { return !m_runThreads || !m_tasks.empty(); });
+		if (!m_runThreads) {
+			break;
+		}
+
+		Task task = m_tasks.top();
+		m_tasks.pop();
+		lk.unlock();
+
+		Request& request = *task.request;
+		bool isDone;
+		if (task.stage == 0) {
+			isDone = !RunStage(request, eLoadState::QUEUED, eLoadState::READING, request.read, eLoadState::DECODING);
+		}
+		else {
+			isDone = !RunStage(request, eLoadState::DECODING, eLoadState::DECODING, request.decode, eLoadState::DECODED);
+		}
+
+		lk.lock();
+		if (isDone) {
+			// Failed or cancelled.
+			--m_inFlightCount;
+			m_decodedCv.notify_all();
+		}
+		else if (task.stage == 0) {
+			PushTask({ std::move(task.request), 1 }, lk);
+		}
+		else {
+			--m_inFlightCount;
+			m_decoded.push_back(std::move(task.request));
+			m_decodedCv.notify_all();
+		}
+	}
+}
+
+
+void AssetLoader::CancelRequest(Request& request) {
+	eLoadState state = request.state.load();
+	while (state != eLoadState::READY && state != eLoadState::FAILED && state != eLoadState::CANCELLED) {
+		if (request.state.compare_exchange_weak(state, eLoadState::CANCELLED)) {
+			break;
+		}
+	}
+}
+
+
+bool AssetLoader::RunStage(Request& request, eLoadState waiting, eLoadState running, const std::function<void()>& stage, eLoadState next) {
+	// The request may be cancelled at any time, the state only moves forward if it was not.
+	eLoadState expected = waiting;
+	if (!request.state.compare_exchange_strong(expected, running)) {
+		return false;
+	}
+
+	try {
+		stage();
+	}
+	catch (...) {
+		request.error = std::current_exception();
+		expected = running;
+		request.state.compare_exchange_strong(expected, eLoadState::FAILED);
+		return false;
+	}
+
+	expected = running;
+	return request.state.compare_exchange_strong(expected, next);
+}
+
+
+} // namespace gxeng
+} // namespace inl
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace inl {
+namespace gxeng {
+
+
+enum class eLoadState {
+	QUEUED,
+	READING,
+	DECODING,
+	/// <summary> Decoded, waiting for <see cref="AssetLoader::Update"/> to create the resources. </summary>
+	DECODED,
+	/// <summary> Resources created, the GPU upload has not finished yet. </summary>
+	UPLOADING,
+	READY,
+	FAILED,
+	CANCELLED,
+};
+
+
+/// <summary>
+/// Loads assets in the background. Each load goes through three stages: reading the file,
+/// decoding it, and creating the GPU resources and queuing their upload.
+/// </summary>
+/// <remarks>
+/// Reading and decoding run on worker threads. A worker picks the highest priority stage
+/// of any request, so the reads of some assets overlap the decodes of others.
+/// Within a priority, stages of requests that are further along come first.
+/// Creating resources is not thread-safe in the engine, so the upload stage runs on the thread
+/// that calls <see cref="Update"/>, usually once per frame.
+/// A load is ready when the uploads of its resources have passed on the GPU.
+/// </remarks>
+class AssetLoader {
+	struct Request {
+		std::atomic<eLoadState> state{ eLoadState::QUEUED };
+		int priority = 0;
+		uint64_t sequence = 0;
+
+		// Each stage stores its result for the next one.
+		std::function<void()> read;
+		std::function<void()> decode;
+		std::function<void()> upload;
+		std::function<bool()> isUploaded;
+
+		std::shared_ptr<void> asset;
+		std::exception_ptr error;
+	};
+
+public:
+	/// <summary> Refers to an asset while it's loading, and keeps it alive after that. </summary>
+	template <class AssetT>
+	class Handle {
+		friend class AssetLoader;
+	public:
+		Handle() = default;
+
+		eLoadState GetState() const { return m_request ? m_request->state.load() : eLoadState::CANCELLED; }
+		bool IsReady() const { return GetState() == eLoadState::READY; }
+		/// <summary> The asset once its resources are created, null before that. It may still be uploading. </summary>
+		AssetT* Get() const;
+		/// <summary> Rethrows the exception of a failed load. </summary>
+		void RethrowError() const;
+
+		/// <summary> Stops the load if the asset is not uploaded yet. Stages that are running finish, but their results are dropped. </summary>
+		void Cancel();
+	private:
+		explicit Handle(std::shared_ptr<Request> request) : m_request(std::move(request)) {}
+		std::shared_ptr<Request> m_request;
+	};
+
+public:
+	/// <param name="workerCount"> Number of worker threads. Zero picks one less than the number of cores. </param>
+	AssetLoader(unsigned workerCount = 0);
+	/// <summary> Waits for the running stages, then cancels every request that is not ready or failed. </summary>
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	/// <summary> Starts loading an asset. </summary>
+	/// <param name="priority"> Higher priorities are processed first. </param>
+	/// <param name="read"> Reads the file on a worker thread: <c>FileT read()</c>. </param>
+	/// <param name="decode"> Decodes it on a worker thread: <c>DataT decode(FileT&amp;&amp;)</c>. </param>
+	/// <param name="upload"> Creates the resources on the thread that calls <see cref="Update"/>:
+	///		<c>std::unique_ptr&lt;AssetT&gt; upload(DataT&amp;&amp;)</c>. Assets that have a HasPendingUploads method
+	///		become ready when it returns false, others right away. </param>
+	/// <remarks> This method is thread-safe. </remarks>
+	template <class ReadFunc, class DecodeFunc, class UploadFunc>
+	auto Load(int priority, ReadFunc read, DecodeFunc decode, UploadFunc upload);
+
+	/// <summary> Runs the upload stage of decoded requests, and finds the ones whose upload has finished. </summary>
+	void Update();
+	/// <summary> Calls <see cref="Update"/> until every request so far has passed its upload stage.
+	///		The uploads themselves finish as the engine renders frames. </summary>
+	void Flush();
+
+	/// <summary> Number of requests that are not ready, failed or cancelled yet. </summary>
+	size_t GetPendingCount() const;
+	unsigned GetWorkerCount() const { return (unsigned)m_workers.size(); }
+private:
+	struct Task {
+		std::shared_ptr<Request> request;
+		int stage; // 0: read, 1: decode.
+
+		bool operator<(const Task& rhs) const; // Lower priority tasks compare less.
+	};
+
+	void Enqueue(std::shared_ptr<Request> request);
+	void PushTask(Task task, std::unique_lock<std::mutex>& lock);
+	void WorkerThreadFunc();
+	/// <summary> Runs a stage unless the request was cancelled. Returns false if the request should not go on. </summary>
+	bool RunStage(Request& request, eLoadState waiting, eLoadState running, const std::function<void()>& stage, eLoadState next);
+	/// <summary> Moves the request to CANCELLED unless it has already finished. </summary>
+	static void CancelRequest(Request& request);
+
+	template <class AssetT>
+	static auto IsUploaded(const AssetT& asset, int) -> decltype(!asset.HasPendingUploads()) { return !asset.HasPendingUploads(); }
+	template <class AssetT>
+	static bool IsUploaded(const AssetT&, long) { return true; }
+private:
+	std::vector<std::thread> m_workers;
+	std::priority_queue<Task> m_tasks;
+	std::vector<std::shared_ptr<Request>> m_decoded;
+	std::vector<std::shared_ptr<Request>> m_uploading;
+	size_t m_inFlightCount = 0; // Requests queued, reading or decoding.
+	uint64_t m_nextSequence = 0;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_taskCv;
+	std::condition_variable m_decodedCv;
+	bool m_runThreads = true;
+};
+
+
+
+template <class AssetT>
+AssetT* AssetLoader::Handle<AssetT>::Get() const {
+	if (!m_request) {
+		return nullptr;
+	}
+	eLoadState state = m_request->state.load();
+	bool hasAsset = state == eLoadState::UPLOADING || state == eLoadState::READY;
+	return hasAsset ? static_cast<AssetT*>(m_request->asset.get()) : nullptr;
+}
+
+
+template <class AssetT>
+void AssetLoader::Handle<AssetT>::RethrowError() const {
+	if (m_request && m_request->state.load() == eLoadState::FAILED) {
+		std::rethrow_exception(m_request->error);
+	}
+}
+
+
+template <class AssetT>
+void AssetLoader::Handle<AssetT>::Cancel() {
+	if (!m_request) {
+		return;
+	}
+	CancelRequest(*m_request);
+	m_request.reset();
+}
+
+
+template <class ReadFunc, class DecodeFunc, class UploadFunc>
+auto AssetLoader::Load(int priority, ReadFunc read, DecodeFunc decode, UploadFunc upload) {
+	using FileT = std::decay_t<decltype(read())>;
+	using DataT = std::decay_t<decltype(decode(std::declval<FileT&&>()))>;
+	using AssetT = typename decltype(upload(std::declval<DataT&&>()))::element_type;
+
+	auto request = std::make_shared<Request>();
+	request->priority = priority;
+
+	// The stages run one after the other, the results are handed over in shared state.
+	// Each stage releases the previous result as soon as it's done.
+	auto file = std::make_shared<std::unique_ptr<FileT>>();
+	auto data = std::make_shared<std::unique_ptr<DataT>>();
+	Request* self = request.get();
+
+	request->read = [file, read = std::move(read)]() mutable {
+		*file = std::make_unique<FileT>(read());
+	};
+	request->decode = [file, data, decode = std::move(decode)]() mutable {
+		*data = std::make_unique<DataT>(decode(std::move(**file)));
+		file->reset();
+	};
+	request->upload = [self, data, upload = std::move(upload)]() mutable {
+		std::unique_ptr<AssetT> asset = upload(std::move(**data));
+		data->reset();
+		self->asset = std::shared_ptr<AssetT>(std::move(asset));
+		self->isUploaded = [self] {
+			return IsUploaded(*static_cast<const AssetT*>(self->asset.get()), 0);
+		};
+	};
+
+	Enqueue(request);
+	return Handle<AssetT>(std::move(request));
+}
+
+
+} // namespace gxeng
+} // namespace inl
@@ -60,6 +60,8 @@ void BasicCommandList::NewScratchSpace(size_t sizeHint) {
 
 BasicCommandList::BasicCommandList(BasicCommandList&& rhs)
 	: m_resourceTransitions(std::move(rhs.m_resourceTransitions)),
+	m_additionalResources(std::move(rhs.m_additionalResources)),
+	m_additionalResourceSet(std::move(rhs.m_additionalResourceSet)),
 	m_scratchSpacePool(rhs.m_scratchSpacePool),
 	m_commandAllocator(std::move(rhs.m_commandAllocator)),
 	m_commandList(std::move(rhs.m_commandList)),
@@ -70,6 +72,8 @@ BasicCommandList::BasicCommandList(BasicCommandList&& rhs)
 
 BasicCommandList& BasicCommandList::operator=(BasicCommandList&& rhs) {
 	m_resourceTransitions = std::move(rhs.m_resourceTransitions);
+	m_additionalResources = std::move(rhs.m_additionalResources);
+	m_additionalResourceSet = std::move(rhs.m_additionalResourceSet);
 	m_scratchSpacePool = rhs.m_scratchSpacePool;
 	m_commandAllocator = std::move(rhs.m_commandAllocator);
 	m_commandList = std::move(rhs.m_commandList);
@@ -91,11 +95,20 @@ BasicCommandList::Decomposition BasicCommandList::Decompose() {
 	for (const auto& v : m_resourceTransitions) {
 		decomposition.usedResources.push_back(ResourceUsage{ std::move(v.first.resource), v.first.subresource, v.second.firstState, v.second.lastState, v.second.multipleStates });
 	}
+	decomposition.additionalResources = std::move(m_additionalResources);
+	m_additionalResourceSet.clear();
 
 	return decomposition;
 }
 
 
+void BasicCommandList::UseResource(const MemoryObject& resource) {
+	if (m_additionalResourceSet.insert(resource._GetResourcePtr()).second) {
+		m_additionalResources.push_back(resource);
+	}
+}
+
+
 
 
 } // namespace gxapi
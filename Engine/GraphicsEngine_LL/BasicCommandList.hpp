@@ -11,6 +11,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 
 
@@ -75,6 +76,7 @@ public:
 		std::unique_ptr<gxapi::ICopyCommandList> commandList;
 		std::vector<ScratchSpacePtr> scratchSpaces;
 		std::vector<ResourceUsage> usedResources;
+		std::vector<MemoryObject> additionalResources; // Used without state transitions, they are only kept resident.
 	};
 public:
 	BasicCommandList(const BasicCommandList& rhs) = delete; // could be, but big perf hit, better not allow user
@@ -86,6 +88,11 @@ public:
 	gxapi::eCommandListType GetType() const { return m_commandList->GetType(); }
 
 	virtual Decomposition Decompose();
+
+	/// <summary> Keeps the resource resident while the list runs. Resources that are transitioned
+	///		with SetResourceState, bound as views, vertex or index buffers are recorded automatically,
+	///		this is for those the GPU only reaches through addresses, like the ones in indirect arguments. </summary>
+	void UseResource(const MemoryObject& resource);
 protected:
 	BasicCommandList(
 		gxapi::IGraphicsApi* gxApi,
@@ -93,13 +100,14 @@ protected:
 		ScratchSpacePool& scratchSpacePool,
 		gxapi::eCommandListType type);
 
-	void UseResource(MemoryObject* resource);
 	gxapi::ICommandList* GetCommandList() const { return m_commandList.get(); }
 
 	StackDescHeap* GetCurrentScratchSpace();
 	virtual void NewScratchSpace(size_t sizeHint);
 protected:
 	std::unordered_map<SubresourceId, SubresourceUsageInfo> m_resourceTransitions;
+	std::vector<MemoryObject> m_additionalResources;
+	std::unordered_set<const gxapi::IResource*> m_additionalResourceSet;
 	gxapi::IGraphicsApi* m_graphicsApi;
 private:
 	// Part sources
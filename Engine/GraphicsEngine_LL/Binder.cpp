@@ -3,6 +3,7 @@
 #include <GraphicsApi_LL/IGraphicsApi.hpp>
 
 #include "Binder.hpp"
+#include "PipelineStateCache.hpp"
 #include <algorithm>
 
 
@@ -11,10 +12,42 @@ namespace gxeng {
 
 
 
-Binder::Binder(inl::gxapi::IGraphicsApi* gxApi, const std::vector<BindParameterDesc>& parameters, const std::vector<gxapi::StaticSamplerDesc>& staticSamplers) {
+Binder::Binder(inl::gxapi::IGraphicsApi* gxApi,
+			   const std::vector<BindParameterDesc>& parameters,
+			   const std::vector<gxapi::StaticSamplerDesc>& staticSamplers,
+			   const BindlessTableDesc& bindlessTable)
+{
+	CalculateRootSignatureDesc(parameters, staticSamplers, bindlessTable);
+	m_rootSignature.reset(gxApi->CreateRootSignature(m_rootSignatureDesc));
+}
+
+
+Binder::Binder(PipelineStateCache* cache,
+			   const std::vector<BindParameterDesc>& parameters,
+			   const std::vector<gxapi::StaticSamplerDesc>& staticSamplers,
+			   const BindlessTableDesc& bindlessTable)
+{
+	CalculateRootSignatureDesc(parameters, staticSamplers, bindlessTable);
+	m_rootSignature = cache->GetRootSignature(m_rootSignatureDesc);
+}
+
+
+void Binder::CalculateRootSignatureDesc(const std::vector<BindParameterDesc>& parameters,
+										const std::vector<gxapi::StaticSamplerDesc>& staticSamplers,
+										const BindlessTableDesc& bindlessTable)
+{
 	CalculateLayout(parameters);
 	m_rootSignatureDesc.staticSamplers = staticSamplers;
-	m_rootSignature.reset(gxApi->CreateRootSignature(m_rootSignatureDesc));
+
+	// the bindless table comes last, its ranges overlap as they view the same descriptors
+	if (bindlessTable.numDescriptors > 0) {
+		std::vector<gxapi::DescriptorRange> ranges;
+		for (unsigned space : bindlessTable.spaces) {
+			ranges.push_back(gxapi::DescriptorRange{ gxapi::DescriptorRange::SRV, bindlessTable.numDescriptors, 0, space, 0 });
+		}
+		m_bindlessSlot = (int)m_rootSignatureDesc.rootParameters.size();
+		m_rootSignatureDesc.rootParameters.push_back(gxapi::RootParameterDesc::DescriptorTable(ranges, bindlessTable.shaderVisibility));
+	}
 }
 
 void Binder::Translate(BindParameter parameter, int & rootParamIndex, int & rootTableIndex) const {
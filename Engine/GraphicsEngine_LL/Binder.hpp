@@ -7,6 +7,7 @@
 #include <cassert>
 #include <iostream>
 #include <initializer_list>
+#include <memory>
 
 
 namespace inl {namespace gxapi {
@@ -17,6 +18,7 @@ namespace inl {namespace gxapi {
 
 namespace inl {namespace gxeng {
 class Binder;
+class PipelineStateCache;
 }
 }
 inline std::ostream& operator<<(std::ostream& os, const inl::gxeng::Binder& binder);
@@ -68,6 +70,17 @@ struct BindParameterDesc {
 };
 
 
+/// <summary>
+/// Makes the bindless table of textures visible to the shaders, see <see cref="BindlessHeap"/>.
+/// The table is declared as an array of textures at register t0 of each space, so shaders can view it with different texture types.
+/// </summary>
+struct BindlessTableDesc {
+	unsigned numDescriptors = 0; /// <summary> Size of the table. Zero if the binder has no bindless table. </summary>
+	std::vector<unsigned> spaces; /// <summary> The register spaces of the arrays. </summary>
+	gxapi::eShaderVisiblity shaderVisibility = gxapi::eShaderVisiblity::ALL;
+};
+
+
 /// <summary>
 /// A binder describes the link between resources and shader registers.
 /// </summary>
@@ -92,7 +105,16 @@ public:
 	Binder() = default;
 
 	/// <summary> Create a binder from specified binding points. </summary>
-	Binder(gxapi::IGraphicsApi* gxApi, const std::vector<BindParameterDesc>& parameters, const std::vector<gxapi::StaticSamplerDesc>& staticSamplers = {});
+	Binder(gxapi::IGraphicsApi* gxApi,
+		   const std::vector<BindParameterDesc>& parameters,
+		   const std::vector<gxapi::StaticSamplerDesc>& staticSamplers = {},
+		   const BindlessTableDesc& bindlessTable = {});
+
+	/// <summary> Create a binder whose root signature is shared with equal binders. </summary>
+	Binder(PipelineStateCache* cache,
+		   const std::vector<BindParameterDesc>& parameters,
+		   const std::vector<gxapi::StaticSamplerDesc>& staticSamplers = {},
+		   const BindlessTableDesc& bindlessTable = {});
 
 	/// <summary> Get where in the root signature the specified parameter lies. </summary>
 	/// <param name="parameter"> The parameter to query. </param>
@@ -106,7 +128,14 @@ public:
 	/// <summary> Return the description of the underying root signature object. </summary>
 	/// <remarks> Use this to determine the type of slots returned by <see cref="Translate">. </remarks>
 	const gxapi::RootSignatureDesc& GetRootSignatureDesc() const { return m_rootSignatureDesc; }
+
+	/// <summary> The root signature slot of the bindless table, -1 if there's none. </summary>
+	/// <remarks> The command lists set it to the scratch space's copy of the table. </remarks>
+	int GetBindlessSlot() const { return m_bindlessSlot; }
 private:
+	void CalculateRootSignatureDesc(const std::vector<BindParameterDesc>& parameters,
+									const std::vector<gxapi::StaticSamplerDesc>& staticSamplers,
+									const BindlessTableDesc& bindlessTable);
 	void CalculateLayout(const std::vector<BindParameterDesc>& parameters);
 	void DistributeParameters(const std::vector<BindParameterDesc>& parameters,
 		std::vector<std::vector<BindParameterDesc>> & tableParams,
@@ -117,8 +146,9 @@ private:
 	std::pair<std::vector<RootParameterMapping>::const_iterator, bool> FindMapping(BindParameter param) const;
 private:
 	std::vector<RootParameterMapping> m_parameters;
-	std::unique_ptr<gxapi::IRootSignature> m_rootSignature;
+	std::shared_ptr<gxapi::IRootSignature> m_rootSignature;
 	gxapi::RootSignatureDesc m_rootSignatureDesc;
+	int m_bindlessSlot = -1;
 
 	// Maximum root signature size = 64 DWORDs.
 	// TODO: query from gxapi!
@@ -16,11 +16,14 @@ public:
 
 	using RootTableManager::SetBinder;
 	using RootTableManager::SetDescriptorHeap;
+	using RootTableManager::PrepareDrawCall;
 	using RootTableManager::CommitDrawCall;
+	using RootTableManager::GetStatistics;
 
 	void Bind(BindParameter parameter, const TextureView1D& shaderResource);
 	void Bind(BindParameter parameter, const TextureView2D& shaderResource);
 	void Bind(BindParameter parameter, const TextureView3D& shaderResource);
+	void Bind(BindParameter parameter, const BufferView& shaderResource);
 	void Bind(BindParameter parameter, const ConstBufferView& shaderConstant);
 	void Bind(BindParameter parameter, const void* shaderConstant, int size, int offset);
 
@@ -69,6 +72,12 @@ void BindingManager<Type>::Bind(BindParameter parameter, const TextureView3D& sh
 }
 
 
+template <gxapi::eCommandListType Type>
+void BindingManager<Type>::Bind(BindParameter parameter, const BufferView& shaderResource) {
+	return BindTexture(parameter, shaderResource.GetHandle());
+}
+
+
 template <gxapi::eCommandListType Type>
 void BindingManager<Type>::BindTexture(BindParameter parameter, gxapi::DescriptorHandle handle) {
 	assert(m_binder != nullptr);
@@ -0,0 +1,89 @@
+#include "BindlessHeap.hpp"
+#include "StackDescHeap.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace inl {
+namespace gxeng {
+
+
+BindlessHeap::BindlessHeap(gxapi::IGraphicsApi* graphicsApi, uint32_t capacity)
+	: m_graphicsApi(graphicsApi),
+	m_capacity(capacity),
+	m_sources(capacity),
+	m_versions(capacity, 0),
+	m_version(0),
+	m_allocEngine(capacity)
+{}
+
+
+uint32_t BindlessHeap::Add(gxapi::DescriptorHandle source) {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+
+	size_t index;
+	try {
+		index = m_allocEngine.Allocate();
+	}
+	catch (std::bad_alloc&) {
+		throw std::runtime_error("Bindless descriptor table is full.");
+	}
+
+	m_sources[index] = source;
+	m_versions[index] = ++m_version;
+	return (uint32_t)index;
+}
+
+
+void BindlessHeap::Set(uint32_t index, gxapi::DescriptorHandle source) {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	assert(index < m_capacity);
+
+	m_sources[index] = source;
+	m_versions[index] = ++m_version;
+}
+
+
+void BindlessHeap::Remove(uint32_t index) {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	assert(index < m_capacity);
+
+	// The stale copies in scratch spaces are left alone, the next descriptor at this index overwrites them.
+	m_sources[index] = gxapi::DescriptorHandle();
+	m_allocEngine.Deallocate(index);
+}
+
+
+void BindlessHeap::Update(StackDescHeap& scratchSpace) {
+	assert(scratchSpace.m_reservedSize == m_capacity);
+
+	// Most draws find the scratch space up to date, that takes no lock.
+	if (scratchSpace.m_bindlessVersion == m_version.load()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lkg(m_mutex);
+
+	std::vector<gxapi::DescriptorHandle> sourceDescHandles;
+	std::vector<gxapi::DescriptorHandle> destDescHandles;
+	for (uint32_t i = 0; i < m_capacity; ++i) {
+		if (m_versions[i] > scratchSpace.m_bindlessVersion && m_sources[i].cpuAddress != nullptr) {
+			sourceDescHandles.push_back(m_sources[i]);
+			destDescHandles.push_back(scratchSpace.m_heap->At(i));
+		}
+	}
+
+	if (!sourceDescHandles.empty()) {
+		std::vector<uint32_t> rangeSizes(sourceDescHandles.size(), 1);
+		m_graphicsApi->CopyDescriptors(
+			sourceDescHandles.size(), sourceDescHandles.data(), rangeSizes.data(),
+			destDescHandles.size(), destDescHandles.data(), rangeSizes.data(),
+			gxapi::eDescriptorHeapType::CBV_SRV_UAV);
+	}
+
+	scratchSpace.m_bindlessVersion = m_version.load();
+}
+
+
+} // namespace gxeng
+} // namespace inl
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../GraphicsApi_LL/IGraphicsApi.hpp"
+#include "../BaseLibrary/Memory/SlabAllocatorEngine.hpp"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace inl {
+namespace gxeng {
+
+class StackDescHeap;
+
+
+/// <summary>
+/// A table of persistent shader resource views that shaders index directly.
+/// Textures are placed in the table once, and materials pass their indices
+/// as constants instead of binding the textures for each draw.
+/// <para />
+/// This class is thread safe.
+/// </summary>
+/// <remarks>
+/// Only one shader visible heap can be bound at a time, so each scratch space reserves
+/// its first descriptors for a copy of the table. <see cref="Update"/> copies the descriptors
+/// that changed since the scratch space was last updated.
+/// <para />
+/// Textures in the table are not bound, so command lists don't track them. Users must keep the
+/// textures a list indexes resident and in a shader resource state, through the list's
+/// UseResource and SetResourceState.
+/// </remarks>
+class BindlessHeap {
+public:
+	BindlessHeap(gxapi::IGraphicsApi* graphicsApi, uint32_t capacity = 8192);
+
+	/// <summary> Places a descriptor in the table. </summary>
+	/// <param name="source"> A non shader visible descriptor, it must stay valid until it's removed or replaced. </param>
+	/// <returns> The index of the descriptor that shaders use. </returns>
+	/// <exception cref="std::runtime_error"> If the table is full. </exception>
+	uint32_t Add(gxapi::DescriptorHandle source);
+
+	/// <summary> Replaces the descriptor at an index. </summary>
+	/// <remarks> The copy in a scratch space is updated when a draw binds the table, and the GPU only reads it
+	///		when the list executes. So every draw of a list that binds the table afterwards sees the new descriptor,
+	///		even the ones recorded before the call. Only replace descriptors that no recorded draw still reads. </remarks>
+	void Set(uint32_t index, gxapi::DescriptorHandle source);
+
+	/// <summary> Frees the index. Command lists already recorded may still read the old descriptor. </summary>
+	void Remove(uint32_t index);
+
+	/// <summary> Copies the descriptors that changed since the last update to the scratch space's reserved range. </summary>
+	void Update(StackDescHeap& scratchSpace);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+private:
+	gxapi::IGraphicsApi* m_graphicsApi;
+	const uint32_t m_capacity;
+
+	std::vector<gxapi::DescriptorHandle> m_sources;
+	std::vector<uint64_t> m_versions; // version of the table when each slot was last changed
+	std::atomic<uint64_t> m_version;
+	exc::SlabAllocatorEngine m_allocEngine;
+	std::mutex m_mutex;
+};
+
+
+} // namespace gxeng
+} // namespace inl
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <utility>
 
 
 
@@ -9,6 +10,181 @@ namespace inl {
 namespace gxeng {
 
 
+namespace impl {
+
+
+static std::atomic<uint64_t> s_nextPoolId{ 1 };
+
+
+CommandAllocatorPoolBase::CommandAllocatorPoolBase(gxapi::IGraphicsApi* gxApi)
+	: m_gxApi(gxApi), m_poolId(s_nextPoolId++), m_threadCaches(std::make_shared<ThreadCaches>())
+{}
+
+
+auto CommandAllocatorPoolBase::RequestAllocator() -> UniquePtr {
+	ThreadCache& cache = GetThreadCache();
+	cache.requestCount.fetch_add(1, std::memory_order_relaxed);
+
+	Entry* entry = TakeReady(cache);
+	if (entry == nullptr) {
+		TakeReturned(cache);
+		entry = TakeReady(cache);
+	}
+
+	if (entry != nullptr) {
+		cache.hitCount.fetch_add(1, std::memory_order_relaxed);
+		entry->allocator->Reset();
+	}
+	else {
+		auto newEntry = std::make_unique<Entry>();
+		newEntry->allocator.reset(CreateAllocator());
+		newEntry->owner = &cache;
+		entry = newEntry.get();
+		cache.entries.push_back(std::move(newEntry));
+	}
+
+	entry->lastUse = SyncPoint();
+	return UniquePtr{ entry->allocator.get(), Deleter{ this, entry } };
+}
+
+
+void CommandAllocatorPoolBase::RecycleAllocator(Entry* entry) {
+	ThreadCache& owner = *entry->owner;
+	if (owner.ownerId.load() == std::this_thread::get_id()) {
+		PushFree(owner, entry);
+		return;
+	}
+
+	owner.foreignReturnCount.fetch_add(1, std::memory_order_relaxed);
+	entry->next = owner.returned.load(std::memory_order_relaxed);
+	while (!owner.returned.compare_exchange_weak(entry->next, entry, std::memory_order_release, std::memory_order_relaxed)) {
+		owner.contentionCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+
+void CommandAllocatorPoolBase::RecycleAfter(UniquePtr allocator, SyncPoint lastUse) {
+	if (allocator) {
+		allocator.get_deleter().GetEntry()->lastUse = std::move(lastUse);
+		allocator.reset();
+	}
+}
+
+
+auto CommandAllocatorPoolBase::GetStatistics() const -> Statistics {
+	std::lock_guard<std::mutex> lkg(m_threadCaches->mutex);
+
+	Statistics statistics;
+	for (const auto& cache : m_threadCaches->all) {
+		statistics.requestCount += cache->requestCount.load(std::memory_order_relaxed);
+		statistics.hitCount += cache->hitCount.load(std::memory_order_relaxed);
+		statistics.foreignReturnCount += cache->foreignReturnCount.load(std::memory_order_relaxed);
+		statistics.contentionCount += cache->contentionCount.load(std::memory_order_relaxed);
+	}
+	statistics.createCount = statistics.requestCount - statistics.hitCount;
+	statistics.threadCount = m_threadCaches->all.size();
+	return statistics;
+}
+
+
+auto CommandAllocatorPoolBase::GetThreadCache() -> ThreadCache& {
+	// A thread only talks to a few pools, a short list beats hashing.
+	// The list gives the thread's caches back to their pools when the thread exits.
+	struct ThreadLookup {
+		struct Item {
+			uint64_t poolId;
+			ThreadCache* cache;
+			std::weak_ptr<ThreadCaches> poolCaches;
+		};
+		~ThreadLookup() {
+			for (const auto& item : items) {
+				if (auto poolCaches = item.poolCaches.lock()) {
+					std::lock_guard<std::mutex> lkg(poolCaches->mutex);
+					item.cache->ownerId = std::thread::id();
+					poolCaches->abandoned.push_back(item.cache);
+				}
+			}
+		}
+		std::vector<Item> items;
+	};
+	thread_local ThreadLookup threadCaches;
+
+	for (const auto& item : threadCaches.items) {
+		if (item.poolId == m_poolId) {
+			return *item.cache;
+		}
+	}
+
+	// First request of this thread, take over the allocators of an exited one if there is any.
+	std::lock_guard<std::mutex> lkg(m_threadCaches->mutex);
+	ThreadCache* cache;
+	if (!m_threadCaches->abandoned.empty()) {
+		cache = m_threadCaches->abandoned.back();
+		m_threadCaches->abandoned.pop_back();
+	}
+	else {
+		m_threadCaches->all.push_back(std::make_unique<ThreadCache>());
+		cache = m_threadCaches->all.back().get();
+	}
+	cache->ownerId = std::this_thread::get_id();
+	threadCaches.items.push_back({ m_poolId, cache, m_threadCaches });
+	return *cache;
+}
+
+
+auto CommandAllocatorPoolBase::TakeReady(ThreadCache& cache) -> Entry* {
+	// Allocators of different queues may finish out of order, so look past the ones still in flight.
+	Entry* previous = nullptr;
+	for (Entry* entry = cache.freeHead; entry != nullptr; previous = entry, entry = entry->next) {
+		if (!entry->lastUse.IsReached()) {
+			continue;
+		}
+		(previous != nullptr ? previous->next : cache.freeHead) = entry->next;
+		if (cache.freeTail == entry) {
+			cache.freeTail = previous;
+		}
+		entry->next = nullptr;
+		return entry;
+	}
+	return nullptr;
+}
+
+
+void CommandAllocatorPoolBase::TakeReturned(ThreadCache& cache) {
+	Entry* returned = cache.returned.exchange(nullptr, std::memory_order_acquire);
+
+	// The stack has the latest return on top, reverse it to keep the free list oldest first.
+	Entry* reversed = nullptr;
+	while (returned != nullptr) {
+		Entry* next = returned->next;
+		returned->next = reversed;
+		reversed = returned;
+		returned = next;
+	}
+	while (reversed != nullptr) {
+		Entry* next = reversed->next;
+		PushFree(cache, reversed);
+		reversed = next;
+	}
+}
+
+
+void CommandAllocatorPoolBase::PushFree(ThreadCache& cache, Entry* entry) {
+	entry->next = nullptr;
+	if (cache.freeTail != nullptr) {
+		cache.freeTail->next = entry;
+	}
+	else {
+		cache.freeHead = entry;
+	}
+	cache.freeTail = entry;
+}
+
+
+} // namespace impl
+
+
+
 CommandAllocatorPool::CommandAllocatorPool(gxapi::IGraphicsApi* gxApi)
 	: m_gxPool(gxApi), m_cuPool(gxApi), m_cpPool(gxApi)
 {}
@@ -31,20 +207,27 @@ auto CommandAllocatorPool::RequestAllocator(gxapi::eCommandListType type) -> Cmd
 }
 
 
-void CommandAllocatorPool::RecycleAllocator(gxapi::ICommandAllocator* allocator) {
-	switch (allocator->GetType())
-	{
-		case gxapi::eCommandListType::COPY:
-			m_cpPool.RecycleAllocator(allocator);
-		case gxapi::eCommandListType::COMPUTE:
-			m_cuPool.RecycleAllocator(allocator);
-		case gxapi::eCommandListType::GRAPHICS:
-			m_gxPool.RecycleAllocator(allocator);
-		default:
-			assert(false); // hlye vagy bazmeg
+void CommandAllocatorPool::RecycleAfter(CmdAllocPtr allocator, SyncPoint lastUse) {
+	impl::CommandAllocatorPoolBase::RecycleAfter(std::move(allocator), std::move(lastUse));
+}
+
+
+auto CommandAllocatorPool::GetStatistics() const -> Statistics {
+	Statistics total;
+	const impl::CommandAllocatorPoolBase* pools[] = { &m_gxPool, &m_cuPool, &m_cpPool };
+	for (auto pool : pools) {
+		Statistics statistics = pool->GetStatistics();
+		total.requestCount += statistics.requestCount;
+		total.hitCount += statistics.hitCount;
+		total.createCount += statistics.createCount;
+		total.foreignReturnCount += statistics.foreignReturnCount;
+		total.contentionCount += statistics.contentionCount;
+		total.threadCount = std::max(total.threadCount, statistics.threadCount);
 	}
+	return total;
 }
 
+
 gxapi::IGraphicsApi* CommandAllocatorPool::GetGraphicsApi() const {
 	return m_gxPool.GetGraphicsApi();
 }
@@ -64,4 +247,4 @@ exc::LogStream* CommandAllocatorPool::GetLogStream() const {
 
 
 } // namespace gxeng
-} // namespace inl
\ No newline at end of file
+} // namespace inl
@@ -1,16 +1,16 @@
 #pragma once
 
-#include "../BaseLibrary/Memory/SlabAllocatorEngine.hpp"
 #include "../GraphicsApi_LL/ICommandAllocator.hpp"
 #include "../GraphicsApi_LL/IGraphicsApi.hpp"
+#include "SyncPoint.hpp"
 
 #include <vector>
 #include <mutex>
-#include <algorithm>
-#include <map>
+#include <atomic>
+#include <thread>
+#include <memory>
 #include <cassert>
 
-#include <iostream> // only for debug
 #include "BaseLibrary/Logging/LogStream.hpp"
 
 
@@ -20,132 +20,124 @@ namespace gxeng {
 
 namespace impl {
 
+	/// <summary>
+	/// Pools command allocators of one type. Each thread requests from its own free list, so reuse takes no lock.
+	/// </summary>
+	/// <remarks>
+	/// An allocator goes back to the free list of the thread that created it. Returns from other threads are
+	/// pushed onto a lock-free stack that the owner takes over when its own list runs out of usable allocators.
+	/// When a thread exits, its free list and allocators are handed to the next thread that requests for the first time.
+	/// Allocators are tagged with the sync point of their last submission, and only reset and reused after the GPU has passed it.
+	/// </remarks>
 	class CommandAllocatorPoolBase {
+		struct ThreadCache;
 	public:
+		/// <summary> An allocator and its bookkeeping. Recycling finds it through the deleter, and free lists link it in place. </summary>
+		struct Entry {
+			std::unique_ptr<gxapi::ICommandAllocator> allocator;
+			SyncPoint lastUse;
+			ThreadCache* owner = nullptr;
+			Entry* next = nullptr;
+		};
+
 		struct Deleter {
 		public:
-			Deleter() : m_container(nullptr) {}
+			Deleter() : m_container(nullptr), m_entry(nullptr) {}
 			Deleter(const Deleter&) = default;
 			Deleter(Deleter&&) = default;
 			Deleter& operator=(const Deleter&) = default;
 			Deleter& operator=(Deleter&&) = default;
-			explicit Deleter(CommandAllocatorPoolBase* container) : m_container(container) {}
+			Deleter(CommandAllocatorPoolBase* container, Entry* entry) : m_container(container), m_entry(entry) {}
 			void operator()(gxapi::ICommandAllocator* object) const {
 				assert(m_container != nullptr);
-				m_container->RecycleAllocator(object);
+				assert(m_entry->allocator.get() == object);
+				m_container->RecycleAllocator(m_entry);
 			}
+			Entry* GetEntry() const { return m_entry; }
 		private:
 			CommandAllocatorPoolBase* m_container;
+			Entry* m_entry;
 		};
 		using UniquePtr = std::unique_ptr<gxapi::ICommandAllocator, Deleter>;
-	public:
-		virtual ~CommandAllocatorPoolBase() {}
-		virtual UniquePtr RequestAllocator() = 0;
-		virtual void RecycleAllocator(gxapi::ICommandAllocator*) = 0;
-	};
-
 
-	template <gxapi::eCommandListType TYPE>
-	class CommandAllocatorPool : public CommandAllocatorPoolBase {
-	public:
+		struct Statistics {
+			uint64_t requestCount = 0;
+			uint64_t hitCount = 0; // Requests that reused an allocator.
+			uint64_t createCount = 0; // Requests that had to create an allocator.
+			uint64_t foreignReturnCount = 0; // Allocators returned by a thread other than their owner.
+			uint64_t contentionCount = 0; // Retries of foreign returns because another thread returned to the same owner at the same time.
+			size_t threadCount = 0; // Free lists, each owned by a thread or waiting for one after its thread exited.
+		};
 	public:
-		explicit CommandAllocatorPool(gxapi::IGraphicsApi* gxApi, size_t initialSize = 1);
-		CommandAllocatorPool(const CommandAllocatorPool&) = delete;
-		CommandAllocatorPool(CommandAllocatorPool&& rhs);
+		explicit CommandAllocatorPoolBase(gxapi::IGraphicsApi* gxApi);
+		virtual ~CommandAllocatorPoolBase() {}
 
-		CommandAllocatorPool& operator=(const CommandAllocatorPool&) = delete;
-		CommandAllocatorPool& operator=(CommandAllocatorPool&& rhs);
+		CommandAllocatorPoolBase(const CommandAllocatorPoolBase&) = delete;
+		CommandAllocatorPoolBase& operator=(const CommandAllocatorPoolBase&) = delete;
 
+		/// <summary> Gets an allocator from the calling thread's free list, or creates one. </summary>
+		UniquePtr RequestAllocator();
+		/// <summary> Returns the allocator to its owner's free list. It is reused once its last use has finished on the GPU. </summary>
+		void RecycleAllocator(Entry* entry);
+		/// <summary> Returns the allocator to its pool after the command list that uses it was submitted. </summary>
+		/// <param name="lastUse"> The allocator is not reset before the GPU passes this. </param>
+		static void RecycleAfter(UniquePtr allocator, SyncPoint lastUse);
 
-		UniquePtr RequestAllocator() override;
-		void RecycleAllocator(gxapi::ICommandAllocator* allocator) override;
-		void Reset(size_t initialSize = 1);
+		Statistics GetStatistics() const;
 
 		gxapi::IGraphicsApi* GetGraphicsApi() const { return m_gxApi; }
 
 		void SetLogStream(exc::LogStream* logStream) { m_logStream = logStream; }
 		exc::LogStream* GetLogStream() const { return m_logStream; }
+	protected:
+		virtual gxapi::ICommandAllocator* CreateAllocator() = 0;
 	private:
-		std::vector<std::unique_ptr<gxapi::ICommandAllocator>> m_pool;
-		exc::SlabAllocatorEngine m_allocator;
-		gxapi::IGraphicsApi* m_gxApi;
-		std::map<gxapi::ICommandAllocator*, size_t> m_addressToIndex;
-		exc::LogStream* m_logStream = nullptr;
-
-		std::mutex m_mtx;
-	};
-
+		struct ThreadCache {
+			std::atomic<std::thread::id> ownerId; // No thread while the cache waits for a new owner.
 
+			// Only the owner thread touches the list, oldest returns first.
+			Entry* freeHead = nullptr;
+			Entry* freeTail = nullptr;
+			std::vector<std::unique_ptr<Entry>> entries;
 
-	template <gxapi::eCommandListType TYPE>
-	CommandAllocatorPool<TYPE>::CommandAllocatorPool(gxapi::IGraphicsApi* gxApi, size_t initialSize)
-		: m_pool(initialSize), m_allocator(initialSize), m_gxApi(gxApi)
-	{}
+			// Other threads push here.
+			std::atomic<Entry*> returned{ nullptr };
 
+			std::atomic<uint64_t> requestCount{ 0 };
+			std::atomic<uint64_t> hitCount{ 0 };
+			std::atomic<uint64_t> foreignReturnCount{ 0 };
+			std::atomic<uint64_t> contentionCount{ 0 };
+		};
 
-	template <gxapi::eCommandListType TYPE>
-	CommandAllocatorPool<TYPE>::CommandAllocatorPool(CommandAllocatorPool&& rhs)
-		: m_pool(std::move(rhs.m_pool)), m_allocator(std::move(rhs.m_allocator)), m_gxApi(rhs.m_gxApi)
-	{}
-
+		ThreadCache& GetThreadCache();
+		static Entry* TakeReady(ThreadCache& cache);
+		static void TakeReturned(ThreadCache& cache);
+		static void PushFree(ThreadCache& cache, Entry* entry);
 
-	template <gxapi::eCommandListType TYPE>
-	CommandAllocatorPool<TYPE>& CommandAllocatorPool<TYPE>::operator=(CommandAllocatorPool&& rhs) {
-		m_pool = std::move(rhs.m_pool);
-		m_allocator = std::move(rhs.m_allocator);
-		m_gxApi = rhs.m_gxApi;
+	private:
+		gxapi::IGraphicsApi* m_gxApi;
+		exc::LogStream* m_logStream = nullptr;
+		const uint64_t m_poolId; // Tells pools apart in the threads' lookup tables, addresses may be reused.
 
-		return *this;
-	}
+		// Shared with the threads' lookup tables, which give the caches back when their thread exits, maybe after the pool.
+		struct ThreadCaches {
+			std::vector<std::unique_ptr<ThreadCache>> all; // Only changes when a thread requests for the first time.
+			std::vector<ThreadCache*> abandoned; // Caches of exited threads.
+			std::mutex mutex;
+		};
+		std::shared_ptr<ThreadCaches> m_threadCaches;
+	};
 
 
 	template <gxapi::eCommandListType TYPE>
-	auto CommandAllocatorPool<TYPE>::RequestAllocator() -> UniquePtr {
-		std::lock_guard<std::mutex> lkg(m_mtx);
-
-		size_t index;
-		try {
-			index = m_allocator.Allocate();
-		}
-		catch (std::bad_alloc&) {
-			size_t currentSize = m_pool.size();
-			size_t newSize = std::max(currentSize + 1, size_t(currentSize * 1.25));
-			m_pool.resize(newSize);
-			m_allocator.Resize(newSize);
-
-			index = m_allocator.Allocate();
-		}
-
-		if (m_pool[index] != nullptr) {
-			return UniquePtr{ m_pool[index].get(), Deleter{this} };
-		}
-		else {
-			std::unique_ptr<gxapi::ICommandAllocator> ptr(m_gxApi->CreateCommandAllocator(TYPE));
-			m_addressToIndex[ptr.get()] = index;
-			m_pool[index] = std::move(ptr);
-			return UniquePtr{ m_pool[index].get(), Deleter{this} };
+	class CommandAllocatorPool : public CommandAllocatorPoolBase {
+	public:
+		explicit CommandAllocatorPool(gxapi::IGraphicsApi* gxApi) : CommandAllocatorPoolBase(gxApi) {}
+	protected:
+		gxapi::ICommandAllocator* CreateAllocator() override {
+			return GetGraphicsApi()->CreateCommandAllocator(TYPE);
 		}
-	}
-
-
-	template <gxapi::eCommandListType TYPE>
-	void CommandAllocatorPool<TYPE>::RecycleAllocator(gxapi::ICommandAllocator* allocator) {
-		std::lock_guard<std::mutex> lkg(m_mtx);
-
-		allocator->Reset();
-		assert(m_addressToIndex.count(allocator) > 0);
-		size_t index = m_addressToIndex[allocator];
-		m_allocator.Deallocate(index);
-	}
-
-
-	template <gxapi::eCommandListType TYPE>
-	void CommandAllocatorPool<TYPE>::Reset(size_t initialSize) {
-		m_pool.clear();
-		m_allocator.Reset();
-		m_pool.resize(initialSize);
-		m_allocator.Resize(initialSize);
-	}
+	};
 
 } // namespace impl
 
@@ -154,15 +146,18 @@ using CmdAllocPtr = impl::CommandAllocatorPoolBase::UniquePtr;
 
 class CommandAllocatorPool {
 public:
+	using Statistics = impl::CommandAllocatorPoolBase::Statistics;
 public:
 	explicit CommandAllocatorPool(gxapi::IGraphicsApi* gxApi);
 	CommandAllocatorPool(const CommandAllocatorPool&) = delete;
-	CommandAllocatorPool(CommandAllocatorPool&& rhs) = default;
 	CommandAllocatorPool& operator=(const CommandAllocatorPool&) = delete;
-	CommandAllocatorPool& operator=(CommandAllocatorPool&& rhs) = default;
 
 	CmdAllocPtr RequestAllocator(gxapi::eCommandListType type);
-	void RecycleAllocator(gxapi::ICommandAllocator* allocator);
+	/// <summary> Returns the allocator after the command list that uses it was submitted. It is reset once the GPU passes the sync point. </summary>
+	static void RecycleAfter(CmdAllocPtr allocator, SyncPoint lastUse);
+
+	/// <summary> Sum of the statistics of the pools of each command list type. </summary>
+	Statistics GetStatistics() const;
 
 	gxapi::IGraphicsApi* GetGraphicsApi() const;
 
@@ -177,4 +172,4 @@ private:
 
 
 } // namespace gxeng
-} // namespace inl
\ No newline at end of file
+} // namespace inl
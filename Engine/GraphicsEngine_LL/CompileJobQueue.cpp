@@ -0,0 +1,85 @@
+#include "CompileJobQueue.hpp"
+
+#include <BaseLibrary/ThreadName.hpp>
+
+#include <algorithm>
+
+
+namespace inl {
+namespace gxeng {
+
+
+CompileJobQueue::CompileJobQueue(unsigned workerCount) {
+	if (workerCount == 0) {
+		// Leave a core for the thread that renders.
+		workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	m_runThreads = true;
+	for (unsigned i = 0; i < workerCount; ++i) {
+		m_workers.push_back(std::thread(&CompileJobQueue::WorkerThreadFunc, this));
+	}
+}
+
+
+CompileJobQueue::~CompileJobQueue() {
+	{
+		std::lock_guard<std::mutex> lkg(m_mutex);
+		m_runThreads = false;
+		m_jobCv.notify_all();
+	}
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+
+void CompileJobQueue::WaitIdle() {
+	std::unique_lock<std::mutex> lk(m_mutex);
+	m_idleCv.wait(lk, [this] { return m_jobs.empty() && m_runningCount == 0; });
+}
+
+
+size_t CompileJobQueue::GetPendingCount() const {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	return m_jobs.size() + m_runningCount;
+}
+
+
+void CompileJobQueue::Push(std::function<void()> job) {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	m_jobs.push(std::move(job));
+	m_jobCv.notify_one();
+}
+
+
+void CompileJobQueue::WorkerThreadFunc() {
+	SetCurrentThreadName("Compile Worker Thread");
+
+	std::unique_lock<std::mutex> lk(m_mutex);
+	while (true) {
+		m_jobCv.wait(lk, [this] { return !m_runThreads || !m_jobs.empty(); });
+		if (!m_runThreads) {
+			break;
+		}
+
+		std::function<void()> job = std::move(m_jobs.front());
+		m_jobs.pop();
+		++m_runningCount;
+		lk.unlock();
+
+		// Exceptions are caught by the packaged task and stored in the future.
+		job();
+		job = nullptr;
+
+		lk.lock();
+		--m_runningCount;
+		if (m_jobs.empty() && m_runningCount == 0) {
+			m_idleCv.notify_all();
+		}
+	}
+}
+
+
+} // namespace gxeng
+} // namespace inl
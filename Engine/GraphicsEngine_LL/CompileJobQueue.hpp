@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+namespace inl {
+namespace gxeng {
+
+
+/// <summary>
+/// Runs shader compilations and pipeline state creation on a pool of worker threads,
+/// so that render nodes don't stall the frame when they meet a new material or mesh layout.
+/// </summary>
+/// <remarks>
+/// Jobs are started in the order they were enqueued. A job may wait for the result of
+/// another job that was enqueued before it: that one is already running or done by then,
+/// so the pool can't deadlock.
+/// </remarks>
+class CompileJobQueue {
+public:
+	/// <param name="workerCount"> Number of worker threads. Zero picks one less than the number of cores. </param>
+	CompileJobQueue(unsigned workerCount = 0);
+	/// <summary> Waits for running jobs, jobs not started yet are abandoned. </summary>
+	/// <remarks> Futures of abandoned jobs hold an std::future_error (broken promise). </remarks>
+	~CompileJobQueue();
+
+	CompileJobQueue(const CompileJobQueue&) = delete;
+	CompileJobQueue& operator=(const CompileJobQueue&) = delete;
+
+	/// <summary> Adds a job to the queue. </summary>
+	/// <returns> The result of the job, or the exception it threw. </returns>
+	/// <remarks> This method is thread-safe. </remarks>
+	template <class Func>
+	auto Enqueue(Func job) -> std::shared_future<decltype(job())>;
+
+	/// <summary> Blocks until all jobs enqueued so far are finished. </summary>
+	/// <remarks> This method is thread-safe, but must not be called from a job. </remarks>
+	void WaitIdle();
+
+	/// <summary> Number of jobs waiting or running. </summary>
+	size_t GetPendingCount() const;
+
+	unsigned GetWorkerCount() const { return (unsigned)m_workers.size(); }
+private:
+	void Push(std::function<void()> job);
+	void WorkerThreadFunc();
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_jobs;
+	size_t m_runningCount = 0;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_jobCv;
+	std::condition_variable m_idleCv;
+	std::atomic_bool m_runThreads;
+};
+
+
+template <class Func>
+auto CompileJobQueue::Enqueue(Func job) -> std::shared_future<decltype(job())> {
+	using ResultT = decltype(job());
+
+	// std::function needs a copyable target, packaged_task is move only.
+	auto task = std::make_shared<std::packaged_task<ResultT()>>(std::move(job));
+	std::shared_future<ResultT> result = task->get_future().share();
+	Push([task] { (*task)(); });
+
+	return result;
+}
+
+
+} // namespace gxeng
+} // namespace inl
@@ -64,7 +64,31 @@ BasicCommandList::Decomposition ComputeCommandList::Decompose() {
 // Draw
 //------------------------------------------------------------------------------
 void ComputeCommandList::Dispatch(size_t numThreadGroupsX, size_t numThreadGroupsY, size_t numThreadGroupsZ) {
+	try {
+		m_computeBindingManager.PrepareDrawCall();
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_computeBindingManager.PrepareDrawCall();
+	}
 	m_commandList->Dispatch(numThreadGroupsX, numThreadGroupsY, numThreadGroupsZ);
+	m_computeBindingManager.CommitDrawCall();
+}
+
+void ComputeCommandList::DispatchIndirect(gxapi::ICommandSignature* commandSignature,
+	unsigned maxCommandCount,
+	const MemoryObject& argumentBuffer,
+	size_t argumentBufferOffset)
+{
+	try {
+		m_computeBindingManager.PrepareDrawCall();
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_computeBindingManager.PrepareDrawCall();
+	}
+	m_commandList->ExecuteIndirect(commandSignature, maxCommandCount, const_cast<gxapi::IResource*>(argumentBuffer._GetResourcePtr()), argumentBufferOffset);
+	m_computeBindingManager.CommitDrawCall();
 }
 
 
@@ -90,6 +114,7 @@ void ComputeCommandList::SetComputeBinder(Binder* binder) {
 
 
 void ComputeCommandList::BindCompute(BindParameter parameter, const TextureView1D& shaderResource) {
+	UseResource(shaderResource.GetResource());
 	try {
 		m_computeBindingManager.Bind(parameter, shaderResource);
 	}
@@ -100,6 +125,7 @@ void ComputeCommandList::BindCompute(BindParameter parameter, const TextureView1
 }
 
 void ComputeCommandList::BindCompute(BindParameter parameter, const TextureView2D& shaderResource) {
+	UseResource(shaderResource.GetResource());
 	try {
 		m_computeBindingManager.Bind(parameter, shaderResource);
 	}
@@ -110,6 +136,18 @@ void ComputeCommandList::BindCompute(BindParameter parameter, const TextureView2
 }
 
 void ComputeCommandList::BindCompute(BindParameter parameter, const TextureView3D& shaderResource) {
+	UseResource(shaderResource.GetResource());
+	try {
+		m_computeBindingManager.Bind(parameter, shaderResource);
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_computeBindingManager.Bind(parameter, shaderResource);
+	}
+}
+
+void ComputeCommandList::BindCompute(BindParameter parameter, const BufferView& shaderResource) {
+	UseResource(shaderResource.GetResource());
 	try {
 		m_computeBindingManager.Bind(parameter, shaderResource);
 	}
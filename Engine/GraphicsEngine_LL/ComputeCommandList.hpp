@@ -28,6 +28,12 @@ protected:
 public:
 	// Draw
 	void Dispatch(size_t numThreadGroupsX, size_t numThreadGroupsY, size_t numThreadGroupsZ);
+	/// <summary> Executes up to maxCommandCount commands of the signature from the argument buffer,
+	///		with the bindings of the compute binder. </summary>
+	void DispatchIndirect(gxapi::ICommandSignature* commandSignature,
+						  unsigned maxCommandCount,
+						  const MemoryObject& argumentBuffer,
+						  size_t argumentBufferOffset);
 
 	// Command list state
 	void ResetState(gxapi::IPipelineState* newState = nullptr);
@@ -39,6 +45,7 @@ public:
 	void BindCompute(BindParameter parameter, const TextureView1D& shaderResource);
 	void BindCompute(BindParameter parameter, const TextureView2D& shaderResource);
 	void BindCompute(BindParameter parameter, const TextureView3D& shaderResource);
+	void BindCompute(BindParameter parameter, const BufferView& shaderResource);
 	void BindCompute(BindParameter parameter, const ConstBufferView& shaderConstant);
 	void BindCompute(BindParameter parameter, const void* shaderConstant, int size, int offset);
 	void BindCompute(BindParameter parameter, const RWTextureView1D& rwResource);
@@ -46,6 +53,8 @@ public:
 	void BindCompute(BindParameter parameter, const RWTextureView3D& rwResource);
 	void BindCompute(BindParameter parameter, const RWBufferView& rwResource);
 
+	const DescriptorTableStatistics& GetComputeBindingStatistics() const { return m_computeBindingManager.GetStatistics(); }
+
 	// UAV barriers
 	void UAVBarrier(MemoryObject& memoryObject);
 protected:
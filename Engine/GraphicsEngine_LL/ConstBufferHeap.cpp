@@ -91,11 +91,14 @@ VolatileConstBuffer ConstantBufferHeap::CreateVolatileBuffer(const void* data, u
 
 
 PersistentConstBuffer ConstantBufferHeap::CreatePersistentBuffer(const void* data, uint32_t dataSize) {
+	// Views of constant buffers must cover a multiple of 256 bytes.
+	uint32_t bufferSize = (uint32_t)SnapUpward(dataSize, CBV_SIZE_ALIGNEMENT);
+
 	MemoryObjDesc objDesc = MemoryObjDesc(
 		m_graphicsApi->CreateCommittedResource(
 			gxapi::HeapProperties{gxapi::eHeapType::UPLOAD},
 			gxapi::eHeapFlags::NONE,
-			gxapi::ResourceDesc::Buffer(dataSize),
+			gxapi::ResourceDesc::Buffer(bufferSize),
 			gxapi::eResourceState::GENERIC_READ
 		)
 	);
@@ -108,7 +111,7 @@ PersistentConstBuffer ConstantBufferHeap::CreatePersistentBuffer(const void* dat
 
 	void* gpuPtr = resource->GetGPUAddress();
 
-	return PersistentConstBuffer(std::move(objDesc), gpuPtr, dataSize, dataSize);
+	return PersistentConstBuffer(std::move(objDesc), gpuPtr, dataSize, bufferSize);
 }
 
 
@@ -143,6 +146,8 @@ void ConstantBufferHeap::OnFrameCompleteDevice(uint64_t frameId) {
 
 
 void ConstantBufferHeap::OnFrameCompleteHost(uint64_t frameId) {
+	// Buffers may be created on other threads while the frame ends, and device events run concurrently.
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_currFrameID++;
 }
 
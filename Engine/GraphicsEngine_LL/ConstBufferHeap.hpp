@@ -67,6 +67,7 @@ protected:
 	// From ( https://msdn.microsoft.com/en-us/library/windows/desktop/dn899216%28v=vs.85%29.aspx )
 	// "Linear subresource copying must be aligned to 512 bytes"
 	static constexpr size_t ALIGNEMENT = 512;
+	static constexpr size_t CBV_SIZE_ALIGNEMENT = 256;
 	static constexpr size_t PAGE_SIZE = 64_Ki;
 
 	static constexpr size_t MAX_PERMANENT_LARGE_PAGE_COUNT = 5;
@@ -3,6 +3,7 @@
 #include "MemoryObject.hpp"
 #include "CopyCommandList.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 
@@ -11,13 +12,172 @@ namespace gxeng {
 namespace impl {
 
 
+static HeapSuballocator::Desc BufferPoolDesc() {
+	// Buffers are always 64KiB aligned, smaller size classes would be wasted.
+	HeapSuballocator::Desc desc;
+	desc.minAlignment = 64 * 1024;
+	return desc;
+}
+
+
+CriticalBufferHeap::State::State() :
+	bufferPool(gxapi::eHeapFlags::ALLOW_ONLY_BUFFERS, BufferPoolDesc()),
+	texturePool(gxapi::eHeapFlags::ALLOW_ONLY_NON_RT_DS_TEXTURES, HeapSuballocator::Desc{})
+{}
+
+
+void CriticalBufferHeap::State::Release(Pool& pool, HeapSuballocator::Allocation allocation) {
+	// Frames that have begun but not completed may still use the resource.
+	if (beganFrameCount <= completedFrameCount) {
+		pool.allocator.Deallocate(allocation);
+	}
+	else {
+		released.push_back({ &pool, allocation, beganFrameCount });
+	}
+}
+
+
+void CriticalBufferHeap::State::DeallocateCompleted() {
+	while (!released.empty() && released.front().frameCount <= completedFrameCount) {
+		released.front().pool->allocator.Deallocate(released.front().allocation);
+		released.pop_front();
+	}
+}
+
 
 CriticalBufferHeap::CriticalBufferHeap(gxapi::IGraphicsApi * graphicsApi) :
-	m_graphicsApi(graphicsApi)
+	m_graphicsApi(graphicsApi),
+	m_state(std::make_shared<State>())
 {}
 
 
-MemoryObjDesc CriticalBufferHeap::Allocate(gxapi::ResourceDesc desc, gxapi::ClearValue* clearValue) {
+MemoryObjDesc CriticalBufferHeap::Allocate(gxapi::ResourceDesc desc, gxapi::ClearValue* clearValue, Placement* placement) {
+	constexpr uint64_t smallTextureAlignment = 4 * 1024;
+
+	bool isBuffer = desc.type == gxapi::eResourceType::BUFFER;
+	bool isTargetTexture = !isBuffer
+		&& ((desc.textureDesc.flags & gxapi::eResourceFlags::ALLOW_RENDER_TARGET) || (desc.textureDesc.flags & gxapi::eResourceFlags::ALLOW_DEPTH_STENCIL));
+
+	// Render targets and depth buffers are big, and are better off with dedicated memory.
+	Pool* pool = nullptr;
+	gxapi::ResourceAllocationInfo info;
+	if (isBuffer) {
+		pool = &m_state->bufferPool;
+		info = m_graphicsApi->GetResourceAllocationInfo(desc);
+	}
+	else if (!isTargetTexture) {
+		pool = &m_state->texturePool;
+
+		// Small textures can be packed at 4KiB boundaries, if the device agrees.
+		gxapi::ResourceDesc smallDesc = desc;
+		smallDesc.textureDesc.alignment = smallTextureAlignment;
+		info = m_graphicsApi->GetResourceAllocationInfo(smallDesc);
+		if (info.alignment == smallTextureAlignment) {
+			desc = smallDesc;
+		}
+		else {
+			info = m_graphicsApi->GetResourceAllocationInfo(desc);
+		}
+	}
+
+	Placement unusedPlacement;
+	placement = placement ? placement : &unusedPlacement;
+	*placement = Placement{};
+
+	if (pool != nullptr) {
+		std::lock_guard<std::mutex> lock(m_state->mtx);
+		if (pool->allocator.IsSupported(info.sizeInBytes, info.alignment)) {
+			return AllocatePlaced(*pool, desc, info, *placement);
+		}
+	}
+
+	return AllocateCommitted(desc, clearValue);
+}
+
+
+std::vector<std::unique_ptr<gxapi::IHeap>> CriticalBufferHeap::ReleaseEmptyHeaps() {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+
+	std::vector<std::unique_ptr<gxapi::IHeap>> heaps;
+	for (Pool* pool : { &m_state->bufferPool, &m_state->texturePool }) {
+		for (uint32_t page : pool->allocator.ReleaseEmptyPages()) {
+			heaps.push_back(std::move(pool->heaps[page]));
+		}
+	}
+	return heaps;
+}
+
+
+CriticalBufferHeap::Statistics CriticalBufferHeap::GetStatistics() const {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+
+	Statistics statistics;
+	statistics.buffers = m_state->bufferPool.allocator.GetStatistics();
+	statistics.textures = m_state->texturePool.allocator.GetStatistics();
+	statistics.committedCount = m_state->committedCount;
+	statistics.releasedCount = m_state->released.size();
+	return statistics;
+}
+
+
+void CriticalBufferHeap::OnFrameBeginHost(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	m_state->beganFrameCount = std::max(m_state->beganFrameCount, frameId + 1);
+}
+
+
+void CriticalBufferHeap::OnFrameCompleteDevice(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	m_state->completedFrameCount = std::max(m_state->completedFrameCount, frameId + 1);
+	m_state->DeallocateCompleted();
+}
+
+
+void CriticalBufferHeap::OnDeviceIdle() {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	m_state->completedFrameCount = m_state->beganFrameCount;
+	m_state->DeallocateCompleted();
+}
+
+
+MemoryObjDesc CriticalBufferHeap::AllocatePlaced(Pool& pool, const gxapi::ResourceDesc& desc, const gxapi::ResourceAllocationInfo& info, Placement& placement) {
+	uint64_t newPageSize;
+	HeapSuballocator::Allocation allocation = pool.allocator.Allocate(info.sizeInBytes, info.alignment, newPageSize);
+
+	gxapi::IResource* resource;
+	try {
+		if (newPageSize != 0) {
+			gxapi::HeapDesc heapDesc(newPageSize, gxapi::HeapProperties(gxapi::eHeapType::DEFAULT), pool.flags);
+			std::unique_ptr<gxapi::IHeap> heap(m_graphicsApi->CreateHeap(heapDesc));
+			if (pool.heaps.size() <= allocation.page) {
+				pool.heaps.resize(allocation.page + 1);
+			}
+			pool.heaps[allocation.page] = std::move(heap);
+		}
+
+		resource = m_graphicsApi->CreatePlacedResource(pool.heaps[allocation.page].get(), allocation.offset, desc, gxapi::eResourceState::COMMON);
+	}
+	catch (...) {
+		pool.allocator.Deallocate(allocation);
+		throw;
+	}
+	placement.heap = pool.heaps[allocation.page].get();
+	placement.newHeapSize = newPageSize;
+
+	MemoryObjDesc result = MemoryObjDesc(resource);
+	MemoryObjDesc::Deleter deleter = result.resource.get_deleter();
+	std::shared_ptr<State> state = m_state;
+	result.resource = MemoryObjDesc::UniqPtr(result.resource.release(), [state, &pool, allocation, deleter](gxapi::IResource* ptr) {
+		deleter(ptr);
+		std::lock_guard<std::mutex> lock(state->mtx);
+		state->Release(pool, allocation);
+	});
+
+	return result;
+}
+
+
+MemoryObjDesc CriticalBufferHeap::AllocateCommitted(const gxapi::ResourceDesc& desc, gxapi::ClearValue* clearValue) {
 	MemoryObjDesc result = MemoryObjDesc(
 		m_graphicsApi->CreateCommittedResource(
 			gxapi::HeapProperties(gxapi::eHeapType::DEFAULT, gxapi::eCpuPageProperty::UNKNOWN, gxapi::eMemoryPool::UNKNOWN),
@@ -28,6 +188,16 @@ MemoryObjDesc CriticalBufferHeap::Allocate(gxapi::ResourceDesc desc, gxapi::Clea
 		)
 	);
 
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	++m_state->committedCount;
+	std::shared_ptr<State> state = m_state;
+	MemoryObjDesc::Deleter deleter = result.resource.get_deleter();
+	result.resource = MemoryObjDesc::UniqPtr(result.resource.release(), [state, deleter](gxapi::IResource* ptr) {
+		deleter(ptr);
+		std::lock_guard<std::mutex> lock(state->mtx);
+		--state->committedCount;
+	});
+
 	return result;
 }
 
@@ -2,21 +2,96 @@
 
 #include "../GraphicsApi_LL/IGraphicsApi.hpp"
 #include "../GraphicsApi_LL/IResource.hpp"
+#include "../GraphicsApi_LL/IHeap.hpp"
 
 #include "MemoryObject.hpp"
+#include "HeapSuballocator.hpp"
+#include "PipelineEventListener.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace inl {
 namespace gxeng {
 
 namespace impl {
 
-class CriticalBufferHeap {
+/// <summary>
+/// Creates default heap resources. Buffers and non render target textures are placed into
+/// a few large heaps, render targets, depth buffers and huge resources get their own committed memory.
+/// The place of a released resource is only reused when the frames that might still use it have completed.
+/// </summary>
+class CriticalBufferHeap : public PipelineEventListener {
+public:
+	struct Statistics {
+		HeapSuballocator::Statistics buffers;
+		HeapSuballocator::Statistics textures;
+		size_t committedCount = 0; // Resources that are not placed.
+		size_t releasedCount = 0; // Places of released resources waiting for the GPU.
+	};
+
+	struct Placement {
+		gxapi::IHeap* heap = nullptr; // The shared heap the resource is placed in, null if it has its own memory.
+		uint64_t newHeapSize = 0; // Size of the heap if it was created for this resource, zero otherwise.
+	};
+
 public:
 	CriticalBufferHeap(gxapi::IGraphicsApi* graphicsApi);
-	MemoryObjDesc Allocate(gxapi::ResourceDesc desc, gxapi::ClearValue* clearValue = nullptr);
+	/// <param name="placement"> Optionally set to where the resource was placed.
+	///		Placed resources can't be made resident or evicted on their own, only together with their heap. </param>
+	MemoryObjDesc Allocate(gxapi::ResourceDesc desc, gxapi::ClearValue* clearValue = nullptr, Placement* placement = nullptr);
+
+	/// <summary> Removes the heaps that hold no resources anymore. </summary>
+	/// <returns> The removed heaps, destroying them is up to the caller. </returns>
+	std::vector<std::unique_ptr<gxapi::IHeap>> ReleaseEmptyHeaps();
+
+	Statistics GetStatistics() const;
+
+	void OnFrameBeginDevice(uint64_t frameId) override {}
+	void OnFrameBeginHost(uint64_t frameId) override;
+	void OnFrameCompleteDevice(uint64_t frameId) override;
+	void OnFrameCompleteHost(uint64_t frameId) override {}
+
+	/// <summary> Reuses the places of all released resources. Call when the GPU has finished every submitted frame. </summary>
+	void OnDeviceIdle();
+
+protected:
+	struct Pool {
+		Pool(gxapi::eHeapFlags flags, HeapSuballocator::Desc desc) : allocator(desc), flags(flags) {}
+		HeapSuballocator allocator;
+		std::vector<std::unique_ptr<gxapi::IHeap>> heaps; // Indexed by the allocator's page.
+		gxapi::eHeapFlags flags;
+	};
+
+	struct Released {
+		Pool* pool;
+		HeapSuballocator::Allocation allocation;
+		uint64_t frameCount; // Reusable when this many frames have completed.
+	};
+
+	// Shared with the deleters of placed resources, which may be released after the heap.
+	struct State {
+		State();
+		void Release(Pool& pool, HeapSuballocator::Allocation allocation);
+		void DeallocateCompleted();
+
+		std::mutex mtx;
+		Pool bufferPool;
+		Pool texturePool;
+		size_t committedCount = 0;
+		std::deque<Released> released; // Oldest first.
+		uint64_t beganFrameCount = 0; // Last frame begun on the host + 1.
+		uint64_t completedFrameCount = 0; // Last frame completed on the device + 1.
+	};
+
+	MemoryObjDesc AllocatePlaced(Pool& pool, const gxapi::ResourceDesc& desc, const gxapi::ResourceAllocationInfo& info, Placement& placement);
+	MemoryObjDesc AllocateCommitted(const gxapi::ResourceDesc& desc, gxapi::ClearValue* clearValue);
 
 protected:
 	gxapi::IGraphicsApi* m_graphicsApi;
+	std::shared_ptr<State> m_state;
 };
 
 
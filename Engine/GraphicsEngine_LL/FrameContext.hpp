@@ -32,10 +32,12 @@ struct FrameContext {
 	ScratchSpacePool* scratchSpacePool = nullptr;
 
 	CommandQueue* commandQueue = nullptr;
+	CommandQueue* copyCommandQueue = nullptr; // optional, uploads go to the graphics queue without it
 	RenderTargetView2D* backBuffer = nullptr;
 	const std::set<Scene*>* scenes = nullptr;
 	const std::set<Camera*>* cameras = nullptr;
 	const std::vector<UploadManager::UploadDescription>* uploadRequests = nullptr;
+	UploadManager* uploadManager = nullptr; // Told when the background uploads of the frame are done.
 	
 	ResourceResidencyQueue* residencyQueue = nullptr;
 
@@ -0,0 +1,242 @@
+#include "GpuScene.hpp"
+
+#include "MeshEntity.hpp"
+#include "OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace inl::gxeng {
+
+
+static uint32_t NextPowerOfTwo(uint32_t value) {
+	uint32_t result = 1;
+	while (result < value) {
+		result *= 2;
+	}
+	return result;
+}
+
+
+size_t GpuScene::DrawKeyHash::operator()(const DrawKey& key) const {
+	size_t hash = std::hash<const void*>()(key.mesh);
+	hash ^= std::hash<uint64_t>()(key.meshVersion) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<const void*>()(key.material) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<size_t>()(key.lod) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+
+void GpuScene::Begin() {
+	for (uint32_t slot : m_dirtySlots) {
+		m_slotDirty[slot] = false;
+	}
+	m_dirtySlots.clear();
+	m_dirtyRanges.clear();
+	m_layoutChanged = false;
+}
+
+
+void GpuScene::Add(const MeshEntity* entity, size_t lod, uint64_t meshVersion, const mathfu::Vector3f& boxMin, const mathfu::Vector3f& boxMax) {
+	uint32_t slot;
+	auto it = m_slots.find(entity);
+	if (it != m_slots.end()) {
+		slot = it->second;
+		if (m_slotAdded[slot]) {
+			return;
+		}
+	}
+	else {
+		if (!m_freeSlots.empty()) {
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else {
+			slot = (uint32_t)m_instances.size();
+			m_instances.emplace_back();
+			m_instances.back().drawIndex = INVALID_DRAW;
+			m_slotEntities.push_back(nullptr);
+			m_slotAdded.push_back(false);
+			m_slotDirty.push_back(false);
+		}
+		m_slots.insert({ entity, slot });
+		m_slotEntities[slot] = entity;
+	}
+	m_slotAdded[slot] = true;
+
+	GpuInstance instance;
+	entity->GetTransform().Pack(instance.world);
+	instance.boxMin = boxMin;
+	instance.drawIndex = GetDraw({ entity->GetMesh(), meshVersion, entity->GetMaterial(), lod });
+	instance.boxMax = boxMax;
+	instance.padding = 0;
+
+	GpuInstance& current = m_instances[slot];
+	if (current.drawIndex != instance.drawIndex) {
+		if (current.drawIndex != INVALID_DRAW) {
+			RemoveFromDraw(current.drawIndex);
+		}
+		DrawState& draw = m_drawStates[instance.drawIndex];
+		if (++draw.instanceCount > draw.capacity) {
+			m_layoutChanged = true;
+		}
+	}
+	if (std::memcmp(&current, &instance, sizeof(instance)) != 0) {
+		current = instance;
+		MarkDirty(slot);
+	}
+}
+
+
+void GpuScene::Build(const CommandWriter& writeCommand) {
+	for (uint32_t slot = 0; slot < m_instances.size(); ++slot) {
+		if (m_slotEntities[slot] != nullptr && !m_slotAdded[slot]) {
+			uint32_t& drawIndex = m_instances[slot].drawIndex;
+			RemoveFromDraw(drawIndex);
+			drawIndex = INVALID_DRAW;
+			MarkDirty(slot);
+
+			m_slots.erase(m_slotEntities[slot]);
+			m_slotEntities[slot] = nullptr;
+			m_freeSlots.push_back(slot);
+		}
+		m_slotAdded[slot] = false;
+	}
+
+	if (m_layoutChanged) {
+		Layout(writeCommand);
+	}
+
+	std::sort(m_dirtySlots.begin(), m_dirtySlots.end());
+	for (uint32_t slot : m_dirtySlots) {
+		if (!m_dirtyRanges.empty() && slot - (m_dirtyRanges.back().first + m_dirtyRanges.back().count) <= MERGE_DISTANCE) {
+			m_dirtyRanges.back().count = slot - m_dirtyRanges.back().first + 1;
+		}
+		else {
+			m_dirtyRanges.push_back({ slot, 1 });
+		}
+	}
+}
+
+
+void GpuScene::Cull(OcclusionCuller& culler, std::vector<GpuCommand>& commands, std::vector<uint32_t>& visibleInstances) const {
+	commands = m_commands;
+	visibleInstances.assign(m_visibleCapacity, 0);
+
+	for (uint32_t slot = 0; slot < m_instances.size(); ++slot) {
+		const GpuInstance& instance = m_instances[slot];
+		if (instance.drawIndex == INVALID_DRAW) {
+			continue;
+		}
+		if (!culler.IsVisible(mathfu::Vector3f(instance.boxMin), mathfu::Vector3f(instance.boxMax), mathfu::Matrix4x4f(instance.world))) {
+			continue;
+		}
+
+		const GpuDraw& draw = m_draws[instance.drawIndex];
+		uint32_t* instanceCount = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(commands.data()) + draw.instanceCountOffset);
+		visibleInstances[draw.firstVisible + (*instanceCount)++] = slot;
+	}
+}
+
+
+uint32_t GpuScene::GetDraw(const DrawKey& key) {
+	auto it = m_drawIndices.find(key);
+	if (it != m_drawIndices.end()) {
+		return it->second;
+	}
+
+	uint32_t index = (uint32_t)m_drawStates.size();
+	m_drawIndices.insert({ key, index });
+	m_drawStates.push_back({ key, 0, 0 });
+	m_layoutChanged = true;
+	return index;
+}
+
+
+void GpuScene::RemoveFromDraw(uint32_t drawIndex) {
+	// The mesh and material of an empty draw may be destroyed any time.
+	if (--m_drawStates[drawIndex].instanceCount == 0) {
+		m_layoutChanged = true;
+	}
+}
+
+
+void GpuScene::Layout(const CommandWriter& writeCommand) {
+	// Draws without instances are dropped, instances of the rest follow their draw's new index.
+	std::vector<uint32_t> newIndices(m_drawStates.size(), INVALID_DRAW);
+	std::vector<DrawState> drawStates;
+	for (uint32_t i = 0; i < m_drawStates.size(); ++i) {
+		if (m_drawStates[i].instanceCount > 0) {
+			newIndices[i] = (uint32_t)drawStates.size();
+			drawStates.push_back(m_drawStates[i]);
+		}
+	}
+	m_drawStates = std::move(drawStates);
+
+	m_drawIndices.clear();
+	for (uint32_t i = 0; i < m_drawStates.size(); ++i) {
+		m_drawIndices.insert({ m_drawStates[i].key, i });
+	}
+	for (uint32_t slot = 0; slot < m_instances.size(); ++slot) {
+		uint32_t& drawIndex = m_instances[slot].drawIndex;
+		if (drawIndex != INVALID_DRAW && newIndices[drawIndex] != drawIndex) {
+			drawIndex = newIndices[drawIndex];
+			MarkDirty(slot);
+		}
+	}
+
+	// Commands of the same material are adjacent, materials in the order of their first draw.
+	std::unordered_map<const Material*, uint32_t> materialOrder;
+	for (const DrawState& draw : m_drawStates) {
+		materialOrder.insert({ draw.key.material, (uint32_t)materialOrder.size() });
+	}
+	std::vector<uint32_t> order(m_drawStates.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+		return materialOrder[m_drawStates[lhs].key.material] < materialOrder[m_drawStates[rhs].key.material];
+	});
+
+	// Regions get room to grow, so that adding a few instances does not lay out everything again.
+	m_draws.resize(m_drawStates.size());
+	m_commands.resize(m_drawStates.size());
+	m_commandMeshes.resize(m_drawStates.size());
+	m_groups.clear();
+	m_visibleCapacity = 0;
+	for (uint32_t commandIndex = 0; commandIndex < order.size(); ++commandIndex) {
+		DrawState& state = m_drawStates[order[commandIndex]];
+		state.capacity = NextPowerOfTwo(state.instanceCount);
+
+		GpuCommand& command = m_commands[commandIndex];
+		command = GpuCommand{};
+		writeCommand(state.key.mesh, state.key.lod, command);
+		m_commandMeshes[commandIndex] = state.key.mesh;
+		command.firstVisible = m_visibleCapacity;
+		command.draw.instanceCount = 0;
+		command.draw.startInstanceLocation = 0;
+
+		GpuDraw& draw = m_draws[order[commandIndex]];
+		draw.firstVisible = m_visibleCapacity;
+		draw.instanceCountOffset = uint32_t(commandIndex * sizeof(GpuCommand) + offsetof(GpuCommand, draw) + offsetof(gxapi::DrawIndexedArguments, instanceCount));
+
+		m_visibleCapacity += state.capacity;
+
+		if (m_groups.empty() || m_groups.back().material != state.key.material) {
+			m_groups.push_back({ state.key.mesh, state.key.material, commandIndex, 0 });
+		}
+		++m_groups.back().commandCount;
+	}
+}
+
+
+void GpuScene::MarkDirty(uint32_t slot) {
+	if (!m_slotDirty[slot]) {
+		m_slotDirty[slot] = true;
+		m_dirtySlots.push_back(slot);
+	}
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <GraphicsApi_LL/Common.hpp>
+
+#include <mathfu/mathfu_exc.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+
+namespace inl::gxeng {
+
+
+class Mesh;
+class Material;
+class MeshEntity;
+class OcclusionCuller;
+
+
+/// <summary> An instance as the culling and the vertex shaders read it. </summary>
+struct GpuInstance {
+	mathfu::VectorPacked<float, 4> world[4]; // Columns of the world matrix.
+	mathfu::VectorPacked<float, 3> boxMin; // Model space bounding box.
+	uint32_t drawIndex; // GpuScene::INVALID_DRAW if the slot is free.
+	mathfu::VectorPacked<float, 3> boxMax;
+	uint32_t padding;
+};
+
+
+/// <summary> Where the culling shader counts and lists the visible instances of a draw. </summary>
+struct GpuDraw {
+	uint32_t firstVisible; // Start of the draw's region in the visible instance list.
+	uint32_t instanceCountOffset; // Byte offset of the draw's instance count in the command buffer.
+};
+
+
+/// <summary> One indirect draw, the arguments in the order of the command signature. </summary>
+struct GpuCommand {
+	gxapi::VertexBufferViewArguments vertexBuffer;
+	gxapi::IndexBufferViewArguments indexBuffer;
+	uint32_t firstVisible; // Root constant, the vertex shader finds its instances from here on in the visible list.
+	gxapi::DrawIndexedArguments draw;
+};
+
+
+static_assert(sizeof(GpuInstance) == 96, "Must match the layout of the shaders.");
+static_assert(sizeof(GpuDraw) == 8, "Must match the layout of the shaders.");
+static_assert(sizeof(GpuCommand) == 56, "Must match the command signature.");
+static_assert(offsetof(GpuCommand, indexBuffer) == 16 && offsetof(GpuCommand, firstVisible) == 32 && offsetof(GpuCommand, draw) == 36, "Must match the command signature.");
+
+
+/// <summary>
+/// Mirrors the instances, draws and indirect commands of mesh entities in the layout of the
+/// persistent GPU buffers, and tracks what changed since the last frame.
+/// </summary>
+/// <remarks>
+/// Entities keep their instance slot as long as they are added every frame, so only changed instances
+/// have to be uploaded. Entities with the same mesh, mesh version, level of detail and material share a draw.
+/// A new mesh version makes a new draw, so the commands are written again with the mesh's new buffers.
+/// Draws of the same material are adjacent commands, a group, executed by a single indirect call.
+/// The visible instance list has a region for each draw, the culling shader counts the visible instances
+/// in the commands and lists their slots in the regions.
+/// When a draw is created, outgrows its region or loses its last instance, the draws and commands are laid out again.
+/// Draws without instances are dropped then, so the scene never refers to the meshes of removed entities.
+/// Usage per frame: <see cref="Begin"/>, <see cref="Add"/> for each entity, <see cref="Build"/>,
+/// then upload <see cref="GetDirtyInstances"/>, and the draws and commands if <see cref="IsLayoutChanged"/>.
+/// </remarks>
+class GpuScene {
+public:
+	static constexpr uint32_t INVALID_DRAW = ~uint32_t(0);
+
+	struct Group {
+		Mesh* mesh; // Of the first command, meshes of the commands share the vertex layout.
+		const Material* material;
+		uint32_t firstCommand;
+		uint32_t commandCount;
+	};
+	struct Range {
+		uint32_t first;
+		uint32_t count;
+	};
+	/// <summary> Fills the buffer views and the index range of the command that draws the mesh's level of detail. </summary>
+	using CommandWriter = std::function<void(Mesh* mesh, size_t lod, GpuCommand& command)>;
+
+public:
+	/// <summary> Forgets the changes of the last frame. </summary>
+	void Begin();
+
+	/// <summary> Adds an entity to be drawn with the given level of detail this frame. </summary>
+	/// <param name="meshVersion"> See <see cref="Mesh::GetVersion"/>. </param>
+	/// <param name="boxMin"> Model space bounding box of the entity's mesh. </param>
+	void Add(const MeshEntity* entity, size_t lod, uint64_t meshVersion, const mathfu::Vector3f& boxMin, const mathfu::Vector3f& boxMax);
+
+	/// <summary> Removes the entities that were not added since <see cref="Begin"/>,
+	///		and lays out the commands again if needed. </summary>
+	void Build(const CommandWriter& writeCommand);
+
+	/// <summary> Does on the CPU what the culling shader does on the GPU.
+	///		Instance counts of the draws are written into a copy of the commands. </summary>
+	void Cull(OcclusionCuller& culler, std::vector<GpuCommand>& commands, std::vector<uint32_t>& visibleInstances) const;
+
+	/// <summary> Indexed by slot, free slots have an invalid draw index. </summary>
+	const std::vector<GpuInstance>& GetInstances() const { return m_instances; }
+	const std::vector<GpuDraw>& GetDraws() const { return m_draws; }
+	/// <summary> Commands with zero instances, the culling pass starts from a copy of these every frame. </summary>
+	const std::vector<GpuCommand>& GetCommands() const { return m_commands; }
+	const std::vector<Group>& GetGroups() const { return m_groups; }
+	/// <summary> The mesh each command draws. </summary>
+	const std::vector<Mesh*>& GetCommandMeshes() const { return m_commandMeshes; }
+	/// <summary> Length of the visible instance list, the sum of the regions of the draws. </summary>
+	uint32_t GetVisibleCapacity() const { return m_visibleCapacity; }
+
+	/// <summary> Slots that changed in the last frame, in increasing order. </summary>
+	const std::vector<Range>& GetDirtyInstances() const { return m_dirtyRanges; }
+	/// <summary> True if the draws and commands changed in the last frame. </summary>
+	bool IsLayoutChanged() const { return m_layoutChanged; }
+private:
+	struct DrawKey {
+		Mesh* mesh;
+		uint64_t meshVersion;
+		const Material* material;
+		size_t lod;
+
+		bool operator==(const DrawKey& rhs) const {
+			return mesh == rhs.mesh && meshVersion == rhs.meshVersion && material == rhs.material && lod == rhs.lod;
+		}
+	};
+	struct DrawKeyHash {
+		size_t operator()(const DrawKey& key) const;
+	};
+	struct DrawState {
+		DrawKey key;
+		uint32_t instanceCount;
+		uint32_t capacity;
+	};
+
+	uint32_t GetDraw(const DrawKey& key);
+	void RemoveFromDraw(uint32_t drawIndex);
+	void Layout(const CommandWriter& writeCommand);
+	void MarkDirty(uint32_t slot);
+private:
+	// Small gaps between changed slots are uploaded too, fewer copies are faster.
+	static constexpr uint32_t MERGE_DISTANCE = 16;
+
+	std::unordered_map<const MeshEntity*, uint32_t> m_slots;
+	std::vector<const MeshEntity*> m_slotEntities; // Null for free slots.
+	std::vector<bool> m_slotAdded; // Added since Begin.
+	std::vector<uint32_t> m_freeSlots;
+	std::vector<GpuInstance> m_instances;
+
+	std::vector<bool> m_slotDirty;
+	std::vector<uint32_t> m_dirtySlots;
+	std::vector<Range> m_dirtyRanges;
+
+	std::unordered_map<DrawKey, uint32_t, DrawKeyHash> m_drawIndices;
+	std::vector<DrawState> m_drawStates;
+	std::vector<GpuDraw> m_draws;
+	std::vector<GpuCommand> m_commands;
+	std::vector<Mesh*> m_commandMeshes;
+	std::vector<Group> m_groups;
+	uint32_t m_visibleCapacity = 0;
+	bool m_layoutChanged = false;
+};
+
+
+} // namespace inl::gxeng
@@ -77,6 +77,13 @@ void GraphicsCommandList::DrawIndexedInstanced(unsigned numIndices,
 	unsigned numInstances,
 	unsigned startInstance)
 {
+	try {
+		m_graphicsBindingManager.PrepareDrawCall();
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_graphicsBindingManager.PrepareDrawCall();
+	}
 	m_commandList->DrawIndexedInstanced(numIndices, startIndex, vertexOffset, numInstances, startInstance);
 	m_graphicsBindingManager.CommitDrawCall();
 }
@@ -86,16 +93,40 @@ void GraphicsCommandList::DrawInstanced(unsigned numVertices,
 	unsigned numInstances,
 	unsigned startInstance)
 {
+	try {
+		m_graphicsBindingManager.PrepareDrawCall();
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_graphicsBindingManager.PrepareDrawCall();
+	}
 	m_commandList->DrawInstanced(numVertices, startVertex, numInstances, startInstance);
 	m_graphicsBindingManager.CommitDrawCall();
 }
 
+void GraphicsCommandList::DrawIndirect(gxapi::ICommandSignature* commandSignature,
+	unsigned maxCommandCount,
+	const MemoryObject& argumentBuffer,
+	size_t argumentBufferOffset)
+{
+	try {
+		m_graphicsBindingManager.PrepareDrawCall();
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_graphicsBindingManager.PrepareDrawCall();
+	}
+	m_commandList->ExecuteIndirect(commandSignature, maxCommandCount, const_cast<gxapi::IResource*>(argumentBuffer._GetResourcePtr()), argumentBufferOffset);
+	m_graphicsBindingManager.CommitDrawCall();
+}
+
 
 //------------------------------------------------------------------------------
 // Input assembler
 //------------------------------------------------------------------------------
 
 void GraphicsCommandList::SetIndexBuffer(const IndexBuffer* resource, bool is32Bit) {
+	UseResource(*resource);
 	m_commandList->SetIndexBuffer(resource->GetVirtualAddress(),
 		resource->GetSize(),
 		is32Bit ? gxapi::eFormat::R32_UINT : gxapi::eFormat::R16_UINT);
@@ -117,6 +148,7 @@ void GraphicsCommandList::SetVertexBuffers(unsigned startSlot,
 
 	for (unsigned i = 0; i < count; ++i) {
 		virtualAddresses[i] = resources[i]->GetVirtualAddress();
+		UseResource(*resources[i]);
 	}
 
 	m_commandList->SetVertexBuffers(startSlot,
@@ -189,6 +221,7 @@ void GraphicsCommandList::SetGraphicsBinder(Binder* binder) {
 
 
 void GraphicsCommandList::BindGraphics(BindParameter parameter, const TextureView1D& shaderResource) {
+	UseResource(shaderResource.GetResource());
 	try {
 		m_graphicsBindingManager.Bind(parameter, shaderResource);
 	}
@@ -199,6 +232,7 @@ void GraphicsCommandList::BindGraphics(BindParameter parameter, const TextureVie
 }
 
 void GraphicsCommandList::BindGraphics(BindParameter parameter, const TextureView2D& shaderResource) {
+	UseResource(shaderResource.GetResource());
 	try {
 		m_graphicsBindingManager.Bind(parameter, shaderResource);
 	}
@@ -209,6 +243,18 @@ void GraphicsCommandList::BindGraphics(BindParameter parameter, const TextureVie
 }
 
 void GraphicsCommandList::BindGraphics(BindParameter parameter, const TextureView3D& shaderResource) {
+	UseResource(shaderResource.GetResource());
+	try {
+		m_graphicsBindingManager.Bind(parameter, shaderResource);
+	}
+	catch (std::bad_alloc&) {
+		NewScratchSpace(1000);
+		m_graphicsBindingManager.Bind(parameter, shaderResource);
+	}
+}
+
+void GraphicsCommandList::BindGraphics(BindParameter parameter, const BufferView& shaderResource) {
+	UseResource(shaderResource.GetResource());
 	try {
 		m_graphicsBindingManager.Bind(parameter, shaderResource);
 	}
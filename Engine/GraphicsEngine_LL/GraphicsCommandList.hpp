@@ -50,6 +50,13 @@ public:
 					   unsigned numInstances = 1,
 					   unsigned startInstance = 0);
 
+	/// <summary> Executes up to maxCommandCount commands of the signature from the argument buffer,
+	///		with the bindings of the graphics binder. </summary>
+	void DrawIndirect(gxapi::ICommandSignature* commandSignature,
+					  unsigned maxCommandCount,
+					  const MemoryObject& argumentBuffer,
+					  size_t argumentBufferOffset);
+
 	//!!! void ExecuteBundle(IGraphicsCommandList* bundle);
 
 	// input assembler
@@ -82,12 +89,15 @@ public:
 	void BindGraphics(BindParameter parameter, const TextureView1D& shaderResource);
 	void BindGraphics(BindParameter parameter, const TextureView2D& shaderResource);
 	void BindGraphics(BindParameter parameter, const TextureView3D& shaderResource);
+	void BindGraphics(BindParameter parameter, const BufferView& shaderResource);
 	void BindGraphics(BindParameter parameter, const ConstBufferView& shaderConstant);
 	void BindGraphics(BindParameter parameter, const void* shaderConstant, int size, int offset);
 	void BindGraphics(BindParameter parameter, const RWTextureView1D& rwResource);
 	void BindGraphics(BindParameter parameter, const RWTextureView2D& rwResource);
 	void BindGraphics(BindParameter parameter, const RWTextureView3D& rwResource);
 	void BindGraphics(BindParameter parameter, const RWBufferView& rwResource);
+
+	const DescriptorTableStatistics& GetGraphicsBindingStatistics() const { return m_graphicsBindingManager.GetStatistics(); }
 protected:
 	virtual Decomposition Decompose() override;
 	virtual void NewScratchSpace(size_t hint) override;
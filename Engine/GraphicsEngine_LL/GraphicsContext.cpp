@@ -1,7 +1,10 @@
 #include "GraphicsContext.hpp"
 #include "MemoryManager.hpp"
+#include "BindlessHeap.hpp"
+#include "PipelineStateCache.hpp"
 
 #include <GraphicsApi_LL/ISwapChain.hpp>
+#include <GraphicsApi_LL/ICommandSignature.hpp>
 
 namespace inl {
 namespace gxeng {
@@ -15,17 +18,23 @@ GraphicsContext::GraphicsContext(MemoryManager* memoryManager,
 								 int deviceCount,
 								 ShaderManager* shaderManager,
 								 gxapi::ISwapChain* swapChain,
-								 gxapi::IGraphicsApi* graphicsApi)
+								 gxapi::IGraphicsApi* graphicsApi,
+								 CompileJobQueue* compileQueue,
+								 BindlessHeap* bindlessHeap,
+								 PipelineStateCache* pipelineStateCache)
 
 	: m_memoryManager(memoryManager),
 	m_srvHeap(srvHeap),
 	m_rtvHeap(rtvHeap),
 	m_dsvHeap(dsvHeap),
+	m_bindlessHeap(bindlessHeap),
 	m_processorCount(processorCount),
 	m_deviceCount(deviceCount),
 	m_shaderManager(shaderManager),
 	m_swapChain(swapChain),
-	m_graphicsApi(graphicsApi)
+	m_graphicsApi(graphicsApi),
+	m_compileQueue(compileQueue),
+	m_pipelineStateCache(pipelineStateCache)
 {}
 
 
@@ -83,6 +92,48 @@ Texture2D GraphicsContext::CreateRWTexture2D(uint64_t width, uint32_t height, gx
 }
 
 
+Texture2D GraphicsContext::CreateTransientRenderTarget2D(uint64_t width, uint32_t height, gxapi::eFormat format, eTransientScope scope, uint16_t arraySize) const {
+	if (m_memoryManager == nullptr) throw std::logic_error("Cannot create texture without memory manager.");
+	if (!m_hasTransientPass) {
+		return CreateRenderTarget2D(width, height, format, arraySize);
+	}
+
+	gxapi::eResourceFlags flags = gxapi::eResourceFlags::ALLOW_RENDER_TARGET;
+
+	Texture2D texture = m_memoryManager->CreateTransientTexture2D(m_transientPass, scope, width, height, format, flags, arraySize);
+	return texture;
+}
+
+
+Texture2D GraphicsContext::CreateTransientDepthStencil2D(uint64_t width, uint32_t height, gxapi::eFormat format, bool shaderResource, eTransientScope scope, uint16_t arraySize) const {
+	if (m_memoryManager == nullptr) throw std::logic_error("Cannot create texture without memory manager.");
+	if (!m_hasTransientPass) {
+		return CreateDepthStencil2D(width, height, format, shaderResource, arraySize);
+	}
+
+	gxapi::eResourceFlags flags = gxapi::eResourceFlags::ALLOW_DEPTH_STENCIL;
+	if (!shaderResource) {
+		flags += gxapi::eResourceFlags::DENY_SHADER_RESOURCE;
+	}
+	Texture2D texture = m_memoryManager->CreateTransientTexture2D(m_transientPass, scope, width, height, format, flags, arraySize);
+	return texture;
+}
+
+
+Texture2D GraphicsContext::CreateTransientRWTexture2D(uint64_t width, uint32_t height, gxapi::eFormat format, bool renderTarget, eTransientScope scope, uint16_t arraySize) const {
+	if (m_memoryManager == nullptr) throw std::logic_error("Cannot create texture without memory manager.");
+	if (!m_hasTransientPass) {
+		return CreateRWTexture2D(width, height, format, renderTarget, arraySize);
+	}
+
+	gxapi::eResourceFlags flags = gxapi::eResourceFlags::ALLOW_UNORDERED_ACCESS;
+	if (renderTarget) { flags += gxapi::eResourceFlags::ALLOW_RENDER_TARGET; }
+
+	Texture2D texture = m_memoryManager->CreateTransientTexture2D(m_transientPass, scope, width, height, format, flags, arraySize);
+	return texture;
+}
+
+
 TextureView2D GraphicsContext::CreateSrv(Texture2D& texture, gxapi::eFormat format, gxapi::SrvTexture2DArray desc) const {
 	if (m_srvHeap == nullptr) throw std::logic_error("Cannot create srv without srv/cbv/uav heap.");
 
@@ -111,16 +162,46 @@ RWTextureView2D GraphicsContext::CreateUav(Texture2D& rwTexture, gxapi::eFormat
 }
 
 
+LinearBuffer GraphicsContext::CreateBuffer(size_t size) const {
+	if (m_memoryManager == nullptr) throw std::logic_error("Cannot create buffer without memory manager.");
+
+	LinearBuffer buffer = m_memoryManager->CreateBuffer(eResourceHeapType::CRITICAL, size);
+	return buffer;
+}
+
+
+LinearBuffer GraphicsContext::CreateRWBuffer(size_t size) const {
+	if (m_memoryManager == nullptr) throw std::logic_error("Cannot create buffer without memory manager.");
+
+	LinearBuffer buffer = m_memoryManager->CreateBuffer(eResourceHeapType::CRITICAL, size, gxapi::eResourceFlags::ALLOW_UNORDERED_ACCESS);
+	return buffer;
+}
+
+
+BufferView GraphicsContext::CreateSrv(LinearBuffer& buffer, gxapi::eFormat format, gxapi::SrvBuffer desc) const {
+	if (m_srvHeap == nullptr) throw std::logic_error("Cannot create srv without srv/cbv/uav heap.");
+
+	return BufferView{ buffer, *m_srvHeap, format, desc };
+}
+
+
+RWBufferView GraphicsContext::CreateUav(LinearBuffer& rwBuffer, gxapi::eFormat format, gxapi::UavBuffer desc) const {
+	if (m_srvHeap == nullptr) throw std::logic_error("Cannot create uav wihtout srv/cbv/uav heap.");
+
+	return RWBufferView{ rwBuffer, *m_srvHeap, format, desc };
+}
+
+
 VertexBuffer GraphicsContext::CreateVertexBuffer(const void* data, size_t size) {
 	VertexBuffer result = m_memoryManager->CreateVertexBuffer(eResourceHeapType::CRITICAL, size);
-	m_memoryManager->GetUploadManager().Upload(result, 0, data, size);
+	m_memoryManager->GetUploadManager().Upload(result, 0, data, size, UploadManager::Priority::VISIBLE);
 	return result;
 }
 
 
 IndexBuffer GraphicsContext::CreateIndexBuffer(const void* data, size_t size, size_t indexCount) {
 	IndexBuffer result = m_memoryManager->CreateIndexBuffer(eResourceHeapType::CRITICAL, size, indexCount);
-	m_memoryManager->GetUploadManager().Upload(result, 0, data, size);
+	m_memoryManager->GetUploadManager().Upload(result, 0, data, size, UploadManager::Priority::VISIBLE);
 	return result;
 }
 
@@ -131,6 +212,12 @@ VolatileConstBuffer GraphicsContext::CreateVolatileConstBuffer(const void * data
 }
 
 
+PersistentConstBuffer GraphicsContext::CreatePersistentConstBuffer(const void* data, size_t size) {
+	PersistentConstBuffer result = m_memoryManager->CreatePersistentConstBuffer(data, (uint32_t)size);
+	return result;
+}
+
+
 ConstBufferView GraphicsContext::CreateCbv(VolatileConstBuffer& buffer, size_t offset, size_t size, VolatileViewHeap& viewHeap) {
 	return ConstBufferView(
 		buffer,
@@ -140,7 +227,17 @@ ConstBufferView GraphicsContext::CreateCbv(VolatileConstBuffer& buffer, size_t o
 }
 
 
+ConstBufferView GraphicsContext::CreateCbv(PersistentConstBuffer& buffer) const {
+	if (m_srvHeap == nullptr) throw std::logic_error("Cannot create cbv without srv/cbv/uav heap.");
+
+	return ConstBufferView(buffer, *m_srvHeap);
+}
+
+
 ShaderProgram GraphicsContext::CreateShader(const std::string& name, ShaderParts stages, const std::string& macros) {
+	if (m_usedShaders != nullptr) {
+		m_usedShaders->insert(name);
+	}
 	return m_shaderManager->CreateShader(name, stages, macros);
 }
 
@@ -148,20 +245,79 @@ ShaderProgram GraphicsContext::CompileShader(const std::string& code, ShaderPart
 	return m_shaderManager->CompileShader(code, stages, macros);
 }
 
-gxapi::IPipelineState* GraphicsContext::CreatePSO(const gxapi::GraphicsPipelineStateDesc& desc) {
-	return m_graphicsApi->CreateGraphicsPipelineState(desc);
+std::shared_ptr<gxapi::IPipelineState> GraphicsContext::CreatePSO(const gxapi::GraphicsPipelineStateDesc& desc) {
+	if (m_pipelineStateCache != nullptr) {
+		return m_pipelineStateCache->GetPipelineState(desc);
+	}
+	return std::shared_ptr<gxapi::IPipelineState>(m_graphicsApi->CreateGraphicsPipelineState(desc));
 }
 
-gxapi::IPipelineState* GraphicsContext::CreatePSO(const gxapi::ComputePipelineStateDesc& desc) {
-	return m_graphicsApi->CreateComputePipelineState(desc);
+std::shared_ptr<gxapi::IPipelineState> GraphicsContext::CreatePSO(const gxapi::ComputePipelineStateDesc& desc) {
+	if (m_pipelineStateCache != nullptr) {
+		return m_pipelineStateCache->GetPipelineState(desc);
+	}
+	return std::shared_ptr<gxapi::IPipelineState>(m_graphicsApi->CreateComputePipelineState(desc));
+}
+
+
+std::shared_future<ShaderProgram> GraphicsContext::CreateShaderAsync(const std::string& name, ShaderParts stages, const std::string& macros) {
+	if (m_usedShaders != nullptr) {
+		m_usedShaders->insert(name);
+	}
+	ShaderManager* shaderManager = m_shaderManager;
+	return RunCompileJob([shaderManager, name, stages, macros] {
+		return shaderManager->CreateShader(name, stages, macros);
+	});
+}
+
+std::shared_future<ShaderProgram> GraphicsContext::CompileShaderAsync(const std::string& code, ShaderParts stages, const std::string& macros) {
+	ShaderManager* shaderManager = m_shaderManager;
+	return RunCompileJob([shaderManager, code, stages, macros] {
+		return shaderManager->CompileShader(code, stages, macros);
+	});
+}
+
+
+std::unique_ptr<gxapi::ICommandSignature> GraphicsContext::CreateCommandSignature(const gxapi::CommandSignatureDesc& desc, const Binder* binder) const {
+	if (m_graphicsApi == nullptr) throw std::logic_error("Cannot create command signature without graphics api.");
+
+	return std::unique_ptr<gxapi::ICommandSignature>(m_graphicsApi->CreateCommandSignature(desc, binder ? binder->GetRootSignature() : nullptr));
 }
 
 
 Binder GraphicsContext::CreateBinder(const std::vector<BindParameterDesc>& parameters, const std::vector<gxapi::StaticSamplerDesc>& staticSamplers) const {
+	if (m_pipelineStateCache != nullptr) {
+		return Binder(m_pipelineStateCache, parameters, staticSamplers);
+	}
 	return Binder(m_graphicsApi, parameters, staticSamplers);
 }
 
 
+Binder GraphicsContext::CreateBindlessBinder(const std::vector<BindParameterDesc>& parameters,
+											 const std::vector<gxapi::StaticSamplerDesc>& staticSamplers,
+											 const std::vector<unsigned>& bindlessSpaces,
+											 gxapi::eShaderVisiblity bindlessVisibility) const
+{
+	if (m_bindlessHeap == nullptr) {
+		throw std::logic_error("The engine has no bindless table.");
+	}
+
+	BindlessTableDesc bindlessTable;
+	bindlessTable.numDescriptors = m_bindlessHeap->GetCapacity();
+	bindlessTable.spaces = bindlessSpaces;
+	bindlessTable.shaderVisibility = bindlessVisibility;
+	if (m_pipelineStateCache != nullptr) {
+		return Binder(m_pipelineStateCache, parameters, staticSamplers, bindlessTable);
+	}
+	return Binder(m_graphicsApi, parameters, staticSamplers, bindlessTable);
+}
+
+
+unsigned GraphicsContext::GetBindlessCapacity() const {
+	return m_bindlessHeap != nullptr ? m_bindlessHeap->GetCapacity() : 0;
+}
+
+
 } // namespace gxeng
 } // namespace inl
 
@@ -3,9 +3,12 @@
 #include "MemoryObject.hpp"
 #include "ResourceView.hpp"
 #include "ShaderManager.hpp"
+#include "CompileJobQueue.hpp"
 #include "VolatileViewHeap.hpp"
 #include "Binder.hpp"
+#include "TransientHeapLayout.hpp"
 #include <cstdint>
+#include <unordered_set>
 
 
 namespace inl {
@@ -16,6 +19,8 @@ class MemoryManager;
 class CbvSrvUavHeap;
 class RTVHeap;
 class DSVHeap;
+class BindlessHeap;
+class PipelineStateCache;
 
 
 class GraphicsContext {
@@ -28,12 +33,21 @@ public:
 					int deviceCount = 0,
 					ShaderManager* shaderManager = nullptr,
 					gxapi::ISwapChain* swapChain = nullptr,
-					gxapi::IGraphicsApi* graphicsApi = nullptr);
+					gxapi::IGraphicsApi* graphicsApi = nullptr,
+					CompileJobQueue* compileQueue = nullptr,
+					BindlessHeap* bindlessHeap = nullptr,
+					PipelineStateCache* pipelineStateCache = nullptr);
 	GraphicsContext(const GraphicsContext& rhs) = default;
 	GraphicsContext(GraphicsContext&& rhs) = default;
 	GraphicsContext& operator=(const GraphicsContext& rhs) = default;
 	GraphicsContext& operator=(GraphicsContext&& rhs) = default;
 
+	/// <summary> Names of shaders created through this context (and its copies) are added to the set,
+	///		so that the user can be reinitialized when they are reloaded. </summary>
+	void SetShaderUsageRecorder(std::unordered_set<std::string>* usedShaders) { m_usedShaders = usedShaders; }
+	/// <summary> Sets the index of the pipeline node using the context, transients are only created if it's set. </summary>
+	void SetTransientPass(unsigned pass) { m_transientPass = pass; m_hasTransientPass = true; }
+
 	// Parallelism
 	int GetProcessorCoreCount() const;
 	int GetGraphicsDeviceCount() const;
@@ -51,22 +65,60 @@ public:
 	DepthStencilView2D CreateDsv(Texture2D& depthStencilView, gxapi::eFormat format, gxapi::DsvTexture2DArray desc) const;
 	RWTextureView2D CreateUav(Texture2D& rwTexture, gxapi::eFormat format, gxapi::UavTexture2DArray desc) const;
 
+	// Create buffers that shaders read, or read and write, their contents persist across frames.
+	LinearBuffer CreateBuffer(size_t size) const;
+	LinearBuffer CreateRWBuffer(size_t size) const;
+	BufferView CreateSrv(LinearBuffer& buffer, gxapi::eFormat format, gxapi::SrvBuffer desc) const;
+	RWBufferView CreateUav(LinearBuffer& rwBuffer, gxapi::eFormat format, gxapi::UavBuffer desc) const;
+
+	// Create textures that only live within a frame, they may share memory with other nodes' transients.
+	// Their contents are undefined when the node's task starts: issue an aliasing barrier, then clear or overwrite them.
+	// Without a pass, these create regular textures.
+	Texture2D CreateTransientRenderTarget2D(uint64_t width, uint32_t height, gxapi::eFormat format, eTransientScope scope, uint16_t arraySize = 1) const;
+	Texture2D CreateTransientDepthStencil2D(uint64_t width, uint32_t height, gxapi::eFormat format, bool shaderResource, eTransientScope scope, uint16_t arraySize = 1) const;
+	Texture2D CreateTransientRWTexture2D(uint64_t width, uint32_t height, gxapi::eFormat format, bool renderTarget, eTransientScope scope, uint16_t arraySize = 1) const;
+
 	// Vertex buffer
 	VertexBuffer CreateVertexBuffer(const void* data, size_t size);
 	IndexBuffer CreateIndexBuffer(const void* data, size_t size, size_t indexCount);
 
 	// Constant buffers
 	VolatileConstBuffer CreateVolatileConstBuffer(const void* data, size_t size);
+	PersistentConstBuffer CreatePersistentConstBuffer(const void* data, size_t size);
 	ConstBufferView CreateCbv(VolatileConstBuffer& buffer, size_t offset, size_t size, VolatileViewHeap& viewHeap);
+	ConstBufferView CreateCbv(PersistentConstBuffer& buffer) const;
 
 	// Shaders and PSOs
 	ShaderProgram CreateShader(const std::string& name, ShaderParts stages, const std::string& macros);
 	ShaderProgram CompileShader(const std::string& code, ShaderParts stages, const std::string& macros);
-	gxapi::IPipelineState* CreatePSO(const gxapi::GraphicsPipelineStateDesc& desc);
-	gxapi::IPipelineState* CreatePSO(const gxapi::ComputePipelineStateDesc& desc);
+	/// <summary> Returns the same PSO for equal descriptions, even across nodes. Safe to call from compile jobs. </summary>
+	std::shared_ptr<gxapi::IPipelineState> CreatePSO(const gxapi::GraphicsPipelineStateDesc& desc);
+	/// <summary> Returns the same PSO for equal descriptions, even across nodes. Safe to call from compile jobs. </summary>
+	std::shared_ptr<gxapi::IPipelineState> CreatePSO(const gxapi::ComputePipelineStateDesc& desc);
+
+	// Background compilation
+	std::shared_future<ShaderProgram> CreateShaderAsync(const std::string& name, ShaderParts stages, const std::string& macros);
+	std::shared_future<ShaderProgram> CompileShaderAsync(const std::string& code, ShaderParts stages, const std::string& macros);
+	/// <summary> Runs the job on the compile workers, or right away if there are none.
+	///		Use it to create PSOs together with their shaders. The job must own everything it uses. </summary>
+	template <class Func>
+	auto RunCompileJob(Func job) -> std::shared_future<decltype(job())>;
 
 	// Binding
 	Binder CreateBinder(const std::vector<BindParameterDesc>& parameters, const std::vector<gxapi::StaticSamplerDesc>& staticSamplers = {}) const;
+	/// <summary> Creates a binder that also has the bindless table, seen as texture arrays at register t0 of the given spaces. </summary>
+	/// <exception cref="std::logic_error"> If the engine has no bindless table. </exception>
+	Binder CreateBindlessBinder(const std::vector<BindParameterDesc>& parameters,
+								const std::vector<gxapi::StaticSamplerDesc>& staticSamplers,
+								const std::vector<unsigned>& bindlessSpaces,
+								gxapi::eShaderVisiblity bindlessVisibility = gxapi::eShaderVisiblity::ALL) const;
+	/// <summary> True if images have bindless indices, see <see cref="BindlessHeap"/>. </summary>
+	bool IsBindless() const { return m_bindlessHeap != nullptr; }
+	/// <summary> Size of the bindless table, zero if there's none. </summary>
+	unsigned GetBindlessCapacity() const;
+	/// <summary> Creates the layout of commands for indirect execution. Root arguments of the commands are
+	///		given as slots of the binder, which may only be null if there are none. </summary>
+	std::unique_ptr<gxapi::ICommandSignature> CreateCommandSignature(const gxapi::CommandSignatureDesc& desc, const Binder* binder) const;
 
 private:
 	// Memory management stuff
@@ -74,17 +126,38 @@ private:
 	CbvSrvUavHeap* m_srvHeap;
 	RTVHeap* m_rtvHeap;
 	DSVHeap* m_dsvHeap;
+	BindlessHeap* m_bindlessHeap;
 	int m_processorCount;
 	int m_deviceCount;
 
 	// Shaders and PSOs
 	ShaderManager* m_shaderManager;
+	CompileJobQueue* m_compileQueue;
+	PipelineStateCache* m_pipelineStateCache;
+	std::unordered_set<std::string>* m_usedShaders = nullptr;
+
+	// Transients
+	unsigned m_transientPass = 0;
+	bool m_hasTransientPass = false;
 
 	gxapi::ISwapChain* m_swapChain;
 	gxapi::IGraphicsApi* m_graphicsApi;
 };
 
 
+template <class Func>
+auto GraphicsContext::RunCompileJob(Func job) -> std::shared_future<decltype(job())> {
+	if (m_compileQueue != nullptr) {
+		return m_compileQueue->Enqueue(std::move(job));
+	}
+
+	std::packaged_task<decltype(job())()> task(std::move(job));
+	auto result = task.get_future().share();
+	task();
+	return result;
+}
+
+
 
 } // namespace gxeng
 } // namespace inl
@@ -4,6 +4,7 @@
 #include "../BaseLibrary/Graph/Node.hpp"
 
 #include <iostream> // only for debugging
+#include <algorithm>
 
 #include "Nodes/Node_FrameCounter.hpp"
 #include "Nodes/Node_FrameColor.hpp"
@@ -16,6 +17,8 @@
 #include "Nodes/Node_ForwardRender.hpp"
 #include "Nodes/Node_DepthPrepass.hpp"
 #include "Nodes/Node_DepthReduction.hpp"
+#include "Nodes/Node_OcclusionCull.hpp"
+#include "Nodes/Node_GpuCull.hpp"
 
 #include "Nodes/Node_GenCSM.hpp"
 #include "Nodes/Node_RenderToBackBuffer.hpp"
@@ -35,21 +38,28 @@ namespace gxeng {
 using namespace gxapi;
 
 
+static const char* PipelineCacheFile = "./PipelineCache.pack";
+
+
 
 GraphicsEngine::GraphicsEngine(GraphicsEngineDesc desc)
 	: m_gxapiManager(desc.gxapiManager),
 	m_graphicsApi(desc.graphicsApi),
 	m_commandAllocatorPool(desc.graphicsApi),
-	m_scratchSpacePool(desc.graphicsApi, gxapi::eDescriptorHeapType::CBV_SRV_UAV),
+	m_bindlessHeap(desc.bindlessTextures ? std::make_unique<BindlessHeap>(desc.graphicsApi) : nullptr),
+	m_scratchSpacePool(desc.graphicsApi, gxapi::eDescriptorHeapType::CBV_SRV_UAV, m_bindlessHeap.get()),
 	m_textureSpace(desc.graphicsApi),
 	m_masterCommandQueue(desc.graphicsApi->CreateCommandQueue(CommandQueueDesc{ eCommandListType::GRAPHICS }), desc.graphicsApi->CreateFence(0)),
-	m_residencyQueue(std::unique_ptr<gxapi::IFence>(desc.graphicsApi->CreateFence(0))),
+	m_copyCommandQueue(desc.graphicsApi, eCommandListType::COPY),
+	m_residencyQueue(std::unique_ptr<gxapi::IFence>(desc.graphicsApi->CreateFence(0)), &m_memoryManager),
 	m_memoryManager(desc.graphicsApi),
 	m_dsvHeap(desc.graphicsApi),
 	m_rtvHeap(desc.graphicsApi),
 	m_persResViewHeap(desc.graphicsApi),
 	m_logger(desc.logger),
-	m_shaderManager(desc.gxapiManager)
+	m_shaderManager(desc.gxapiManager),
+	m_pipelineStateCache(desc.graphicsApi),
+	m_gpuDrivenRendering(desc.gpuDrivenRendering)
 {
 	// Create swapchain
 	SwapChainDesc swapChainDesc;
@@ -75,25 +85,38 @@ GraphicsEngine::GraphicsEngine(GraphicsEngineDesc desc)
 	m_shaderManager.AddSourceDirectory("./Materials");
 #ifdef NDEBUG
 	m_shaderManager.SetShaderCompileFlags(gxapi::eShaderCompileFlags::OPTIMIZATION_HIGH);
+	m_shaderHotReload = false;
 #else
 	gxapi::eShaderCompileFlags flags = gxapi::eShaderCompileFlags::NO_OPTIMIZATION;
 	flags += gxapi::eShaderCompileFlags::DEBUG;
 	m_shaderManager.SetShaderCompileFlags(flags);
+	m_shaderHotReload = true;
 #endif // NDEBUG
+	m_shaderManager.SetCacheFile("./ShaderCache.pack");
+	m_pipelineStateCache.Load(PipelineCacheFile); // Starts empty if there's no file yet.
 
 
 	// Do more stuff...
 	CreatePipeline();
 	m_scheduler.SetPipeline(std::move(m_pipeline));
+	m_shaderManager.FlushCache(); // Don't lose the pipeline's shaders if we crash later.
 
 	// Init logger
 	m_logStreamGeneral = m_logger->CreateLogStream("General");
 	m_logStreamPipeline = m_logger->CreateLogStream("Pipeline");
 
+	auto transients = m_memoryManager.GetTransientStatistics();
+	uint64_t transientHeapBytes = transients.targets.peakReservedBytes + transients.textures.peakReservedBytes;
+	uint64_t transientBytes = transients.targets.peakAllocatedBytes + transients.textures.peakAllocatedBytes;
+	m_logStreamGeneral.Event("Transient textures: " + std::to_string(transientHeapBytes / (1024 * 1024)) + " MiB in heaps, "
+							 + std::to_string(transientBytes / (1024 * 1024)) + " MiB without aliasing.");
+
 	// Init misc stuff
 	m_absoluteTime = decltype(m_absoluteTime)(0);
+	m_lastShaderPoll = m_absoluteTime;
 	m_commandAllocatorPool.SetLogStream(&m_logStreamPipeline);
 
+	m_pipelineEventDispatcher += &m_memoryManager;
 	m_pipelineEventDispatcher += &m_memoryManager.GetUploadManager();
 	// DELETE THIS
 	m_pipelineEventPrinter.SetLog(&m_logStreamPipeline);
@@ -104,6 +127,11 @@ GraphicsEngine::GraphicsEngine(GraphicsEngineDesc desc)
 GraphicsEngine::~GraphicsEngine() {
 	SyncPoint lastSync = m_masterCommandQueue.Signal();
 	lastSync.Wait();
+	SyncPoint lastCopySync = m_copyCommandQueue.Signal(); // Background uploads may still be running.
+	lastCopySync.Wait();
+
+	m_compileQueue.WaitIdle(); // PSOs may still be created in the background.
+	m_pipelineStateCache.Save(PipelineCacheFile);
 }
 
 
@@ -117,6 +145,9 @@ void GraphicsEngine::Update(float elapsed) {
 		m_frameEndFenceValues[backBufferIndex].Wait();
 	}
 
+	// Swap in reloaded shaders between frames
+	UpdateShaderReload();
+
 	// Set up context
 	FrameContext context;
 	context.frameTime = frameTime;
@@ -129,19 +160,22 @@ void GraphicsEngine::Update(float elapsed) {
 	context.scratchSpacePool = &m_scratchSpacePool;
 
 	context.commandQueue = &m_masterCommandQueue;
+	context.copyCommandQueue = &m_copyCommandQueue;
 	context.backBuffer = &m_backBufferHeap->GetBackBuffer(backBufferIndex);
 	context.scenes = &m_scenes;
 	context.cameras = &m_cameras;
 
-	std::vector<UploadManager::UploadDescription> uploadRequests = m_memoryManager.GetUploadManager()._TakeQueuedUploads();
+	std::vector<UploadManager::UploadDescription> uploadRequests = m_memoryManager.GetUploadManager()._TakeQueuedUploads(m_frame);
 	context.uploadRequests = &uploadRequests;
+	context.uploadManager = &m_memoryManager.GetUploadManager();
 
 	context.residencyQueue = &m_residencyQueue;
 
 	// Execute the pipeline
-	m_pipelineEventDispatcher.DispatchFrameBegin(m_frame).wait();
+	m_memoryManager.BeginResidencyFrame(m_frame);
+	m_pipelineEventDispatcher.DispatchFrameBegin(m_frame);
 	m_scheduler.Execute(context);
-	m_pipelineEventDispatcher.DispatchFrameEnd(m_frame).wait();
+	m_pipelineEventDispatcher.DispatchFrameEnd(m_frame);
 
 	// Mark frame completion
 	SyncPoint frameEnd = m_masterCommandQueue.Signal();
@@ -164,12 +198,14 @@ void GraphicsEngine::SetScreenSize(unsigned width, unsigned height) {
 
 	SyncPoint sp = m_masterCommandQueue.Signal();
 	sp.Wait();
+	m_memoryManager.OnDeviceIdle();
 
 	m_backBufferHeap.reset();
 	m_swapChain->Resize(width, height);
 	m_backBufferHeap = std::make_unique<BackBufferManager>(m_graphicsApi, m_swapChain.get());
 
 	InitializeGraphicsNodes();
+	m_memoryManager.ReleaseUnusedTransients(); // Textures of the old size.
 }
 void GraphicsEngine::GetScreenSize(unsigned& width, unsigned& height) {
 	auto desc = m_swapChain->GetDesc();
@@ -186,13 +222,30 @@ bool GraphicsEngine::GetFullScreen() const {
 }
 
 
+OcclusionCuller::Statistics GraphicsEngine::GetOcclusionStatistics() const {
+	return m_occlusionCull ? m_occlusionCull->GetStatistics() : OcclusionCuller::Statistics{};
+}
+
+
+DrawStatistics GraphicsEngine::GetDrawStatistics() const {
+	DrawStatistics statistics;
+	if (m_depthPrepass) {
+		statistics += m_depthPrepass->GetStatistics();
+	}
+	if (m_forwardRender) {
+		statistics += m_forwardRender->GetStatistics();
+	}
+	return statistics;
+}
+
+
 // Resources
 Mesh* GraphicsEngine::CreateMesh() {
 	return new Mesh(&m_memoryManager);
 }
 
 Image* GraphicsEngine::CreateImage() {
-	return new Image(&m_memoryManager, &m_textureSpace);
+	return new Image(&m_memoryManager, &m_textureSpace, m_bindlessHeap.get());
 }
 
 Material* GraphicsEngine::CreateMaterial() {
@@ -268,6 +321,82 @@ MeshEntity* GraphicsEngine::CreateMeshEntity() {
 }
 
 
+void GraphicsEngine::Precompile(const Scene* scene, bool wait) {
+	for (auto node : m_graphicsNodes) {
+		if (auto forwardRender = dynamic_cast<nodes::ForwardRender*>(node)) {
+			forwardRender->Precompile(scene->GetMeshEntities());
+		}
+	}
+
+	if (wait) {
+		m_compileQueue.WaitIdle();
+	}
+}
+
+
+void GraphicsEngine::SetShaderHotReload(bool enable) {
+	m_shaderHotReload = enable;
+}
+
+
+void GraphicsEngine::UpdateShaderReload() {
+	if (m_shaderReload.valid()) {
+		if (m_shaderReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+		bool anyReloaded = false;
+		try {
+			anyReloaded = m_shaderReload.get();
+		}
+		catch (std::exception& ex) {
+			m_logStreamGeneral.Event(std::string("Failed to check shaders for changes: ") + ex.what());
+		}
+		m_shaderReload = {};
+
+		if (anyReloaded) {
+			ShaderManager::ReloadResult result = m_shaderManager.ApplyReloadedShaders();
+			for (auto& error : result.errors) {
+				m_logStreamGeneral.Event(error);
+			}
+
+			// Only the nodes using the shaders have to recreate their PSOs.
+			std::vector<GraphicsNode*> affectedNodes;
+			for (auto node : m_graphicsNodes) {
+				const auto& usedShaders = m_nodeShaders[node];
+				bool affected = std::any_of(result.reloadedShaders.begin(), result.reloadedShaders.end(), [&usedShaders](const std::string& name) {
+					return usedShaders.count(name) > 0;
+				});
+				if (affected) {
+					affectedNodes.push_back(node);
+				}
+			}
+
+			if (!affectedNodes.empty()) {
+				// The old PSOs may still be in use by the GPU, and the nodes' contexts by their compile jobs.
+				SyncPoint sp = m_masterCommandQueue.Signal();
+				sp.Wait();
+				m_memoryManager.OnDeviceIdle();
+				m_compileQueue.WaitIdle();
+
+				for (auto node : affectedNodes) {
+					InitializeGraphicsNode(node);
+				}
+				m_memoryManager.ReleaseUnusedTransients();
+				m_pipelineStateCache.ReleaseUnused(); // PSOs of the replaced shaders.
+			}
+			for (auto& name : result.reloadedShaders) {
+				m_logStreamGeneral.Event("Shader reloaded: " + name);
+			}
+		}
+	}
+
+	if (m_shaderHotReload && m_absoluteTime - m_lastShaderPoll >= std::chrono::seconds(1)) {
+		m_lastShaderPoll = m_absoluteTime;
+		m_shaderReload = m_compileQueue.Enqueue([this] { return m_shaderManager.ReloadShaders(); });
+	}
+}
+
+
 void GraphicsEngine::CreatePipeline() {
 	auto swapChainDesc = m_swapChain->GetDesc();
 
@@ -275,25 +404,43 @@ void GraphicsEngine::CreatePipeline() {
 	std::unique_ptr<nodes::GetCameraByName> getCamera(new nodes::GetCameraByName());
 	std::unique_ptr<nodes::RenderToBackBuffer> renderToBackbuffer(new nodes::RenderToBackBuffer(m_graphicsApi));
 
-	std::unique_ptr<nodes::ForwardRender> forwardRender(new nodes::ForwardRender(m_graphicsApi));
-	std::unique_ptr<nodes::DepthPrepass> depthPrePass(new nodes::DepthPrepass(m_graphicsApi));
+	std::unique_ptr<nodes::OcclusionCull> occlusionCull(new nodes::OcclusionCull());
+	std::unique_ptr<nodes::ForwardRender> forwardRender(new nodes::ForwardRender(m_graphicsApi, m_gpuDrivenRendering));
+	std::unique_ptr<nodes::DepthPrepass> depthPrePass(new nodes::DepthPrepass(m_graphicsApi, m_gpuDrivenRendering));
 	std::unique_ptr<nodes::DepthReduction> depthReduction(new nodes::DepthReduction(m_graphicsApi));
 	std::unique_ptr<nodes::DrawSky> drawSky(new nodes::DrawSky(m_graphicsApi));
 
 	getWorldScene->GetInput<0>().Set("World");
 	getCamera->GetInput<0>().Set("WorldCam");
 
-	depthPrePass->GetInput<0>().Link(getWorldScene->GetOutput(0));
+	occlusionCull->GetInput<0>().Link(getWorldScene->GetOutput(0));
+	occlusionCull->GetInput<1>().Link(getCamera->GetOutput(0));
+
+	depthPrePass->GetInput<0>().Link(occlusionCull->GetOutput(0));
 	depthPrePass->GetInput<1>().Link(getCamera->GetOutput(0));
 
 	//depthReduction->GetInput<0>().Link(depthPrePass->GetOutput(0));
 
 	//forwardRender->GetInput<0>().Link(depthReduction->GetOutput(1));
 	forwardRender->GetInput<0>().Link(depthPrePass->GetOutput(0));
-	forwardRender->GetInput<1>().Link(getWorldScene->GetOutput(0));
+	forwardRender->GetInput<1>().Link(occlusionCull->GetOutput(0));
 	forwardRender->GetInput<2>().Link(getCamera->GetOutput(0));
 	forwardRender->GetInput<3>().Link(getWorldScene->GetOutput(1));
 
+	// The CPU only renders the occluders, the entities are culled against them on the GPU.
+	std::unique_ptr<nodes::GpuCull> gpuCull;
+	if (m_gpuDrivenRendering) {
+		gpuCull.reset(new nodes::GpuCull(m_graphicsApi));
+		occlusionCull->SetCullEntities(false);
+
+		gpuCull->GetInput<0>().Link(getWorldScene->GetOutput(0));
+		gpuCull->GetInput<1>().Link(getCamera->GetOutput(0));
+		gpuCull->GetInput<2>().Link(occlusionCull->GetOutput(1));
+
+		depthPrePass->GetInput<2>().Link(gpuCull->GetOutput(0));
+		forwardRender->GetInput<4>().Link(gpuCull->GetOutput(0));
+	}
+
 	drawSky->GetInput<0>().Link(forwardRender->GetOutput(0));
 	drawSky->GetInput<1>().Link(depthPrePass->GetOutput(0));
 	drawSky->GetInput<2>().Link(getCamera->GetOutput(0));
@@ -303,18 +450,23 @@ void GraphicsEngine::CreatePipeline() {
 	//renderToBackbuffer->GetInput<0>().Link(forwardRender->GetOutput(0));
 	//renderToBackbuffer->GetInput<0>().Link(depthReduction->GetOutput(0));
 
+	m_occlusionCull = occlusionCull.get();
+	m_depthPrepass = depthPrePass.get();
+	m_forwardRender = forwardRender.get();
 	m_graphicsNodes = {
 		getWorldScene.release(),
 		getCamera.release(),
+		occlusionCull.release(),
 		depthPrePass.release(),
 		//depthReduction.release(),
 		forwardRender.release(),
 		renderToBackbuffer.release(),
 		drawSky.release()
 	};
+	if (gpuCull) {
+		m_graphicsNodes.push_back(gpuCull.release());
+	}
 	try {
-		InitializeGraphicsNodes();
-
 		std::vector<exc::NodeBase*> nodeList;
 		nodeList.reserve(m_graphicsNodes.size());
 		for (auto curr : m_graphicsNodes) {
@@ -329,15 +481,105 @@ void GraphicsEngine::CreatePipeline() {
 		for (auto currNode : m_graphicsNodes) {
 			delete currNode;
 		}
+		m_occlusionCull = nullptr;
+		m_depthPrepass = nullptr;
+		m_forwardRender = nullptr;
 		throw;
 	}
+
+	// The pipeline owns the nodes from here. They are initialized after the graph is known,
+	// so that their transient textures can be placed according to it.
+	SetTransientPasses();
+	InitializeGraphicsNodes();
+}
+
+
+void GraphicsEngine::SetTransientPasses() {
+	// Each node is a pass, passes come before those that depend on them, even indirectly.
+	const lemon::ListDigraph& graph = m_pipeline.GetDependencyGraph();
+	const lemon::ListDigraph::NodeMap<exc::NodeBase*>& nodeMap = m_pipeline.GetNodeMap();
+
+	m_nodePasses.clear();
+	lemon::ListDigraph::NodeMap<unsigned> passes(graph);
+	for (lemon::ListDigraph::NodeIt node(graph); node != lemon::INVALID; ++node) {
+		auto it = std::find(m_graphicsNodes.begin(), m_graphicsNodes.end(), nodeMap[node]);
+		assert(it != m_graphicsNodes.end());
+		passes[node] = unsigned(it - m_graphicsNodes.begin());
+		m_nodePasses[*it] = passes[node];
+	}
+
+	std::vector<std::vector<bool>> passOrder(m_graphicsNodes.size(), std::vector<bool>(m_graphicsNodes.size(), false));
+	for (lemon::ListDigraph::NodeIt source(graph); source != lemon::INVALID; ++source) {
+		std::vector<lemon::ListDigraph::Node> stack = { source };
+		while (!stack.empty()) {
+			lemon::ListDigraph::Node node = stack.back();
+			stack.pop_back();
+			for (lemon::ListDigraph::OutArcIt arc(graph, node); arc != lemon::INVALID; ++arc) {
+				lemon::ListDigraph::Node target = graph.target(arc);
+				if (!passOrder[passes[source]][passes[target]]) {
+					passOrder[passes[source]][passes[target]] = true;
+					stack.push_back(target);
+				}
+			}
+		}
+	}
+
+	// A node's transients are read by the nodes linked to its outputs, and by those linked to the outputs they are passed through.
+	std::unordered_map<const exc::InputPortBase*, std::pair<GraphicsNode*, unsigned>> inputOwners;
+	for (GraphicsNode* node : m_graphicsNodes) {
+		for (size_t i = 0; i < node->GetNumInputs(); ++i) {
+			inputOwners[node->GetInput(i)] = { node, unsigned(i) };
+		}
+	}
+
+	std::vector<std::vector<unsigned>> passConsumers(m_graphicsNodes.size());
+	for (unsigned pass = 0; pass < m_graphicsNodes.size(); ++pass) {
+		std::vector<exc::OutputPortBase*> stack;
+		for (size_t i = 0; i < m_graphicsNodes[pass]->GetNumOutputs(); ++i) {
+			stack.push_back(m_graphicsNodes[pass]->GetOutput(i));
+		}
+		std::unordered_set<exc::OutputPortBase*> visited(stack.begin(), stack.end());
+		while (!stack.empty()) {
+			exc::OutputPortBase* output = stack.back();
+			stack.pop_back();
+			for (exc::InputPortBase* input : *output) {
+				auto owner = inputOwners.find(input);
+				if (owner == inputOwners.end()) {
+					continue;
+				}
+				GraphicsNode* consumer = owner->second.first;
+				passConsumers[pass].push_back(unsigned(std::find(m_graphicsNodes.begin(), m_graphicsNodes.end(), consumer) - m_graphicsNodes.begin()));
+				for (auto[inputIndex, outputIndex] : consumer->GetPassThroughPorts()) {
+					if (inputIndex == owner->second.second && visited.insert(consumer->GetOutput(outputIndex)).second) {
+						stack.push_back(consumer->GetOutput(outputIndex));
+					}
+				}
+			}
+		}
+	}
+
+	m_memoryManager.SetTransientPassOrder(std::move(passOrder), std::move(passConsumers));
 }
 
 void GraphicsEngine::InitializeGraphicsNodes() {
-	GraphicsContext graphicsContext(&m_memoryManager, &m_persResViewHeap, &m_rtvHeap, &m_dsvHeap, std::thread::hardware_concurrency(), 1, &m_shaderManager, m_swapChain.get(), m_graphicsApi);
 	for (auto curr : m_graphicsNodes) {
-		curr->InitGraphics(graphicsContext);
+		InitializeGraphicsNode(curr);
+	}
+}
+
+void GraphicsEngine::InitializeGraphicsNode(GraphicsNode* node) {
+	GraphicsContext graphicsContext(&m_memoryManager, &m_persResViewHeap, &m_rtvHeap, &m_dsvHeap, std::thread::hardware_concurrency(), 1, &m_shaderManager, m_swapChain.get(), m_graphicsApi, &m_compileQueue, m_bindlessHeap.get(), &m_pipelineStateCache);
+
+	std::unordered_set<std::string>& usedShaders = m_nodeShaders[node];
+	usedShaders.clear();
+	graphicsContext.SetShaderUsageRecorder(&usedShaders);
+
+	auto pass = m_nodePasses.find(node);
+	if (pass != m_nodePasses.end()) {
+		graphicsContext.SetTransientPass(pass->second);
 	}
+
+	node->InitGraphics(graphicsContext);
 }
 
 
@@ -4,6 +4,7 @@
 #include "Scheduler.hpp"
 #include "CommandAllocatorPool.hpp"
 #include "ScratchSpacePool.hpp"
+#include "BindlessHeap.hpp"
 #include "ResourceResidencyQueue.hpp"
 #include "PipelineEventDispatcher.hpp"
 #include "PipelineEventListener.hpp"
@@ -13,6 +14,10 @@
 #include "MemoryManager.hpp"
 #include "HostDescHeap.hpp"
 #include "ShaderManager.hpp"
+#include "CompileJobQueue.hpp"
+#include "PipelineStateCache.hpp"
+#include "OcclusionCuller.hpp"
+#include "InstanceBatcher.hpp"
 
 #include <GraphicsApi_LL/IGxapiManager.hpp>
 #include <GraphicsApi_LL/IGraphicsApi.hpp>
@@ -38,6 +43,12 @@ class Camera;
 
 class WindowResizeListener;
 
+namespace nodes {
+class OcclusionCull;
+class DepthPrepass;
+class ForwardRender;
+}
+
 
 struct GraphicsEngineDesc {
 	gxapi::IGxapiManager* gxapiManager;
@@ -47,6 +58,8 @@ struct GraphicsEngineDesc {
 	int width;
 	int height;
 	exc::Logger* logger;
+	bool bindlessTextures = false; // Images get indices in a bindless table, and materials index it instead of binding textures.
+	bool gpuDrivenRendering = false; // Entities are kept in GPU buffers, culled by a compute shader and drawn by indirect commands.
 };
 
 
@@ -100,8 +113,26 @@ public:
 	Scene* CreateScene(std::string name);
 	MeshEntity* CreateMeshEntity();
 	Camera* CreateCamera(std::string name);
+
+	/// <summary> Compiles the shaders and PSOs needed to render the scene's entities in the background.
+	///		Entities are not drawn until theirs are ready, so call this at load time to avoid pop-in. </summary>
+	/// <param name="wait"> Blocks until the compilation is finished. </param>
+	void Precompile(const Scene* scene, bool wait);
+
+	/// <summary> Watches the shader files, and reloads the shaders and nodes using them when they change.
+	///		Enabled by default in debug builds. Only shaders created by name are watched,
+	///		material shaders, which nodes compile from generated code, are not reloaded. </summary>
+	void SetShaderHotReload(bool enable);
+
+	/// <summary> Entities culled on the CPU in the last frame, and the occluders that hid them. </summary>
+	OcclusionCuller::Statistics GetOcclusionStatistics() const;
+
+	/// <summary> Instances drawn and draw calls recorded by the scene passes in the last frame. </summary>
+	DrawStatistics GetDrawStatistics() const;
 private:
 	void CreatePipeline();
+	void SetTransientPasses();
+	void UpdateShaderReload();
 private:
 	// Graphics API things
 	gxapi::IGxapiManager* m_gxapiManager; // external resource, we should not delete it
@@ -121,16 +152,31 @@ private:
 
 	// Pipeline Facilities
 	CommandAllocatorPool m_commandAllocatorPool;
+	std::unique_ptr<BindlessHeap> m_bindlessHeap; // Null if bindless textures are disabled. Scratch spaces hold a copy.
 	ScratchSpacePool m_scratchSpacePool; // Creates CBV_SRV_UAV type scratch spaces
 	CbvSrvUavHeap m_textureSpace;
 	Pipeline m_pipeline;
 	Scheduler m_scheduler;
 	ShaderManager m_shaderManager;
+	PipelineStateCache m_pipelineStateCache; // Saved to file on exit, the driver creates known PSOs faster.
+	CompileJobQueue m_compileQueue; // Must be destroyed before the nodes and shader manager used by its jobs.
 	std::vector<SyncPoint> m_frameEndFenceValues;
 	std::vector<GraphicsNode*> m_graphicsNodes;
+	std::unordered_map<GraphicsNode*, std::unordered_set<std::string>> m_nodeShaders; // Names of shaders each node uses.
+	std::unordered_map<GraphicsNode*, unsigned> m_nodePasses; // Index of each node for placing transient textures.
+	nodes::OcclusionCull* m_occlusionCull = nullptr; // Owned by the pipeline.
+	nodes::DepthPrepass* m_depthPrepass = nullptr; // Owned by the pipeline.
+	nodes::ForwardRender* m_forwardRender = nullptr; // Owned by the pipeline.
+	bool m_gpuDrivenRendering;
+
+	// Shader hot reload
+	bool m_shaderHotReload;
+	std::chrono::nanoseconds m_lastShaderPoll;
+	std::shared_future<bool> m_shaderReload; // Checks the files in the background.
 
 	// Pipeline elements
 	CommandQueue m_masterCommandQueue;
+	CommandQueue m_copyCommandQueue;
 	ResourceResidencyQueue m_residencyQueue;
 	PipelineEventDispatcher m_pipelineEventDispatcher;
 	PipelineEventPrinter m_pipelineEventPrinter; // DELETE THIS
@@ -150,6 +196,7 @@ private:
 
 private:
 	void InitializeGraphicsNodes();
+	void InitializeGraphicsNode(GraphicsNode* node);
 };
 
 
@@ -4,6 +4,9 @@
 #include "../BaseLibrary/Graph/Node.hpp"
 #include "Task.hpp"
 
+#include <vector>
+#include <utility>
+
 
 
 namespace inl {
@@ -16,6 +19,10 @@ class GraphicsNode : virtual public exc::NodeBase {
 public:
 	virtual void InitGraphics(const GraphicsContext& context) = 0;
 	virtual Task GetTask() = 0;
+
+	/// <summary> Returns the (input, output) port index pairs where the node forwards its input texture. </summary>
+	/// <remarks> Transient textures passed through stay in use by the nodes linked to the output. </remarks>
+	virtual std::vector<std::pair<unsigned, unsigned>> GetPassThroughPorts() const { return {}; }
 };
 
 
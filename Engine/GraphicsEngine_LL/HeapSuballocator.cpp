@@ -0,0 +1,262 @@
+#include "HeapSuballocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+
+namespace inl::gxeng {
+
+
+HeapSuballocator::HeapSuballocator()
+	: HeapSuballocator(Desc{})
+{}
+
+
+HeapSuballocator::HeapSuballocator(Desc desc)
+	: m_desc(desc)
+{
+	auto isPowerOfTwo = [](uint64_t value) { return value != 0 && (value & (value - 1)) == 0; };
+	if (!isPowerOfTwo(desc.minAlignment) || !isPowerOfTwo(desc.largeGranularity) || desc.largeGranularity < desc.minAlignment) {
+		throw std::invalid_argument("Alignments must be powers of two, and the large granularity can't be less than the minimum alignment.");
+	}
+
+	uint32_t classCount = GetSizeClass(desc.smallSizeLimit, 0) + 1;
+	if (desc.smallPageSize < GetClassSize(classCount - 1) || desc.largePageSize < desc.largeGranularity) {
+		throw std::invalid_argument("Pages must fit at least one allocation.");
+	}
+	m_availablePages.resize(classCount);
+}
+
+
+HeapSuballocator::Allocation HeapSuballocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& newPageSize) {
+	if (!IsSupported(size, alignment)) {
+		throw std::invalid_argument("Allocation size or alignment is not supported.");
+	}
+
+	newPageSize = 0;
+	if (std::max(size, alignment) <= m_desc.smallSizeLimit) {
+		return AllocateSmall(size, GetSizeClass(size, alignment), newPageSize);
+	}
+	else {
+		return AllocateLarge(size, newPageSize);
+	}
+}
+
+
+void HeapSuballocator::Deallocate(const Allocation& allocation) {
+	if (allocation.page >= m_pages.size() || !m_pages[allocation.page].live) {
+		throw std::invalid_argument("Allocation's page does not exist.");
+	}
+
+	Page& page = m_pages[allocation.page];
+	if (page.sizeClass != LARGE_CLASS) {
+		uint64_t classSize = GetClassSize(page.sizeClass);
+		if (allocation.size != classSize || allocation.offset % classSize != 0 || allocation.offset >= page.size || page.allocationCount == 0) {
+			throw std::invalid_argument("Allocation does not belong to its page.");
+		}
+		page.slots->Deallocate(size_t(allocation.offset / classSize));
+		if (!page.hasFreeSlot) {
+			page.hasFreeSlot = true;
+			m_availablePages[page.sizeClass].push_back(allocation.page);
+		}
+	}
+	else {
+		if (allocation.offset % m_desc.largeGranularity != 0) {
+			throw std::invalid_argument("Allocation does not belong to its page.");
+		}
+		page.ranges->Deallocate(size_t(allocation.offset / m_desc.largeGranularity));
+	}
+
+	--page.allocationCount;
+	page.allocatedBytes -= allocation.size;
+	page.requestedBytes -= allocation.requestedSize;
+}
+
+
+bool HeapSuballocator::IsSupported(uint64_t size, uint64_t alignment) const {
+	bool alignmentOk = alignment == 0 || ((alignment & (alignment - 1)) == 0 && alignment <= m_desc.largeGranularity);
+	return size > 0 && size <= m_desc.largePageSize && alignmentOk;
+}
+
+
+std::vector<uint32_t> HeapSuballocator::ReleaseEmptyPages() {
+	std::vector<uint32_t> released;
+
+	for (uint32_t index = 0; index < m_pages.size(); ++index) {
+		Page& page = m_pages[index];
+		if (!page.live || page.allocationCount > 0) {
+			continue;
+		}
+
+		auto& list = page.sizeClass != LARGE_CLASS ? m_availablePages[page.sizeClass] : m_largePages;
+		list.erase(std::remove(list.begin(), list.end(), index), list.end());
+
+		page = Page{};
+		m_releasedPages.push_back(index);
+		released.push_back(index);
+	}
+
+	return released;
+}
+
+
+std::vector<uint32_t> HeapSuballocator::FindSparsePages(float maxUtilization) const {
+	std::vector<uint32_t> sparsePages;
+	for (uint32_t index = 0; index < m_pages.size(); ++index) {
+		if (m_pages[index].live && m_pages[index].allocationCount > 0 && GetPageUtilization(index) <= maxUtilization) {
+			sparsePages.push_back(index);
+		}
+	}
+	return sparsePages;
+}
+
+
+uint64_t HeapSuballocator::GetPageSize(uint32_t page) const {
+	return m_pages.at(page).size;
+}
+
+
+float HeapSuballocator::GetPageUtilization(uint32_t page) const {
+	const Page& p = m_pages.at(page);
+	return p.size > 0 ? float(p.allocatedBytes) / float(p.size) : 0.0f;
+}
+
+
+HeapSuballocator::Statistics HeapSuballocator::GetStatistics() const {
+	Statistics statistics;
+	uint64_t largeFreeBytes = 0;
+	uint64_t largeContiguousFreeBytes = 0;
+
+	for (const Page& page : m_pages) {
+		if (!page.live) {
+			continue;
+		}
+		++statistics.pageCount;
+		statistics.allocationCount += page.allocationCount;
+		statistics.reservedBytes += page.size;
+		statistics.allocatedBytes += page.allocatedBytes;
+		statistics.requestedBytes += page.requestedBytes;
+
+		if (page.sizeClass == LARGE_CLASS) {
+			uint64_t largest = page.ranges->GetLargestFreeBlock() * m_desc.largeGranularity;
+			statistics.largestFreeBlock = std::max(statistics.largestFreeBlock, largest);
+			largeFreeBytes += page.ranges->GetFreeSize() * m_desc.largeGranularity;
+			largeContiguousFreeBytes += largest;
+		}
+	}
+
+	if (largeFreeBytes > 0) {
+		statistics.fragmentation = 1.0f - float(largeContiguousFreeBytes) / float(largeFreeBytes);
+	}
+	return statistics;
+}
+
+
+uint32_t HeapSuballocator::GetSizeClass(uint64_t size, uint64_t alignment) const {
+	uint64_t needed = std::max({ size, alignment, m_desc.minAlignment });
+	uint32_t sizeClass = 0;
+	while (GetClassSize(sizeClass) < needed) {
+		++sizeClass;
+	}
+	return sizeClass;
+}
+
+
+uint32_t HeapSuballocator::NewPage(uint64_t size, uint32_t sizeClass) {
+	uint32_t index;
+	if (!m_releasedPages.empty()) {
+		index = m_releasedPages.back();
+		m_releasedPages.pop_back();
+	}
+	else {
+		index = (uint32_t)m_pages.size();
+		m_pages.push_back({});
+	}
+
+	Page& page = m_pages[index];
+	page.size = size;
+	page.sizeClass = sizeClass;
+	page.live = true;
+	if (sizeClass != LARGE_CLASS) {
+		page.slots = std::make_unique<exc::SlabAllocatorEngine>(size_t(size / GetClassSize(sizeClass)));
+		page.hasFreeSlot = true;
+		m_availablePages[sizeClass].push_back(index);
+	}
+	else {
+		page.ranges = std::make_unique<exc::TlsfAllocationEngine>(size_t(size / m_desc.largeGranularity));
+		m_largePages.push_back(index);
+	}
+
+	return index;
+}
+
+
+HeapSuballocator::Allocation HeapSuballocator::AllocateSmall(uint64_t size, uint32_t sizeClass, uint64_t& newPageSize) {
+	auto& available = m_availablePages[sizeClass];
+	if (available.empty()) {
+		NewPage(m_desc.smallPageSize, sizeClass);
+		newPageSize = m_desc.smallPageSize;
+	}
+
+	uint32_t pageIndex = available.back();
+	Page& page = m_pages[pageIndex];
+	uint64_t classSize = GetClassSize(sizeClass);
+
+	Allocation allocation;
+	allocation.page = pageIndex;
+	allocation.offset = page.slots->Allocate() * classSize;
+	allocation.size = classSize;
+	allocation.requestedSize = size;
+
+	++page.allocationCount;
+	page.allocatedBytes += allocation.size;
+	page.requestedBytes += size;
+	if (page.allocationCount == page.slots->Size()) {
+		page.hasFreeSlot = false;
+		available.pop_back();
+	}
+
+	return allocation;
+}
+
+
+HeapSuballocator::Allocation HeapSuballocator::AllocateLarge(uint64_t size, uint64_t& newPageSize) {
+	size_t units = size_t((size + m_desc.largeGranularity - 1) / m_desc.largeGranularity);
+
+	auto TryPage = [&](uint32_t pageIndex, Allocation& allocation) {
+		Page& page = m_pages[pageIndex];
+		if (page.ranges->GetFreeSize() < units) {
+			return false;
+		}
+		try {
+			allocation.offset = page.ranges->Allocate(units) * m_desc.largeGranularity;
+		}
+		catch (std::bad_alloc&) {
+			return false;
+		}
+		allocation.page = pageIndex;
+		allocation.size = units * m_desc.largeGranularity;
+		allocation.requestedSize = size;
+		++page.allocationCount;
+		page.allocatedBytes += allocation.size;
+		page.requestedBytes += size;
+		return true;
+	};
+
+	Allocation allocation;
+	for (uint32_t pageIndex : m_largePages) {
+		if (TryPage(pageIndex, allocation)) {
+			return allocation;
+		}
+	}
+
+	uint32_t pageIndex = NewPage(m_desc.largePageSize, LARGE_CLASS);
+	newPageSize = m_desc.largePageSize;
+	bool success = TryPage(pageIndex, allocation);
+	assert(success);
+	return allocation;
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <BaseLibrary/Memory/SlabAllocatorEngine.hpp>
+#include <BaseLibrary/Memory/TlsfAllocationEngine.hpp>
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+namespace inl::gxeng {
+
+
+/// <summary>
+/// Places resources into large heaps. Only does the bookkeeping of heap pages and offsets,
+/// the caller creates the actual heaps and places the resources.
+/// </summary>
+/// <remarks>
+/// Small allocations are rounded up to a power of two size class, and each page of
+/// a size class is divided into equal slots. Larger allocations are placed
+/// in bigger pages with a two-level segregated fit allocator. Both are O(1) per page.
+/// Pages are identified by index, a released page's index is reused by the next new page.
+/// Not thread safe.
+/// </remarks>
+class HeapSuballocator {
+public:
+	struct Desc {
+		uint64_t smallPageSize = 4 * 1024 * 1024;
+		uint64_t largePageSize = 64 * 1024 * 1024;
+		uint64_t minAlignment = 4 * 1024; // Size of the smallest size class.
+		uint64_t largeGranularity = 64 * 1024; // Unit of large allocations, also the largest supported alignment.
+		uint64_t smallSizeLimit = 256 * 1024; // Allocations above this are large.
+	};
+
+	struct Allocation {
+		uint32_t page;
+		uint64_t offset; // In bytes, from the start of the page.
+		uint64_t size; // Bytes reserved, may be more than requested.
+		uint64_t requestedSize;
+	};
+
+	struct Statistics {
+		size_t pageCount = 0;
+		size_t allocationCount = 0;
+		uint64_t reservedBytes = 0; // Total size of the pages.
+		uint64_t allocatedBytes = 0; // Including size class and granularity rounding.
+		uint64_t requestedBytes = 0;
+		uint64_t largestFreeBlock = 0; // Largest free range in large pages.
+		float fragmentation = 0.0f; // 1 - largest free range / all free space, over large pages.
+	};
+
+public:
+	HeapSuballocator();
+	explicit HeapSuballocator(Desc desc);
+
+	/// <summary> Reserves space for an allocation. </summary>
+	/// <param name="newPageSize"> Set to the size of the new page if one had to be added, the caller must create a heap for it,
+	///		otherwise set to zero. </param>
+	/// <exception cref="std::invalid_argument"> If the size is zero, the alignment is not supported, or the size
+	///		exceeds the large page size. Use <see cref="IsSupported"/> to check beforehand. </exception>
+	Allocation Allocate(uint64_t size, uint64_t alignment, uint64_t& newPageSize);
+
+	/// <summary> Releases the allocation. Empty pages are kept until <see cref="ReleaseEmptyPages"/>. </summary>
+	/// <exception cref="std::invalid_argument"> If the allocation is not from this suballocator. </exception>
+	void Deallocate(const Allocation& allocation);
+
+	bool IsSupported(uint64_t size, uint64_t alignment) const;
+
+	/// <summary> Frees the bookkeeping of pages that hold no allocations. </summary>
+	/// <returns> The indices of the released pages, the caller should destroy the heaps. </returns>
+	std::vector<uint32_t> ReleaseEmptyPages();
+
+	/// <summary> Pages whose used portion is at most maxUtilization.
+	///		Moving their allocations elsewhere would let the pages be released. </summary>
+	std::vector<uint32_t> FindSparsePages(float maxUtilization) const;
+
+	uint64_t GetPageSize(uint32_t page) const;
+	float GetPageUtilization(uint32_t page) const;
+
+	Statistics GetStatistics() const;
+private:
+	static constexpr uint32_t LARGE_CLASS = ~uint32_t(0);
+
+	struct Page {
+		uint64_t size = 0;
+		uint32_t sizeClass = LARGE_CLASS;
+		size_t allocationCount = 0;
+		uint64_t allocatedBytes = 0;
+		uint64_t requestedBytes = 0;
+		bool live = false;
+		bool hasFreeSlot = false; // Small pages only, whether it's on its class's available list.
+		std::unique_ptr<exc::SlabAllocatorEngine> slots; // Small pages only.
+		std::unique_ptr<exc::TlsfAllocationEngine> ranges; // Large pages only.
+	};
+
+	uint32_t GetSizeClass(uint64_t size, uint64_t alignment) const;
+	uint64_t GetClassSize(uint32_t sizeClass) const { return m_desc.minAlignment << sizeClass; }
+	uint32_t NewPage(uint64_t size, uint32_t sizeClass);
+
+	Allocation AllocateSmall(uint64_t size, uint32_t sizeClass, uint64_t& newPageSize);
+	Allocation AllocateLarge(uint64_t size, uint64_t& newPageSize);
+private:
+	Desc m_desc;
+	std::vector<Page> m_pages;
+	std::vector<uint32_t> m_releasedPages;
+	std::vector<std::vector<uint32_t>> m_availablePages; // Small pages with free slots, per size class.
+	std::vector<uint32_t> m_largePages;
+};
+
+
+} // namespace inl::gxeng
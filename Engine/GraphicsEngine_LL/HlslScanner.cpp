@@ -0,0 +1,251 @@
+#include "HlslScanner.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace inl::gxeng {
+
+
+static inline bool IsIdentifierStart(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool IsIdentifierChar(char c) {
+	return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static inline bool IsSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+auto HlslScanner::Next() -> Token {
+	const size_t size = m_code.size();
+
+	// Skip whitespaces and comments.
+	while (m_position < size) {
+		if (IsSpace(m_code[m_position])) {
+			++m_position;
+			continue;
+		}
+		size_t afterComment = SkipComment(m_position);
+		if (afterComment == m_position) {
+			break;
+		}
+		m_position = afterComment;
+	}
+
+	Token token;
+	token.begin = m_position;
+	if (m_position >= size) {
+		token.type = eTokenType::END;
+		token.end = m_position;
+		return token;
+	}
+
+	char c = m_code[m_position];
+	if (IsIdentifierStart(c)) {
+		token.type = eTokenType::IDENTIFIER;
+		do { ++m_position; } while (m_position < size && IsIdentifierChar(m_code[m_position]));
+	}
+	else if (c >= '0' && c <= '9') {
+		// Covers suffixes, hexadecimals and exponents, though signs of exponents become separate tokens.
+		token.type = eTokenType::NUMBER;
+		do { ++m_position; } while (m_position < size && (IsIdentifierChar(m_code[m_position]) || m_code[m_position] == '.'));
+	}
+	else if (c == '"' || c == '\'') {
+		token.type = eTokenType::STRING;
+		++m_position;
+		while (m_position < size && m_code[m_position] != c && m_code[m_position] != '\n') {
+			m_position += m_code[m_position] == '\\' ? 2 : 1;
+		}
+		m_position = std::min(m_position + 1, size);
+	}
+	else {
+		token.type = eTokenType::PUNCTUATION;
+		++m_position;
+	}
+
+	token.end = m_position;
+	return token;
+}
+
+
+std::string HlslScanner::RemoveComments(const std::string& code) {
+	HlslScanner scanner(code);
+	std::string result;
+	result.reserve(code.size());
+
+	size_t position = 0;
+	while (position < code.size()) {
+		char c = code[position];
+		if (c == '"' || c == '\'') {
+			// Copy literals as they are, they may contain comment markers.
+			scanner.m_position = position;
+			Token literal = scanner.Next();
+			result.append(code, literal.begin, literal.end - literal.begin);
+			position = literal.end;
+			continue;
+		}
+
+		size_t afterComment = scanner.SkipComment(position);
+		if (afterComment == position) {
+			result += c;
+			++position;
+			continue;
+		}
+
+		result += ' ';
+		for (; position < afterComment; ++position) {
+			if (code[position] == '\n') {
+				result += '\n';
+			}
+		}
+	}
+
+	return result;
+}
+
+
+bool HlslScanner::FindFunctionSignature(const std::string& code, const std::string& functionName, FunctionSignature& signature) {
+	HlslScanner scanner(code);
+
+	Token previous = { eTokenType::END, 0, 0 };
+	Token current = scanner.Next();
+	while (current.type != eTokenType::END) {
+		bool isCandidate = current.type == eTokenType::IDENTIFIER
+			&& previous.type == eTokenType::IDENTIFIER
+			&& scanner.TokenEquals(current, functionName);
+		if (!isCandidate) {
+			previous = current;
+			current = scanner.Next();
+			continue;
+		}
+
+		Token returnType = previous;
+		previous = current;
+		current = scanner.Next();
+		if (!scanner.TokenIs(current, '(')) {
+			continue;
+		}
+
+		// Collect the tokens of each parameter until the matching parenthesis.
+		std::vector<std::vector<Token>> parameters(1);
+		int depth = 1;
+		while (depth > 0) {
+			current = scanner.Next();
+			if (current.type == eTokenType::END) {
+				return false;
+			}
+			if (scanner.TokenIs(current, '(')) {
+				++depth;
+			}
+			else if (scanner.TokenIs(current, ')')) {
+				--depth;
+				if (depth == 0) {
+					break;
+				}
+			}
+			else if (depth == 1 && scanner.TokenIs(current, ',')) {
+				parameters.emplace_back();
+				continue;
+			}
+			parameters.back().push_back(current);
+		}
+
+		// A definition must follow, not a semicolon. The return value may have a semantic.
+		previous = current;
+		current = scanner.Next();
+		if (scanner.TokenIs(current, ':')) {
+			previous = scanner.Next();
+			current = previous.type == eTokenType::IDENTIFIER ? scanner.Next() : previous;
+		}
+		if (!scanner.TokenIs(current, '{')) {
+			continue;
+		}
+
+		signature.returnType = code.substr(returnType.begin, returnType.end - returnType.begin);
+		signature.parameters.clear();
+		if (parameters.size() == 1 && parameters[0].empty()) {
+			return true; // No parameters.
+		}
+		for (auto& parameter : parameters) {
+			// Semantics and default values follow the name.
+			auto end = std::find_if(parameter.begin(), parameter.end(), [&](const Token& token) {
+				return scanner.TokenIs(token, ':') || scanner.TokenIs(token, '=');
+			});
+			parameter.erase(end, parameter.end());
+
+			if (parameter.size() < 2 || parameter.back().type != eTokenType::IDENTIFIER) {
+				throw std::invalid_argument("Parameter of " + functionName + " has no type specifier or declaration name.");
+			}
+
+			// The type is everything before the name, words separated by a single space.
+			std::string type;
+			for (size_t i = 0; i + 1 < parameter.size(); ++i) {
+				bool isWord = parameter[i].type != eTokenType::PUNCTUATION;
+				bool previousIsWord = i > 0 && parameter[i - 1].type != eTokenType::PUNCTUATION;
+				if (isWord && previousIsWord) {
+					type += ' ';
+				}
+				type.append(code, parameter[i].begin, parameter[i].end - parameter[i].begin);
+			}
+			const Token& name = parameter.back();
+			signature.parameters.push_back({ std::move(type), code.substr(name.begin, name.end - name.begin) });
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+std::string HlslScanner::RenameIdentifier(const std::string& code, const std::string& from, const std::string& to) {
+	HlslScanner scanner(code);
+	std::string result;
+	result.reserve(code.size());
+
+	// Copy everything between the matches, comments and whitespaces included.
+	size_t copied = 0;
+	for (Token token = scanner.Next(); token.type != eTokenType::END; token = scanner.Next()) {
+		if (token.type == eTokenType::IDENTIFIER && scanner.TokenEquals(token, from)) {
+			result.append(code, copied, token.begin - copied);
+			result += to;
+			copied = token.end;
+		}
+	}
+	result.append(code, copied, code.npos);
+
+	return result;
+}
+
+
+size_t HlslScanner::SkipComment(size_t position) const {
+	if (position + 1 >= m_code.size() || m_code[position] != '/') {
+		return position;
+	}
+
+	if (m_code[position + 1] == '/') {
+		size_t lineEnd = m_code.find('\n', position + 2);
+		return lineEnd != m_code.npos ? lineEnd : m_code.size();
+	}
+	if (m_code[position + 1] == '*') {
+		size_t commentEnd = m_code.find("*/", position + 2);
+		return commentEnd != m_code.npos ? commentEnd + 2 : m_code.size();
+	}
+	return position;
+}
+
+
+bool HlslScanner::TokenEquals(const Token& token, const std::string& text) const {
+	return token.end - token.begin == text.size() && m_code.compare(token.begin, text.size(), text) == 0;
+}
+
+
+bool HlslScanner::TokenIs(const Token& token, char punctuation) const {
+	return token.type == eTokenType::PUNCTUATION && m_code[token.begin] == punctuation;
+}
+
+
+} // namespace inl::gxeng
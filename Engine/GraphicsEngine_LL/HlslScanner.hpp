@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+
+namespace inl::gxeng {
+
+
+/// <summary>
+/// Single pass tokenizer for the bits of HLSL the material system has to understand:
+/// comments, function signatures and identifiers. Everything runs in linear time.
+/// </summary>
+/// <remarks>
+/// It is not a parser, preprocessor directives and macros are treated as ordinary tokens.
+/// Comments and string literals are always skipped, so names inside them are never matched.
+/// </remarks>
+class HlslScanner {
+public:
+	struct FunctionSignature {
+		std::string returnType;
+		std::vector<std::pair<std::string, std::string>> parameters; // {type, name}
+	};
+
+	enum class eTokenType {
+		END,
+		IDENTIFIER, // Keywords included.
+		NUMBER,
+		STRING,
+		PUNCTUATION, // A single character.
+	};
+
+	struct Token {
+		eTokenType type;
+		size_t begin; // Index of the first character in the code.
+		size_t end; // Index past the last character.
+	};
+
+public:
+	HlslScanner(const std::string& code) : m_code(code), m_position(0) {}
+
+	/// <summary> Returns the next token, skipping whitespaces and comments. Returns END repeatedly at the end. </summary>
+	Token Next();
+
+	/// <summary> Replaces comments by whitespaces. Line breaks are kept, so that line numbers don't change. </summary>
+	static std::string RemoveComments(const std::string& code);
+
+	/// <summary> Finds the definition of a function, prototypes and calls are ignored. </summary>
+	/// <returns> False if there is no such function. </returns>
+	/// <exception cref="std::invalid_argument"> If a parameter has no type or no name. </exception>
+	static bool FindFunctionSignature(const std::string& code, const std::string& functionName, FunctionSignature& signature);
+
+	/// <summary> Replaces all occurences of an identifier. Longer identifiers containing it are not affected. </summary>
+	static std::string RenameIdentifier(const std::string& code, const std::string& from, const std::string& to);
+private:
+	/// <summary> Returns the index past the comment starting at position, or position if there's none. </summary>
+	size_t SkipComment(size_t position) const;
+	bool TokenEquals(const Token& token, const std::string& text) const;
+	bool TokenIs(const Token& token, char punctuation) const;
+private:
+	const std::string& m_code;
+	size_t m_position;
+};
+
+
+} // namespace inl::gxeng
@@ -1,24 +1,31 @@
 #include "Image.hpp"
+#include "PixelConverter.hpp"
 
 namespace inl {
 namespace gxeng {
 
 
-Image::Image(MemoryManager* memoryManager, CbvSrvUavHeap* descriptorHeap) {
+Image::Image(MemoryManager* memoryManager, CbvSrvUavHeap* descriptorHeap, BindlessHeap* bindlessHeap) {
 	assert(memoryManager != nullptr);
 	m_memoryManager = memoryManager;
 	m_descriptorHeap = descriptorHeap;
+	m_bindlessHeap = bindlessHeap;
+	m_bindlessIndex = INVALID_BINDLESS_INDEX;
 
 	m_channelCount = 0;
+	m_textureChannelCount = 0;
+	m_compression = eTextureCompression::NONE;
 }
 
 
 Image::~Image() {
-
+	if (m_bindlessIndex != INVALID_BINDLESS_INDEX) {
+		m_bindlessHeap->Remove(m_bindlessIndex);
+	}
 }
 
 
-void Image::SetLayout(size_t width, size_t height, ePixelChannelType channelType, int channelCount, ePixelClass pixelClass) {
+void Image::SetLayout(size_t width, size_t height, ePixelChannelType channelType, int channelCount, ePixelClass pixelClass, int mipCount) {
 	gxapi::eFormat format;
 	int resultChCnt = 0;
 	if (!ConvertFormat(channelType, channelCount, pixelClass, format, resultChCnt)) {
@@ -26,7 +33,7 @@ void Image::SetLayout(size_t width, size_t height, ePixelChannelType channelType
 	}
 
 	try {
-		Texture2D texture = m_memoryManager->CreateTexture2D(eResourceHeapType::CRITICAL, width, (uint32_t)height, format);
+		Texture2D texture = m_memoryManager->CreateTexture2D(eResourceHeapType::CRITICAL, width, (uint32_t)height, format, gxapi::eResourceFlags::NONE, 1, (uint16_t)mipCount);
 		gxapi::SrvTexture2DArray desc;
 		desc.activeArraySize = 1;
 		desc.firstArrayElement = 0;
@@ -35,10 +42,13 @@ void Image::SetLayout(size_t width, size_t height, ePixelChannelType channelType
 		desc.numMipLevels = -1;
 		desc.planeIndex = 0;
 		m_resource.reset(new TextureView2D(texture, *m_descriptorHeap, texture.GetFormat(), desc));
+		UpdateBindlessTable();
 
 		m_channelCount = channelCount;
+		m_textureChannelCount = resultChCnt;
 		m_channelType = channelType;
 		m_pixelClass = pixelClass;
+		m_compression = eTextureCompression::NONE;
 	}
 	catch (...) {
 		// might be able to do something useful
@@ -46,45 +56,87 @@ void Image::SetLayout(size_t width, size_t height, ePixelChannelType channelType
 	}
 }
 
+
+void Image::SetLayout(size_t width, size_t height, eTextureCompression compression, int mipCount) {
+	gxapi::eFormat format;
+	switch (compression) {
+		case eTextureCompression::NONE: format = gxapi::eFormat::R8G8B8A8_UNORM; break;
+		case eTextureCompression::BC1: format = gxapi::eFormat::BC1_UNORM; break;
+		case eTextureCompression::BC3: format = gxapi::eFormat::BC3_UNORM; break;
+		case eTextureCompression::BC5: format = gxapi::eFormat::BC5_UNORM; break;
+		case eTextureCompression::BC7: format = gxapi::eFormat::BC7_UNORM; break;
+		default: throw std::invalid_argument("Unsupported texture compression.");
+	}
+	if (compression != eTextureCompression::NONE && (width % 4 != 0 || height % 4 != 0)) {
+		throw std::invalid_argument("Size of block compressed textures must be a multiple of 4.");
+	}
+
+	Texture2D texture = m_memoryManager->CreateTexture2D(eResourceHeapType::CRITICAL, width, (uint32_t)height, format, gxapi::eResourceFlags::NONE, 1, (uint16_t)mipCount);
+	gxapi::SrvTexture2DArray desc;
+	desc.activeArraySize = 1;
+	desc.firstArrayElement = 0;
+	desc.mipLevelClamping = 0;
+	desc.mostDetailedMip = 0;
+	desc.numMipLevels = -1;
+	desc.planeIndex = 0;
+	m_resource.reset(new TextureView2D(texture, *m_descriptorHeap, texture.GetFormat(), desc));
+	UpdateBindlessTable();
+
+	m_channelCount = compression == eTextureCompression::BC5 ? 2 : 4;
+	m_textureChannelCount = m_channelCount;
+	m_channelType = ePixelChannelType::INT8_NORM;
+	m_pixelClass = ePixelClass::LINEAR;
+	m_compression = compression;
+}
+
 void Image::Update(size_t x, size_t y, size_t width, size_t height, const void* pixels, const IPixelReader& reader, size_t bytesPerRow) {
 	if (!m_resource) {
 		throw std::logic_error("Must create image first.");
 	}
 
+	if (m_compression != eTextureCompression::NONE) {
+		throw std::logic_error("Compressed images are updated by whole mip levels.");
+	}
+
 	if (x + width > GetWidth() || y + height > GetHeight()) {
 		throw std::out_of_range("Destination region out of bounds.");
 	}
 
-	if (GetChannelCount() != 4 && reader.GetChannelCount() == 3) {
-		if (reader.GetChannelCount() != GetChannelCount()
-			|| reader.GetPixelClass() != GetPixelClass()
-			|| reader.GetChannelType() != GetChannelType())
-		{
-			throw std::invalid_argument("Pixel types mismatch, conversion is not supported yet (but will be).");
-		}
+	PixelFormat sourceFormat{ reader.GetChannelType(), reader.GetChannelCount(), reader.GetPixelClass() };
+	PixelFormat textureFormat{ m_channelType, m_textureChannelCount, m_pixelClass };
+	UploadManager& uploadManager = m_memoryManager->GetUploadManager();
+
+	if (sourceFormat == textureFormat) {
+		uploadManager.Upload(m_resource->GetResource(), (uint32_t)x, (uint32_t)y, pixels, width, (uint32_t)height, m_resource->GetFormat(), bytesPerRow);
+		return;
 	}
 
-	// convert 3 channel pixels to 4 channels
-	std::unique_ptr<uint8_t> pixels4;
-	if (reader.GetChannelCount() == 3) {
-		size_t structureSize = reader.StructureSize();
-		size_t structureSize4 = structureSize * 4 / 3;
-		size_t channelSize = structureSize / 3;
-		pixels4.reset(new uint8_t[structureSize4 * width * height]);
-		size_t dstPitch = width * structureSize4;
-		size_t srcPitch = bytesPerRow > 0 ? bytesPerRow : width * structureSize;
-		for (size_t y = 0; y < height; ++y) {
-			for (size_t x = 0; x < height; ++x) {
-				uint8_t* dst = pixels4.get() + (y * dstPitch + x * structureSize4);
-				memcpy(dst, (uint8_t*)pixels + (y * srcPitch + x * structureSize), structureSize);
-				memset(dst + structureSize, 0, channelSize);
-			}
-		}
-		pixels = pixels4.get();
+	// Convert the pixels right into the staging memory.
+	PixelConverter::Kernel kernel = PixelConverter::Find(sourceFormat, textureFormat);
+	if (kernel == nullptr) {
+		throw std::invalid_argument("Pixel types mismatch, there is no conversion between them.");
+	}
+
+	size_t srcPitch = bytesPerRow > 0 ? bytesPerRow : width * sourceFormat.GetSize();
+	auto ConvertRows = [&](uint32_t firstRow, uint32_t numRows, uint8_t* destination, size_t destinationPitch) {
+		PixelConverter::Convert(kernel,
+								(const uint8_t*)pixels + firstRow * srcPitch, srcPitch,
+								destination, destinationPitch,
+								width, numRows);
+	};
+	uploadManager.Upload(m_resource->GetResource(), (uint32_t)x, (uint32_t)y, width, (uint32_t)height, m_resource->GetFormat(), ConvertRows);
+}
+
+
+void Image::UpdateMip(int mipLevel, const void* data, size_t bytesPerRow) {
+	if (!m_resource) {
+		throw std::logic_error("Must create image first.");
+	}
+	if (mipLevel < 0 || mipLevel >= GetMipCount()) {
+		throw std::out_of_range("Image does not have that many mip levels.");
 	}
 
-	// upload data to gpu
-	m_memoryManager->GetUploadManager().Upload(m_resource->GetResource(), (uint32_t)x, (uint32_t)y, pixels, width, (uint32_t)height, m_resource->GetFormat(), bytesPerRow);
+	m_memoryManager->GetUploadManager().UploadMip(m_resource->GetResource(), (uint32_t)mipLevel, data, bytesPerRow);
 }
 
 
@@ -118,12 +170,52 @@ ePixelClass Image::GetPixelClass() const {
 	return m_pixelClass;
 }
 
+eTextureCompression Image::GetCompression() const {
+	return m_compression;
+}
+
+int Image::GetMipCount() const {
+	if (m_resource) {
+		return m_resource->GetResource().GetDescription().textureDesc.mipLevels;
+	}
+	else {
+		return 0;
+	}
+}
+
+bool Image::HasPendingUploads() const {
+	return m_resource && m_resource->GetResource().HasPendingUploads();
+}
+
 
 std::shared_ptr<const TextureView2D> Image::GetSrv() {
 	return m_resource;
 }
 
 
+uint32_t Image::GetBindlessIndex() const {
+	if (m_bindlessIndex == INVALID_BINDLESS_INDEX) {
+		throw std::logic_error("Image has no bindless index.");
+	}
+	return m_bindlessIndex;
+}
+
+
+void Image::UpdateBindlessTable() {
+	if (m_bindlessHeap == nullptr) {
+		return;
+	}
+
+	// Keep the index, materials may have packed it in their constants already.
+	if (m_bindlessIndex == INVALID_BINDLESS_INDEX) {
+		m_bindlessIndex = m_bindlessHeap->Add(m_resource->GetHandle());
+	}
+	else {
+		m_bindlessHeap->Set(m_bindlessIndex, m_resource->GetHandle());
+	}
+}
+
+
 bool Image::ConvertFormat(ePixelChannelType channelType, int channelCount, ePixelClass pixelClass, gxapi::eFormat& fmt, int& resultingChannelCount) {
 	using gxapi::eFormat;
 
@@ -5,28 +5,55 @@
 #include "Pixel.hpp"
 #include "MemoryManager.hpp"
 #include "ResourceView.hpp"
+#include "BindlessHeap.hpp"
 
 
 namespace inl {
 namespace gxeng {
 
 
+/// <summary> Block compression of textures, uncompressed textures are 8 bit RGBA. </summary>
+enum class eTextureCompression {
+	NONE,
+	BC1,
+	BC3,
+	BC5,
+	BC7,
+};
+
 
 class Image {
 public:
-	Image(MemoryManager* memoryManager, CbvSrvUavHeap* descriptorHeap);
+	/// <param name="bindlessHeap"> The image gets an index in this table if not null. </param>
+	Image(MemoryManager* memoryManager, CbvSrvUavHeap* descriptorHeap, BindlessHeap* bindlessHeap = nullptr);
 	~Image();
 
-	void SetLayout(size_t width, size_t height, ePixelChannelType channelType, int channelCount, ePixelClass pixelClass);
+	void SetLayout(size_t width, size_t height, ePixelChannelType channelType, int channelCount, ePixelClass pixelClass, int mipCount = 1);
+	/// <summary> Creates a texture for cooked mips, which are uploaded as they are by <see cref="UpdateMip"/>. </summary>
+	/// <exception cref="std::invalid_argument"> If the size of a compressed texture is not a multiple of 4. </exception>
+	void SetLayout(size_t width, size_t height, eTextureCompression compression, int mipCount);
+	/// <summary> Uploads a region of the image. The pixels are converted to the image's format if needed. </summary>
+	/// <exception cref="std::invalid_argument"> If there is no conversion between the formats. </exception>
 	void Update(size_t x, size_t y, size_t width, size_t height, const void* pixels, const IPixelReader& reader, size_t bytesPerRow = 0);
+	/// <summary> Uploads a whole mip level in the texture's format: rows of 4x4 blocks for compressed textures, RGBA pixels otherwise. </summary>
+	/// <param name="bytesPerRow"> Pitch of the rows in the data, zero if they are tightly packed. </param>
+	void UpdateMip(int mipLevel, const void* data, size_t bytesPerRow = 0);
 
 	size_t GetWidth();
 	size_t GetHeight();
 	ePixelChannelType GetChannelType() const;
 	int GetChannelCount() const;
 	ePixelClass GetPixelClass() const;
+	eTextureCompression GetCompression() const;
+	int GetMipCount() const;
+
+	/// <summary> True while the pixels are still being uploaded. </summary>
+	bool HasPendingUploads() const;
 
 	std::shared_ptr<const TextureView2D> GetSrv();
+	/// <summary> The index of the SRV in the bindless table. It stays the same when the layout changes. </summary>
+	/// <exception cref="std::logic_error"> If the image has no layout, or the engine has no bindless table. </exception>
+	uint32_t GetBindlessIndex() const;
 protected:
 	static bool Image::ConvertFormat(ePixelChannelType channelType, int channelCount, ePixelClass pixelClass, gxapi::eFormat& fmt, int& resultingChannelCount);
 private:
@@ -34,9 +61,15 @@ private:
 	ePixelChannelType m_channelType;
 	int m_channelCount;
 	ePixelClass m_pixelClass;
+	int m_textureChannelCount; // 3 channel images are stored with 4 channels for some types
+	eTextureCompression m_compression;
 	MemoryManager* m_memoryManager;
 	CbvSrvUavHeap* m_descriptorHeap;
-
+	BindlessHeap* m_bindlessHeap;
+	uint32_t m_bindlessIndex;
+	static constexpr uint32_t INVALID_BINDLESS_INDEX = ~uint32_t(0);
+private:
+	void UpdateBindlessTable();
 };
 
 
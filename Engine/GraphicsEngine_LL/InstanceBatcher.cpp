@@ -0,0 +1,76 @@
+#include "InstanceBatcher.hpp"
+
+#include "MeshEntity.hpp"
+
+#include <algorithm>
+#include <functional>
+
+
+namespace inl::gxeng {
+
+
+size_t InstanceBatcher::KeyHash::operator()(const Key& key) const {
+	size_t hash = std::hash<const void*>()(key.mesh);
+	hash ^= std::hash<const void*>()(key.material) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	hash ^= std::hash<size_t>()(key.lod) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+
+void InstanceBatcher::Clear() {
+	m_groupIndices.clear();
+	m_groups.clear();
+	m_entries.clear();
+	m_batches.clear();
+	m_instances.clear();
+}
+
+
+void InstanceBatcher::Add(const MeshEntity* entity, size_t lod, const Material* material) {
+	Key key{ entity->GetMesh(), material, lod };
+	auto it = m_groupIndices.find(key);
+	if (it == m_groupIndices.end()) {
+		it = m_groupIndices.insert({ key, (uint32_t)m_groups.size() }).first;
+		m_groups.push_back(key);
+	}
+	m_entries.push_back({ entity, it->second });
+}
+
+
+void InstanceBatcher::Build() {
+	// Counting sort by group keeps the order of entities within each group.
+	m_groupOffsets.assign(m_groups.size() + 1, 0);
+	for (const Entry& entry : m_entries) {
+		++m_groupOffsets[entry.group + 1];
+	}
+	for (size_t i = 1; i < m_groupOffsets.size(); ++i) {
+		m_groupOffsets[i] += m_groupOffsets[i - 1];
+	}
+
+	m_instances.resize(m_entries.size());
+	for (const Entry& entry : m_entries) {
+		m_instances[m_groupOffsets[entry.group]++] = entry.entity;
+	}
+
+	// The offsets were advanced to the end of each group.
+	m_batches.clear();
+	for (size_t i = 0; i < m_groups.size(); ++i) {
+		const Key& key = m_groups[i];
+		uint32_t begin = i == 0 ? 0 : m_groupOffsets[i - 1];
+		uint32_t end = m_groupOffsets[i];
+		for (uint32_t first = begin; first < end; first += MAX_INSTANCES) {
+			m_batches.push_back({ key.mesh, key.material, key.lod, first, std::min(MAX_INSTANCES, end - first) });
+		}
+	}
+}
+
+
+void InstanceBatcher::PackTransforms(const Batch& batch, std::vector<mathfu::VectorPacked<float, 4>>& transforms) const {
+	transforms.resize(4 * batch.instanceCount);
+	for (uint32_t i = 0; i < batch.instanceCount; ++i) {
+		m_instances[batch.firstInstance + i]->GetTransform().Pack(&transforms[4 * i]);
+	}
+}
+
+
+} // namespace inl::gxeng
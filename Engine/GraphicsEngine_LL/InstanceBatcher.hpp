@@ -0,0 +1,100 @@
+#pragma once
+
+#include <mathfu/mathfu_exc.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+namespace inl::gxeng {
+
+
+class Mesh;
+class Material;
+class MeshEntity;
+
+
+/// <summary>
+/// Draw calls issued by a render pass in the last frame, and the time it took to record them.
+/// </summary>
+struct DrawStatistics {
+	size_t instanceCount = 0;
+	size_t drawCount = 0;
+	std::chrono::microseconds recordTime = std::chrono::microseconds(0);
+
+	DrawStatistics& operator+=(const DrawStatistics& rhs) {
+		instanceCount += rhs.instanceCount;
+		drawCount += rhs.drawCount;
+		recordTime += rhs.recordTime;
+		return *this;
+	}
+};
+
+
+/// <summary>
+/// Groups entities that can be drawn with a single instanced draw call:
+/// those with the same mesh, level of detail and material.
+/// </summary>
+/// <remarks>
+/// Batches come in the order their first entity was added, entities keep their order within a batch.
+/// Batches are split at <see cref="MAX_INSTANCES"/>, which is how many world matrices fit
+/// in a constant buffer.
+/// Usage per frame: <see cref="Clear"/>, <see cref="Add"/> for each entity, <see cref="Build"/>.
+/// </remarks>
+class InstanceBatcher {
+public:
+	static constexpr uint32_t MAX_INSTANCES = 1024;
+
+	struct Batch {
+		Mesh* mesh;
+		const Material* material;
+		size_t lod;
+		uint32_t firstInstance; // Index in GetInstances().
+		uint32_t instanceCount;
+	};
+
+public:
+	void Clear();
+
+	/// <summary> Adds an entity to be drawn with the given level of detail. </summary>
+	/// <param name="material"> Entities are only batched with the same material. Pass null if the pass ignores materials. </param>
+	void Add(const MeshEntity* entity, size_t lod, const Material* material);
+
+	/// <summary> Sorts the entities added since <see cref="Clear"/> into batches. </summary>
+	void Build();
+
+	/// <summary> Writes the world matrix of each instance of the batch, four columns each, in instance order. </summary>
+	void PackTransforms(const Batch& batch, std::vector<mathfu::VectorPacked<float, 4>>& transforms) const;
+
+	const std::vector<Batch>& GetBatches() const { return m_batches; }
+	const std::vector<const MeshEntity*>& GetInstances() const { return m_instances; }
+private:
+	struct Key {
+		Mesh* mesh;
+		const Material* material;
+		size_t lod;
+
+		bool operator==(const Key& rhs) const { return mesh == rhs.mesh && material == rhs.material && lod == rhs.lod; }
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+	struct Entry {
+		const MeshEntity* entity;
+		uint32_t group;
+	};
+private:
+	std::unordered_map<Key, uint32_t, KeyHash> m_groupIndices;
+	std::vector<Key> m_groups; // In the order of the first entity of each.
+	std::vector<uint32_t> m_groupOffsets;
+	std::vector<Entry> m_entries;
+
+	std::vector<Batch> m_batches;
+	std::vector<const MeshEntity*> m_instances;
+};
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,73 @@
+#include "LodSelector.hpp"
+
+#include "Camera.hpp"
+#include "MeshEntity.hpp"
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace inl::gxeng {
+
+
+LodSelector::LodSelector(const Camera* camera, unsigned viewportHeight)
+	: m_cameraPosition(camera->GetPosition()),
+	m_nearPlane(camera->GetNearPlane())
+{
+	// A unit long segment at unit distance facing the camera covers this many pixels.
+	m_pixelsPerUnitAtUnitDistance = float(viewportHeight) / (2.0f * std::tan(camera->GetFOVVertical() * 0.5f));
+}
+
+
+size_t LodSelector::SelectLod(const MeshEntity& entity) const {
+	const Mesh* mesh = entity.GetMesh();
+	size_t lodCount = mesh->GetLodCount();
+	if (lodCount <= 1) {
+		return 0;
+	}
+
+	float worldRadius;
+	float pixelsPerUnit = GetPixelsPerUnit(entity, worldRadius);
+	if (2.0f * worldRadius * pixelsPerUnit < m_minimumProjectedSize) {
+		return lodCount - 1;
+	}
+
+	mathfu::Vector3f scale = entity.GetScale();
+	float maxScale = std::max({ std::abs(scale.x()), std::abs(scale.y()), std::abs(scale.z()) });
+
+	// Errors grow with the level, so look for the first one that's too coarse.
+	size_t lod = 0;
+	while (lod + 1 < lodCount && mesh->GetLodError(lod + 1) * maxScale * pixelsPerUnit <= m_pixelErrorTolerance) {
+		++lod;
+	}
+	return lod;
+}
+
+
+float LodSelector::GetProjectedSize(const MeshEntity& entity) const {
+	float worldRadius;
+	float pixelsPerUnit = GetPixelsPerUnit(entity, worldRadius);
+	return 2.0f * worldRadius * pixelsPerUnit;
+}
+
+
+float LodSelector::GetPixelsPerUnit(const MeshEntity& entity, float& worldRadius) const {
+	const Mesh* mesh = entity.GetMesh();
+	mathfu::Vector3f scale = entity.GetScale();
+	float maxScale = std::max({ std::abs(scale.x()), std::abs(scale.y()), std::abs(scale.z()) });
+
+	mathfu::Vector4f localCenter(mesh->GetBoundingSphereCenter(), 1.0f);
+	mathfu::Vector3f worldCenter = (entity.GetTransform() * localCenter).xyz();
+	worldRadius = mesh->GetBoundingSphereRadius() * maxScale;
+
+	// Distance to the closest point of the bounding sphere, so that
+	// the error is never underestimated for any part of the mesh.
+	float distance = (worldCenter - m_cameraPosition).Length() - worldRadius;
+	distance = std::max(distance, m_nearPlane);
+
+	return m_pixelsPerUnitAtUnitDistance / distance;
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <mathfu/mathfu_exc.hpp>
+
+#include <cstddef>
+
+
+namespace inl::gxeng {
+
+
+class Camera;
+class MeshEntity;
+
+
+/// <summary>
+/// Chooses the level of detail of mesh entities based on how large their simplification
+/// error appears on the screen from the given camera.
+/// </summary>
+/// <remarks>
+/// The selection is deterministic for the same camera and viewport, which is important
+/// because passes that rely on depth equality (depth prepass and forward render)
+/// must draw the very same triangles.
+/// </remarks>
+class LodSelector {
+public:
+	LodSelector(const Camera* camera, unsigned viewportHeight);
+
+	/// <summary> Largest acceptable screen-space deviation from the full-detail mesh, in pixels. </summary>
+	void SetPixelErrorTolerance(float pixels) { m_pixelErrorTolerance = pixels; }
+	/// <summary> Entities that are projected smaller than this (bounding sphere diameter, in pixels)
+	///		always get the coarsest level. </summary>
+	void SetMinimumProjectedSize(float pixels) { m_minimumProjectedSize = pixels; }
+
+	/// <summary> Returns the index of the coarsest level whose error is within tolerance. </summary>
+	size_t SelectLod(const MeshEntity& entity) const;
+
+	/// <summary> Diameter of the entity's bounding sphere on the screen, in pixels. </summary>
+	float GetProjectedSize(const MeshEntity& entity) const;
+private:
+	float GetPixelsPerUnit(const MeshEntity& entity, float& worldRadius) const;
+private:
+	mathfu::Vector3f m_cameraPosition;
+	float m_nearPlane;
+	float m_pixelsPerUnitAtUnitDistance;
+	float m_pixelErrorTolerance = 1.0f;
+	float m_minimumProjectedSize = 2.0f;
+};
+
+
+} // namespace inl::gxeng
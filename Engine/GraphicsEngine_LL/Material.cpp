@@ -1,5 +1,9 @@
 #include "Material.hpp"
 #include <stack>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstring>
 
 
 
@@ -18,18 +22,54 @@ std::string MaterialShader::LoadShaderSource(std::string name) const {
 std::vector<MaterialShaderParameter> MaterialShader::GetShaderParameters() const {
 	std::vector<MaterialShaderParameter> params;
 	eMaterialShaderParamType ret;
-	ExtractShaderParameters(GetShaderCode(), "main", ret, params);
+	GetSignature(ret, params);
 	return params;
 }
 
 eMaterialShaderParamType MaterialShader::GetShaderOutputType() const {
 	std::vector<MaterialShaderParameter> params;
 	eMaterialShaderParamType ret;
-	ExtractShaderParameters(GetShaderCode(), "main", ret, params);
+	GetSignature(ret, params);
 	return ret;
 }
 
 
+void MaterialShader::GetSignature(eMaterialShaderParamType& returnType, std::vector<MaterialShaderParameter>& parameters) const {
+	struct Signature {
+		eMaterialShaderParamType returnType;
+		std::vector<MaterialShaderParameter> parameters;
+	};
+	// Many materials share the same few shaders, and the signature is queried over and over.
+	// Keyed on the whole source, shaders with colliding hashes must not share signatures.
+	static std::mutex cacheMutex;
+	static std::unordered_map<std::string, Signature> cache;
+	constexpr size_t maxCachedSignatures = 256;
+
+	std::string code = GetShaderCode();
+	{
+		std::lock_guard<std::mutex> lkg(cacheMutex);
+		auto it = cache.find(code);
+		if (it != cache.end()) {
+			returnType = it->second.returnType;
+			parameters = it->second.parameters;
+			return;
+		}
+	}
+
+	Signature signature;
+	ExtractShaderParameters(code, "main", signature.returnType, signature.parameters);
+	returnType = signature.returnType;
+	parameters = signature.parameters;
+
+	// Edited shaders leave their old sources behind, the cache must not grow with them.
+	std::lock_guard<std::mutex> lkg(cacheMutex);
+	if (cache.size() >= maxCachedSignatures) {
+		cache.erase(cache.begin());
+	}
+	cache.insert({ std::move(code), std::move(signature) });
+}
+
+
 void MaterialShader::SetName(std::string name) {
 	if (name.find("__") != name.npos) {
 		throw std::invalid_argument("Name cannot contain double-underscores.");
@@ -85,7 +125,8 @@ void MaterialShaderGraph::AssembleShaderCode() {
 	for (size_t i = 0; i < m_nodes.size(); ++i) {
 		MaterialShader* shader = m_nodes[i].get();
 		functions[i] = shader->GetShaderCode();
-		ExtractShaderParameters(functions[i], "main", shaderNodeReturns[i], shaderNodeParams[i]);
+		shaderNodeParams[i] = shader->GetShaderParameters();
+		shaderNodeReturns[i] = shader->GetShaderOutputType();
 
 		for (auto p : shaderNodeParams[i]) {
 			if (p.type == eMaterialShaderParamType::UNKNOWN) {
@@ -163,7 +204,7 @@ void MaterialShaderGraph::AssembleShaderCode() {
 		std::stringstream ss;
 		ss << "main_" << topologicalOrder.size();
 		shaderNodes[node].SetFunctionName(ss.str());
-		functions[node] = std::regex_replace(functions[node], std::regex("main"), ss.str());
+		functions[node] = HlslScanner::RenameIdentifier(functions[node], "main", ss.str());
 		topologicalOrder.push_back(node);
 		shaderNodes[node].SetFunctionReturn(GetParameterString(shaderNodeReturns[node]));
 	};
@@ -223,118 +264,6 @@ void MaterialShaderGraph::SetGraph(std::vector<std::unique_ptr<MaterialShader>>
 //------------------------------------------------------------------------------
 
 
-std::string MaterialShader::RemoveComments(std::string code) {
-	std::stringstream ss(code);
-
-	// remove single line comments by trimming commented-out tails, line-by-line
-	std::string noSingleLine;
-	std::string singleLine;
-	while (std::getline(ss, singleLine)) {
-		size_t idx = singleLine.find_first_of("//");
-		if (idx != singleLine.npos) {
-			singleLine = singleLine.substr(0, idx - 1);
-		}
-		noSingleLine += singleLine;
-	}
-
-	// remove multiline comments by replacing regex template " /*anything*/ " to empty string
-	std::stringstream noComment;
-	std::regex multilinePattern(R"(/\*.*\*/)");
-	std::regex_replace(std::ostreambuf_iterator<char>(noComment), noSingleLine.begin(), noSingleLine.end(), multilinePattern, "");
-
-	std::string ret = noComment.str();
-	return ret;
-}
-
-
-std::string MaterialShader::FindFunctionSignature(std::string code, const std::string& functionName) {
-	// regex to match " functionName ( anything ) { " 
-	std::regex signaturePattern(functionName + R"(\s*\(.*\)\s*\{)");
-
-	// find matches
-	std::smatch matches;
-	if (!std::regex_search(code, matches, signaturePattern)) {
-		throw std::invalid_argument("No main function found in material shader.");
-	}
-
-	// march back towards return type over whitespaces
-	intptr_t matchIdx = matches[0].first - code.cbegin();
-	matchIdx -= 1;
-	while (matchIdx >= 0 && isspace(code[matchIdx])) {
-		--matchIdx;
-	}
-
-	// march back over return type's characters
-	intptr_t returnIdx = matchIdx;
-	while (returnIdx >= 0 && !isspace(code[returnIdx])) {
-		--returnIdx;
-	}
-	returnIdx = std::max(intptr_t(0), returnIdx);
-
-	// return type spans across range [returnIdx, matchIdx], it being empty range means failure
-	if (matchIdx == returnIdx) {
-		throw std::invalid_argument("Main function has no return type.");
-	}
-
-	// walk back from match's end until ')'
-	intptr_t matchEndIdx = matches[0].second - code.begin();
-	while (code[matchEndIdx] != ')') {
-		matchEndIdx--;
-	}
-	++matchEndIdx;
-
-	return code.substr(returnIdx, matchEndIdx - returnIdx);
-}
-
-
-void MaterialShader::SplitFunctionSignature(std::string signature, std::string& returnType, std::vector<std::pair<std::string, std::string>>& parameters) {
-	// extract part between the parentheses
-	size_t opening = signature.find_first_of('(');
-	size_t closing = signature.find_first_of(')');
-	std::stringstream paramString(signature.substr(opening + 1, closing - opening - 1));
-
-	// split the parameters string to individual parameters, and process them
-	std::string param;
-	while (getline(paramString, param, ',')) {
-		if (param.size() == 0) {
-			throw std::invalid_argument("Parameter of main has zero characters.");
-		}
-		// trim leading and trailing whitespaces
-		intptr_t firstChar = 0;
-		while (firstChar < (intptr_t)param.size() && isspace(param[firstChar])) {
-			++firstChar;
-		}
-		intptr_t lastChar = param.size() - 1;
-		while (lastChar >= firstChar && isspace(param[lastChar])) {
-			--lastChar;
-		}
-		if (firstChar >= lastChar) {
-			throw std::invalid_argument("Parameter of main has no type specifier or declaration name.");
-		}
-		param = param.substr(firstChar, lastChar-firstChar+1);
-
-		// split param to type and name
-		firstChar = 0;
-		while (!isspace(param[firstChar])) {
-			++firstChar;
-		}
-		lastChar = param.size() - 1;
-		while (!isspace(param[lastChar])) {
-			--lastChar;
-		}
-
-		parameters.push_back({ param.substr(0, firstChar), param.substr(lastChar + 1, param.npos) });
-	}
-
-	// get return type
-	intptr_t lastChar = 0;
-	while (!isspace(signature[lastChar])) {
-		++lastChar;
-	}
-	returnType = signature.substr(0, lastChar);
-}
-
-
 std::string MaterialShader::GetParameterString(eMaterialShaderParamType type) {
 	switch (type) {
 		case eMaterialShaderParamType::COLOR: return "float4";
@@ -364,19 +293,17 @@ eMaterialShaderParamType MaterialShader::GetParameterType(std::string typeString
 }
 
 
-void MaterialShader::ExtractShaderParameters(std::string code, const std::string& functionName, eMaterialShaderParamType& returnType, std::vector<MaterialShaderParameter>& parameters) {
-	code = RemoveComments(code);
-	std::string signature = FindFunctionSignature(code, functionName);
-
-	std::string returnTypeStr;
-	std::vector<std::pair<std::string, std::string>> paramList;
-	SplitFunctionSignature(signature, returnTypeStr, paramList);
+void MaterialShader::ExtractShaderParameters(const std::string& code, const std::string& functionName, eMaterialShaderParamType& returnType, std::vector<MaterialShaderParameter>& parameters) {
+	HlslScanner::FunctionSignature signature;
+	if (!HlslScanner::FindFunctionSignature(code, functionName, signature)) {
+		throw std::invalid_argument("No main function found in material shader.");
+	}
 
-	returnType = GetParameterType(returnTypeStr);
+	returnType = GetParameterType(signature.returnType);
 
 	// collect results
 	std::vector<MaterialShaderParameter> params;
-	for (const auto& p : paramList) {
+	for (const auto& p : signature.parameters) {
 		MaterialShaderParameter param;
 		param.type = GetParameterType(p.first);
 		param.name = p.second;
@@ -510,7 +437,12 @@ Material::Parameter::operator float() const {
 
 
 
+Material::Material() {
+	MarkModified();
+}
+
 void Material::SetShader(MaterialShader* shader) {
+	MarkModified();
 	m_shader = shader;
 	auto params = m_shader->GetShaderParameters();
 	m_parameters.clear();
@@ -527,6 +459,7 @@ size_t Material::GetParameterCount() const {
 
 Material::Parameter& Material::operator[](size_t index) {
 	assert(index < m_parameters.size());
+	MarkModified();
 	return m_parameters[index];
 }
 
@@ -548,4 +481,46 @@ const Material::Parameter& Material::operator[](const std::string& name) const {
 }
 
 
+const std::vector<uint8_t>& Material::GetConstantBlock(const std::vector<int>& offsets, size_t size) const {
+	if (m_constantBlockVersion == m_version && m_constantBlock.size() == size) {
+		return m_constantBlock;
+	}
+	assert(offsets.size() == m_parameters.size());
+
+	m_constantBlock.assign(size, 0);
+	for (size_t paramIdx = 0; paramIdx < m_parameters.size(); ++paramIdx) {
+		const Parameter& param = m_parameters[paramIdx];
+		uint8_t* target = m_constantBlock.data() + offsets[paramIdx];
+		switch (param.GetType()) {
+			case eMaterialShaderParamType::COLOR:
+			{
+				assert(offsets[paramIdx] + 4 * sizeof(float) <= size);
+				mathfu::VectorPacked<float, 4> color;
+				((mathfu::Vector4f)param).Pack(&color);
+				memcpy(target, color.data, sizeof(color.data));
+				break;
+			}
+			case eMaterialShaderParamType::VALUE:
+			{
+				assert(offsets[paramIdx] + sizeof(float) <= size);
+				float value = param;
+				memcpy(target, &value, sizeof(value));
+				break;
+			}
+			default:
+				break; // Textures are not part of the constant buffer.
+		}
+	}
+	m_constantBlockVersion = m_version;
+
+	return m_constantBlock;
+}
+
+
+void Material::MarkModified() {
+	static std::atomic<uint64_t> versionCounter(0);
+	m_version = ++versionCounter;
+}
+
+
 } // namespace inl::gxeng
\ No newline at end of file
@@ -1,11 +1,11 @@
 #pragma once
 
 #include "ShaderManager.hpp"
+#include "HlslScanner.hpp"
 
 #include <BaseLibrary/Graph_All.hpp>
 #include <mathfu/mathfu_exc.hpp>
 
-#include <regex>
 #include <sstream>
 #include <iterator>
 #include <algorithm>
@@ -46,14 +46,14 @@ public:
 	void SetName(std::string name);
 	const std::string& GetName() const;
 protected:
-	static std::string RemoveComments(std::string code);
-	static std::string FindFunctionSignature(std::string code, const std::string& functionName);
-	static void SplitFunctionSignature(std::string signature, std::string& returnType, std::vector<std::pair<std::string, std::string>>& parameters);
 	static std::string GetParameterString(eMaterialShaderParamType type);
 	static eMaterialShaderParamType GetParameterType(std::string typeString);
-	static void ExtractShaderParameters(std::string code, const std::string& functionName, eMaterialShaderParamType& returnType, std::vector<MaterialShaderParameter>& parameters);
+	static void ExtractShaderParameters(const std::string& code, const std::string& functionName, eMaterialShaderParamType& returnType, std::vector<MaterialShaderParameter>& parameters);
 protected:
 	std::string LoadShaderSource(std::string name) const;
+private:
+	/// <summary> Parses the main function's signature, or returns it from a cache shared by all shaders with the same source. </summary>
+	void GetSignature(eMaterialShaderParamType& returnType, std::vector<MaterialShaderParameter>& parameters) const;
 private:
 	ShaderManager* m_shaderManager;
 	std::string m_name;
@@ -143,25 +143,48 @@ public:
 	};
 
 public:
+	Material();
+
 	void SetShader(MaterialShader* shader);
 	MaterialShader* GetShader() const { return m_shader; }
 	size_t GetParameterCount() const;
 
+	/// <remarks> Accessing a parameter for writing marks the material modified.
+	///		Do not keep the reference to set the parameter later. </remarks>
 	Parameter& operator[](size_t index);
 	const Parameter& operator[](size_t index) const;
 
 	Parameter& operator[](const std::string& name);
 	const Parameter& operator[](const std::string& name) const;
+
+	/// <summary> Changes whenever the parameters might have been modified.
+	///		Versions are unique among materials, so renderers can use them to tell if their copies are outdated. </summary>
+	uint64_t GetVersion() const { return m_version; }
+
+	/// <summary> Returns the color and value parameters packed into a constant buffer.
+	///		The block is only rebuilt when the material has been modified since the last call. </summary>
+	/// <param name="offsets"> Byte offset of each parameter in the buffer, those of textures are ignored. </param>
+	/// <param name="size"> The size of the constant buffer in bytes. </param>
+	/// <remarks> This method is NOT thread-safe. </remarks>
+	const std::vector<uint8_t>& GetConstantBlock(const std::vector<int>& offsets, size_t size) const;
+private:
+	void MarkModified();
 private:
 	std::vector<Parameter> m_parameters;
 	MaterialShader* m_shader = nullptr;
 	std::unordered_map<std::string, size_t> m_paramNameMap; // maps parameter names to indices
+
+	uint64_t m_version;
+	mutable std::vector<uint8_t> m_constantBlock;
+	mutable uint64_t m_constantBlockVersion = 0; // m_version when m_constantBlock was packed
 };
 
 
 
 // TEST IMPLEMENTATION
-inline std::string MaterialGenPixelShader(const MaterialShader& shader) {
+/// <param name="bindlessCapacity"> If not zero, textures are taken from the bindless table at the indices
+///		in the material constants, instead of being bound to their own registers. </param>
+inline std::string MaterialGenPixelShader(const MaterialShader& shader, unsigned bindlessCapacity = 0) {
 	// get material shading function's HLSL code
 	std::vector<MaterialShaderParameter> params;
 	std::string shadingFunction;
@@ -170,10 +193,7 @@ inline std::string MaterialGenPixelShader(const MaterialShader& shader) {
 	shadingFunction = shader.GetShaderCode();
 
 	// rename "main" to something else
-	std::stringstream renameMain;
-	std::regex renameRegex("main");
-	std::regex_replace(std::ostreambuf_iterator<char>(renameMain), shadingFunction.begin(), shadingFunction.end(), renameRegex, "mtl_shader");
-	shadingFunction = renameMain.str();
+	shadingFunction = HlslScanner::RenameIdentifier(shadingFunction, "main", "mtl_shader");
 
 	// structures
 	std::string structures =
@@ -209,6 +229,13 @@ inline std::string MaterialGenPixelShader(const MaterialShader& shader) {
 		"};\n";
 	lightConstantBuffer << "ConstantBuffer<LightConstants> lightCb: register(b100); \n";
 
+	if (bindlessCapacity > 0) {
+		// the same table seen as both kinds of textures
+		textures << "Texture2DArray<float4> bindlessColor[" << bindlessCapacity << "] : register(t0, space1); \n";
+		textures << "Texture2DArray<float> bindlessValue[" << bindlessCapacity << "] : register(t0, space2); \n";
+		textures << "SamplerState bindlessSamp : register(s0); \n";
+	}
+
 	mtlConstantBuffer << "struct MtlConstants { \n";
 	int numMtlConstants = 0;
 	for (size_t i = 0; i < params.size(); ++i) {
@@ -227,12 +254,22 @@ inline std::string MaterialGenPixelShader(const MaterialShader& shader) {
 			}
 			case eMaterialShaderParamType::BITMAP_COLOR_2D:
 			{
+				if (bindlessCapacity > 0) {
+					mtlConstantBuffer << "    uint param" << i << "; \n";
+					++numMtlConstants;
+					break;
+				}
 				textures << "Texture2DArray<float4> tex" << i << " : register(t" << i << "); \n";
 				textures << "SamplerState samp" << i << " : register(s" << i << "); \n";
 				break;
 			}
 			case eMaterialShaderParamType::BITMAP_VALUE_2D:
 			{
+				if (bindlessCapacity > 0) {
+					mtlConstantBuffer << "    uint param" << i << "; \n";
+					++numMtlConstants;
+					break;
+				}
 				textures << "Texture2DArray<float> tex" << i << " : register(t" << i << "); \n";
 				textures << "SamplerState samp" << i << " : register(s" << i << "); \n";
 				break;
@@ -270,6 +307,11 @@ inline std::string MaterialGenPixelShader(const MaterialShader& shader) {
 			case eMaterialShaderParamType::BITMAP_COLOR_2D:
 			{
 				PSMain << "    MapColor2D input" << i << "; \n";
+				if (bindlessCapacity > 0) {
+					PSMain << "    input" << i << ".tex = bindlessColor[mtlCb.param" << i << "]; \n";
+					PSMain << "    input" << i << ".samp = bindlessSamp; \n\n";
+					break;
+				}
 				PSMain << "    input" << i << ".tex = tex" << i << "; \n";
 				PSMain << "    input" << i << ".samp = samp" << i << "; \n\n";
 				break;
@@ -277,6 +319,11 @@ inline std::string MaterialGenPixelShader(const MaterialShader& shader) {
 			case eMaterialShaderParamType::BITMAP_VALUE_2D:
 			{
 				PSMain << "    MapValue2D input" << i << "; \n";
+				if (bindlessCapacity > 0) {
+					PSMain << "    input" << i << ".tex = bindlessValue[mtlCb.param" << i << "]; \n";
+					PSMain << "    input" << i << ".samp = bindlessSamp; \n\n";
+					break;
+				}
 				PSMain << "    input" << i << ".tex = tex" << i << "; \n";
 				PSMain << "    input" << i << ".samp = samp" << i << "; \n\n";
 				break;
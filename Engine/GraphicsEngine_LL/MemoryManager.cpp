@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 
 
 namespace inl {
@@ -17,11 +18,31 @@ namespace gxeng {
 MemoryManager::MemoryManager(gxapi::IGraphicsApi* graphicsApi) :
 	m_graphicsApi(graphicsApi),
 	m_criticalHeap(graphicsApi),
+	m_transientHeap(graphicsApi),
 	m_uploadHeap(graphicsApi),
-	m_constBufferHeap(graphicsApi)
+	m_constBufferHeap(graphicsApi),
+	m_residency(std::make_shared<Residency>())
 {}
 
 
+void MemoryManager::OnFrameBeginHost(uint64_t frameId) {
+	m_criticalHeap.OnFrameBeginHost(frameId);
+	m_transientHeap.OnFrameBeginHost(frameId);
+}
+
+
+void MemoryManager::OnFrameCompleteDevice(uint64_t frameId) {
+	m_criticalHeap.OnFrameCompleteDevice(frameId);
+	m_transientHeap.OnFrameCompleteDevice(frameId);
+}
+
+
+void MemoryManager::OnDeviceIdle() {
+	m_criticalHeap.OnDeviceIdle();
+	m_transientHeap.OnDeviceIdle();
+}
+
+
 void MemoryManager::LockResident(const std::vector<MemoryObject>& resources) {
 	// Lock resident wants to modify contents but not the vector.
 	auto& nonconst = const_cast<std::vector<MemoryObject>&>(resources);
@@ -35,6 +56,121 @@ void MemoryManager::UnlockResident(const std::vector<MemoryObject>& resources) {
 }
 
 
+void MemoryManager::SetResidencyBudget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(m_residency->mutex);
+	m_residency->tracker.SetBudget(bytes);
+}
+
+
+ResidencyTracker::Statistics MemoryManager::GetResidencyStatistics() const {
+	std::lock_guard<std::mutex> lock(m_residency->mutex);
+	return m_residency->tracker.GetStatistics();
+}
+
+
+void MemoryManager::BeginResidencyFrame(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_residency->mutex);
+	m_residency->tracker.BeginFrame(frameId);
+}
+
+
+void MemoryManager::LockResidentLowLevel(const std::vector<gxapi::IResource*>& resources) {
+	std::lock_guard<std::mutex> lock(m_residency->mutex);
+	LockPageables(GetPageables(resources));
+}
+
+
+void MemoryManager::UnlockResidentLowLevel(const std::vector<gxapi::IResource*>& resources) {
+	std::lock_guard<std::mutex> lock(m_residency->mutex);
+	m_residency->tracker.Unlock(GetPageables(resources));
+}
+
+
+std::vector<gxapi::IPageable*> MemoryManager::GetPageables(const std::vector<gxapi::IResource*>& resources) const {
+	std::vector<gxapi::IPageable*> pageables;
+	pageables.reserve(resources.size());
+	for (gxapi::IResource* resource : resources) {
+		auto it = m_residency->placedHeaps.find(resource);
+		if (it != m_residency->placedHeaps.end()) {
+			pageables.push_back(it->second);
+		}
+		else {
+			pageables.push_back(resource);
+		}
+	}
+	return pageables;
+}
+
+
+void MemoryManager::LockPageables(const std::vector<gxapi::IPageable*>& pageables) {
+	std::vector<gxapi::IPageable*> toMakeResident = m_residency->tracker.Lock(pageables);
+	std::vector<gxapi::IPageable*> toEvict = m_residency->tracker.SelectEvictions();
+	if (toMakeResident.empty() && toEvict.empty()) {
+		return;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	try {
+		// Evict before paging in, so that the new resources have room.
+		if (!toEvict.empty()) {
+			m_graphicsApi->Evict(toEvict);
+		}
+		if (!toMakeResident.empty()) {
+			try {
+				m_graphicsApi->MakeResident(toMakeResident);
+			}
+			catch (gxapi::OutOfMemory&) {
+				// The budget was too optimistic, evict everything that is not in use, and try again.
+				toEvict = m_residency->tracker.SelectEvictions(0);
+				if (!toEvict.empty()) {
+					m_graphicsApi->Evict(toEvict);
+				}
+				m_graphicsApi->MakeResident(toMakeResident);
+			}
+		}
+	}
+	catch (...) {
+		// Nothing stays locked, the resources are paged in again by the next lock.
+		m_residency->tracker.CancelLock(pageables, toMakeResident);
+		throw;
+	}
+
+	m_residency->tracker.AddStallTime(std::chrono::steady_clock::now() - startTime);
+}
+
+
+impl::CriticalBufferHeap::Statistics MemoryManager::GetHeapStatistics() const {
+	return m_criticalHeap.GetStatistics();
+}
+
+
+void MemoryManager::ReleaseEmptyHeaps() {
+	// The heaps are destroyed at the end of the scope, when the tracker has forgotten them.
+	std::vector<std::unique_ptr<gxapi::IHeap>> heaps = m_criticalHeap.ReleaseEmptyHeaps();
+
+	std::lock_guard<std::mutex> lock(m_residency->mutex);
+	for (const auto& heap : heaps) {
+		m_residency->tracker.Remove(heap.get());
+	}
+}
+
+
+void MemoryManager::SetTransientPassOrder(std::vector<std::vector<bool>> passOrder, std::vector<std::vector<unsigned>> passConsumers) {
+	m_transientHeap.SetPassOrder(std::move(passOrder), std::move(passConsumers));
+}
+
+
+impl::TransientHeap::Statistics MemoryManager::GetTransientStatistics() const {
+	return m_transientHeap.GetStatistics();
+}
+
+
+void MemoryManager::ReleaseUnusedTransients() {
+	m_transientHeap.ReleaseUnused();
+}
+
+
 UploadManager& MemoryManager::GetUploadManager() {
 	return m_uploadHeap;
 }
@@ -66,6 +202,14 @@ IndexBuffer MemoryManager::CreateIndexBuffer(eResourceHeapType heap, size_t size
 }
 
 
+LinearBuffer MemoryManager::CreateBuffer(eResourceHeapType heap, size_t size, gxapi::eResourceFlags flags) {
+	MemoryObjDesc desc = AllocateResource(heap, gxapi::ResourceDesc::Buffer(size, flags));
+
+	LinearBuffer result(std::move(desc));
+	return result;
+}
+
+
 Texture1D MemoryManager::CreateTexture1D(eResourceHeapType heap, uint64_t width, gxapi::eFormat format, gxapi::eResourceFlags flags, uint16_t arraySize) {
 	if (arraySize < 1) {
 		throw gxapi::InvalidArgument("\"count\" should not be at least one.");
@@ -78,12 +222,12 @@ Texture1D MemoryManager::CreateTexture1D(eResourceHeapType heap, uint64_t width,
 }
 
 
-Texture2D MemoryManager::CreateTexture2D(eResourceHeapType heap, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags, uint16_t arraySize) {
+Texture2D MemoryManager::CreateTexture2D(eResourceHeapType heap, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags, uint16_t arraySize, uint16_t mipLevels) {
 	if (arraySize < 1) {
 		throw gxapi::InvalidArgument("\"count\" should not be at least one.");
 	}
 
-	MemoryObjDesc desc = AllocateResource(heap, gxapi::ResourceDesc::Texture2DArray(width, height, format, arraySize, flags));
+	MemoryObjDesc desc = AllocateResource(heap, gxapi::ResourceDesc::Texture2DArray(width, height, format, arraySize, flags, mipLevels));
 
 	Texture2D result(std::move(desc));
 	return result;
@@ -106,10 +250,79 @@ TextureCube MemoryManager::CreateTextureCube(eResourceHeapType heap, uint64_t wi
 }
 
 
+Texture2D MemoryManager::CreateTransientTexture2D(unsigned pass, eTransientScope scope, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags, uint16_t arraySize) {
+	if (arraySize < 1) {
+		throw gxapi::InvalidArgument("\"count\" should not be at least one.");
+	}
+
+	gxapi::ResourceDesc resourceDesc = gxapi::ResourceDesc::Texture2DArray(width, height, format, arraySize, flags);
+	std::optional<gxapi::ClearValue> clearValue = GetOptimizedClearValue(resourceDesc);
+	gxapi::ClearValue* pClearValue = clearValue ? &clearValue.value() : nullptr;
+
+	// Transients are placed, they are resident as long as their heap is.
+	MemoryObjDesc desc = m_transientHeap.Allocate(resourceDesc, pClearValue, pass, scope);
+
+	Texture2D result(std::move(desc));
+	return result;
+}
+
+
 MemoryObjDesc MemoryManager::AllocateResource(eResourceHeapType heap, const gxapi::ResourceDesc& desc) {
+	std::optional<gxapi::ClearValue> clearValue = GetOptimizedClearValue(desc);
+	gxapi::ClearValue* pClearValue = clearValue ? &clearValue.value() : nullptr;
+
+	MemoryObjDesc result;
+	impl::CriticalBufferHeap::Placement placement;
+	switch(heap) {
+	case eResourceHeapType::CRITICAL: 
+		result = m_criticalHeap.Allocate(std::move(desc), pClearValue, &placement);
+		break;
+	default:
+		assert(false);
+		return MemoryObjDesc();
+	}
+
+	// Track the resource, or its heap if it's placed, for residency management until it is destroyed.
+	bool isPlaced = placement.heap != nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_residency->mutex);
+		if (!isPlaced) {
+			m_residency->tracker.Add(result.resource.get(), EstimateSize(desc));
+		}
+		else if (placement.newHeapSize != 0) {
+			m_residency->tracker.Add(placement.heap, placement.newHeapSize);
+		}
+		else if (!m_residency->tracker.IsResident(placement.heap)) {
+			// The heap was evicted, but new resources are expected to be resident, they may be uploaded to right away.
+			LockPageables({ placement.heap });
+			m_residency->tracker.Unlock({ placement.heap });
+		}
+		if (isPlaced) {
+			m_residency->placedHeaps.insert({ result.resource.get(), placement.heap });
+		}
+	}
+	// The resource may outlive the manager, then there is nothing to remove it from.
+	MemoryObjDesc::Deleter deleter = result.resource.get_deleter();
+	gxapi::IResource* resource = result.resource.release();
+	std::weak_ptr<Residency> residency = m_residency;
+	result.resource = MemoryObjDesc::UniqPtr(resource, [residency, deleter, isPlaced](gxapi::IResource* ptr) {
+		if (auto lockedResidency = residency.lock()) {
+			std::lock_guard<std::mutex> lock(lockedResidency->mutex);
+			if (isPlaced) {
+				lockedResidency->placedHeaps.erase(ptr);
+			}
+			else {
+				lockedResidency->tracker.Remove(ptr);
+			}
+		}
+		deleter(ptr);
+	});
+
+	return result;
+}
 
-	gxapi::ClearValue* pClearValue = nullptr;
 
+std::optional<gxapi::ClearValue> MemoryManager::GetOptimizedClearValue(const gxapi::ResourceDesc& desc) {
 	bool depthStencilTexture = (desc.type == gxapi::eResourceType::TEXTURE) && (desc.textureDesc.flags & gxapi::eResourceFlags::ALLOW_DEPTH_STENCIL);
 	bool renderTargetTexture = (desc.type == gxapi::eResourceType::TEXTURE) && (desc.textureDesc.flags & gxapi::eResourceFlags::ALLOW_RENDER_TARGET);
 
@@ -136,24 +349,41 @@ MemoryObjDesc MemoryManager::AllocateResource(eResourceHeapType heap, const gxap
 		}
 	}
 
-	gxapi::ClearValue dsvClearValue(clearFormat, 1, 0);
-	gxapi::ClearValue rtvClearValue(clearFormat, gxapi::ColorRGBA(0, 0, 0, 1));
-	if (depthStencilTexture) {
-		pClearValue = &dsvClearValue;
-	}
 	if (renderTargetTexture) {
-		pClearValue = &rtvClearValue;
+		return gxapi::ClearValue(clearFormat, gxapi::ColorRGBA(0, 0, 0, 1));
+	}
+	if (depthStencilTexture) {
+		return gxapi::ClearValue(clearFormat, 1, 0);
 	}
+	return {};
+}
 
-	switch(heap) {
-	case eResourceHeapType::CRITICAL: 
-		return m_criticalHeap.Allocate(std::move(desc), pClearValue);
-		break;
-	default:
-		assert(false);
+
+size_t MemoryManager::EstimateSize(const gxapi::ResourceDesc& desc) {
+	// The real size depends on the driver's layout, this is only used to compare against the budget.
+	constexpr size_t placementAlignment = 64 * 1024;
+
+	size_t size = 0;
+	if (desc.type == gxapi::eResourceType::BUFFER) {
+		size = desc.bufferDesc.sizeInBytes;
+	}
+	else {
+		const gxapi::TextureDesc& texture = desc.textureDesc;
+		size_t blockSize = gxapi::GetFormatBlockSize(texture.format);
+		size_t width = texture.width;
+		size_t height = texture.height;
+		size_t depth = texture.dimension == gxapi::eTextueDimension::THREE ? texture.depthOrArraySize : 1;
+		size_t arraySize = texture.dimension == gxapi::eTextueDimension::THREE ? 1 : texture.depthOrArraySize;
+		for (unsigned mip = 0; mip < std::max<unsigned>(1, texture.mipLevels); ++mip) {
+			size += gxapi::GetFormatRowSizeInBytes(texture.format, width) * ((height + blockSize - 1) / blockSize) * depth;
+			width = std::max<size_t>(1, width / 2);
+			height = std::max<size_t>(1, height / 2);
+			depth = std::max<size_t>(1, depth / 2);
+		}
+		size *= arraySize * std::max<size_t>(1, texture.multisampleCount);
 	}
 
-	return MemoryObjDesc();
+	return (size + placementAlignment - 1) / placementAlignment * placementAlignment;
 }
 
 
@@ -3,70 +3,125 @@
 #include "HostDescHeap.hpp"
 #include "MemoryObject.hpp"
 #include "CriticalBufferHeap.hpp"
+#include "TransientHeap.hpp"
 #include "UploadManager.hpp"
 #include "ConstBufferHeap.hpp"
+#include "ResidencyTracker.hpp"
+#include "PipelineEventListener.hpp"
 
 #include "../GraphicsApi_LL/Common.hpp"
 #include "../GraphicsApi_D3D12/DescriptorHeap.hpp"
 #include "../GraphicsApi_D3D12/GraphicsApi.hpp"
 
 #include <iostream>
-#include <unordered_set>
 #include <mutex>
 #include <cassert>
 #include <type_traits>
+#include <optional>
+#include <memory>
+#include <unordered_map>
 
 namespace inl {
 namespace gxeng {
 
 enum class eResourceHeapType { CRITICAL };
 
-class MemoryManager {
+/// <summary>
+/// Creates and tracks resources. Register it for pipeline events, the memory of
+/// released resources is reused when the frames that might use them have completed.
+/// </summary>
+class MemoryManager : public PipelineEventListener {
 public:
 	MemoryManager(gxapi::IGraphicsApi* graphicsApi);
 
+	void OnFrameBeginDevice(uint64_t frameId) override {}
+	void OnFrameBeginHost(uint64_t frameId) override;
+	void OnFrameCompleteDevice(uint64_t frameId) override;
+	void OnFrameCompleteHost(uint64_t frameId) override {}
+	/// <summary> Reuses the memory of all released resources. Call when the GPU has finished every submitted frame. </summary>
+	void OnDeviceIdle();
+
 	/// <summary>
-	/// Makes given resources resident.
+	/// Makes given resources resident, and keeps them resident until they are unlocked.
+	/// Least recently used resources are evicted to stay within the residency budget.
 	/// </summary>
 	/// <exception cref="inl::gxapi::OutOfMemory">
 	/// If there is not enough free memory in the resource's appropriate
-	/// memory pool for the resource to fit in.
+	/// memory pool for the resource to fit in, even after evicting every unlocked resource.
+	/// The resources are not locked then, and must not be unlocked.
 	/// </exception>
 	void LockResident(const std::vector<MemoryObject>& resources);
 	template<typename IterT>
 	void LockResident(IterT begin, IterT end);
 
 	/// <summary>
-	/// WRITE A DESCRIPTION
+	/// Signals that the GPU has finished using the resources. They may be evicted afterwards.
+	/// The resources must not be destroyed before they are unlocked.
 	/// </summary>
 	void UnlockResident(const std::vector<MemoryObject>& resources);
 	template<typename IterT>
 	void UnlockResident(IterT begin, IterT end);
 
+	/// <summary> Sets how many bytes of resources are kept resident at most. Unlimited by default. </summary>
+	void SetResidencyBudget(size_t bytes);
+	ResidencyTracker::Statistics GetResidencyStatistics() const;
+	/// <summary> Resources used in the given frame are not evicted, even if they are over budget. </summary>
+	void BeginResidencyFrame(uint64_t frameId);
+
+	/// <summary> Occupancy and fragmentation of the heaps resources are placed in. </summary>
+	impl::CriticalBufferHeap::Statistics GetHeapStatistics() const;
+	/// <summary> Gives the memory of heaps that hold no resources back to the system. </summary>
+	void ReleaseEmptyHeaps();
+
+	/// <summary> Sets the order of pipeline nodes and the nodes reading each node's outputs,
+	///		which decide which transient textures may share memory. </summary>
+	void SetTransientPassOrder(std::vector<std::vector<bool>> passOrder, std::vector<std::vector<unsigned>> passConsumers);
+	/// <summary> Peak and current memory of transient textures, with and without aliasing. </summary>
+	impl::TransientHeap::Statistics GetTransientStatistics() const;
+	/// <summary> Frees the memory of released transients that were not created again. Call after reinitializing the nodes. </summary>
+	void ReleaseUnusedTransients();
+
 	UploadManager& GetUploadManager();
 	VolatileConstBuffer CreateVolatileConstBuffer(const void* data, uint32_t size);
 	PersistentConstBuffer CreatePersistentConstBuffer(const void* data, uint32_t size);
 
 	VertexBuffer CreateVertexBuffer(eResourceHeapType heap, size_t size);
 	IndexBuffer CreateIndexBuffer(eResourceHeapType heap, size_t size, size_t indexCount);
+	LinearBuffer CreateBuffer(eResourceHeapType heap, size_t size, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE);
 	Texture1D CreateTexture1D(eResourceHeapType heap, uint64_t width, gxapi::eFormat format, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE, uint16_t arraySize = 1);
-	Texture2D CreateTexture2D(eResourceHeapType heap, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE, uint16_t arraySize = 1);
+	Texture2D CreateTexture2D(eResourceHeapType heap, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE, uint16_t arraySize = 1, uint16_t mipLevels = 1);
 	Texture3D CreateTexture3D(eResourceHeapType heap, uint64_t width, uint32_t height, uint16_t depth, gxapi::eFormat format, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE);
 	TextureCube CreateTextureCube(eResourceHeapType heap, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE);
+	/// <summary> Creates a texture that only lives within a frame, and may share memory with other transients. </summary>
+	/// <param name="pass"> The index of the pipeline node creating the texture. </param>
+	Texture2D CreateTransientTexture2D(unsigned pass, eTransientScope scope, uint64_t width, uint32_t height, gxapi::eFormat format, gxapi::eResourceFlags flags = gxapi::eResourceFlags::NONE, uint16_t arraySize = 1);
 
 protected:
 	gxapi::IGraphicsApi* m_graphicsApi;
 
 	impl::CriticalBufferHeap m_criticalHeap;
+	impl::TransientHeap m_transientHeap;
 
 	UploadManager m_uploadHeap;
 	ConstantBufferHeap m_constBufferHeap;
 
-	std::mutex m_evictablesMtx;
-	std::unordered_set<MemoryObject> m_evictables;
+	// Shared with the deleters of tracked resources, which may be released after the manager.
+	struct Residency {
+		std::mutex mutex;
+		ResidencyTracker tracker; // Committed resources and the heaps of placed resources.
+		std::unordered_map<const gxapi::IResource*, gxapi::IHeap*> placedHeaps; // Placed resources are paged with their heap.
+	};
+	std::shared_ptr<Residency> m_residency;
 
 protected:
 	MemoryObjDesc AllocateResource(eResourceHeapType heap, const gxapi::ResourceDesc& desc);
+	static std::optional<gxapi::ClearValue> GetOptimizedClearValue(const gxapi::ResourceDesc& desc);
+	void LockResidentLowLevel(const std::vector<gxapi::IResource*>& resources);
+	void UnlockResidentLowLevel(const std::vector<gxapi::IResource*>& resources);
+	// These expect the residency mutex to be locked.
+	std::vector<gxapi::IPageable*> GetPageables(const std::vector<gxapi::IResource*>& resources) const;
+	void LockPageables(const std::vector<gxapi::IPageable*>& pageables);
+	static size_t EstimateSize(const gxapi::ResourceDesc& desc);
 };
 
 
@@ -74,54 +129,12 @@ template<typename IterT>
 void MemoryManager::LockResident(IterT begin, IterT end) {
 	static_assert(std::is_same<typename IterT::value_type, MemoryObject>::value);
 
-	std::vector<gxapi::IResource*> lowLevelTargets;
-	std::vector<MemoryObject> highLevelTargets;
-
-	{
-		std::lock_guard<std::mutex> lock(m_evictablesMtx);
-
-		IterT currIter = begin;
-		while (currIter != end) {
-			auto& curr = *(currIter++);
-			auto currEvictableIter = m_evictables.find(curr);
-			bool evictable = currEvictableIter != m_evictables.end();
-			if (evictable) {
-				assert(curr._GetResident());
-				m_evictables.erase(currEvictableIter);
-			}
-			else {
-				if (curr._GetResident() == false) {
-					lowLevelTargets.push_back(curr._GetResourcePtr());
-					highLevelTargets.push_back(curr);
-				}
-			}
-		}
-
-		try {
-			m_graphicsApi->MakeResident(lowLevelTargets);
-		}
-		catch (gxapi::OutOfMemory&) {
-			std::vector<gxapi::IResource*> toEvict;
-			toEvict.reserve(m_evictables.size());
-			for (auto& curr : m_evictables) {
-				// NOTE I'm not sure why 'curr' is a const reference. I had to add a const cast.
-				toEvict.push_back(const_cast<gxapi::IResource*>(curr._GetResourcePtr()));
-			}
-			m_graphicsApi->Evict(toEvict);
-			m_evictables.clear();
-
-			m_graphicsApi->MakeResident(lowLevelTargets);
-		}
+	std::vector<gxapi::IResource*> resources;
+	for (IterT it = begin; it != end; ++it) {
+		resources.push_back(it->_GetResourcePtr());
 	}
 
-	assert(lowLevelTargets.size() == highLevelTargets.size());
-	for (size_t i = 0; i < highLevelTargets.size(); i++) {
-		auto currLowlevel = lowLevelTargets[i];
-		auto& currHighLevel = highLevelTargets[i];
-		assert(currHighLevel._GetResourcePtr() == currLowlevel);
-
-		currHighLevel._SetResident(true);
-	}
+	LockResidentLowLevel(resources);
 }
 
 
@@ -129,8 +142,12 @@ template<typename IterT>
 void MemoryManager::UnlockResident(IterT begin, IterT end) {
 	static_assert(std::is_same<typename IterT::value_type, MemoryObject>::value);
 
-	std::lock_guard<std::mutex> lock(m_evictablesMtx);
-	m_evictables.insert(begin, end);
+	std::vector<gxapi::IResource*> resources;
+	for (IterT it = begin; it != end; ++it) {
+		resources.push_back(it->_GetResourcePtr());
+	}
+
+	UnlockResidentLowLevel(resources);
 }
 
 } // namespace gxeng
@@ -94,6 +94,25 @@ bool MemoryObject::_GetResident() const noexcept {
 }
 
 
+bool MemoryObject::HasPendingUploads() const noexcept {
+	assert(m_contents);
+	return m_contents->pendingUploads.load() != 0;
+}
+
+
+void MemoryObject::_AddPendingUpload() noexcept {
+	assert(m_contents);
+	++m_contents->pendingUploads;
+}
+
+
+void MemoryObject::_RemovePendingUpload() noexcept {
+	assert(m_contents);
+	assert(m_contents->pendingUploads.load() > 0);
+	--m_contents->pendingUploads;
+}
+
+
 gxapi::IResource* MemoryObject::_GetResourcePtr() noexcept {
 	assert(m_contents);
 	return m_contents->resource.get();
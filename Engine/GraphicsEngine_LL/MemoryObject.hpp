@@ -6,6 +6,7 @@
 #include "../GraphicsApi_LL/IResource.hpp"
 
 #include <functional>
+#include <atomic>
 
 namespace inl {
 namespace gxeng {
@@ -73,6 +74,12 @@ public:
 	void _SetResident(bool value) noexcept;
 	bool _GetResident() const noexcept;
 
+	/// <summary> True while there are uploads to the resource that have not finished on the GPU.
+	///		Render nodes should not read the resource until then. </summary>
+	bool HasPendingUploads() const noexcept;
+	void _AddPendingUpload() noexcept;
+	void _RemovePendingUpload() noexcept;
+
 	gxapi::IResource* _GetResourcePtr() noexcept;
 	const gxapi::IResource* _GetResourcePtr() const noexcept;
 
@@ -85,6 +92,7 @@ private:
 		bool resident;
 
 		std::vector<gxapi::eResourceState> subresourceStates;
+		std::atomic<uint32_t> pendingUploads{ 0 };
 	};
 
 private:
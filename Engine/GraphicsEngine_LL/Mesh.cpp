@@ -1,7 +1,12 @@
 #include "Mesh.hpp"
 #include "VertexElementCompressor.hpp"
+#include "MeshSimplifier.hpp"
 #include <BaseLibrary/ArrayView.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
 using exc::ArrayView;
 
 
@@ -9,8 +14,91 @@ namespace inl {
 namespace gxeng {
 
 
+static bool ExtractPositions(const VertexBase* vertices, size_t numVertices, std::vector<mathfu::Vector3f>& positions) {
+	positions.clear();
+	positions.reserve(numVertices);
+
+	ArrayView<const VertexBase> inputArrayView{ vertices, numVertices, vertices->StructureSize() };
+	for (size_t i = 0; i < numVertices; i++) {
+		auto* positionPart = dynamic_cast<const VertexPart<eVertexElementSemantic::POSITION>*>(&inputArrayView[i]);
+		if (positionPart == nullptr) {
+			return false;
+		}
+		positions.push_back(positionPart->GetPosition(0));
+	}
+	return true;
+}
+
+
+// Reads the positions of a stream that is already in the GPU layout.
+static bool ExtractStreamPositions(const void* vertexData, size_t numVertices, uint32_t stride, const std::vector<Mesh::Element>& elements, std::vector<mathfu::Vector3f>& positions) {
+	positions.clear();
+
+	auto positionElement = std::find_if(elements.begin(), elements.end(), [](const Mesh::Element& element) {
+		return element.semantic == eVertexElementSemantic::POSITION && element.index == 0;
+	});
+	if (positionElement == elements.end()) {
+		return false;
+	}
+
+	positions.resize(numVertices);
+	const uint8_t* source = reinterpret_cast<const uint8_t*>(vertexData) + positionElement->offset;
+	for (size_t i = 0; i < numVertices; i++) {
+		float position[3];
+		memcpy(position, source + i * stride, sizeof(position));
+		positions[i] = mathfu::Vector3f(position[0], position[1], position[2]);
+	}
+	return true;
+}
+
+
+// Appends successively simplified copies of the index list after the original one.
+// The vertices are shared, every level is just a different range of the index buffer.
+static std::vector<uint32_t> GenerateLods(std::vector<mathfu::Vector3f> positions,
+										  const unsigned* indices,
+										  size_t numIndices,
+										  const Mesh::LodDesc& lodDesc,
+										  float maxError,
+										  std::vector<IndexRange>& ranges,
+										  std::vector<float>& errors)
+{
+	std::vector<uint32_t> allIndices(indices, indices + numIndices);
+	ranges = { IndexRange{ 0, numIndices } };
+	errors = { 0.0f };
+
+	MeshSimplifier simplifier(std::move(positions));
+	std::vector<uint32_t> current = allIndices;
+	std::vector<uint32_t> simplified;
+	float accumulatedError = 0.0f;
+
+	for (unsigned lod = 1; lod < lodDesc.maxLodCount; ++lod) {
+		size_t targetIndexCount = size_t(current.size() / 3 * lodDesc.reductionPerLod) * 3;
+		float error = simplifier.Simplify(current.data(), current.size(), targetIndexCount, maxError - accumulatedError, simplified);
+
+		// Stop when the error limit does not allow at least half of the intended reduction.
+		if (simplified.empty() || simplified.size() > (current.size() + targetIndexCount) / 2) {
+			break;
+		}
+
+		// Each level is simplified from the previous one, so errors add up.
+		accumulatedError += error;
+		ranges.push_back(IndexRange{ allIndices.size(), simplified.size() });
+		errors.push_back(accumulatedError);
+		allIndices.insert(allIndices.end(), simplified.begin(), simplified.end());
+		current.swap(simplified);
+	}
+
+	return allIndices;
+}
+
+
 
 void Mesh::Set(const VertexBase* vertices, size_t numVertices, const unsigned* indices, size_t numIndices) {
+	Set(vertices, numVertices, indices, numIndices, LodDesc());
+}
+
+
+void Mesh::Set(const VertexBase* vertices, size_t numVertices, const unsigned* indices, size_t numIndices, const LodDesc& lodDesc) {
 	// Create constants
 	auto& elements = vertices[0].GetElements();
 	std::vector<bool> elementMap(elements.size(), true);
@@ -29,24 +117,55 @@ void Mesh::Set(const VertexBase* vertices, size_t numVertices, const unsigned* i
 		compressedElements = VertexCompressor::Compress(inputArrayView[i], elementMap, &outputArrayView[i]);
 	}
 
-	// Set data
-	VertexStream stream;
-	stream.stride = compressedStride;
-	stream.count = numVertices;
-	stream.data = compressedData.get();
-	MeshBuffer::Set(&stream, &stream + 1, indices, indices + numIndices);
-
-	// Set stream elements.
-	std::vector<std::vector<Element>> layout;
-	layout.clear();
 	std::vector<Element> streamElements;
 	for (const auto& e : compressedElements) {
 		streamElements.push_back({ e.semantic, e.index, e.offset });
 	}
-	layout.push_back(streamElements);
 
-	// Calculate hashes
-	m_layout = Layout(layout);
+	Set(compressedData.get(), numVertices, compressedStride, streamElements, indices, numIndices, lodDesc);
+}
+
+
+void Mesh::Set(const void* vertexData, size_t numVertices, uint32_t stride, const std::vector<Element>& elements, const unsigned* indices, size_t numIndices) {
+	Set(vertexData, numVertices, stride, elements, indices, numIndices, LodDesc());
+}
+
+
+void Mesh::Set(const void* vertexData, size_t numVertices, uint32_t stride, const std::vector<Element>& elements, const unsigned* indices, size_t numIndices, const LodDesc& lodDesc) {
+	// Calculate bounds and simplified levels
+	std::vector<mathfu::Vector3f> positions;
+	bool hasPositions = ExtractStreamPositions(vertexData, numVertices, stride, elements, positions);
+	UpdateBounds(positions, true);
+
+	std::vector<uint32_t> lodIndices;
+	std::vector<IndexRange> lodRanges;
+	if (lodDesc.maxLodCount > 1) {
+		if (!hasPositions) {
+			throw std::invalid_argument("Vertices must have a position to generate levels of detail.");
+		}
+		float maxError = lodDesc.maxRelativeError * m_boundingSphereRadius;
+		lodIndices = GenerateLods(std::move(positions), indices, numIndices, lodDesc, maxError, lodRanges, m_lodErrors);
+	}
+	else {
+		m_lodErrors = { 0.0f };
+	}
+
+	// Set data
+	VertexStream stream;
+	stream.stride = stride;
+	stream.count = numVertices;
+	stream.data = const_cast<void*>(vertexData); // Only read by the upload.
+	if (lodIndices.empty()) {
+		MeshBuffer::Set(&stream, &stream + 1, indices, indices + numIndices);
+	}
+	else {
+		MeshBuffer::Set(&stream, &stream + 1, lodIndices.data(), lodIndices.data() + lodIndices.size());
+		MeshBuffer::SetIndexRanges(std::move(lodRanges));
+	}
+
+	// Set stream elements, calculate hashes
+	m_layout = Layout({ elements });
+	m_version = NextVersion();
 }
 
 
@@ -70,12 +189,22 @@ void Mesh::Update(const VertexBase* vertices, size_t numVertices, size_t offsetI
 
 	// Update data
 	MeshBuffer::Update(0, compressedData.get(), numVertices, offsetInVertices);
+
+	// Bounds can only grow, the rest of the vertices are not known here.
+	std::vector<mathfu::Vector3f> positions;
+	if (ExtractPositions(vertices, numVertices, positions)) {
+		UpdateBounds(positions, false);
+	}
 }
 
 
 void Mesh::Clear() {
 	MeshBuffer::Clear();
 	m_layout.Clear();
+	m_lodErrors.clear();
+	m_boundingBoxMin = m_boundingBoxMax = m_boundingSphereCenter = mathfu::Vector3f(0, 0, 0);
+	m_boundingSphereRadius = 0.0f;
+	m_version = NextVersion();
 }
 
 
@@ -84,6 +213,54 @@ const Mesh::Layout& Mesh::GetLayout() const {
 }
 
 
+size_t Mesh::GetLodCount() const {
+	return MeshBuffer::GetNumIndexRanges();
+}
+
+
+const IndexRange& Mesh::GetLodRange(size_t lod) const {
+	return MeshBuffer::GetIndexRange(lod);
+}
+
+
+float Mesh::GetLodError(size_t lod) const {
+	assert(lod < m_lodErrors.size());
+	return m_lodErrors[lod];
+}
+
+
+void Mesh::UpdateBounds(const std::vector<mathfu::Vector3f>& positions, bool reset) {
+	if (positions.empty()) {
+		return;
+	}
+
+	mathfu::Vector3f boxMin = reset ? positions[0] : m_boundingBoxMin;
+	mathfu::Vector3f boxMax = reset ? positions[0] : m_boundingBoxMax;
+	for (const auto& p : positions) {
+		boxMin = mathfu::Vector3f::Min(boxMin, p);
+		boxMax = mathfu::Vector3f::Max(boxMax, p);
+	}
+
+	// Sphere around the box center, radius fitted to the vertices.
+	mathfu::Vector3f center = (boxMin + boxMax) * 0.5f;
+	float radius = reset ? 0.0f : (boxMax - center).Length(); // old vertices are only known to be inside the box
+	for (const auto& p : positions) {
+		radius = std::max(radius, (p - center).Length());
+	}
+
+	m_boundingBoxMin = boxMin;
+	m_boundingBoxMax = boxMax;
+	m_boundingSphereCenter = center;
+	m_boundingSphereRadius = radius;
+}
+
+
+uint64_t Mesh::NextVersion() {
+	static std::atomic<uint64_t> nextVersion = 0;
+	return nextVersion++;
+}
+
+
 
 bool Mesh::Layout::EqualElements(const Layout& rhs) const {
 	if (m_elementHash != rhs.m_elementHash) {
@@ -3,13 +3,19 @@
 #include "MeshBuffer.hpp"
 #include "Vertex.hpp"
 
+#include <mathfu/mathfu_exc.hpp>
+
 #include <type_traits>
+#include <memory>
 
 
 namespace inl {
 namespace gxeng {
 
 
+struct OccluderMesh;
+
+
 class Mesh : protected MeshBuffer {
 public:
 	struct Element {
@@ -43,10 +49,27 @@ public:
 		size_t m_elementHash = 0;
 		size_t m_layoutHash = 0;
 	};
+	/// <summary> Controls the generation of simplified index lists for distant rendering. </summary>
+	struct LodDesc {
+		/// <summary> Maximum number of levels including the original mesh. 1 means no simplification. </summary>
+		unsigned maxLodCount = 1;
+		/// <summary> Each level aims for this fraction of the previous level's triangles. </summary>
+		float reductionPerLod = 0.5f;
+		/// <summary> Upper limit on the geometric error of any level, relative to the bounding sphere radius. </summary>
+		float maxRelativeError = 0.1f;
+	};
 public:
-	Mesh(MemoryManager* memoryManager) : MeshBuffer(memoryManager) {}
+	Mesh(MemoryManager* memoryManager) : MeshBuffer(memoryManager), m_version(NextVersion()) {}
 
 	void Set(const VertexBase* vertices, size_t numVertices, const unsigned* indices, size_t numIndices);
+	void Set(const VertexBase* vertices, size_t numVertices, const unsigned* indices, size_t numIndices, const LodDesc& lodDesc);
+	/// <summary> Sets vertices that are already in the layout of the vertex buffer, such as cooked meshes.
+	///		The vertices are uploaded as they are, without converting them one by one. </summary>
+	/// <param name="elements"> Semantics and byte offsets of the attributes within a vertex. </param>
+	void Set(const void* vertexData, size_t numVertices, uint32_t stride, const std::vector<Element>& elements,
+			 const unsigned* indices, size_t numIndices);
+	void Set(const void* vertexData, size_t numVertices, uint32_t stride, const std::vector<Element>& elements,
+			 const unsigned* indices, size_t numIndices, const LodDesc& lodDesc);
 	void Update(const VertexBase* vertices, size_t numVertices, size_t offsetInVertices);
 	void Clear();
 
@@ -55,10 +78,45 @@ public:
 	using MeshBuffer::GetVertexBufferStride;
 	using MeshBuffer::GetIndexBuffer;
 	using MeshBuffer::IsIndexBuffer32Bit;
+	using MeshBuffer::HasPendingUploads;
 
 	const Layout& GetLayout() const;
+
+	/// <summary> Number of detail levels. Level 0 is the original mesh, higher levels are coarser. </summary>
+	size_t GetLodCount() const;
+	/// <summary> The part of the index buffer that draws the given level. </summary>
+	const IndexRange& GetLodRange(size_t lod) const;
+	/// <summary> Geometric deviation of the level from the original mesh, in model space units. </summary>
+	float GetLodError(size_t lod) const;
+
+	/// <summary> Changes whenever Set or Clear replaces the buffers. GPU addresses and index ranges
+	///		taken from an older version must not be used anymore. Versions are never reused, not even by other meshes,
+	///		so a new mesh created at the address of a destroyed one is still told apart. </summary>
+	uint64_t GetVersion() const { return m_version; }
+
+	/// <summary> Axis aligned bounding box of the vertices in model space. </summary>
+	mathfu::Vector3f GetBoundingBoxMin() const { return m_boundingBoxMin; }
+	mathfu::Vector3f GetBoundingBoxMax() const { return m_boundingBoxMax; }
+	/// <summary> Bounding sphere of the vertices in model space. </summary>
+	mathfu::Vector3f GetBoundingSphereCenter() const { return m_boundingSphereCenter; }
+	float GetBoundingSphereRadius() const { return m_boundingSphereRadius; }
+
+	/// <summary> Simplified geometry drawn in place of the mesh when occlusion is rendered on the CPU.
+	///		Null by default, meaning the mesh hides nothing. Kept when the mesh is cleared. </summary>
+	void SetOccluder(std::shared_ptr<const OccluderMesh> occluder) { m_occluder = std::move(occluder); }
+	const OccluderMesh* GetOccluder() const { return m_occluder.get(); }
+private:
+	void UpdateBounds(const std::vector<mathfu::Vector3f>& positions, bool reset);
+	static uint64_t NextVersion();
 private:
 	Layout m_layout;
+	std::vector<float> m_lodErrors;
+	mathfu::Vector3f m_boundingBoxMin = mathfu::Vector3f(0, 0, 0);
+	mathfu::Vector3f m_boundingBoxMax = mathfu::Vector3f(0, 0, 0);
+	mathfu::Vector3f m_boundingSphereCenter = mathfu::Vector3f(0, 0, 0);
+	float m_boundingSphereRadius = 0.0f;
+	std::shared_ptr<const OccluderMesh> m_occluder;
+	uint64_t m_version;
 };
 
 
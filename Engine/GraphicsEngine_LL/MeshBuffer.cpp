@@ -3,6 +3,7 @@
 #include "MemoryManager.hpp"
 
 #include <cassert>
+#include <stdexcept>
 
 
 
@@ -43,6 +44,21 @@ void MeshBuffer::Update(uint32_t streamIndex, const void* vertexData, size_t ver
 void MeshBuffer::Clear() {
 	m_vertexBuffers.clear();
 	m_indexBuffer = IndexBuffer();
+	m_indexRanges.clear();
+}
+
+
+void MeshBuffer::SetIndexRanges(std::vector<IndexRange> ranges) {
+	for (const auto& range : ranges) {
+		if (range.indexCount % 3 != 0) {
+			throw std::invalid_argument("Index range count not divisible by 3. Must be triangles.");
+		}
+		if (range.firstIndex + range.indexCount > m_indexBuffer.GetIndexCount()) {
+			throw std::out_of_range("Index range over-indexes the index buffer.");
+		}
+	}
+
+	m_indexRanges = std::move(ranges);
 }
 
 
@@ -64,6 +80,24 @@ const IndexBuffer& MeshBuffer::GetIndexBuffer() const {
 	return m_indexBuffer;
 }
 
+size_t MeshBuffer::GetNumIndexRanges() const {
+	return m_indexRanges.size();
+}
+
+const IndexRange& MeshBuffer::GetIndexRange(size_t rangeIndex) const {
+	assert(rangeIndex < m_indexRanges.size());
+	return m_indexRanges[rangeIndex];
+}
+
+bool MeshBuffer::HasPendingUploads() const {
+	for (const auto& vertexBuffer : m_vertexBuffers) {
+		if (vertexBuffer.HasPendingUploads()) {
+			return true;
+		}
+	}
+	return m_indexBuffer && m_indexBuffer.HasPendingUploads();
+}
+
 
 
 } // namespace gxeng
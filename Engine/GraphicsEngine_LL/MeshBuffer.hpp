@@ -23,6 +23,13 @@ struct VertexStream {
 };
 
 
+/// <summary> A contiguous part of the index buffer, such as a level of detail. </summary>
+struct IndexRange {
+	size_t firstIndex;
+	size_t indexCount;
+};
+
+
 class MeshBuffer {
 	enum class eValidationResult {
 		OK,
@@ -40,11 +47,20 @@ public:
 	void Update(uint32_t streamIndex, const void* vertexData, size_t vertexCount, size_t offsetInVertex);
 	void Clear();
 
+	/// <summary> Splits the index buffer into sub-ranges which can be drawn separately.
+	///		By default, there is one range covering the whole index buffer. </summary>
+	void SetIndexRanges(std::vector<IndexRange> ranges);
+
 	size_t GetNumStreams() const;
 	const VertexBuffer& GetVertexBuffer(size_t streamIndex) const;
 	size_t GetVertexBufferStride(size_t streamIndex) const;
 	const IndexBuffer& GetIndexBuffer() const;
 	bool IsIndexBuffer32Bit() const { return m_isIndex32Bit; }
+	size_t GetNumIndexRanges() const;
+	const IndexRange& GetIndexRange(size_t rangeIndex) const;
+
+	/// <summary> True while the vertex or index data is still being uploaded. The mesh must not be drawn until then. </summary>
+	bool HasPendingUploads() const;
 private:
 	template <class StreamIt, class IndexIt>
 	eValidationResult Validate(StreamIt firstStream, StreamIt lastStream, IndexIt firstIndex, IndexIt lastIndex);
@@ -52,6 +68,7 @@ private:
 	std::vector<VertexBuffer> m_vertexBuffers;
 	std::vector<size_t> m_vertexStrides;
 	IndexBuffer m_indexBuffer;
+	std::vector<IndexRange> m_indexRanges;
 	bool m_isIndex32Bit;
 	MemoryManager* m_memoryManager;
 };
@@ -113,6 +130,7 @@ void MeshBuffer::Set(StreamIt firstStream, StreamIt lastStream, IndexIt firstInd
 		m_vertexStrides.push_back(streamIt->stride);
 	}
 	m_isIndex32Bit = using32BitIndex;
+	m_indexRanges = { IndexRange{ 0, numIndices } };
 
 
 	// Fill the vertex buffers.
@@ -0,0 +1,281 @@
+#include "MeshSimplifier.hpp"
+
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cassert>
+
+
+namespace inl::gxeng {
+
+
+namespace {
+
+// Symmetric 4x4 matrix of the sum of squared distances to a set of planes.
+struct Quadric {
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+
+	static Quadric Plane(double a, double b, double c, double d, double weight) {
+		Quadric q;
+		q.a2 = weight*a*a; q.ab = weight*a*b; q.ac = weight*a*c; q.ad = weight*a*d;
+		q.b2 = weight*b*b; q.bc = weight*b*c; q.bd = weight*b*d;
+		q.c2 = weight*c*c; q.cd = weight*c*d;
+		q.d2 = weight*d*d;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& rhs) {
+		a2 += rhs.a2; ab += rhs.ab; ac += rhs.ac; ad += rhs.ad;
+		b2 += rhs.b2; bc += rhs.bc; bd += rhs.bd;
+		c2 += rhs.c2; cd += rhs.cd;
+		d2 += rhs.d2;
+		return *this;
+	}
+
+	double Evaluate(const mathfu::Vector3f& p) const {
+		double x = p.x(), y = p.y(), z = p.z();
+		return x*x*a2 + 2*x*y*ab + 2*x*z*ac + 2*x*ad
+			+ y*y*b2 + 2*y*z*bc + 2*y*bd
+			+ z*z*c2 + 2*z*cd
+			+ d2;
+	}
+};
+
+
+struct Collapse {
+	double cost;
+	uint32_t from; // this vertex disappears...
+	uint32_t to; // ...and is replaced by this one
+	uint32_t fromVersion;
+	uint32_t toVersion;
+
+	bool operator>(const Collapse& rhs) const { return cost > rhs.cost; }
+};
+
+
+// Border edges are weighted heavier than surface planes so that silhouettes and seams stay put.
+constexpr double BorderWeight = 16.0;
+
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) {
+	return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+} // namespace
+
+
+
+MeshSimplifier::MeshSimplifier(std::vector<mathfu::Vector3f> positions)
+	: m_positions(std::move(positions))
+{}
+
+
+float MeshSimplifier::Simplify(const uint32_t* indices, size_t numIndices, size_t targetIndexCount, float maxError, std::vector<uint32_t>& result) const {
+	if (numIndices % 3 != 0) {
+		throw std::invalid_argument("Index count not divisible by 3. Must be triangles.");
+	}
+
+	const size_t numVertices = m_positions.size();
+	const size_t numTriangles = numIndices / 3;
+
+	// Copy triangles, drop the degenerate ones right away.
+	std::vector<uint32_t> triangles;
+	triangles.reserve(numIndices);
+	for (size_t i = 0; i < numIndices; i += 3) {
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (a >= numVertices || b >= numVertices || c >= numVertices) {
+			throw std::invalid_argument("Indices over-index the vertex positions.");
+		}
+		if (a != b && b != c && c != a) {
+			triangles.push_back(a);
+			triangles.push_back(b);
+			triangles.push_back(c);
+		}
+	}
+
+	std::vector<bool> triangleAlive(triangles.size() / 3, true);
+	size_t aliveCount = triangles.size() / 3;
+
+	// Vertex -> triangle adjacency.
+	std::vector<std::vector<uint32_t>> vertexTriangles(numVertices);
+	for (uint32_t t = 0; t < triangles.size() / 3; ++t) {
+		for (int k = 0; k < 3; ++k) {
+			vertexTriangles[triangles[3 * t + k]].push_back(t);
+		}
+	}
+
+	// Initial quadrics from the triangle planes.
+	std::vector<Quadric> quadrics(numVertices);
+	std::unordered_map<uint64_t, std::pair<int, uint32_t>> edgeUse; // edge -> (use count, last triangle)
+	edgeUse.reserve(triangles.size());
+	for (uint32_t t = 0; t < triangles.size() / 3; ++t) {
+		const mathfu::Vector3f& p0 = m_positions[triangles[3 * t + 0]];
+		const mathfu::Vector3f& p1 = m_positions[triangles[3 * t + 1]];
+		const mathfu::Vector3f& p2 = m_positions[triangles[3 * t + 2]];
+		mathfu::Vector3f normal = mathfu::Vector3f::CrossProduct(p1 - p0, p2 - p0);
+		float length = normal.Length();
+		if (length > 0.0f) {
+			normal /= length;
+			Quadric plane = Quadric::Plane(normal.x(), normal.y(), normal.z(), -mathfu::Vector3f::DotProduct(normal, p0), 1.0);
+			for (int k = 0; k < 3; ++k) {
+				quadrics[triangles[3 * t + k]] += plane;
+			}
+		}
+		for (int k = 0; k < 3; ++k) {
+			auto& use = edgeUse[EdgeKey(triangles[3 * t + k], triangles[3 * t + (k + 1) % 3])];
+			++use.first;
+			use.second = t;
+		}
+	}
+
+	// Penalty planes along open borders.
+	for (auto& edge : edgeUse) {
+		if (edge.second.first != 1) {
+			continue;
+		}
+		uint32_t a = uint32_t(edge.first >> 32);
+		uint32_t b = uint32_t(edge.first & 0xFFFFFFFFu);
+		uint32_t t = edge.second.second;
+		const mathfu::Vector3f& p0 = m_positions[triangles[3 * t + 0]];
+		const mathfu::Vector3f& p1 = m_positions[triangles[3 * t + 1]];
+		const mathfu::Vector3f& p2 = m_positions[triangles[3 * t + 2]];
+		mathfu::Vector3f faceNormal = mathfu::Vector3f::CrossProduct(p1 - p0, p2 - p0);
+		mathfu::Vector3f borderNormal = mathfu::Vector3f::CrossProduct(m_positions[b] - m_positions[a], faceNormal);
+		float length = borderNormal.Length();
+		if (length > 0.0f) {
+			borderNormal /= length;
+			Quadric plane = Quadric::Plane(borderNormal.x(), borderNormal.y(), borderNormal.z(), -mathfu::Vector3f::DotProduct(borderNormal, m_positions[a]), BorderWeight);
+			quadrics[a] += plane;
+			quadrics[b] += plane;
+		}
+	}
+
+	std::vector<uint32_t> versions(numVertices, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+	auto PushEdge = [&](uint32_t a, uint32_t b) {
+		Quadric q = quadrics[a];
+		q += quadrics[b];
+		double costToA = q.Evaluate(m_positions[a]);
+		double costToB = q.Evaluate(m_positions[b]);
+		if (costToB <= costToA) {
+			queue.push({ std::max(0.0, costToB), a, b, versions[a], versions[b] });
+		}
+		else {
+			queue.push({ std::max(0.0, costToA), b, a, versions[b], versions[a] });
+		}
+	};
+
+	for (auto& edge : edgeUse) {
+		PushEdge(uint32_t(edge.first >> 32), uint32_t(edge.first & 0xFFFFFFFFu));
+	}
+	edgeUse.clear();
+
+	// Collapse cheapest edges first.
+	const double maxErrorSq = double(maxError) * double(maxError);
+	const size_t targetTriangleCount = targetIndexCount / 3;
+	double largestCost = 0.0;
+	std::vector<uint32_t> neighbours;
+
+	while (aliveCount > targetTriangleCount && !queue.empty()) {
+		Collapse collapse = queue.top();
+		queue.pop();
+
+		if (collapse.cost > maxErrorSq) {
+			break;
+		}
+		if (versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion) {
+			continue; // stale, endpoints have changed since
+		}
+
+		// Reject collapses that would flip or degenerate the surrounding triangles.
+		bool flips = false;
+		for (uint32_t t : vertexTriangles[collapse.from]) {
+			if (!triangleAlive[t]) {
+				continue;
+			}
+			uint32_t* tri = &triangles[3 * t];
+			if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+				continue; // these will be removed
+			}
+			mathfu::Vector3f before[3], after[3];
+			for (int k = 0; k < 3; ++k) {
+				before[k] = m_positions[tri[k]];
+				after[k] = m_positions[tri[k] == collapse.from ? collapse.to : tri[k]];
+			}
+			mathfu::Vector3f normalBefore = mathfu::Vector3f::CrossProduct(before[1] - before[0], before[2] - before[0]);
+			mathfu::Vector3f normalAfter = mathfu::Vector3f::CrossProduct(after[1] - after[0], after[2] - after[0]);
+			if (mathfu::Vector3f::DotProduct(normalBefore, normalAfter) <= 0.0f) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) {
+			continue;
+		}
+
+		// Rewire triangles of the removed vertex.
+		for (uint32_t t : vertexTriangles[collapse.from]) {
+			if (!triangleAlive[t]) {
+				continue;
+			}
+			uint32_t* tri = &triangles[3 * t];
+			if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+				triangleAlive[t] = false;
+				--aliveCount;
+			}
+			else {
+				for (int k = 0; k < 3; ++k) {
+					if (tri[k] == collapse.from) {
+						tri[k] = collapse.to;
+					}
+				}
+				vertexTriangles[collapse.to].push_back(t);
+			}
+		}
+		vertexTriangles[collapse.from].clear();
+		quadrics[collapse.to] += quadrics[collapse.from];
+		++versions[collapse.from];
+		++versions[collapse.to];
+		largestCost = std::max(largestCost, collapse.cost);
+
+		// Compact the adjacency of the surviving vertex and re-evaluate its edges.
+		auto& survivorTriangles = vertexTriangles[collapse.to];
+		survivorTriangles.erase(std::remove_if(survivorTriangles.begin(), survivorTriangles.end(), [&](uint32_t t) { return !triangleAlive[t]; }), survivorTriangles.end());
+		neighbours.clear();
+		for (uint32_t t : survivorTriangles) {
+			for (int k = 0; k < 3; ++k) {
+				if (triangles[3 * t + k] != collapse.to) {
+					neighbours.push_back(triangles[3 * t + k]);
+				}
+			}
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (uint32_t n : neighbours) {
+			PushEdge(collapse.to, n);
+		}
+	}
+
+	// Gather surviving triangles.
+	result.clear();
+	result.reserve(aliveCount * 3);
+	for (size_t t = 0; t < triangleAlive.size(); ++t) {
+		if (triangleAlive[t]) {
+			result.push_back(triangles[3 * t + 0]);
+			result.push_back(triangles[3 * t + 1]);
+			result.push_back(triangles[3 * t + 2]);
+		}
+	}
+
+	assert(numTriangles >= result.size() / 3);
+	return (float)std::sqrt(largestCost);
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <mathfu/mathfu_exc.hpp>
+
+#include <vector>
+#include <cstdint>
+
+
+namespace inl::gxeng {
+
+
+/// <summary>
+/// Reduces the triangle count of an indexed triangle list using quadric error metrics.
+/// </summary>
+/// <remarks>
+/// Only the index list is rewritten: edges are collapsed into one of their existing
+/// endpoints, vertices are never moved or created. This way every level of detail
+/// can be drawn from the vertex buffers of the original mesh.
+/// Open borders (including UV seams, where vertices are split) are kept in place
+/// by penalty planes perpendicular to the border.
+/// </remarks>
+class MeshSimplifier {
+public:
+	MeshSimplifier(std::vector<mathfu::Vector3f> positions);
+
+	/// <summary> Collapses edges until the triangle list has no more than <paramref name="targetIndexCount"/> indices,
+	///		or no collapse is left that keeps the geometric error below <paramref name="maxError"/>. </summary>
+	/// <param name="result"> Receives the simplified triangle list. </param>
+	/// <returns> The largest geometric error introduced, in the units of the vertex positions. </returns>
+	float Simplify(const uint32_t* indices, size_t numIndices, size_t targetIndexCount, float maxError, std::vector<uint32_t>& result) const;
+
+	size_t GetVertexCount() const { return m_positions.size(); }
+private:
+	std::vector<mathfu::Vector3f> m_positions;
+};
+
+
+} // namespace inl::gxeng
@@ -4,8 +4,10 @@
 #include "../Mesh.hpp"
 #include "../Image.hpp"
 #include "../DirectionalLight.hpp"
+#include "../LodSelector.hpp"
 
 #include <array>
+#include <chrono>
 
 namespace inl::gxeng::nodes {
 
@@ -45,10 +47,17 @@ static void ConvertToSubmittable(
 
 
 
-DepthPrepass::DepthPrepass(gxapi::IGraphicsApi* graphicsApi):
-	m_binder(graphicsApi, {})
+DepthPrepass::DepthPrepass(gxapi::IGraphicsApi* graphicsApi, bool indirect):
+	m_binder(graphicsApi, {}),
+	m_indirect(indirect)
 {
 	this->GetInput<0>().Set({});
+	this->GetInput<2>().Set(nullptr);
+}
+
+
+void DepthPrepass::InitGraphics(const GraphicsContext & context) {
+	m_graphicsContext = context;
 
 	BindParameterDesc transformBindParamDesc;
 	m_transformBindParam = BindParameter(eBindParameterType::CONSTANT, 0);
@@ -58,6 +67,35 @@ DepthPrepass::DepthPrepass(gxapi::IGraphicsApi* graphicsApi):
 	transformBindParamDesc.relativeChangeFrequency = 0;
 	transformBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
 
+	BindParameterDesc instancesBindParamDesc;
+	m_instancesBindParam = BindParameter(eBindParameterType::CONSTANT, 1);
+	instancesBindParamDesc.parameter = m_instancesBindParam;
+	instancesBindParamDesc.constantSize = 0; // Bound as a CBV, the world matrices of a batch live in a volatile buffer.
+	instancesBindParamDesc.relativeAccessFrequency = 0;
+	instancesBindParamDesc.relativeChangeFrequency = 0;
+	instancesBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
+
+	// Indirect draws read the world matrices from the GPU scene, each command sets its first visible instance.
+	BindParameterDesc instanceBufferBindParamDesc;
+	m_instanceBufferBindParam = BindParameter(eBindParameterType::TEXTURE, 100);
+	instanceBufferBindParamDesc.parameter = m_instanceBufferBindParam;
+	instanceBufferBindParamDesc.constantSize = 0;
+	instanceBufferBindParamDesc.relativeAccessFrequency = 0;
+	instanceBufferBindParamDesc.relativeChangeFrequency = 0;
+	instanceBufferBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
+
+	BindParameterDesc visibleBindParamDesc;
+	m_visibleBindParam = BindParameter(eBindParameterType::TEXTURE, 101);
+	visibleBindParamDesc.parameter = m_visibleBindParam;
+	visibleBindParamDesc.constantSize = 0;
+	visibleBindParamDesc.relativeAccessFrequency = 0;
+	visibleBindParamDesc.relativeChangeFrequency = 0;
+	visibleBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
+
+	if (m_indirect) {
+		instancesBindParamDesc.constantSize = sizeof(uint32_t);
+	}
+
 	BindParameterDesc sampBindParamDesc;
 	sampBindParamDesc.parameter = BindParameter(eBindParameterType::SAMPLER, 0);
 	sampBindParamDesc.constantSize = 0;
@@ -75,12 +113,12 @@ DepthPrepass::DepthPrepass(gxapi::IGraphicsApi* graphicsApi):
 	samplerDesc.registerSpace = 0;
 	samplerDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
 
-	m_binder = Binder{ graphicsApi,{ transformBindParamDesc, sampBindParamDesc },{ samplerDesc } };
-}
-
-
-void DepthPrepass::InitGraphics(const GraphicsContext & context) {
-	m_graphicsContext = context;
+	if (m_indirect) {
+		m_binder = context.CreateBinder({ transformBindParamDesc, instancesBindParamDesc, instanceBufferBindParamDesc, visibleBindParamDesc, sampBindParamDesc }, { samplerDesc });
+	}
+	else {
+		m_binder = context.CreateBinder({ transformBindParamDesc, instancesBindParamDesc, sampBindParamDesc }, { samplerDesc });
+	}
 
 	auto swapChainDesc = context.GetSwapChainDesc();
 	InitRenderTarget(swapChainDesc.width, swapChainDesc.height);
@@ -89,7 +127,7 @@ void DepthPrepass::InitGraphics(const GraphicsContext & context) {
 	shaderParts.vs = true;
 	shaderParts.ps = true;
 
-	auto shader = m_graphicsContext.CreateShader("DepthPrepass", shaderParts, "");
+	auto shader = m_graphicsContext.CreateShader("DepthPrepass", shaderParts, m_indirect ? "INDIRECT=1" : "");
 
 	std::vector<gxapi::InputElementDesc> inputElementDesc = {
 		gxapi::InputElementDesc("POSITION", 0, gxapi::eFormat::R32G32B32_FLOAT, 0, 0),
@@ -111,7 +149,11 @@ void DepthPrepass::InitGraphics(const GraphicsContext & context) {
 
 	psoDesc.numRenderTargets = 0;
 
-	m_PSO.reset(m_graphicsContext.CreatePSO(psoDesc));
+	m_PSO = m_graphicsContext.CreatePSO(psoDesc);
+
+	if (m_indirect) {
+		m_commandSignature = GpuCull::CreateCommandSignature(m_graphicsContext, m_binder, m_instancesBindParam);
+	}
 }
 
 
@@ -125,14 +167,25 @@ Task DepthPrepass::GetTask() {
 		const Camera* camera = this->GetInput<1>().Get();
 		this->GetInput<1>().Clear();
 
+		const GpuDrawList* drawList = this->GetInput<2>().Get();
+		this->GetInput<2>().Clear();
+
 		this->GetOutput<0>().Set(pipeline::Texture2D(m_depthTargetSrv, m_dsv));
 
-		if (entities) {
+		if (entities && (!m_indirect || drawList)) {
 			GraphicsCommandList cmdList = context.GetGraphicsCommandList();
 			CopyCommandList cpyCmdList = context.GetCopyCommandList();
+			VolatileViewHeap volatileHeap = context.GetVolatileViewHeap();
+
+			auto recordStart = std::chrono::steady_clock::now();
+			RenderScene(m_dsv, *entities, camera, volatileHeap, cmdList);
+			if (m_indirect) {
+				RenderIndirect(*drawList, cmdList);
+			}
+			m_statistics.recordTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - recordStart);
 
-			RenderScene(m_dsv, *entities, camera, cmdList);
 			result.AddCommandList(std::move(cmdList));
+			result.GiveVolatileViewHeap(std::move(volatileHeap));
 		}
 
 		return result;
@@ -147,7 +200,7 @@ void DepthPrepass::InitRenderTarget(unsigned width, unsigned height) {
 	auto formatColor = eFormat::R32_FLOAT_X8X24_TYPELESS;
 	auto formatTypeless = eFormat::R32G8X24_TYPELESS;
 
-	Texture2D tex = m_graphicsContext.CreateDepthStencil2D(width, height, formatTypeless, true);
+	Texture2D tex = m_graphicsContext.CreateTransientDepthStencil2D(width, height, formatTypeless, true, eTransientScope::DOWNSTREAM);
 
 	gxapi::DsvTexture2DArray dsvDesc;
 	dsvDesc.activeArraySize = 1;
@@ -172,6 +225,7 @@ void DepthPrepass::RenderScene(
 	DepthStencilView2D& dsv,
 	const EntityCollection<MeshEntity>& entities,
 	const Camera* camera,
+	VolatileViewHeap& volatileHeap,
 	GraphicsCommandList& commandList
 ) {
 	commandList.SetRenderTargets(0, nullptr, &dsv);
@@ -187,6 +241,8 @@ void DepthPrepass::RenderScene(
 	commandList.SetScissorRects(1, &rect);
 	commandList.SetViewports(1, &viewport);
 
+	// The depth buffer is transient, it may have held another texture until now.
+	commandList.ResourceBarrier(gxapi::AliasingBarrier{ nullptr, dsv.GetResource()._GetResourcePtr() });
 	commandList.SetResourceState(dsv.GetResource(), 0, gxapi::eResourceState::DEPTH_WRITE);
 	commandList.ClearDepthStencil(dsv, 1, 0, 0, nullptr, true, true);
 
@@ -198,36 +254,87 @@ void DepthPrepass::RenderScene(
 	mathfu::Matrix4x4f projection = camera->GetPerspectiveMatrixRH();
 
 	auto viewProjection = projection * view;
-	
-	std::vector<const gxeng::VertexBuffer*> vertexBuffers;
-	std::vector<unsigned> sizes;
-	std::vector<unsigned> strides;
 
-	// Iterate over all entities
+	std::array<mathfu::VectorPacked<float, 4>, 4> transformCBData;
+	viewProjection.Pack(transformCBData.data());
+	commandList.BindGraphics(m_transformBindParam, transformCBData.data(), sizeof(transformCBData), 0);
+
+	if (m_indirect) {
+		return; // The GPU culled draws are recorded by RenderIndirect.
+	}
+
+	LodSelector lodSelector(camera, (unsigned)m_dsv.GetResource().GetHeight());
+
+	// Entities with the same mesh and level of detail are drawn as instances of one draw call.
+	m_batcher.Clear();
 	for (const MeshEntity* entity : entities) {
-		// Get entity parameters
-		Mesh* mesh = entity->GetMesh();
-		auto position = entity->GetPosition();
+		const Mesh* mesh = entity->GetMesh();
+
+		// Skip meshes whose data has not arrived yet.
+		if (mesh->HasPendingUploads()) {
+			continue;
+		}
 
-		// Draw mesh
 		if (!CheckMeshFormat(*mesh)) {
 			assert(false);
 			continue;
 		}
 
-		ConvertToSubmittable(mesh, vertexBuffers, sizes, strides);
+		m_batcher.Add(entity, lodSelector.SelectLod(*entity), nullptr);
+	}
+	m_batcher.Build();
 
-		auto MVP = viewProjection * entity->GetTransform();
+	std::vector<const gxeng::VertexBuffer*> vertexBuffers;
+	std::vector<unsigned> sizes;
+	std::vector<unsigned> strides;
+	std::vector<mathfu::VectorPacked<float, 4>> instanceTransforms;
 
-		std::array<mathfu::VectorPacked<float, 4>, 4> transformCBData;
-		MVP.Pack(transformCBData.data());
+	for (const InstanceBatcher::Batch& batch : m_batcher.GetBatches()) {
+		Mesh* mesh = batch.mesh;
 
-		commandList.BindGraphics(m_transformBindParam, transformCBData.data(), sizeof(transformCBData), 0);
+		m_batcher.PackTransforms(batch, instanceTransforms);
+		size_t instanceDataSize = instanceTransforms.size() * sizeof(instanceTransforms[0]);
+		VolatileConstBuffer instanceBuffer = m_graphicsContext.CreateVolatileConstBuffer(instanceTransforms.data(), instanceDataSize);
+		ConstBufferView instanceCbv = m_graphicsContext.CreateCbv(instanceBuffer, 0, instanceDataSize, volatileHeap);
+		commandList.BindGraphics(m_instancesBindParam, instanceCbv);
 
+		ConvertToSubmittable(mesh, vertexBuffers, sizes, strides);
 		commandList.SetVertexBuffers(0, (unsigned)vertexBuffers.size(), vertexBuffers.data(), sizes.data(), strides.data());
 		commandList.SetIndexBuffer(&mesh->GetIndexBuffer(), mesh->IsIndexBuffer32Bit());
-		commandList.DrawIndexedInstanced((unsigned)mesh->GetIndexBuffer().GetIndexCount());
+		const IndexRange& lodRange = mesh->GetLodRange(batch.lod);
+		commandList.DrawIndexedInstanced((unsigned)lodRange.indexCount, (unsigned)lodRange.firstIndex, 0, batch.instanceCount);
 	}
+
+	m_statistics.instanceCount = m_batcher.GetInstances().size();
+	m_statistics.drawCount = m_batcher.GetBatches().size();
+}
+
+
+void DepthPrepass::RenderIndirect(const GpuDrawList& drawList, GraphicsCommandList& commandList) {
+	// Copies refer to the same resources, states are tracked on those.
+	LinearBuffer instances = drawList.instances.GetResource();
+	LinearBuffer visibleInstances = drawList.visibleInstances.GetResource();
+	LinearBuffer commands = drawList.commands;
+
+	m_statistics.instanceCount = 0; // Counted on the GPU.
+	m_statistics.drawCount = 0;
+	if (drawList.commandCount == 0) {
+		return;
+	}
+
+	commandList.SetResourceState(instances, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+	commandList.SetResourceState(visibleInstances, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+	commandList.SetResourceState(commands, 0, gxapi::eResourceState::INDIRECT_ARGUMENT);
+	for (const MemoryObject& buffer : drawList.meshBuffers) {
+		commandList.UseResource(buffer);
+	}
+
+	// Depth only needs positions, all commands go in a single call regardless of their materials.
+	commandList.BindGraphics(m_instanceBufferBindParam, drawList.instances);
+	commandList.BindGraphics(m_visibleBindParam, drawList.visibleInstances);
+	commandList.DrawIndirect(m_commandSignature.get(), drawList.commandCount, commands, 0);
+
+	m_statistics.drawCount = 1;
 }
 
 
@@ -3,6 +3,7 @@
 #include "../GraphicsNode.hpp"
 
 #include "Node_GenCSM.hpp"
+#include "Node_GpuCull.hpp"
 
 #include "../Scene.hpp"
 #include "../Camera.hpp"
@@ -10,6 +11,7 @@
 #include "../ConstBufferHeap.hpp"
 #include "../GraphicsContext.hpp"
 #include "../PipelineTypes.hpp"
+#include "../InstanceBatcher.hpp"
 #include "GraphicsApi_LL/IPipelineState.hpp"
 #include "GraphicsApi_LL/IGxapiManager.hpp"
 
@@ -18,11 +20,13 @@ namespace inl::gxeng::nodes {
 
 class DepthPrepass :
 	virtual public GraphicsNode,
-	virtual public exc::InputPortConfig<const EntityCollection<MeshEntity>*, const Camera*>,
+	// Inputs: entities, camera, GPU culled draws (indirect only)
+	virtual public exc::InputPortConfig<const EntityCollection<MeshEntity>*, const Camera*, const GpuDrawList*>,
 	virtual public exc::OutputPortConfig<pipeline::Texture2D>
 {
 public:
-	DepthPrepass(gxapi::IGraphicsApi* graphicsApi);
+	/// <param name="indirect"> If true, the draws culled by <see cref="GpuCull"/> are executed instead of drawing the entities. </param>
+	DepthPrepass(gxapi::IGraphicsApi* graphicsApi, bool indirect = false);
 
 	void Update() override {}
 	void Notify(exc::InputPortBase* sender) override {}
@@ -30,6 +34,9 @@ public:
 
 	Task GetTask() override;
 
+	/// <summary> Draws of the last frame. </summary>
+	const DrawStatistics& GetStatistics() const { return m_statistics; }
+
 protected:
 	DepthStencilView2D m_dsv;
 	TextureView2D m_depthTargetSrv;
@@ -38,7 +45,15 @@ protected:
 	GraphicsContext m_graphicsContext;
 	Binder m_binder;
 	BindParameter m_transformBindParam;
-	std::unique_ptr<gxapi::IPipelineState> m_PSO;
+	BindParameter m_instancesBindParam;
+	BindParameter m_instanceBufferBindParam;
+	BindParameter m_visibleBindParam;
+	std::shared_ptr<gxapi::IPipelineState> m_PSO;
+	std::unique_ptr<gxapi::ICommandSignature> m_commandSignature;
+	bool m_indirect;
+
+	InstanceBatcher m_batcher;
+	DrawStatistics m_statistics;
 
 private:
 	void InitRenderTarget(unsigned width, unsigned height);
@@ -46,7 +61,9 @@ private:
 		DepthStencilView2D& dsv,
 		const EntityCollection<MeshEntity>& entities,
 		const Camera* camera,
+		VolatileViewHeap& volatileHeap,
 		GraphicsCommandList& commandList);
+	void RenderIndirect(const GpuDrawList& drawList, GraphicsCommandList& commandList);
 };
 
 
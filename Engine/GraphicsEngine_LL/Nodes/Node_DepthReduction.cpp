@@ -37,6 +37,11 @@ DepthReduction::DepthReduction(gxapi::IGraphicsApi * graphicsApi):
 	m_binder(graphicsApi, {})
 {
 	this->GetInput<0>().Set({});
+}
+
+
+void DepthReduction::InitGraphics(const GraphicsContext& context) {
+	m_graphicsContext = context;
 
 	BindParameterDesc sampBindParamDesc;
 	sampBindParamDesc.parameter = BindParameter(eBindParameterType::SAMPLER, 0);
@@ -71,12 +76,7 @@ DepthReduction::DepthReduction(gxapi::IGraphicsApi * graphicsApi):
 	samplerDesc.registerSpace = 0;
 	samplerDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
 
-	m_binder = Binder{ graphicsApi,{ sampBindParamDesc, depthBindParamDesc, outputBindParamDesc },{ samplerDesc } };
-}
-
-
-void DepthReduction::InitGraphics(const GraphicsContext& context) {
-	m_graphicsContext = context;
+	m_binder = context.CreateBinder({ sampBindParamDesc, depthBindParamDesc, outputBindParamDesc }, { samplerDesc });
 
 	auto swapChainDesc = context.GetSwapChainDesc();
 	m_width = swapChainDesc.width;
@@ -92,7 +92,7 @@ void DepthReduction::InitGraphics(const GraphicsContext& context) {
 	csoDesc.rootSignature = m_binder.GetRootSignature();
 	csoDesc.cs = shader.cs;
 
-	m_CSO.reset(m_graphicsContext.CreatePSO(csoDesc));
+	m_CSO = m_graphicsContext.CreatePSO(csoDesc);
 }
 
 
@@ -138,7 +138,8 @@ void DepthReduction::InitRenderTarget() {
 	srvDesc.mostDetailedMip = 0;
 	srvDesc.planeIndex = 0;
 
-	Texture2D tex = m_graphicsContext.CreateRWTexture2D(m_width, m_height, formatDepthReductionResult, 1);
+	// Only written through the UAV, it doesn't need to be a render target, which would have to be cleared after aliasing.
+	Texture2D tex = m_graphicsContext.CreateTransientRWTexture2D(m_width, m_height, formatDepthReductionResult, false, eTransientScope::DOWNSTREAM);
 	m_uav = m_graphicsContext.CreateUav(tex, formatDepthReductionResult, uavDesc);
 	m_srv = m_graphicsContext.CreateSrv(tex, formatDepthReductionResult, srvDesc);
 }
@@ -152,6 +153,7 @@ void DepthReduction::RenderScene(
 	unsigned dispatchW, dispatchH;
 	setWorkgroupSize((unsigned)std::ceil(m_width * 0.5f), m_height, 16, 16, dispatchW, dispatchH);
 
+	commandList.ResourceBarrier(gxapi::AliasingBarrier{ nullptr, const_cast<gxapi::IResource*>(uav.GetResource()._GetResourcePtr()) });
 	commandList.SetPipelineState(m_CSO.get());
 	commandList.SetComputeBinder(&m_binder);
 	commandList.BindCompute(m_depthBindParam, depthTex.QueryRead());
@@ -27,6 +27,7 @@ public:
 	void Update() override {}
 	void Notify(exc::InputPortBase* sender) override {}
 	void InitGraphics(const GraphicsContext& context) override;
+	std::vector<std::pair<unsigned, unsigned>> GetPassThroughPorts() const override { return { { 0, 1 } }; }
 
 	Task GetTask() override;
 
@@ -42,7 +43,7 @@ protected:
 	Binder m_binder;
 	BindParameter m_depthBindParam;
 	BindParameter m_outputBindParam;
-	std::unique_ptr<gxapi::IPipelineState> m_CSO;
+	std::shared_ptr<gxapi::IPipelineState> m_CSO;
 
 private:
 	void InitRenderTarget();
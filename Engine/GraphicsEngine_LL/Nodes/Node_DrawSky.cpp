@@ -8,7 +8,12 @@ namespace inl::gxeng::nodes {
 
 DrawSky::DrawSky(gxapi::IGraphicsApi * graphicsApi):
 	m_binder(graphicsApi, {})
-{
+{}
+
+
+void DrawSky::InitGraphics(const GraphicsContext & context) {
+	m_graphicsContext = context;
+
 	BindParameterDesc sunCbBindParamDesc;
 	m_sunCbBindParam = BindParameter(eBindParameterType::CONSTANT, 0);
 	sunCbBindParamDesc.parameter = m_sunCbBindParam;
@@ -42,12 +47,7 @@ DrawSky::DrawSky(gxapi::IGraphicsApi * graphicsApi):
 	samplerDesc.registerSpace = 0;
 	samplerDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
 
-	m_binder = Binder{ graphicsApi,{ sunCbBindParamDesc, camCbBindParamDesc, sampBindParamDesc },{ samplerDesc } };
-}
-
-
-void DrawSky::InitGraphics(const GraphicsContext & context) {
-	m_graphicsContext = context;
+	m_binder = context.CreateBinder({ sunCbBindParamDesc, camCbBindParamDesc, sampBindParamDesc }, { samplerDesc });
 
 	std::vector<float> vertices = {
 		-1, -1, 0,
@@ -96,7 +96,7 @@ void DrawSky::InitGraphics(const GraphicsContext & context) {
 	psoDesc.numRenderTargets = 1;
 	psoDesc.renderTargetFormats[0] = gxapi::eFormat::R16G16B16A16_FLOAT;
 
-	m_PSO.reset(m_graphicsContext.CreatePSO(psoDesc));
+	m_PSO = m_graphicsContext.CreatePSO(psoDesc);
 }
 
 
@@ -27,6 +27,7 @@ public:
 	void Update() override {}
 	void Notify(exc::InputPortBase* sender) override {}
 	void InitGraphics(const GraphicsContext& context) override;
+	std::vector<std::pair<unsigned, unsigned>> GetPassThroughPorts() const override { return { { 0, 0 } }; }
 
 	Task GetTask() override {
 		return Task({ [this](const ExecutionContext& context) {
@@ -72,7 +73,7 @@ protected:
 	Binder m_binder;
 	BindParameter m_sunCbBindParam;
 	BindParameter m_camCbBindParam;
-	std::unique_ptr<gxapi::IPipelineState> m_PSO;
+	std::shared_ptr<gxapi::IPipelineState> m_PSO;
 
 private:
 	void Render(
@@ -5,8 +5,12 @@
 #include "../Image.hpp"
 #include "../DirectionalLight.hpp"
 #include "../GraphicsContext.hpp"
+#include "../LodSelector.hpp"
 
 #include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
 
 namespace inl::gxeng::nodes {
 
@@ -24,6 +28,20 @@ static bool CheckMeshFormat(const Mesh& mesh) {
 }
 
 
+// Background uploads run on the copy queue while the frame renders, textures are only bound once they are done.
+static bool HasPendingTextures(const Material& material) {
+	for (size_t paramIdx = 0; paramIdx < material.GetParameterCount(); ++paramIdx) {
+		const Material::Parameter& param = material[paramIdx];
+		if (param.GetType() == eMaterialShaderParamType::BITMAP_COLOR_2D || param.GetType() == eMaterialShaderParamType::BITMAP_VALUE_2D) {
+			if (((Image*)param)->HasPendingUploads()) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
 static void ConvertToSubmittable(
 	Mesh* mesh,
 	std::vector<const gxeng::VertexBuffer*>& vertexBuffers,
@@ -46,13 +64,29 @@ static void ConvertToSubmittable(
 
 
 
-ForwardRender::ForwardRender(gxapi::IGraphicsApi * graphicsApi) {
+ForwardRender::ForwardRender(gxapi::IGraphicsApi * graphicsApi, bool indirect) :
+	m_indirect(indirect)
+{
 	this->GetInput<0>().Set({});
+	this->GetInput<4>().Set(nullptr);
+}
+
+
+ForwardRender::~ForwardRender() {
+	// Compile jobs reference this node.
+	for (auto& scenario : m_scenarios) {
+		scenario.second.wait();
+	}
+}
+
+
+void ForwardRender::InitGraphics(const GraphicsContext& context) {
+	m_graphicsContext = context;
 
 	BindParameterDesc transformBindParamDesc;
 	m_transformBindParam = BindParameter(eBindParameterType::CONSTANT, 0);
 	transformBindParamDesc.parameter = m_transformBindParam;
-	transformBindParamDesc.constantSize = sizeof(float) * 4 * 4 * 2;
+	transformBindParamDesc.constantSize = sizeof(float) * 4 * 4 * 3;
 	transformBindParamDesc.relativeAccessFrequency = 0;
 	transformBindParamDesc.relativeChangeFrequency = 0;
 	transformBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
@@ -90,12 +124,7 @@ ForwardRender::ForwardRender(gxapi::IGraphicsApi * graphicsApi) {
 	samplerDesc.registerSpace = 0;
 	samplerDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
 
-	m_binder = Binder{ graphicsApi,{ transformBindParamDesc, sunBindParamDesc, albedoBindParamDesc, sampBindParamDesc },{ samplerDesc } };
-}
-
-
-void ForwardRender::InitGraphics(const GraphicsContext& context) {
-	m_graphicsContext = context;
+	m_binder = context.CreateBinder({ transformBindParamDesc, sunBindParamDesc, albedoBindParamDesc, sampBindParamDesc }, { samplerDesc });
 
 	auto swapChainDesc = context.GetSwapChainDesc();
 	InitRenderTarget(swapChainDesc.width, swapChainDesc.height);
@@ -136,7 +165,7 @@ void ForwardRender::InitGraphics(const GraphicsContext& context) {
 	psoDesc.numRenderTargets = 1;
 	psoDesc.renderTargetFormats[0] = gxapi::eFormat::R16G16B16A16_FLOAT;
 
-	m_PSO.reset(m_graphicsContext.CreatePSO(psoDesc));
+	m_PSO = m_graphicsContext.CreatePSO(psoDesc);
 }
 
 
@@ -156,15 +185,23 @@ Task ForwardRender::GetTask() {
 		const DirectionalLight* sun = this->GetInput<3>().Get();
 		this->GetInput<3>().Clear();
 
+		const GpuDrawList* drawList = this->GetInput<4>().Get();
+		this->GetInput<4>().Clear();
+
 		this->GetOutput<0>().Set(pipeline::Texture2D(m_renderTargetSrv, m_rtv));
 
 		if (entities) {
 			GraphicsCommandList cmdList = context.GetGraphicsCommandList();
+			VolatileViewHeap volatileHeap = context.GetVolatileViewHeap();
 
 			DepthStencilView2D dsv = depthStencil.QueryDepthStencil(cmdList, m_graphicsContext);
 
-			RenderScene(dsv, *entities, camera, sun, cmdList);
+			auto recordStart = std::chrono::steady_clock::now();
+			RenderScene(dsv, *entities, camera, sun, drawList, context.GetFrameNumber(), volatileHeap, cmdList);
+			m_statistics.recordTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - recordStart);
+
 			result.AddCommandList(std::move(cmdList));
+			result.GiveVolatileViewHeap(std::move(volatileHeap));
 		}
 
 		return result;
@@ -175,7 +212,7 @@ Task ForwardRender::GetTask() {
 void ForwardRender::InitRenderTarget(unsigned width, unsigned height) {
 	auto format = gxapi::eFormat::R16G16B16A16_FLOAT;
 
-	Texture2D tex = m_graphicsContext.CreateRenderTarget2D(width, height, format, true);
+	Texture2D tex = m_graphicsContext.CreateTransientRenderTarget2D(width, height, format, eTransientScope::DOWNSTREAM);
 
 	gxapi::RtvTexture2DArray rtvDesc;
 	rtvDesc.activeArraySize = 1;
@@ -200,10 +237,16 @@ void ForwardRender::RenderScene(
 	const EntityCollection<MeshEntity>& entities,
 	const Camera* camera,
 	const DirectionalLight* sun,
+	const GpuDrawList* drawList,
+	uint64_t frameNumber,
+	VolatileViewHeap& volatileHeap,
 	GraphicsCommandList& commandList
 ) {
+	ReleaseRetiredConstants(frameNumber);
+
 	// Set render target
 	auto pRTV = &m_rtv;
+	commandList.ResourceBarrier(gxapi::AliasingBarrier{ nullptr, m_rtv.GetResource()._GetResourcePtr() }); // The target is transient.
 	commandList.SetResourceState(m_rtv.GetResource(), 0, gxapi::eResourceState::RENDER_TARGET);
 	commandList.SetRenderTargets(1, &pRTV, &dsv);
 	commandList.ClearRenderTarget(m_rtv, gxapi::ColorRGBA(0, 0, 0, 1));
@@ -228,82 +271,45 @@ void ForwardRender::RenderScene(
 	mathfu::Matrix4x4f projection = camera->GetPerspectiveMatrixRH();
 	auto viewProjection = projection * view;
 
+	// Must select the same levels as the depth prepass, depth test is EQUAL.
+	LodSelector lodSelector(camera, (unsigned)m_rtv.GetResource().GetHeight());
+
 
 	std::vector<const gxeng::VertexBuffer*> vertexBuffers;
 	std::vector<unsigned> sizes;
 	std::vector<unsigned> strides;
 
+	// Entities with the same mesh, level of detail and material are drawn as instances of one draw call.
+	m_batcher.Clear();
+	size_t singleDrawCount = 0;
+
 	// Iterate over all entities
 	for (const MeshEntity* entity : entities) {
 		// Get entity parameters
 		Mesh* mesh = entity->GetMesh();
-		Material* material = entity->GetMaterial();
+		const Material* material = entity->GetMaterial();
 
-		if (material != nullptr) {
-			// Set pipeline state & binder
-			const Mesh::Layout& layout = mesh->GetLayout();
-			const MaterialShader* materialShader = material->GetShader();
-			assert(materialShader != nullptr);
-
-			ScenarioData& scenario = GetScenario(layout, *materialShader);
-
-			commandList.SetPipelineState(scenario.pso.get());
-			commandList.SetGraphicsBinder(&scenario.binder);
+		// Skip meshes whose data has not arrived yet.
+		if (mesh->HasPendingUploads()) {
+			continue;
+		}
 
-			// Set material parameters
-			std::vector<uint8_t> materialConstants(scenario.constantsSize);
-			for (size_t paramIdx = 0; paramIdx < material->GetParameterCount(); ++paramIdx) {
-				const Material::Parameter& param = (*material)[paramIdx];
-				switch (param.GetType()) {
-					case eMaterialShaderParamType::BITMAP_COLOR_2D:
-					case eMaterialShaderParamType::BITMAP_VALUE_2D:
-					{
-						BindParameter bindSlot(eBindParameterType::TEXTURE, scenario.offsets[paramIdx]);
-						commandList.BindGraphics(bindSlot, *((Image*)param)->GetSrv());
-						break;
-					}
-					case eMaterialShaderParamType::COLOR:
-					{
-						*reinterpret_cast<float*>(materialConstants.data() + scenario.offsets[paramIdx] + 0) = ((mathfu::Vector4f)param).x();
-						*reinterpret_cast<float*>(materialConstants.data() + scenario.offsets[paramIdx] + 4) = ((mathfu::Vector4f)param).y();
-						*reinterpret_cast<float*>(materialConstants.data() + scenario.offsets[paramIdx] + 8) = ((mathfu::Vector4f)param).z();
-						*reinterpret_cast<float*>(materialConstants.data() + scenario.offsets[paramIdx] + 12) = ((mathfu::Vector4f)param).w();
-						break;
-					}
-					case eMaterialShaderParamType::VALUE:
-					{
-						*reinterpret_cast<float*>(materialConstants.data() + scenario.offsets[paramIdx]) = ((float)param);
-						break;
-					}
-				}
+		if (material != nullptr) {
+			if (m_indirect) {
+				continue; // Drawn from the GPU culled draws.
 			}
-			if (scenario.constantsSize > 0) {
-				commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 200), materialConstants.data(), materialConstants.size(), 0);
+			if (HasPendingTextures(*material)) {
+				continue;
 			}
 
-			// Set vertex and light constants
-			VsConstants vsConstants;
-			LightConstants lightConstants;
-			entity->GetTransform().Pack(vsConstants.model);
-			(viewProjection * entity->GetTransform()).Pack(vsConstants.mvp);
-			lightConstants.direction = sun->GetDirection().Normalized();
-			lightConstants.color = sun->GetColor();
-
-			commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 0), &vsConstants, sizeof(vsConstants), 0);
-			commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 100), &lightConstants, sizeof(lightConstants), 0);
+			const MaterialShader* materialShader = material->GetShader();
+			assert(materialShader != nullptr);
 
-			// Set primitives
-			vertexBuffers.clear(); sizes.clear(); strides.clear();
-			for (size_t i = 0; i < mesh->GetNumStreams(); ++i) {
-				vertexBuffers.push_back(&mesh->GetVertexBuffer(i));
-				sizes.push_back(mesh->GetVertexBuffer(i).GetSize());
-				strides.push_back(mesh->GetVertexBufferStride(i));
+			if (GetScenario(mesh->GetLayout(), *materialShader) == nullptr) {
+				continue; // Still compiling or failed, the entity pops in when it's done.
 			}
-			commandList.SetVertexBuffers(0, (unsigned)vertexBuffers.size(), vertexBuffers.data(), sizes.data(), strides.data());
-			commandList.SetIndexBuffer(&mesh->GetIndexBuffer(), mesh->IsIndexBuffer32Bit());
 
-			// Drawcall
-			commandList.DrawIndexedInstanced((unsigned)mesh->GetIndexBuffer().GetIndexCount());
+			m_batcher.Add(entity, lodSelector.SelectLod(*entity), material);
 		}
 		else {
 			// THIS PATH IS USED TO BYPASS MATERIAL SYSTEM AND RENDER ENTITIES WITH SIMPLY A TEXTURE
@@ -322,82 +328,286 @@ void ForwardRender::RenderScene(
 			}
 
 			// Draw mesh
-			if (!CheckMeshFormat(*mesh)) {
+			if (!CheckMeshFormat(*mesh) || entity->GetTexture()->HasPendingUploads()) {
 				continue;
 			}
 
 			ConvertToSubmittable(mesh, vertexBuffers, sizes, strides);
 
 			auto world = entity->GetTransform();
-			auto MVP = viewProjection * world;
 			auto worldInvTr = world.Inverse().Transpose();
 
-			std::array<mathfu::VectorPacked<float, 4>, 8> transformCBData;
-			MVP.Pack(transformCBData.data());
-			worldInvTr.Pack(transformCBData.data() + 4);
+			std::array<mathfu::VectorPacked<float, 4>, 12> transformCBData;
+			viewProjection.Pack(transformCBData.data());
+			world.Pack(transformCBData.data() + 4);
+			worldInvTr.Pack(transformCBData.data() + 8);
 
 			commandList.BindGraphics(m_albedoBindParam, *entity->GetTexture()->GetSrv());
 			commandList.BindGraphics(m_transformBindParam, transformCBData.data(), sizeof(transformCBData), 0);
 
 			commandList.SetVertexBuffers(0, (unsigned)vertexBuffers.size(), vertexBuffers.data(), sizes.data(), strides.data());
 			commandList.SetIndexBuffer(&mesh->GetIndexBuffer(), mesh->IsIndexBuffer32Bit());
-			commandList.DrawIndexedInstanced((unsigned)mesh->GetIndexBuffer().GetIndexCount());
+			const IndexRange& lodRange = mesh->GetLodRange(lodSelector.SelectLod(*entity));
+			commandList.DrawIndexedInstanced((unsigned)lodRange.indexCount, (unsigned)lodRange.firstIndex);
+			++singleDrawCount;
+		}
+	}
+	m_batcher.Build();
+
+	VsConstants vsConstants;
+	LightConstants lightConstants;
+	viewProjection.Pack(vsConstants.viewProjection);
+	lightConstants.direction = sun->GetDirection().Normalized();
+	lightConstants.color = sun->GetColor();
+
+	std::vector<mathfu::VectorPacked<float, 4>> instanceTransforms;
+	const ScenarioData* currentScenario = nullptr;
+
+	auto SetScenarioAndMaterial = [&](ScenarioData& scenario, const Material* material) {
+		if (&scenario != currentScenario) {
+			commandList.SetPipelineState(scenario.pso.get());
+			commandList.SetGraphicsBinder(&scenario.binder);
+
+			// Set view and light constants
+			commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 0), &vsConstants, sizeof(vsConstants), 0);
+			commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 100), &lightConstants, sizeof(lightConstants), 0);
+			if (m_indirect && drawList != nullptr) {
+				commandList.BindGraphics(BindParameter(eBindParameterType::TEXTURE, 100), drawList->instances);
+				commandList.BindGraphics(BindParameter(eBindParameterType::TEXTURE, 101), drawList->visibleInstances);
+			}
+			currentScenario = &scenario;
+		}
+
+		// Set material parameters, bindless textures are indexed through the material constants
+		for (size_t paramIdx = 0; paramIdx < material->GetParameterCount(); ++paramIdx) {
+			const Material::Parameter& param = (*material)[paramIdx];
+			if (param.GetType() == eMaterialShaderParamType::BITMAP_COLOR_2D || param.GetType() == eMaterialShaderParamType::BITMAP_VALUE_2D) {
+				if (m_graphicsContext.IsBindless()) {
+					// Not bound, so the list must be told that the texture is read.
+					Texture2D texture = ((Image*)param)->GetSrv()->GetResource();
+					commandList.SetResourceState(texture, 0, gxapi::eResourceState::PIXEL_SHADER_RESOURCE);
+					commandList.UseResource(texture);
+				}
+				else {
+					BindParameter bindSlot(eBindParameterType::TEXTURE, scenario.offsets[paramIdx]);
+					commandList.BindGraphics(bindSlot, *((Image*)param)->GetSrv());
+				}
+			}
+		}
+		if (scenario.constantsSize > 0) {
+			commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 200), GetMaterialConstants(*material, scenario, frameNumber));
+		}
+	};
+
+	for (const InstanceBatcher::Batch& batch : m_batcher.GetBatches()) {
+		Mesh* mesh = batch.mesh;
+		const Material* material = batch.material;
+
+		// Set pipeline state & binder, the scenario is ready as the entities were only added if it was
+		ScenarioData& scenario = *GetScenario(mesh->GetLayout(), *material->GetShader());
+		SetScenarioAndMaterial(scenario, material);
+
+		// Set instance transforms
+		m_batcher.PackTransforms(batch, instanceTransforms);
+		size_t instanceDataSize = instanceTransforms.size() * sizeof(instanceTransforms[0]);
+		VolatileConstBuffer instanceBuffer = m_graphicsContext.CreateVolatileConstBuffer(instanceTransforms.data(), instanceDataSize);
+		ConstBufferView instanceCbv = m_graphicsContext.CreateCbv(instanceBuffer, 0, instanceDataSize, volatileHeap);
+		commandList.BindGraphics(BindParameter(eBindParameterType::CONSTANT, 1), instanceCbv);
+
+		// Set primitives
+		vertexBuffers.clear(); sizes.clear(); strides.clear();
+		for (size_t i = 0; i < mesh->GetNumStreams(); ++i) {
+			vertexBuffers.push_back(&mesh->GetVertexBuffer(i));
+			sizes.push_back(mesh->GetVertexBuffer(i).GetSize());
+			strides.push_back(mesh->GetVertexBufferStride(i));
+		}
+		commandList.SetVertexBuffers(0, (unsigned)vertexBuffers.size(), vertexBuffers.data(), sizes.data(), strides.data());
+		commandList.SetIndexBuffer(&mesh->GetIndexBuffer(), mesh->IsIndexBuffer32Bit());
+
+		// Drawcall
+		const IndexRange& lodRange = mesh->GetLodRange(batch.lod);
+		commandList.DrawIndexedInstanced((unsigned)lodRange.indexCount, (unsigned)lodRange.firstIndex, 0, batch.instanceCount);
+	}
+
+	// Commands of the same material are executed by a single call, instance counts were written by the culling shader.
+	size_t indirectDrawCount = 0;
+	if (m_indirect && drawList != nullptr && drawList->commandCount > 0) {
+		// Copies refer to the same resources, states are tracked on those.
+		LinearBuffer instances = drawList->instances.GetResource();
+		LinearBuffer visibleInstances = drawList->visibleInstances.GetResource();
+		LinearBuffer commands = drawList->commands;
+		commandList.SetResourceState(instances, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+		commandList.SetResourceState(visibleInstances, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+		commandList.SetResourceState(commands, 0, gxapi::eResourceState::INDIRECT_ARGUMENT);
+		for (const MemoryObject& buffer : drawList->meshBuffers) {
+			commandList.UseResource(buffer);
+		}
+
+		for (const GpuScene::Group& group : drawList->groups) {
+			if (group.material == nullptr) {
+				continue; // Drawn one by one above.
+			}
+			if (HasPendingTextures(*group.material)) {
+				continue;
+			}
+
+			ScenarioData* scenario = GetScenario(group.mesh->GetLayout(), *group.material->GetShader());
+			if (scenario == nullptr) {
+				continue; // Still compiling or failed, the entities pop in when it's done.
+			}
+			SetScenarioAndMaterial(*scenario, group.material);
+
+			commandList.DrawIndirect(scenario->commandSignature.get(), group.commandCount, commands, group.firstCommand * sizeof(GpuCommand));
+			++indirectDrawCount;
+		}
+	}
+
+	// Instances of indirect draws are counted on the GPU.
+	m_statistics.instanceCount = m_batcher.GetInstances().size() + singleDrawCount;
+	m_statistics.drawCount = m_batcher.GetBatches().size() + singleDrawCount + indirectDrawCount;
+}
+
+
+
+const ConstBufferView& ForwardRender::GetMaterialConstants(const Material& material, const ScenarioData& scenario, uint64_t frameNumber) {
+	auto it = m_materialConstants.find(&material);
+	if (it != m_materialConstants.end() && it->second.version == material.GetVersion()) {
+		it->second.lastUsedFrame = frameNumber;
+		return it->second.cbv;
+	}
+
+	const std::vector<uint8_t>* constants = &material.GetConstantBlock(scenario.offsets, scenario.constantsSize);
+
+	// Images keep their bindless index, so the constants are only outdated when the material changes.
+	std::vector<uint8_t> bindlessConstants;
+	if (m_graphicsContext.IsBindless()) {
+		bindlessConstants = *constants;
+		for (size_t paramIdx = 0; paramIdx < material.GetParameterCount(); ++paramIdx) {
+			const Material::Parameter& param = material[paramIdx];
+			if (param.GetType() == eMaterialShaderParamType::BITMAP_COLOR_2D || param.GetType() == eMaterialShaderParamType::BITMAP_VALUE_2D) {
+				assert(scenario.offsets[paramIdx] + sizeof(uint32_t) <= bindlessConstants.size());
+				uint32_t index = ((Image*)param)->GetBindlessIndex();
+				memcpy(bindlessConstants.data() + scenario.offsets[paramIdx], &index, sizeof(index));
+			}
+		}
+		constants = &bindlessConstants;
+	}
+
+	PersistentConstBuffer buffer = m_graphicsContext.CreatePersistentConstBuffer(constants->data(), constants->size());
+
+	if (it == m_materialConstants.end()) {
+		it = m_materialConstants.insert({ &material, MaterialConstants{} }).first;
+	}
+	else {
+		m_retiredConstants.push_back({ frameNumber, std::move(it->second.cbv) });
+	}
+	it->second.version = material.GetVersion();
+	it->second.lastUsedFrame = frameNumber;
+	it->second.cbv = m_graphicsContext.CreateCbv(buffer);
+
+	return it->second.cbv;
+}
+
+
+void ForwardRender::ReleaseRetiredConstants(uint64_t frameNumber) {
+	// The engine does not start a frame before the one using the same back buffer has finished.
+	const uint64_t framesInFlight = m_graphicsContext.GetSwapChainDesc().numBuffers;
+	while (!m_retiredConstants.empty() && m_retiredConstants.front().first + framesInFlight <= frameNumber) {
+		m_retiredConstants.pop_front();
+	}
+
+	for (auto it = m_materialConstants.begin(); it != m_materialConstants.end();) {
+		if (it->second.lastUsedFrame + MATERIAL_CONSTANTS_LIFETIME <= frameNumber) {
+			m_retiredConstants.push_back({ frameNumber, std::move(it->second.cbv) });
+			it = m_materialConstants.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+
+void ForwardRender::Precompile(const EntityCollection<MeshEntity>& entities) {
+	for (const MeshEntity* entity : entities) {
+		const Material* material = entity->GetMaterial();
+		if (material != nullptr && material->GetShader() != nullptr) {
+			StartScenario(entity->GetMesh()->GetLayout(), *material->GetShader());
 		}
 	}
 }
 
 
+ForwardRender::ScenarioData* ForwardRender::GetScenario(const Mesh::Layout& layout, const MaterialShader& shader) {
+	auto& scenario = StartScenario(layout, shader);
+	if (scenario.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return nullptr;
+	}
+	try {
+		return scenario.get().get();
+	}
+	catch (std::exception& ex) {
+		// Reported once, the failed scenario is replaced by an empty one and its entities are skipped from now on.
+		std::cerr << "Forward render: material shader failed to compile, entities using it are not drawn." << std::endl << ex.what() << std::endl;
+		std::promise<std::unique_ptr<ScenarioData>> failed;
+		failed.set_value(nullptr);
+		scenario = failed.get_future().share();
+		return nullptr;
+	}
+}
+
 
-ForwardRender::ScenarioData& ForwardRender::GetScenario(const Mesh::Layout& layout, const MaterialShader& shader) {
+std::shared_future<std::unique_ptr<ForwardRender::ScenarioData>>& ForwardRender::StartScenario(const Mesh::Layout& layout, const MaterialShader& shader) {
 	std::string shaderCode = shader.GetShaderCode();
 
 	ScenarioDesc key{ layout, shaderCode };
 	auto scenarioIt = m_scenarios.find(key);
+	if (scenarioIt != m_scenarios.end()) {
+		return scenarioIt->second;
+	}
 
-	// Create scenario PSO if needed
-	if (scenarioIt == m_scenarios.end()) {
-		auto vsIt = m_vertexShaders.find(layout);
-		auto psIt = m_materialShaders.find(shaderCode);
-
-		// Compile vertex shader if needed
-		if (vsIt == m_vertexShaders.end()) {
-			std::string vsCode = GenerateVertexShader(layout);
-			ShaderParts vsParts;
-			vsParts.vs = true;
-			auto res = m_vertexShaders.insert({ layout, m_graphicsContext.CompileShader(vsCode, vsParts, "") });
-			vsIt = res.first;
-		}
+	auto vsIt = m_vertexShaders.find(layout);
+	auto psIt = m_materialShaders.find(shaderCode);
 
-		// Compile pixel shader if needed
-		if (psIt == m_materialShaders.end()) {
-			std::string psCode = GeneratePixelShader(shader);
-			ShaderParts psParts;
-			psParts.ps = true;
-			auto res = m_materialShaders.insert({ shaderCode, m_graphicsContext.CompileShader(psCode, psParts, "") });
-			psIt = res.first;
-		}
+	// Compile vertex shader if needed
+	if (vsIt == m_vertexShaders.end()) {
+		std::string vsCode = GenerateVertexShader(layout, m_indirect);
+		ShaderParts vsParts;
+		vsParts.vs = true;
+		auto res = m_vertexShaders.insert({ layout, m_graphicsContext.CompileShaderAsync(vsCode, vsParts, "") });
+		vsIt = res.first;
+	}
 
-		// Create PSO
+	// Compile pixel shader if needed
+	if (psIt == m_materialShaders.end()) {
+		std::string psCode = GeneratePixelShader(shader, m_graphicsContext.GetBindlessCapacity());
+		ShaderParts psParts;
+		psParts.ps = true;
+		auto res = m_materialShaders.insert({ shaderCode, m_graphicsContext.CompileShaderAsync(psCode, psParts, "") });
+		psIt = res.first;
+	}
+
+	// Create PSO once the shaders are done. They were enqueued earlier, so waiting for them can't deadlock.
+	std::shared_future<ShaderProgram> vsFuture = vsIt->second;
+	std::shared_future<ShaderProgram> psFuture = psIt->second;
+	std::vector<MaterialShaderParameter> shaderParams = shader.GetShaderParameters();
+
+	auto CreateScenario = [this, vsFuture, psFuture, shaderParams] {
 		std::vector<gxapi::InputElementDesc> inputElementDesc = {
 			gxapi::InputElementDesc("POSITION", 0, gxapi::eFormat::R32G32B32_FLOAT, 0, 0),
 			gxapi::InputElementDesc("NORMAL", 0, gxapi::eFormat::R32G32B32_FLOAT, 0, 12),
 			gxapi::InputElementDesc("TEX_COORD", 0, gxapi::eFormat::R32G32_FLOAT, 0, 24),
 		};
 
-
-		std::unique_ptr<gxapi::IPipelineState> pso;
-		std::vector<int> offsets;
-		size_t constantsSize;
-		Binder binder;
-
-		binder = GenerateBinder(shader.GetShaderParameters(), offsets, constantsSize);
+		auto scenario = std::make_unique<ScenarioData>();
+		scenario->binder = GenerateBinder(shaderParams, scenario->offsets, scenario->constantsSize);
 
 		gxapi::GraphicsPipelineStateDesc psoDesc;
 		psoDesc.inputLayout.elements = inputElementDesc.data();
 		psoDesc.inputLayout.numElements = (unsigned)inputElementDesc.size();
-		psoDesc.rootSignature = binder.GetRootSignature();
-		psoDesc.vs = vsIt->second.vs;
-		psoDesc.ps = psIt->second.ps;
+		psoDesc.rootSignature = scenario->binder.GetRootSignature();
+		psoDesc.vs = vsFuture.get().vs;
+		psoDesc.ps = psFuture.get().ps;
 		psoDesc.rasterization = gxapi::RasterizerState(gxapi::eFillMode::SOLID, gxapi::eCullMode::DRAW_CCW);
 		psoDesc.primitiveTopologyType = gxapi::ePrimitiveTopologyType::TRIANGLE;
 
@@ -416,21 +626,21 @@ ForwardRender::ScenarioData& ForwardRender::GetScenario(const Mesh::Layout& layo
 		psoDesc.numRenderTargets = 1;
 		psoDesc.renderTargetFormats[0] = gxapi::eFormat::R16G16B16A16_FLOAT;
 
-		pso.reset(m_graphicsContext.CreatePSO(psoDesc));
+		scenario->pso = m_graphicsContext.CreatePSO(psoDesc);
 
-		auto res = m_scenarios.insert({ key, ScenarioData() });
-		scenarioIt = res.first;
-		scenarioIt->second.pso = std::move(pso);
-		scenarioIt->second.offsets = std::move(offsets);
-		scenarioIt->second.binder = std::move(binder);
-		scenarioIt->second.constantsSize = constantsSize;
-	}
+		if (m_indirect) {
+			scenario->commandSignature = GpuCull::CreateCommandSignature(m_graphicsContext, scenario->binder, BindParameter(eBindParameterType::CONSTANT, 1));
+		}
+
+		return scenario;
+	};
 
-	return scenarioIt->second;
+	auto res = m_scenarios.insert({ key, m_graphicsContext.RunCompileJob(CreateScenario) });
+	return res.first->second;
 }
 
 
-std::string ForwardRender::GenerateVertexShader(const Mesh::Layout& layout) {
+std::string ForwardRender::GenerateVertexShader(const Mesh::Layout& layout, bool indirect) {
 	// there's only a single vertex format supported for now
 	if (layout.GetStreamCount() <= 0) {
 		throw std::invalid_argument("Meshes must have a single interleaved buffer.");
@@ -445,13 +655,40 @@ std::string ForwardRender::GenerateVertexShader(const Mesh::Layout& layout) {
 		throw std::invalid_argument("Mesh must have 3 attributes: position, normal, texcoord.");
 	}
 
+	// Indirect draws find their instances in the visible list of the GPU scene, the layout is GpuInstance.
+	std::string instances = indirect ?
+		"struct Instance \n"
+		"{\n"
+		"	float4x4 world;\n"
+		"	float3 boxMin;\n"
+		"	uint drawIndex;\n"
+		"	float3 boxMax;\n"
+		"	uint padding;\n"
+		"};\n"
+		"struct Command \n"
+		"{\n"
+		"	uint firstVisible;\n"
+		"};\n"
+		"ConstantBuffer<Command> command : register(b1);\n"
+		"StructuredBuffer<Instance> instanceBuffer : register(t100);\n"
+		"Buffer<uint> visibleInstances : register(t101);\n"
+		"float4x4 GetWorld(uint instanceId) { return instanceBuffer[visibleInstances[command.firstVisible + instanceId]].world; }\n"
+		:
+		"#define MAX_INSTANCES " + std::to_string(InstanceBatcher::MAX_INSTANCES) + "\n"
+		"struct Instances \n"
+		"{\n"
+		"	float4x4 world[MAX_INSTANCES];\n"
+		"};\n"
+		"ConstantBuffer<Instances> instances : register(b1);\n"
+		"float4x4 GetWorld(uint instanceId) { return instances.world[instanceId]; }\n";
+
 	std::string vertexShader =
 		"struct VsConstants \n"
 		"{\n"
-		"	float4x4 MVP;\n"
-		"	float4x4 worldInvTr;"
+		"	float4x4 viewProjection;\n"
 		"};\n"
 		"ConstantBuffer<VsConstants> vsConstants : register(b0);\n"
+		+ instances +
 
 		"struct PS_Input\n"
 		"{\n"
@@ -460,13 +697,16 @@ std::string ForwardRender::GenerateVertexShader(const Mesh::Layout& layout) {
 		"	float2 texCoord : TEX_COORD;\n"
 		"};\n"
 
-		"PS_Input VSMain(float4 position : POSITION, float4 normal : NORMAL, float4 texCoord : TEX_COORD)\n"
+		"PS_Input VSMain(float4 position : POSITION, float4 normal : NORMAL, float4 texCoord : TEX_COORD, uint instanceId : SV_InstanceID)\n"
 		"{\n"
 		"	PS_Input result;\n"
 
-		"	float3 worldNormal = normalize(mul(vsConstants.worldInvTr, float4(normal.xyz, 0.0)).xyz);\n"
+		"	float4x4 world = GetWorld(instanceId);\n"
+		"	float3 worldNormal = normalize(mul(world, float4(normal.xyz, 0.0)).xyz);\n"
 
-		"	result.position = mul(vsConstants.MVP, position);\n"
+		// Exactly as in the depth prepass, the depth test is EQUAL.
+		"	precise float4 worldPosition = mul(world, position);\n"
+		"	result.position = mul(vsConstants.viewProjection, worldPosition);\n"
 		"	result.normal = worldNormal;\n"
 		"	result.texCoord = texCoord.xy;\n"
 
@@ -476,12 +716,13 @@ std::string ForwardRender::GenerateVertexShader(const Mesh::Layout& layout) {
 	return vertexShader;
 }
 
-std::string ForwardRender::GeneratePixelShader(const MaterialShader& shader) {
-	std::string code = ::inl::gxeng::MaterialGenPixelShader(shader);
+std::string ForwardRender::GeneratePixelShader(const MaterialShader& shader, unsigned bindlessCapacity) {
+	std::string code = ::inl::gxeng::MaterialGenPixelShader(shader, bindlessCapacity);
 	return code;
 }
 
 Binder ForwardRender::GenerateBinder(const std::vector<MaterialShaderParameter>& mtlParams, std::vector<int>& offsets, size_t& materialCbSize) {
+	const bool bindless = m_graphicsContext.IsBindless();
 	int textureRegister = 0;
 	int cbSize = 0;
 	std::vector<BindParameterDesc> descs;
@@ -492,6 +733,14 @@ Binder ForwardRender::GenerateBinder(const std::vector<MaterialShaderParameter>&
 			case eMaterialShaderParamType::BITMAP_COLOR_2D:
 			case eMaterialShaderParamType::BITMAP_VALUE_2D:
 			{
+				if (bindless) {
+					// index in the bindless table
+					cbSize = ((cbSize + 3) / 4) * 4; // correct alignement
+					offsets.push_back(cbSize);
+					cbSize += sizeof(uint32_t);
+					break;
+				}
+
 				BindParameterDesc desc;
 				desc.parameter = BindParameter(eBindParameterType::TEXTURE, textureRegister);
 				desc.constantSize = 0;
@@ -534,6 +783,24 @@ Binder ForwardRender::GenerateBinder(const std::vector<MaterialShaderParameter>&
 	vsCbDesc.relativeChangeFrequency = 0;
 	vsCbDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
 
+	BindParameterDesc instancesCbDesc;
+	instancesCbDesc.parameter = BindParameter(eBindParameterType::CONSTANT, 1);
+	instancesCbDesc.constantSize = 0; // Bound as a CBV, the world matrices of a batch live in a volatile buffer.
+	instancesCbDesc.relativeAccessFrequency = 0;
+	instancesCbDesc.relativeChangeFrequency = 0;
+	instancesCbDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
+
+	// Indirect draws read the world matrices from the GPU scene, each command sets its first visible instance.
+	BindParameterDesc instanceBufferDesc;
+	instanceBufferDesc.parameter = BindParameter(eBindParameterType::TEXTURE, 100);
+	instanceBufferDesc.constantSize = 0;
+	instanceBufferDesc.relativeAccessFrequency = 0;
+	instanceBufferDesc.relativeChangeFrequency = 0;
+	instanceBufferDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
+
+	BindParameterDesc visibleInstancesDesc = instanceBufferDesc;
+	visibleInstancesDesc.parameter = BindParameter(eBindParameterType::TEXTURE, 101);
+
 	BindParameterDesc lightCbDesc;
 	lightCbDesc.parameter = BindParameter(eBindParameterType::CONSTANT, 100);
 	lightCbDesc.constantSize = sizeof(LightConstants);
@@ -543,7 +810,7 @@ Binder ForwardRender::GenerateBinder(const std::vector<MaterialShaderParameter>&
 
 	BindParameterDesc mtlCbDesc;
 	mtlCbDesc.parameter = BindParameter(eBindParameterType::CONSTANT, 200);
-	mtlCbDesc.constantSize = cbSize;
+	mtlCbDesc.constantSize = 0; // Bound as a CBV, the constants live in persistent buffers.
 	mtlCbDesc.relativeAccessFrequency = 0;
 	mtlCbDesc.relativeChangeFrequency = 0;
 	mtlCbDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
@@ -566,6 +833,15 @@ Binder ForwardRender::GenerateBinder(const std::vector<MaterialShaderParameter>&
 	samplerParam.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
 
 	descs.push_back(vsCbDesc);
+	if (m_indirect) {
+		instancesCbDesc.constantSize = sizeof(uint32_t);
+		descs.push_back(instancesCbDesc);
+		descs.push_back(instanceBufferDesc);
+		descs.push_back(visibleInstancesDesc);
+	}
+	else {
+		descs.push_back(instancesCbDesc);
+	}
 	descs.push_back(lightCbDesc);
 	if (cbSize > 0) {
 		descs.push_back(mtlCbDesc);
@@ -580,6 +856,12 @@ Binder ForwardRender::GenerateBinder(const std::vector<MaterialShaderParameter>&
 
 	materialCbSize = cbSize;
 
+	if (bindless) {
+		// a single sampler for all bindless textures, the material shader sees it as "bindlessSamp"
+		descs.push_back(samplerDesc);
+		samplerParams.push_back(samplerParam);
+		return m_graphicsContext.CreateBindlessBinder(descs, samplerParams, { 1, 2 }, gxapi::eShaderVisiblity::PIXEL);
+	}
 	return m_graphicsContext.CreateBinder(descs, samplerParams);
 }
 
@@ -3,6 +3,7 @@
 #include "../GraphicsNode.hpp"
 
 #include "Node_GenCSM.hpp"
+#include "Node_GpuCull.hpp"
 
 #include "../Scene.hpp"
 #include "../Camera.hpp"
@@ -11,15 +12,19 @@
 #include "../ConstBufferHeap.hpp"
 #include "../GraphicsContext.hpp"
 #include "../PipelineTypes.hpp"
+#include "../InstanceBatcher.hpp"
 #include "GraphicsApi_LL/IPipelineState.hpp"
 #include "GraphicsApi_LL/IGxapiManager.hpp"
 
+#include <future>
+#include <deque>
+
 namespace inl::gxeng::nodes {
 
 class ForwardRender :
 	virtual public GraphicsNode,
-	// Inputs: depth stencil (from depth prepass), geometry, camera, sun
-	virtual public exc::InputPortConfig<pipeline::Texture2D, const EntityCollection<MeshEntity>*, const Camera*, const DirectionalLight*>,
+	// Inputs: depth stencil (from depth prepass), geometry, camera, sun, GPU culled draws (indirect only)
+	virtual public exc::InputPortConfig<pipeline::Texture2D, const EntityCollection<MeshEntity>*, const Camera*, const DirectionalLight*, const GpuDrawList*>,
 	virtual public exc::OutputPortConfig<pipeline::Texture2D>
 {
 private:
@@ -28,21 +33,29 @@ private:
 		std::string shader;
 	};
 	struct ScenarioData {
-		std::unique_ptr<gxapi::IPipelineState> pso;
+		std::shared_ptr<gxapi::IPipelineState> pso;
 		Binder binder;
 		std::vector<int> offsets;
 		size_t constantsSize;
+		std::unique_ptr<gxapi::ICommandSignature> commandSignature; // Indirect only.
+	};
+	struct MaterialConstants {
+		uint64_t version; // Material::GetVersion() at the time of the upload
+		uint64_t lastUsedFrame;
+		ConstBufferView cbv;
 	};
 	struct VsConstants {
-		mathfu::VectorPacked<float, 4> mvp[4];
-		mathfu::VectorPacked<float, 4> model[4];
-	};	
+		mathfu::VectorPacked<float, 4> viewProjection[4];
+	};
 	struct LightConstants {
 		alignas(16) mathfu::VectorPacked<float, 3> direction;
 		alignas(16) mathfu::VectorPacked<float, 3> color;
 	};
 public:
-	ForwardRender(gxapi::IGraphicsApi* graphicsApi);
+	/// <param name="indirect"> If true, entities with materials are drawn by executing the draws culled by
+	///		<see cref="GpuCull"/>, one call for each material. It must match the depth prepass. </param>
+	ForwardRender(gxapi::IGraphicsApi* graphicsApi, bool indirect = false);
+	~ForwardRender();
 
 	void Update() override {}
 	void Notify(exc::InputPortBase* sender) override {}
@@ -50,6 +63,14 @@ public:
 
 	Task GetTask() override;
 
+	/// <summary> Starts compiling the PSOs of the entities in the background,
+	///		so that they are ready by the time the entities are first rendered. </summary>
+	/// <remarks> Must not be called while the node is rendering. </remarks>
+	void Precompile(const EntityCollection<MeshEntity>& entities);
+
+	/// <summary> Draws of the last frame. </summary>
+	const DrawStatistics& GetStatistics() const { return m_statistics; }
+
 private:
 	void InitRenderTarget(unsigned width, unsigned height);
 	void RenderScene(
@@ -57,12 +78,24 @@ private:
 		const EntityCollection<MeshEntity>& entities,
 		const Camera* camera,
 		const DirectionalLight* sun,
+		const GpuDrawList* drawList,
+		uint64_t frameNumber,
+		VolatileViewHeap& volatileHeap,
 		GraphicsCommandList& commandList);
+	/// <summary> Returns the material's constant buffer, uploads the constants if they changed. </summary>
+	const ConstBufferView& GetMaterialConstants(const Material& material, const ScenarioData& scenario, uint64_t frameNumber);
+	/// <summary> Releases the buffers that frames in flight are done with, and retires the constants of materials
+	///		that have not been drawn for a while. Those may have been destroyed, their address reused by a new one. </summary>
+	void ReleaseRetiredConstants(uint64_t frameNumber);
 
-	static std::string GenerateVertexShader(const Mesh::Layout& layout);
-	static std::string GeneratePixelShader(const MaterialShader& shader);
+	/// <remarks> Indirect draws read the world matrices from the GPU scene, see <see cref="GpuDrawList"/>. </remarks>
+	static std::string GenerateVertexShader(const Mesh::Layout& layout, bool indirect);
+	static std::string GeneratePixelShader(const MaterialShader& shader, unsigned bindlessCapacity);
+	/// <remarks> If the engine has a bindless table, textures are not bound but their indices are put in the material constants. </remarks>
 	Binder GenerateBinder(const std::vector<MaterialShaderParameter>& mtlParams, std::vector<int>& offsets, size_t& materialCbSize);
-	ScenarioData& GetScenario(const Mesh::Layout& layout, const MaterialShader& shader);
+	/// <summary> Returns the PSO for the combination, or null if it is still being compiled. </summary>
+	ScenarioData* GetScenario(const Mesh::Layout& layout, const MaterialShader& shader);
+	std::shared_future<std::unique_ptr<ScenarioData>>& StartScenario(const Mesh::Layout& layout, const MaterialShader& shader);
 protected:
 	//unsigned m_width;
 	//unsigned m_height;
@@ -76,7 +109,11 @@ protected:
 	BindParameter m_transformBindParam;
 	BindParameter m_sunBindParam;
 	BindParameter m_albedoBindParam;
-	std::unique_ptr<gxapi::IPipelineState> m_PSO;
+	std::shared_ptr<gxapi::IPipelineState> m_PSO;
+	bool m_indirect;
+
+	InstanceBatcher m_batcher;
+	DrawStatistics m_statistics;
 private:
 	struct ElementHash {
 		size_t operator()(const Mesh::Layout& obj) const { return obj.GetElementHash(); }
@@ -88,9 +125,15 @@ private:
 			return lhs.layout.EqualLayout(rhs.layout) && lhs.shader == rhs.shader;
 		}
 	};
-	std::unordered_map<std::string, ShaderProgram> m_materialShaders; // maps MaterialShader codes to pixel shaders
-	std::unordered_map<Mesh::Layout, ShaderProgram, ElementHash, ElementHash> m_vertexShaders; // maps Mesh layouts to vertex shaders
-	std::unordered_map<ScenarioDesc, ScenarioData, ScenarioHash, ScenarioHash> m_scenarios; // maps mesh-mtlshader pairs to PSOs
+	// These are compiled by background jobs, entities are skipped until their scenario is ready.
+	std::unordered_map<std::string, std::shared_future<ShaderProgram>> m_materialShaders; // maps MaterialShader codes to pixel shaders
+	std::unordered_map<Mesh::Layout, std::shared_future<ShaderProgram>, ElementHash, ElementHash> m_vertexShaders; // maps Mesh layouts to vertex shaders
+	std::unordered_map<ScenarioDesc, std::shared_future<std::unique_ptr<ScenarioData>>, ScenarioHash, ScenarioHash> m_scenarios; // maps mesh-mtlshader pairs to PSOs
+
+	std::unordered_map<const Material*, MaterialConstants> m_materialConstants; // Versions are unique, a new material at an old address does not match.
+	static constexpr uint64_t MATERIAL_CONSTANTS_LIFETIME = 300; // Frames an unused material's constants are kept for.
+	// Outdated buffers might still be read by frames in flight, they are kept until those finish.
+	std::deque<std::pair<uint64_t, ConstBufferView>> m_retiredConstants; // {frame of retirement, buffer}
 };
 
 } // namespace inl::gxeng::nodes
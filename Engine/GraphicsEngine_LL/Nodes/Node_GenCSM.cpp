@@ -3,24 +3,23 @@
 #include "../DirectionalLight.hpp"
 #include "../MeshEntity.hpp"
 #include "../Mesh.hpp"
-#include "../Image.hpp"
-#include "../GraphicsEngine.hpp"
+#include "../LodSelector.hpp"
 
 #include <GraphicsApi_LL/IGxapiManager.hpp>
 
 #include <mathfu/matrix_4x4.h>
 
+#include <algorithm>
 #include <array>
+#include <limits>
 
 
-// OBSOLETE, please update
-#if 0
 namespace inl::gxeng::nodes {
 
 
 static bool CheckMeshFormat(const Mesh& mesh) {
 	for (size_t i = 0; i < mesh.GetNumStreams(); i++) {
-		auto& elements = mesh.GetVertexBufferElements(i);
+		auto& elements = mesh.GetLayout()[0];
 		if (elements.size() != 3) return false;
 		if (elements[0].semantic != eVertexElementSemantic::POSITION) return false;
 		if (elements[1].semantic != eVertexElementSemantic::NORMAL) return false;
@@ -52,116 +51,35 @@ static void ConvertToSubmittable(
 }
 
 
-mathfu::Matrix4x4f LightViewTransform(const DirectionalLight * light) {
-	auto dir = -light->GetDirection();
 
-	auto z = dir;
-	auto x = mathfu::Vector3f::CrossProduct({ 0, 1, 0 }, z);
-	if (x.LengthSquared() < 0.0001f) {
-		x = mathfu::Vector3f(1, 0, 0);
-	}
-	else {
-		x.Normalize();
-	}
-	auto y = mathfu::Vector3f::CrossProduct(z, x);
-
-	return mathfu::Matrix4x4f(x.x(), x.y(), x.z(), 0, y.x(), y.y(), y.z(), 0, z.x(), z.y(), z.z(), 0, 0, 0, 0, 1).Inverse();
-}
-
-
-mathfu::Matrix4x4f LightDirectionalProjectionTransform(const mathfu::Matrix4x4f & lightViewTransform, const Camera * camera) {
-	// Get camera frustum in world space than transform it to sun view space and fit an aabb on it.
-	// This aabb is the ortho proj.
-
-	const std::array<mathfu::Vector4f, 8> camFrustum = {
-		// near plane
-		mathfu::Vector4f(-1.f, -1.f, -0.f, 1.f),
-		mathfu::Vector4f(+1.f, -1.f, -0.f, 1.f),
-		mathfu::Vector4f(+1.f, +1.f, -0.f, 1.f),
-		mathfu::Vector4f(-1.f, +1.f, -0.f, 1.f),
-
-		// far plane
-		mathfu::Vector4f(-1.f, -1.f, +1.f, 1.f),
-		mathfu::Vector4f(+1.f, -1.f, +1.f, 1.f),
-		mathfu::Vector4f(+1.f, +1.f, +1.f, 1.f),
-		mathfu::Vector4f(-1.f, +1.f, +1.f, 1.f)
-	};
-
-	auto camProjToWorld = (camera->GetPerspectiveMatrixRH() * camera->GetViewMatrixRH()).Inverse();
-	auto transform = lightViewTransform * camProjToWorld;
-
-	mathfu::Vector4f aabbMin = mathfu::Vector4f(INFINITY, INFINITY, INFINITY, INFINITY);
-	mathfu::Vector4f aabbMax = -aabbMin;
-
-	for (const auto& curr : camFrustum) {
-		auto v = transform * curr;
-		float w = v.w();
-		v /= w;
-		aabbMin = mathfu::Vector4f::Min(aabbMin, v);
-		aabbMax = mathfu::Vector4f::Max(aabbMax, v);
-	}
-
-	float depth = aabbMax.z() - aabbMin.z();
-
-	// RIGHT HANDED
-	return mathfu::Matrix4x4f::Ortho(aabbMin.x(), aabbMax.x(), aabbMin.y(), aabbMax.y(), aabbMax.z() + depth, aabbMin.z(), 1.f);
-}
-
-
-GenCSM::GenCSM(
-	gxapi::IGraphicsApi* graphicsApi,
-	unsigned width,
-	unsigned height
-) :
-	m_width(width),
-	m_height(height),
+GenCSM::GenCSM(gxapi::IGraphicsApi* graphicsApi, unsigned resolution, unsigned cascadeCount) :
+	m_fitter(cascadeCount, resolution),
+	m_camera(nullptr),
+	m_viewportHeight(1),
 	m_binder(graphicsApi, {})
 {
 	this->GetInput<0>().Set(nullptr);
-
-	m_cascades.subCameras.resize(m_cascadeCount);
-
-	BindParameterDesc cbBindParamDesc;
-	m_cbBindParam = BindParameter(eBindParameterType::CONSTANT, 0);
-	cbBindParamDesc.parameter = m_cbBindParam;
-	cbBindParamDesc.constantSize = sizeof(float) * 4 * 4;
-	cbBindParamDesc.relativeAccessFrequency = 0;
-	cbBindParamDesc.relativeChangeFrequency = 0;
-	cbBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
-
-	BindParameterDesc texBindParamDesc;
-	m_texBindParam = BindParameter(eBindParameterType::TEXTURE, 0);
-	texBindParamDesc.parameter = m_texBindParam;
-	texBindParamDesc.constantSize = 0;
-	texBindParamDesc.relativeAccessFrequency = 0;
-	texBindParamDesc.relativeChangeFrequency = 0;
-	texBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
-
-	BindParameterDesc sampBindParamDesc;
-	sampBindParamDesc.parameter = BindParameter(eBindParameterType::SAMPLER, 0);
-	sampBindParamDesc.constantSize = 0;
-	sampBindParamDesc.relativeAccessFrequency = 0;
-	sampBindParamDesc.relativeChangeFrequency = 0;
-	sampBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
-
-	gxapi::StaticSamplerDesc samplerDesc;
-	samplerDesc.shaderRegister = 0;
-	samplerDesc.filter = gxapi::eTextureFilterMode::MIN_MAG_MIP_LINEAR;
-	samplerDesc.addressU = gxapi::eTextureAddressMode::WRAP;
-	samplerDesc.addressV = gxapi::eTextureAddressMode::WRAP;
-	samplerDesc.addressW = gxapi::eTextureAddressMode::WRAP;
-	samplerDesc.mipLevelBias = 0.f;
-	samplerDesc.registerSpace = 0;
-	samplerDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
-
-	m_binder = Binder{ graphicsApi,{ cbBindParamDesc, texBindParamDesc, sampBindParamDesc },{ samplerDesc } };
+	this->GetInput<3>().Set(nullptr);
 }
 
 
 void GenCSM::InitGraphics(const GraphicsContext& context) {
 	m_graphicsContext = context;
 
-	InitBuffers();
+	BindParameterDesc transformBindParamDesc;
+	m_transformBindParam = BindParameter(eBindParameterType::CONSTANT, 0);
+	transformBindParamDesc.parameter = m_transformBindParam;
+	transformBindParamDesc.constantSize = sizeof(float) * 4 * 4;
+	transformBindParamDesc.relativeAccessFrequency = 0;
+	transformBindParamDesc.relativeChangeFrequency = 0;
+	transformBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::VERTEX;
+
+	m_binder = context.CreateBinder({ transformBindParamDesc });
+
+	// LODs are selected as for the camera's view, so shadows match the geometry on the screen.
+	m_viewportHeight = context.GetSwapChainDesc().height;
+
+	InitRenderTarget();
 
 	ShaderParts shaderParts;
 	shaderParts.vs = true;
@@ -181,24 +99,25 @@ void GenCSM::InitGraphics(const GraphicsContext& context) {
 	psoDesc.rootSignature = m_binder.GetRootSignature();
 	psoDesc.vs = shader.vs;
 	psoDesc.ps = shader.ps;
-	psoDesc.rasterization = gxapi::RasterizerState(gxapi::eFillMode::SOLID, gxapi::eCullMode::DRAW_CW);
+	// Both faces are drawn, and the slope bias keeps surfaces at grazing angles from shadowing themselves.
+	psoDesc.rasterization = gxapi::RasterizerState(gxapi::eFillMode::SOLID, gxapi::eCullMode::DRAW_ALL, 0, 0.0f, 1.5f);
 	psoDesc.primitiveTopologyType = gxapi::ePrimitiveTopologyType::TRIANGLE;
-	psoDesc.blending.multiTarget[0].enableBlending = false;
-	psoDesc.blending.multiTarget[0].enableLogicOp = false;
-	psoDesc.blending.multiTarget[1].enableBlending = false;
-	psoDesc.blending.multiTarget[1].enableLogicOp = false;
 
 	psoDesc.depthStencilState = gxapi::DepthStencilState(true, true);
 	psoDesc.depthStencilFormat = gxapi::eFormat::D32_FLOAT;
 
 	psoDesc.numRenderTargets = 0;
 
-	m_PSO.reset(m_graphicsContext.CreatePSO(psoDesc));
+	m_PSO = m_graphicsContext.CreatePSO(psoDesc);
 }
 
 
 Task GenCSM::GetTask() {
-	return Task({ [this](const ExecutionContext& context) {
+	// Fitting and culling runs first, then each cascade is recorded by its own subtask.
+	Task task;
+
+	auto fitNode = task.m_nodes.addNode();
+	task.m_subtasks[fitNode] = [this](const ExecutionContext& context) {
 		ExecutionResult result;
 
 		const Camera* camera = this->GetInput<0>().Get();
@@ -207,143 +126,182 @@ Task GenCSM::GetTask() {
 		const DirectionalLight* sun = this->GetInput<1>().Get();
 		this->GetInput<1>().Clear();
 
-		const EntityCollection<MeshEntity>* entities = this->GetInput<2>().Get();
+		const EntityCollection<MeshEntity>* casters = this->GetInput<2>().Get();
 		this->GetInput<2>().Clear();
 
-		if (entities) {
-			GraphicsCommandList cmdList = context.GetGraphicsCommandList();
-			RenderScene(camera, sun, *entities, context.GetFrameNumber(), cmdList);
-			result.AddCommandList(std::move(cmdList));
+		const EntityCollection<MeshEntity>* receivers = this->GetInput<3>().Get();
+		this->GetInput<3>().Clear();
+
+		m_casters.clear();
+		if (camera && sun && casters) {
+			FitCascades(camera, sun, *casters, receivers);
 		}
 
+		GraphicsCommandList cmdList = context.GetGraphicsCommandList();
+		ClearMaps(cmdList);
+		result.AddCommandList(std::move(cmdList));
+
 		this->GetOutput<0>().Set(&m_cascades);
 
 		return result;
-	} });
-}
+	};
 
+	for (unsigned i = 0; i < m_fitter.GetCascadeCount(); ++i) {
+		auto cascadeNode = task.m_nodes.addNode();
+		task.m_subtasks[cascadeNode] = [this, i](const ExecutionContext& context) {
+			ExecutionResult result;
+			// Cascades without casters are left cleared.
+			if (!m_casters.empty() && !m_fitter.GetCascades()[i].casters.empty()) {
+				GraphicsCommandList cmdList = context.GetGraphicsCommandList();
+				RenderCascade(i, cmdList);
+				result.AddCommandList(std::move(cmdList));
+			}
+			return result;
+		};
+		task.m_nodes.addArc(fitNode, cascadeNode);
+	}
 
-void GenCSM::SetShadowMapSize(unsigned width, unsigned height) {
-	m_width = width;
-	m_height = height;
-	InitBuffers();
+	return task;
 }
 
 
-void GenCSM::InitBuffers() {
+void GenCSM::InitRenderTarget() {
 	using gxapi::eFormat;
 
-	m_cascades.mapArray = DepthStencilArrayPack(
-		m_width,
-		m_height,
-		m_cascadeCount,
-		eFormat::D32_FLOAT,
-		eFormat::R32_FLOAT,
-		eFormat::R32_TYPELESS,
-		m_graphicsContext);
-}
-
+	const unsigned resolution = m_fitter.GetResolution();
+	const unsigned cascadeCount = m_fitter.GetCascadeCount();
 
-Camera& GenCSM::CalculateSubCamera(const Camera* camera, unsigned cascadeID) {
-	// maps every x in range [0, 1] to an exponentialy
-	// increasing curve in the range [0, 1]
-	auto Exponential = [](float x) {
-		constexpr float steepness = 32;
-		return (std::pow(steepness, x) - 1.f) / (steepness - 1.f);
-	};
+	Texture2D tex = m_graphicsContext.CreateTransientDepthStencil2D(resolution, resolution, eFormat::R32_TYPELESS, true, eTransientScope::DOWNSTREAM, (uint16_t)cascadeCount);
 
-	assert(m_cascades.subCameras.size() == m_cascadeCount);
-	assert(cascadeID < m_cascadeCount);
+	m_dsvs.clear();
+	for (unsigned i = 0; i < cascadeCount; ++i) {
+		gxapi::DsvTexture2DArray dsvDesc;
+		dsvDesc.activeArraySize = 1;
+		dsvDesc.firstArrayElement = i;
+		dsvDesc.firstMipLevel = 0;
 
-	const float origDepth = camera->GetFarPlane() - camera->GetNearPlane();
-	const float origNear = camera->GetNearPlane();
-	
-	const float nearOffset = origDepth * Exponential(float(cascadeID) / m_cascadeCount);
-	const float farOffset = origDepth * Exponential(float(cascadeID + 1) / m_cascadeCount);
-	const float newFar = origNear + farOffset;
-	const float newNear = origNear + nearOffset;
+		m_dsvs.push_back(m_graphicsContext.CreateDsv(tex, eFormat::D32_FLOAT, dsvDesc));
+	}
 
-	Camera& cam = m_cascades.subCameras[cascadeID];
-	cam = *camera;
-	cam.SetNearPlane(newNear);
-	cam.SetFarPlane(newFar);
+	gxapi::SrvTexture2DArray srvDesc;
+	srvDesc.activeArraySize = cascadeCount;
+	srvDesc.firstArrayElement = 0;
+	srvDesc.numMipLevels = -1;
+	srvDesc.mipLevelClamping = 0;
+	srvDesc.mostDetailedMip = 0;
+	srvDesc.planeIndex = 0;
 
-	return cam;
+	m_cascades.mapArray = m_graphicsContext.CreateSrv(tex, eFormat::R32_FLOAT, srvDesc);
 }
 
 
-void GenCSM::RenderScene(
-	const Camera* camera,
-	const DirectionalLight* sun,
-	const EntityCollection<MeshEntity>& entities,
-	uint64_t frameID,
-	GraphicsCommandList & commandList
-) {
-	// Set render target
-	//const int cascadeID = frameID % m_cascadeCount;
-	//const int cascadeID = 0;
-	for (int cascadeID = 0; cascadeID < m_cascadeCount; cascadeID++) {
-		assert(m_cascades.mapArray.dsvs.size() == m_cascadeCount);
-		auto& renderTargetDsv = m_cascades.mapArray.dsvs[cascadeID];
-
-		commandList.SetRenderTargets(0, nullptr, &renderTargetDsv);
-
-		gxapi::Rectangle rect{ 0, static_cast<int>(m_height), 0, static_cast<int>(m_width) };
-		gxapi::Viewport viewport;
-		viewport.width = (float)rect.right;
-		viewport.height = (float)rect.bottom;
-		viewport.topLeftX = 0;
-		viewport.topLeftY = 0;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		commandList.SetScissorRects(1, &rect);
-		commandList.SetViewports(1, &viewport);
-
-		commandList.SetResourceState(renderTargetDsv.GetResource(), cascadeID, gxapi::eResourceState::DEPTH_WRITE);
-		commandList.ClearDepthStencil(renderTargetDsv, 1, 0);
-
-		commandList.SetPipelineState(m_PSO.get());
-		commandList.SetGraphicsBinder(&m_binder);
-		commandList.SetPrimitiveTopology(gxapi::ePrimitiveTopology::TRIANGLELIST);
-
-		Camera& subcamera = CalculateSubCamera(camera, cascadeID);
-
-		auto view = LightViewTransform(sun);
-		auto viewProjection = LightDirectionalProjectionTransform(view, &subcamera) * view;
-
-		std::vector<const gxeng::VertexBuffer*> vertexBuffers;
-		std::vector<unsigned> sizes;
-		std::vector<unsigned> strides;
-
-		// Iterate over all entities
-		for (const MeshEntity* entity : entities) {
-			// Get entity parameters
-			Mesh* mesh = entity->GetMesh();
-			auto position = entity->GetPosition();
-
-			// Draw mesh
-			if (!CheckMeshFormat(*mesh)) {
-				assert(false);
+void GenCSM::FitCascades(const Camera* camera,
+						 const DirectionalLight* sun,
+						 const EntityCollection<MeshEntity>& casters,
+						 const EntityCollection<MeshEntity>* receivers)
+{
+	m_fitter.Fit(*camera, sun->GetDirection());
+
+	m_casterBounds.clear();
+	for (const MeshEntity* entity : casters) {
+		const Mesh* mesh = entity->GetMesh();
+		// Skip meshes whose data has not arrived yet.
+		if (mesh->HasPendingUploads()) {
+			continue;
+		}
+		m_casters.push_back(entity);
+		m_casterBounds.push_back({ mesh->GetBoundingBoxMin(), mesh->GetBoundingBoxMax(), entity->GetTransform() });
+	}
+
+	// Receivers only narrow the depth range of the cascades, their slices stay on the camera's range.
+	m_receiverBounds.clear();
+	if (receivers) {
+		for (const MeshEntity* entity : *receivers) {
+			const Mesh* mesh = entity->GetMesh();
+			if (mesh->HasPendingUploads()) {
 				continue;
 			}
+			m_receiverBounds.push_back({ mesh->GetBoundingBoxMin(), mesh->GetBoundingBoxMax(), entity->GetTransform() });
+		}
+	}
+	m_fitter.Cull(m_casterBounds, m_receiverBounds);
+	m_camera = camera;
+
+	const auto& cascades = m_fitter.GetCascades();
+	m_cascades.transforms.resize(cascades.size());
+	m_cascades.farDistances.resize(cascades.size());
+	for (size_t i = 0; i < cascades.size(); ++i) {
+		m_cascades.transforms[i] = cascades[i].viewProjection;
+		m_cascades.farDistances[i] = cascades[i].farDistance;
+	}
+}
 
-			ConvertToSubmittable(mesh, vertexBuffers, sizes, strides);
 
-			auto world = entity->GetTransform();
-			auto MVP = viewProjection * world;
+void GenCSM::ClearMaps(GraphicsCommandList& commandList) {
+	// The shadow maps are transient, they may have held another texture until now.
+	Texture2D& maps = m_dsvs[0].GetResource();
+	commandList.ResourceBarrier(gxapi::AliasingBarrier{ nullptr, maps._GetResourcePtr() });
+	for (unsigned i = 0; i < m_dsvs.size(); ++i) {
+		commandList.SetResourceState(maps, maps.GetSubresourceIndex(i, 0), gxapi::eResourceState::DEPTH_WRITE);
+		commandList.ClearDepthStencil(m_dsvs[i], 1, 0, 0, nullptr, true, false);
+	}
+}
+
+
+void GenCSM::RenderCascade(unsigned cascadeIndex, GraphicsCommandList& commandList) {
+	const ShadowCascadeFitter::Cascade& cascade = m_fitter.GetCascades()[cascadeIndex];
+
+	DepthStencilView2D& dsv = m_dsvs[cascadeIndex];
+	Texture2D& maps = dsv.GetResource();
+	commandList.SetResourceState(maps, maps.GetSubresourceIndex(cascadeIndex, 0), gxapi::eResourceState::DEPTH_WRITE);
+	commandList.SetRenderTargets(0, nullptr, &dsv);
+
+	gxapi::Rectangle rect{ 0, (int)maps.GetHeight(), 0, (int)maps.GetWidth() };
+	gxapi::Viewport viewport;
+	viewport.width = (float)rect.right;
+	viewport.height = (float)rect.bottom;
+	viewport.topLeftX = 0;
+	viewport.topLeftY = 0;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	commandList.SetScissorRects(1, &rect);
+	commandList.SetViewports(1, &viewport);
+
+	commandList.SetPipelineState(m_PSO.get());
+	commandList.SetGraphicsBinder(&m_binder);
+	commandList.SetPrimitiveTopology(gxapi::ePrimitiveTopology::TRIANGLELIST);
 
-			std::array<mathfu::VectorPacked<float, 4>, 4> cbufferData;
-			MVP.Pack(cbufferData.data());
+	LodSelector lodSelector(m_camera, m_viewportHeight);
 
-			commandList.BindGraphics(m_texBindParam, *entity->GetTexture()->GetSrv());
-			commandList.BindGraphics(m_cbBindParam, cbufferData.data(), sizeof(cbufferData), 0);
-			commandList.SetVertexBuffers(0, (unsigned)vertexBuffers.size(), vertexBuffers.data(), sizes.data(), strides.data());
-			commandList.SetIndexBuffer(&mesh->GetIndexBuffer(), mesh->IsIndexBuffer32Bit());
-			commandList.DrawIndexedInstanced((unsigned)mesh->GetIndexBuffer().GetIndexCount());
+	std::vector<const gxeng::VertexBuffer*> vertexBuffers;
+	std::vector<unsigned> sizes;
+	std::vector<unsigned> strides;
+
+	// Only the casters that overlap this cascade are drawn.
+	for (uint32_t casterIndex : cascade.casters) {
+		const MeshEntity* entity = m_casters[casterIndex];
+		Mesh* mesh = entity->GetMesh();
+
+		if (!CheckMeshFormat(*mesh)) {
+			assert(false);
+			continue;
 		}
+
+		ConvertToSubmittable(mesh, vertexBuffers, sizes, strides);
+
+		auto MVP = cascade.viewProjection * entity->GetTransform();
+
+		std::array<mathfu::VectorPacked<float, 4>, 4> transformCBData;
+		MVP.Pack(transformCBData.data());
+
+		commandList.BindGraphics(m_transformBindParam, transformCBData.data(), sizeof(transformCBData), 0);
+
+		commandList.SetVertexBuffers(0, (unsigned)vertexBuffers.size(), vertexBuffers.data(), sizes.data(), strides.data());
+		commandList.SetIndexBuffer(&mesh->GetIndexBuffer(), mesh->IsIndexBuffer32Bit());
+		const IndexRange& lodRange = mesh->GetLodRange(lodSelector.SelectLod(*entity));
+		commandList.DrawIndexedInstanced((unsigned)lodRange.indexCount, (unsigned)lodRange.firstIndex);
 	}
 }
 
 
 } // namespace inl::gxeng::nodes
-#endif
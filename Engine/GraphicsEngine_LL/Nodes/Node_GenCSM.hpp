@@ -4,6 +4,7 @@
 
 #include "../Scene.hpp"
 #include "../Camera.hpp"
+#include "../ShadowCascades.hpp"
 #include "../ConstBufferHeap.hpp"
 #include "../GraphicsContext.hpp"
 #include "../PipelineTypes.hpp"
@@ -13,92 +14,78 @@
 #include <vector>
 
 
+namespace inl::gxeng {
+class DirectionalLight;
+} // namespace inl::gxeng
 
-// OBSOLETE
-// this class should be updated to match current pipeline
 
-#if 0
 namespace inl::gxeng::nodes {
 
 
 /// <summary>
-/// Takes a directional light and returns a transformation that acts
-/// as a view transform when rendering a shadow map.
+/// Shadow maps of a directional light, one slice of the texture array for each cascade.
 /// </summary>
-mathfu::Matrix4x4f LightViewTransform(const DirectionalLight* light);
-
-/// <summary>
-/// Takes a view transformation of a directional light and 
-/// returns a transformation that acts as a projection transform when
-/// rendering shadow map for the corresponding directional light, and camera.
-/// The frustum of the light is fitted on the camera frustum.
-/// </summary>
-mathfu::Matrix4x4f LightDirectionalProjectionTransform(const mathfu::Matrix4x4f& lightViewTransform, const Camera* camera);
-
-
-// A single shadow map and the corresponding camera for cascaded shadow maps
-struct ShadowMapCascade {
-	Camera subCamera;
-	DepthStencilPack map;
-};
-
-// Contains shadow maps and their corresponding camera for each cascade of
-// a cascaded shadow map
 struct ShadowCascades {
-	DepthStencilArrayPack mapArray;
-	std::vector<Camera> subCameras;
+	TextureView2D mapArray;
+	std::vector<mathfu::Matrix4x4f> transforms; // World space to the shadow map of each cascade.
+	std::vector<float> farDistances; // Where each cascade ends along the camera's view direction.
 };
 
 
-// Cascaded shadow mapping
+/// <summary>
+/// Renders cascaded shadow maps of the sun.
+/// Inputs: camera, sun, shadow casters (usually all entities of the scene),
+/// receivers (the visible entities, they narrow the depth range of the cascades; optional).
+/// </summary>
+/// <remarks>
+/// Cascades are fitted and casters are culled for each cascade on the CPU first,
+/// then every cascade is recorded into its own command list by a separate subtask,
+/// drawing only the casters that fall into it.
+/// </remarks>
 class GenCSM :
 	virtual public GraphicsNode,
-	virtual public exc::InputPortConfig<const Camera*, const DirectionalLight*, const EntityCollection<MeshEntity>*>,
+	virtual public exc::InputPortConfig<const Camera*, const DirectionalLight*, const EntityCollection<MeshEntity>*, const EntityCollection<MeshEntity>*>,
 	virtual public exc::OutputPortConfig<const ShadowCascades*>
 {
 public:
-	GenCSM(
-		gxapi::IGraphicsApi* graphicsApi,
-		unsigned width,
-		unsigned height);
+	GenCSM(gxapi::IGraphicsApi* graphicsApi, unsigned resolution = 1024, unsigned cascadeCount = 4);
 
 	void Update() override {}
 	void Notify(exc::InputPortBase* sender) override {}
-	void InitGraphics(const GraphicsContext&) override;
+	void InitGraphics(const GraphicsContext& context) override;
 
 	Task GetTask() override;
 
-	void SetShadowMapSize(unsigned width, unsigned height);
+	/// <summary> 0 splits the view range uniformly, 1 logarithmically. </summary>
+	void SetLogarithmicWeight(float weight) { m_fitter.SetLogarithmicWeight(weight); }
 
-protected:
-	unsigned m_width;
-	unsigned m_height;
+	const ShadowCascadeFitter& GetFitter() const { return m_fitter; }
 
-	MemoryManager* m_memoryManager;
+protected:
+	ShadowCascades m_cascades;
+	std::vector<DepthStencilView2D> m_dsvs;
+	ShadowCascadeFitter m_fitter;
+	std::vector<ShadowCascadeFitter::Caster> m_casterBounds;
+	std::vector<ShadowCascadeFitter::Receiver> m_receiverBounds;
+	std::vector<const MeshEntity*> m_casters;
+	const Camera* m_camera;
+	unsigned m_viewportHeight;
 
 protected:
 	GraphicsContext m_graphicsContext;
 	Binder m_binder;
-	BindParameter m_cbBindParam;
-	BindParameter m_texBindParam;
-	std::unique_ptr<gxapi::IPipelineState> m_PSO;
-
-protected:
-	unsigned m_cascadeCount = 5;
-	ShadowCascades_DEPRECATED m_cascades;
-	//std::vector<ShadowMapCascade> m_cascades; // cameras for subfrusta
+	BindParameter m_transformBindParam;
+	std::shared_ptr<gxapi::IPipelineState> m_PSO;
 
 private:
-	void InitBuffers();
-	Camera& CalculateSubCamera(const Camera* camera, unsigned cascadeID);
-	void RenderScene(
-		const Camera* camera,
-		const DirectionalLight* sun,
-		const EntityCollection<MeshEntity>& entities,
-		uint64_t frameID,
-		GraphicsCommandList& commandList);
+	void InitRenderTarget();
+	void FitCascades(const Camera* camera,
+					 const DirectionalLight* sun,
+					 const EntityCollection<MeshEntity>& casters,
+					 const EntityCollection<MeshEntity>* receivers);
+	void ClearMaps(GraphicsCommandList& commandList);
+	void RenderCascade(unsigned cascadeIndex, GraphicsCommandList& commandList);
 };
 
 
 } // namespace inl::gxeng::nodes
-#endif
@@ -0,0 +1,402 @@
+#include "Node_GpuCull.hpp"
+
+#include "../MeshEntity.hpp"
+#include "../Mesh.hpp"
+#include "../LodSelector.hpp"
+
+#include <algorithm>
+
+namespace inl::gxeng::nodes {
+
+
+static bool CheckMeshFormat(const Mesh& mesh) {
+	for (size_t i = 0; i < mesh.GetNumStreams(); i++) {
+		auto& elements = mesh.GetLayout()[0];
+		if (elements.size() != 3) return false;
+		if (elements[0].semantic != eVertexElementSemantic::POSITION) return false;
+		if (elements[1].semantic != eVertexElementSemantic::NORMAL) return false;
+		if (elements[2].semantic != eVertexElementSemantic::TEX_COORD) return false;
+	}
+
+	return true;
+}
+
+
+// Meshes have a single interleaved vertex stream, see CheckMeshFormat.
+static void WriteCommand(Mesh* mesh, size_t lod, GpuCommand& command) {
+	const VertexBuffer& vertexBuffer = mesh->GetVertexBuffer(0);
+	command.vertexBuffer.gpuVirtualAddress = (uint64_t)vertexBuffer.GetVirtualAddress();
+	command.vertexBuffer.sizeInBytes = (uint32_t)vertexBuffer.GetSize();
+	command.vertexBuffer.strideInBytes = (uint32_t)mesh->GetVertexBufferStride(0);
+
+	const IndexBuffer& indexBuffer = mesh->GetIndexBuffer();
+	command.indexBuffer.gpuVirtualAddress = (uint64_t)indexBuffer.GetVirtualAddress();
+	command.indexBuffer.sizeInBytes = (uint32_t)indexBuffer.GetSize();
+	command.indexBuffer.format = mesh->IsIndexBuffer32Bit() ? gxapi::eFormat::R32_UINT : gxapi::eFormat::R16_UINT;
+
+	const IndexRange& lodRange = mesh->GetLodRange(lod);
+	command.draw.indexCountPerInstance = (uint32_t)lodRange.indexCount;
+	command.draw.startIndexLocation = (uint32_t)lodRange.firstIndex;
+	command.draw.baseVertexLocation = 0;
+}
+
+
+static size_t BufferSize(size_t size) {
+	size_t result = 4096;
+	while (result < size) {
+		result *= 2;
+	}
+	return result;
+}
+
+
+
+GpuCull::GpuCull(gxapi::IGraphicsApi* graphicsApi) :
+	m_binder(graphicsApi, {}),
+	m_viewportHeight(1)
+{
+	this->GetInput<0>().Set({});
+	this->GetInput<2>().Set(nullptr);
+}
+
+
+void GpuCull::InitGraphics(const GraphicsContext& context) {
+	m_graphicsContext = context;
+
+	BindParameterDesc constantsBindParamDesc;
+	m_constantsBindParam = BindParameter(eBindParameterType::CONSTANT, 0);
+	constantsBindParamDesc.parameter = m_constantsBindParam;
+	constantsBindParamDesc.constantSize = 0; // Bound as a CBV, too large to be inline.
+	constantsBindParamDesc.relativeAccessFrequency = 0;
+	constantsBindParamDesc.relativeChangeFrequency = 0;
+	constantsBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
+
+	BindParameterDesc instancesBindParamDesc;
+	m_instancesBindParam = BindParameter(eBindParameterType::TEXTURE, 0);
+	instancesBindParamDesc.parameter = m_instancesBindParam;
+	instancesBindParamDesc.constantSize = 0;
+	instancesBindParamDesc.relativeAccessFrequency = 0;
+	instancesBindParamDesc.relativeChangeFrequency = 0;
+	instancesBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
+
+	BindParameterDesc drawsBindParamDesc;
+	m_drawsBindParam = BindParameter(eBindParameterType::TEXTURE, 1);
+	drawsBindParamDesc.parameter = m_drawsBindParam;
+	drawsBindParamDesc.constantSize = 0;
+	drawsBindParamDesc.relativeAccessFrequency = 0;
+	drawsBindParamDesc.relativeChangeFrequency = 0;
+	drawsBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
+
+	BindParameterDesc pyramidBindParamDesc;
+	m_pyramidBindParam = BindParameter(eBindParameterType::TEXTURE, 2);
+	pyramidBindParamDesc.parameter = m_pyramidBindParam;
+	pyramidBindParamDesc.constantSize = 0;
+	pyramidBindParamDesc.relativeAccessFrequency = 0;
+	pyramidBindParamDesc.relativeChangeFrequency = 0;
+	pyramidBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
+
+	BindParameterDesc commandsBindParamDesc;
+	m_commandsBindParam = BindParameter(eBindParameterType::UNORDERED, 0);
+	commandsBindParamDesc.parameter = m_commandsBindParam;
+	commandsBindParamDesc.constantSize = 0;
+	commandsBindParamDesc.relativeAccessFrequency = 0;
+	commandsBindParamDesc.relativeChangeFrequency = 0;
+	commandsBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
+
+	BindParameterDesc visibleBindParamDesc;
+	m_visibleBindParam = BindParameter(eBindParameterType::UNORDERED, 1);
+	visibleBindParamDesc.parameter = m_visibleBindParam;
+	visibleBindParamDesc.constantSize = 0;
+	visibleBindParamDesc.relativeAccessFrequency = 0;
+	visibleBindParamDesc.relativeChangeFrequency = 0;
+	visibleBindParamDesc.shaderVisibility = gxapi::eShaderVisiblity::ALL;
+
+	m_binder = context.CreateBinder({ constantsBindParamDesc, instancesBindParamDesc, drawsBindParamDesc, pyramidBindParamDesc, commandsBindParamDesc, visibleBindParamDesc });
+
+	// Must select the same levels as the render passes would, they use the full screen.
+	m_viewportHeight = context.GetSwapChainDesc().height;
+
+	ShaderParts shaderParts;
+	shaderParts.cs = true;
+
+	auto shader = m_graphicsContext.CreateShader("GpuCull", shaderParts, "");
+
+	gxapi::ComputePipelineStateDesc csoDesc;
+	csoDesc.rootSignature = m_binder.GetRootSignature();
+	csoDesc.cs = shader.cs;
+
+	m_CSO = m_graphicsContext.CreatePSO(csoDesc);
+}
+
+
+Task GpuCull::GetTask() {
+	return Task({ [this](const ExecutionContext& context) {
+		ExecutionResult result;
+
+		const EntityCollection<MeshEntity>* entities = this->GetInput<0>().Get();
+		this->GetInput<0>().Clear();
+
+		const Camera* camera = this->GetInput<1>().Get();
+		this->GetInput<1>().Clear();
+
+		const OcclusionCuller* culler = this->GetInput<2>().Get();
+		this->GetInput<2>().Clear();
+
+		if (entities && camera) {
+			GraphicsCommandList cmdList = context.GetGraphicsCommandList();
+			VolatileViewHeap volatileHeap = context.GetVolatileViewHeap();
+
+			UpdateScene(*entities, camera);
+			Cull(camera, culler, context.GetFrameNumber(), volatileHeap, cmdList);
+			this->GetOutput<0>().Set(&m_drawList);
+
+			result.AddCommandList(std::move(cmdList));
+			result.GiveVolatileViewHeap(std::move(volatileHeap));
+		}
+		else {
+			this->GetOutput<0>().Set(nullptr);
+		}
+
+		return result;
+	} });
+}
+
+
+std::unique_ptr<gxapi::ICommandSignature> GpuCull::CreateCommandSignature(const GraphicsContext& context, const Binder& binder, BindParameter firstVisibleParam) {
+	int rootParamIndex, rootTableIndex;
+	binder.Translate(firstVisibleParam, rootParamIndex, rootTableIndex);
+	if (binder.GetRootSignatureDesc().rootParameters[rootParamIndex].type != gxapi::RootParameterDesc::CONSTANT) {
+		throw std::logic_error("The first visible instance must be an inline root constant to be set by indirect commands.");
+	}
+
+	gxapi::CommandSignatureDesc desc;
+	desc.byteStride = sizeof(GpuCommand);
+	desc.arguments.resize(4);
+	desc.arguments[0].type = gxapi::eIndirectArgumentType::VERTEX_BUFFER_VIEW;
+	desc.arguments[0].slot = 0;
+	desc.arguments[1].type = gxapi::eIndirectArgumentType::INDEX_BUFFER_VIEW;
+	desc.arguments[2].type = gxapi::eIndirectArgumentType::CONSTANT;
+	desc.arguments[2].slot = (unsigned)rootParamIndex;
+	desc.arguments[2].destOffsetIn32BitValues = 0;
+	desc.arguments[2].num32BitValues = 1;
+	desc.arguments[3].type = gxapi::eIndirectArgumentType::DRAW_INDEXED;
+
+	return context.CreateCommandSignature(desc, &binder);
+}
+
+
+void GpuCull::UpdateScene(const EntityCollection<MeshEntity>& entities, const Camera* camera) {
+	LodSelector lodSelector(camera, m_viewportHeight);
+
+	m_scene.Begin();
+	for (const MeshEntity* entity : entities) {
+		const Mesh* mesh = entity->GetMesh();
+
+		// Skip meshes whose data has not arrived yet, they are added when it does.
+		if (mesh->HasPendingUploads()) {
+			continue;
+		}
+
+		if (!CheckMeshFormat(*mesh)) {
+			assert(false);
+			continue;
+		}
+
+		m_scene.Add(entity, lodSelector.SelectLod(*entity), mesh->GetVersion(), mesh->GetBoundingBoxMin(), mesh->GetBoundingBoxMax());
+	}
+	m_scene.Build(WriteCommand);
+}
+
+
+bool GpuCull::ReserveBuffer(LinearBuffer& buffer, size_t size, bool unorderedAccess, uint64_t frameNumber) {
+	if (buffer && buffer.GetSize() >= size) {
+		return false;
+	}
+
+	if (buffer) {
+		m_retiredBuffers.push_back({ frameNumber, std::move(buffer) });
+	}
+	// Grows by powers of two, so that a slowly growing scene does not create new buffers every frame.
+	size_t bufferSize = BufferSize(size);
+	buffer = unorderedAccess ? m_graphicsContext.CreateRWBuffer(bufferSize) : m_graphicsContext.CreateBuffer(bufferSize);
+	return true;
+}
+
+
+void GpuCull::CreateViews() {
+	gxapi::SrvBuffer instancesDesc;
+	instancesDesc.firstElement = 0;
+	instancesDesc.numElements = unsigned(m_instanceBuffer.GetSize() / sizeof(GpuInstance));
+	instancesDesc.structureStrideInBytes = sizeof(GpuInstance);
+	instancesDesc.isRaw = false;
+	m_drawList.instances = m_graphicsContext.CreateSrv(m_instanceBuffer, gxapi::eFormat::UNKNOWN, instancesDesc);
+
+	gxapi::SrvBuffer drawsDesc;
+	drawsDesc.firstElement = 0;
+	drawsDesc.numElements = unsigned(m_drawBuffer.GetSize() / sizeof(GpuDraw));
+	drawsDesc.structureStrideInBytes = sizeof(GpuDraw);
+	drawsDesc.isRaw = false;
+	m_drawSrv = m_graphicsContext.CreateSrv(m_drawBuffer, gxapi::eFormat::UNKNOWN, drawsDesc);
+
+	gxapi::SrvBuffer pyramidDesc;
+	pyramidDesc.firstElement = 0;
+	pyramidDesc.numElements = unsigned(m_pyramidBuffer.GetSize() / sizeof(float));
+	pyramidDesc.structureStrideInBytes = 0;
+	pyramidDesc.isRaw = false;
+	m_pyramidSrv = m_graphicsContext.CreateSrv(m_pyramidBuffer, gxapi::eFormat::R32_FLOAT, pyramidDesc);
+
+	// Instance counts are incremented with atomics on a byte address buffer.
+	gxapi::UavBuffer commandsDesc;
+	commandsDesc.raw = true;
+	commandsDesc.firstElement = 0;
+	commandsDesc.numElements = unsigned(m_commandBuffer.GetSize() / sizeof(uint32_t));
+	commandsDesc.elementStride = 0;
+	commandsDesc.countOffset = 0;
+	m_commandUav = m_graphicsContext.CreateUav(m_commandBuffer, gxapi::eFormat::R32_TYPELESS, commandsDesc);
+
+	gxapi::UavBuffer visibleUavDesc;
+	visibleUavDesc.raw = false;
+	visibleUavDesc.firstElement = 0;
+	visibleUavDesc.numElements = unsigned(m_visibleBuffer.GetSize() / sizeof(uint32_t));
+	visibleUavDesc.elementStride = 0;
+	visibleUavDesc.countOffset = 0;
+	m_visibleUav = m_graphicsContext.CreateUav(m_visibleBuffer, gxapi::eFormat::R32_UINT, visibleUavDesc);
+
+	gxapi::SrvBuffer visibleSrvDesc;
+	visibleSrvDesc.firstElement = 0;
+	visibleSrvDesc.numElements = visibleUavDesc.numElements;
+	visibleSrvDesc.structureStrideInBytes = 0;
+	visibleSrvDesc.isRaw = false;
+	m_drawList.visibleInstances = m_graphicsContext.CreateSrv(m_visibleBuffer, gxapi::eFormat::R32_UINT, visibleSrvDesc);
+
+	m_drawList.commands = m_commandBuffer;
+}
+
+
+void GpuCull::Upload(GraphicsCommandList& commandList, LinearBuffer& destination, size_t offset, const void* data, size_t size) {
+	// Volatile buffers are sub-allocated from upload pages, the copy starts at the allocation's place on the page.
+	VolatileConstBuffer source = m_graphicsContext.CreateVolatileConstBuffer(data, size);
+	size_t sourceOffset = (uint8_t*)source.GetVirtualAddress() - (uint8_t*)source.MemoryObject::GetVirtualAddress();
+
+	commandList.SetResourceState(destination, 0, gxapi::eResourceState::COPY_DEST);
+	commandList.CopyBuffer(destination, offset, source, sourceOffset, size);
+}
+
+
+void GpuCull::Cull(const Camera* camera, const OcclusionCuller* culler, uint64_t frameNumber, VolatileViewHeap& volatileHeap, GraphicsCommandList& commandList) {
+	ReleaseRetiredBuffers(frameNumber);
+
+	const std::vector<GpuInstance>& instances = m_scene.GetInstances();
+	const std::vector<GpuDraw>& draws = m_scene.GetDraws();
+	const std::vector<GpuCommand>& commands = m_scene.GetCommands();
+
+	m_drawList.groups = m_scene.GetGroups();
+	m_drawList.commandCount = (uint32_t)commands.size();
+
+	// The buffers of the commands are kept until the commands are written again, even if their mesh was set anew since.
+	if (m_scene.IsLayoutChanged()) {
+		std::vector<Mesh*> meshes = m_scene.GetCommandMeshes();
+		std::sort(meshes.begin(), meshes.end());
+		meshes.erase(std::unique(meshes.begin(), meshes.end()), meshes.end());
+
+		m_drawList.meshBuffers.clear();
+		for (Mesh* mesh : meshes) {
+			m_drawList.meshBuffers.push_back(mesh->GetVertexBuffer(0));
+			m_drawList.meshBuffers.push_back(mesh->GetIndexBuffer());
+		}
+	}
+
+	if (commands.empty()) {
+		return;
+	}
+
+	// Levels of the pyramid follow each other in a single buffer.
+	CullConstants constants;
+	(camera->GetPerspectiveMatrixRH() * camera->GetViewMatrixRH()).Pack(constants.viewProjection);
+	constants.instanceCount = (uint32_t)instances.size();
+	constants.levelCount = 0;
+	constants.width = 0;
+	constants.height = 0;
+	m_pyramid.clear();
+	if (culler != nullptr) {
+		constants.levelCount = (uint32_t)std::min<size_t>(culler->GetLevelCount(), MAX_LEVELS);
+		constants.width = culler->GetWidth();
+		constants.height = culler->GetHeight();
+		for (uint32_t level = 0; level < constants.levelCount; ++level) {
+			const std::vector<float>& depths = culler->GetLevelDepths(level);
+			constants.levelOffsets[level] = (uint32_t)m_pyramid.size();
+			constants.levelWidths[level] = culler->GetLevelWidth(level);
+			m_pyramid.insert(m_pyramid.end(), depths.begin(), depths.end());
+		}
+	}
+
+	size_t commandsSize = commands.size() * sizeof(GpuCommand);
+	bool newInstanceBuffer = ReserveBuffer(m_instanceBuffer, instances.size() * sizeof(GpuInstance), false, frameNumber);
+	bool newDrawBuffer = ReserveBuffer(m_drawBuffer, draws.size() * sizeof(GpuDraw), false, frameNumber);
+	bool newTemplateBuffer = ReserveBuffer(m_commandTemplateBuffer, commandsSize, false, frameNumber);
+	bool newCommandBuffer = ReserveBuffer(m_commandBuffer, commandsSize, true, frameNumber);
+	bool newVisibleBuffer = ReserveBuffer(m_visibleBuffer, m_scene.GetVisibleCapacity() * sizeof(uint32_t), true, frameNumber);
+	bool newPyramidBuffer = ReserveBuffer(m_pyramidBuffer, m_pyramid.size() * sizeof(float), false, frameNumber);
+	if (newInstanceBuffer || newDrawBuffer || newCommandBuffer || newVisibleBuffer || newPyramidBuffer) {
+		CreateViews();
+	}
+
+	// Only what changed is uploaded, the copies run on the GPU after the previous frame has read the buffers.
+	if (newInstanceBuffer) {
+		Upload(commandList, m_instanceBuffer, 0, instances.data(), instances.size() * sizeof(GpuInstance));
+	}
+	else {
+		for (const GpuScene::Range& range : m_scene.GetDirtyInstances()) {
+			Upload(commandList, m_instanceBuffer, range.first * sizeof(GpuInstance), &instances[range.first], range.count * sizeof(GpuInstance));
+		}
+	}
+	if (newDrawBuffer || m_scene.IsLayoutChanged()) {
+		Upload(commandList, m_drawBuffer, 0, draws.data(), draws.size() * sizeof(GpuDraw));
+	}
+	if (newTemplateBuffer || m_scene.IsLayoutChanged()) {
+		Upload(commandList, m_commandTemplateBuffer, 0, commands.data(), commandsSize);
+	}
+	if (!m_pyramid.empty()) {
+		Upload(commandList, m_pyramidBuffer, 0, m_pyramid.data(), m_pyramid.size() * sizeof(float));
+	}
+
+	// Instance counts start from zero every frame.
+	commandList.SetResourceState(m_commandTemplateBuffer, 0, gxapi::eResourceState::COPY_SOURCE);
+	commandList.SetResourceState(m_commandBuffer, 0, gxapi::eResourceState::COPY_DEST);
+	commandList.CopyBuffer(m_commandBuffer, 0, m_commandTemplateBuffer, 0, commandsSize);
+
+	commandList.SetResourceState(m_instanceBuffer, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+	commandList.SetResourceState(m_drawBuffer, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+	commandList.SetResourceState(m_pyramidBuffer, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+	commandList.SetResourceState(m_commandBuffer, 0, gxapi::eResourceState::UNORDERED_ACCESS);
+	commandList.SetResourceState(m_visibleBuffer, 0, gxapi::eResourceState::UNORDERED_ACCESS);
+
+	VolatileConstBuffer constantBuffer = m_graphicsContext.CreateVolatileConstBuffer(&constants, sizeof(constants));
+	ConstBufferView constantCbv = m_graphicsContext.CreateCbv(constantBuffer, 0, sizeof(constants), volatileHeap);
+
+	commandList.SetPipelineState(m_CSO.get());
+	commandList.SetComputeBinder(&m_binder);
+	commandList.BindCompute(m_constantsBindParam, constantCbv);
+	commandList.BindCompute(m_instancesBindParam, m_drawList.instances);
+	commandList.BindCompute(m_drawsBindParam, m_drawSrv);
+	commandList.BindCompute(m_pyramidBindParam, m_pyramidSrv);
+	commandList.BindCompute(m_commandsBindParam, m_commandUav);
+	commandList.BindCompute(m_visibleBindParam, m_visibleUav);
+	commandList.Dispatch((instances.size() + 63) / 64, 1, 1);
+
+	// The render passes read the results right away.
+	commandList.SetResourceState(m_commandBuffer, 0, gxapi::eResourceState::INDIRECT_ARGUMENT);
+	commandList.SetResourceState(m_visibleBuffer, 0, gxapi::eResourceState::NON_PIXEL_SHADER_RESOURCE);
+}
+
+
+void GpuCull::ReleaseRetiredBuffers(uint64_t frameNumber) {
+	// The engine does not start a frame before the one using the same back buffer has finished.
+	const uint64_t framesInFlight = m_graphicsContext.GetSwapChainDesc().numBuffers;
+	while (!m_retiredBuffers.empty() && m_retiredBuffers.front().first + framesInFlight <= frameNumber) {
+		m_retiredBuffers.pop_front();
+	}
+}
+
+
+} // namespace inl::gxeng::nodes
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "../GraphicsNode.hpp"
+
+#include "../Scene.hpp"
+#include "../Camera.hpp"
+#include "../GpuScene.hpp"
+#include "../OcclusionCuller.hpp"
+#include "../GraphicsContext.hpp"
+#include "GraphicsApi_LL/IPipelineState.hpp"
+#include "GraphicsApi_LL/ICommandSignature.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace inl::gxeng::nodes {
+
+
+/// <summary>
+/// Indirect draw commands of the visible mesh entities, and the buffers their vertex shaders read.
+/// </summary>
+/// <remarks>
+/// The vertex shader of an indirect draw gets the command's firstVisible as a root constant,
+/// and finds the world matrix of instance i at instances[visibleInstances[firstVisible + i]].
+/// </remarks>
+struct GpuDrawList {
+	BufferView instances; // StructuredBuffer of GpuInstance.
+	BufferView visibleInstances; // Buffer<uint> of instance slots.
+	LinearBuffer commands; // GpuCommands, in INDIRECT_ARGUMENT state once the node has run.
+	std::vector<GpuScene::Group> groups; // Commands of the same material, one indirect draw each.
+	std::vector<MemoryObject> meshBuffers; // Vertex and index buffers the commands point to, passes drawing them must use them.
+	uint32_t commandCount = 0;
+};
+
+
+/// <summary>
+/// Keeps the transforms, bounds and draw arguments of all mesh entities in persistent GPU buffers,
+/// and culls them against the frustum and the occluders in a compute shader, which writes the instance
+/// counts of the indirect draw commands.
+/// </summary>
+/// <remarks>
+/// Only changed instances are uploaded each frame. Levels of detail are selected on the CPU,
+/// a change moves the instance to another draw.
+/// Occlusion is tested against the depth pyramid of the CPU occlusion culler if it is linked,
+/// otherwise only the frustum is tested.
+/// </remarks>
+class GpuCull :
+	virtual public GraphicsNode,
+	// Inputs: entities, camera, occlusion culler (optional)
+	virtual public exc::InputPortConfig<const EntityCollection<MeshEntity>*, const Camera*, const OcclusionCuller*>,
+	virtual public exc::OutputPortConfig<const GpuDrawList*>
+{
+public:
+	static constexpr unsigned MAX_LEVELS = 16; // Of the depth pyramid.
+private:
+	struct CullConstants {
+		mathfu::VectorPacked<float, 4> viewProjection[4];
+		uint32_t instanceCount;
+		uint32_t levelCount; // Zero if there's no depth pyramid.
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelOffsets[MAX_LEVELS]; // Packed into uint4s in the shader.
+		uint32_t levelWidths[MAX_LEVELS];
+	};
+public:
+	GpuCull(gxapi::IGraphicsApi* graphicsApi);
+
+	void Update() override {}
+	void Notify(exc::InputPortBase* sender) override {}
+	void InitGraphics(const GraphicsContext& context) override;
+
+	Task GetTask() override;
+
+	/// <summary> Creates the signature of <see cref="GpuCommand"/>s for a binder whose vertex shader reads
+	///		firstVisible from a 4 byte root constant at the given parameter. </summary>
+	static std::unique_ptr<gxapi::ICommandSignature> CreateCommandSignature(const GraphicsContext& context, const Binder& binder, BindParameter firstVisibleParam);
+
+	/// <summary> Instances and commands of the last frame. </summary>
+	const GpuScene& GetScene() const { return m_scene; }
+
+private:
+	void UpdateScene(const EntityCollection<MeshEntity>& entities, const Camera* camera);
+	/// <summary> Makes sure the buffer holds at least size bytes, returns true if it was created anew. </summary>
+	bool ReserveBuffer(LinearBuffer& buffer, size_t size, bool unorderedAccess, uint64_t frameNumber);
+	void CreateViews();
+	void Upload(GraphicsCommandList& commandList, LinearBuffer& destination, size_t offset, const void* data, size_t size);
+	void Cull(const Camera* camera, const OcclusionCuller* culler, uint64_t frameNumber, VolatileViewHeap& volatileHeap, GraphicsCommandList& commandList);
+	void ReleaseRetiredBuffers(uint64_t frameNumber);
+
+protected:
+	GraphicsContext m_graphicsContext;
+	Binder m_binder;
+	BindParameter m_constantsBindParam;
+	BindParameter m_instancesBindParam;
+	BindParameter m_drawsBindParam;
+	BindParameter m_pyramidBindParam;
+	BindParameter m_commandsBindParam;
+	BindParameter m_visibleBindParam;
+	std::shared_ptr<gxapi::IPipelineState> m_CSO;
+
+	GpuScene m_scene;
+	GpuDrawList m_drawList;
+	unsigned m_viewportHeight;
+
+private:
+	LinearBuffer m_instanceBuffer;
+	LinearBuffer m_drawBuffer;
+	LinearBuffer m_commandTemplateBuffer; // Commands with zero instances, copied to the commands before culling.
+	LinearBuffer m_commandBuffer;
+	LinearBuffer m_visibleBuffer;
+	LinearBuffer m_pyramidBuffer;
+	BufferView m_drawSrv;
+	BufferView m_pyramidSrv;
+	RWBufferView m_commandUav;
+	RWBufferView m_visibleUav;
+	std::vector<float> m_pyramid;
+
+	// Replaced buffers might still be read by frames in flight, they are kept until those finish.
+	std::deque<std::pair<uint64_t, LinearBuffer>> m_retiredBuffers; // {frame of retirement, buffer}
+};
+
+
+} // namespace inl::gxeng::nodes
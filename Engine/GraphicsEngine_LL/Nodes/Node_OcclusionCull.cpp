@@ -0,0 +1,92 @@
+#include "Node_OcclusionCull.hpp"
+
+#include "../MeshEntity.hpp"
+#include "../Mesh.hpp"
+#include "../LodSelector.hpp"
+
+#include <algorithm>
+
+namespace inl::gxeng::nodes {
+
+
+OcclusionCull::OcclusionCull() :
+	m_culler(256, 128),
+	m_viewportHeight(1),
+	m_maxOccluders(16),
+	m_minimumOccluderSize(64.0f),
+	m_cullEntities(true)
+{
+	this->GetInput<0>().Set({});
+}
+
+
+void OcclusionCull::InitGraphics(const GraphicsContext& context) {
+	// Occluder sizes are measured on the real screen, the culler's buffer is much smaller.
+	m_viewportHeight = context.GetSwapChainDesc().height;
+}
+
+
+Task OcclusionCull::GetTask() {
+	return Task({ [this](const ExecutionContext& context) {
+		const EntityCollection<MeshEntity>* entities = this->GetInput<0>().Get();
+		this->GetInput<0>().Clear();
+
+		const Camera* camera = this->GetInput<1>().Get();
+		this->GetInput<1>().Clear();
+
+		if (entities && camera) {
+			Cull(*entities, camera);
+			this->GetOutput<0>().Set(m_cullEntities ? &m_visibleEntities : entities);
+			this->GetOutput<1>().Set(&m_culler);
+		}
+		else {
+			this->GetOutput<0>().Set(entities);
+			this->GetOutput<1>().Set(nullptr);
+		}
+
+		return ExecutionResult{};
+	} });
+}
+
+
+void OcclusionCull::Cull(const EntityCollection<MeshEntity>& entities, const Camera* camera) {
+	m_culler.Begin(camera->GetPerspectiveMatrixRH() * camera->GetViewMatrixRH());
+
+	// The largest occluders on the screen are likely to hide the most. Entities not drawn yet must not hide others.
+	LodSelector sizes(camera, m_viewportHeight);
+	m_occluders.clear();
+	for (const MeshEntity* entity : entities) {
+		const Mesh* mesh = entity->GetMesh();
+		if (mesh->GetOccluder() == nullptr || mesh->HasPendingUploads()) {
+			continue;
+		}
+		float size = sizes.GetProjectedSize(*entity);
+		if (size >= m_minimumOccluderSize) {
+			m_occluders.push_back({ size, entity });
+		}
+	}
+
+	size_t occluderCount = std::min(m_occluders.size(), m_maxOccluders);
+	std::partial_sort(m_occluders.begin(), m_occluders.begin() + occluderCount, m_occluders.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.first > rhs.first;
+	});
+	for (size_t i = 0; i < occluderCount; ++i) {
+		const MeshEntity* entity = m_occluders[i].second;
+		m_culler.AddOccluder(*entity->GetMesh()->GetOccluder(), entity->GetTransform());
+	}
+	m_culler.RenderOccluders();
+
+	m_visibleEntities.Clear();
+	if (!m_cullEntities) {
+		return;
+	}
+	for (MeshEntity* entity : entities) {
+		const Mesh* mesh = entity->GetMesh();
+		if (m_culler.IsVisible(mesh->GetBoundingBoxMin(), mesh->GetBoundingBoxMax(), entity->GetTransform())) {
+			m_visibleEntities.Add(entity);
+		}
+	}
+}
+
+
+} // namespace inl::gxeng::nodes
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../GraphicsNode.hpp"
+
+#include "../Scene.hpp"
+#include "../Camera.hpp"
+#include "../OcclusionCuller.hpp"
+#include "../GraphicsContext.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace inl::gxeng::nodes {
+
+
+/// <summary>
+/// Passes on the entities that may be visible from the camera.
+/// The largest occluders on the screen are rendered on the CPU, and entities whose bounding box
+/// is outside the frustum or behind them are left out.
+/// The culler is passed on as well, so that the GPU can test against the same depth pyramid.
+/// </summary>
+class OcclusionCull :
+	virtual public GraphicsNode,
+	virtual public exc::InputPortConfig<const EntityCollection<MeshEntity>*, const Camera*>,
+	virtual public exc::OutputPortConfig<const EntityCollection<MeshEntity>*, const OcclusionCuller*>
+{
+public:
+	OcclusionCull();
+
+	void Update() override {}
+	void Notify(exc::InputPortBase* sender) override {}
+	void InitGraphics(const GraphicsContext& context) override;
+
+	Task GetTask() override;
+
+	/// <summary> At most this many occluders are rendered each frame. </summary>
+	void SetMaxOccluders(size_t count) { m_maxOccluders = count; }
+	/// <summary> Occluders smaller than this on the screen (bounding sphere diameter, in pixels) are not rendered. </summary>
+	void SetMinimumOccluderSize(float pixels) { m_minimumOccluderSize = pixels; }
+	/// <summary> If false, only the occluders are rendered, and all entities are passed on. Used when culling is done on the GPU. </summary>
+	void SetCullEntities(bool enabled) { m_cullEntities = enabled; }
+
+	/// <summary> Counts of the last frame. </summary>
+	const OcclusionCuller::Statistics& GetStatistics() const { return m_culler.GetStatistics(); }
+
+protected:
+	OcclusionCuller m_culler;
+	EntityCollection<MeshEntity> m_visibleEntities;
+	std::vector<std::pair<float, const MeshEntity*>> m_occluders;
+	unsigned m_viewportHeight;
+	size_t m_maxOccluders;
+	float m_minimumOccluderSize;
+	bool m_cullEntities;
+
+private:
+	void Cull(const EntityCollection<MeshEntity>& entities, const Camera* camera);
+};
+
+
+} // namespace inl::gxeng::nodes
@@ -6,7 +6,12 @@ namespace inl::gxeng::nodes {
 
 RenderToBackBuffer::RenderToBackBuffer(gxapi::IGraphicsApi * graphicsApi):
 	m_binder(graphicsApi, {})
-{
+{}
+
+
+void RenderToBackBuffer::InitGraphics(const GraphicsContext& context) {
+	m_graphicsContext = context;
+
 	BindParameterDesc texBindParamDesc;
 	m_texBindParam = BindParameter(eBindParameterType::TEXTURE, 0);
 	texBindParamDesc.parameter = m_texBindParam;
@@ -32,12 +37,7 @@ RenderToBackBuffer::RenderToBackBuffer(gxapi::IGraphicsApi * graphicsApi):
 	samplerDesc.registerSpace = 0;
 	samplerDesc.shaderVisibility = gxapi::eShaderVisiblity::PIXEL;
 
-	m_binder = Binder{ graphicsApi,{ texBindParamDesc, sampBindParamDesc },{ samplerDesc } };
-}
-
-
-void RenderToBackBuffer::InitGraphics(const GraphicsContext& context) {
-	m_graphicsContext = context;
+	m_binder = context.CreateBinder({ texBindParamDesc, sampBindParamDesc }, { samplerDesc });
 
 	std::vector<float> vertices = {
 		-1, -1, 0,
@@ -73,7 +73,7 @@ void RenderToBackBuffer::InitGraphics(const GraphicsContext& context) {
 	psoDesc.numRenderTargets = 1;
 	psoDesc.renderTargetFormats[0] = gxapi::eFormat::R8G8B8A8_UNORM;
 
-	m_PSO.reset(m_graphicsContext.CreatePSO(psoDesc));
+	m_PSO = m_graphicsContext.CreatePSO(psoDesc);
 }
 
 
@@ -54,7 +54,7 @@ protected:
 protected:
 	Binder m_binder;
 	BindParameter m_texBindParam;
-	std::unique_ptr<gxapi::IPipelineState> m_PSO;
+	std::shared_ptr<gxapi::IPipelineState> m_PSO;
 
 private:
 	void Render(
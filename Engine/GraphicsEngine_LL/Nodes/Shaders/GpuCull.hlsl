@@ -0,0 +1,154 @@
+/*
+ * GPU culling shader
+ * Input: instances, draws, depth pyramid of the CPU occlusion culler
+ * Output: instance counts of the indirect draw commands, visible instance list
+ * Must test visibility exactly like OcclusionCuller::IsVisible.
+ */
+
+// Must be the same as GpuCull::MAX_LEVELS.
+#define MAX_LEVELS 16
+
+#define LOCAL_SIZE 64
+
+// Same as GpuScene::INVALID_DRAW.
+#define INVALID_DRAW 0xFFFFFFFF
+
+struct CullConstants
+{
+	float4x4 viewProjection;
+	uint instanceCount;
+	uint levelCount; // zero if there's no depth pyramid
+	uint width;
+	uint height;
+	uint4 levelOffsets[MAX_LEVELS / 4];
+	uint4 levelWidths[MAX_LEVELS / 4];
+};
+
+struct Instance
+{
+	float4x4 world; // column major, as packed by mathfu
+	float3 boxMin;
+	uint drawIndex;
+	float3 boxMax;
+	uint padding;
+};
+
+struct Draw
+{
+	uint firstVisible;
+	uint instanceCountOffset;
+};
+
+ConstantBuffer<CullConstants> constants : register(b0);
+StructuredBuffer<Instance> instances : register(t0);
+StructuredBuffer<Draw> draws : register(t1);
+Buffer<float> pyramid : register(t2);
+RWByteAddressBuffer commands : register(u0);
+RWBuffer<uint> visibleInstances : register(u1);
+
+
+float GetPyramidDepth(uint x, uint y, uint level)
+{
+	uint offset = constants.levelOffsets[level / 4][level % 4];
+	uint width = constants.levelWidths[level / 4][level % 4];
+	return pyramid[offset + y * width + x];
+}
+
+
+bool IsVisible(Instance instance)
+{
+	float4x4 worldViewProjection = mul(constants.viewProjection, instance.world);
+	float4 corners[8];
+	for (uint i = 0; i < 8; ++i)
+	{
+		float4 corner = float4(i & 1 ? instance.boxMax.x : instance.boxMin.x,
+							   i & 2 ? instance.boxMax.y : instance.boxMin.y,
+							   i & 4 ? instance.boxMax.z : instance.boxMin.z,
+							   1.0f);
+		corners[i] = mul(worldViewProjection, corner);
+	}
+
+	// Outside if all corners are beyond the same clip plane.
+	bool3 outsideMin = bool3(true, true, true);
+	bool3 outsideMax = bool3(true, true, true);
+	for (uint j = 0; j < 8; ++j)
+	{
+		float4 v = corners[j];
+		outsideMin = outsideMin && v.xyz < float3(-v.ww, 0.0f);
+		outsideMax = outsideMax && v.xyz > v.www;
+	}
+	if (any(outsideMin) || any(outsideMax))
+	{
+		return false;
+	}
+
+	if (constants.levelCount == 0)
+	{
+		return true;
+	}
+
+	// Boxes crossing the near plane can't be projected, they are taken as visible.
+	float2 minXY = float2(3.402823466e+38f, 3.402823466e+38f);
+	float2 maxXY = -minXY;
+	float minZ = 1.0f;
+	for (uint k = 0; k < 8; ++k)
+	{
+		float4 corner = corners[k];
+		if (corner.z < 0.0f || corner.w <= 0.0f)
+		{
+			return true;
+		}
+		float2 xy = float2((corner.x / corner.w * 0.5f + 0.5f) * constants.width,
+						   (0.5f - corner.y / corner.w * 0.5f) * constants.height);
+		minXY = min(minXY, xy);
+		maxXY = max(maxXY, xy);
+		minZ = min(minZ, corner.z / corner.w);
+	}
+
+	float2 size = float2(constants.width - 1, constants.height - 1);
+	uint2 p0 = uint2(clamp(minXY, 0.0f, size));
+	uint2 p1 = uint2(clamp(maxXY, 0.0f, size));
+
+	// The coarsest level needed is where the box covers at most 2x2 cells.
+	uint level = 0;
+	while (level + 1 < constants.levelCount && ((p1.x >> level) - (p0.x >> level) > 1 || (p1.y >> level) - (p0.y >> level) > 1))
+	{
+		++level;
+	}
+
+	for (uint y = p0.y >> level; y <= p1.y >> level; ++y)
+	{
+		for (uint x = p0.x >> level; x <= p1.x >> level; ++x)
+		{
+			if (minZ <= GetPyramidDepth(x, y, level))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+[numthreads(LOCAL_SIZE, 1, 1)]
+void CSMain(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+	uint slot = dispatchThreadId.x;
+	if (slot >= constants.instanceCount)
+	{
+		return;
+	}
+
+	Instance instance = instances[slot];
+	if (instance.drawIndex == INVALID_DRAW || !IsVisible(instance))
+	{
+		return;
+	}
+
+	// The instance count of the draw's command is the next free place in the draw's region.
+	Draw draw = draws[instance.drawIndex];
+	uint index;
+	commands.InterlockedAdd(draw.instanceCountOffset, 1, index);
+	visibleInstances[draw.firstVisible + index] = slot;
+}
@@ -1,23 +1,67 @@
 
+// Must be the same as InstanceBatcher::MAX_INSTANCES.
+#define MAX_INSTANCES 1024
+
 struct Transform
 {
-	float4x4 MVP;
+	float4x4 viewProjection;
+};
+
+struct Instances
+{
+	float4x4 world[MAX_INSTANCES];
 };
 
 
 ConstantBuffer<Transform> transform : register(b0);
 
+#ifdef INDIRECT
+// Drawn by GPU culled indirect commands, each sets its first visible instance.
+// Same layout as GpuInstance.
+struct Instance
+{
+	float4x4 world;
+	float3 boxMin;
+	uint drawIndex;
+	float3 boxMax;
+	uint padding;
+};
+
+struct Command
+{
+	uint firstVisible;
+};
+
+ConstantBuffer<Command> command : register(b1);
+StructuredBuffer<Instance> instanceBuffer : register(t100);
+Buffer<uint> visibleInstances : register(t101);
+
+float4x4 GetWorld(uint instanceId)
+{
+	return instanceBuffer[visibleInstances[command.firstVisible + instanceId]].world;
+}
+#else
+ConstantBuffer<Instances> instances : register(b1);
+
+float4x4 GetWorld(uint instanceId)
+{
+	return instances.world[instanceId];
+}
+#endif
+
 struct PS_Input
 {
 	float4 position : SV_POSITION;
 };
 
 
-PS_Input VSMain(float4 position : POSITION)
+PS_Input VSMain(float4 position : POSITION, uint instanceId : SV_InstanceID)
 {
 	PS_Input result;
 
-	result.position = mul(transform.MVP, position);
+	// The forward pass tests depth for equality, it must compute positions exactly like this.
+	precise float4 worldPosition = mul(GetWorld(instanceId), position);
+	result.position = mul(transform.viewProjection, worldPosition);
 
 	return result;
 }
@@ -1,7 +1,8 @@
 
 struct Transform
 {
-	float4x4 MVP;
+	float4x4 viewProjection;
+	float4x4 world;
 	float4x4 worldInvTr;
 };
 
@@ -31,7 +32,9 @@ PS_Input VSMain(float4 position : POSITION, float4 normal : NORMAL, float4 texCo
 
 	float3 worldNormal = normalize(mul(transform.worldInvTr, float4(normal.xyz, 0.0)).xyz);
 
-	result.position = mul(transform.MVP, position);
+	// The depth test is EQUAL, positions must be computed exactly as in the depth prepass.
+	precise float4 worldPosition = mul(transform.world, position);
+	result.position = mul(transform.viewProjection, worldPosition);
 	result.normal = worldNormal;
 	result.texCoord = texCoord.xy;
 
@@ -0,0 +1,336 @@
+#include "OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+
+namespace inl::gxeng {
+
+
+OcclusionCuller::OcclusionCuller(unsigned width, unsigned height)
+	: m_width(width), m_height(height)
+{
+	if (width == 0 || height == 0) {
+		throw std::invalid_argument("Depth buffer size must be positive.");
+	}
+
+	m_tileCountX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+	m_tileCountY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+	m_bins.resize(m_tileCountX * m_tileCountY);
+
+	// Each level halves the previous, rounding up, until a single cell is left.
+	unsigned levelWidth = width;
+	unsigned levelHeight = height;
+	while (true) {
+		m_levels.push_back(Level{ levelWidth, levelHeight, std::vector<float>(levelWidth * levelHeight, 1.0f) });
+		if (levelWidth == 1 && levelHeight == 1) {
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	m_viewProjection = mathfu::Matrix4x4f::Identity();
+}
+
+
+void OcclusionCuller::Begin(const mathfu::Matrix4x4f& viewProjection) {
+	m_viewProjection = viewProjection;
+	m_triangles.clear();
+	for (auto& bin : m_bins) {
+		bin.clear();
+	}
+	for (auto& level : m_levels) {
+		std::fill(level.depth.begin(), level.depth.end(), 1.0f);
+	}
+	m_statistics = Statistics{};
+}
+
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const mathfu::Matrix4x4f& world) {
+	if (std::any_of(mesh.indices.begin(), mesh.indices.end(), [&mesh](unsigned index) { return index >= mesh.positions.size(); })) {
+		throw std::invalid_argument("Occluder index out of range.");
+	}
+
+	mathfu::Matrix4x4f worldViewProjection = m_viewProjection * world;
+	std::vector<mathfu::Vector4f> clipPositions;
+	clipPositions.reserve(mesh.positions.size());
+	for (const auto& position : mesh.positions) {
+		clipPositions.push_back(worldViewProjection * mathfu::Vector4f(position, 1.0f));
+	}
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		ClipAndAddTriangle(clipPositions[mesh.indices[i]], clipPositions[mesh.indices[i + 1]], clipPositions[mesh.indices[i + 2]]);
+	}
+
+	++m_statistics.occluderCount;
+}
+
+
+void OcclusionCuller::RenderOccluders() {
+	auto RenderTileRows = [this](unsigned firstRow, unsigned lastRow) {
+		for (unsigned tileY = firstRow; tileY < lastRow; ++tileY) {
+			for (unsigned tileX = 0; tileX < m_tileCountX; ++tileX) {
+				RasterizeTile(tileX, tileY);
+			}
+		}
+	};
+
+	size_t threadCount = std::min({ size_t(std::max(1u, std::thread::hardware_concurrency())),
+									m_triangles.size() / MIN_TRIANGLES_PER_THREAD,
+									size_t(m_tileCountY) });
+	if (threadCount <= 1) {
+		RenderTileRows(0, m_tileCountY);
+	}
+	else {
+		// Tiles don't share pixels, so rows of them need no synchronization. The first band is rendered on this thread.
+		unsigned rowsPerBand = unsigned((m_tileCountY + threadCount - 1) / threadCount);
+		std::vector<std::future<void>> bands;
+		for (unsigned firstRow = rowsPerBand; firstRow < m_tileCountY; firstRow += rowsPerBand) {
+			bands.push_back(std::async(std::launch::async, RenderTileRows, firstRow, std::min(m_tileCountY, firstRow + rowsPerBand)));
+		}
+		RenderTileRows(0, rowsPerBand);
+		for (auto& band : bands) {
+			band.get();
+		}
+	}
+
+	BuildPyramid();
+}
+
+
+bool OcclusionCuller::IsVisible(const mathfu::Vector3f& boxMin, const mathfu::Vector3f& boxMax, const mathfu::Matrix4x4f& world) {
+	++m_statistics.testedCount;
+
+	mathfu::Matrix4x4f worldViewProjection = m_viewProjection * world;
+	mathfu::Vector4f corners[8];
+	for (int i = 0; i < 8; ++i) {
+		mathfu::Vector4f corner(i & 1 ? boxMax[0] : boxMin[0],
+								i & 2 ? boxMax[1] : boxMin[1],
+								i & 4 ? boxMax[2] : boxMin[2],
+								1.0f);
+		corners[i] = worldViewProjection * corner;
+	}
+
+	// Outside if all corners are beyond the same clip plane.
+	auto AllOutside = [&corners](auto isOutside) {
+		return std::all_of(std::begin(corners), std::end(corners), isOutside);
+	};
+	if (AllOutside([](const mathfu::Vector4f& v) { return v[0] < -v[3]; })
+		|| AllOutside([](const mathfu::Vector4f& v) { return v[0] > v[3]; })
+		|| AllOutside([](const mathfu::Vector4f& v) { return v[1] < -v[3]; })
+		|| AllOutside([](const mathfu::Vector4f& v) { return v[1] > v[3]; })
+		|| AllOutside([](const mathfu::Vector4f& v) { return v[2] < 0.0f; })
+		|| AllOutside([](const mathfu::Vector4f& v) { return v[2] > v[3]; }))
+	{
+		++m_statistics.outsideCount;
+		return false;
+	}
+
+	// Boxes crossing the near plane can't be projected, they are taken as visible.
+	float minX = std::numeric_limits<float>::max(), maxX = -std::numeric_limits<float>::max();
+	float minY = std::numeric_limits<float>::max(), maxY = -std::numeric_limits<float>::max();
+	float minZ = 1.0f;
+	for (const auto& corner : corners) {
+		if (corner[2] < 0.0f || corner[3] <= 0.0f) {
+			return true;
+		}
+		float x = (corner[0] / corner[3] * 0.5f + 0.5f) * m_width;
+		float y = (0.5f - corner[1] / corner[3] * 0.5f) * m_height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, corner[2] / corner[3]);
+	}
+
+	unsigned x0 = unsigned(std::clamp(minX, 0.0f, float(m_width - 1)));
+	unsigned x1 = unsigned(std::clamp(maxX, 0.0f, float(m_width - 1)));
+	unsigned y0 = unsigned(std::clamp(minY, 0.0f, float(m_height - 1)));
+	unsigned y1 = unsigned(std::clamp(maxY, 0.0f, float(m_height - 1)));
+
+	// The coarsest level needed is where the box covers at most 2x2 cells.
+	size_t level = 0;
+	while (level + 1 < m_levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+		++level;
+	}
+
+	const Level& cells = m_levels[level];
+	for (unsigned y = y0 >> level; y <= y1 >> level; ++y) {
+		for (unsigned x = x0 >> level; x <= x1 >> level; ++x) {
+			if (minZ <= cells.depth[y * cells.width + x]) {
+				return true;
+			}
+		}
+	}
+
+	++m_statistics.occludedCount;
+	return false;
+}
+
+
+float OcclusionCuller::GetDepth(unsigned x, unsigned y, size_t level) const {
+	const Level& cells = m_levels.at(level);
+	if (x >= cells.width || y >= cells.height) {
+		throw std::out_of_range("Cell is outside the level.");
+	}
+	return cells.depth[y * cells.width + x];
+}
+
+
+void OcclusionCuller::ClipAndAddTriangle(const mathfu::Vector4f& v0, const mathfu::Vector4f& v1, const mathfu::Vector4f& v2) {
+	// Only the near plane must be clipped, the rest of the triangle is limited to the screen when binned.
+	const mathfu::Vector4f* input[3] = { &v0, &v1, &v2 };
+	mathfu::Vector4f polygon[4];
+	int vertexCount = 0;
+	for (int i = 0; i < 3; ++i) {
+		const mathfu::Vector4f& current = *input[i];
+		const mathfu::Vector4f& next = *input[(i + 1) % 3];
+		bool currentInside = current[2] >= 0.0f;
+		bool nextInside = next[2] >= 0.0f;
+		if (currentInside) {
+			polygon[vertexCount++] = current;
+		}
+		if (currentInside != nextInside) {
+			float t = current[2] / (current[2] - next[2]);
+			polygon[vertexCount++] = current + (next - current) * t;
+		}
+	}
+
+	for (int i = 1; i + 1 < vertexCount; ++i) {
+		AddTriangle(polygon[0], polygon[i], polygon[i + 1]);
+	}
+}
+
+
+void OcclusionCuller::AddTriangle(const mathfu::Vector4f& v0, const mathfu::Vector4f& v1, const mathfu::Vector4f& v2) {
+	float x[3], y[3], z[3];
+	const mathfu::Vector4f* vertices[3] = { &v0, &v1, &v2 };
+	for (int i = 0; i < 3; ++i) {
+		const mathfu::Vector4f& v = *vertices[i];
+		if (v[3] <= 0.0f) {
+			return; // Degenerate, on the camera's plane.
+		}
+		x[i] = (v[0] / v[3] * 0.5f + 0.5f) * m_width;
+		y[i] = (0.5f - v[1] / v[3] * 0.5f) * m_height;
+		z[i] = v[2] / v[3];
+	}
+
+	// Fully beyond the far plane, or not covering the screen.
+	if (z[0] > 1.0f && z[1] > 1.0f && z[2] > 1.0f) {
+		return;
+	}
+	float minX = std::clamp(std::min({ x[0], x[1], x[2] }), -1.0f, float(m_width) + 1.0f);
+	float maxX = std::clamp(std::max({ x[0], x[1], x[2] }), -1.0f, float(m_width) + 1.0f);
+	float minY = std::clamp(std::min({ y[0], y[1], y[2] }), -1.0f, float(m_height) + 1.0f);
+	float maxY = std::clamp(std::max({ y[0], y[1], y[2] }), -1.0f, float(m_height) + 1.0f);
+
+	Triangle triangle;
+	triangle.minX = std::max(0, int(std::ceil(minX - 0.5f)));
+	triangle.maxX = std::min(int(m_width), int(std::floor(maxX - 0.5f)) + 1);
+	triangle.minY = std::max(0, int(std::ceil(minY - 0.5f)));
+	triangle.maxY = std::min(int(m_height), int(std::floor(maxY - 0.5f)) + 1);
+	if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY) {
+		return;
+	}
+
+	// Edge i goes from vertex i+1 to i+2, so its function is zero there and twice the area at vertex i.
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3;
+		int k = (i + 2) % 3;
+		triangle.a[i] = y[j] - y[k];
+		triangle.b[i] = x[k] - x[j];
+		triangle.c[i] = x[j] * y[k] - x[k] * y[j];
+	}
+	float area = triangle.a[0] * x[0] + triangle.b[0] * y[0] + triangle.c[0];
+	if (std::abs(area) < 1e-6f) {
+		return;
+	}
+	// Both facings are drawn, the nearest one wins anyway.
+	float sign = area < 0.0f ? -1.0f : 1.0f;
+	for (int i = 0; i < 3; ++i) {
+		triangle.a[i] *= sign;
+		triangle.b[i] *= sign;
+		triangle.c[i] *= sign;
+	}
+	area *= sign;
+
+	// Depth divided by w is linear on the screen, the edge functions are its barycentric weights.
+	triangle.za = (triangle.a[0] * z[0] + triangle.a[1] * z[1] + triangle.a[2] * z[2]) / area;
+	triangle.zb = (triangle.b[0] * z[0] + triangle.b[1] * z[1] + triangle.b[2] * z[2]) / area;
+	triangle.zc = z[0] - triangle.za * x[0] - triangle.zb * y[0]; // Summing the c terms would lose precision for small triangles.
+
+	uint32_t index = uint32_t(m_triangles.size());
+	m_triangles.push_back(triangle);
+	++m_statistics.triangleCount;
+
+	for (unsigned tileY = triangle.minY / TILE_HEIGHT; tileY <= unsigned(triangle.maxY - 1) / TILE_HEIGHT; ++tileY) {
+		for (unsigned tileX = triangle.minX / TILE_WIDTH; tileX <= unsigned(triangle.maxX - 1) / TILE_WIDTH; ++tileX) {
+			m_bins[tileY * m_tileCountX + tileX].push_back(index);
+		}
+	}
+}
+
+
+void OcclusionCuller::RasterizeTile(unsigned tileX, unsigned tileY) {
+	int tileMinX = int(tileX * TILE_WIDTH);
+	int tileMinY = int(tileY * TILE_HEIGHT);
+	int tileMaxX = std::min(int(m_width), tileMinX + int(TILE_WIDTH));
+	int tileMaxY = std::min(int(m_height), tileMinY + int(TILE_HEIGHT));
+	float* depth = m_levels[0].depth.data();
+
+	for (uint32_t index : m_bins[tileY * m_tileCountX + tileX]) {
+		const Triangle& triangle = m_triangles[index];
+		int minX = std::max(tileMinX, triangle.minX);
+		int maxX = std::min(tileMaxX, triangle.maxX);
+		int minY = std::max(tileMinY, triangle.minY);
+		int maxY = std::min(tileMaxY, triangle.maxY);
+		int count = maxX - minX;
+
+		for (int y = minY; y < maxY; ++y) {
+			float px = float(minX) + 0.5f;
+			float py = float(y) + 0.5f;
+			float e0 = triangle.a[0] * px + triangle.b[0] * py + triangle.c[0];
+			float e1 = triangle.a[1] * px + triangle.b[1] * py + triangle.c[1];
+			float e2 = triangle.a[2] * px + triangle.b[2] * py + triangle.c[2];
+			float z = triangle.za * px + triangle.zb * py + triangle.zc;
+			float* row = depth + y * m_width + minX;
+
+			// Branchless and on locals that can't alias the row, so that the compiler evaluates several pixels at once.
+			const float a0 = triangle.a[0], a1 = triangle.a[1], a2 = triangle.a[2], za = triangle.za;
+			for (int i = 0; i < count; ++i) {
+				float fi = float(i);
+				bool inside = (e0 + a0 * fi >= 0.0f) & (e1 + a1 * fi >= 0.0f) & (e2 + a2 * fi >= 0.0f);
+				float current = row[i];
+				float pixelZ = z + za * fi;
+				row[i] = inside & (pixelZ < current) ? pixelZ : current;
+			}
+		}
+	}
+}
+
+
+void OcclusionCuller::BuildPyramid() {
+	for (size_t index = 1; index < m_levels.size(); ++index) {
+		const Level& source = m_levels[index - 1];
+		Level& target = m_levels[index];
+		for (unsigned y = 0; y < target.height; ++y) {
+			unsigned y0 = 2 * y;
+			unsigned y1 = std::min(y0 + 1, source.height - 1);
+			for (unsigned x = 0; x < target.width; ++x) {
+				unsigned x0 = 2 * x;
+				unsigned x1 = std::min(x0 + 1, source.width - 1);
+				target.depth[y * target.width + x] = std::max({
+					source.depth[y0 * source.width + x0], source.depth[y0 * source.width + x1],
+					source.depth[y1 * source.width + x0], source.depth[y1 * source.width + x1] });
+			}
+		}
+	}
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <mathfu/mathfu_exc.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace inl::gxeng {
+
+
+/// <summary>
+/// Simplified geometry that stands in for a mesh when occlusion is rendered on the CPU.
+/// It must not reach outside the mesh it stands for, or objects that are visible past the mesh get culled.
+/// </summary>
+struct OccluderMesh {
+	std::vector<mathfu::Vector3f> positions; // Model space.
+	std::vector<unsigned> indices; // Triangle list.
+};
+
+
+/// <summary>
+/// Rejects objects hidden behind occluders, without the GPU.
+/// Occluders are rasterized into a small depth buffer, and a pyramid of the farthest depth
+/// of each 2x2 block is built over it. Bounding boxes are tested against the pyramid level
+/// where they cover at most 2x2 cells.
+/// </summary>
+/// <remarks>
+/// Depth is in normalized device coordinates, 0 at the near and 1 at the far plane.
+/// The depth buffer is split into tiles, and triangles are binned to the tiles they overlap,
+/// so that rows of tiles can be rasterized on separate threads without sharing memory.
+/// The pixel loops are written to be vectorized by the compiler.
+/// Usage per frame: <see cref="Begin"/>, <see cref="AddOccluder"/> for each occluder,
+/// <see cref="RenderOccluders"/>, then <see cref="IsVisible"/> for each object.
+/// </remarks>
+class OcclusionCuller {
+public:
+	struct Statistics {
+		size_t occluderCount = 0;
+		size_t triangleCount = 0; // Occluder triangles that reached the depth buffer, after near plane clipping.
+		size_t testedCount = 0;
+		size_t outsideCount = 0; // Outside the view frustum.
+		size_t occludedCount = 0; // In the frustum, but behind occluders.
+	};
+
+public:
+	/// <summary> Creates a culler with a depth buffer of the given resolution. </summary>
+	/// <exception cref="std::invalid_argument"> If either size is zero. </exception>
+	OcclusionCuller(unsigned width = 256, unsigned height = 128);
+
+	/// <summary> Clears the depth buffer, the occluders and the statistics. </summary>
+	void Begin(const mathfu::Matrix4x4f& viewProjection);
+
+	/// <summary> Transforms the occluder's triangles to the screen and bins them to tiles. </summary>
+	/// <exception cref="std::invalid_argument"> If an index is out of range. </exception>
+	void AddOccluder(const OccluderMesh& mesh, const mathfu::Matrix4x4f& world);
+
+	/// <summary> Rasterizes the occluders added since <see cref="Begin"/>, and builds the depth pyramid. </summary>
+	void RenderOccluders();
+
+	/// <summary> False if the model space box is outside the frustum or hidden by the occluders. </summary>
+	bool IsVisible(const mathfu::Vector3f& boxMin, const mathfu::Vector3f& boxMax, const mathfu::Matrix4x4f& world);
+
+	unsigned GetWidth() const { return m_width; }
+	unsigned GetHeight() const { return m_height; }
+	/// <summary> Number of levels in the depth pyramid, level 0 is the depth buffer. </summary>
+	size_t GetLevelCount() const { return m_levels.size(); }
+	/// <summary> Farthest depth of occluders within the cell of the given pyramid level. </summary>
+	float GetDepth(unsigned x, unsigned y, size_t level = 0) const;
+	/// <summary> Size of a pyramid level, in cells. </summary>
+	unsigned GetLevelWidth(size_t level) const { return m_levels.at(level).width; }
+	unsigned GetLevelHeight(size_t level) const { return m_levels.at(level).height; }
+	/// <summary> Depths of all cells of a pyramid level, row major. </summary>
+	const std::vector<float>& GetLevelDepths(size_t level) const { return m_levels.at(level).depth; }
+	/// <summary> The transform given to <see cref="Begin"/>. </summary>
+	const mathfu::Matrix4x4f& GetViewProjection() const { return m_viewProjection; }
+
+	const Statistics& GetStatistics() const { return m_statistics; }
+private:
+	struct Triangle {
+		// Edge functions a*x + b*y + c, positive inside.
+		float a[3];
+		float b[3];
+		float c[3];
+		// Depth plane over the screen.
+		float za, zb, zc;
+		// Pixels whose center may be inside, end exclusive.
+		int minX, minY, maxX, maxY;
+	};
+	struct Level {
+		unsigned width;
+		unsigned height;
+		std::vector<float> depth;
+	};
+
+	void ClipAndAddTriangle(const mathfu::Vector4f& v0, const mathfu::Vector4f& v1, const mathfu::Vector4f& v2);
+	void AddTriangle(const mathfu::Vector4f& v0, const mathfu::Vector4f& v1, const mathfu::Vector4f& v2);
+	void RasterizeTile(unsigned tileX, unsigned tileY);
+	void BuildPyramid();
+private:
+	static constexpr unsigned TILE_WIDTH = 32;
+	static constexpr unsigned TILE_HEIGHT = 16;
+	static constexpr size_t MIN_TRIANGLES_PER_THREAD = 256;
+
+	unsigned m_width;
+	unsigned m_height;
+	unsigned m_tileCountX;
+	unsigned m_tileCountY;
+	mathfu::Matrix4x4f m_viewProjection;
+	std::vector<Triangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_bins; // Triangles overlapping each tile, row major.
+	std::vector<Level> m_levels;
+	Statistics m_statistics;
+};
+
+
+} // namespace inl::gxeng
@@ -1,23 +1,35 @@
 #include "PipelineEventDispatcher.hpp"
 #include <BaseLibrary/ThreadName.hpp>
 
+#include <algorithm>
+#include <cassert>
+
 
 namespace inl {
 namespace gxeng {
 
 
 
+PipelineEventDispatcher::State::~State() {
+	DeviceEvent* event = m_deviceEvents.exchange(nullptr);
+	while (event != nullptr) {
+		DeviceEvent* next = event->next;
+		delete event;
+		event = next;
+	}
+}
+
+
+
 PipelineEventDispatcher::PipelineEventDispatcher() {
 	state.reset(new State());
+	state->m_listeners = std::make_shared<const Listeners>();
 	state->m_runDeviceThread = true;
-	state->m_runEventThread = true;
 	m_deviceSyncThread = std::thread(&PipelineEventDispatcher::DeviceSyncThread, state);
-	m_eventThread = std::thread(&PipelineEventDispatcher::DispatchThread, state);
 }
 
 PipelineEventDispatcher::PipelineEventDispatcher(PipelineEventDispatcher&& rhs) {
 	state = std::move(rhs.state);
-	m_eventThread = std::move(rhs.m_eventThread);
 	m_deviceSyncThread = std::move(rhs.m_deviceSyncThread);
 }
 
@@ -25,7 +37,6 @@ PipelineEventDispatcher& PipelineEventDispatcher::operator=(PipelineEventDispatc
 	Shutdown();
 
 	state = std::move(rhs.state);
-	m_eventThread = std::move(rhs.m_eventThread);
 	m_deviceSyncThread = std::move(rhs.m_deviceSyncThread);
 
 	return *this;
@@ -39,156 +50,124 @@ PipelineEventDispatcher::~PipelineEventDispatcher() noexcept {
 void PipelineEventDispatcher::Shutdown() {
 	if (m_deviceSyncThread.joinable()) {
 		state->m_runDeviceThread = false;
+		{
+			std::lock_guard<std::mutex> lkg(state->m_deviceSleepMutex);
+		}
 		state->m_deviceCv.notify_all();
 		m_deviceSyncThread.join();
 	}
-
-	if (m_eventThread.joinable()) {
-		state->m_runEventThread = false;
-		state->m_eventCv.notify_all();
-		m_eventThread.join();
-	}
 }
 
 
 
-std::future<void> PipelineEventDispatcher::DispatchFrameBegin(uint64_t frameId) {
-	EventAction eventAction;
-	eventAction.action = std::bind(&PipelineEventListener::OnFrameBeginHost, std::placeholders::_1, frameId);
-	auto ret = eventAction.signal.get_future();
-	PushEventAction(state.get(), std::move(eventAction));
-	return ret;
+void PipelineEventDispatcher::DispatchFrameBegin(uint64_t frameId) {
+	Notify(state.get(), &PipelineEventListener::OnFrameBeginHost, frameId);
 }
 
-std::future<void> PipelineEventDispatcher::DispatchFrameEnd(uint64_t frameId) {
-	EventAction eventAction;
-	eventAction.action = std::bind(&PipelineEventListener::OnFrameCompleteHost, std::placeholders::_1, frameId);
-	auto ret = eventAction.signal.get_future();
-	PushEventAction(state.get(), std::move(eventAction));
-	return ret;
+void PipelineEventDispatcher::DispatchFrameEnd(uint64_t frameId) {
+	Notify(state.get(), &PipelineEventListener::OnFrameCompleteHost, frameId);
 }
 
 
-std::future<void> PipelineEventDispatcher::DispatchDeviceFrameBegin(SyncPoint deviceEvent, uint64_t frameId) {
-	DeviceEventAction action;
-	action.action = std::bind(&PipelineEventListener::OnFrameBeginDevice, std::placeholders::_1, frameId);
-	action.premise = deviceEvent;
-
-	std::future<void> ret = action.signal.get_future();
-
-	std::unique_lock<std::mutex>  lkg(state->m_deviceEventMutex);
-	state->m_deviceEventActions.push(std::move(action));
-	state->m_deviceCv.notify_all();
-
-	return ret;
+void PipelineEventDispatcher::DispatchDeviceFrameBegin(SyncPoint deviceEvent, uint64_t frameId) {
+	PushDeviceEvent(state.get(), new DeviceEvent{ &PipelineEventListener::OnFrameBeginDevice, frameId, deviceEvent, nullptr });
 }
 
-std::future<void> PipelineEventDispatcher::DispatchDeviceFrameEnd(SyncPoint deviceEvent, uint64_t frameId) {
-	DeviceEventAction action;
-	action.action = std::bind(&PipelineEventListener::OnFrameCompleteDevice, std::placeholders::_1, frameId);
-	action.premise = deviceEvent;
-
-	std::future<void> ret = action.signal.get_future();
-
-	std::unique_lock<std::mutex>  lkg(state->m_deviceEventMutex);
-	state->m_deviceEventActions.push(std::move(action));
-	state->m_deviceCv.notify_all();
-
-	return ret;
+void PipelineEventDispatcher::DispatchDeviceFrameEnd(SyncPoint deviceEvent, uint64_t frameId) {
+	PushDeviceEvent(state.get(), new DeviceEvent{ &PipelineEventListener::OnFrameCompleteDevice, frameId, deviceEvent, nullptr });
 }
 
 
 void PipelineEventDispatcher::operator+=(PipelineEventListener* listener) {
-	std::lock_guard<std::mutex> lkg(state->m_listenerMutex);
-	state->m_listeners.insert(listener);
-}
+	std::lock_guard<std::mutex> lkg(state->m_listenerWriteMutex);
 
+	std::shared_ptr<const Listeners> current = std::atomic_load(&state->m_listeners);
+	if (std::find(current->begin(), current->end(), listener) != current->end()) {
+		return;
+	}
 
-void PipelineEventDispatcher::operator-=(PipelineEventListener* listener) {
-	std::lock_guard<std::mutex> lkg(state->m_listenerMutex);
-	state->m_listeners.erase(listener);
+	auto updated = std::make_shared<Listeners>(*current);
+	updated->push_back(listener);
+	std::atomic_store(&state->m_listeners, std::shared_ptr<const Listeners>(std::move(updated)));
 }
 
 
-void PipelineEventDispatcher::DispatchThread(std::shared_ptr<State> state) {
-	SetCurrentThreadName("Event Dispatcher Thread");
+void PipelineEventDispatcher::operator-=(PipelineEventListener* listener) {
+	std::lock_guard<std::mutex> lkg(state->m_listenerWriteMutex);
 
-	while (state->m_runEventThread) {
-		// 0. acquire unique lock
-		std::unique_lock<std::mutex> eventLock(state->m_eventMutex);
+	std::shared_ptr<const Listeners> current = std::atomic_load(&state->m_listeners);
+	auto updated = std::make_shared<Listeners>(*current);
+	updated->erase(std::remove(updated->begin(), updated->end(), listener), updated->end());
+	std::atomic_store(&state->m_listeners, std::shared_ptr<const Listeners>(std::move(updated)));
 
-		// 1. wait on any of: 
-		//	- first event (condvar)
-		//	- first device event (SyncPoint - cannot be changed)
-		//	- cancel event (condvar)
-		state->m_eventCv.wait(eventLock, [&state] { return !state->m_eventActions.empty() || !state->m_runEventThread; });
+	// Dispatches hold the snapshot they read, wait until the last one that may call the listener is done.
+	while (current.use_count() > 1) {
+		std::this_thread::yield();
+	}
+}
 
-		// 2. acquire lock
-		// wait re-acquires lock
 
-		// 3. exctract & remove all data from queue
-		std::vector<EventAction> events;
-		while (!state->m_eventActions.empty()) {
-			events.push_back(std::move(state->m_eventActions.front()));
-			state->m_eventActions.pop();
-		}
+void PipelineEventDispatcher::Notify(State* state, Handler handler, uint64_t frameId) {
+	std::shared_ptr<const Listeners> listeners = std::atomic_load(&state->m_listeners);
+	for (auto listener : *listeners) {
+		(listener->*handler)(frameId);
+	}
+}
 
-		// 4. release lock
-		eventLock.unlock();
 
-		// 5. lock collection of event listeners
-		std::lock_guard<std::mutex> listenerLock(state->m_listenerMutex);
+void PipelineEventDispatcher::PushDeviceEvent(State* state, DeviceEvent* event) {
+	// The event may be taken and deleted as soon as it's pushed, only the local copy of the old head is safe to read after.
+	DeviceEvent* head = state->m_deviceEvents.load(std::memory_order_relaxed);
+	do {
+		event->next = head;
+	} while (!state->m_deviceEvents.compare_exchange_weak(head, event, std::memory_order_release, std::memory_order_relaxed));
 
-		// 6. call event handlers
-		for (auto& event : events) {
-			try {
-				for (auto listener : state->m_listeners) {
-					event.action(listener);
-				}
-				event.signal.set_value();
-			}
-			catch (...) {
-				assert(false); // should log instead
-				event.signal.set_exception(std::current_exception());
-			}
+	// The thread only sleeps when the queue is empty, it must not miss the first event.
+	if (head == nullptr) {
+		{
+			std::lock_guard<std::mutex> lkg(state->m_deviceSleepMutex);
 		}
+		state->m_deviceCv.notify_one();
 	}
-
-	// 7. ???
-	// 8. profit
 }
 
+
 void PipelineEventDispatcher::DeviceSyncThread(std::shared_ptr<State> state) {
 	SetCurrentThreadName("Event Dispatcher: Device Sync Thread");
 
+	std::vector<DeviceEvent*> events;
 	while (state->m_runDeviceThread) {
-		std::unique_lock<std::mutex> lk(state->m_deviceEventMutex);
-		state->m_deviceCv.wait(lk, [&state] { return !state->m_deviceEventActions.empty() || !state->m_runDeviceThread; });
-
-		std::vector<DeviceEventAction> events;
-		while (!state->m_deviceEventActions.empty()) {
-			events.push_back(std::move(state->m_deviceEventActions.front()));
-			state->m_deviceEventActions.pop();
+		DeviceEvent* newest = state->m_deviceEvents.exchange(nullptr, std::memory_order_acquire);
+		if (newest == nullptr) {
+			std::unique_lock<std::mutex> lk(state->m_deviceSleepMutex);
+			state->m_deviceCv.wait(lk, [&state] { return state->m_deviceEvents.load() != nullptr || !state->m_runDeviceThread; });
+			continue;
 		}
 
-		lk.unlock();
+		// Take the whole batch at once, oldest first.
+		events.clear();
+		for (DeviceEvent* event = newest; event != nullptr; event = event->next) {
+			events.push_back(event);
+		}
+		std::reverse(events.begin(), events.end());
 
-		for (auto& event : events) {
-			event.premise.Wait();
-			PushEventAction(state.get(), EventAction{ std::move(event.action), std::move(event.signal) });
+		// Events are mostly on the same queue, one wait usually covers the whole batch.
+		for (DeviceEvent* event : events) {
+			if (!event->premise.IsReached()) {
+				event->premise.Wait();
+			}
+			try {
+				Notify(state.get(), event->handler, event->frameId);
+			}
+			catch (...) {
+				assert(false); // should log instead
+			}
+			delete event;
 		}
 	}
 }
 
 
 
-void PipelineEventDispatcher::PushEventAction(State* state, EventAction eventAction) {
-	std::unique_lock<std::mutex>  lkg(state->m_eventMutex);
-	state->m_eventActions.push(std::move(eventAction));
-	state->m_eventCv.notify_all();
-}
-
-
-
 } // namespace gxeng
-} // namespace inl
\ No newline at end of file
+} // namespace inl
@@ -3,11 +3,12 @@
 #include "SyncPoint.hpp"
 #include "PipelineEventListener.hpp"
 
-#include <future>
 #include <cstdint>
-#include <set>
-#include <queue>
+#include <vector>
+#include <memory>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 
 
@@ -15,32 +16,37 @@ namespace inl {
 namespace gxeng {
 
 
+/// <summary>
+/// Calls listeners when frames begin and end.
+/// Host events are dispatched right away on the calling thread. Device events are dispatched on a
+/// background thread, once the GPU has reached their sync point, in the order they were queued.
+/// </summary>
+/// <remarks>
+/// Dispatching takes no locks: listeners are read from an immutable snapshot that is
+/// replaced when the set of listeners changes, and device events go through a lock-free queue.
+/// Removing a listener waits until no dispatch is using a snapshot that still has it,
+/// so it must not be called from a listener.
+/// </remarks>
 class PipelineEventDispatcher {
-	struct EventAction {
-		std::function<void(PipelineEventListener*)> action;
-		std::promise<void> signal;
-	};
-	struct DeviceEventAction : EventAction {
+	using Handler = void (PipelineEventListener::*)(uint64_t);
+	using Listeners = std::vector<PipelineEventListener*>;
+
+	struct DeviceEvent {
+		Handler handler;
+		uint64_t frameId;
 		SyncPoint premise; // NOT prOmise
-	};
-	enum eReasonForAwake {
-		CANCEL = 0,
-		QUIT = 1,
-		EVENT,
+		DeviceEvent* next;
 	};
 	struct State {
-		std::queue<EventAction> m_eventActions;
-		std::mutex m_eventMutex;
-		std::condition_variable m_eventCv;
-		std::atomic_bool m_runEventThread;
+		~State();
 
-		std::queue<DeviceEventAction> m_deviceEventActions;
-		std::mutex m_deviceEventMutex;
+		std::shared_ptr<const Listeners> m_listeners; // Accessed atomically.
+		std::mutex m_listenerWriteMutex; // Serializes changes only, readers don't take it.
+
+		std::atomic<DeviceEvent*> m_deviceEvents{ nullptr }; // Newest first.
+		std::mutex m_deviceSleepMutex; // Only for sleeping when there are no events.
 		std::condition_variable m_deviceCv;
 		std::atomic_bool m_runDeviceThread;
-
-		std::mutex m_listenerMutex;
-		std::set<PipelineEventListener*> m_listeners;
 	};
 public:
 	PipelineEventDispatcher();
@@ -51,23 +57,22 @@ public:
 	~PipelineEventDispatcher() noexcept;
 
 
-	std::future<void> DispatchFrameBegin(uint64_t frameId);
-	std::future<void> DispatchFrameEnd(uint64_t frameId);
-	std::future<void> DispatchDeviceFrameBegin(SyncPoint deviceEvent, uint64_t frameId);
-	std::future<void> DispatchDeviceFrameEnd(SyncPoint deviceEvent, uint64_t frameId);
+	void DispatchFrameBegin(uint64_t frameId);
+	void DispatchFrameEnd(uint64_t frameId);
+	void DispatchDeviceFrameBegin(SyncPoint deviceEvent, uint64_t frameId);
+	void DispatchDeviceFrameEnd(SyncPoint deviceEvent, uint64_t frameId);
 
 
 	void operator+=(PipelineEventListener* listener);
 	void operator-=(PipelineEventListener* listener);
 private:
-	static void DispatchThread(std::shared_ptr<State> state);
+	static void Notify(State* state, Handler handler, uint64_t frameId);
+	static void PushDeviceEvent(State* state, DeviceEvent* event);
 	static void DeviceSyncThread(std::shared_ptr<State> state);
-	static void PushEventAction(State* state, EventAction eventAction);
 	void Shutdown();
 private:
 	std::shared_ptr<State> state;
 
-	std::thread m_eventThread;
 	std::thread m_deviceSyncThread;
 };
 
@@ -7,7 +7,11 @@ namespace inl {
 namespace gxeng {
 
 
-
+/// <summary>
+/// Receives frame events from a <see cref="PipelineEventDispatcher"/>.
+/// Host events are called on the thread that dispatches them, device events on the dispatcher's own thread,
+/// so the two kinds may run at the same time and implementations must be thread safe.
+/// </summary>
 class PipelineEventListener {
 public:
 	virtual void OnFrameBeginDevice(uint64_t frameId) = 0;
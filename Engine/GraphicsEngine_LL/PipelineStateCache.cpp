@@ -0,0 +1,495 @@
+#include "PipelineStateCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+namespace inl {
+namespace gxeng {
+
+
+static constexpr char FileMagic[8] = { 'I', 'N', 'L', 'P', 'S', 'O', 'C', '\0' };
+static constexpr uint32_t FileVersion = 1;
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t entryCount;
+};
+
+struct FileEntry {
+	PipelineStateCache::Key key;
+	uint64_t size;
+};
+
+
+template <class T>
+static void AddValue(ShaderCache::KeyBuilder& builder, const T& value) {
+	builder.Add(&value, sizeof(value));
+}
+
+static void AddShader(ShaderCache::KeyBuilder& builder, const gxapi::ShaderByteCodeDesc& shader) {
+	// Content rather than address, the same binary may be compiled again or sit in another node's copy.
+	if (shader.shaderByteCode != nullptr) {
+		builder.Add(shader.shaderByteCode, shader.sizeOfByteCode);
+	}
+	else {
+		builder.Add(std::string());
+	}
+}
+
+
+
+template <class ObjectT>
+PipelineStateCache::Table<ObjectT>::Table() {
+	for (auto& bucket : m_buckets) {
+		bucket.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+
+template <class ObjectT>
+auto PipelineStateCache::Table<ObjectT>::Find(const Key& key) const -> Entry* {
+	const std::atomic<Entry*>& bucket = m_buckets[key.low % BucketCount];
+	for (Entry* entry = bucket.load(std::memory_order_acquire); entry != nullptr; entry = entry->next) {
+		if (entry->key == key) {
+			return entry;
+		}
+	}
+	return nullptr;
+}
+
+
+template <class ObjectT>
+auto PipelineStateCache::Table<ObjectT>::Insert(std::unique_ptr<Entry> entry) -> Entry* {
+	Entry* existing = Find(entry->key);
+	if (existing != nullptr) {
+		return existing;
+	}
+
+	// Entries are complete before they are published, readers only ever see the new head.
+	std::atomic<Entry*>& bucket = m_buckets[entry->key.low % BucketCount];
+	entry->next = bucket.load(std::memory_order_relaxed);
+	bucket.store(entry.get(), std::memory_order_release);
+	m_entries.push_back(std::move(entry));
+	return m_entries.back().get();
+}
+
+
+
+PipelineStateCache::PipelineStateCache(gxapi::IGraphicsApi* gxApi)
+	: m_gxApi(gxApi)
+{}
+
+
+std::shared_ptr<gxapi::IRootSignature> PipelineStateCache::GetRootSignature(const gxapi::RootSignatureDesc& desc) {
+	Key key = MakeKey(desc);
+	auto* found = m_rootSignatures.Find(key);
+	if (found != nullptr) {
+		m_hitCount.fetch_add(1, std::memory_order_relaxed);
+		return found->object;
+	}
+
+	auto entry = std::make_unique<Table<gxapi::IRootSignature>::Entry>();
+	entry->key = key;
+	entry->fileKey = key;
+	entry->hasFileKey = true;
+	entry->object.reset(CreateRootSignature(desc));
+	m_missCount.fetch_add(1, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	auto* inserted = m_rootSignatures.Insert(std::move(entry));
+	m_rootSignatureKeys[inserted->object.get()] = key;
+	return inserted->object;
+}
+
+
+std::shared_ptr<gxapi::IPipelineState> PipelineStateCache::GetPipelineState(const gxapi::GraphicsPipelineStateDesc& desc) {
+	return GetPipelineStateImpl(desc);
+}
+
+
+std::shared_ptr<gxapi::IPipelineState> PipelineStateCache::GetPipelineState(const gxapi::ComputePipelineStateDesc& desc) {
+	return GetPipelineStateImpl(desc);
+}
+
+
+template <class DescT>
+std::shared_ptr<gxapi::IPipelineState> PipelineStateCache::GetPipelineStateImpl(const DescT& desc) {
+	ShaderCache::KeyBuilder builder = MakeKeyBuilder(desc);
+
+	// Root signatures of the cache live as long as the cache, so their address identifies them.
+	ShaderCache::KeyBuilder addressBuilder = builder;
+	addressBuilder.Add(uint64_t(reinterpret_cast<uintptr_t>(desc.rootSignature)));
+	Key key = addressBuilder.Finish();
+
+	auto* found = m_pipelineStates.Find(key);
+	if (found != nullptr) {
+		std::shared_ptr<gxapi::IPipelineState> object = std::atomic_load(&found->object);
+		if (object) {
+			m_hitCount.fetch_add(1, std::memory_order_relaxed);
+			return object;
+		}
+	}
+
+	// Addresses change between runs, files identify root signatures by content.
+	auto entry = std::make_unique<Table<gxapi::IPipelineState>::Entry>();
+	entry->key = key;
+	{
+		std::lock_guard<std::mutex> lkg(m_mutex);
+		auto rootSignatureIt = m_rootSignatureKeys.find(desc.rootSignature);
+		if (rootSignatureIt != m_rootSignatureKeys.end()) {
+			builder.Add(rootSignatureIt->second.low);
+			builder.Add(rootSignatureIt->second.high);
+			entry->fileKey = builder.Finish();
+			entry->hasFileKey = true;
+		}
+	}
+
+	std::shared_ptr<gxapi::IPipelineState> object(CreateWithBlob(desc, entry->hasFileKey ? &entry->fileKey : nullptr));
+	entry->object = object;
+	m_missCount.fetch_add(1, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	auto* inserted = m_pipelineStates.Insert(std::move(entry));
+
+	// The entry of a dropped PSO stays in the table, it gets the new object.
+	std::shared_ptr<gxapi::IPipelineState> current = std::atomic_load(&inserted->object);
+	if (!current) {
+		std::atomic_store(&inserted->object, object);
+		return object;
+	}
+	return current;
+}
+
+
+template <class DescT>
+gxapi::IPipelineState* PipelineStateCache::CreateWithBlob(DescT desc, const Key* fileKey) {
+	std::vector<uint8_t> blob;
+	if (fileKey != nullptr) {
+		std::lock_guard<std::mutex> lkg(m_mutex);
+		auto blobIt = m_blobs.find(*fileKey);
+		if (blobIt != m_blobs.end()) {
+			blob = std::move(blobIt->second);
+			m_blobs.erase(blobIt);
+		}
+	}
+
+	if (!blob.empty()) {
+		desc.cachedBlob = blob.data();
+		desc.cachedBlobSize = blob.size();
+		try {
+			gxapi::IPipelineState* pipelineState = CreatePipelineState(desc);
+			m_blobHitCount.fetch_add(1, std::memory_order_relaxed);
+			return pipelineState;
+		}
+		catch (std::exception&) {
+			// Blobs don't survive driver or hardware changes, compile from scratch then.
+			m_blobRejectCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		desc.cachedBlob = nullptr;
+		desc.cachedBlobSize = 0;
+	}
+
+	return CreatePipelineState(desc);
+}
+
+
+bool PipelineStateCache::Load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	FileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good() || std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0 || header.version != FileVersion) {
+		return false;
+	}
+
+	std::unordered_map<Key, std::vector<uint8_t>, KeyHash> blobs;
+	for (uint64_t i = 0; i < header.entryCount; ++i) {
+		FileEntry entry;
+		file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+		if (!file.good() || entry.size > (1ull << 30)) {
+			return false;
+		}
+		std::vector<uint8_t> blob(entry.size);
+		file.read(reinterpret_cast<char*>(blob.data()), entry.size);
+		if (!file.good()) {
+			return false;
+		}
+		blobs[entry.key] = std::move(blob);
+	}
+
+	std::lock_guard<std::mutex> lkg(m_mutex);
+	for (auto& blob : blobs) {
+		m_blobs.insert(std::move(blob));
+	}
+	return true;
+}
+
+
+bool PipelineStateCache::Save(const std::string& path) const noexcept {
+	// Called on exit, a failure must not throw out of a destructor.
+	try {
+		std::unordered_map<Key, std::vector<uint8_t>, KeyHash> blobs;
+		{
+			std::lock_guard<std::mutex> lkg(m_mutex);
+			blobs = m_blobs;
+			for (const auto& entry : m_pipelineStates.GetEntries()) {
+				std::shared_ptr<gxapi::IPipelineState> object = std::atomic_load(&entry->object);
+				if (entry->hasFileKey && object) {
+					std::vector<uint8_t> blob;
+					try {
+						blob = object->GetCachedBlob();
+					}
+					catch (std::exception&) {
+						// The PSO is compiled from scratch in the next run, the others are still worth saving.
+						continue;
+					}
+					if (!blob.empty()) {
+						blobs[entry->fileKey] = std::move(blob);
+					}
+				}
+			}
+		}
+
+		FileHeader header;
+		std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+		header.version = FileVersion;
+		header.reserved = 0;
+		header.entryCount = blobs.size();
+
+		// Write a new file next to the old one, then swap them, so that a crash can't leave a half-written file.
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (const auto& blob : blobs) {
+				FileEntry entry;
+				entry.key = blob.first;
+				entry.size = blob.second.size();
+				file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+				file.write(reinterpret_cast<const char*>(blob.second.data()), blob.second.size());
+			}
+			if (!file.good()) {
+				file.close();
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+
+		std::remove(path.c_str());
+		return std::rename(tempPath.c_str(), path.c_str()) == 0;
+	}
+	catch (...) {
+		return false;
+	}
+}
+
+
+void PipelineStateCache::ReleaseUnused() {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+
+	for (const auto& entry : m_pipelineStates.GetEntries()) {
+		std::shared_ptr<gxapi::IPipelineState> object = std::atomic_load(&entry->object);
+		// Held by the entry and by this copy only. Lookups don't lock, one may have just taken it, that copy stays valid.
+		if (object && object.use_count() == 2) {
+			std::atomic_store(&entry->object, std::shared_ptr<gxapi::IPipelineState>());
+		}
+	}
+}
+
+
+auto PipelineStateCache::GetStatistics() const -> Statistics {
+	std::lock_guard<std::mutex> lkg(m_mutex);
+
+	Statistics statistics;
+	statistics.hitCount = m_hitCount.load(std::memory_order_relaxed);
+	statistics.missCount = m_missCount.load(std::memory_order_relaxed);
+	statistics.blobHitCount = m_blobHitCount.load(std::memory_order_relaxed);
+	statistics.blobRejectCount = m_blobRejectCount.load(std::memory_order_relaxed);
+	statistics.rootSignatureCount = m_rootSignatures.GetEntries().size();
+	for (const auto& entry : m_pipelineStates.GetEntries()) {
+		if (std::atomic_load(&entry->object)) {
+			++statistics.pipelineStateCount;
+		}
+	}
+	return statistics;
+}
+
+
+auto PipelineStateCache::MakeKey(const gxapi::RootSignatureDesc& desc) -> Key {
+	ShaderCache::KeyBuilder builder;
+	builder.Add(uint64_t('R'));
+
+	builder.Add(uint64_t(desc.rootParameters.size()));
+	for (const auto& parameter : desc.rootParameters) {
+		AddValue(builder, parameter.type);
+		AddValue(builder, parameter.shaderVisibility);
+		switch (parameter.type) {
+			case gxapi::RootParameterDesc::CONSTANT: {
+				const auto& constant = parameter.As<gxapi::RootParameterDesc::CONSTANT>();
+				AddValue(builder, constant.shaderRegister);
+				AddValue(builder, constant.registerSpace);
+				AddValue(builder, constant.numConstants);
+				break;
+			}
+			case gxapi::RootParameterDesc::CBV:
+			case gxapi::RootParameterDesc::SRV:
+			case gxapi::RootParameterDesc::UAV: {
+				const auto& descriptor = parameter.As<gxapi::RootParameterDesc::CBV>();
+				AddValue(builder, descriptor.shaderRegister);
+				AddValue(builder, descriptor.registerSpace);
+				break;
+			}
+			case gxapi::RootParameterDesc::DESCRIPTOR_TABLE: {
+				const auto& ranges = parameter.As<gxapi::RootParameterDesc::DESCRIPTOR_TABLE>().ranges;
+				builder.Add(uint64_t(ranges.size()));
+				for (const auto& range : ranges) {
+					AddValue(builder, range.type);
+					AddValue(builder, range.numDescriptors);
+					AddValue(builder, range.baseShaderRegister);
+					AddValue(builder, range.registerSpace);
+					AddValue(builder, range.offsetFromTableStart);
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	builder.Add(uint64_t(desc.staticSamplers.size()));
+	for (const auto& sampler : desc.staticSamplers) {
+		AddValue(builder, sampler.filter);
+		AddValue(builder, sampler.addressU);
+		AddValue(builder, sampler.addressV);
+		AddValue(builder, sampler.addressW);
+		AddValue(builder, sampler.mipLevelBias);
+		AddValue(builder, sampler.maxAnisotropy);
+		AddValue(builder, sampler.compareFunc);
+		AddValue(builder, sampler.border);
+		AddValue(builder, sampler.minMipLevel);
+		AddValue(builder, sampler.maxMipLevel);
+		AddValue(builder, sampler.shaderRegister);
+		AddValue(builder, sampler.registerSpace);
+		AddValue(builder, sampler.shaderVisibility);
+	}
+
+	return builder.Finish();
+}
+
+
+ShaderCache::KeyBuilder PipelineStateCache::MakeKeyBuilder(const gxapi::GraphicsPipelineStateDesc& desc) {
+	ShaderCache::KeyBuilder builder;
+	builder.Add(uint64_t('G'));
+
+	AddShader(builder, desc.vs);
+	AddShader(builder, desc.gs);
+	AddShader(builder, desc.hs);
+	AddShader(builder, desc.ds);
+	AddShader(builder, desc.ps);
+
+	const gxapi::RasterizerState& rasterization = desc.rasterization;
+	AddValue(builder, rasterization.fillMode);
+	AddValue(builder, rasterization.cullMode);
+	AddValue(builder, rasterization.depthBias);
+	AddValue(builder, rasterization.depthBiasClamp);
+	AddValue(builder, rasterization.slopeScaledDepthBias);
+	AddValue(builder, rasterization.depthClipEnabled);
+	AddValue(builder, rasterization.multisampleEnabled);
+	AddValue(builder, rasterization.lineAntialiasingEnabled);
+	AddValue(builder, rasterization.forcedSampleCount);
+	AddValue(builder, rasterization.conservativeRasterization);
+
+	const gxapi::DepthStencilState& depthStencil = desc.depthStencilState;
+	AddValue(builder, depthStencil.enableDepthTest);
+	AddValue(builder, depthStencil.enableDepthStencilWrite);
+	AddValue(builder, depthStencil.depthFunc);
+	AddValue(builder, depthStencil.enableStencilTest);
+	AddValue(builder, depthStencil.stencilReadMask);
+	AddValue(builder, depthStencil.stencilWriteMask);
+	for (const auto* face : { &depthStencil.cwFace, &depthStencil.ccwFace }) {
+		AddValue(builder, face->stencilOpOnStencilFail);
+		AddValue(builder, face->stencilOpOnDepthFail);
+		AddValue(builder, face->stencilOpOnPass);
+		AddValue(builder, face->stencilFunc);
+	}
+
+	AddValue(builder, desc.blending.alphaToCoverage);
+	AddValue(builder, desc.blending.independentBlending);
+	for (const auto& target : desc.blending.multiTarget) {
+		AddValue(builder, target.enableBlending);
+		AddValue(builder, target.enableLogicOp);
+		AddValue(builder, target.colorOperand1);
+		AddValue(builder, target.colorOperand2);
+		AddValue(builder, target.colorOperation);
+		AddValue(builder, target.alphaOperand1);
+		AddValue(builder, target.alphaOperand2);
+		AddValue(builder, target.alphaOperation);
+		AddValue(builder, target.mask);
+		AddValue(builder, target.logicOperation);
+	}
+	AddValue(builder, desc.blendSampleMask);
+
+	builder.Add(uint64_t(desc.inputLayout.numElements));
+	for (unsigned i = 0; i < desc.inputLayout.numElements; ++i) {
+		const gxapi::InputElementDesc& element = desc.inputLayout.elements[i];
+		builder.Add(element.semanticName != nullptr ? std::string(element.semanticName) : std::string());
+		AddValue(builder, element.semanticIndex);
+		AddValue(builder, element.format);
+		AddValue(builder, element.inputSlot);
+		AddValue(builder, element.offset);
+		AddValue(builder, element.classifiacation);
+		AddValue(builder, element.instanceDataStepRate);
+	}
+	AddValue(builder, desc.primitiveTopologyType);
+	AddValue(builder, desc.triangleStripCutIndex);
+
+	// The formats of unused targets are ignored when creating the PSO.
+	AddValue(builder, desc.numRenderTargets);
+	for (unsigned i = 0; i < desc.numRenderTargets && i < 8; ++i) {
+		AddValue(builder, desc.renderTargetFormats[i]);
+	}
+	AddValue(builder, desc.depthStencilFormat);
+	AddValue(builder, desc.multisampleCount);
+	AddValue(builder, desc.multisampleQuality);
+	AddValue(builder, desc.addDebugInfo);
+
+	return builder;
+}
+
+
+ShaderCache::KeyBuilder PipelineStateCache::MakeKeyBuilder(const gxapi::ComputePipelineStateDesc& desc) {
+	ShaderCache::KeyBuilder builder;
+	builder.Add(uint64_t('C'));
+	AddShader(builder, desc.cs);
+	AddValue(builder, desc.addDebugInfo);
+	return builder;
+}
+
+
+gxapi::IRootSignature* PipelineStateCache::CreateRootSignature(const gxapi::RootSignatureDesc& desc) {
+	return m_gxApi->CreateRootSignature(desc);
+}
+
+
+gxapi::IPipelineState* PipelineStateCache::CreatePipelineState(const gxapi::GraphicsPipelineStateDesc& desc) {
+	return m_gxApi->CreateGraphicsPipelineState(desc);
+}
+
+
+gxapi::IPipelineState* PipelineStateCache::CreatePipelineState(const gxapi::ComputePipelineStateDesc& desc) {
+	return m_gxApi->CreateComputePipelineState(desc);
+}
+
+
+} // namespace gxeng
+} // namespace inl
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "ShaderCache.hpp"
+
+#include "../GraphicsApi_LL/IGraphicsApi.hpp"
+#include "../GraphicsApi_LL/IPipelineState.hpp"
+#include "../GraphicsApi_LL/IRootSignature.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace inl {
+namespace gxeng {
+
+
+/// <summary>
+/// Creates root signatures and pipeline states, and returns the same object for equal descriptions,
+/// no matter which node asks for it.
+/// </summary>
+/// <remarks>
+/// Descriptions are hashed by content, including the shader binaries, so PSOs of reloaded or
+/// regenerated shaders are found if the binary is the same.
+/// Root signatures are deduplicated as well, so that the PSOs of nodes with equal binders match.
+/// Root signatures that were not made by the cache are told apart by address, and must not be
+/// destroyed while PSOs are requested with them.
+///
+/// Lookups of existing objects don't lock. Creation happens outside the lock too, if two threads
+/// create the same object at once, one of them is dropped.
+///
+/// The driver's compiled form of the PSOs can be saved to a file, and is passed to the driver
+/// when the same PSO is created in a later run. Blobs the driver rejects, say after a driver update,
+/// are ignored. PSOs dropped by <see cref="ReleaseUnused"/> are not saved.
+/// </remarks>
+class PipelineStateCache {
+public:
+	using Key = ShaderCache::Key;
+
+	struct Statistics {
+		uint64_t hitCount = 0;
+		uint64_t missCount = 0; // Requests that created an object.
+		uint64_t blobHitCount = 0; // PSOs created from a blob loaded from file.
+		uint64_t blobRejectCount = 0; // Loaded blobs the driver did not accept.
+		size_t rootSignatureCount = 0;
+		size_t pipelineStateCount = 0; // Not counting the dropped ones.
+	};
+
+public:
+	explicit PipelineStateCache(gxapi::IGraphicsApi* gxApi);
+	virtual ~PipelineStateCache() {}
+
+	PipelineStateCache(const PipelineStateCache&) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+	/// <remarks> This method is thread-safe. </remarks>
+	std::shared_ptr<gxapi::IRootSignature> GetRootSignature(const gxapi::RootSignatureDesc& desc);
+	/// <remarks> This method is thread-safe. </remarks>
+	std::shared_ptr<gxapi::IPipelineState> GetPipelineState(const gxapi::GraphicsPipelineStateDesc& desc);
+	/// <remarks> This method is thread-safe. </remarks>
+	std::shared_ptr<gxapi::IPipelineState> GetPipelineState(const gxapi::ComputePipelineStateDesc& desc);
+
+	/// <summary> Loads the blobs of a file written by <see cref="Save"/>. </summary>
+	/// <returns> False if the file is missing or corrupt, the cache is left as it was then. </returns>
+	/// <remarks> This method is thread-safe. </remarks>
+	bool Load(const std::string& path);
+	/// <summary> Writes the blobs of the PSOs created so far, and the loaded blobs that were not used.
+	///		PSOs whose blob the driver fails to give are left out. </summary>
+	/// <returns> False if the file could not be written. Never throws, so it may be called on exit. </returns>
+	/// <remarks> This method is thread-safe. </remarks>
+	bool Save(const std::string& path) const noexcept;
+
+	/// <summary> Drops the PSOs only the cache holds, like those of shaders replaced by hot reload.
+	///		They are created again if requested. </summary>
+	/// <remarks> This method is thread-safe. </remarks>
+	void ReleaseUnused();
+
+	Statistics GetStatistics() const;
+
+	static Key MakeKey(const gxapi::RootSignatureDesc& desc);
+	/// <summary> Hashes the description without the root signature. </summary>
+	static ShaderCache::KeyBuilder MakeKeyBuilder(const gxapi::GraphicsPipelineStateDesc& desc);
+	/// <summary> Hashes the description without the root signature. </summary>
+	static ShaderCache::KeyBuilder MakeKeyBuilder(const gxapi::ComputePipelineStateDesc& desc);
+protected:
+	virtual gxapi::IRootSignature* CreateRootSignature(const gxapi::RootSignatureDesc& desc);
+	virtual gxapi::IPipelineState* CreatePipelineState(const gxapi::GraphicsPipelineStateDesc& desc);
+	virtual gxapi::IPipelineState* CreatePipelineState(const gxapi::ComputePipelineStateDesc& desc);
+private:
+	/// <summary> A hash table that can be read while it's written. Entries are never removed. </summary>
+	template <class ObjectT>
+	class Table {
+	public:
+		Table();
+
+		struct Entry {
+			Key key;
+			Key fileKey; // Identifies PSOs across runs.
+			bool hasFileKey = false; // Only if the root signature was made by the cache.
+			std::shared_ptr<ObjectT> object; // Accessed atomically for PSOs, null if dropped.
+			Entry* next = nullptr;
+		};
+
+		Entry* Find(const Key& key) const;
+		/// <summary> Adds the entry unless one with the same key exists. Returns the one in the table. Needs the cache's lock. </summary>
+		Entry* Insert(std::unique_ptr<Entry> entry);
+
+		const std::vector<std::unique_ptr<Entry>>& GetEntries() const { return m_entries; }
+	private:
+		static constexpr size_t BucketCount = 1024;
+		std::array<std::atomic<Entry*>, BucketCount> m_buckets;
+		std::vector<std::unique_ptr<Entry>> m_entries;
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const { return size_t(key.low); }
+	};
+
+	template <class DescT>
+	std::shared_ptr<gxapi::IPipelineState> GetPipelineStateImpl(const DescT& desc);
+	/// <summary> Creates the PSO from the loaded blob of the file key if there's one, and without it otherwise. </summary>
+	template <class DescT>
+	gxapi::IPipelineState* CreateWithBlob(DescT desc, const Key* fileKey);
+private:
+	gxapi::IGraphicsApi* m_gxApi;
+
+	Table<gxapi::IRootSignature> m_rootSignatures;
+	Table<gxapi::IPipelineState> m_pipelineStates;
+	std::unordered_map<const gxapi::IRootSignature*, Key> m_rootSignatureKeys;
+	std::unordered_map<Key, std::vector<uint8_t>, KeyHash> m_blobs; // Loaded from file, not used yet.
+	mutable std::mutex m_mutex; // Guards insertion and everything but the tables' lookups.
+
+	std::atomic<uint64_t> m_hitCount{ 0 };
+	std::atomic<uint64_t> m_missCount{ 0 };
+	std::atomic<uint64_t> m_blobHitCount{ 0 };
+	std::atomic<uint64_t> m_blobRejectCount{ 0 };
+};
+
+
+} // namespace gxeng
+} // namespace inl
@@ -3,6 +3,7 @@
 
 #include <type_traits>
 #include <cstdint>
+#include <cstddef>
 
 
 namespace inl {
@@ -131,12 +132,13 @@ public:
 	using impl::PixelData<typename impl::GetChannelType<ChannelType>::type, ChannelCount>::PixelData;
 
 	class PixelReader : public IPixelReader {
+		using ChannelT = typename impl::GetChannelType<ChannelType>::type;
 	public:
 		float Get(const void* pixel, int channel) const override {
-			return impl::DenormalizeColor<float>(reinterpret_cast<const Pixel*>(pixel)->channels[channel]);
+			return impl::NormalizeColor<ChannelT>(reinterpret_cast<const Pixel*>(pixel)->channels[channel]);
 		}
 		void Set(void* pixel, int channel, float value) const override {
-			reinterpret_cast<Pixel*>(pixel)->channels[channel] = impl::NormalizeColor<Type>(value);
+			reinterpret_cast<Pixel*>(pixel)->channels[channel] = impl::DenormalizeColor<ChannelT>(value);
 		}
 		ePixelChannelType GetChannelType() const override {
 			return ChannelType;
@@ -0,0 +1,229 @@
+#include "PixelConverter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace inl {
+namespace gxeng {
+
+
+namespace {
+
+constexpr int CHANNEL_TYPE_COUNT = 4;
+constexpr int MAX_CHANNEL_COUNT = 4;
+
+using KernelTable = PixelConverter::Kernel[CHANNEL_TYPE_COUNT][MAX_CHANNEL_COUNT][CHANNEL_TYPE_COUNT][MAX_CHANNEL_COUNT];
+
+
+template <class T>
+constexpr ePixelChannelType ChannelTypeOf();
+template <> constexpr ePixelChannelType ChannelTypeOf<uint8_t>() { return ePixelChannelType::INT8_NORM; }
+template <> constexpr ePixelChannelType ChannelTypeOf<uint16_t>() { return ePixelChannelType::INT16_NORM; }
+template <> constexpr ePixelChannelType ChannelTypeOf<uint32_t>() { return ePixelChannelType::INT32; }
+template <> constexpr ePixelChannelType ChannelTypeOf<float>() { return ePixelChannelType::FLOAT32; }
+
+
+// Normalized integers and floats, rounded to nearest.
+template <class SrcT, class DstT>
+inline DstT ConvertChannel(SrcT value) {
+	if constexpr (std::is_same_v<SrcT, DstT>) {
+		return value;
+	}
+	else if constexpr (std::is_floating_point_v<SrcT>) {
+		// Written so that NaN compares false and becomes 0, out of range floats would be undefined to convert.
+		float clamped = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+		return DstT(clamped * float(DstT(~DstT(0))) + 0.5f);
+	}
+	else if constexpr (std::is_floating_point_v<DstT>) {
+		return DstT(value) * (DstT(1) / DstT(SrcT(~SrcT(0))));
+	}
+	else if constexpr (sizeof(SrcT) < sizeof(DstT)) {
+		return DstT(value) * (DstT(~DstT(0)) / DstT(SrcT(~SrcT(0)))); // 8 to 16 bits: x * 257
+	}
+	else {
+		constexpr uint32_t srcMax = SrcT(~SrcT(0));
+		constexpr uint32_t dstMax = DstT(~DstT(0));
+		return DstT((uint32_t(value) * dstMax + srcMax / 2) / srcMax);
+	}
+}
+
+
+template <class T>
+constexpr T OpaqueAlpha() {
+	if constexpr (std::is_floating_point_v<T>) {
+		return T(1);
+	}
+	else {
+		return T(~T(0));
+	}
+}
+
+
+// The inner loops have constant trip counts, the compiler unrolls and vectorizes them.
+template <class SrcT, int SrcCount, class DstT, int DstCount>
+void ConvertPixels(const void* source, void* destination, size_t pixelCount) {
+	static_assert(SrcCount == DstCount || (SrcCount == 3 && DstCount == 4), "Only expansion to alpha is supported.");
+
+	const SrcT* src = reinterpret_cast<const SrcT*>(source);
+	DstT* dst = reinterpret_cast<DstT*>(destination);
+	for (size_t i = 0; i < pixelCount; ++i) {
+		for (int c = 0; c < SrcCount; ++c) {
+			dst[c] = ConvertChannel<SrcT, DstT>(src[c]);
+		}
+		if constexpr (DstCount > SrcCount) {
+			dst[3] = OpaqueAlpha<DstT>();
+		}
+		src += SrcCount;
+		dst += DstCount;
+	}
+}
+
+
+template <class T, int Count>
+void CopyPixels(const void* source, void* destination, size_t pixelCount) {
+	memcpy(destination, source, pixelCount * Count * sizeof(T));
+}
+
+
+// Most textures are RGB8 images, they are done four pixels at a time: three words in, four words out.
+void ExpandRgb8ToRgba8(const void* source, void* destination, size_t pixelCount) {
+	const uint8_t* src = reinterpret_cast<const uint8_t*>(source);
+	uint8_t* dst = reinterpret_cast<uint8_t*>(destination);
+	constexpr uint32_t alpha = 0xFF000000u; // Little endian, the fourth byte is the highest.
+
+	size_t i = 0;
+	for (; i + 4 <= pixelCount; i += 4) {
+		uint32_t in[3];
+		memcpy(in, src, sizeof(in));
+		uint32_t out[4] = {
+			in[0] | alpha,
+			(in[0] >> 24) | (in[1] << 8) | alpha,
+			(in[1] >> 16) | (in[2] << 16) | alpha,
+			(in[2] >> 8) | alpha,
+		};
+		memcpy(dst, out, sizeof(out));
+		src += sizeof(in);
+		dst += sizeof(out);
+	}
+	ConvertPixels<uint8_t, 3, uint8_t, 4>(src, dst, pixelCount - i);
+}
+
+
+template <class SrcT, int SrcCount, class DstT, int DstCount>
+void Register(KernelTable& table, PixelConverter::Kernel kernel) {
+	table[(int)ChannelTypeOf<SrcT>()][SrcCount - 1][(int)ChannelTypeOf<DstT>()][DstCount - 1] = kernel;
+}
+
+template <class SrcT, class DstT>
+void RegisterConversions(KernelTable& table) {
+	Register<SrcT, 1, DstT, 1>(table, &ConvertPixels<SrcT, 1, DstT, 1>);
+	Register<SrcT, 2, DstT, 2>(table, &ConvertPixels<SrcT, 2, DstT, 2>);
+	Register<SrcT, 3, DstT, 3>(table, &ConvertPixels<SrcT, 3, DstT, 3>);
+	Register<SrcT, 4, DstT, 4>(table, &ConvertPixels<SrcT, 4, DstT, 4>);
+	Register<SrcT, 3, DstT, 4>(table, &ConvertPixels<SrcT, 3, DstT, 4>);
+}
+
+template <class T>
+void RegisterCopies(KernelTable& table) {
+	Register<T, 1, T, 1>(table, &CopyPixels<T, 1>);
+	Register<T, 2, T, 2>(table, &CopyPixels<T, 2>);
+	Register<T, 3, T, 3>(table, &CopyPixels<T, 3>);
+	Register<T, 4, T, 4>(table, &CopyPixels<T, 4>);
+	Register<T, 3, T, 4>(table, &ConvertPixels<T, 3, T, 4>);
+}
+
+
+struct KernelRegistry {
+	KernelTable table = {};
+
+	KernelRegistry() {
+		RegisterCopies<uint8_t>(table);
+		RegisterCopies<uint16_t>(table);
+		RegisterCopies<uint32_t>(table); // Not normalized, can't be converted to others.
+		RegisterCopies<float>(table);
+
+		RegisterConversions<uint8_t, uint16_t>(table);
+		RegisterConversions<uint8_t, float>(table);
+		RegisterConversions<uint16_t, uint8_t>(table);
+		RegisterConversions<uint16_t, float>(table);
+		RegisterConversions<float, uint8_t>(table);
+		RegisterConversions<float, uint16_t>(table);
+
+		Register<uint8_t, 3, uint8_t, 4>(table, &ExpandRgb8ToRgba8);
+	}
+};
+
+const KernelTable& GetKernelTable() {
+	static const KernelRegistry registry;
+	return registry.table;
+}
+
+} // namespace
+
+
+size_t PixelFormat::GetSize() const {
+	switch (channelType) {
+		case ePixelChannelType::INT8_NORM: return channelCount * sizeof(uint8_t);
+		case ePixelChannelType::INT16_NORM: return channelCount * sizeof(uint16_t);
+		case ePixelChannelType::INT32: return channelCount * sizeof(uint32_t);
+		case ePixelChannelType::FLOAT32: return channelCount * sizeof(float);
+	}
+	return 0;
+}
+
+
+PixelConverter::Kernel PixelConverter::Find(const PixelFormat& source, const PixelFormat& destination) {
+	if (source.pixelClass != destination.pixelClass) {
+		return nullptr;
+	}
+	if (source.channelCount < 1 || source.channelCount > MAX_CHANNEL_COUNT
+		|| destination.channelCount < 1 || destination.channelCount > MAX_CHANNEL_COUNT)
+	{
+		return nullptr;
+	}
+
+	return GetKernelTable()[(int)source.channelType][source.channelCount - 1][(int)destination.channelType][destination.channelCount - 1];
+}
+
+
+void PixelConverter::Convert(Kernel kernel,
+							 const void* source, size_t sourcePitch,
+							 void* destination, size_t destinationPitch,
+							 size_t width, size_t height)
+{
+	auto ConvertBand = [=](size_t firstRow, size_t lastRow) {
+		for (size_t y = firstRow; y < lastRow; ++y) {
+			kernel(reinterpret_cast<const uint8_t*>(source) + y * sourcePitch,
+				   reinterpret_cast<uint8_t*>(destination) + y * destinationPitch,
+				   width);
+		}
+	};
+
+	size_t threadCount = std::min({ size_t(std::max(1u, std::thread::hardware_concurrency())),
+									width * height / MIN_PIXELS_PER_THREAD,
+									height });
+	if (threadCount <= 1) {
+		ConvertBand(0, height);
+		return;
+	}
+
+	// The first band is converted on this thread.
+	size_t rowsPerBand = (height + threadCount - 1) / threadCount;
+	std::vector<std::future<void>> bands;
+	for (size_t firstRow = rowsPerBand; firstRow < height; firstRow += rowsPerBand) {
+		bands.push_back(std::async(std::launch::async, ConvertBand, firstRow, std::min(height, firstRow + rowsPerBand)));
+	}
+	ConvertBand(0, rowsPerBand);
+	for (auto& band : bands) {
+		band.get();
+	}
+}
+
+
+} // namespace gxeng
+} // namespace inl
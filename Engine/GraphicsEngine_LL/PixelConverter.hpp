@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Pixel.hpp"
+
+#include <cstddef>
+
+
+namespace inl {
+namespace gxeng {
+
+
+struct PixelFormat {
+	ePixelChannelType channelType;
+	int channelCount;
+	ePixelClass pixelClass;
+
+	bool operator==(const PixelFormat& rhs) const {
+		return channelType == rhs.channelType && channelCount == rhs.channelCount && pixelClass == rhs.pixelClass;
+	}
+	bool operator!=(const PixelFormat& rhs) const {
+		return !(*this == rhs);
+	}
+
+	size_t GetSize() const;
+};
+
+
+/// <summary>
+/// Converts rows of pixels between formats, used to fill upload staging memory.
+/// </summary>
+/// <remarks>
+/// Kernels exist for changing the channel type between normalized integers and floats,
+/// and for expanding 3 channel pixels to 4 channels. Added alpha channels are opaque.
+/// The pixel class is not converted, it must be the same for the source and the destination.
+/// </remarks>
+class PixelConverter {
+public:
+	/// <summary> Converts a row of tightly packed pixels. </summary>
+	using Kernel = void(*)(const void* source, void* destination, size_t pixelCount);
+
+	/// <summary> Returns the kernel for the pair of formats, or null if the conversion is not supported. </summary>
+	static Kernel Find(const PixelFormat& source, const PixelFormat& destination);
+
+	/// <summary> Converts a rectangle of pixels. Large images are split into bands of rows converted in parallel. </summary>
+	static void Convert(Kernel kernel,
+						const void* source, size_t sourcePitch,
+						void* destination, size_t destinationPitch,
+						size_t width, size_t height);
+
+	/// <summary> Images with fewer pixels are converted on the calling thread. </summary>
+	static constexpr size_t MIN_PIXELS_PER_THREAD = 256 * 1024;
+};
+
+
+} // namespace gxeng
+} // namespace inl
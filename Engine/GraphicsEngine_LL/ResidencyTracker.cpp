@@ -0,0 +1,189 @@
+#include "ResidencyTracker.hpp"
+
+#include <stdexcept>
+#include <cassert>
+
+
+namespace inl::gxeng {
+
+
+ResidencyTracker::ResidencyTracker(size_t budget) {
+	m_statistics.budget = budget;
+}
+
+
+void ResidencyTracker::SetBudget(size_t bytes) {
+	m_statistics.budget = bytes;
+}
+
+
+size_t ResidencyTracker::GetBudget() const {
+	return m_statistics.budget;
+}
+
+
+void ResidencyTracker::Add(const gxapi::IPageable* resource, size_t size) {
+	Entry entry;
+	entry.size = size;
+	entry.lruPosition = m_lruList.end();
+
+	bool inserted = m_entries.insert({ resource, entry }).second;
+	if (!inserted) {
+		throw std::invalid_argument("Resource is already tracked.");
+	}
+
+	m_statistics.residentBytes += size;
+	m_statistics.trackedBytes += size;
+}
+
+
+void ResidencyTracker::Remove(const gxapi::IPageable* resource) {
+	auto it = m_entries.find(resource);
+	if (it == m_entries.end()) {
+		return;
+	}
+
+	Entry& entry = it->second;
+	if (entry.lruPosition != m_lruList.end()) {
+		m_lruList.erase(entry.lruPosition);
+	}
+	if (entry.resident) {
+		m_statistics.residentBytes -= entry.size;
+	}
+	m_statistics.trackedBytes -= entry.size;
+	m_entries.erase(it);
+}
+
+
+std::vector<gxapi::IPageable*> ResidencyTracker::Lock(const std::vector<gxapi::IPageable*>& resources) {
+	std::vector<gxapi::IPageable*> toMakeResident;
+
+	for (gxapi::IPageable* resource : resources) {
+		auto it = m_entries.find(resource);
+		if (it == m_entries.end()) {
+			continue;
+		}
+
+		Entry& entry = it->second;
+		if (entry.lruPosition != m_lruList.end()) {
+			m_lruList.erase(entry.lruPosition);
+			entry.lruPosition = m_lruList.end();
+		}
+		if (!entry.resident) {
+			entry.resident = true;
+			m_statistics.residentBytes += entry.size;
+			toMakeResident.push_back(resource);
+		}
+		entry.lastUsedFrame = m_currentFrame;
+		++entry.lockCount;
+	}
+
+	if (!toMakeResident.empty()) {
+		m_statistics.makeResidentCount += toMakeResident.size();
+		++m_statistics.makeResidentBatches;
+	}
+	return toMakeResident;
+}
+
+
+void ResidencyTracker::Unlock(const std::vector<gxapi::IPageable*>& resources) {
+	for (gxapi::IPageable* resource : resources) {
+		auto it = m_entries.find(resource);
+		if (it == m_entries.end()) {
+			continue; // Might have been removed while the GPU was using it.
+		}
+
+		Entry& entry = it->second;
+		assert(entry.lockCount > 0);
+		--entry.lockCount;
+		entry.evictable = true;
+		if (entry.lockCount == 0 && entry.resident) {
+			assert(entry.lruPosition == m_lruList.end());
+			entry.lruPosition = m_lruList.insert(m_lruList.end(), resource);
+		}
+	}
+}
+
+
+void ResidencyTracker::CancelLock(const std::vector<gxapi::IPageable*>& resources, const std::vector<gxapi::IPageable*>& notMadeResident) {
+	for (gxapi::IPageable* resource : notMadeResident) {
+		Entry& entry = m_entries.at(resource);
+		if (entry.resident) {
+			entry.resident = false;
+			m_statistics.residentBytes -= entry.size;
+		}
+	}
+	if (!notMadeResident.empty()) {
+		m_statistics.makeResidentCount -= notMadeResident.size();
+		--m_statistics.makeResidentBatches;
+	}
+
+	for (gxapi::IPageable* resource : resources) {
+		auto it = m_entries.find(resource);
+		if (it == m_entries.end()) {
+			continue;
+		}
+
+		Entry& entry = it->second;
+		assert(entry.lockCount > 0);
+		--entry.lockCount;
+		if (entry.lockCount == 0 && entry.resident && entry.evictable) {
+			assert(entry.lruPosition == m_lruList.end());
+			entry.lruPosition = m_lruList.insert(m_lruList.end(), resource);
+		}
+	}
+}
+
+
+std::vector<gxapi::IPageable*> ResidencyTracker::SelectEvictions(size_t targetBytes) {
+	std::vector<gxapi::IPageable*> toEvict;
+
+	while (m_statistics.residentBytes > targetBytes && !m_lruList.empty()) {
+		gxapi::IPageable* resource = m_lruList.front();
+		Entry& entry = m_entries.at(resource);
+		if (entry.lastUsedFrame >= m_currentFrame) {
+			break; // The rest of the list has been used in this frame as well.
+		}
+
+		m_lruList.pop_front();
+		entry.lruPosition = m_lruList.end();
+		entry.resident = false;
+		m_statistics.residentBytes -= entry.size;
+		toEvict.push_back(resource);
+	}
+
+	m_statistics.evictionCount += toEvict.size();
+	m_statistics.lastFrameEvictions += toEvict.size();
+	return toEvict;
+}
+
+
+std::vector<gxapi::IPageable*> ResidencyTracker::SelectEvictions() {
+	return SelectEvictions(m_statistics.budget);
+}
+
+
+bool ResidencyTracker::IsResident(const gxapi::IPageable* resource) const {
+	auto it = m_entries.find(resource);
+	return it != m_entries.end() && it->second.resident;
+}
+
+
+void ResidencyTracker::BeginFrame(uint64_t frameId) {
+	assert(frameId >= m_currentFrame);
+	m_currentFrame = frameId;
+	m_statistics.lastFrameEvictions = 0;
+}
+
+
+void ResidencyTracker::AddStallTime(std::chrono::nanoseconds time) {
+	m_statistics.stallTime += time;
+}
+
+
+ResidencyTracker::Statistics ResidencyTracker::GetStatistics() const {
+	return m_statistics;
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <cstdint>
+
+
+namespace inl::gxapi {
+class IPageable;
+}
+
+
+namespace inl::gxeng {
+
+
+/// <summary>
+/// Decides which resources should be resident in GPU memory, and which ones can be evicted.
+/// </summary>
+/// <remarks>
+/// Resources are locked while the GPU may use them, and are evicted in least recently used order
+/// when the resident size exceeds the budget. A resource is considered for eviction only after it has been
+/// unlocked at least once, resources never used by the scheduler are never evicted.
+/// The tracked objects are committed resources and heaps, placed resources are tracked as their heap.
+/// The class only does the bookkeeping, the caller has to make the resources resident or evict them. Not thread safe.
+/// </remarks>
+class ResidencyTracker {
+public:
+	struct Statistics {
+		size_t budget = 0;
+		size_t residentBytes = 0; // Estimated size of resident resources.
+		size_t trackedBytes = 0; // Estimated size of all resources, resident or not.
+		size_t lastFrameEvictions = 0; // Resources evicted since the last BeginFrame.
+		uint64_t evictionCount = 0;
+		uint64_t makeResidentCount = 0; // Resources that were paged back in.
+		uint64_t makeResidentBatches = 0; // Times the caller had to make resources resident.
+		std::chrono::nanoseconds stallTime{ 0 }; // Time spent waiting for residency operations.
+	};
+
+public:
+	explicit ResidencyTracker(size_t budget = std::numeric_limits<size_t>::max());
+
+	void SetBudget(size_t bytes);
+	size_t GetBudget() const;
+
+	/// <summary> Starts tracking a newly created, resident resource. </summary>
+	/// <exception cref="std::invalid_argument"> If the resource is already tracked. </exception>
+	void Add(const gxapi::IPageable* resource, size_t size);
+	/// <summary> Stops tracking a resource that is being destroyed. Unknown resources are ignored. </summary>
+	void Remove(const gxapi::IPageable* resource);
+
+	/// <summary> Marks the resources as used by the GPU in the current frame. They won't be evicted until unlocked.
+	///		Untracked resources are ignored, they are considered always resident. </summary>
+	/// <returns> The resources that are currently evicted, and must be made resident. They are accounted as resident from now on. </returns>
+	std::vector<gxapi::IPageable*> Lock(const std::vector<gxapi::IPageable*>& resources);
+	/// <summary> Signals that the GPU has finished using the resources. Every Lock must be paired with an Unlock. </summary>
+	void Unlock(const std::vector<gxapi::IPageable*>& resources);
+	/// <summary> Undoes a Lock of the resources when the ones it returned could not be made resident.
+	///		Those are accounted as evicted again, and the next Lock returns them again. The Lock must not be unlocked. </summary>
+	void CancelLock(const std::vector<gxapi::IPageable*>& resources, const std::vector<gxapi::IPageable*>& notMadeResident);
+
+	/// <summary> Picks least recently used resources to evict until the resident size goes down to targetBytes,
+	///		or there are no more candidates. Resources used in the current frame are not picked. </summary>
+	/// <returns> The resources to evict. They are accounted as evicted from now on. </returns>
+	std::vector<gxapi::IPageable*> SelectEvictions(size_t targetBytes);
+	/// <summary> Same as SelectEvictions with the budget as target. </summary>
+	std::vector<gxapi::IPageable*> SelectEvictions();
+
+	bool IsResident(const gxapi::IPageable* resource) const;
+
+	void BeginFrame(uint64_t frameId);
+	void AddStallTime(std::chrono::nanoseconds time);
+
+	Statistics GetStatistics() const;
+private:
+	struct Entry {
+		size_t size;
+		uint64_t lastUsedFrame = 0;
+		uint32_t lockCount = 0;
+		bool resident = true;
+		bool evictable = false;
+		std::list<gxapi::IPageable*>::iterator lruPosition;
+	};
+
+	std::unordered_map<const gxapi::IPageable*, Entry> m_entries;
+	std::list<gxapi::IPageable*> m_lruList; // Resident, unlocked, evictable resources. The front is the least recently used.
+	uint64_t m_currentFrame = 0;
+
+	Statistics m_statistics;
+};
+
+
+} // namespace inl::gxeng
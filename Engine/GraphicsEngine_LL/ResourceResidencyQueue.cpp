@@ -1,13 +1,18 @@
 #include "ResourceResidencyQueue.hpp"
+#include "MemoryManager.hpp"
+#include "../GraphicsApi_LL/Exception.hpp"
 #include <BaseLibrary/ThreadName.hpp>
 
+#include <algorithm>
+
 namespace inl {
 namespace gxeng {
 
 
-ResourceResidencyQueue::ResourceResidencyQueue(std::unique_ptr<gxapi::IFence> fence) 
+ResourceResidencyQueue::ResourceResidencyQueue(std::unique_ptr<gxapi::IFence> fence, MemoryManager* memoryManager)
 	: m_fence(std::move(fence)),
-	m_fenceValue(0)
+	m_fenceValue(0),
+	m_memoryManager(memoryManager)
 {
 	m_fence->Signal(0);
 	m_runThreads = true;
@@ -62,10 +67,28 @@ void ResourceResidencyQueue::InitThreadFunc() {
 		}
 		lk.unlock();
 
+		// Make the resources of all waiting tasks resident in a single batch.
+		std::vector<MemoryObject> resources;
 		for (auto& task : workingSet) {
-			for (const MemoryObject& res : task->resources) {
-				// TODO...
+			resources.insert(resources.end(), task->resources.begin(), task->resources.end());
+		}
+		try {
+			m_memoryManager->LockResident(resources);
+		}
+		catch (gxapi::OutOfMemory&) {
+			// None of them were locked.
+			{
+				std::lock_guard<std::mutex> lkg(m_cleanMutex);
+				for (MemoryObject& resource : resources) {
+					m_failedLocks.insert(resource._GetResourcePtr());
+				}
+			}
+			if (m_failureHandler) {
+				m_failureHandler();
 			}
+		}
+
+		for (auto& task : workingSet) {
 			task->syncPoint.m_fence->Signal(task->syncPoint.m_value);
 		}
 
@@ -91,9 +114,8 @@ void ResourceResidencyQueue::CleanThreadFunc() {
 
 		for (auto& task : workingSet) {
 			task->syncPoint.m_fence->Wait(task->syncPoint.m_value);
-			for (const MemoryObject& res : task->resources) {
-				// TODO...
-			}
+			SkipFailedLocks(task->resources);
+			m_memoryManager->UnlockResident(task->resources);
 		}
 
 		workingSet.clear();
@@ -101,5 +123,24 @@ void ResourceResidencyQueue::CleanThreadFunc() {
 }
 
 
+void ResourceResidencyQueue::SkipFailedLocks(std::vector<MemoryObject>& resources) {
+	std::lock_guard<std::mutex> lkg(m_cleanMutex);
+	if (m_failedLocks.empty()) {
+		return;
+	}
+
+	// If another command list locked the same resource, it stays locked until both are cleaned.
+	auto end = std::remove_if(resources.begin(), resources.end(), [this](MemoryObject& resource) {
+		auto it = m_failedLocks.find(resource._GetResourcePtr());
+		if (it == m_failedLocks.end()) {
+			return false;
+		}
+		m_failedLocks.erase(it);
+		return true;
+	});
+	resources.erase(end, resources.end());
+}
+
+
 } // namespace gxeng
 } // namespace inl
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <mutex>
 #include <queue>
 #include <functional>
+#include <unordered_set>
 
 #include "SyncPoint.hpp"
 #include "CriticalBufferHeap.hpp"
@@ -13,6 +14,9 @@
 namespace inl {
 namespace gxeng {
 
+
+class MemoryManager;
+
 /// <summary> Manages initializing and cleanup of command lists. </summary>
 class ResourceResidencyQueue {
 	struct Task {
@@ -24,7 +28,8 @@ class ResourceResidencyQueue {
 		SyncPoint syncPoint;
 	};
 public:
-	ResourceResidencyQueue(std::unique_ptr<gxapi::IFence> fence);
+	/// <param name="memoryManager"> Makes the resources resident, and evicts them when they are no longer used. </param>
+	ResourceResidencyQueue(std::unique_ptr<gxapi::IFence> fence, MemoryManager* memoryManager);
 	~ResourceResidencyQueue();
 
 
@@ -57,6 +62,7 @@ public:
 private:
 	void InitThreadFunc();
 	void CleanThreadFunc();
+	void SkipFailedLocks(std::vector<MemoryObject>& resources);
 	
 private:
 	// Init
@@ -70,6 +76,7 @@ private:
 	std::thread m_cleanThread;
 	std::condition_variable m_cleanCv;
 	std::queue<std::unique_ptr<Task>> m_cleanQueue;
+	std::unordered_multiset<const gxapi::IResource*> m_failedLocks; // Resources that could not be locked, their next clean must not unlock them.
 
 	// Thread run flag
 	std::atomic_bool m_runThreads;
@@ -81,6 +88,8 @@ private:
 	// Event tracking
 	std::shared_ptr<gxapi::IFence> m_fence;
 	uint64_t m_fenceValue;
+
+	MemoryManager* m_memoryManager;
 };
 
 
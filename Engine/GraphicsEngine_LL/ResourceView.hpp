@@ -81,6 +81,7 @@ protected:
 
 class ConstBufferView : public ResourceViewBase<ConstBuffer> {
 public:
+	ConstBufferView() = default;
 	ConstBufferView(const VolatileConstBuffer& resource, CbvSrvUavHeap& heap);
 	ConstBufferView(const PersistentConstBuffer& resource, CbvSrvUavHeap& heap);
 	ConstBufferView(const VolatileConstBuffer& resource, gxapi::DescriptorHandle handle, gxapi::IGraphicsApi* gxapi);
@@ -4,6 +4,8 @@
 #include <utility>
 #include <cassert>
 #include <type_traits>
+#include <algorithm>
+#include <unordered_map>
 #include <GraphicsApi_LL/ICommandList.hpp>
 #include "StackDescHeap.hpp"
 #include "Binder.hpp"
@@ -13,15 +15,27 @@ namespace inl::gxeng {
 
 
 struct DescriptorTableState {
-	DescriptorTableState() : slot(0), committed(false) {}
-	DescriptorTableState(DescriptorArrayRef&& reference, int slot)
-		: reference(std::move(reference)), slot(slot), committed(false)
+	DescriptorTableState() : slot(0), committed(true), dirty(false) {}
+	DescriptorTableState(int slot, size_t numDescriptors)
+		: slot(slot), committed(true), dirty(true), bindings(numDescriptors), dirtyMask((numDescriptors + 63) / 64, 0)
 	{}
 
 	DescriptorArrayRef reference; // current place in scratch space
 	int slot; // which root signature slot it belongs to
-	bool committed; // true if modifying descriptor in sratch space would break previous draw calls
+	bool committed; // true if modifying descriptor in sratch space would break previous draw calls or cached tables
+	bool dirty; // true if bindings changed since the table was last written to scratch space
 	std::vector<gxapi::DescriptorHandle> bindings; // currently bound descriptor handle, staging heap sources
+	std::vector<uint64_t> dirtyMask; // one bit per binding that is not yet copied to the current place
+};
+
+
+/// <summary> Counts the work of keeping descriptor tables up to date in scratch space. </summary>
+struct DescriptorTableStatistics {
+	uint64_t drawCount = 0;
+	uint64_t descriptorCopyCount = 0; // Descriptors copied from staging heaps to scratch space.
+	uint64_t tableAllocationCount = 0; // Tables written to a fresh range of scratch space.
+	uint64_t tableReuseCount = 0; // Tables found in scratch space with the same content instead.
+	uint64_t redundantBindCount = 0; // Binds of the descriptor that was already bound.
 };
 
 
@@ -38,14 +52,34 @@ public:
 	RootTableManager(gxapi::IGraphicsApi* graphicsApi, CommandListT* commandList);
 	void SetBinder(Binder* binder);
 	void SetDescriptorHeap(StackDescHeap* heap);
+	/// <summary> Writes the changed bindings to scratch space, and sets the bindless table if the binder has one.
+	///		Call this before each drawcall. </summary>
+	/// <exception cref="std::bad_alloc"> If the scratch space is full. Set a new one and call again. </exception>
+	void PrepareDrawCall();
 	void CommitDrawCall();
 	void UpdateBinding(gxapi::DescriptorHandle handle, int rootSignatureSlot, int indexInTable);
+
+	const DescriptorTableStatistics& GetStatistics() const { return m_statistics; }
 private:
-	/// <summary> Updates a binding which is managed on the scratch space. </summary>
+	struct CachedTable {
+		std::vector<gxapi::DescriptorHandle> bindings;
+		DescriptorArrayRef reference;
+	};
+
+	/// <summary> Records a binding which is managed on the scratch space. It's written by <see cref="PrepareDrawCall"/>. </summary>
 	void UpdateRootTable(gxapi::DescriptorHandle, int rootSignatureSlot, int indexInTable);
 
-	/// <summary> Copies a whole scratch space table to a fresh range in scratch space. </summary>
-	void DuplicateRootTable(DescriptorTableState& table);
+	/// <summary> Brings the table in scratch space up to date with its bindings. </summary>
+	void WriteRootTable(DescriptorTableState& table);
+
+	/// <summary> Copies the bindings marked dirty to the current place of the table. </summary>
+	void CopyDirtyDescriptors(DescriptorTableState& table);
+
+	/// <summary> Finds a table with the same bindings in the current scratch space. </summary>
+	const CachedTable* FindCachedTable(const std::vector<gxapi::DescriptorHandle>& bindings, size_t hash) const;
+
+	static size_t HashBindings(const std::vector<gxapi::DescriptorHandle>& bindings);
+	static bool EqualBindings(const std::vector<gxapi::DescriptorHandle>& lhs, const std::vector<gxapi::DescriptorHandle>& rhs);
 
 	/// <summary> Get reference to root table state identified by it's root signature slot. </summary>
 	DescriptorTableState&  FindRootTable(int rootSignatureSlot);
@@ -53,16 +87,19 @@ private:
 	/// <summary> Calculates root table states based on the currently bound Binder. </summary>
 	void InitRootTables();
 
-	/// <summary> Marks all root tables committed. Call this after each drawcall. </summary>
+	/// <summary> Marks all root tables committed and remembers their content for reuse. Call this after each drawcall. </summary>
 	void CommitRootTables();
 
-	/// <summary> Copies ALL scratch space tables to a fresh range. Used after a new scratch space is bound. </summary>
+	/// <summary> Moves ALL scratch space tables to a fresh range on the next drawcall. Used after a new scratch space is bound. </summary>
 	void RenewRootTables();
 
 	void SetRootDescriptorTable(gxapi::IGraphicsCommandList* list, unsigned parameterIndex, gxapi::DescriptorHandle baseHandle);
 	void SetRootDescriptorTable(gxapi::IComputeCommandList* list, unsigned parameterIndex, gxapi::DescriptorHandle baseHandle);
 	void SetRootSignature(gxapi::IGraphicsCommandList* list, gxapi::IRootSignature* sig);
 	void SetRootSignature(gxapi::IComputeCommandList* list, gxapi::IRootSignature* sig);
+
+	/// <summary> Points the binder's bindless slot to the scratch space's copy of the table, and updates that copy. </summary>
+	void SetBindlessTable();
 protected:
 	gxapi::IGraphicsApi* m_graphicsApi;
 	CommandListT* m_commandList;
@@ -70,6 +107,13 @@ protected:
 	StackDescHeap* m_heap;
 private:
 	std::vector<DescriptorTableState> m_rootTableStates;
+	bool m_isBindlessTableSet = false; // the bindless slot is set for the current binder and scratch space
+
+	// Committed tables of the current scratch space by the hash of their bindings.
+	// Tables can't be copied from scratch space as it's shader visible, so a hit saves writing every descriptor.
+	std::unordered_multimap<size_t, CachedTable> m_tableCache;
+
+	DescriptorTableStatistics m_statistics;
 };
 
 
@@ -78,6 +122,8 @@ template <gxapi::eCommandListType Type>
 RootTableManager<Type>::RootTableManager() {
 	m_graphicsApi = nullptr;
 	m_commandList = nullptr;
+	m_binder = nullptr;
+	m_heap = nullptr;
 }
 
 
@@ -85,6 +131,8 @@ template <gxapi::eCommandListType Type>
 RootTableManager<Type>::RootTableManager(gxapi::IGraphicsApi* graphicsApi, CommandListT* commandList) {
 	m_graphicsApi = graphicsApi;
 	m_commandList = commandList;
+	m_binder = nullptr;
+	m_heap = nullptr;
 }
 
 
@@ -93,6 +141,7 @@ void RootTableManager<Type>::SetBinder(Binder* binder) {
 	m_binder = binder;
 	SetRootSignature(m_commandList, m_binder->GetRootSignature());
 	InitRootTables();
+	m_isBindlessTableSet = false;
 }
 
 
@@ -101,11 +150,26 @@ void RootTableManager<Type>::SetDescriptorHeap(StackDescHeap* heap) {
 	assert(heap != nullptr);
 	m_heap = heap;
 	RenewRootTables();
+	m_isBindlessTableSet = false;
+}
+
+
+template <gxapi::eCommandListType Type>
+void RootTableManager<Type>::PrepareDrawCall() {
+	for (auto& table : m_rootTableStates) {
+		if (table.dirty) {
+			WriteRootTable(table);
+		}
+	}
+	if (m_binder != nullptr && m_binder->GetBindlessSlot() >= 0) {
+		SetBindlessTable();
+	}
 }
 
 
 template <gxapi::eCommandListType Type>
 void RootTableManager<Type>::CommitDrawCall() {
+	++m_statistics.drawCount;
 	CommitRootTables();
 }
 
@@ -120,48 +184,113 @@ template <gxapi::eCommandListType Type>
 void RootTableManager<Type>::UpdateRootTable(gxapi::DescriptorHandle handle, int rootSignatureSlot, int indexInTable) {
 	DescriptorTableState& table = FindRootTable(rootSignatureSlot);
 
-	// if table is committed, duplicate it so that recent drawcalls won't be broken
+	if (table.bindings[indexInTable].cpuAddress == handle.cpuAddress) {
+		++m_statistics.redundantBindCount;
+		return;
+	}
+
+	// only record the change, the table is written once before the next drawcall
+	table.bindings[indexInTable] = handle;
+	table.dirtyMask[indexInTable / 64] |= uint64_t(1) << (indexInTable % 64);
+	table.dirty = true;
+}
+
+
+template <gxapi::eCommandListType Type>
+void RootTableManager<Type>::WriteRootTable(DescriptorTableState& table) {
+	// if table is committed, move it so that recent drawcalls won't be broken
 	if (table.committed) {
-		// update handle in advance so that duplicate will copy it instead and we save time
-		table.bindings[indexInTable] = handle;
-		DuplicateRootTable(table);
+		size_t hash = HashBindings(table.bindings);
+		if (const CachedTable* cached = FindCachedTable(table.bindings, hash)) {
+			table.reference = cached->reference;
+			std::fill(table.dirtyMask.begin(), table.dirtyMask.end(), 0);
+			++m_statistics.tableReuseCount;
+		}
+		else {
+			// the old place can't be the source of a copy, so every binding has to be written to the new one
+			table.reference = m_heap->Allocate((uint32_t)table.bindings.size());
+			table.committed = false;
+			std::fill(table.dirtyMask.begin(), table.dirtyMask.end(), ~uint64_t(0));
+			CopyDirtyDescriptors(table);
+			++m_statistics.tableAllocationCount;
+		}
 
 		// update table root parameters
-		SetRootDescriptorTable(m_commandList, rootSignatureSlot, table.reference.Get(0));
+		SetRootDescriptorTable(m_commandList, table.slot, table.reference.Get(0));
 	}
-	// just update the binding
+	// just update the changed bindings
 	else {
-		table.bindings[indexInTable] = handle;
-		m_graphicsApi->CopyDescriptors(handle, table.reference.Get(indexInTable), 1, gxapi::eDescriptorHeapType::CBV_SRV_UAV);
+		CopyDirtyDescriptors(table);
 	}
+	table.dirty = false;
 }
 
-template <gxapi::eCommandListType Type>
-void RootTableManager<Type>::DuplicateRootTable(DescriptorTableState& table) {
-	uint32_t numDescriptors = (uint32_t)table.bindings.size();
-
-	// allocate new space on scratch space
-	DescriptorArrayRef space = m_heap->Allocate(numDescriptors);
 
-	// copy old descriptors to new space
-	std::vector<gxapi::DescriptorHandle> sourceDescHandles(numDescriptors);
-	std::vector<uint32_t> sourceRangeSizes(numDescriptors, 1);
-	for (size_t i = 0; i < numDescriptors; ++i) {
-		sourceDescHandles[i] = table.bindings[i];
+template <gxapi::eCommandListType Type>
+void RootTableManager<Type>::CopyDirtyDescriptors(DescriptorTableState& table) {
+	std::vector<gxapi::DescriptorHandle> sourceDescHandles;
+	std::vector<gxapi::DescriptorHandle> destDescHandles;
+
+	for (size_t word = 0; word < table.dirtyMask.size(); ++word) {
+		uint64_t mask = table.dirtyMask[word];
+		table.dirtyMask[word] = 0;
+		for (size_t bit = 0; mask != 0; ++bit, mask >>= 1) {
+			size_t index = word * 64 + bit;
+			// unbound slots are left as they are, shaders must not access them
+			if ((mask & 1) == 0 || index >= table.bindings.size() || table.bindings[index].cpuAddress == nullptr) {
+				continue;
+			}
+			sourceDescHandles.push_back(table.bindings[index]);
+			destDescHandles.push_back(table.reference.Get((uint32_t)index));
+		}
 	}
 
-	gxapi::DescriptorHandle destDescHandle = space.Get(0);
+	if (sourceDescHandles.empty()) {
+		return;
+	}
 
+	// a single call for all the changed descriptors, one descriptor per range
+	std::vector<uint32_t> rangeSizes(sourceDescHandles.size(), 1);
 	m_graphicsApi->CopyDescriptors(
-		sourceDescHandles.size(), sourceDescHandles.data(), sourceRangeSizes.data(),
-		1, &destDescHandle, &numDescriptors,
+		sourceDescHandles.size(), sourceDescHandles.data(), rangeSizes.data(),
+		destDescHandles.size(), destDescHandles.data(), rangeSizes.data(),
 		gxapi::eDescriptorHeapType::CBV_SRV_UAV);
 
-	// update table parameters
-	table.committed = false;
-	table.reference = space;
+	m_statistics.descriptorCopyCount += sourceDescHandles.size();
 }
 
+
+template <gxapi::eCommandListType Type>
+auto RootTableManager<Type>::FindCachedTable(const std::vector<gxapi::DescriptorHandle>& bindings, size_t hash) const -> const CachedTable* {
+	auto range = m_tableCache.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (EqualBindings(it->second.bindings, bindings)) {
+			return &it->second;
+		}
+	}
+	return nullptr;
+}
+
+
+template <gxapi::eCommandListType Type>
+size_t RootTableManager<Type>::HashBindings(const std::vector<gxapi::DescriptorHandle>& bindings) {
+	// FNV-1a over the source addresses
+	uint64_t hash = 14695981039346656037ull;
+	for (const auto& binding : bindings) {
+		hash ^= (uint64_t)(uintptr_t)binding.cpuAddress;
+		hash *= 1099511628211ull;
+	}
+	return (size_t)hash;
+}
+
+
+template <gxapi::eCommandListType Type>
+bool RootTableManager<Type>::EqualBindings(const std::vector<gxapi::DescriptorHandle>& lhs, const std::vector<gxapi::DescriptorHandle>& rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+					  [](const gxapi::DescriptorHandle& a, const gxapi::DescriptorHandle& b) { return a.cpuAddress == b.cpuAddress; });
+}
+
+
 template <gxapi::eCommandListType Type>
 auto RootTableManager<Type>::FindRootTable(int rootSignatureSlot) -> DescriptorTableState& {
 	// root table states are already sorted by init
@@ -184,6 +313,10 @@ void RootTableManager<Type>::InitRootTables() {
 
 	for (size_t slot = 0; slot < desc.rootParameters.size(); slot++) {
 		auto& param = desc.rootParameters[slot];
+		// the bindless table is not managed on the scratch space
+		if ((int)slot == m_binder->GetBindlessSlot()) {
+			continue;
+		}
 		if (param.type == gxapi::RootParameterDesc::DESCRIPTOR_TABLE) {
 			auto& ranges = param.As<gxapi::RootParameterDesc::DESCRIPTOR_TABLE>().ranges;
 
@@ -215,10 +348,8 @@ void RootTableManager<Type>::InitRootTables() {
 			}
 			assert(descriptorCountTotal == largestIndex);
 
-			// add record for this table
-			m_rootTableStates.push_back({ m_heap->Allocate((uint32_t)descriptorCountTotal), (int)slot });
-			SetRootDescriptorTable(m_commandList, m_rootTableStates.back().slot, m_rootTableStates.back().reference.Get(0));
-			m_rootTableStates.back().bindings.resize(descriptorCountTotal);
+			// add record for this table, it's placed in scratch space before the first drawcall
+			m_rootTableStates.push_back({ (int)slot, descriptorCountTotal });
 		}
 	}
 }
@@ -226,14 +357,34 @@ void RootTableManager<Type>::InitRootTables() {
 template <gxapi::eCommandListType Type>
 void RootTableManager<Type>::CommitRootTables() {
 	for (auto& table : m_rootTableStates) {
-		table.committed = true;
+		if (!table.committed) {
+			// the range won't change anymore, tables with the same bindings can point here
+			size_t hash = HashBindings(table.bindings);
+			if (!FindCachedTable(table.bindings, hash)) {
+				m_tableCache.insert({ hash, CachedTable{ table.bindings, table.reference } });
+			}
+			table.committed = true;
+		}
 	}
 }
 
 template <gxapi::eCommandListType Type>
 void RootTableManager<Type>::RenewRootTables() {
+	// cached ranges belong to the previous scratch space
+	m_tableCache.clear();
 	for (auto& table : m_rootTableStates) {
-		DuplicateRootTable(table);
+		table.committed = true;
+		table.dirty = true;
+	}
+}
+
+template <gxapi::eCommandListType Type>
+void RootTableManager<Type>::SetBindlessTable() {
+	// textures may have been added while recording, descriptors are only read when the GPU executes the list
+	m_heap->UpdateBindlessTable();
+	if (!m_isBindlessTableSet) {
+		SetRootDescriptorTable(m_commandList, m_binder->GetBindlessSlot(), m_heap->GetBindlessTable());
+		m_isBindlessTableSet = true;
 	}
 }
 
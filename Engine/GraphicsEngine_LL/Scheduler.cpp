@@ -2,6 +2,7 @@
 
 #include <GraphicsApi_LL/IGraphicsApi.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <iostream> // only for debugging
 
@@ -9,6 +10,36 @@ namespace inl {
 namespace gxeng {
 
 
+// Decrements the pending upload counters of the destinations when destroyed,
+// so that render nodes can start using them.
+struct PendingUploadRelease {
+	PendingUploadRelease(std::vector<MemoryObject> destinations) : destinations(std::move(destinations)) {}
+	PendingUploadRelease(PendingUploadRelease&&) = default;
+	~PendingUploadRelease() {
+		for (auto& destination : destinations) {
+			destination._RemovePendingUpload();
+		}
+	}
+	std::vector<MemoryObject> destinations;
+};
+
+
+// Tells the upload manager that the copies of the background uploads of a frame are done when destroyed.
+struct BackgroundUploadsComplete {
+	BackgroundUploadsComplete(UploadManager* uploadManager, uint64_t frameId) : uploadManager(uploadManager), frameId(frameId) {}
+	BackgroundUploadsComplete(BackgroundUploadsComplete&& other) : uploadManager(other.uploadManager), frameId(other.frameId) {
+		other.uploadManager = nullptr;
+	}
+	~BackgroundUploadsComplete() {
+		if (uploadManager) {
+			uploadManager->_OnBackgroundUploadsComplete(frameId);
+		}
+	}
+	UploadManager* uploadManager;
+	uint64_t frameId;
+};
+
+
 Scheduler::Scheduler()
 {}
 
@@ -30,14 +61,51 @@ void Scheduler::Execute(FrameContext context) {
 
 	auto tasks = MakeSchedule(taskGraph, taskFunctionMap);
 
+	// Uploads to resources that are in COMMON state go through the copy queue, where the
+	// state is promoted implicitly, so the copies overlap with rendering. The rest, and every upload
+	// when there is no copy queue, are recorded on the graphics queue at the start of the frame.
+	// Destinations of background copies stay pending until the copy queue is done with them,
+	// render nodes must not read resources that have pending uploads.
+	std::vector<UploadManager::UploadDescription> visibleCopyUploads;
+	std::vector<UploadManager::UploadDescription> backgroundCopyUploads;
+	std::vector<UploadManager::UploadDescription> graphicsUploads;
+	std::vector<LinearBuffer> stagingBuffers;
+	std::vector<LinearBuffer> backgroundStagingBuffers;
+	for (const auto& upload : *context.uploadRequests) {
+		bool isBackground = false;
+		if (context.copyCommandQueue != nullptr && upload.destination.ReadState(0) == gxapi::eResourceState::COMMON) {
+			isBackground = upload.priority != UploadManager::Priority::VISIBLE;
+			auto& batch = isBackground ? backgroundCopyUploads : visibleCopyUploads;
+			batch.push_back(upload);
+		}
+		else {
+			graphicsUploads.push_back(upload);
+		}
+		auto& buffers = isBackground ? backgroundStagingBuffers : stagingBuffers;
+		if (std::find(buffers.begin(), buffers.end(), upload.source) == buffers.end()) {
+			buffers.push_back(upload.source);
+		}
+	}
+
+	// Visible uploads must finish before the frame starts rendering.
+	if (!visibleCopyUploads.empty()) {
+		SyncPoint visibleUploadsDone = EnqueueCopyQueueUploads(visibleCopyUploads, false, context);
+		context.commandQueue->Wait(visibleUploadsDone);
+	}
+	if (!backgroundCopyUploads.empty()) {
+		EnqueueCopyQueueUploads(backgroundCopyUploads, true, context);
+	}
+
 	// Inject copy task to the start.
-	tasks.insert(tasks.begin(),[context](ExecutionContext ctx){
-		auto cmdList = ctx.GetGraphicsCommandList();
-		UploadTask(cmdList, *context.uploadRequests);
-		ExecutionResult res;
-		res.AddCommandList(std::move(cmdList));
-		return res;
-	});
+	if (!graphicsUploads.empty()) {
+		tasks.insert(tasks.begin(), [&graphicsUploads](ExecutionContext ctx) {
+			auto cmdList = ctx.GetGraphicsCommandList();
+			UploadTask(cmdList, graphicsUploads);
+			ExecutionResult res;
+			res.AddCommandList(std::move(cmdList));
+			return res;
+		});
+	}
 
 	// Execute the tasks.
 	try {
@@ -79,11 +147,15 @@ void Scheduler::Execute(FrameContext context) {
 				}
 
 				// Enqueue actual command list.
+				// Resources read through views and vertex buffers are locked for residency as well.
 				std::vector<MemoryObject> usedResourceList;
-				usedResourceList.reserve(dec.usedResources.size());
+				usedResourceList.reserve(dec.usedResources.size() + dec.additionalResources.size());
 				for (const auto& v : dec.usedResources) {
 					usedResourceList.push_back(v.resource);
 				}
+				for (auto& resource : dec.additionalResources) {
+					usedResourceList.push_back(std::move(resource));
+				}
 
 				dec.commandList->Close();
 
@@ -140,18 +212,17 @@ void Scheduler::Execute(FrameContext context) {
 			context.log->Event(std::string("Fatal pipeline error, could not render error screen: ") + ex.what());
 		}
 	}
-}
-
 
-void Scheduler::MakeResident(std::vector<MemoryObject*> usedResources) {
+	// Dedicated staging resources must live until the copies that read them have finished.
+	context.residencyQueue->EnqueueClean(context.commandQueue->Signal(), {}, std::move(stagingBuffers));
 
+	// Background uploads are not waited for by the graphics queue, they may run past the end of the frame.
+	// Their staging memory is recycled once the copy queue has finished them, independently of the frames.
+	CommandQueue& backgroundQueue = context.copyCommandQueue != nullptr ? *context.copyCommandQueue : *context.commandQueue;
+	context.residencyQueue->EnqueueClean(backgroundQueue.Signal(), {}, std::move(backgroundStagingBuffers), BackgroundUploadsComplete(context.uploadManager, context.frame));
 }
 
 
-void Scheduler::Evict(std::vector<MemoryObject*> usedResources) {
-
-}
-
 std::vector<ElementaryTask> Scheduler::MakeSchedule(const lemon::ListDigraph& taskGraph,
 												const lemon::ListDigraph::NodeMap<ElementaryTask>& taskFunctionMap
 												/*std::vector<CommandQueue*> queues*/)
@@ -196,12 +267,15 @@ void Scheduler::EnqueueCommandList(CommandQueue& commandQueue,
 	gxapi::ICommandList* execLists[] = {
 		commandList.get(),
 	};
-	context.commandQueue->Wait(residentPoint);
-	context.commandQueue->ExecuteCommandLists(1, execLists);
-	SyncPoint completionPoint = context.commandQueue->Signal();
+	commandQueue.Wait(residentPoint);
+	commandQueue.ExecuteCommandLists(1, execLists);
+	SyncPoint completionPoint = commandQueue.Signal();
+
+	// The allocator is reset when it's requested again after the command list finished.
+	CommandAllocatorPool::RecycleAfter(std::move(commandAllocator), completionPoint);
 
 	// Enqueue CPU task to clean up resources after command list finished.
-	context.residencyQueue->EnqueueClean(completionPoint, std::move(usedResources), std::move(commandAllocator), std::move(scratchSpaces));
+	context.residencyQueue->EnqueueClean(completionPoint, std::move(usedResources), std::move(scratchSpaces));
 }
 
 
@@ -276,24 +350,73 @@ void Scheduler::RenderFailureScreen(FrameContext context) {
 
 void Scheduler::UploadTask(CopyCommandList& commandList, const std::vector<UploadManager::UploadDescription>& uploads) {
 	for (auto& request : uploads) {
-		// Init copy parameters
-		auto& source = request.source;
-		auto& destination = const_cast<MemoryObject&>(request.destination);
-
 		// Set destination resource state
+		auto& destination = const_cast<MemoryObject&>(request.destination);
 		commandList.SetResourceState(destination, 0, gxapi::eResourceState::COPY_DEST);
 
-		auto destType = request.destType;
+		RecordUpload(commandList, request);
 
-		if (destType == UploadManager::DestType::BUFFER) {
-			auto& dstBuffer = static_cast<LinearBuffer&>(destination);
-			commandList.CopyBuffer(dstBuffer, request.dstOffsetX, source, 0, dstBuffer.GetSize());
-		}
-		else if (destType == UploadManager::DestType::TEXTURE_2D) {
-			auto& dstTexture = static_cast<Texture2D&>(destination);
-			commandList.CopyTexture(dstTexture, source, SubTexture2D(0, 0, mathfu::Vector<intptr_t, 2>((intptr_t)request.dstOffsetX, (intptr_t)request.dstOffsetY)), request.textureBufferDesc);
+		// Commands on the graphics queue are ordered, so the render nodes can use the resource right away.
+		destination._RemovePendingUpload();
+	}
+}
+
+
+void Scheduler::RecordUpload(CopyCommandList& commandList, const UploadManager::UploadDescription& request) {
+	// Init copy parameters
+	auto& source = request.source;
+	auto& destination = const_cast<MemoryObject&>(request.destination);
+
+	auto destType = request.destType;
+
+	if (destType == UploadManager::DestType::BUFFER) {
+		auto& dstBuffer = static_cast<LinearBuffer&>(destination);
+		commandList.CopyBuffer(dstBuffer, request.dstOffsetX, source, request.srcOffset, request.numBytes);
+	}
+	else if (destType == UploadManager::DestType::TEXTURE_2D) {
+		auto& dstTexture = static_cast<Texture2D&>(destination);
+		commandList.CopyTexture(dstTexture, source, SubTexture2D(request.dstMipLevel, 0, mathfu::Vector<intptr_t, 2>((intptr_t)request.dstOffsetX, (intptr_t)request.dstOffsetY)), request.textureBufferDesc);
+	}
+}
+
+
+SyncPoint Scheduler::EnqueueCopyQueueUploads(const std::vector<UploadManager::UploadDescription>& uploads, bool releaseOnCompletion, const FrameContext& context) {
+	assert(context.copyCommandQueue != nullptr);
+
+	// No barriers are recorded: the destinations are in COMMON state, which is promoted to COPY_DEST
+	// by the first copy, and decays back to COMMON when the command list finishes on the copy queue.
+	CopyCommandList commandList(context.gxApi, *context.commandAllocatorPool, *context.scratchSpacePool);
+	std::vector<MemoryObject> destinations;
+	for (auto& request : uploads) {
+		RecordUpload(commandList, request);
+		destinations.push_back(request.destination);
+	}
+
+	auto dec = static_cast<BasicCommandList&>(commandList).Decompose();
+	dec.commandList->Close();
+
+	SyncPoint residentPoint = context.residencyQueue->EnqueueInit(destinations);
+
+	gxapi::ICommandList* execLists[] = {
+		dec.commandList.get(),
+	};
+	context.copyCommandQueue->Wait(residentPoint);
+	context.copyCommandQueue->ExecuteCommandLists(1, execLists);
+	SyncPoint completionPoint = context.copyCommandQueue->Signal();
+	CommandAllocatorPool::RecycleAfter(std::move(dec.commandAllocator), completionPoint);
+
+	if (releaseOnCompletion) {
+		context.residencyQueue->EnqueueClean(completionPoint, destinations, std::move(dec.scratchSpaces), PendingUploadRelease(destinations));
+	}
+	else {
+		// The graphics queue waits for the copies before rendering anything, so the render nodes can use the resources right away.
+		for (auto& destination : destinations) {
+			destination._RemovePendingUpload();
 		}
+		context.residencyQueue->EnqueueClean(completionPoint, destinations, std::move(dec.scratchSpaces));
 	}
+
+	return completionPoint;
 }
 
 
@@ -32,10 +32,14 @@ protected:
 	};
 
 
-	static void MakeResident(std::vector<MemoryObject*> usedResources);
-	static void Evict(std::vector<MemoryObject*> usedResources);
-
 	static void UploadTask(CopyCommandList& commandList, const std::vector<UploadManager::UploadDescription>& uploads);
+	static void RecordUpload(CopyCommandList& commandList, const UploadManager::UploadDescription& upload);
+
+	/// <summary> Submits the uploads to the copy queue. </summary>
+	/// <param name="releaseOnCompletion"> If true, the destinations are shown to the render nodes only
+	///		after the copy queue has finished, otherwise right away. </param>
+	/// <returns> The point the graphics queue must wait for before touching the destinations. </returns>
+	static SyncPoint EnqueueCopyQueueUploads(const std::vector<UploadManager::UploadDescription>& uploads, bool releaseOnCompletion, const FrameContext& context);
 
 	static std::vector<ElementaryTask> MakeSchedule(const lemon::ListDigraph& taskGraph,
 													const lemon::ListDigraph::NodeMap<ElementaryTask>& taskFunctionMap
@@ -5,8 +5,8 @@
 namespace inl {
 namespace gxeng {
 
-ScratchSpacePool::ScratchSpacePool(gxapi::IGraphicsApi* gxApi, gxapi::eDescriptorHeapType type) 
-	: m_gxApi(gxApi), m_type(type)
+ScratchSpacePool::ScratchSpacePool(gxapi::IGraphicsApi* gxApi, gxapi::eDescriptorHeapType type, BindlessHeap* bindlessHeap) 
+	: m_gxApi(gxApi), m_type(type), m_bindlessHeap(bindlessHeap)
 {}
 
 
@@ -30,7 +30,7 @@ auto ScratchSpacePool::RequestScratchSpace() -> UniquePtr {
 		return UniquePtr{ m_pool[index].get(), Deleter{this} };
 	}
 	else {
-		std::unique_ptr<StackDescHeap> ptr(new StackDescHeap{ m_gxApi, m_type, 1000 });
+		std::unique_ptr<StackDescHeap> ptr(new StackDescHeap{ m_gxApi, m_type, 1000, m_bindlessHeap });
 		m_addressToIndex[ptr.get()] = index;
 		m_pool[index] = std::move(ptr);
 		return UniquePtr{ m_pool[index].get(), Deleter{this} };
@@ -28,7 +28,8 @@ public:
 
 	using UniquePtr = std::unique_ptr<StackDescHeap, Deleter>;
 public:
-	ScratchSpacePool(gxapi::IGraphicsApi* gxApi, gxapi::eDescriptorHeapType type);
+	/// <param name="bindlessHeap"> Scratch spaces hold a copy of this table if not null. </param>
+	ScratchSpacePool(gxapi::IGraphicsApi* gxApi, gxapi::eDescriptorHeapType type, BindlessHeap* bindlessHeap = nullptr);
 	ScratchSpacePool(const ScratchSpacePool&) = delete;
 	ScratchSpacePool(ScratchSpacePool&&) = default;
 	ScratchSpacePool& operator=(const ScratchSpacePool&) = delete;
@@ -41,6 +42,7 @@ private:
 	gxapi::eDescriptorHeapType m_type;
 	exc::SlabAllocatorEngine m_allocator;
 	gxapi::IGraphicsApi* m_gxApi;
+	BindlessHeap* m_bindlessHeap;
 	std::map<StackDescHeap*, size_t> m_addressToIndex;
 
 	std::mutex m_mutex;
@@ -0,0 +1,275 @@
+#include "ShaderCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+
+namespace inl {
+namespace gxeng {
+
+
+static constexpr char PackMagic[8] = { 'I', 'N', 'L', 'S', 'H', 'P', 'K', '\0' };
+static constexpr uint32_t PackVersion = 1;
+
+
+static inline uint64_t RotateLeft(uint64_t value, int shift) {
+	return (value << shift) | (value >> (64 - shift));
+}
+
+static inline uint64_t Avalanche(uint64_t value) {
+	value ^= value >> 30;
+	value *= 0xBF58476D1CE4E5B9ull;
+	value ^= value >> 27;
+	value *= 0x94D049BB133111EBull;
+	value ^= value >> 31;
+	return value;
+}
+
+
+ShaderCache::KeyBuilder& ShaderCache::KeyBuilder::Add(const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	auto Mix = [this](uint64_t word) {
+		m_low = RotateLeft(m_low ^ (word * 0x87C37B91114253D5ull), 31) * 0x4CF5AD432745937Full;
+		m_high = RotateLeft(m_high ^ (word * 0x9E3779B97F4A7C15ull), 29) * 0xC2B2AE3D27D4EB4Full;
+	};
+
+	size_t index = 0;
+	for (; index + 8 <= size; index += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + index, 8);
+		Mix(word);
+	}
+
+	// The remaining bytes share a word with the size, so that consecutive Adds can't be confused.
+	uint64_t tail = 0;
+	std::memcpy(&tail, bytes + index, size - index);
+	Mix(tail);
+	Mix(uint64_t(size));
+
+	return *this;
+}
+
+
+ShaderCache::Key ShaderCache::KeyBuilder::Finish() const {
+	Key key;
+	key.low = Avalanche(m_low ^ RotateLeft(m_high, 17));
+	key.high = Avalanche(m_high ^ RotateLeft(m_low, 41));
+	return key;
+}
+
+
+
+ShaderCache::ShaderCache(std::string packPath, const std::string& compilerVersion)
+	: m_packPath(std::move(packPath)), m_hits(0), m_misses(0)
+{
+	KeyBuilder compilerKey;
+	compilerKey.Add(compilerVersion);
+	m_compilerHash = compilerKey.Finish().low;
+
+	m_generation = OpenPack() + 1;
+}
+
+
+ShaderCache::~ShaderCache() {
+	Flush();
+}
+
+
+bool ShaderCache::Find(const Key& key, std::vector<uint8_t>& binary) const {
+	// Packed entries are immutable until the next flush, no need to lock.
+	const PackEntry* entry = FindPacked(key);
+	if (entry != nullptr) {
+		m_packedUsed[entry - m_packedEntries].store(true, std::memory_order_relaxed);
+		const uint8_t* data = m_pack.Data() + entry->offset;
+		binary.assign(data, data + entry->size);
+		++m_hits;
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(m_newMutex);
+	auto it = m_newEntries.find(key);
+	if (it != m_newEntries.end()) {
+		binary = it->second;
+		++m_hits;
+		return true;
+	}
+
+	++m_misses;
+	return false;
+}
+
+
+void ShaderCache::Store(const Key& key, std::vector<uint8_t> binary) {
+	std::lock_guard<std::mutex> lock(m_newMutex);
+	m_newEntries[key] = std::move(binary);
+}
+
+
+bool ShaderCache::Flush() {
+	// Collect what to keep.
+	struct OutputEntry {
+		PackEntry entry;
+		const uint8_t* data;
+	};
+	std::vector<OutputEntry> output;
+
+	bool anyDropped = false;
+	for (size_t i = 0; i < m_packedEntryCount; ++i) {
+		PackEntry entry = m_packedEntries[i];
+		if (m_packedUsed[i].load(std::memory_order_relaxed)) {
+			entry.lastUsedGeneration = m_generation;
+		}
+		if (m_generation - entry.lastUsedGeneration > MaxUnusedGenerations || m_newEntries.count(entry.key) > 0) {
+			anyDropped = true;
+			continue;
+		}
+		output.push_back({ entry, m_pack.Data() + entry.offset });
+	}
+	for (auto& newEntry : m_newEntries) {
+		PackEntry entry;
+		entry.key = newEntry.first;
+		entry.size = newEntry.second.size();
+		entry.lastUsedGeneration = m_generation;
+		entry.reserved = 0;
+		output.push_back({ entry, newEntry.second.data() });
+	}
+
+	bool anyUsed = false;
+	for (size_t i = 0; i < m_packedEntryCount && !anyUsed; ++i) {
+		anyUsed = m_packedUsed[i].load(std::memory_order_relaxed);
+	}
+	if (m_newEntries.empty() && !anyDropped && !anyUsed) {
+		return true; // Nothing to update.
+	}
+
+	std::sort(output.begin(), output.end(), [](const OutputEntry& lhs, const OutputEntry& rhs) {
+		return lhs.entry.key < rhs.entry.key;
+	});
+
+	PackHeader header;
+	std::memcpy(header.magic, PackMagic, sizeof(PackMagic));
+	header.version = PackVersion;
+	header.generation = m_generation;
+	header.compilerHash = m_compilerHash;
+	header.entryCount = output.size();
+
+	uint64_t offset = sizeof(PackHeader) + output.size() * sizeof(PackEntry);
+	for (auto& item : output) {
+		item.entry.offset = offset;
+		offset += item.entry.size;
+	}
+
+	// Write a new file next to the old one, then swap them, so that a crash can't leave a half-written pack.
+	std::string tempPath = m_packPath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto& item : output) {
+			file.write(reinterpret_cast<const char*>(&item.entry), sizeof(item.entry));
+		}
+		for (const auto& item : output) {
+			file.write(reinterpret_cast<const char*>(item.data), item.entry.size);
+		}
+		if (!file.good()) {
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	m_pack.Close();
+	std::remove(m_packPath.c_str());
+	bool replaced = std::rename(tempPath.c_str(), m_packPath.c_str()) == 0;
+
+	m_newEntries.clear();
+	OpenPack();
+
+	// Entries used before the flush are already marked in the new pack.
+	return replaced;
+}
+
+
+ShaderCache::Statistics ShaderCache::GetStatistics() const {
+	std::lock_guard<std::mutex> lock(m_newMutex);
+
+	Statistics statistics;
+	statistics.packedEntries = m_packedEntryCount;
+	statistics.newEntries = m_newEntries.size();
+	statistics.hits = m_hits;
+	statistics.misses = m_misses;
+	return statistics;
+}
+
+
+uint32_t ShaderCache::OpenPack() {
+	m_pack.Close();
+	m_packedEntries = nullptr;
+	m_packedEntryCount = 0;
+	m_packedUsed.reset();
+
+	try {
+		m_pack = exc::MemoryMappedFile(m_packPath);
+	}
+	catch (std::runtime_error&) {
+		return 0; // No pack yet.
+	}
+
+	// Validate the whole file now, so that lookups don't have to.
+	auto Invalidate = [this] {
+		m_pack.Close();
+		return 0u;
+	};
+
+	if (m_pack.Size() < sizeof(PackHeader)) {
+		return Invalidate();
+	}
+	PackHeader header;
+	std::memcpy(&header, m_pack.Data(), sizeof(header));
+	if (std::memcmp(header.magic, PackMagic, sizeof(PackMagic)) != 0 || header.version != PackVersion) {
+		return Invalidate();
+	}
+	if (header.compilerHash != m_compilerHash) {
+		return Invalidate();
+	}
+	if (header.entryCount > (m_pack.Size() - sizeof(PackHeader)) / sizeof(PackEntry)) {
+		return Invalidate();
+	}
+
+	const PackEntry* entries = reinterpret_cast<const PackEntry*>(m_pack.Data() + sizeof(PackHeader));
+	for (size_t i = 0; i < header.entryCount; ++i) {
+		bool inBounds = entries[i].offset <= m_pack.Size() && entries[i].size <= m_pack.Size() - entries[i].offset;
+		bool sorted = i == 0 || entries[i - 1].key < entries[i].key;
+		if (!inBounds || !sorted) {
+			return Invalidate();
+		}
+	}
+
+	m_packedEntries = entries;
+	m_packedEntryCount = (size_t)header.entryCount;
+	m_packedUsed = std::make_unique<std::atomic<bool>[]>(m_packedEntryCount);
+	for (size_t i = 0; i < m_packedEntryCount; ++i) {
+		m_packedUsed[i].store(false, std::memory_order_relaxed);
+	}
+
+	return header.generation;
+}
+
+
+auto ShaderCache::FindPacked(const Key& key) const -> const PackEntry* {
+	const PackEntry* end = m_packedEntries + m_packedEntryCount;
+	const PackEntry* it = std::lower_bound(m_packedEntries, end, key, [](const PackEntry& entry, const Key& key) {
+		return entry.key < key;
+	});
+	return it != end && it->key == key ? it : nullptr;
+}
+
+
+} // namespace gxeng
+} // namespace inl
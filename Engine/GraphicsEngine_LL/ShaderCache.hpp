@@ -0,0 +1,127 @@
+#pragma once
+
+#include <BaseLibrary/Platform/MemoryMappedFile.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace inl {
+namespace gxeng {
+
+
+/// <summary>
+/// Content addressed store of compiled shader binaries, persisted in a single pack file between runs.
+/// </summary>
+/// <remarks>
+/// The key must be built from everything that affects the binary: the source code with all its includes,
+/// the macros, the compile flags and the entry point. A changed source produces a different key,
+/// so stale binaries are never returned, and are dropped from the pack after going unused for a few runs.
+/// A pack written by a different compiler version is discarded as a whole.
+///
+/// Looking up binaries that were loaded from the pack does not lock, only binaries stored during this run do.
+/// </remarks>
+class ShaderCache {
+public:
+	struct Key {
+		uint64_t low;
+		uint64_t high;
+		bool operator==(const Key& rhs) const { return low == rhs.low && high == rhs.high; }
+		bool operator<(const Key& rhs) const { return high < rhs.high || (high == rhs.high && low < rhs.low); }
+	};
+
+	/// <summary> Hashes arbitrary data into a 128 bit key. </summary>
+	class KeyBuilder {
+	public:
+		KeyBuilder& Add(const void* data, size_t size);
+		KeyBuilder& Add(const std::string& str) { return Add(str.data(), str.size()); }
+		KeyBuilder& Add(uint64_t value) { return Add(&value, sizeof(value)); }
+		Key Finish() const;
+	private:
+		uint64_t m_low = 0x243F6A8885A308D3ull;
+		uint64_t m_high = 0x13198A2E03707344ull;
+	};
+
+	struct Statistics {
+		size_t packedEntries = 0; // Loaded from the pack file.
+		size_t newEntries = 0; // Stored since the last flush.
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+
+	/// <summary> Entries unused for this many runs are not written back to the pack. </summary>
+	static constexpr uint32_t MaxUnusedGenerations = 8;
+
+public:
+	/// <summary> Opens the pack file, or starts empty if it is missing, corrupt or made by another compiler. </summary>
+	/// <param name="compilerVersion"> Identifies the shader compiler, binaries of other compilers are discarded. </param>
+	ShaderCache(std::string packPath, const std::string& compilerVersion);
+	/// <summary> Flushes the new entries to the pack file. </summary>
+	~ShaderCache();
+
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+
+	/// <summary> Looks up a binary. </summary>
+	/// <returns> True if found, in which case binary is filled. </returns>
+	/// <remarks> This method is thread-safe. </remarks>
+	bool Find(const Key& key, std::vector<uint8_t>& binary) const;
+
+	/// <summary> Adds a new binary. It is written to the pack file on the next flush. </summary>
+	/// <remarks> This method is thread-safe. </remarks>
+	void Store(const Key& key, std::vector<uint8_t> binary);
+
+	/// <summary> Rewrites the pack file with the used and new entries. </summary>
+	/// <returns> False if the file could not be written. The cache remains usable either way. </returns>
+	/// <remarks> This method is NOT thread-safe, no other methods may be called concurrently. </remarks>
+	bool Flush();
+
+	Statistics GetStatistics() const;
+private:
+	struct PackHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t generation;
+		uint64_t compilerHash;
+		uint64_t entryCount;
+	};
+	struct PackEntry {
+		Key key;
+		uint64_t offset; // From the start of the file.
+		uint64_t size;
+		uint32_t lastUsedGeneration;
+		uint32_t reserved;
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const { return size_t(key.low); }
+	};
+
+	/// <summary> Maps the pack file and validates it. Leaves the pack empty if invalid. </summary>
+	/// <returns> The generation stored in the pack, or 0. </returns>
+	uint32_t OpenPack();
+	const PackEntry* FindPacked(const Key& key) const;
+private:
+	std::string m_packPath;
+	uint64_t m_compilerHash;
+	uint32_t m_generation; // Increased every run.
+
+	exc::MemoryMappedFile m_pack;
+	const PackEntry* m_packedEntries = nullptr; // Sorted by key, points into the mapped file.
+	size_t m_packedEntryCount = 0;
+	std::unique_ptr<std::atomic<bool>[]> m_packedUsed; // Which packed entries were hit in this run.
+
+	mutable std::mutex m_newMutex;
+	std::unordered_map<Key, std::vector<uint8_t>, KeyHash> m_newEntries;
+
+	mutable std::atomic<uint64_t> m_hits;
+	mutable std::atomic<uint64_t> m_misses;
+};
+
+
+} // namespace gxeng
+} // namespace inl
@@ -75,7 +75,7 @@ const ShaderProgram& ShaderManager::CreateShader(const std::string& name, Shader
 	// shader does not exist
 	else {
 		// insert new entry for shader
-		auto ins = m_shaders.insert({ name, std::make_unique<ShaderStore>() });
+		auto ins = m_shaders.insert({ shaderId, std::make_unique<ShaderStore>() });
 		it = ins.first;
 	}
 	ShaderStore* shader = it->second.get();
@@ -116,6 +116,7 @@ const ShaderProgram& ShaderManager::CreateShader(const std::string& name, Shader
 	if (partsToCompile.gs) { shader->program.gs = std::move(program.gs); }
 	if (partsToCompile.ps) { shader->program.ps = std::move(program.ps); }
 	if (partsToCompile.cs) { shader->program.cs = std::move(program.cs); }
+	shader->dependencies = GetSourceFiles(shaderPath, shaderSource);
 
 	return shader->program;
 }
@@ -129,8 +130,100 @@ gxapi::eShaderCompileFlags ShaderManager::GetShaderCompileFlags() const {
 	return m_compileFlags;
 }
 
-void ShaderManager::ReloadShaders() {
-	return;
+void ShaderManager::SetCacheFile(const std::string& packPath) {
+	m_cache = std::make_unique<ShaderCache>(packPath, m_gxapiManager->GetShaderCompilerVersion());
+}
+
+void ShaderManager::FlushCache() {
+	if (m_cache) {
+		m_cache->Flush();
+	}
+}
+
+bool ShaderManager::ReloadShaders() {
+	namespace fs = std::experimental::filesystem;
+
+	std::vector<std::pair<ShaderId, ShaderStore*>> shaders;
+	{
+		std::lock_guard<std::mutex> shaderMapLock(m_shaderMutex);
+		for (auto& shader : m_shaders) {
+			shaders.push_back({ shader.first, shader.second.get() });
+		}
+	}
+
+	// Shaders share includes, so check each file only once.
+	std::unordered_map<std::string, bool> changedFiles;
+	auto IsChanged = [&changedFiles](const SourceFile& file) {
+		auto it = changedFiles.find(file.path);
+		if (it == changedFiles.end()) {
+			std::error_code error;
+			auto lastWriteTime = fs::last_write_time(file.path, error);
+			it = changedFiles.insert({ file.path, error || lastWriteTime != file.lastWriteTime }).first;
+		}
+		return it->second;
+	};
+
+	std::vector<PendingReload> reloads;
+	std::shared_lock<std::shared_mutex> sourceLock(m_sourceMutex);
+	for (auto& shader : shaders) {
+		const ShaderId& shaderId = shader.first;
+		ShaderStore* store = shader.second;
+		std::unique_lock<std::mutex> shaderLock(m_compileMutexes[ShaderIdHash()(shaderId) % m_numCompileMutexes]);
+
+		if (std::none_of(store->dependencies.begin(), store->dependencies.end(), IsChanged)) {
+			continue;
+		}
+
+		PendingReload reload;
+		reload.id = shaderId;
+		reload.store = store;
+		reload.parts = ShaderParts().SetUnion(store->parts);
+		reload.dependencies = store->dependencies; // Don't retry until the files change again, even if it fails.
+		try {
+			auto pathSourcePair = FindShaderCode(shaderId.name);
+			reload.dependencies = GetSourceFiles(pathSourcePair.first, pathSourcePair.second);
+			reload.program = CompileShaderInternal(pathSourcePair.second, reload.parts, shaderId.macros);
+		}
+		catch (gxapi::ShaderCompilationError& ex) {
+			reload.error = "Error while reloading shader '" + shaderId.name + "'. Compiler message: " + ex.what();
+		}
+		catch (std::runtime_error& ex) {
+			reload.error = "Error while reloading shader '" + shaderId.name + "': " + ex.what();
+		}
+		reloads.push_back(std::move(reload));
+	}
+	sourceLock.unlock();
+
+	std::lock_guard<std::mutex> reloadLock(m_reloadMutex);
+	for (auto& reload : reloads) {
+		m_pendingReloads.push_back(std::move(reload));
+	}
+	return !reloads.empty();
+}
+
+
+auto ShaderManager::ApplyReloadedShaders() -> ReloadResult {
+	std::lock_guard<std::mutex> reloadLock(m_reloadMutex);
+
+	ReloadResult result;
+	for (auto& reload : m_pendingReloads) {
+		std::lock_guard<std::mutex> shaderLock(m_compileMutexes[ShaderIdHash()(reload.id) % m_numCompileMutexes]);
+		ShaderStore* store = reload.store;
+
+		store->dependencies = std::move(reload.dependencies);
+		if (!reload.error.empty()) {
+			result.errors.push_back(std::move(reload.error));
+			continue;
+		}
+
+		// Stages compiled since the reload started are dropped, they'll be recompiled when requested again.
+		store->program = std::move(reload.program);
+		store->parts = reload.parts;
+		result.reloadedShaders.push_back(reload.id.name);
+	}
+	m_pendingReloads.clear();
+
+	return result;
 }
 
 
@@ -221,17 +314,43 @@ ShaderProgram ShaderManager::CompileShaderInternal(const std::string& sourceCode
 		if (parts.cs) { compileIndices[idx] = 5; ++idx; }
 	}
 
+	// Everything the binaries depend on, except for the stage, which is added per stage.
+	ShaderCache::KeyBuilder programKey;
+	if (m_cache) {
+		gxapi::eShaderCompileFlags flags = m_compileFlags;
+		programKey.Add(sourceCode).Add(macros).Add(uint64_t((gxapi::eShaderCompileFlags::EnumT)flags));
+		std::vector<IncludedSource> includes;
+		std::unordered_set<std::string> visitedIncludes;
+		FindIncludes(sourceCode, includes, visitedIncludes);
+		for (const auto& include : includes) {
+			programKey.Add(include.name).Add(include.code);
+		}
+	}
+
 	int idx = 0;
 	while (compileIndices[idx] != -1) {
 		const int stageId = compileIndices[idx];
 		const char* mainName = mainNames[stageId];
 		gxapi::eShaderType type = types[stageId];
-		auto binary = m_gxapiManager->CompileShader(sourceCode.c_str(),
-			mainName,
-			type,
-			m_compileFlags,
-			&includeProvider,
-			macros.c_str());
+
+		gxapi::ShaderProgramBinary binary;
+		ShaderCache::Key key;
+		bool cached = false;
+		if (m_cache) {
+			key = ShaderCache::KeyBuilder(programKey).Add(uint64_t(stageId)).Finish();
+			cached = m_cache->Find(key, binary.data);
+		}
+		if (!cached) {
+			binary = m_gxapiManager->CompileShader(sourceCode.c_str(),
+				mainName,
+				type,
+				m_compileFlags,
+				&includeProvider,
+				macros.c_str());
+			if (m_cache) {
+				m_cache->Store(key, binary.data);
+			}
+		}
 
 		ShaderStage* dest;
 		switch (type) {
@@ -250,6 +369,63 @@ ShaderProgram ShaderManager::CompileShaderInternal(const std::string& sourceCode
 }
 
 
+void ShaderManager::FindIncludes(const std::string& sourceCode, std::vector<IncludedSource>& includes, std::unordered_set<std::string>& visited) const {
+	size_t position = 0;
+	while ((position = sourceCode.find("#include", position)) != sourceCode.npos) {
+		position += sizeof("#include") - 1;
+		size_t nameBegin = sourceCode.find_first_of("\"<\n", position);
+		if (nameBegin == sourceCode.npos || sourceCode[nameBegin] == '\n') {
+			continue;
+		}
+		size_t nameEnd = sourceCode.find(sourceCode[nameBegin] == '"' ? '"' : '>', nameBegin + 1);
+		if (nameEnd == sourceCode.npos) {
+			break;
+		}
+
+		std::string includeName = sourceCode.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+		position = nameEnd + 1;
+		if (!visited.insert(includeName).second) {
+			continue;
+		}
+
+		std::pair<std::string, std::string> pathSourcePair;
+		try {
+			pathSourcePair = FindShaderCode(includeName);
+		}
+		catch (std::runtime_error&) {
+			continue; // The compiler will report it.
+		}
+		includes.push_back({ includeName, pathSourcePair.first, pathSourcePair.second });
+		FindIncludes(pathSourcePair.second, includes, visited);
+	}
+}
+
+
+auto ShaderManager::GetSourceFiles(const std::string& shaderPath, const std::string& sourceCode) const -> std::vector<SourceFile> {
+	std::vector<std::string> paths = { shaderPath };
+	std::vector<IncludedSource> includes;
+	std::unordered_set<std::string> visitedIncludes;
+	FindIncludes(sourceCode, includes, visitedIncludes);
+	for (const auto& include : includes) {
+		paths.push_back(include.path);
+	}
+
+	// Sources added as code are not files, they can't change.
+	std::vector<SourceFile> files;
+	for (auto& path : paths) {
+		if (m_codes.count(path) > 0) {
+			continue;
+		}
+		std::error_code error;
+		auto lastWriteTime = std::experimental::filesystem::last_write_time(path, error);
+		if (!error) {
+			files.push_back({ std::move(path), lastWriteTime });
+		}
+	}
+	return files;
+}
+
+
 std::string ShaderManager::StripShaderName(std::string name) {
 	// remove extension from the end, if any
 	size_t extDot = name.find_last_of('.');
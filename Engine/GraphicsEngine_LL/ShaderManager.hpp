@@ -9,6 +9,8 @@
 #include <GraphicsApi_LL/IGxapiManager.hpp>
 #include <GraphicsApi_LL/Common.hpp>
 
+#include "ShaderCache.hpp"
+
 
 namespace inl {
 namespace gxeng {
@@ -118,9 +120,27 @@ private:
 		std::string macros;
 		bool operator==(const ShaderId& rhs) const { return name == rhs.name && macros == rhs.macros; }
 	};
+	struct SourceFile {
+		std::string path;
+		std::experimental::filesystem::file_time_type lastWriteTime;
+	};
 	struct ShaderStore {
 		ShaderProgram program;
 		volatile ShaderParts parts;
+		std::vector<SourceFile> dependencies; /// <summary> The shader's file and all files it includes, for reloading. </summary>
+	};
+	struct IncludedSource {
+		std::string name; /// <summary> As written in the include directive. </summary>
+		std::string path; /// <summary> Canonical name returned by FindShaderCode. </summary>
+		std::string code;
+	};
+	struct PendingReload {
+		ShaderId id;
+		ShaderStore* store;
+		ShaderProgram program;
+		ShaderParts parts;
+		std::vector<SourceFile> dependencies;
+		std::string error; /// <summary> The compiler message if it failed, the old binaries are kept then. </summary>
 	};
 	struct PathHash {
 		size_t operator()(const std::experimental::filesystem::path& obj) const {
@@ -137,6 +157,11 @@ private:
 	using PathContainer = std::unordered_set<std::experimental::filesystem::path, PathHash>;
 	using CodeContainer = std::unordered_map<std::string, std::string>;
 	using ShaderContainer = std::unordered_map<ShaderId, std::unique_ptr<ShaderStore>, ShaderIdHash>;
+public:
+	struct ReloadResult {
+		std::vector<std::string> reloadedShaders; /// <summary> Names of the shaders whose binaries changed. </summary>
+		std::vector<std::string> errors; /// <summary> Compiler messages of shaders that failed to reload. </summary>
+	};
 public:
 	ShaderManager(gxapi::IGxapiManager* gxapiManager);
 	~ShaderManager();
@@ -186,14 +211,34 @@ public:
 	const ShaderProgram& CreateShader(const std::string& name, ShaderParts parts, const std::string& macros = {});
 
 
-	/// <summary> It does not do anything, but I guess it will be good for something in the future. </summary>
-	void ReloadShaders();
+	/// <summary> Keep compiled binaries in a pack file between runs. Binaries are looked up by the source code,
+	///		including all included files, the macros and the compile flags. </summary>
+	/// <remarks> This method is NOT thread-safe, call it before compiling shaders. </remarks>
+	void SetCacheFile(const std::string& packPath);
+
+	/// <summary> Writes newly compiled binaries to the cache file. It also happens on destruction. </summary>
+	/// <remarks> This method is NOT thread-safe, no shaders may be compiled meanwhile. </remarks>
+	void FlushCache();
+
+	/// <summary> Recompiles the shaders whose source file or any of its includes has changed on disk.
+	///		The new binaries are not visible until <see cref="ApplyReloadedShaders"/> is called. </summary>
+	/// <returns> True if any shader was recompiled, or failed to. </returns>
+	/// <remarks> This method is thread-safe, and may take long, so you might want to run it in the background.
+	///		Don't call it again before applying the results. Only shaders created by name are reloaded. </remarks>
+	bool ReloadShaders();
+
+	/// <summary> Replaces the binaries of the shaders with the ones recompiled by <see cref="ReloadShaders"/>.
+	///		Shaders that failed to compile keep their old binaries. </summary>
+	/// <remarks> This method is thread-safe. Call it at a frame boundary, then recreate the PSOs of the reloaded shaders. </remarks>
+	ReloadResult ApplyReloadedShaders();
 
 	/// <summary> Return the source code of a certain shader. </summary>
 	std::string LoadShaderSource(const std::string& name) const;
 
 	/// <summary> Compile arbitrary source code without adding it to the library. </summary>
-	/// <remarks> Include directives will still work if registered files are referenced. </remarks>
+	/// <remarks> Include directives will still work if registered files are referenced.
+	///		The result is not watched by <see cref="ReloadShaders"/>, not even when an included file changes,
+	///		so generated shaders, like those of materials, are not hot reloaded. </remarks>
 	ShaderProgram CompileShader(const std::string& sourceCode, ShaderParts parts, const std::string& macros = {});
 private:
 	/// <summary> Find a source in dirs, resource and codes by its name. Does not lock anything. </summary>
@@ -206,6 +251,13 @@ private:
 	/// <summary> Compiles a shader to binary according to parameters. </summary>
 	ShaderProgram CompileShaderInternal(const std::string& sourceCode, ShaderParts parts, const std::string& macros);
 
+	/// <summary> Finds the sources included by the source code, recursively, in the order they appear. Does not lock anything. </summary>
+	/// <remarks> Only looks for the directives, conditional includes are returned even if they are not compiled. </remarks>
+	void FindIncludes(const std::string& sourceCode, std::vector<IncludedSource>& includes, std::unordered_set<std::string>& visited) const;
+
+	/// <summary> Lists the files of a shader found by FindShaderCode, with their modification times. Does not lock anything. </summary>
+	std::vector<SourceFile> GetSourceFiles(const std::string& shaderPath, const std::string& sourceCode) const;
+
 	// Cuts off extension (only .hlsl, .glsl, .cg, .txt), converts to lowercase.
 	static std::string StripShaderName(std::string name);
 private:
@@ -221,7 +273,12 @@ private:
 	std::unique_ptr<std::mutex[]> m_compileMutexes; /// <summary> Hash-modulo select one, lock when accessing hashed shader binary. </summary>
 	size_t m_numCompileMutexes;
 
+	std::mutex m_reloadMutex; /// <summary> Lock when accessing m_pendingReloads. </summary>
+	std::vector<PendingReload> m_pendingReloads; /// <summary> Recompiled shaders waiting to be applied. </summary>
+
 	gxapi::eShaderCompileFlags m_compileFlags;
+
+	std::unique_ptr<ShaderCache> m_cache; /// <summary> Binaries from previous runs, null if not enabled. </summary>
 };
 
 
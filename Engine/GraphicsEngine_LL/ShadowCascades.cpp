@@ -0,0 +1,255 @@
+#include "ShadowCascades.hpp"
+
+#include "Camera.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+
+namespace inl::gxeng {
+
+
+ShadowCascadeFitter::ShadowCascadeFitter(unsigned cascadeCount, unsigned resolution) :
+	m_cascadeCount(1),
+	m_resolution(2),
+	m_logarithmicWeight(0.75f),
+	m_lightView(mathfu::Matrix4x4f::Identity())
+{
+	SetCascadeCount(cascadeCount);
+	SetResolution(resolution);
+}
+
+
+void ShadowCascadeFitter::SetCascadeCount(unsigned count) {
+	if (count == 0) {
+		throw std::invalid_argument("There must be at least one cascade.");
+	}
+	m_cascadeCount = count;
+}
+
+
+void ShadowCascadeFitter::SetResolution(unsigned resolution) {
+	if (resolution < 2) {
+		throw std::invalid_argument("Shadow map resolution must be at least 2 texels.");
+	}
+	m_resolution = resolution;
+}
+
+
+void ShadowCascadeFitter::SetLogarithmicWeight(float weight) {
+	m_logarithmicWeight = std::min(1.0f, std::max(0.0f, weight));
+}
+
+
+std::vector<float> ShadowCascadeFitter::CalculateSplits(float nearDistance, float farDistance, unsigned cascadeCount, float logarithmicWeight) {
+	if (nearDistance <= 0.0f || farDistance <= nearDistance) {
+		throw std::invalid_argument("Split range must satisfy 0 < near < far.");
+	}
+	if (cascadeCount == 0) {
+		throw std::invalid_argument("There must be at least one cascade.");
+	}
+
+	std::vector<float> splits(cascadeCount + 1);
+	splits.front() = nearDistance;
+	for (unsigned i = 1; i < cascadeCount; ++i) {
+		float t = float(i) / cascadeCount;
+		float logarithmic = nearDistance * std::pow(farDistance / nearDistance, t);
+		float uniform = nearDistance + (farDistance - nearDistance) * t;
+		splits[i] = logarithmicWeight * logarithmic + (1.0f - logarithmicWeight) * uniform;
+	}
+	splits.back() = farDistance;
+
+	return splits;
+}
+
+
+mathfu::Matrix4x4f ShadowCascadeFitter::LightViewTransform(const mathfu::Vector3f& lightDirection) {
+	auto z = -lightDirection.Normalized();
+	auto x = mathfu::Vector3f::CrossProduct({ 0, 1, 0 }, z);
+	if (x.LengthSquared() < 0.0001f) {
+		x = mathfu::Vector3f(1, 0, 0);
+	}
+	else {
+		x.Normalize();
+	}
+	auto y = mathfu::Vector3f::CrossProduct(z, x);
+
+	// Rotation only: the light view stays put while the camera moves, which keeps texel snapping meaningful.
+	return mathfu::Matrix4x4f(x.x(), x.y(), x.z(), 0, y.x(), y.y(), y.z(), 0, z.x(), z.y(), z.z(), 0, 0, 0, 0, 1).Inverse();
+}
+
+
+void ShadowCascadeFitter::Fit(const Camera& camera, const mathfu::Vector3f& lightDirection) {
+	m_lightView = LightViewTransform(lightDirection);
+
+	// Splits must not follow the scene, the slices' spheres and so the texel size would change every frame.
+	std::vector<float> splits = CalculateSplits(camera.GetNearPlane(), camera.GetFarPlane(), m_cascadeCount, m_logarithmicWeight);
+
+	// Corners of the slices are unprojected from the camera's own matrices, so they match the rendered frustum exactly.
+	mathfu::Matrix4x4f projection = camera.GetPerspectiveMatrixRH();
+	mathfu::Matrix4x4f inverseViewProjection = (projection * camera.GetViewMatrixRH()).Inverse();
+	auto GetCorners = [&](float distance) {
+		mathfu::Vector4f clip = projection * mathfu::Vector4f(0, 0, -distance, 1);
+		float ndcZ = clip.z() / clip.w();
+		std::array<mathfu::Vector3f, 4> corners;
+		for (int i = 0; i < 4; ++i) {
+			mathfu::Vector4f corner = inverseViewProjection * mathfu::Vector4f(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, ndcZ, 1.0f);
+			corners[i] = corner.xyz() / corner.w();
+		}
+		return corners;
+	};
+
+	m_cascades.resize(m_cascadeCount);
+	std::array<mathfu::Vector3f, 4> nearCorners = GetCorners(splits[0]);
+	for (unsigned i = 0; i < m_cascadeCount; ++i) {
+		Cascade& cascade = m_cascades[i];
+		std::array<mathfu::Vector3f, 4> farCorners = GetCorners(splits[i + 1]);
+
+		// The smallest sphere around the slice has its center on the view axis, where the near and far corners are equally far.
+		// Its radius only depends on the slice, not on where the camera looks.
+		mathfu::Vector3f nearCenter = (nearCorners[0] + nearCorners[1] + nearCorners[2] + nearCorners[3]) * 0.25f;
+		mathfu::Vector3f farCenter = (farCorners[0] + farCorners[1] + farCorners[2] + farCorners[3]) * 0.25f;
+		float nearRadiusSq = 0.0f, farRadiusSq = 0.0f;
+		for (int j = 0; j < 4; ++j) {
+			nearRadiusSq = std::max(nearRadiusSq, (nearCorners[j] - nearCenter).LengthSquared());
+			farRadiusSq = std::max(farRadiusSq, (farCorners[j] - farCenter).LengthSquared());
+		}
+		float length = (farCenter - nearCenter).Length();
+		float offset = std::min(length, std::max(0.0f, (length * length + farRadiusSq - nearRadiusSq) / (2.0f * length)));
+		mathfu::Vector3f center = nearCenter + (farCenter - nearCenter) * (offset / length);
+		float radius = std::sqrt(std::max(offset * offset + nearRadiusSq, (length - offset) * (length - offset) + farRadiusSq));
+
+		// Rounding up hides the float noise of turning the camera, so the texel size stays the same.
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		// Snapping moves the center by at most half a texel, so the projection is made that much larger than the sphere.
+		float halfSize = radius * m_resolution / (m_resolution - 1);
+		float texelSize = 2.0f * halfSize / m_resolution;
+		mathfu::Vector3f lightCenter = (m_lightView * mathfu::Vector4f(center, 1.0f)).xyz();
+		lightCenter.x() = std::round(lightCenter.x() / texelSize) * texelSize;
+		lightCenter.y() = std::round(lightCenter.y() / texelSize) * texelSize;
+
+		cascade.nearDistance = splits[i];
+		cascade.farDistance = splits[i + 1];
+		cascade.center = lightCenter;
+		cascade.radius = radius;
+		cascade.nearZ = lightCenter.z() + radius;
+		cascade.farZ = lightCenter.z() - radius;
+		cascade.casters.clear();
+		UpdateProjection(cascade);
+
+		nearCorners = farCorners;
+	}
+}
+
+
+void ShadowCascadeFitter::TransformBounds(const mathfu::Matrix4x4f& lightView, const std::vector<Caster>& boxes, std::vector<Bounds>& bounds) {
+	bounds.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i) {
+		const Caster& box = boxes[i];
+		mathfu::Matrix4x4f transform = lightView * box.world;
+		for (int j = 0; j < 8; ++j) {
+			mathfu::Vector3f corner(j & 1 ? box.boxMax.x() : box.boxMin.x(),
+									j & 2 ? box.boxMax.y() : box.boxMin.y(),
+									j & 4 ? box.boxMax.z() : box.boxMin.z());
+			mathfu::Vector3f transformed = (transform * mathfu::Vector4f(corner, 1.0f)).xyz();
+			bounds[i].min = j == 0 ? transformed : mathfu::Vector3f::Min(bounds[i].min, transformed);
+			bounds[i].max = j == 0 ? transformed : mathfu::Vector3f::Max(bounds[i].max, transformed);
+		}
+	}
+}
+
+
+void ShadowCascadeFitter::Cull(const std::vector<Caster>& casters, const std::vector<Receiver>& receivers) {
+	// Boxes are brought to light space once, every cascade tests against the same bounds.
+	TransformBounds(m_lightView, casters, m_casterBounds);
+	TransformBounds(m_lightView, receivers, m_receiverBounds);
+
+	// Cascades don't share anything but the bounds, which are only read.
+	size_t threadCount = std::min({ size_t(std::max(1u, std::thread::hardware_concurrency())),
+									casters.size() / MIN_CASTERS_PER_THREAD,
+									m_cascades.size() });
+	auto CullCascades = [this](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			CullCascade(m_cascades[i]);
+		}
+	};
+	if (threadCount <= 1) {
+		CullCascades(0, m_cascades.size());
+	}
+	else {
+		size_t cascadesPerBand = (m_cascades.size() + threadCount - 1) / threadCount;
+		std::vector<std::future<void>> bands;
+		for (size_t first = cascadesPerBand; first < m_cascades.size(); first += cascadesPerBand) {
+			bands.push_back(std::async(std::launch::async, CullCascades, first, std::min(m_cascades.size(), first + cascadesPerBand)));
+		}
+		CullCascades(0, cascadesPerBand);
+		for (auto& band : bands) {
+			band.get();
+		}
+	}
+}
+
+
+void ShadowCascadeFitter::CullCascade(Cascade& cascade) const {
+	float halfSize = cascade.radius * m_resolution / (m_resolution - 1);
+	float left = cascade.center.x() - halfSize;
+	float right = cascade.center.x() + halfSize;
+	float bottom = cascade.center.y() - halfSize;
+	float top = cascade.center.y() + halfSize;
+	float farZ = cascade.center.z() - cascade.radius;
+	float sphereNearZ = cascade.center.z() + cascade.radius;
+
+	// Nothing farther from the light than every receiver in the slice needs a shadow.
+	float receiverFarZ = std::numeric_limits<float>::infinity();
+	for (const Bounds& bounds : m_receiverBounds) {
+		if (bounds.max.x() < left || bounds.min.x() > right
+			|| bounds.max.y() < bottom || bounds.min.y() > top
+			|| bounds.max.z() < farZ || bounds.min.z() > sphereNearZ)
+		{
+			continue;
+		}
+		receiverFarZ = std::min(receiverFarZ, bounds.min.z());
+	}
+	if (receiverFarZ != std::numeric_limits<float>::infinity()) {
+		farZ = std::max(farZ, receiverFarZ);
+	}
+
+	// Anything toward the light from the slice may throw a shadow into it, but nothing behind it can.
+	cascade.casters.clear();
+	float nearZ = -std::numeric_limits<float>::infinity();
+	for (size_t i = 0; i < m_casterBounds.size(); ++i) {
+		const Bounds& bounds = m_casterBounds[i];
+		if (bounds.max.x() < left || bounds.min.x() > right
+			|| bounds.max.y() < bottom || bounds.min.y() > top
+			|| bounds.max.z() < farZ)
+		{
+			continue;
+		}
+		cascade.casters.push_back(uint32_t(i));
+		nearZ = std::max(nearZ, bounds.max.z());
+	}
+
+	// Receivers closer to the light than every caster are lit anyway, so the depth range ends at the nearest caster.
+	cascade.nearZ = cascade.casters.empty() ? sphereNearZ : nearZ;
+	cascade.farZ = farZ;
+	cascade.nearZ = std::max(cascade.nearZ, cascade.farZ + cascade.radius * 1e-3f);
+	UpdateProjection(cascade);
+}
+
+
+void ShadowCascadeFitter::UpdateProjection(Cascade& cascade) const {
+	float halfSize = cascade.radius * m_resolution / (m_resolution - 1);
+	cascade.projection = mathfu::Matrix4x4f::Ortho(cascade.center.x() - halfSize, cascade.center.x() + halfSize,
+												   cascade.center.y() - halfSize, cascade.center.y() + halfSize,
+												   cascade.nearZ, cascade.farZ);
+	cascade.viewProjection = cascade.projection * m_lightView;
+}
+
+
+} // namespace inl::gxeng
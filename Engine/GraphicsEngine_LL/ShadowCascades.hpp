@@ -0,0 +1,110 @@
+#pragma once
+
+#include <mathfu/mathfu_exc.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace inl::gxeng {
+
+
+class Camera;
+
+
+/// <summary>
+/// Fits the cascades of a directional light's shadow map on the view frustum of a camera,
+/// and sorts shadow casters into the cascades they can throw a shadow in.
+/// </summary>
+/// <remarks>
+/// The view range is split at distances blended from a logarithmic and a uniform scheme.
+/// Each cascade's projection covers the bounding sphere of its slice of the frustum, so its size
+/// does not change as the camera turns, and its center is snapped to whole shadow map texels,
+/// so shadow edges don't crawl as the camera moves.
+/// After culling, the depth range of each cascade reaches from its caster nearest to the light
+/// to its receiver farthest from the light, but not beyond the far side of its slice.
+/// Usage per frame: <see cref="Fit"/>, then <see cref="Cull"/>.
+/// </remarks>
+class ShadowCascadeFitter {
+public:
+	/// <summary> Bounding box of a potential shadow caster or receiver. </summary>
+	struct Caster {
+		mathfu::Vector3f boxMin; // Model space.
+		mathfu::Vector3f boxMax;
+		mathfu::Matrix4x4f world;
+	};
+	using Receiver = Caster;
+
+	struct Cascade {
+		float nearDistance; // Distance along the camera's view direction where the slice starts.
+		float farDistance;
+		mathfu::Vector3f center; // Bounding sphere of the slice in light view space, snapped to texels.
+		float radius;
+		float nearZ; // Depth range in light view space, the light looks down -Z so nearZ > farZ.
+		float farZ;
+		mathfu::Matrix4x4f projection; // Light view space to shadow map.
+		mathfu::Matrix4x4f viewProjection; // World space to shadow map.
+		std::vector<uint32_t> casters; // Indices of the casters given to Cull that are drawn into this cascade.
+	};
+
+public:
+	/// <exception cref="std::invalid_argument"> If cascade count or resolution is zero. </exception>
+	ShadowCascadeFitter(unsigned cascadeCount = 4, unsigned resolution = 1024);
+
+	/// <exception cref="std::invalid_argument"> If count is zero. </exception>
+	void SetCascadeCount(unsigned count);
+	/// <summary> Width and height of each cascade's shadow map in texels. </summary>
+	/// <exception cref="std::invalid_argument"> If resolution is zero. </exception>
+	void SetResolution(unsigned resolution);
+	/// <summary> 0 splits the view range uniformly, 1 logarithmically. Clamped to [0, 1]. </summary>
+	void SetLogarithmicWeight(float weight);
+
+	unsigned GetCascadeCount() const { return m_cascadeCount; }
+	unsigned GetResolution() const { return m_resolution; }
+	float GetLogarithmicWeight() const { return m_logarithmicWeight; }
+
+	/// <summary> Splits the distance range. The first split is the near, the last is the far distance. </summary>
+	static std::vector<float> CalculateSplits(float nearDistance, float farDistance, unsigned cascadeCount, float logarithmicWeight);
+
+	/// <summary> World space to light view space, the light looks down -Z. Only depends on the direction. </summary>
+	static mathfu::Matrix4x4f LightViewTransform(const mathfu::Vector3f& lightDirection);
+
+	/// <summary> Splits the camera's frustum between its near and far planes and fits a stable projection on each slice. </summary>
+	/// <param name="lightDirection"> Direction the light travels in. </param>
+	void Fit(const Camera& camera, const mathfu::Vector3f& lightDirection);
+
+	/// <summary>
+	/// Collects the casters that overlap each cascade, and pulls the cascade's near depth
+	/// to the caster nearest to the light. Cascades are processed on separate threads.
+	/// </summary>
+	/// <param name="receivers"> If any of them overlaps a cascade, its far depth is pulled to the one farthest from the light.
+	///		Only the depth range changes, the slices and their texels stay the same. </param>
+	void Cull(const std::vector<Caster>& casters, const std::vector<Receiver>& receivers = {});
+
+	const mathfu::Matrix4x4f& GetLightView() const { return m_lightView; }
+	const std::vector<Cascade>& GetCascades() const { return m_cascades; }
+private:
+	struct Bounds {
+		mathfu::Vector3f min;
+		mathfu::Vector3f max;
+	};
+
+	static void TransformBounds(const mathfu::Matrix4x4f& lightView, const std::vector<Caster>& boxes, std::vector<Bounds>& bounds);
+	void CullCascade(Cascade& cascade) const;
+	void UpdateProjection(Cascade& cascade) const;
+private:
+	static constexpr size_t MIN_CASTERS_PER_THREAD = 256;
+
+	unsigned m_cascadeCount;
+	unsigned m_resolution;
+	float m_logarithmicWeight;
+
+	mathfu::Matrix4x4f m_lightView;
+	std::vector<Cascade> m_cascades;
+	std::vector<Bounds> m_casterBounds; // Light view space.
+	std::vector<Bounds> m_receiverBounds;
+};
+
+
+} // namespace inl::gxeng
@@ -1,5 +1,6 @@
 
 #include "StackDescHeap.hpp"
+#include "BindlessHeap.hpp"
 
 #include <cassert>
 
@@ -45,12 +46,16 @@ DescriptorArrayRef::DescriptorArrayRef(StackDescHeap* home, uint32_t pos, uint32
 // =======================================================
 
 
-StackDescHeap::StackDescHeap(gxapi::IGraphicsApi* graphicsApi, gxapi::eDescriptorHeapType type, uint32_t size) :
-	m_size(size),
-	m_next(0)
+StackDescHeap::StackDescHeap(gxapi::IGraphicsApi* graphicsApi, gxapi::eDescriptorHeapType type, uint32_t size, BindlessHeap* bindlessHeap) :
+	m_bindlessHeap(bindlessHeap),
+	m_reservedSize(bindlessHeap != nullptr ? bindlessHeap->GetCapacity() : 0),
+	m_bindlessVersion(0)
 {
 	assert(type == gxapi::eDescriptorHeapType::CBV_SRV_UAV || type == gxapi::eDescriptorHeapType::SAMPLER);
-	gxapi::DescriptorHeapDesc desc(type, size, true);
+	assert(bindlessHeap == nullptr || type == gxapi::eDescriptorHeapType::CBV_SRV_UAV);
+	m_size = m_reservedSize + size;
+	m_next = m_reservedSize;
+	gxapi::DescriptorHeapDesc desc(type, m_size, true);
 	m_heap.reset(graphicsApi->CreateDescriptorHeap(desc));
 }
 
@@ -67,7 +72,22 @@ DescriptorArrayRef StackDescHeap::Allocate(uint32_t size) {
 
 
 void StackDescHeap::Reset() {
-	m_next = 0;
+	m_next = m_reservedSize;
+}
+
+
+void StackDescHeap::UpdateBindlessTable() {
+	if (m_bindlessHeap != nullptr) {
+		m_bindlessHeap->Update(*this);
+	}
+}
+
+
+gxapi::DescriptorHandle StackDescHeap::GetBindlessTable() {
+	if (m_bindlessHeap == nullptr) {
+		throw gxapi::InvalidState("Scratch space has no bindless table.");
+	}
+	return m_heap->At(0);
 }
 
 
@@ -10,6 +10,7 @@ namespace inl {
 namespace gxeng {
 
 class StackDescHeap;
+class BindlessHeap;
 
 class DescriptorArrayRef {
 public:
@@ -49,11 +50,15 @@ protected:
 /// <para />
 /// Each CPU thread that generates command lists should have
 /// exclusive ownership over at least one instance of this class.
+/// <para />
+/// If there is a bindless table, the heap starts with a copy of it,
+/// and allocations are placed after that.
 /// </summary>
 class StackDescHeap {
 	friend class DescriptorArrayRef;
+	friend class BindlessHeap;
 public:
-	StackDescHeap(gxapi::IGraphicsApi* graphicsApi, gxapi::eDescriptorHeapType type, uint32_t size);
+	StackDescHeap(gxapi::IGraphicsApi* graphicsApi, gxapi::eDescriptorHeapType type, uint32_t size, BindlessHeap* bindlessHeap = nullptr);
 
 	DescriptorArrayRef Allocate(uint32_t size);
 
@@ -63,10 +68,20 @@ public:
 	void Reset();
 
 	gxapi::IDescriptorHeap* GetHeap() const { return m_heap.get(); }
+
+	/// <summary> Brings the copy of the bindless table up to date. </summary>
+	void UpdateBindlessTable();
+	/// <summary> The first descriptor of the bindless table's copy. </summary>
+	/// <exception cref="inl::gxapi::InvalidState"> If there's no bindless table. </exception>
+	gxapi::DescriptorHandle GetBindlessTable();
 protected:
 	std::unique_ptr<gxapi::IDescriptorHeap> m_heap;
 	uint32_t m_size;
 	uint32_t m_next;
+
+	BindlessHeap* m_bindlessHeap;
+	uint32_t m_reservedSize; // descriptors at the start of the heap that hold the bindless table
+	uint64_t m_bindlessVersion; // version of the bindless table when it was last copied
 };
 
 
@@ -0,0 +1,80 @@
+#include "StagingRingAllocator.hpp"
+
+#include <stdexcept>
+#include <new>
+#include <cassert>
+
+
+namespace inl::gxeng {
+
+
+static size_t CheckedSlotCount(size_t size, size_t alignment) {
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+		throw std::invalid_argument("Alignment must be a power of two.");
+	}
+	if (size < alignment) {
+		throw std::invalid_argument("Staging ring must be at least as large as the alignment.");
+	}
+	return size / alignment;
+}
+
+
+StagingRingAllocator::StagingRingAllocator(size_t size, size_t alignment)
+	: m_engine(CheckedSlotCount(size, alignment)),
+	m_alignment(alignment)
+{}
+
+
+bool StagingRingAllocator::TryAllocate(size_t size, size_t& offset) {
+	if (size == 0) {
+		throw std::invalid_argument("Allocation size should be non-zero.");
+	}
+
+	size_t slotCount = (size + m_alignment - 1) / m_alignment;
+	size_t firstSlot;
+	try {
+		firstSlot = m_engine.Allocate(slotCount);
+	}
+	catch (std::bad_alloc&) {
+		return false;
+	}
+
+	m_liveAllocations.insert({ firstSlot, slotCount });
+	m_usedSlots += slotCount;
+
+	offset = firstSlot * m_alignment;
+	return true;
+}
+
+
+void StagingRingAllocator::Retire(size_t offset, uint64_t frameId) {
+	size_t firstSlot = offset / m_alignment;
+	auto it = m_liveAllocations.find(firstSlot);
+	if (offset % m_alignment != 0 || it == m_liveAllocations.end()) {
+		throw std::invalid_argument("No live allocation at given offset.");
+	}
+	assert(m_retiredAllocations.empty() || m_retiredAllocations.back().frameId <= frameId);
+
+	m_retiredAllocations.push_back({ frameId, firstSlot, it->second });
+	m_liveAllocations.erase(it);
+}
+
+
+size_t StagingRingAllocator::ReleaseFrames(uint64_t frameId) {
+	size_t releasedSlots = 0;
+
+	// Allocations are mostly retired in the order they were made, so the ring is freed up from its oldest end.
+	// The engine handles the out-of-order ones by keeping them reserved until their predecessors are gone.
+	while (!m_retiredAllocations.empty() && m_retiredAllocations.front().frameId <= frameId) {
+		const RetiredAllocation& allocation = m_retiredAllocations.front();
+		m_engine.Deallocate(allocation.firstSlot);
+		releasedSlots += allocation.slotCount;
+		m_retiredAllocations.pop_front();
+	}
+
+	m_usedSlots -= releasedSlots;
+	return releasedSlots * m_alignment;
+}
+
+
+} // namespace inl::gxeng
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <BaseLibrary/Memory/RingAllocationEngine.hpp>
+
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+
+namespace inl::gxeng {
+
+
+/// <summary>
+/// Administrates byte ranges of a fixed size, persistently mapped staging buffer.
+/// </summary>
+/// <remarks>
+/// Allocations are handed out in FIFO order. Once the copy that reads an allocation
+/// is submitted, the allocation is retired to that frame, and it is recycled when
+/// the frame finishes on the GPU. The class only does the bookkeeping, it does not
+/// own any GPU memory. Not thread safe.
+/// </remarks>
+class StagingRingAllocator {
+public:
+	/// <param name="size"> Size of the staging buffer in bytes. Rounded down to a multiple of the alignment. </param>
+	/// <param name="alignment"> Every allocation starts at a multiple of this. Must be a power of two. </param>
+	/// <exception cref="std::invalid_argument"> If alignment is not a power of two or size is smaller than alignment. </exception>
+	StagingRingAllocator(size_t size, size_t alignment);
+
+	/// <summary> Reserves an aligned range. The range stays in use until it is retired and released. </summary>
+	/// <param name="offset"> Receives the byte offset of the range within the staging buffer. </param>
+	/// <returns> False if the range does not fit until some frames are released. </returns>
+	/// <exception cref="std::invalid_argument"> If size is zero. </exception>
+	bool TryAllocate(size_t size, size_t& offset);
+
+	/// <summary> Marks the allocation at offset as used by the given frame. </summary>
+	/// <remarks> Allocations must be retired with non-decreasing frame ids. </remarks>
+	/// <exception cref="std::invalid_argument"> If there is no live allocation at offset. </exception>
+	void Retire(size_t offset, uint64_t frameId);
+
+	/// <summary> Recycles the allocations retired to frames up to and including frameId. </summary>
+	/// <returns> The number of bytes that became available. </returns>
+	size_t ReleaseFrames(uint64_t frameId);
+
+	/// <summary> True if there are retired allocations that will be released when their frame finishes. </summary>
+	bool HasRetiredAllocations() const { return !m_retiredAllocations.empty(); }
+
+	size_t GetSize() const { return m_engine.Size() * m_alignment; }
+	size_t GetAlignment() const { return m_alignment; }
+	size_t GetUsedSize() const { return m_usedSlots * m_alignment; }
+private:
+	struct RetiredAllocation {
+		uint64_t frameId;
+		size_t firstSlot;
+		size_t slotCount;
+	};
+
+	exc::RingAllocationEngine m_engine;
+	size_t m_alignment;
+	size_t m_usedSlots = 0;
+
+	std::unordered_map<size_t, size_t> m_liveAllocations; // first slot -> slot count
+	std::deque<RetiredAllocation> m_retiredAllocations;
+};
+
+
+} // namespace inl::gxeng
@@ -29,6 +29,11 @@ public:
 		m_fence->Wait(m_value);		
 	}
 
+	/// <summary> True once the GPU has signaled the fence. Default constructed sync points are always reached. </summary>
+	bool IsReached() const {
+		return !m_fence || m_fence->Fetch() >= m_value;
+	}
+
 	operator bool() {
 		return (bool)m_fence;
 	}
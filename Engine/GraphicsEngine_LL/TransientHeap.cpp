@@ -0,0 +1,205 @@
+#include "TransientHeap.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace inl {
+namespace gxeng {
+namespace impl {
+
+
+TransientHeap::State::State() :
+	targetPool(gxapi::eHeapFlags::ALLOW_ONLY_RT_DS_TEXTURES),
+	texturePool(gxapi::eHeapFlags::ALLOW_ONLY_NON_RT_DS_TEXTURES)
+{}
+
+
+void TransientHeap::State::Release(Unused place) {
+	// Frames that have begun but not completed may still use the texture.
+	if (beganFrameCount <= completedFrameCount) {
+		unused.push_back(std::move(place));
+	}
+	else {
+		released.push_back({ std::move(place), beganFrameCount });
+	}
+}
+
+
+void TransientHeap::State::KeepCompleted() {
+	while (!released.empty() && released.front().frameCount <= completedFrameCount) {
+		unused.push_back(std::move(released.front().place));
+		released.pop_front();
+	}
+}
+
+
+TransientHeap::TransientHeap(gxapi::IGraphicsApi* graphicsApi) :
+	m_graphicsApi(graphicsApi),
+	m_state(std::make_shared<State>())
+{}
+
+
+void TransientHeap::SetPassOrder(std::vector<std::vector<bool>> passOrder, std::vector<std::vector<unsigned>> passConsumers) {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+
+	// Places kept for reuse were decided by the old order.
+	for (auto& unused : m_state->unused) {
+		unused.pool->layout.Deallocate(unused.allocation);
+	}
+	m_state->unused.clear();
+	for (auto& released : m_state->released) {
+		released.place.pool->layout.Deallocate(released.place.allocation);
+	}
+	m_state->released.clear();
+
+	m_state->targetPool.layout.SetPassOrder(passOrder, passConsumers);
+	m_state->texturePool.layout.SetPassOrder(std::move(passOrder), std::move(passConsumers));
+}
+
+
+MemoryObjDesc TransientHeap::Allocate(const gxapi::ResourceDesc& desc, gxapi::ClearValue* clearValue, unsigned pass, eTransientScope scope) {
+	if (desc.type != gxapi::eResourceType::TEXTURE) {
+		throw std::invalid_argument("Transient resources must be textures.");
+	}
+
+	bool isTargetTexture = (desc.textureDesc.flags & gxapi::eResourceFlags::ALLOW_RENDER_TARGET) || (desc.textureDesc.flags & gxapi::eResourceFlags::ALLOW_DEPTH_STENCIL);
+	Pool& pool = isTargetTexture ? m_state->targetPool : m_state->texturePool;
+
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+
+	std::vector<unsigned> users = pool.layout.GetUsers(pass, scope);
+
+	// Go where an equal texture was, its neighbours surely don't conflict.
+	auto unusedIt = std::find_if(m_state->unused.begin(), m_state->unused.end(), [&](const Unused& unused) {
+		return unused.pool == &pool && unused.users == users && IsSameDesc(unused.desc, desc);
+	});
+	if (unusedIt != m_state->unused.end()) {
+		TransientHeapLayout::Allocation allocation = unusedIt->allocation;
+		m_state->unused.erase(unusedIt);
+		try {
+			MemoryObjDesc result = Place(desc, clearValue, std::move(users), pool, allocation);
+			++m_state->recycledCount;
+			return result;
+		}
+		catch (...) {
+			pool.layout.Deallocate(allocation);
+			throw;
+		}
+	}
+
+	gxapi::ResourceAllocationInfo info = m_graphicsApi->GetResourceAllocationInfo(desc);
+	uint64_t newPageSize;
+	TransientHeapLayout::Allocation allocation = pool.layout.Allocate(info.sizeInBytes, info.alignment, users, newPageSize);
+
+	try {
+		if (newPageSize != 0) {
+			gxapi::HeapDesc heapDesc(newPageSize, gxapi::HeapProperties(gxapi::eHeapType::DEFAULT), pool.flags);
+			std::unique_ptr<gxapi::IHeap> heap(m_graphicsApi->CreateHeap(heapDesc));
+			if (pool.heaps.size() <= allocation.page) {
+				pool.heaps.resize(allocation.page + 1);
+			}
+			pool.heaps[allocation.page] = std::move(heap);
+		}
+
+		return Place(desc, clearValue, std::move(users), pool, allocation);
+	}
+	catch (...) {
+		pool.layout.Deallocate(allocation);
+		throw;
+	}
+}
+
+
+void TransientHeap::ReleaseUnused() {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+
+	for (auto& unused : m_state->unused) {
+		unused.pool->layout.Deallocate(unused.allocation);
+	}
+	m_state->unused.clear();
+
+	ReleaseEmptyHeaps();
+}
+
+
+TransientHeap::Statistics TransientHeap::GetStatistics() const {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+
+	Statistics statistics;
+	statistics.targets = m_state->targetPool.layout.GetStatistics();
+	statistics.textures = m_state->texturePool.layout.GetStatistics();
+	statistics.recycledCount = m_state->recycledCount;
+	statistics.unusedCount = m_state->unused.size();
+	statistics.releasedCount = m_state->released.size();
+	return statistics;
+}
+
+
+void TransientHeap::OnFrameBeginHost(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	m_state->beganFrameCount = std::max(m_state->beganFrameCount, frameId + 1);
+}
+
+
+void TransientHeap::OnFrameCompleteDevice(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	m_state->completedFrameCount = std::max(m_state->completedFrameCount, frameId + 1);
+	m_state->KeepCompleted();
+}
+
+
+void TransientHeap::OnDeviceIdle() {
+	std::lock_guard<std::mutex> lock(m_state->mtx);
+	m_state->completedFrameCount = m_state->beganFrameCount;
+	m_state->KeepCompleted();
+}
+
+
+MemoryObjDesc TransientHeap::Place(const gxapi::ResourceDesc& desc, gxapi::ClearValue* clearValue, std::vector<unsigned> users, Pool& pool, TransientHeapLayout::Allocation allocation) {
+	gxapi::IResource* resource = m_graphicsApi->CreatePlacedResource(pool.heaps[allocation.page].get(), allocation.offset, desc, gxapi::eResourceState::COMMON, clearValue);
+
+	// The place is kept when the texture is destroyed, a new texture is placed there to reset the state tracking.
+	MemoryObjDesc result = MemoryObjDesc(resource);
+	MemoryObjDesc::Deleter deleter = result.resource.get_deleter();
+	std::shared_ptr<State> state = m_state;
+	result.resource = MemoryObjDesc::UniqPtr(result.resource.release(), [state, &pool, desc, users, allocation, deleter](gxapi::IResource* ptr) {
+		deleter(ptr);
+		std::lock_guard<std::mutex> lock(state->mtx);
+		state->Release({ desc, users, &pool, allocation });
+	});
+
+	return result;
+}
+
+
+bool TransientHeap::IsSameDesc(const gxapi::ResourceDesc& desc1, const gxapi::ResourceDesc& desc2) {
+	const gxapi::TextureDesc& tex1 = desc1.textureDesc;
+	const gxapi::TextureDesc& tex2 = desc2.textureDesc;
+	return desc1.type == desc2.type
+		&& tex1.dimension == tex2.dimension
+		&& tex1.alignment == tex2.alignment
+		&& tex1.width == tex2.width
+		&& tex1.height == tex2.height
+		&& tex1.depthOrArraySize == tex2.depthOrArraySize
+		&& tex1.mipLevels == tex2.mipLevels
+		&& tex1.format == tex2.format
+		&& tex1.layout == tex2.layout
+		&& tex1.flags == tex2.flags
+		&& tex1.multisampleCount == tex2.multisampleCount
+		&& tex1.multisampleQuality == tex2.multisampleQuality;
+}
+
+
+void TransientHeap::ReleaseEmptyHeaps() {
+	for (Pool* pool : { &m_state->targetPool, &m_state->texturePool }) {
+		for (uint32_t page : pool->layout.ReleaseEmptyPages()) {
+			pool->heaps[page].reset();
+		}
+	}
+}
+
+
+} // namespace impl
+} // namespace gxeng
+} // namespace inl
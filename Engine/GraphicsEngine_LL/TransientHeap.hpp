@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../GraphicsApi_LL/IGraphicsApi.hpp"
+#include "../GraphicsApi_LL/IResource.hpp"
+#include "../GraphicsApi_LL/IHeap.hpp"
+
+#include "MemoryObject.hpp"
+#include "TransientHeapLayout.hpp"
+#include "PipelineEventListener.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace inl {
+namespace gxeng {
+
+namespace impl {
+
+/// <summary>
+/// Creates textures that live within a frame. Textures whose uses don't overlap in the pipeline are
+/// placed over the same memory, see <see cref="TransientHeapLayout"/>. The place of released textures is kept,
+/// and an equal request gets it again, until <see cref="ReleaseUnused"/> is called. A place is only kept
+/// for reuse when the frames that might still use the released texture have completed.
+/// </summary>
+/// <remarks>
+/// The contents of a transient are undefined at the start of its first use in each frame.
+/// Users must issue an aliasing barrier for it, then clear or fully overwrite it.
+/// </remarks>
+class TransientHeap : public PipelineEventListener {
+public:
+	struct Statistics {
+		TransientHeapLayout::Statistics targets; // Render targets and depth buffers.
+		TransientHeapLayout::Statistics textures;
+		size_t recycledCount = 0; // Requests placed where an equal released texture was.
+		size_t unusedCount = 0; // Places of released textures waiting to be reused.
+		size_t releasedCount = 0; // Places of released textures waiting for the GPU.
+	};
+
+public:
+	TransientHeap(gxapi::IGraphicsApi* graphicsApi);
+
+	/// <summary> Sets the order of pipeline nodes, see <see cref="TransientHeapLayout::SetPassOrder"/>. </summary>
+	/// <exception cref="std::logic_error"> If there are transients. </exception>
+	void SetPassOrder(std::vector<std::vector<bool>> passOrder, std::vector<std::vector<unsigned>> passConsumers);
+
+	/// <param name="pass"> The index of the pipeline node creating the texture. </param>
+	/// <exception cref="std::invalid_argument"> If the resource is not a texture. </exception>
+	MemoryObjDesc Allocate(const gxapi::ResourceDesc& desc, gxapi::ClearValue* clearValue, unsigned pass, eTransientScope scope);
+
+	/// <summary> Frees the places of released textures that no one asked for again, and destroys the heaps left empty. </summary>
+	void ReleaseUnused();
+
+	Statistics GetStatistics() const;
+
+	void OnFrameBeginDevice(uint64_t frameId) override {}
+	void OnFrameBeginHost(uint64_t frameId) override;
+	void OnFrameCompleteDevice(uint64_t frameId) override;
+	void OnFrameCompleteHost(uint64_t frameId) override {}
+
+	/// <summary> Keeps the places of all released textures for reuse. Call when the GPU has finished every submitted frame. </summary>
+	void OnDeviceIdle();
+
+protected:
+	struct Pool {
+		Pool(gxapi::eHeapFlags flags) : flags(flags) {}
+		TransientHeapLayout layout;
+		std::vector<std::unique_ptr<gxapi::IHeap>> heaps; // Indexed by the layout's page.
+		gxapi::eHeapFlags flags;
+	};
+
+	struct Unused {
+		gxapi::ResourceDesc desc;
+		std::vector<unsigned> users;
+		Pool* pool;
+		TransientHeapLayout::Allocation allocation;
+	};
+
+	struct Released {
+		Unused place;
+		uint64_t frameCount; // Reusable when this many frames have completed.
+	};
+
+	// Shared with the deleters of placed textures, which may be released after the heap.
+	struct State {
+		State();
+		void Release(Unused place);
+		void KeepCompleted();
+
+		std::mutex mtx;
+		Pool targetPool;
+		Pool texturePool;
+		std::vector<Unused> unused;
+		std::deque<Released> released; // Oldest first.
+		size_t recycledCount = 0;
+		uint64_t beganFrameCount = 0; // Last frame begun on the host + 1.
+		uint64_t completedFrameCount = 0; // Last frame completed on the device + 1.
+	};
+
+	MemoryObjDesc Place(const gxapi::ResourceDesc& desc, gxapi::ClearValue* clearValue, std::vector<unsigned> users, Pool& pool, TransientHeapLayout::Allocation allocation);
+	static bool IsSameDesc(const gxapi::ResourceDesc& desc1, const gxapi::ResourceDesc& desc2);
+	void ReleaseEmptyHeaps();
+
+protected:
+	gxapi::IGraphicsApi* m_graphicsApi;
+	std::shared_ptr<State> m_state;
+};
+
+
+} // namespace impl
+} // namespace gxeng
+} // namespace inl
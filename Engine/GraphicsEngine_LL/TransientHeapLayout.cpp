@@ -0,0 +1,218 @@
+#include "TransientHeapLayout.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+
+
+namespace inl::gxeng {
+
+
+TransientHeapLayout::TransientHeapLayout()
+	: TransientHeapLayout(Desc{})
+{}
+
+
+TransientHeapLayout::TransientHeapLayout(Desc desc)
+	: m_desc(desc)
+{
+	auto isPowerOfTwo = [](uint64_t value) { return value != 0 && (value & (value - 1)) == 0; };
+	if (!isPowerOfTwo(desc.pageGranularity) || desc.pageSize < desc.pageGranularity) {
+		throw std::invalid_argument("Page granularity must be a power of two, and pages must be at least that large.");
+	}
+}
+
+
+void TransientHeapLayout::SetPassOrder(std::vector<std::vector<bool>> passOrder, std::vector<std::vector<unsigned>> passConsumers) {
+	if (m_statistics.allocationCount > 0) {
+		throw std::logic_error("Pass order can't be changed while there are allocations.");
+	}
+	for (const auto& row : passOrder) {
+		if (row.size() != passOrder.size()) {
+			throw std::invalid_argument("Pass order must be a square matrix.");
+		}
+	}
+	if (passConsumers.size() > passOrder.size()) {
+		throw std::invalid_argument("There are consumers for passes not in the order.");
+	}
+	m_passOrder = std::move(passOrder);
+	m_passConsumers = std::move(passConsumers);
+}
+
+
+std::vector<unsigned> TransientHeapLayout::GetUsers(unsigned pass, eTransientScope scope) const {
+	std::vector<unsigned> users = { pass };
+	if (scope == eTransientScope::DOWNSTREAM && pass < m_passConsumers.size()) {
+		for (unsigned consumer : m_passConsumers[pass]) {
+			if (consumer != pass) {
+				users.push_back(consumer);
+			}
+		}
+		std::sort(users.begin(), users.end());
+		users.erase(std::unique(users.begin(), users.end()), users.end());
+	}
+	else if (scope == eTransientScope::DOWNSTREAM && pass < m_passOrder.size()) {
+		for (unsigned other = 0; other < m_passOrder.size(); ++other) {
+			if (m_passOrder[pass][other]) {
+				users.push_back(other);
+			}
+		}
+		std::sort(users.begin(), users.end());
+	}
+	return users;
+}
+
+
+bool TransientHeapLayout::IsConflicting(const std::vector<unsigned>& users1, const std::vector<unsigned>& users2) const {
+	return !IsBefore(users1, users2) && !IsBefore(users2, users1);
+}
+
+
+TransientHeapLayout::Allocation TransientHeapLayout::Allocate(uint64_t size, uint64_t alignment, std::vector<unsigned> users, uint64_t& newPageSize) {
+	if (size == 0 || (alignment & (alignment - 1)) != 0) {
+		throw std::invalid_argument("Allocation size must be positive, and alignment a power of two.");
+	}
+	alignment = std::max<uint64_t>(alignment, 1);
+
+	newPageSize = 0;
+	uint32_t pageIndex = 0;
+	uint64_t offset = 0;
+	bool found = false;
+	for (; pageIndex < m_pages.size() && !found; ++pageIndex) {
+		found = m_pages[pageIndex].live && FindOffset(m_pages[pageIndex], size, alignment, users, offset);
+	}
+
+	if (found) {
+		--pageIndex;
+	}
+	else {
+		uint64_t pageSize = std::max(m_desc.pageSize, (size + m_desc.pageGranularity - 1) / m_desc.pageGranularity * m_desc.pageGranularity);
+		pageIndex = NewPage(pageSize);
+		newPageSize = pageSize;
+		offset = 0;
+	}
+
+	Page& page = m_pages[pageIndex];
+	Placed placed{ offset, size, m_nextId++, std::move(users) };
+	auto position = std::upper_bound(page.allocations.begin(), page.allocations.end(), offset, [](uint64_t offset, const Placed& placed) {
+		return offset < placed.offset;
+	});
+	page.allocations.insert(position, std::move(placed));
+
+	++m_statistics.allocationCount;
+	m_statistics.allocatedBytes += size;
+	UpdatePeaks();
+
+	return Allocation{ pageIndex, offset, size, m_nextId - 1 };
+}
+
+
+void TransientHeapLayout::Deallocate(const Allocation& allocation) {
+	if (allocation.page >= m_pages.size() || !m_pages[allocation.page].live) {
+		throw std::invalid_argument("Allocation's page does not exist.");
+	}
+
+	auto& allocations = m_pages[allocation.page].allocations;
+	auto it = std::find_if(allocations.begin(), allocations.end(), [&allocation](const Placed& placed) {
+		return placed.id == allocation.id;
+	});
+	if (it == allocations.end() || it->offset != allocation.offset || it->size != allocation.size) {
+		throw std::invalid_argument("Allocation does not belong to its page.");
+	}
+	allocations.erase(it);
+
+	--m_statistics.allocationCount;
+	m_statistics.allocatedBytes -= allocation.size;
+}
+
+
+std::vector<uint32_t> TransientHeapLayout::ReleaseEmptyPages() {
+	std::vector<uint32_t> released;
+
+	for (uint32_t index = 0; index < m_pages.size(); ++index) {
+		Page& page = m_pages[index];
+		if (!page.live || !page.allocations.empty()) {
+			continue;
+		}
+
+		--m_statistics.pageCount;
+		m_statistics.reservedBytes -= page.size;
+		page = Page{};
+		m_releasedPages.push_back(index);
+		released.push_back(index);
+	}
+
+	return released;
+}
+
+
+uint64_t TransientHeapLayout::GetPageSize(uint32_t page) const {
+	return page < m_pages.size() ? m_pages[page].size : 0;
+}
+
+
+TransientHeapLayout::Statistics TransientHeapLayout::GetStatistics() const {
+	return m_statistics;
+}
+
+
+bool TransientHeapLayout::IsBefore(const std::vector<unsigned>& users1, const std::vector<unsigned>& users2) const {
+	for (unsigned pass1 : users1) {
+		for (unsigned pass2 : users2) {
+			if (pass1 >= m_passOrder.size() || pass2 >= m_passOrder.size() || !m_passOrder[pass1][pass2]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+bool TransientHeapLayout::FindOffset(const Page& page, uint64_t size, uint64_t alignment, const std::vector<unsigned>& users, uint64_t& offset) const {
+	// Allocations are ordered by offset, so the gaps between conflicting ones come up from low to high.
+	uint64_t candidate = 0;
+	for (const Placed& placed : page.allocations) {
+		if (!IsConflicting(placed.users, users)) {
+			continue;
+		}
+		if (candidate + size <= placed.offset) {
+			break;
+		}
+		uint64_t end = placed.offset + placed.size;
+		candidate = std::max(candidate, (end + alignment - 1) / alignment * alignment);
+	}
+
+	offset = candidate;
+	return candidate + size <= page.size;
+}
+
+
+uint32_t TransientHeapLayout::NewPage(uint64_t size) {
+	uint32_t index;
+	if (!m_releasedPages.empty()) {
+		index = m_releasedPages.back();
+		m_releasedPages.pop_back();
+	}
+	else {
+		index = (uint32_t)m_pages.size();
+		m_pages.push_back({});
+	}
+
+	Page& page = m_pages[index];
+	page.size = size;
+	page.live = true;
+
+	++m_statistics.pageCount;
+	m_statistics.reservedBytes += size;
+
+	return index;
+}
+
+
+void TransientHeapLayout::UpdatePeaks() {
+	m_statistics.peakReservedBytes = std::max(m_statistics.peakReservedBytes, m_statistics.reservedBytes);
+	m_statistics.peakAllocatedBytes = std::max(m_statistics.peakAllocatedBytes, m_statistics.allocatedBytes);
+}
+
+
+} // namespace inl::gxeng
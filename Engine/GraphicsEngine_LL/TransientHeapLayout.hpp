@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace inl::gxeng {
+
+
+/// <summary> How long the contents of a transient resource must survive within a frame. </summary>
+enum class eTransientScope {
+	NODE, // Only the task of the node that created it uses it.
+	DOWNSTREAM, // Nodes linked to the creator's outputs read it too, possibly through pass-through ports.
+};
+
+
+/// <summary>
+/// Places transient resources into heaps so that resources whose uses don't overlap in time share memory.
+/// Only does the bookkeeping of heap pages and offsets, the caller creates the actual heaps and places the resources.
+/// </summary>
+/// <remarks>
+/// Time is given as passes, one for each pipeline node. A resource is used by the pass that created it,
+/// and, if its scope is downstream, by every pass that depends on that one. Two resources may alias
+/// if every use of one happens before every use of the other, which holds for any order the scheduler
+/// picks, not just one of them. A new resource goes to the lowest offset where it overlaps no conflicting resource.
+/// Pages are identified by index, a released page's index is reused by the next new page.
+/// Not thread safe.
+/// </remarks>
+class TransientHeapLayout {
+public:
+	struct Desc {
+		uint64_t pageSize = 64 * 1024 * 1024; // Larger resources get a page of their own size.
+		uint64_t pageGranularity = 64 * 1024;
+	};
+
+	struct Allocation {
+		uint32_t page;
+		uint64_t offset; // In bytes, from the start of the page.
+		uint64_t size;
+		uint64_t id;
+	};
+
+	struct Statistics {
+		size_t pageCount = 0;
+		size_t allocationCount = 0;
+		uint64_t reservedBytes = 0; // Total size of the pages.
+		uint64_t allocatedBytes = 0; // What the allocations would take without aliasing.
+		uint64_t peakReservedBytes = 0;
+		uint64_t peakAllocatedBytes = 0;
+	};
+
+public:
+	TransientHeapLayout();
+	explicit TransientHeapLayout(Desc desc);
+
+	/// <summary> Sets the order of passes. passOrder[a][b] is true if pass a always finishes before pass b starts. </summary>
+	/// <remarks> The relation must be transitive, like reachability in the pipeline's dependency graph.
+	///		Allocations of passes not in the order conflict with every other allocation. </remarks>
+	/// <param name="passConsumers"> The passes that read the outputs of each pass. Passes without an entry
+	///		are assumed to be read by every pass after them. </param>
+	/// <exception cref="std::logic_error"> If there are allocations, their placement would not be valid anymore. </exception>
+	void SetPassOrder(std::vector<std::vector<bool>> passOrder, std::vector<std::vector<unsigned>> passConsumers = {});
+
+	/// <summary> Returns the passes using a resource of the given pass and scope, in increasing order. </summary>
+	std::vector<unsigned> GetUsers(unsigned pass, eTransientScope scope) const;
+
+	/// <summary> True if the resources used by the given passes can't share memory. </summary>
+	bool IsConflicting(const std::vector<unsigned>& users1, const std::vector<unsigned>& users2) const;
+
+	/// <summary> Reserves space for a resource used by the given passes. </summary>
+	/// <param name="newPageSize"> Set to the size of the new page if one had to be added, the caller must create a heap for it,
+	///		otherwise set to zero. </param>
+	/// <exception cref="std::invalid_argument"> If the size is zero or the alignment is not a power of two. </exception>
+	Allocation Allocate(uint64_t size, uint64_t alignment, std::vector<unsigned> users, uint64_t& newPageSize);
+
+	/// <summary> Releases the allocation. Empty pages are kept until <see cref="ReleaseEmptyPages"/>. </summary>
+	/// <exception cref="std::invalid_argument"> If the allocation is not from this layout. </exception>
+	void Deallocate(const Allocation& allocation);
+
+	/// <summary> Frees the bookkeeping of pages that hold no allocations. </summary>
+	/// <returns> The indices of the released pages, the caller should destroy the heaps. </returns>
+	std::vector<uint32_t> ReleaseEmptyPages();
+
+	uint64_t GetPageSize(uint32_t page) const;
+
+	Statistics GetStatistics() const;
+private:
+	struct Placed {
+		uint64_t offset;
+		uint64_t size;
+		uint64_t id;
+		std::vector<unsigned> users;
+	};
+
+	struct Page {
+		uint64_t size = 0;
+		bool live = false;
+		std::vector<Placed> allocations; // Ordered by offset.
+	};
+
+	bool IsBefore(const std::vector<unsigned>& users1, const std::vector<unsigned>& users2) const;
+	bool FindOffset(const Page& page, uint64_t size, uint64_t alignment, const std::vector<unsigned>& users, uint64_t& offset) const;
+	uint32_t NewPage(uint64_t size);
+	void UpdatePeaks();
+private:
+	Desc m_desc;
+	std::vector<std::vector<bool>> m_passOrder;
+	std::vector<std::vector<unsigned>> m_passConsumers;
+	std::vector<Page> m_pages;
+	std::vector<uint32_t> m_releasedPages;
+	uint64_t m_nextId = 0;
+	Statistics m_statistics;
+};
+
+
+} // namespace inl::gxeng
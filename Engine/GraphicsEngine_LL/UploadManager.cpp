@@ -2,58 +2,76 @@
 
 #include <GraphicsApi_LL/Common.hpp>
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <cassert>
 
 namespace inl {
 namespace gxeng {
 
 
-UploadManager::UploadManager(gxapi::IGraphicsApi* graphicsApi) :
-	m_graphicsApi(graphicsApi)
+UploadManager::UploadManager(gxapi::IGraphicsApi* graphicsApi, size_t stagingSize) :
+	m_graphicsApi(graphicsApi),
+	m_stagingRing(stagingSize / 2, DUP_D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT),
+	m_backgroundRing(stagingSize / 2, DUP_D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT)
 {
 	std::lock_guard<std::mutex> lock(m_mtx);
 
-	// Add a new queue before any frame starts to handle uploads at initialization.
-	m_uploadQueues.push_back(std::vector<UploadDescription>()); 
+	// The staging ring stays mapped for the lifetime of the manager.
+	// Keeping upload heap resources mapped is allowed, and saves a Map/Unmap pair per upload.
+	m_stagingBuffer = LinearBuffer(MemoryObjDesc(
+		m_graphicsApi->CreateCommittedResource(
+			gxapi::HeapProperties(gxapi::eHeapType::UPLOAD),
+			gxapi::eHeapFlags::NONE,
+			gxapi::ResourceDesc::Buffer(m_stagingRing.GetSize() + m_backgroundRing.GetSize()),
+			//NOTE: GENERIC_READ is the required starting state for upload heap resources according to msdn
+			// (also there is no need for resource state transition)
+			gxapi::eResourceState::GENERIC_READ
+		)
+	));
+	gxapi::MemoryRange noReadRange{0, 0};
+	m_stagingCpuAddress = reinterpret_cast<uint8_t*>(m_stagingBuffer._GetResourcePtr()->Map(0, &noReadRange));
+
+	// A single chunk may not take the whole ring, otherwise the uploads of
+	// a frame could not make progress while the previous frame is in flight.
+	m_maxChunkSize = m_stagingRing.GetSize() / 4;
+	m_statistics.stagingSize = m_stagingRing.GetSize() + m_backgroundRing.GetSize();
+}
+
+
+UploadManager::~UploadManager() {
+	m_stagingBuffer._GetResourcePtr()->Unmap(0, nullptr);
 }
 
 
-void UploadManager::Upload(const LinearBuffer& target, size_t offset, const void* data, size_t size) {
+void UploadManager::Upload(const LinearBuffer& target, size_t offset, const void* data, size_t size, Priority priority) {
 	if (target.GetSize() < (offset+size)) {
 		throw inl::gxapi::InvalidArgument("Target buffer is not large enough for the uploaded data to fit.", "target");
 	}
 
-	MemoryObjDesc uploadObjDesc(
-		m_graphicsApi->CreateCommittedResource(
-			gxapi::HeapProperties(gxapi::eHeapType::UPLOAD),
-			gxapi::eHeapFlags::NONE,
-			gxapi::ResourceDesc::Buffer(size),
-			//NOTE: GENERIC_READ is the required starting state for upload heap resources according to msdn
-			// (also there is no need for resource state transition)
-			gxapi::eResourceState::GENERIC_READ 
-		)
-	);
-	auto uploadResource = uploadObjDesc.resource.get();
-	{
-		std::lock_guard<std::mutex> lock(m_mtx);
+	auto byteData = reinterpret_cast<const uint8_t*>(data);
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	++m_statistics.uploadCount;
+
+	// Large buffers are split into chunks that fit the staging ring.
+	for (size_t chunkOffset = 0; chunkOffset < size; chunkOffset += m_maxChunkSize) {
+		size_t chunkSize = std::min(m_maxChunkSize, size - chunkOffset);
+
+		StagingRange staging = AllocateStaging(chunkSize, priority, lock);
+		memcpy(staging.cpuAddress, byteData + chunkOffset, chunkSize);
 
-		auto& currQueue = m_uploadQueues.back();
-		
 		UploadDescription uploadDesc(
-			LinearBuffer(std::move(uploadObjDesc)),
+			std::move(staging.buffer),
+			staging.offset,
 			target,
-			offset
+			offset + chunkOffset,
+			chunkSize
 		);
 
-		currQueue.push_back(std::move(uploadDesc));
+		Enqueue(std::move(uploadDesc), priority, chunkSize);
 	}
-
-	gxapi::MemoryRange noReadRange{0, 0};
-	void* stagePtr = uploadResource->Map(0, &noReadRange);
-	memcpy(stagePtr, data, size);
-	// Theres no need to unmap but leaving a resource mapped has a performance hit while debugging
-	// see https://msdn.microsoft.com/en-us/library/windows/desktop/dn899215(v=vs.85).aspx#mapping_and_unmapping
-	uploadResource->Unmap(0, nullptr);
 }
 
 
@@ -65,55 +83,112 @@ void UploadManager::Upload(
 	uint64_t width,
 	uint32_t height,
 	gxapi::eFormat format,
-	size_t bytesPerRow
+	size_t bytesPerRow,
+	Priority priority
+) {
+	auto rowSize = gxapi::GetFormatRowSizeInBytes(format, width);
+	size_t srcPitch = bytesPerRow > 0 ? bytesPerRow : rowSize;
+	auto byteData = reinterpret_cast<const uint8_t*>(data);
+
+	auto CopyRows = [&](uint32_t firstRow, uint32_t numRows, uint8_t* destination, size_t destinationPitch) {
+		for (size_t y = 0; y < numRows; y++) {
+			memcpy(destination + destinationPitch*y, byteData + srcPitch*(firstRow + y), rowSize);
+		}
+	};
+	UploadTexture(target, 0, offsetX, offsetY, width, height, format, CopyRows, priority);
+}
+
+
+void UploadManager::Upload(
+	const Texture2D& target,
+	uint32_t offsetX,
+	uint32_t offsetY,
+	uint64_t width,
+	uint32_t height,
+	gxapi::eFormat format,
+	const RowWriter& writeRows,
+	Priority priority
+) {
+	UploadTexture(target, 0, offsetX, offsetY, width, height, format, writeRows, priority);
+}
+
+
+void UploadManager::UploadMip(const Texture2D& target, uint32_t mipLevel, const void* data, size_t bytesPerRow, Priority priority) {
+	if (mipLevel >= target.GetDescription().textureDesc.mipLevels) {
+		throw inl::gxapi::InvalidArgument("Texture does not have that many mip levels.", "mipLevel");
+	}
+
+	gxapi::eFormat format = target.GetFormat();
+	uint64_t width = std::max<uint64_t>(1, target.GetWidth() >> mipLevel);
+	uint32_t height = std::max<uint32_t>(1, (uint32_t)target.GetHeight() >> mipLevel);
+
+	auto rowSize = gxapi::GetFormatRowSizeInBytes(format, width);
+	size_t srcPitch = bytesPerRow > 0 ? bytesPerRow : rowSize;
+	auto byteData = reinterpret_cast<const uint8_t*>(data);
+
+	auto CopyRows = [&](uint32_t firstRow, uint32_t numRows, uint8_t* destination, size_t destinationPitch) {
+		for (size_t y = 0; y < numRows; y++) {
+			memcpy(destination + destinationPitch*y, byteData + srcPitch*(firstRow + y), rowSize);
+		}
+	};
+	UploadTexture(target, mipLevel, 0, 0, width, height, format, CopyRows, priority);
+}
+
+
+void UploadManager::UploadTexture(
+	const Texture2D& target,
+	uint32_t mipLevel,
+	uint32_t offsetX,
+	uint32_t offsetY,
+	uint64_t width,
+	uint32_t height,
+	gxapi::eFormat format,
+	const RowWriter& writeRows,
+	Priority priority
 ) {
-	if (target.GetWidth() < (offsetX + width) || target.GetHeight() < (offsetY + height)) {
+	uint64_t targetWidth = std::max<uint64_t>(1, target.GetWidth() >> mipLevel);
+	uint32_t targetHeight = std::max<uint32_t>(1, (uint32_t)target.GetHeight() >> mipLevel);
+	if (targetWidth < (offsetX + width) || targetHeight < (offsetY + height)) {
 		throw inl::gxapi::InvalidArgument("Uploaded data does not fit inside target texture. (Uploaded size or offset is too large)", "target");
 	}
 
-	auto pixelSize = gxapi::GetFormatSizeInBytes(format);
-	auto rowSize = width * pixelSize;
+	// Compressed textures are copied in rows of 4x4 blocks.
+	uint32_t blockSize = gxapi::GetFormatBlockSize(format);
+	uint32_t blockRows = (height + blockSize - 1) / blockSize;
+	auto rowSize = gxapi::GetFormatRowSizeInBytes(format, width);
 	size_t rowPitch = SnapUpwrads(rowSize, DUP_D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
-	auto requiredSize = bytesPerRow > 0 ? bytesPerRow : rowPitch * height;
 
-	MemoryObjDesc uploadObjDesc = MemoryObjDesc(
-		m_graphicsApi->CreateCommittedResource(
-			gxapi::HeapProperties(gxapi::eHeapType::UPLOAD),
-			gxapi::eHeapFlags::NONE,
-			gxapi::ResourceDesc::Buffer(requiredSize),
-			//NOTE: GENERIC_READ is the required starting state for upload heap resources according to msdn
-			// (also there is no need for resource state transition)
-			gxapi::eResourceState::GENERIC_READ 
-		)
-	);
-	auto uploadResource = uploadObjDesc.resource.get();
-	{
-		std::lock_guard<std::mutex> lock(m_mtx);
+	std::unique_lock<std::mutex> lock(m_mtx);
+	++m_statistics.uploadCount;
+
+	// Large textures are split into bands of whole rows that fit the staging ring.
+	// A single row that is larger than a chunk gets its own staging resource.
+	uint32_t rowsPerChunk = (uint32_t)std::max(size_t(1), std::min(size_t(blockRows), m_maxChunkSize / rowPitch));
 
-		auto& currQueue = m_uploadQueues.back();
+	for (uint32_t firstRow = 0; firstRow < blockRows; firstRow += rowsPerChunk) {
+		uint32_t numRows = std::min(rowsPerChunk, blockRows - firstRow);
+		uint32_t numPixelRows = std::min(numRows * blockSize, height - firstRow * blockSize);
+
+		StagingRange staging = AllocateStaging(rowPitch * numRows, priority, lock);
+
+		// The range stays reserved until it is queued and taken, so the rows are written without
+		// holding up other uploads. Converting them is the slow part of a texture upload.
+		lock.unlock();
+		writeRows(firstRow, numRows, staging.cpuAddress, rowPitch);
+		lock.lock();
 
 		UploadDescription uploadDesc(
-			LinearBuffer(std::move(uploadObjDesc)),
+			std::move(staging.buffer),
 			target,
 			offsetX,
-			offsetY,
+			offsetY + firstRow * blockSize,
 			0,
-			gxapi::TextureCopyDesc::Buffer(format, width, height, 1, 0)
+			gxapi::TextureCopyDesc::Buffer(format, width, numPixelRows, 1, staging.offset),
+			mipLevel
 		);
 
-		currQueue.push_back(std::move(uploadDesc));
-
-		currQueue.back().source._SetResident(true);
-	}
-
-	gxapi::MemoryRange noReadRange{0, 0};
-	auto stagePtr = reinterpret_cast<uint8_t*>(uploadResource->Map(0, &noReadRange));
-	auto byteData = reinterpret_cast<const uint8_t*>(data);
-	//copy texture row-by-row
-	for (size_t y = 0; y < height; y++) {
-		memcpy(stagePtr + rowPitch*y, byteData + rowSize*y, rowSize);
+		Enqueue(std::move(uploadDesc), priority, rowPitch * numRows);
 	}
-	uploadResource->Unmap(0, nullptr);
 }
 
 
@@ -122,12 +197,40 @@ void UploadManager::OnFrameBeginDevice(uint64_t frameId) {
 
 
 void UploadManager::OnFrameBeginHost(uint64_t frameId) {
-	std::lock_guard<std::mutex> lock(m_mtx);
-	m_uploadQueues.push_back(std::vector<UploadDescription>());
 }
 
 
 void UploadManager::OnFrameCompleteDevice(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_stagingRing.ReleaseFrames(frameId);
+	m_completedFrames = std::max(m_completedFrames, frameId + 1);
+	ReleaseBackgroundFrames();
+	UpdateStagingStatistics();
+	m_stagingReleased.notify_all();
+}
+
+
+void UploadManager::_OnBackgroundUploadsComplete(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_completedBackgroundFrames = std::max(m_completedBackgroundFrames, frameId + 1);
+	ReleaseBackgroundFrames();
+	UpdateStagingStatistics();
+	m_stagingReleased.notify_all();
+}
+
+
+void UploadManager::ReleaseBackgroundFrames() {
+	// Uploads of the background ring may have been recorded on the graphics queue as well,
+	// so both the frame and its copy queue work must be done.
+	uint64_t completed = std::min(m_completedFrames, m_completedBackgroundFrames);
+	if (completed > 0) {
+		m_backgroundRing.ReleaseFrames(completed - 1);
+	}
+}
+
+
+void UploadManager::UpdateStagingStatistics() {
+	m_statistics.stagingUsed = m_stagingRing.GetUsedSize() + m_backgroundRing.GetUsedSize();
 }
 
 
@@ -135,18 +238,130 @@ void UploadManager::OnFrameCompleteHost(uint64_t frameId) {
 }
 
 
-std::vector<UploadManager::UploadDescription> UploadManager::_TakeQueuedUploads() {
+void UploadManager::SetFrameBudget(size_t bytesPerFrame) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_frameBudget = bytesPerFrame;
+}
+
+
+size_t UploadManager::GetFrameBudget() const {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_frameBudget;
+}
+
+
+std::vector<UploadManager::UploadDescription> UploadManager::_TakeQueuedUploads(uint64_t frameId) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	// Uploads to the same destination must stay in order, so each of them gets
+	// the most urgent priority among the uploads to that destination.
+	std::unordered_map<const gxapi::IResource*, Priority> destinationPriorities;
+	for (const auto& upload : m_pendingUploads) {
+		auto it = destinationPriorities.insert({ upload.destination._GetResourcePtr(), upload.priority }).first;
+		it->second = std::min(it->second, upload.priority);
+	}
+	std::stable_sort(m_pendingUploads.begin(), m_pendingUploads.end(), [&destinationPriorities](const UploadDescription& lhs, const UploadDescription& rhs) {
+		return destinationPriorities.at(lhs.destination._GetResourcePtr()) < destinationPriorities.at(rhs.destination._GetResourcePtr());
+	});
+
+	// Take uploads until the budget runs out. Once an upload is deferred, all later
+	// uploads to the same destination must be deferred as well.
 	std::vector<UploadDescription> result;
-	{
-		std::lock_guard<std::mutex> lock(m_mtx);
-		assert(!m_uploadQueues.empty());
-		result = std::move(m_uploadQueues.front());
-		m_uploadQueues.pop_front();
+	std::vector<UploadDescription> deferred;
+	std::unordered_set<const gxapi::IResource*> deferredDestinations;
+	size_t scheduledBytes = 0;
+
+	for (auto& upload : m_pendingUploads) {
+		const gxapi::IResource* destination = upload.destination._GetResourcePtr();
+		bool isVisible = destinationPriorities.at(destination) == Priority::VISIBLE;
+		bool fitsBudget = isVisible || scheduledBytes == 0 || scheduledBytes + upload.numBytes <= m_frameBudget;
+
+		if (fitsBudget && deferredDestinations.count(destination) == 0) {
+			scheduledBytes += upload.numBytes;
+			// The taken uploads are executed in the frame that takes them.
+			if (upload.source == m_stagingBuffer) {
+				if (upload.srcOffset < m_stagingRing.GetSize()) {
+					m_stagingRing.Retire(upload.srcOffset, frameId);
+				}
+				else {
+					m_backgroundRing.Retire(upload.srcOffset - m_stagingRing.GetSize(), frameId);
+				}
+			}
+			result.push_back(std::move(upload));
+		}
+		else {
+			deferredDestinations.insert(destination);
+			deferred.push_back(std::move(upload));
+		}
 	}
+	m_pendingUploads = std::move(deferred);
+
+	m_statistics.pendingCount = m_pendingUploads.size();
+	m_statistics.lastFrameBytes = scheduledBytes;
+
 	return result;
 }
 
 
+UploadManager::Statistics UploadManager::GetStatistics() const {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_statistics;
+}
+
+
+UploadManager::StagingRange UploadManager::AllocateStaging(size_t size, Priority priority, std::unique_lock<std::mutex>& lock) {
+	assert(lock.owns_lock());
+
+	++m_statistics.chunkCount;
+	m_statistics.bytesStaged += size;
+
+	// The priority of the queued upload may still be raised to VISIBLE by a later upload to the same
+	// destination, that only delays the recycling of its staging memory until the copy queue is done.
+	StagingRingAllocator& ring = priority == Priority::VISIBLE ? m_stagingRing : m_backgroundRing;
+	size_t ringOffset = &ring == &m_backgroundRing ? m_stagingRing.GetSize() : 0;
+
+	size_t offset;
+	while (!ring.TryAllocate(size, offset)) {
+		if (!ring.HasRetiredAllocations() || size > m_maxChunkSize) {
+			// Nothing is going to be freed before the queued uploads are executed,
+			// fall back to a dedicated staging resource.
+			++m_statistics.fallbackCount;
+			m_statistics.fallbackBytes += size;
+
+			LinearBuffer buffer(MemoryObjDesc(
+				m_graphicsApi->CreateCommittedResource(
+					gxapi::HeapProperties(gxapi::eHeapType::UPLOAD),
+					gxapi::eHeapFlags::NONE,
+					gxapi::ResourceDesc::Buffer(size),
+					gxapi::eResourceState::GENERIC_READ
+				)
+			));
+			// The resource stays mapped until it is released after the copy command that reads it has finished.
+			gxapi::MemoryRange noReadRange{0, 0};
+			uint8_t* cpuAddress = reinterpret_cast<uint8_t*>(buffer._GetResourcePtr()->Map(0, &noReadRange));
+			return { std::move(buffer), cpuAddress, 0 };
+		}
+
+		// Wait for the GPU to finish a frame and give back some space.
+		++m_statistics.stallCount;
+		m_stagingReleased.wait(lock);
+	}
+
+	UpdateStagingStatistics();
+	offset += ringOffset;
+	return { m_stagingBuffer, m_stagingCpuAddress + offset, offset };
+}
+
+
+void UploadManager::Enqueue(UploadDescription&& upload, Priority priority, size_t numBytes) {
+	upload.priority = priority;
+	upload.numBytes = numBytes;
+	upload.destination._AddPendingUpload();
+	m_pendingUploads.push_back(std::move(upload));
+	m_statistics.pendingCount = m_pendingUploads.size();
+}
+
+
 size_t UploadManager::SnapUpwrads(size_t value, size_t gridSize) {
 	// alignement should be power of two
 	assert(((gridSize-1) & gridSize) == 0);
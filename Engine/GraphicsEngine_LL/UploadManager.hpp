@@ -2,10 +2,13 @@
 
 #include "PipelineEventListener.hpp"
 #include "MemoryObject.hpp"
+#include "StagingRingAllocator.hpp"
 
 #include <utility>
 #include <mutex>
-#include <deque>
+#include <condition_variable>
+#include <vector>
+#include <functional>
 
 namespace inl {
 namespace gxeng {
@@ -14,26 +17,47 @@ namespace gxeng {
 class UploadManager : public PipelineEventListener {
 public:
 	enum class DestType { BUFFER, TEXTURE_2D };
+
+	/// <summary> Decides the order in which queued uploads are given to the GPU. </summary>
+	enum class Priority {
+		VISIBLE = 0, // The data is needed for rendering right away. Not limited by the frame budget.
+		NORMAL = 1,
+		PREFETCH = 2, // The data will likely be needed later, uses the budget left over by others.
+	};
+
 	struct UploadDescription {
 		UploadDescription(LinearBuffer&& source,
+						  size_t sourceOffset,
 						  const LinearBuffer& destination,
-						  size_t bufferOffset) :
+						  size_t bufferOffset,
+						  size_t numBytes) :
 			source(std::move(source)),
+			srcOffset(sourceOffset),
+			numBytes(numBytes),
 			destination(destination),
 			destType(DestType::BUFFER),
-			dstOffsetX(bufferOffset) {}
+			dstOffsetX(bufferOffset),
+			priority(Priority::NORMAL) {}
 
 		UploadDescription(LinearBuffer&& source,
 						  const Texture2D& destination,
 						  size_t dstOffsetX, uint32_t dstOffsetY, uint32_t dstOffsetZ,
-						  gxapi::TextureCopyDesc textureBufferDesc) :
+						  gxapi::TextureCopyDesc textureBufferDesc,
+						  uint32_t dstMipLevel = 0) :
 			source(std::move(source)),
+			srcOffset(textureBufferDesc.byteOffset),
+			numBytes(0),
 			destination(destination),
 			destType(DestType::TEXTURE_2D),
 			dstOffsetX(dstOffsetX), dstOffsetY(dstOffsetY), dstOffsetZ(dstOffsetZ),
-			textureBufferDesc(textureBufferDesc) {}
+			dstMipLevel(dstMipLevel),
+			textureBufferDesc(textureBufferDesc),
+			priority(Priority::NORMAL) {}
 		
+		// The source is usually a range of the shared staging ring.
 		LinearBuffer source;
+		size_t srcOffset;
+		size_t numBytes; // staged bytes, for buffers also the size of the copy
 
 		// Destination is a weak pointer because it might get deleted before
 		// the graphics engine starts to process the request.
@@ -43,17 +67,52 @@ public:
 		size_t dstOffsetX; // also offset in linear buffer
 		uint32_t dstOffsetY;
 		uint32_t dstOffsetZ;
+		uint32_t dstMipLevel = 0;
 
 		gxapi::TextureCopyDesc textureBufferDesc;
+
+		Priority priority;
+	};
+
+	struct Statistics {
+		uint64_t uploadCount = 0; // Number of Upload calls.
+		uint64_t chunkCount = 0; // Number of copy commands the uploads were split into.
+		uint64_t bytesStaged = 0; // Bytes written into staging memory.
+		uint64_t stallCount = 0; // Times an upload had to wait for the GPU to free up the staging ring.
+		uint64_t fallbackCount = 0; // Chunks that got a dedicated staging resource because the ring was full.
+		uint64_t fallbackBytes = 0;
+		size_t stagingSize = 0;
+		size_t stagingUsed = 0;
+		size_t pendingCount = 0; // Uploads waiting in the queue, deferred because of the frame budget.
+		uint64_t lastFrameBytes = 0; // Bytes scheduled in the last frame.
 	};
 
 public:
-	UploadManager(gxapi::IGraphicsApi* graphicsApi);
+	UploadManager(gxapi::IGraphicsApi* graphicsApi, size_t stagingSize = DEFAULT_STAGING_SIZE);
+	~UploadManager();
 
-	void Upload(const LinearBuffer& target, size_t offset, const void* data, size_t size);
+	void Upload(const LinearBuffer& target, size_t offset, const void* data, size_t size, Priority priority = Priority::NORMAL);
 
 	// The pixels from the source image must be in row-major order inside memory.
-	void Upload(const Texture2D& target, uint32_t offsetX, uint32_t offsetY, const void* data, uint64_t width, uint32_t height, gxapi::eFormat format, size_t bytesPerRow = 0);
+	void Upload(const Texture2D& target, uint32_t offsetX, uint32_t offsetY, const void* data, uint64_t width, uint32_t height, gxapi::eFormat format, size_t bytesPerRow = 0, Priority priority = Priority::NORMAL);
+
+	/// <summary> Fills a band of rows of the staging memory. The rows are relative to the uploaded region,
+	///		for block compressed formats they are rows of blocks. </summary>
+	using RowWriter = std::function<void(uint32_t firstRow, uint32_t numRows, uint8_t* destination, size_t destinationPitch)>;
+
+	/// <summary> Same as the other texture upload, but the pixels are written straight into the staging memory
+	///		by the callback, so that pixels that have to be converted are not copied again. </summary>
+	/// <remarks> The callback is invoked without the manager's lock, other threads may upload while it runs. </remarks>
+	void Upload(const Texture2D& target, uint32_t offsetX, uint32_t offsetY, uint64_t width, uint32_t height, gxapi::eFormat format, const RowWriter& writeRows, Priority priority = Priority::NORMAL);
+
+	/// <summary> Uploads a whole mip level in the texture's format, block compressed formats included. </summary>
+	/// <param name="bytesPerRow"> Pitch of the rows (of blocks) in the data, zero if they are tightly packed. </param>
+	void UploadMip(const Texture2D& target, uint32_t mipLevel, const void* data, size_t bytesPerRow = 0, Priority priority = Priority::NORMAL);
+
+	/// <summary> Sets how many bytes of NORMAL and PREFETCH uploads are given to the GPU per frame.
+	///		At least one upload is scheduled each frame, even if it is larger than the budget. </summary>
+	void SetFrameBudget(size_t bytesPerFrame);
+	size_t GetFrameBudget() const;
 
 	void OnFrameBeginDevice(uint64_t frameId) override;
 	void OnFrameBeginHost(uint64_t frameId) override;
@@ -62,18 +121,65 @@ public:
 
 	//const std::vector<UploadDescription>& _GetQueuedUploads();
 
-	/// <summary>Removes the least recent upload queue, and returns it to the caller.</summary>
-	std::vector<UploadDescription> _TakeQueuedUploads();
+	/// <summary>Removes the uploads that fit into the budget of the current frame from the queue,
+	///		and returns them to the caller ordered by priority. The rest stays queued for later frames.</summary>
+	/// <param name="frameId"> The frame that executes the returned uploads, the same id that
+	///		<see cref="OnFrameCompleteDevice"/> is called with when the frame finishes. </param>
+	/// <remarks>The staging memory of VISIBLE uploads is recycled when frameId completes on the device,
+	///		those copies must be finished within that frame. The staging memory of the rest is recycled
+	///		once <see cref="_OnBackgroundUploadsComplete"/> is called for frameId as well.
+	///		Frame ids must not decrease between calls.
+	///		Uploads to the same destination are always returned in the order they were queued.</remarks>
+	std::vector<UploadDescription> _TakeQueuedUploads(uint64_t frameId);
+
+	/// <summary> Tells that the copies of the uploads taken up to and including frameId, which may run
+	///		past the end of their frame, have finished. Must be called with non-decreasing frame ids. </summary>
+	void _OnBackgroundUploadsComplete(uint64_t frameId);
+
+	Statistics GetStatistics() const;
 protected:
+	struct StagingRange {
+		LinearBuffer buffer;
+		uint8_t* cpuAddress;
+		size_t offset;
+	};
+
 	gxapi::IGraphicsApi* m_graphicsApi;
-	std::deque<std::vector<UploadDescription>> m_uploadQueues;
+	std::vector<UploadDescription> m_pendingUploads;
+	size_t m_frameBudget = DEFAULT_FRAME_BUDGET;
 
-	std::mutex m_mtx;
+	// The staging buffer is split into two rings. Background uploads may take several frames on the copy queue,
+	// and would hold up the recycling of everything allocated after them if they shared a ring with the rest.
+	LinearBuffer m_stagingBuffer;
+	uint8_t* m_stagingCpuAddress;
+	StagingRingAllocator m_stagingRing; // VISIBLE uploads, recycled in frame order.
+	StagingRingAllocator m_backgroundRing; // Other uploads, placed after the staging ring in the buffer.
+	size_t m_maxChunkSize;
+	uint64_t m_completedFrames = 0; // Frames finished on the device.
+	uint64_t m_completedBackgroundFrames = 0; // Frames whose background uploads have finished.
+
+	Statistics m_statistics;
+
+	mutable std::mutex m_mtx;
+	std::condition_variable m_stagingReleased;
+
+public:
+	static constexpr size_t DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+	static constexpr size_t DEFAULT_FRAME_BUDGET = 8 * 1024 * 1024;
 
 protected:
 	static constexpr int DUP_D3D12_TEXTURE_DATA_PITCH_ALIGNMENT = 256;
+	static constexpr int DUP_D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT = 512;
 
 private:
+	/// <summary> Reserves staging memory, waits for the GPU if the ring is temporarily full. Lock must be held. </summary>
+	StagingRange AllocateStaging(size_t size, Priority priority, std::unique_lock<std::mutex>& lock);
+	/// <summary> Recycles the background ring up to the last frame that both rendered and finished its copies. Lock must be held. </summary>
+	void ReleaseBackgroundFrames();
+	void UpdateStagingStatistics();
+	void UploadTexture(const Texture2D& target, uint32_t mipLevel, uint32_t offsetX, uint32_t offsetY, uint64_t width, uint32_t height, gxapi::eFormat format, const RowWriter& writeRows, Priority priority);
+	/// <summary> Queues the upload, and hides its destination from the render nodes until it is done. Lock must be held. </summary>
+	void Enqueue(UploadDescription&& upload, Priority priority, size_t numBytes);
 	static size_t SnapUpwrads(size_t value, size_t gridSize);
 };
 
@@ -2,14 +2,169 @@
 
 #include <AssetLibrary/Model.hpp>
 #include "AssetLibrary/Image.hpp"
+#include "AssetLibrary/TextureCooker.hpp"
+#include "AssetLibrary/MeshCooker.hpp"
+#include "GraphicsEngine_LL/OcclusionCuller.hpp"
 
 #include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
 #include <random>
 
 inline float rand2() {
 	return (rand() / float(RAND_MAX)) * 2 - 1;
 }
 
+// Reads a cooked file if there is one, the decode stage cooks the asset otherwise.
+static std::vector<uint8_t> ReadCookedFile(const std::string& cookedPath) {
+	std::ifstream file(cookedPath, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return {};
+	}
+	std::vector<uint8_t> data((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)data.data(), data.size());
+	return data;
+}
+
+// Identifies the version of a source file by its modification time and size.
+// Zero if the source is missing, then whatever was cooked is used.
+static uint64_t GetSourceStamp(const std::string& path) {
+	namespace fs = std::experimental::filesystem;
+	std::error_code error;
+	auto lastWriteTime = fs::last_write_time(path, error);
+	if (error) {
+		return 0;
+	}
+	uint64_t size = fs::file_size(path, error);
+	if (error) {
+		return 0;
+	}
+	uint64_t stamp = (uint64_t)lastWriteTime.time_since_epoch().count() * 0x9E3779B97F4A7C15ull ^ size;
+	return stamp != 0 ? stamp : 1;
+}
+
+// Places every instance of a cooked model's submeshes into one vertex and index list.
+// The simulator's entities draw a single mesh each, so shared submeshes are copied for each of their instances.
+static inl::asset::MeshCooker::Submesh BakeInstances(const inl::asset::CookedModel& cooked) {
+	using namespace inl::asset;
+
+	MeshCooker::Submesh baked;
+	for (unsigned instanceID = 0; instanceID < cooked.InstanceCount(); ++instanceID) {
+		const CookedInstance& instance = cooked.GetInstance(instanceID);
+		const CookedSubmesh& submesh = cooked.GetSubmesh(instance.submeshID);
+		mathfu::Matrix4x4f transform(instance.transform);
+		mathfu::Matrix4x4f normalTransform = transform.Inverse().Transpose();
+
+		uint32_t firstVertex = (uint32_t)baked.vertices.size();
+		for (uint32_t i = 0; i < submesh.vertexCount; ++i) {
+			CookedVertex vertex = submesh.vertices[i];
+			mathfu::Vector3f position = (transform * mathfu::Vector4f(vertex.position[0], vertex.position[1], vertex.position[2], 1.0f)).xyz();
+			mathfu::Vector3f normal = (normalTransform * mathfu::Vector4f(vertex.normal[0], vertex.normal[1], vertex.normal[2], 0.0f)).xyz().Normalized();
+			for (int axis = 0; axis < 3; ++axis) {
+				vertex.position[axis] = position[axis];
+				vertex.normal[axis] = normal[axis];
+			}
+			baked.vertices.push_back(vertex);
+		}
+		for (uint32_t i = 0; i < submesh.indexCount; ++i) {
+			baked.indices.push_back(firstVertex + submesh.indices[i]);
+		}
+	}
+	return baked;
+}
+
+// Models are cooked next to the source file the first time and when it changes, other runs read the cooked vertices and indices.
+// Occluders keep a copy of their triangles on the CPU, to hide entities behind them before they're drawn.
+static auto LoadCookedMesh(inl::gxeng::AssetLoader& loader, inl::gxeng::GraphicsEngine* graphicsEngine,
+						   const std::string& path, inl::asset::CoordSysLayout coordSysLayout, const inl::gxeng::Mesh::LodDesc& lodDesc = {},
+						   bool occluder = false) {
+	using namespace inl::asset;
+	using inl::gxeng::eVertexElementSemantic;
+
+	std::string cookedPath = path + ".mesh";
+	auto read = [cookedPath] {
+		return ReadCookedFile(cookedPath);
+	};
+	auto decode = [path, cookedPath, coordSysLayout](std::vector<uint8_t> data) {
+		// A cooked file of an older source is cooked again.
+		uint64_t sourceStamp = GetSourceStamp(path);
+		try {
+			CookedModel cooked = CookedModel::Parse(data.data(), data.size());
+			if (sourceStamp != 0 && cooked.GetSourceStamp() != sourceStamp) {
+				throw std::runtime_error("Cooked model is out of date.");
+			}
+		}
+		catch (std::runtime_error&) {
+			data = Model(path).Cook(coordSysLayout, sourceStamp);
+			std::ofstream(cookedPath, std::ios::binary).write((const char*)data.data(), data.size());
+		}
+		return BakeInstances(CookedModel::Parse(data.data(), data.size()));
+	};
+	auto upload = [graphicsEngine, lodDesc, occluder](MeshCooker::Submesh baked) {
+		static const std::vector<inl::gxeng::Mesh::Element> elements = {
+			{ eVertexElementSemantic::POSITION, 0, (int)offsetof(CookedVertex, position) },
+			{ eVertexElementSemantic::NORMAL, 0, (int)offsetof(CookedVertex, normal) },
+			{ eVertexElementSemantic::TEX_COORD, 0, (int)offsetof(CookedVertex, texCoord) },
+		};
+		std::unique_ptr<inl::gxeng::Mesh> mesh(graphicsEngine->CreateMesh());
+		mesh->Set(baked.vertices.data(), baked.vertices.size(), sizeof(CookedVertex), elements, baked.indices.data(), baked.indices.size(), lodDesc);
+		if (occluder) {
+			auto occluderMesh = std::make_shared<inl::gxeng::OccluderMesh>();
+			for (const CookedVertex& vertex : baked.vertices) {
+				occluderMesh->positions.push_back({ vertex.position[0], vertex.position[1], vertex.position[2] });
+			}
+			occluderMesh->indices = std::move(baked.indices);
+			mesh->SetOccluder(std::move(occluderMesh));
+		}
+		return mesh;
+	};
+	return loader.Load(0, read, decode, upload);
+}
+
+// Images are cooked next to the source file the first time and when it changes, other runs read the cooked mips.
+static auto LoadCookedImage(inl::gxeng::AssetLoader& loader, inl::gxeng::GraphicsEngine* graphicsEngine, const std::string& path) {
+	using namespace inl::asset;
+
+	std::string cookedPath = path + ".tex";
+	auto read = [cookedPath] {
+		return ReadCookedFile(cookedPath);
+	};
+	auto decode = [path, cookedPath](std::vector<uint8_t> data) {
+		uint64_t sourceStamp = GetSourceStamp(path);
+		try {
+			CookedTexture cooked = CookedTexture::Parse(data.data(), data.size());
+			if (sourceStamp != 0 && cooked.GetSourceStamp() != sourceStamp) {
+				throw std::runtime_error("Cooked texture is out of date.");
+			}
+		}
+		catch (std::runtime_error&) {
+			Image source(path);
+			bool isBlockAligned = source.GetWidth() % 4 == 0 && source.GetHeight() % 4 == 0;
+
+			TextureCooker::Options options;
+			options.compression = isBlockAligned ? eTextureCompression::BC1 : eTextureCompression::NONE;
+			options.filter = eMipFilter::KAISER;
+			options.sourceStamp = sourceStamp;
+			data = TextureCooker::Cook((const uint8_t*)source.GetData(), (uint32_t)source.GetWidth(), (uint32_t)source.GetHeight(),
+									   (int)source.GetChannelCount(), source.GetBytesPerRow(), options);
+			std::ofstream(cookedPath, std::ios::binary).write((const char*)data.data(), data.size());
+		}
+		return data;
+	};
+	auto upload = [graphicsEngine](std::vector<uint8_t> data) {
+		CookedTexture cooked = CookedTexture::Parse(data.data(), data.size());
+		std::unique_ptr<inl::gxeng::Image> image(graphicsEngine->CreateImage());
+		image->SetLayout(cooked.GetWidth(), cooked.GetHeight(), (inl::gxeng::eTextureCompression)cooked.GetCompression(), cooked.GetMipCount());
+		for (int level = 0; level < cooked.GetMipCount(); ++level) {
+			image->UpdateMip(level, cooked.GetMipData(level));
+		}
+		return image;
+	};
+	return loader.Load(0, read, decode, upload);
+}
+
 QCWorld::QCWorld(inl::gxeng::GraphicsEngine* graphicsEngine) {
 	using namespace inl::gxeng;
 
@@ -32,88 +187,33 @@ QCWorld::QCWorld(inl::gxeng::GraphicsEngine* graphicsEngine) {
 		inl::asset::AxisDir::POS_X, inl::asset::AxisDir::POS_Z, inl::asset::AxisDir::NEG_Y
 	};
 
-	// Create terrain mesh
+	// Load meshes and textures in parallel
 	{
-		inl::asset::Model model("assets\\terrain.fbx");
-
-		auto modelVertices = model.GetVertices<Position<0>, Normal<0>, TexCoord<0>>(0, coordSysLayout);
-		std::vector<unsigned> modelIndices = model.GetIndices(0);
-
-		m_terrainMesh.reset(m_graphicsEngine->CreateMesh());
-		m_terrainMesh->Set(modelVertices.data(), modelVertices.size(), modelIndices.data(), modelIndices.size());
-	}
-
-	// Create terrain texture
-	{
-		using PixelT = Pixel<ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR>;
-		inl::asset::Image img("assets\\terrain.jpg");
-
-		m_terrainTexture.reset(m_graphicsEngine->CreateImage());
-		m_terrainTexture->SetLayout(img.GetWidth(), img.GetHeight(), ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR);
-		m_terrainTexture->Update(0, 0, img.GetWidth(), img.GetHeight(), img.GetData(), PixelT::Reader());
-	}
-
-	// Create QC mesh
-	{
-		inl::asset::Model model("assets\\quadcopter.fbx");
-
-		auto modelVertices = model.GetVertices<Position<0>, Normal<0>, TexCoord<0>>(0, coordSysLayout);
-		std::vector<unsigned> modelIndices = model.GetIndices(0);
-
-		m_quadcopterMesh.reset(m_graphicsEngine->CreateMesh());
-		m_quadcopterMesh->Set(modelVertices.data(), modelVertices.size(), modelIndices.data(), modelIndices.size());
-	}
-
-	// Create QC texture
-	{
-		using PixelT = Pixel<ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR>;
-		inl::asset::Image img("assets\\axes.jpg");
-
-		m_axesTexture.reset(m_graphicsEngine->CreateImage());
-		m_axesTexture->SetLayout(img.GetWidth(), img.GetHeight(), ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR);
-		m_axesTexture->Update(0, 0, img.GetWidth(), img.GetHeight(), img.GetData(), PixelT::Reader());
-	}
-
-	// Create axes mesh
-	{
-		inl::asset::Model model("assets\\axes.fbx");
-
-		auto modelVertices = model.GetVertices<Position<0>, Normal<0>, TexCoord<0>>(0, { inl::asset::AxisDir::POS_Z, inl::asset::AxisDir::POS_Y, inl::asset::AxisDir::POS_X });
-		std::vector<unsigned> modelIndices = model.GetIndices(0);
-
-		m_axesMesh.reset(m_graphicsEngine->CreateMesh());
-		m_axesMesh->Set(modelVertices.data(), modelVertices.size(), modelIndices.data(), modelIndices.size());
-	}
-
-	// Create axes texture
-	{
-		using PixelT = Pixel<ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR>;
-		inl::asset::Image img("assets\\quadcopter.jpg");
-
-		m_quadcopterTexture.reset(m_graphicsEngine->CreateImage());
-		m_quadcopterTexture->SetLayout(img.GetWidth(), img.GetHeight(), ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR);
-		m_quadcopterTexture->Update(0, 0, img.GetWidth(), img.GetHeight(), img.GetData(), PixelT::Reader());
-	}
-
-	// Create tree mesh
-	{
-		inl::asset::Model model("assets\\pine_tree.fbx");
-
-		auto modelVertices = model.GetVertices<Position<0>, Normal<0>, TexCoord<0>>(0, coordSysLayout);
-		std::vector<unsigned> modelIndices = model.GetIndices(0);
-
-		m_treeMesh.reset(m_graphicsEngine->CreateMesh());
-		m_treeMesh->Set(modelVertices.data(), modelVertices.size(), modelIndices.data(), modelIndices.size());
-	}
-
-	// Create tree texture
-	{
-		using PixelT = Pixel<ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR>;
-		inl::asset::Image img("assets\\pine_tree.jpg");
-
-		m_treeTexture.reset(m_graphicsEngine->CreateImage());
-		m_treeTexture->SetLayout(img.GetWidth(), img.GetHeight(), ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR);
-		m_treeTexture->Update(0, 0, img.GetWidth(), img.GetHeight(), img.GetData(), PixelT::Reader());
+		AssetLoader loader;
+
+		m_terrainMesh = LoadCookedMesh(loader, m_graphicsEngine, "assets\\terrain.fbx", coordSysLayout, {}, true);
+		m_terrainTexture = LoadCookedImage(loader, m_graphicsEngine, "assets\\terrain.jpg");
+
+		m_quadcopterMesh = LoadCookedMesh(loader, m_graphicsEngine, "assets\\quadcopter.fbx", coordSysLayout);
+		m_quadcopterTexture = LoadCookedImage(loader, m_graphicsEngine, "assets\\quadcopter.jpg");
+
+		m_axesMesh = LoadCookedMesh(loader, m_graphicsEngine, "assets\\axes.fbx", { inl::asset::AxisDir::POS_Z, inl::asset::AxisDir::POS_Y, inl::asset::AxisDir::POS_X });
+		m_axesTexture = LoadCookedImage(loader, m_graphicsEngine, "assets\\axes.jpg");
+
+		// Trees are scattered far and wide, generate simplified levels for the distant ones.
+		Mesh::LodDesc lodDesc;
+		lodDesc.maxLodCount = 4;
+		m_treeMesh = LoadCookedMesh(loader, m_graphicsEngine, "assets\\pine_tree.fbx", coordSysLayout, lodDesc);
+		m_treeTexture = LoadCookedImage(loader, m_graphicsEngine, "assets\\pine_tree.jpg");
+
+		// The resources exist after this, the renderer skips meshes until their uploads finish.
+		loader.Flush();
+		for (auto handle : { &m_terrainMesh, &m_quadcopterMesh, &m_axesMesh, &m_treeMesh }) {
+			handle->RethrowError();
+		}
+		for (auto handle : { &m_terrainTexture, &m_quadcopterTexture, &m_axesTexture, &m_treeTexture }) {
+			handle->RethrowError();
+		}
 	}
 
 	// Create tree material
@@ -132,7 +232,7 @@ QCWorld::QCWorld(inl::gxeng::GraphicsEngine* graphicsEngine) {
 		m_treeShader->SetGraph(std::move(nodes), { {0, 1, 0} });
 		m_treeMaterial->SetShader(m_treeShader.get());
 
-		(*m_treeMaterial)[0] = m_treeTexture.get();
+		(*m_treeMaterial)[0] = m_treeTexture.Get();
 	}
 
 	// Create checker texture
@@ -152,8 +252,8 @@ QCWorld::QCWorld(inl::gxeng::GraphicsEngine* graphicsEngine) {
 
 	// Set up terrain
 	m_terrainEntity.reset(m_graphicsEngine->CreateMeshEntity());
-	m_terrainEntity->SetMesh(m_terrainMesh.get());
-	m_terrainEntity->SetTexture(m_terrainTexture.get());
+	m_terrainEntity->SetMesh(m_terrainMesh.Get());
+	m_terrainEntity->SetTexture(m_terrainTexture.Get());
 	m_terrainEntity->SetPosition({ 0,0,0 });
 	m_terrainEntity->SetRotation({ 1,0,0,0 });
 	m_terrainEntity->SetScale({ 1,1,1 });
@@ -161,8 +261,8 @@ QCWorld::QCWorld(inl::gxeng::GraphicsEngine* graphicsEngine) {
 
 	// Set up copter
 	m_quadcopterEntity.reset(m_graphicsEngine->CreateMeshEntity());
-	m_quadcopterEntity->SetMesh(m_quadcopterMesh.get());
-	m_quadcopterEntity->SetTexture(m_quadcopterTexture.get());
+	m_quadcopterEntity->SetMesh(m_quadcopterMesh.Get());
+	m_quadcopterEntity->SetTexture(m_quadcopterTexture.Get());
 	m_quadcopterEntity->SetPosition({ 0,0,3 });
 	m_quadcopterEntity->SetRotation({ 1,0,0,0 });
 	m_quadcopterEntity->SetScale({ 1,1,1 });
@@ -170,8 +270,8 @@ QCWorld::QCWorld(inl::gxeng::GraphicsEngine* graphicsEngine) {
 
 	// Set up axes
 	m_axesEntity.reset(m_graphicsEngine->CreateMeshEntity());
-	m_axesEntity->SetMesh(m_axesMesh.get());
-	m_axesEntity->SetTexture(m_axesTexture.get());
+	m_axesEntity->SetMesh(m_axesMesh.Get());
+	m_axesEntity->SetTexture(m_axesTexture.Get());
 	m_axesEntity->SetPosition({ 0,0,3 });
 	m_axesEntity->SetRotation({ 1,0,0,0 });
 	m_axesEntity->SetScale({ 1,1,1 });
@@ -265,9 +365,9 @@ void QCWorld::AddTree(mathfu::Vector3f position) {
 	float s = rng(rne);
 
 	tree.reset(m_graphicsEngine->CreateMeshEntity());
-	tree->SetMesh(m_treeMesh.get());
+	tree->SetMesh(m_treeMesh.Get());
 	tree->SetMaterial(m_treeMaterial.get());
-	tree->SetTexture(m_treeTexture.get());
+	tree->SetTexture(m_treeTexture.Get());
 	tree->SetPosition(position);
 	tree->SetRotation({ 1,0,0,0 });
 	tree->SetScale({ s,s,s });
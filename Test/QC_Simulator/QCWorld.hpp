@@ -9,6 +9,7 @@
 #include <GraphicsEngine_LL/Scene.hpp>
 #include <GraphicsEngine_LL/Camera.hpp>
 #include <GraphicsEngine_LL/DirectionalLight.hpp>
+#include <GraphicsEngine_LL/AssetLoader.hpp>
 #include "RigidBody.hpp"
 #include "Rotor.hpp"
 #include "PIDController.hpp"
@@ -83,14 +84,14 @@ private:
 	inl::gxeng::GraphicsEngine* m_graphicsEngine;
 
 	// Resource
-	std::unique_ptr<inl::gxeng::Mesh> m_quadcopterMesh;
-	std::unique_ptr<inl::gxeng::Image> m_quadcopterTexture;
-	std::unique_ptr<inl::gxeng::Mesh> m_axesMesh;
-	std::unique_ptr<inl::gxeng::Image> m_axesTexture;
-	std::unique_ptr<inl::gxeng::Mesh> m_terrainMesh;
-	std::unique_ptr<inl::gxeng::Image> m_terrainTexture;
-	std::unique_ptr<inl::gxeng::Mesh> m_treeMesh;
-	std::unique_ptr<inl::gxeng::Image> m_treeTexture;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Mesh> m_quadcopterMesh;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Image> m_quadcopterTexture;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Mesh> m_axesMesh;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Image> m_axesTexture;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Mesh> m_terrainMesh;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Image> m_terrainTexture;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Mesh> m_treeMesh;
+	inl::gxeng::AssetLoader::Handle<inl::gxeng::Image> m_treeTexture;
 
 	std::unique_ptr<inl::gxeng::Image> m_checkerTexture;
 
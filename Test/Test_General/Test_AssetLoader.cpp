@@ -0,0 +1,221 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "GraphicsEngine_LL/AssetLoader.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+struct MockAsset {
+	std::string value;
+};
+
+// Stands in for meshes and images whose upload finishes on the GPU later.
+struct MockGpuAsset {
+	std::shared_ptr<std::atomic<bool>> isPending;
+	bool HasPendingUploads() const { return *isPending; }
+};
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestAssetLoader : public AutoRegisterTest<TestAssetLoader> {
+public:
+	TestAssetLoader() {}
+
+	static std::string Name() {
+		return "Asset Loader";
+	}
+	int Run() override;
+};
+
+
+
+int TestAssetLoader::Run() {
+	try {
+		auto upload = [](std::string data) { return std::make_unique<MockAsset>(MockAsset{ data }); };
+
+		// The stages hand over their results.
+		{
+			AssetLoader loader(2);
+			auto handle = loader.Load(0,
+									  [] { return 21; },
+									  [](int file) { return std::to_string(file * 2); },
+									  upload);
+			loader.Flush();
+			TestAssert(handle.IsReady());
+			TestAssert(handle.Get() != nullptr && handle.Get()->value == "42");
+			TestAssert(loader.GetPendingCount() == 0);
+		}
+
+		// Higher priorities first, FIFO within a priority.
+		{
+			AssetLoader loader(1);
+			std::promise<void> gate;
+			std::shared_future<void> opened = gate.get_future().share();
+			loader.Load(100, [opened] { opened.wait(); return 0; }, [](int) { return ""s; }, upload);
+
+			std::mutex orderMutex;
+			std::vector<int> order;
+			const int priorities[] = { 1, 5, 3, 5 };
+			for (int i = 0; i < 4; ++i) {
+				loader.Load(priorities[i],
+							[&, i] { std::lock_guard<std::mutex> lkg(orderMutex); order.push_back(i); return 0; },
+							[](int) { return ""s; },
+							upload);
+			}
+			gate.set_value();
+			loader.Flush();
+			TestAssert((order == std::vector<int>{ 1, 3, 2, 0 }));
+		}
+
+		// Reads and decodes of different assets overlap.
+		{
+			constexpr int loadCount = 8;
+			const auto stageTime = std::chrono::milliseconds(20);
+
+			AssetLoader loader(4);
+			auto start = std::chrono::steady_clock::now();
+			std::vector<AssetLoader::Handle<MockAsset>> handles;
+			for (int i = 0; i < loadCount; ++i) {
+				handles.push_back(loader.Load(0,
+											  [stageTime, i] { std::this_thread::sleep_for(stageTime); return i; },
+											  [stageTime](int file) { std::this_thread::sleep_for(stageTime); return std::to_string(file); },
+											  upload));
+			}
+			loader.Flush();
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			cout << "Loaded " << loadCount << " assets in " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+				<< " ms, " << 2 * loadCount * stageTime.count() << " ms serially." << endl;
+			TestAssert(elapsed < 2 * loadCount * stageTime * 3 / 4);
+			for (auto& handle : handles) {
+				TestAssert(handle.IsReady());
+			}
+		}
+
+		// Cancelled loads don't run their remaining stages.
+		{
+			AssetLoader loader(1);
+			std::promise<void> gate;
+			std::shared_future<void> opened = gate.get_future().share();
+			loader.Load(1, [opened] { opened.wait(); return 0; }, [](int) { return ""s; }, upload);
+
+			std::atomic<int> stageCount(0);
+			auto handle = loader.Load(0,
+									  [&] { ++stageCount; return 0; },
+									  [&](int) { ++stageCount; return ""s; },
+									  upload);
+			TestAssert(handle.GetState() == eLoadState::QUEUED);
+			handle.Cancel();
+			TestAssert(handle.GetState() == eLoadState::CANCELLED);
+			gate.set_value();
+			loader.Flush();
+			TestAssert(stageCount == 0);
+			TestAssert(loader.GetPendingCount() == 0);
+		}
+
+		// Exceptions of the stages fail the load.
+		{
+			AssetLoader loader(2);
+			auto failed = loader.Load(0,
+									  [] { return 0; },
+									  [](int) -> std::string { throw std::invalid_argument("corrupted file"); },
+									  upload);
+			auto succeeded = loader.Load(0, [] { return 1; }, [](int) { return ""s; }, upload);
+			loader.Flush();
+			TestAssert(failed.GetState() == eLoadState::FAILED);
+			TestAssert(failed.Get() == nullptr);
+			TestAssert(succeeded.IsReady());
+
+			bool thrown = false;
+			try {
+				failed.RethrowError();
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+
+		// Assets are ready when their GPU uploads are.
+		{
+			AssetLoader loader(1);
+			auto isPending = std::make_shared<std::atomic<bool>>(true);
+			auto handle = loader.Load(0,
+									  [] { return 0; },
+									  [](int) { return 0; },
+									  [isPending](int) { return std::make_unique<MockGpuAsset>(MockGpuAsset{ isPending }); });
+			loader.Flush();
+			TestAssert(handle.GetState() == eLoadState::UPLOADING);
+			TestAssert(handle.Get() != nullptr);
+			TestAssert(loader.GetPendingCount() == 1);
+
+			*isPending = false;
+			loader.Update();
+			TestAssert(handle.IsReady());
+			TestAssert(loader.GetPendingCount() == 0);
+		}
+
+		// Destroying the loader cancels the loads it has not finished, the one that was running as well.
+		{
+			auto isPending = std::make_shared<std::atomic<bool>>(true);
+			std::promise<void> gate;
+			std::shared_future<void> opened = gate.get_future().share();
+			std::promise<void> started;
+			std::thread opener;
+
+			AssetLoader::Handle<MockGpuAsset> uploading;
+			AssetLoader::Handle<MockAsset> reading;
+			AssetLoader::Handle<MockAsset> queued;
+			{
+				AssetLoader loader(1);
+				uploading = loader.Load(0,
+										[] { return 0; },
+										[](int) { return 0; },
+										[isPending](int) { return std::make_unique<MockGpuAsset>(MockGpuAsset{ isPending }); });
+				loader.Flush();
+				reading = loader.Load(0, [&started, opened] { started.set_value(); opened.wait(); return 0; }, [](int) { return ""s; }, upload);
+				queued = loader.Load(0, [] { return 0; }, [](int) { return ""s; }, upload);
+				started.get_future().wait();
+
+				// The read finishes while the loader is being destroyed.
+				opener = std::thread([&gate] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); gate.set_value(); });
+			}
+			opener.join();
+			TestAssert(uploading.GetState() == eLoadState::CANCELLED);
+			TestAssert(reading.GetState() == eLoadState::CANCELLED);
+			TestAssert(queued.GetState() == eLoadState::CANCELLED);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Asset loader works." << endl;
+	return 0;
+}
@@ -0,0 +1,209 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include "GraphicsEngine_LL/CommandAllocatorPool.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+class MockAllocator : public inl::gxapi::ICommandAllocator {
+public:
+	void Reset() override { ++resetCount; }
+	inl::gxapi::eCommandListType GetType() const override { return inl::gxapi::eCommandListType::GRAPHICS; }
+	int resetCount = 0;
+};
+
+
+class MockFence : public inl::gxapi::IFence {
+public:
+	uint64_t Fetch() const override { return value; }
+	void Signal(uint64_t value) override { this->value = value; }
+	void Wait(uint64_t, uint64_t) const override {}
+	void WaitAny(const IFence**, uint64_t*, size_t, uint64_t) const override {}
+	void WaitAll(const IFence**, uint64_t*, size_t, uint64_t) const override {}
+	std::atomic<uint64_t> value{ 0 };
+};
+
+
+class MockPool : public impl::CommandAllocatorPoolBase {
+public:
+	MockPool() : CommandAllocatorPoolBase(nullptr) {}
+protected:
+	inl::gxapi::ICommandAllocator* CreateAllocator() override { return new MockAllocator(); }
+};
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestCommandAllocatorPool : public AutoRegisterTest<TestCommandAllocatorPool> {
+public:
+	TestCommandAllocatorPool() {}
+
+	static std::string Name() {
+		return "Command Allocator Pool";
+	}
+	int Run() override;
+};
+
+
+
+int TestCommandAllocatorPool::Run() {
+	try {
+		// Recycled allocators are reset and reused.
+		{
+			MockPool pool;
+			auto first = pool.RequestAllocator();
+			auto firstPtr = static_cast<MockAllocator*>(first.get());
+			first.reset();
+			auto second = pool.RequestAllocator();
+			TestAssert(second.get() == firstPtr);
+			TestAssert(firstPtr->resetCount == 1);
+
+			auto statistics = pool.GetStatistics();
+			TestAssert(statistics.requestCount == 2 && statistics.hitCount == 1 && statistics.createCount == 1);
+		}
+
+		// Allocators are not reset before the GPU passes their last use.
+		{
+			MockPool pool;
+			auto fence = std::make_shared<MockFence>();
+			fence->value = 4;
+
+			auto allocator = pool.RequestAllocator();
+			auto allocatorPtr = static_cast<MockAllocator*>(allocator.get());
+			impl::CommandAllocatorPoolBase::RecycleAfter(std::move(allocator), SyncPoint(fence, 5));
+
+			auto inFlight = pool.RequestAllocator();
+			TestAssert(inFlight.get() != allocatorPtr);
+			TestAssert(allocatorPtr->resetCount == 0);
+
+			fence->value = 5;
+			auto finished = pool.RequestAllocator();
+			TestAssert(finished.get() == allocatorPtr);
+			TestAssert(allocatorPtr->resetCount == 1);
+		}
+
+		// Allocators returned by other threads go back to the thread that created them.
+		{
+			MockPool pool;
+			auto allocator = pool.RequestAllocator();
+			auto allocatorPtr = allocator.get();
+			std::thread([&] { allocator.reset(); }).join();
+
+			inl::gxapi::ICommandAllocator* otherPtr = nullptr;
+			std::thread([&] { otherPtr = pool.RequestAllocator().get(); }).join();
+			TestAssert(otherPtr != allocatorPtr);
+
+			auto reused = pool.RequestAllocator();
+			TestAssert(reused.get() == allocatorPtr);
+
+			auto statistics = pool.GetStatistics();
+			TestAssert(statistics.foreignReturnCount == 1);
+			TestAssert(statistics.threadCount == 2); // Only threads that request have a free list.
+		}
+
+		// Threads that request and return on their own need one allocator each.
+		{
+			constexpr int threadCount = 4;
+			constexpr int requestCount = 1000;
+
+			MockPool pool;
+			std::atomic<int> finishedCount{ 0 };
+			std::vector<std::thread> threads;
+			for (int i = 0; i < threadCount; ++i) {
+				threads.emplace_back([&pool, &finishedCount] {
+					for (int j = 0; j < requestCount; ++j) {
+						auto allocator = pool.RequestAllocator();
+					}
+					// Stay alive, an exited thread's allocators would be handed to the next one.
+					++finishedCount;
+					while (finishedCount < threadCount) {
+						std::this_thread::yield();
+					}
+				});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			auto statistics = pool.GetStatistics();
+			TestAssert(statistics.requestCount == threadCount * requestCount);
+			TestAssert(statistics.createCount == threadCount);
+		}
+
+		// Allocators of exited threads are reused by new threads.
+		{
+			MockPool pool;
+			inl::gxapi::ICommandAllocator* firstPtr = nullptr;
+			std::thread([&] { firstPtr = pool.RequestAllocator().get(); }).join();
+
+			inl::gxapi::ICommandAllocator* secondPtr = nullptr;
+			std::thread([&] { secondPtr = pool.RequestAllocator().get(); }).join();
+			TestAssert(secondPtr == firstPtr);
+
+			auto statistics = pool.GetStatistics();
+			TestAssert(statistics.createCount == 1);
+			TestAssert(statistics.threadCount == 1);
+		}
+
+		// Returns from many threads at once are not lost.
+		{
+			constexpr int threadCount = 4;
+			constexpr int allocatorCount = 256;
+
+			MockPool pool;
+			std::vector<CmdAllocPtr> allocators;
+			for (int i = 0; i < threadCount * allocatorCount; ++i) {
+				allocators.push_back(pool.RequestAllocator());
+			}
+
+			std::vector<std::thread> threads;
+			for (int i = 0; i < threadCount; ++i) {
+				threads.emplace_back([&allocators, i] {
+					for (int j = 0; j < allocatorCount; ++j) {
+						allocators[i * allocatorCount + j].reset();
+					}
+				});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			for (int i = 0; i < threadCount * allocatorCount; ++i) {
+				allocators[i] = pool.RequestAllocator();
+			}
+			auto statistics = pool.GetStatistics();
+			TestAssert(statistics.createCount == threadCount * allocatorCount);
+			TestAssert(statistics.hitCount == threadCount * allocatorCount);
+			cout << "Contended returns: " << statistics.contentionCount << " of " << statistics.foreignReturnCount << "." << endl;
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Command allocator pool works." << endl;
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include "GraphicsEngine_LL/CompileJobQueue.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestCompileJobQueue : public AutoRegisterTest<TestCompileJobQueue> {
+public:
+	TestCompileJobQueue() {}
+
+	static std::string Name() {
+		return "Compile Job Queue";
+	}
+	int Run() override;
+};
+
+
+
+int TestCompileJobQueue::Run() {
+	try {
+		// Results and exceptions arrive through the futures.
+		{
+			CompileJobQueue queue(4);
+			std::vector<std::shared_future<int>> results;
+			for (int i = 0; i < 100; ++i) {
+				results.push_back(queue.Enqueue([i] { return i * i; }));
+			}
+			auto failed = queue.Enqueue([]() -> int { throw std::logic_error("compilation failed"); });
+
+			for (int i = 0; i < 100; ++i) {
+				TestAssert(results[i].get() == i * i);
+			}
+			bool thrown = false;
+			try {
+				failed.get();
+			}
+			catch (std::logic_error&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+
+		// Jobs may wait for jobs enqueued before them, even with a single worker.
+		{
+			CompileJobQueue queue(1);
+			auto shader = queue.Enqueue([] { return std::string("binary"); });
+			auto pso = queue.Enqueue([shader] { return shader.get() + " + pso"; });
+			TestAssert(pso.get() == "binary + pso");
+		}
+
+		// WaitIdle returns when everything is done.
+		{
+			CompileJobQueue queue(3);
+			std::atomic<int> finished(0);
+			for (int i = 0; i < 20; ++i) {
+				queue.Enqueue([&finished] {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					++finished;
+					return 0;
+				});
+			}
+			queue.WaitIdle();
+			TestAssert(finished == 20);
+			TestAssert(queue.GetPendingCount() == 0);
+		}
+
+		// Jobs not started when the queue is destroyed are abandoned.
+		{
+			std::shared_future<int> abandoned;
+			{
+				CompileJobQueue queue(1);
+				queue.Enqueue([] {
+					std::this_thread::sleep_for(std::chrono::milliseconds(20));
+					return 0;
+				});
+				abandoned = queue.Enqueue([] { return 1; });
+			}
+			bool thrown = false;
+			try {
+				abandoned.get();
+			}
+			catch (std::future_error&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Compile job queue works." << endl;
+	return 0;
+}
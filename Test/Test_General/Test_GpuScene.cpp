@@ -0,0 +1,311 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include "GraphicsEngine_LL/GpuScene.hpp"
+#include "GraphicsEngine_LL/MeshEntity.hpp"
+#include "GraphicsEngine_LL/OcclusionCuller.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// The scene only compares mesh and material pointers, it never dereferences them.
+template <class T>
+static T* StandIn(uintptr_t id) {
+	return reinterpret_cast<T*>(id * 64);
+}
+
+
+// Commands tell their mesh and level of detail in the fields the real writer fills from the mesh.
+static void WriteCommand(Mesh* mesh, size_t lod, GpuCommand& command) {
+	command.vertexBuffer.gpuVirtualAddress = reinterpret_cast<uintptr_t>(mesh);
+	command.draw.indexCountPerInstance = uint32_t(lod + 1);
+}
+
+
+static const mathfu::Vector3f unitMin(-0.5f, -0.5f, -0.5f);
+static const mathfu::Vector3f unitMax(0.5f, 0.5f, 0.5f);
+
+
+static void AddAll(GpuScene& scene, const std::vector<MeshEntity>& entities, const std::vector<size_t>& lods, const std::vector<bool>& skip = {}, uint64_t meshVersion = 0) {
+	scene.Begin();
+	for (size_t i = 0; i < entities.size(); ++i) {
+		if (i < skip.size() && skip[i]) {
+			continue;
+		}
+		scene.Add(&entities[i], lods[i], meshVersion, unitMin, unitMax);
+	}
+	scene.Build(WriteCommand);
+}
+
+
+static const GpuCommand& GetCommandOfDraw(const GpuScene& scene, uint32_t drawIndex) {
+	uint32_t offset = scene.GetDraws()[drawIndex].instanceCountOffset;
+	return scene.GetCommands()[offset / sizeof(GpuCommand)];
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestGpuScene : public AutoRegisterTest<TestGpuScene> {
+public:
+	TestGpuScene() {}
+
+	static std::string Name() {
+		return "GPU Scene";
+	}
+	int Run() override;
+};
+
+
+
+int TestGpuScene::Run() {
+	Mesh* meshA = StandIn<Mesh>(1);
+	Mesh* meshB = StandIn<Mesh>(2);
+	Material* materialA = StandIn<Material>(3);
+	Material* materialB = StandIn<Material>(4);
+
+	try {
+		// Draws of the same material are adjacent commands, each draw gets a region of the visible list.
+		{
+			std::vector<MeshEntity> entities(7);
+			std::vector<size_t> lods = { 0, 0, 0, 0, 0, 0, 1 };
+			entities[0].SetMesh(meshA); entities[0].SetMaterial(materialA);
+			entities[1].SetMesh(meshB); entities[1].SetMaterial(materialA);
+			entities[2].SetMesh(meshA); entities[2].SetMaterial(materialB);
+			entities[3].SetMesh(meshA); entities[3].SetMaterial(materialA);
+			entities[4].SetMesh(meshA); entities[4].SetMaterial(materialB);
+			entities[5].SetMesh(meshA); entities[5].SetMaterial(materialA);
+			entities[6].SetMesh(meshA); entities[6].SetMaterial(materialA);
+
+			GpuScene scene;
+			AddAll(scene, entities, lods);
+
+			TestAssert(scene.IsLayoutChanged());
+			TestAssert(scene.GetInstances().size() == 7);
+			TestAssert(scene.GetDirtyInstances().size() == 1);
+			TestAssert(scene.GetDirtyInstances()[0].first == 0 && scene.GetDirtyInstances()[0].count == 7);
+
+			const auto& groups = scene.GetGroups();
+			TestAssert(groups.size() == 2);
+			TestAssert(groups[0].material == materialA && groups[0].firstCommand == 0 && groups[0].commandCount == 3);
+			TestAssert(groups[1].material == materialB && groups[1].firstCommand == 3 && groups[1].commandCount == 1);
+
+			// Commands of material A: mesh A, mesh B, then the other level of mesh A.
+			const auto& commands = scene.GetCommands();
+			TestAssert(commands.size() == 4);
+			TestAssert(commands[0].vertexBuffer.gpuVirtualAddress == reinterpret_cast<uintptr_t>(meshA) && commands[0].draw.indexCountPerInstance == 1);
+			TestAssert(commands[1].vertexBuffer.gpuVirtualAddress == reinterpret_cast<uintptr_t>(meshB));
+			TestAssert(commands[2].vertexBuffer.gpuVirtualAddress == reinterpret_cast<uintptr_t>(meshA) && commands[2].draw.indexCountPerInstance == 2);
+			for (const GpuCommand& command : commands) {
+				TestAssert(command.draw.instanceCount == 0);
+			}
+
+			// Regions are rounded up to powers of two: 3 -> 4, 1, 1, 2.
+			TestAssert(commands[0].firstVisible == 0 && commands[1].firstVisible == 4 && commands[2].firstVisible == 5 && commands[3].firstVisible == 6);
+			TestAssert(scene.GetVisibleCapacity() == 8);
+
+			// Each instance's draw points at the instance count of its own command.
+			for (size_t i = 0; i < entities.size(); ++i) {
+				const GpuInstance& instance = scene.GetInstances()[i];
+				const GpuDraw& draw = scene.GetDraws()[instance.drawIndex];
+				TestAssert(draw.instanceCountOffset % sizeof(GpuCommand) == 40);
+				const GpuCommand& command = GetCommandOfDraw(scene, instance.drawIndex);
+				TestAssert(command.firstVisible == draw.firstVisible);
+				TestAssert(command.vertexBuffer.gpuVirtualAddress == reinterpret_cast<uintptr_t>(entities[i].GetMesh()));
+				TestAssert(command.draw.indexCountPerInstance == lods[i] + 1);
+			}
+		}
+
+		// Only changed instances are uploaded, nearby changes are merged into one range.
+		{
+			std::vector<MeshEntity> entities(40);
+			std::vector<size_t> lods(40, 0);
+			for (auto& entity : entities) {
+				entity.SetMesh(meshA);
+				entity.SetMaterial(materialA);
+			}
+
+			GpuScene scene;
+			AddAll(scene, entities, lods);
+			AddAll(scene, entities, lods);
+			TestAssert(!scene.IsLayoutChanged());
+			TestAssert(scene.GetDirtyInstances().empty());
+
+			entities[5].SetPosition({ 1, 2, 3 });
+			AddAll(scene, entities, lods);
+			TestAssert(scene.GetDirtyInstances().size() == 1);
+			TestAssert(scene.GetDirtyInstances()[0].first == 5 && scene.GetDirtyInstances()[0].count == 1);
+			TestAssert(scene.GetInstances()[5].world[3].data[0] == 1.0f);
+
+			entities[0].SetPosition({ 1, 0, 0 });
+			entities[10].SetPosition({ 1, 0, 0 });
+			entities[39].SetPosition({ 1, 0, 0 });
+			AddAll(scene, entities, lods);
+			const auto& ranges = scene.GetDirtyInstances();
+			TestAssert(ranges.size() == 2);
+			TestAssert(ranges[0].first == 0 && ranges[0].count == 11);
+			TestAssert(ranges[1].first == 39 && ranges[1].count == 1);
+
+			// A new level of detail moves the instance to a new draw.
+			lods[7] = 2;
+			AddAll(scene, entities, lods);
+			TestAssert(scene.IsLayoutChanged());
+			TestAssert(scene.GetCommands().size() == 2);
+			TestAssert(GetCommandOfDraw(scene, scene.GetInstances()[7].drawIndex).draw.indexCountPerInstance == 3);
+
+			// Setting the mesh anew replaces its buffers, the commands are written again even though the pointer is the same.
+			AddAll(scene, entities, lods, {}, 1);
+			TestAssert(scene.IsLayoutChanged());
+			TestAssert(scene.GetCommands().size() == 2);
+			TestAssert(scene.GetCommandMeshes().size() == 2);
+			TestAssert(scene.GetCommandMeshes()[0] == meshA && scene.GetCommandMeshes()[1] == meshA);
+			AddAll(scene, entities, lods, {}, 1);
+			TestAssert(!scene.IsLayoutChanged());
+		}
+
+		// Entities that are not added are removed, their slots are reused, draws are only laid out again when needed.
+		{
+			std::vector<MeshEntity> entities(6);
+			std::vector<size_t> lods(6, 0);
+			for (auto& entity : entities) {
+				entity.SetMesh(meshA);
+				entity.SetMaterial(materialA);
+			}
+			entities[1].SetMesh(meshB);
+
+			GpuScene scene;
+			AddAll(scene, entities, lods, { false, false, false, false, false, true });
+			TestAssert(scene.GetInstances().size() == 5);
+			TestAssert(scene.GetVisibleCapacity() == 4 + 1);
+
+			// Removing frees the slot, the draw keeps its region.
+			AddAll(scene, entities, lods, { false, false, true, false, false, true });
+			TestAssert(!scene.IsLayoutChanged());
+			TestAssert(scene.GetInstances()[2].drawIndex == GpuScene::INVALID_DRAW);
+			TestAssert(scene.GetDirtyInstances().size() == 1 && scene.GetDirtyInstances()[0].first == 2);
+
+			// A new entity takes the free slot, and fits in the region.
+			AddAll(scene, entities, lods, { false, false, true, false, false, false });
+			TestAssert(!scene.IsLayoutChanged());
+			TestAssert(scene.GetInstances().size() == 5);
+			TestAssert(scene.GetInstances()[2].drawIndex != GpuScene::INVALID_DRAW);
+
+			// Outgrowing the region lays out again.
+			AddAll(scene, entities, lods);
+			TestAssert(scene.IsLayoutChanged());
+			TestAssert(scene.GetInstances().size() == 6);
+			TestAssert(scene.GetVisibleCapacity() == 8 + 1);
+
+			// The draw of mesh B is dropped as it has no instances left, the other draw is renumbered.
+			entities[1].SetMesh(meshA);
+			entities[1].SetMaterial(materialB);
+			AddAll(scene, entities, lods);
+			TestAssert(scene.IsLayoutChanged());
+			TestAssert(scene.GetCommands().size() == 2);
+			TestAssert(scene.GetGroups().size() == 2);
+			for (const GpuCommand& command : scene.GetCommands()) {
+				TestAssert(command.vertexBuffer.gpuVirtualAddress == reinterpret_cast<uintptr_t>(meshA));
+			}
+			for (const GpuInstance& instance : scene.GetInstances()) {
+				TestAssert(instance.drawIndex < scene.GetDraws().size());
+			}
+
+			// Removing the last instance of a draw lays out again right away, its mesh may be destroyed next.
+			AddAll(scene, entities, lods, { false, true, false, false, false, false });
+			TestAssert(scene.IsLayoutChanged());
+			TestAssert(scene.GetCommands().size() == 1);
+			TestAssert(scene.GetGroups().size() == 1 && scene.GetGroups()[0].material == materialA);
+		}
+
+		// Culling counts the visible instances into their commands, and lists them in the regions of their draws.
+		{
+			const float pi = 3.14159265f;
+			mathfu::Matrix4x4f viewProjection = mathfu::Matrix4x4f::Perspective(pi / 2, 2.0f, 0.1f, 100.0f, 1.0f);
+
+			// A wall 10 units ahead, covering the view up to 45 degrees to the side.
+			OccluderMesh wall;
+			wall.positions = { { -10, -10, -10 }, { 10, -10, -10 }, { 10, 10, -10 }, { -10, 10, -10 } };
+			wall.indices = { 0, 1, 2, 0, 2, 3 };
+
+			OcclusionCuller culler(256, 128);
+			culler.Begin(viewProjection);
+			culler.AddOccluder(wall, mathfu::Matrix4x4f::Identity());
+			culler.RenderOccluders();
+
+			std::vector<MeshEntity> entities(60);
+			std::vector<size_t> lods(60);
+			for (size_t i = 0; i < entities.size(); ++i) {
+				// In front of the wall, behind it, behind the camera, and far to the side.
+				float distance = i % 4 == 0 ? 5.0f : i % 4 == 1 ? 20.0f : i % 4 == 2 ? -5.0f : 20.0f;
+				float side = i % 4 == 3 ? 60.0f : 0.0f;
+				entities[i].SetPosition({ side + float(i % 5) - 2.0f, 0.0f, -distance });
+				entities[i].SetMesh(i % 3 == 0 ? meshA : meshB);
+				entities[i].SetMaterial(i % 2 == 0 ? materialA : materialB);
+				lods[i] = i % 7 == 0 ? 1 : 0;
+			}
+
+			GpuScene scene;
+			AddAll(scene, entities, lods, std::vector<bool>(60, false));
+
+			std::vector<GpuCommand> commands;
+			std::vector<uint32_t> visible;
+			scene.Cull(culler, commands, visible);
+			TestAssert(visible.size() == scene.GetVisibleCapacity());
+
+			std::vector<uint32_t> listed;
+			for (const GpuCommand& command : commands) {
+				TestAssert(command.draw.instanceCount <= scene.GetVisibleCapacity() - command.firstVisible);
+				for (uint32_t i = 0; i < command.draw.instanceCount; ++i) {
+					uint32_t slot = visible[command.firstVisible + i];
+					TestAssert(scene.GetDraws()[scene.GetInstances()[slot].drawIndex].firstVisible == command.firstVisible);
+					listed.push_back(slot);
+				}
+			}
+			std::sort(listed.begin(), listed.end());
+
+			std::vector<uint32_t> expected;
+			for (uint32_t slot = 0; slot < entities.size(); ++slot) {
+				if (culler.IsVisible(unitMin, unitMax, entities[slot].GetTransform())) {
+					expected.push_back(slot);
+				}
+			}
+			TestAssert(listed == expected);
+			TestAssert(expected.size() == 15);
+			for (uint32_t slot : expected) {
+				TestAssert(slot % 4 == 0);
+			}
+
+			// The scene's own commands are left alone, they are the template of every frame.
+			for (const GpuCommand& command : scene.GetCommands()) {
+				TestAssert(command.draw.instanceCount == 0);
+			}
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "GPU scene works." << endl;
+	return 0;
+}
@@ -0,0 +1,184 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "GraphicsEngine_LL/HeapSuballocator.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestHeapSuballocator : public AutoRegisterTest<TestHeapSuballocator> {
+public:
+	TestHeapSuballocator() {}
+
+	static std::string Name() {
+		return "Heap Suballocator";
+	}
+	int Run() override;
+};
+
+
+
+int TestHeapSuballocator::Run() {
+	constexpr uint64_t KiB = 1024;
+	constexpr uint64_t MiB = 1024 * KiB;
+
+	try {
+		// Small allocations share pages by size class.
+		{
+			HeapSuballocator allocator;
+			uint64_t newPageSize;
+
+			auto a = allocator.Allocate(3 * KiB, 4 * KiB, newPageSize);
+			TestAssert(newPageSize == 4 * MiB);
+			auto b = allocator.Allocate(4 * KiB, 4 * KiB, newPageSize);
+			TestAssert(newPageSize == 0);
+			TestAssert(a.page == b.page && a.offset != b.offset);
+			TestAssert(a.size == 4 * KiB && a.requestedSize == 3 * KiB);
+
+			// Buffers need 64KiB alignment, which puts them into a different class.
+			auto c = allocator.Allocate(1 * KiB, 64 * KiB, newPageSize);
+			TestAssert(newPageSize == 4 * MiB);
+			TestAssert(c.page != a.page && c.offset % (64 * KiB) == 0 && c.size == 64 * KiB);
+
+			// Large allocations go into large pages at 64KiB granularity.
+			auto d = allocator.Allocate(1 * MiB + 1, 64 * KiB, newPageSize);
+			TestAssert(newPageSize == 64 * MiB);
+			TestAssert(d.size == 1 * MiB + 64 * KiB);
+
+			TestAssert(!allocator.IsSupported(128 * MiB, 0));
+			TestAssert(!allocator.IsSupported(4 * MiB, 4 * MiB));
+
+			auto statistics = allocator.GetStatistics();
+			TestAssert(statistics.pageCount == 3);
+			TestAssert(statistics.allocationCount == 4);
+			TestAssert(statistics.requestedBytes == 3 * KiB + 4 * KiB + 1 * KiB + 1 * MiB + 1);
+
+			// Empty pages are only released on request, and their indices are reused.
+			allocator.Deallocate(c);
+			TestAssert(allocator.GetStatistics().pageCount == 3);
+			auto released = allocator.ReleaseEmptyPages();
+			TestAssert(released.size() == 1 && released[0] == c.page);
+			auto e = allocator.Allocate(100 * KiB, 0, newPageSize);
+			TestAssert(newPageSize == 4 * MiB && e.page == c.page);
+
+			bool thrown = false;
+			try {
+				allocator.Deallocate(c); // Its page now belongs to another class.
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+
+			allocator.Deallocate(a);
+			allocator.Deallocate(b);
+			allocator.Deallocate(d);
+			allocator.Deallocate(e);
+			TestAssert(allocator.ReleaseEmptyPages().size() == 3);
+			TestAssert(allocator.GetStatistics().reservedBytes == 0);
+		}
+
+		// A full small page is replaced by a new one, and reused once a slot frees up.
+		{
+			HeapSuballocator::Desc desc;
+			desc.smallPageSize = 256 * KiB;
+			HeapSuballocator allocator(desc);
+			uint64_t newPageSize;
+
+			std::vector<HeapSuballocator::Allocation> allocations;
+			for (int i = 0; i < 4; ++i) {
+				allocations.push_back(allocator.Allocate(64 * KiB, 64 * KiB, newPageSize));
+				TestAssert(allocations.back().page == allocations.front().page);
+			}
+			auto overflow = allocator.Allocate(64 * KiB, 64 * KiB, newPageSize);
+			TestAssert(newPageSize == 256 * KiB && overflow.page != allocations.front().page);
+
+			allocator.Deallocate(allocations[2]);
+			auto reused = allocator.Allocate(64 * KiB, 64 * KiB, newPageSize);
+			TestAssert(newPageSize == 0 && reused.page == allocations[2].page && reused.offset == allocations[2].offset);
+		}
+
+		// Mixed workload: allocations never overlap, pages are packed densely.
+		{
+			HeapSuballocator allocator;
+			std::mt19937 rne(42);
+			std::vector<HeapSuballocator::Allocation> live;
+			std::vector<uint64_t> pageSizes;
+
+			for (int iteration = 0; iteration < 5000; ++iteration) {
+				if (live.empty() || rne() % 3 != 0) {
+					uint64_t size = rne() % 4 == 0 ? rne() % (8 * MiB) + 1 : rne() % (200 * KiB) + 1;
+					uint64_t alignment = rne() % 2 == 0 ? 64 * KiB : 4 * KiB;
+					uint64_t newPageSize;
+					auto allocation = allocator.Allocate(size, alignment, newPageSize);
+					if (newPageSize != 0) {
+						pageSizes.resize(std::max<size_t>(pageSizes.size(), allocation.page + 1));
+						pageSizes[allocation.page] = newPageSize;
+					}
+					TestAssert(allocation.offset % alignment == 0);
+					TestAssert(allocation.size >= size);
+					TestAssert(allocation.offset + allocation.size <= pageSizes[allocation.page]);
+					live.push_back(allocation);
+				}
+				else {
+					size_t pick = rne() % live.size();
+					allocator.Deallocate(live[pick]);
+					live[pick] = live.back();
+					live.pop_back();
+				}
+			}
+
+			std::sort(live.begin(), live.end(), [](auto& lhs, auto& rhs) {
+				return lhs.page < rhs.page || (lhs.page == rhs.page && lhs.offset < rhs.offset);
+			});
+			for (size_t i = 1; i < live.size(); ++i) {
+				if (live[i].page == live[i - 1].page) {
+					TestAssert(live[i - 1].offset + live[i - 1].size <= live[i].offset);
+				}
+			}
+
+			auto statistics = allocator.GetStatistics();
+			TestAssert(statistics.allocationCount == live.size());
+			cout << statistics.allocationCount << " allocations in " << statistics.pageCount << " pages, "
+				<< 100 * statistics.requestedBytes / statistics.reservedBytes << "% of reserved memory requested, "
+				<< 100 * statistics.allocatedBytes / statistics.reservedBytes << "% allocated, "
+				<< "fragmentation " << statistics.fragmentation << "." << endl;
+
+			for (auto& allocation : live) {
+				allocator.Deallocate(allocation);
+			}
+			TestAssert(allocator.FindSparsePages(1.0f).empty());
+			TestAssert(allocator.ReleaseEmptyPages().size() == statistics.pageCount);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Heap suballocator works." << endl;
+	return 0;
+}
@@ -0,0 +1,163 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <regex>
+#include <chrono>
+#include "GraphicsEngine_LL/HlslScanner.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// The materials in Engine/GraphicsEngine_LL/Materials, with a few helpers and comments like real ones have.
+static const char* const MaterialLibrary[] = {
+	"float4 main(MapColor2D map) {\n"
+	"	return map.tex.Sample(map.samp, g_tex0);\n"
+	"}",
+
+	"float main(MapValue2D map) {\n"
+	"	return map.tex.Sample(map.samp, g_tex0);\n"
+	"}",
+
+	"float4 main(float4 diffuse) {\n"
+	"	return float4(saturate(dot(-g_lightDir, g_normal)) * diffuse * g_lightColor, 1.0f) + 0.5*float4(0.6, 0, 0, 1.0f);;\n"
+	"}",
+
+	"// Blinn-Phong with a rough approximation of energy conservation.\n"
+	"float3 Specular(float3 normal, float roughness) {\n"
+	"	float3 halfway = normalize(-g_lightDir + float3(0, 0, 1)); // Viewer is assumed to be far.\n"
+	"	float power = 2.0f / (roughness * roughness + 1e-4f) - 2.0f;\n"
+	"	return pow(saturate(dot(normal, halfway)), power) * (power + 8.0f) / 25.13f;\n"
+	"}\n"
+	"\n"
+	"/* Inputs:\n"
+	"     diffuseColor, specularColor: linear RGB\n"
+	"     roughness: 0..1 */\n"
+	"float4 main(float4 diffuseColor, float4 specularColor, float roughness) {\n"
+	"	float3 light = saturate(dot(-g_lightDir, g_normal)) * g_lightColor;\n"
+	"	return float4(light * (diffuseColor.rgb + specularColor.rgb * Specular(g_normal, roughness)), diffuseColor.a);\n"
+	"}",
+};
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestHlslScanner : public AutoRegisterTest<TestHlslScanner> {
+public:
+	TestHlslScanner() {}
+
+	static std::string Name() {
+		return "HLSL Scanner";
+	}
+	int Run() override;
+};
+
+
+
+int TestHlslScanner::Run() {
+	try {
+		HlslScanner::FunctionSignature signature;
+
+		// Comments, prototypes and calls are skipped.
+		std::string code =
+			"// float main(float commented) {\n"
+			"float4 main(float4 color);\n"
+			"float helper(float x) { return main(x); }\n"
+			"/* float main() { */ float4 main ( Texture2D<float4> tex, float/*comment*/value , MapColor2D map ) \n"
+			"{ return 0; }";
+		TestAssert(HlslScanner::FindFunctionSignature(code, "main", signature));
+		TestAssert(signature.returnType == "float4");
+		TestAssert(signature.parameters.size() == 3);
+		TestAssert(signature.parameters[0].first == "Texture2D<float4>" && signature.parameters[0].second == "tex");
+		TestAssert(signature.parameters[1].first == "float" && signature.parameters[1].second == "value");
+		TestAssert(signature.parameters[2].first == "MapColor2D" && signature.parameters[2].second == "map");
+
+		TestAssert(HlslScanner::FindFunctionSignature("float main() { return 1; }", "main", signature));
+		TestAssert(signature.returnType == "float" && signature.parameters.empty());
+		TestAssert(!HlslScanner::FindFunctionSignature("float domain(float x) { return x; }", "main", signature));
+
+		// Semantics and default values are not part of the name.
+		TestAssert(HlslScanner::FindFunctionSignature("float4 main(float x : TEXCOORD0, in float y = 1.0f) : SV_Target { return x; }", "main", signature));
+		TestAssert(signature.returnType == "float4" && signature.parameters.size() == 2);
+		TestAssert(signature.parameters[0].first == "float" && signature.parameters[0].second == "x");
+		TestAssert(signature.parameters[1].first == "in float" && signature.parameters[1].second == "y");
+
+		bool thrown = false;
+		try {
+			HlslScanner::FindFunctionSignature("float main(float) { return 1; }", "main", signature);
+		}
+		catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		TestAssert(thrown);
+
+		// Only whole identifiers are renamed.
+		std::string renamed = HlslScanner::RenameIdentifier("float4 main(float4 domain) { return mainColor + main2; } // main", "main", "main_0");
+		TestAssert(renamed == "float4 main_0(float4 domain) { return mainColor + main2; } // main");
+
+		// Line breaks are kept, literals are left alone.
+		std::string stripped = HlslScanner::RemoveComments("a / b; // one\n/* two\nthree */ c \"//not a comment\"");
+		TestAssert(stripped == "a / b;  \n \n c \"//not a comment\"");
+
+
+		// Benchmark: the whole library in many variants, like loading a few thousand materials.
+		constexpr int variantCount = 1000;
+		std::vector<std::string> materials;
+		for (int variant = 0; variant < variantCount; ++variant) {
+			for (const char* material : MaterialLibrary) {
+				materials.push_back("// Variant " + std::to_string(variant) + "\n" + material);
+			}
+		}
+
+		using Clock = std::chrono::high_resolution_clock;
+		auto startTime = Clock::now();
+		size_t parameterCount = 0;
+		for (const auto& material : materials) {
+			HlslScanner::FindFunctionSignature(material, "main", signature);
+			parameterCount += signature.parameters.size();
+			renamed = HlslScanner::RenameIdentifier(material, "main", "mtl_shader");
+		}
+		auto scannerTime = Clock::now() - startTime;
+		TestAssert(parameterCount == variantCount * (1 + 1 + 1 + 3));
+
+		// The regular expressions that were used before, for comparison.
+		startTime = Clock::now();
+		for (const auto& material : materials) {
+			std::smatch matches;
+			std::regex_search(material, matches, std::regex(R"(main\s*\(.*\)\s*\{)"));
+			renamed = std::regex_replace(material, std::regex("main"), "mtl_shader");
+		}
+		auto regexTime = Clock::now() - startTime;
+
+		auto Milliseconds = [](Clock::duration duration) {
+			return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+		};
+		cout << materials.size() << " materials: scanner " << Milliseconds(scannerTime) << " ms, "
+			<< "regex " << Milliseconds(regexTime) << " ms." << endl;
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "HLSL scanner works." << endl;
+	return 0;
+}
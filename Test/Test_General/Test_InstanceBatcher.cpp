@@ -0,0 +1,142 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "GraphicsEngine_LL/InstanceBatcher.hpp"
+#include "GraphicsEngine_LL/MeshEntity.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// The batcher only compares mesh and material pointers, it never dereferences them.
+template <class T>
+static T* StandIn(uintptr_t id) {
+	return reinterpret_cast<T*>(id * 64);
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestInstanceBatcher : public AutoRegisterTest<TestInstanceBatcher> {
+public:
+	TestInstanceBatcher() {}
+
+	static std::string Name() {
+		return "Instance Batcher";
+	}
+	int Run() override;
+};
+
+
+
+int TestInstanceBatcher::Run() {
+	Mesh* meshA = StandIn<Mesh>(1);
+	Mesh* meshB = StandIn<Mesh>(2);
+	Material* materialA = StandIn<Material>(3);
+	Material* materialB = StandIn<Material>(4);
+
+	try {
+		// Entities sharing mesh, lod and material end up in one batch, batches in order of first appearance.
+		{
+			std::vector<MeshEntity> entities(6);
+			entities[0].SetMesh(meshA); entities[0].SetMaterial(materialA);
+			entities[1].SetMesh(meshB); entities[1].SetMaterial(materialA);
+			entities[2].SetMesh(meshA); entities[2].SetMaterial(materialA);
+			entities[3].SetMesh(meshA); entities[3].SetMaterial(materialB);
+			entities[4].SetMesh(meshA); entities[4].SetMaterial(materialA);
+			entities[5].SetMesh(meshB); entities[5].SetMaterial(materialA);
+
+			InstanceBatcher batcher;
+			batcher.Clear();
+			for (const MeshEntity& entity : entities) {
+				batcher.Add(&entity, 0, entity.GetMaterial());
+			}
+			// Same as entity 4, but a different level of detail.
+			batcher.Add(&entities[4], 1, entities[4].GetMaterial());
+			batcher.Build();
+
+			const auto& batches = batcher.GetBatches();
+			const auto& instances = batcher.GetInstances();
+			TestAssert(batches.size() == 4);
+			TestAssert(instances.size() == 7);
+
+			TestAssert(batches[0].mesh == meshA && batches[0].material == materialA && batches[0].lod == 0);
+			TestAssert(batches[0].firstInstance == 0 && batches[0].instanceCount == 3);
+			TestAssert(instances[0] == &entities[0] && instances[1] == &entities[2] && instances[2] == &entities[4]);
+
+			TestAssert(batches[1].mesh == meshB && batches[1].instanceCount == 2);
+			TestAssert(instances[3] == &entities[1] && instances[4] == &entities[5]);
+
+			TestAssert(batches[2].material == materialB && batches[2].instanceCount == 1);
+			TestAssert(batches[3].lod == 1 && batches[3].instanceCount == 1 && instances[6] == &entities[4]);
+
+			// Without materials, only the mesh and lod count.
+			batcher.Clear();
+			for (const MeshEntity& entity : entities) {
+				batcher.Add(&entity, 0, nullptr);
+			}
+			batcher.Build();
+			TestAssert(batcher.GetBatches().size() == 2);
+			TestAssert(batcher.GetBatches()[0].instanceCount == 4);
+			TestAssert(batcher.GetBatches()[1].instanceCount == 2);
+		}
+
+		// Batches are split when there are more instances than fit into a constant buffer.
+		{
+			const uint32_t count = 2 * InstanceBatcher::MAX_INSTANCES + 10;
+			std::vector<MeshEntity> entities(count);
+
+			InstanceBatcher batcher;
+			for (uint32_t i = 0; i < count; ++i) {
+				entities[i].SetMesh(meshA);
+				entities[i].SetPosition({ float(i), 0.0f, 0.0f });
+				batcher.Add(&entities[i], 0, nullptr);
+			}
+			batcher.Build();
+
+			const auto& batches = batcher.GetBatches();
+			TestAssert(batches.size() == 3);
+			TestAssert(batches[0].instanceCount == InstanceBatcher::MAX_INSTANCES);
+			TestAssert(batches[1].firstInstance == InstanceBatcher::MAX_INSTANCES);
+			TestAssert(batches[2].firstInstance == 2 * InstanceBatcher::MAX_INSTANCES && batches[2].instanceCount == 10);
+
+			// The packed transforms are the world matrices of the instances of the batch, in order.
+			std::vector<mathfu::VectorPacked<float, 4>> transforms;
+			batcher.PackTransforms(batches[2], transforms);
+			TestAssert(transforms.size() == 4 * 10);
+			for (uint32_t i = 0; i < 10; ++i) {
+				mathfu::Matrix4x4f world(mathfu::Vector4f(transforms[4 * i + 0]),
+										 mathfu::Vector4f(transforms[4 * i + 1]),
+										 mathfu::Vector4f(transforms[4 * i + 2]),
+										 mathfu::Vector4f(transforms[4 * i + 3]));
+				mathfu::Vector3f position = (world * mathfu::Vector4f(0, 0, 0, 1)).xyz();
+				TestAssert(position.x() == float(2 * InstanceBatcher::MAX_INSTANCES + i));
+			}
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Instance batcher works." << endl;
+	return 0;
+}
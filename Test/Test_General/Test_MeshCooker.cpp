@@ -0,0 +1,197 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include "AssetLibrary/MeshCooker.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::asset;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// A grid of quads with the triangles in random order, like meshes that come out of modeling tools.
+static MeshCooker::Submesh MakeGrid(unsigned size, unsigned seed) {
+	MeshCooker::Submesh grid;
+	for (unsigned y = 0; y <= size; ++y) {
+		for (unsigned x = 0; x <= size; ++x) {
+			grid.vertices.push_back({ { float(x), float(y), 0.0f }, { 0.0f, 0.0f, 1.0f }, { float(x) / size, float(y) / size } });
+		}
+	}
+
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (unsigned y = 0; y < size; ++y) {
+		for (unsigned x = 0; x < size; ++x) {
+			uint32_t v = y * (size + 1) + x;
+			triangles.push_back({ v, v + 1, v + size + 1 });
+			triangles.push_back({ v + 1, v + size + 2, v + size + 1 });
+		}
+	}
+	std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+	for (const auto& triangle : triangles) {
+		grid.indices.insert(grid.indices.end(), triangle.begin(), triangle.end());
+	}
+	return grid;
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestMeshCooker : public AutoRegisterTest<TestMeshCooker> {
+public:
+	TestMeshCooker() {}
+
+	static std::string Name() {
+		return "Mesh Cooker";
+	}
+	int Run() override;
+};
+
+
+
+int TestMeshCooker::Run() {
+	try {
+		// Reordering keeps the triangles and their winding, but reuses the cache.
+		{
+			auto grid = MakeGrid(64, 1);
+			auto sortedTriangles = [](const std::vector<uint32_t>& indices) {
+				std::vector<std::array<uint32_t, 3>> triangles;
+				for (size_t i = 0; i < indices.size(); i += 3) {
+					std::array<uint32_t, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+					std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+					triangles.push_back(t);
+				}
+				std::sort(triangles.begin(), triangles.end());
+				return triangles;
+			};
+
+			std::vector<uint32_t> optimized = grid.indices;
+			MeshCooker::OptimizeVertexCache(optimized, grid.vertices.size());
+			TestAssert(sortedTriangles(optimized) == sortedTriangles(grid.indices));
+
+			float before = MeshCooker::AverageCacheMissRatio(grid.indices, grid.vertices.size());
+			float after = MeshCooker::AverageCacheMissRatio(optimized, grid.vertices.size());
+			cout << "Vertices per triangle: " << before << " shuffled, " << after << " optimized." << endl;
+			TestAssert(after < 0.8f && after < before / 2);
+		}
+
+		// Unused vertices are dropped, the rest are in the order of first use.
+		{
+			MeshCooker::Submesh submesh;
+			for (int i = 0; i < 5; ++i) {
+				submesh.vertices.push_back({ { float(i), 0, 0 }, { 0, 0, 1 }, { 0, 0 } });
+			}
+			submesh.indices = { 4, 2, 3 };
+			MeshCooker::OptimizeVertexFetch(submesh.vertices, submesh.indices);
+			TestAssert(submesh.vertices.size() == 3);
+			TestAssert((submesh.indices == std::vector<uint32_t>{ 0, 1, 2 }));
+			TestAssert(submesh.vertices[0].position[0] == 4.0f && submesh.vertices[2].position[0] == 3.0f);
+		}
+
+		// Container roundtrip.
+		{
+			std::vector<MeshCooker::Submesh> submeshes = { MakeGrid(8, 2), MakeGrid(3, 3) };
+			// The second submesh is placed twice.
+			std::vector<CookedInstance> instances(3, CookedInstance{ 0, { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 } });
+			instances[1].submeshID = 1;
+			instances[1].transform[12] = 5.0f;
+			instances[2].submeshID = 1;
+			instances[2].transform[12] = -5.0f;
+			auto cooked = MeshCooker::Cook(submeshes, instances, 0x1234);
+			CookedModel model = CookedModel::Parse(cooked.data(), cooked.size());
+			TestAssert(model.GetSourceStamp() == 0x1234);
+			TestAssert(model.SubmeshCount() == 2);
+			TestAssert(model.InstanceCount() == 3);
+			for (unsigned i = 0; i < model.InstanceCount(); ++i) {
+				TestAssert(model.GetInstance(i).submeshID == instances[i].submeshID);
+				TestAssert(std::equal(std::begin(instances[i].transform), std::end(instances[i].transform), model.GetInstance(i).transform));
+			}
+			for (unsigned i = 0; i < model.SubmeshCount(); ++i) {
+				const CookedSubmesh& submesh = model.GetSubmesh(i);
+				TestAssert(submesh.vertexCount == submeshes[i].vertices.size());
+				TestAssert(submesh.indexCount == submeshes[i].indices.size());
+
+				// Same triangles by position.
+				auto positions = [](const CookedVertex* vertices, const uint32_t* indices, size_t indexCount) {
+					std::vector<std::array<float, 3>> result;
+					for (size_t j = 0; j < indexCount; ++j) {
+						const float* p = vertices[indices[j]].position;
+						result.push_back({ p[0], p[1], p[2] });
+					}
+					std::sort(result.begin(), result.end());
+					return result;
+				};
+				TestAssert(positions(submesh.vertices, submesh.indices, submesh.indexCount)
+						   == positions(submeshes[i].vertices.data(), submeshes[i].indices.data(), submeshes[i].indices.size()));
+			}
+
+			bool thrown = false;
+			try {
+				CookedModel::Parse(cooked.data(), cooked.size() - 4);
+			}
+			catch (std::runtime_error&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+
+			// A corrupted index would read past the vertex buffer.
+			thrown = false;
+			try {
+				std::vector<uint8_t> corrupted = cooked;
+				size_t indexOffset = reinterpret_cast<const uint8_t*>(model.GetSubmesh(1).indices) - cooked.data();
+				uint32_t index = model.GetSubmesh(1).vertexCount;
+				memcpy(corrupted.data() + indexOffset, &index, sizeof(index));
+				CookedModel::Parse(corrupted.data(), corrupted.size());
+			}
+			catch (std::runtime_error&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+
+			thrown = false;
+			try {
+				MeshCooker::Cook(submeshes, { CookedInstance{ 2, {} } });
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+
+			thrown = false;
+			try {
+				submeshes[0].indices.back() = 1000;
+				MeshCooker::Cook(submeshes);
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Mesh cooker works." << endl;
+	return 0;
+}
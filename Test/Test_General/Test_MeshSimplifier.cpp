@@ -0,0 +1,134 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include "GraphicsEngine_LL/MeshSimplifier.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestMeshSimplifier : public AutoRegisterTest<TestMeshSimplifier> {
+public:
+	TestMeshSimplifier() {}
+
+	static std::string Name() {
+		return "Mesh Simplifier";
+	}
+	int Run() override;
+};
+
+
+//------------------------------------------------------------------------------
+// Test definition
+//------------------------------------------------------------------------------
+
+
+static void MakeGrid(int size, std::vector<mathfu::Vector3f>& positions, std::vector<uint32_t>& indices) {
+	for (int y = 0; y < size; ++y) {
+		for (int x = 0; x < size; ++x) {
+			positions.push_back({ float(x), float(y), 0.0f });
+		}
+	}
+	for (int y = 0; y < size - 1; ++y) {
+		for (int x = 0; x < size - 1; ++x) {
+			uint32_t a = y*size + x, b = a + 1, c = a + size, d = c + 1;
+			indices.insert(indices.end(), { a, b, c, b, d, c });
+		}
+	}
+}
+
+
+static void MakeSphere(int rings, int segments, std::vector<mathfu::Vector3f>& positions, std::vector<uint32_t>& indices) {
+	const float pi = 3.14159265f;
+	for (int r = 0; r <= rings; ++r) {
+		for (int s = 0; s <= segments; ++s) {
+			float theta = pi * r / rings;
+			float phi = 2 * pi * s / segments;
+			positions.push_back({ std::sin(theta)*std::cos(phi), std::sin(theta)*std::sin(phi), std::cos(theta) });
+		}
+	}
+	for (int r = 0; r < rings; ++r) {
+		for (int s = 0; s < segments; ++s) {
+			uint32_t a = r*(segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+			indices.insert(indices.end(), { a, c, b, b, c, d });
+		}
+	}
+}
+
+
+int TestMeshSimplifier::Run() {
+	try {
+		// A flat grid collapses to almost nothing without error.
+		{
+			std::vector<mathfu::Vector3f> positions;
+			std::vector<uint32_t> indices, result;
+			MakeGrid(33, positions, indices);
+
+			MeshSimplifier simplifier(positions);
+			float error = simplifier.Simplify(indices.data(), indices.size(), 0, 1e-3f, result);
+			cout << "Grid: " << indices.size() / 3 << " -> " << result.size() / 3 << " triangles, error = " << error << endl;
+
+			TestAssert(result.size() % 3 == 0);
+			TestAssert(result.size() < indices.size() / 100);
+			TestAssert(error < 1e-3f);
+		}
+
+		// A sphere reaches the target count with a small error, all indices stay valid.
+		{
+			std::vector<mathfu::Vector3f> positions;
+			std::vector<uint32_t> indices, result;
+			MakeSphere(64, 128, positions, indices);
+
+			MeshSimplifier simplifier(positions);
+			size_t target = indices.size() / 8;
+			float error = simplifier.Simplify(indices.data(), indices.size(), target, 1.0f, result);
+			cout << "Sphere: " << indices.size() / 3 << " -> " << result.size() / 3 << " triangles, error = " << error << endl;
+
+			TestAssert(result.size() <= target);
+			TestAssert(result.size() > 0);
+			TestAssert(error < 0.1f);
+			for (auto index : result) {
+				TestAssert(index < positions.size());
+			}
+		}
+
+		// Error limit stops simplification early.
+		{
+			std::vector<mathfu::Vector3f> positions;
+			std::vector<uint32_t> indices, result;
+			MakeSphere(16, 32, positions, indices);
+
+			MeshSimplifier simplifier(positions);
+			simplifier.Simplify(indices.data(), indices.size(), 0, 1e-6f, result);
+			cout << "Sphere with strict limit: " << indices.size() / 3 << " -> " << result.size() / 3 << " triangles" << endl;
+
+			TestAssert(result.size() > indices.size() / 2);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << ex.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include "GraphicsEngine_LL/OcclusionCuller.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// Square facing the camera at the given distance, split into a grid of triangles.
+static OccluderMesh MakeWall(float halfSize, float distance, unsigned divisions) {
+	OccluderMesh mesh;
+	for (unsigned y = 0; y <= divisions; ++y) {
+		for (unsigned x = 0; x <= divisions; ++x) {
+			mesh.positions.push_back({ -halfSize + 2 * halfSize * x / divisions, -halfSize + 2 * halfSize * y / divisions, -distance });
+		}
+	}
+	for (unsigned y = 0; y < divisions; ++y) {
+		for (unsigned x = 0; x < divisions; ++x) {
+			unsigned i = y * (divisions + 1) + x;
+			mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + divisions + 2, i, i + divisions + 2, i + divisions + 1 });
+		}
+	}
+	return mesh;
+}
+
+
+static bool IsBoxVisible(OcclusionCuller& culler, mathfu::Vector3f center, float halfSize) {
+	mathfu::Vector3f extent(halfSize, halfSize, halfSize);
+	return culler.IsVisible(center - extent, center + extent, mathfu::Matrix4x4f::Identity());
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestOcclusionCuller : public AutoRegisterTest<TestOcclusionCuller> {
+public:
+	TestOcclusionCuller() {}
+
+	static std::string Name() {
+		return "Occlusion Culler";
+	}
+	int Run() override;
+};
+
+
+
+int TestOcclusionCuller::Run() {
+	const float pi = 3.14159265f;
+
+	// Camera at the origin looking down -Z, 90 degrees vertically and twice as wide.
+	mathfu::Matrix4x4f viewProjection = mathfu::Matrix4x4f::Perspective(pi / 2, 2.0f, 0.1f, 100.0f, 1.0f);
+
+	try {
+		// Boxes behind the wall are culled, the rest are not.
+		{
+			OcclusionCuller culler(256, 128);
+			culler.Begin(viewProjection);
+			culler.AddOccluder(MakeWall(5.0f, 10.0f, 1), mathfu::Matrix4x4f::Identity());
+			culler.RenderOccluders();
+
+			TestAssert(culler.GetStatistics().occluderCount == 1);
+			TestAssert(culler.GetStatistics().triangleCount == 2);
+			TestAssert(culler.GetDepth(0, 0) == 1.0f);
+			TestAssert(culler.GetDepth(128, 64) < 1.0f);
+
+			TestAssert(!IsBoxVisible(culler, { 0, 0, -20 }, 1.0f));
+			TestAssert(IsBoxVisible(culler, { 0, 0, -5 }, 1.0f));
+			TestAssert(IsBoxVisible(culler, { 15, 0, -20 }, 1.0f));
+			TestAssert(IsBoxVisible(culler, { 0, 0, -10 }, 1.0f)); // Intersects the wall.
+			TestAssert(IsBoxVisible(culler, { 0, 0, 0 }, 1.0f)); // Crosses the near plane.
+			TestAssert(!IsBoxVisible(culler, { 100, 0, -20 }, 1.0f));
+			TestAssert(!IsBoxVisible(culler, { 0, 0, 10 }, 1.0f));
+
+			TestAssert(culler.GetStatistics().testedCount == 7);
+			TestAssert(culler.GetStatistics().occludedCount == 1);
+			TestAssert(culler.GetStatistics().outsideCount == 2);
+		}
+
+		// Each pyramid cell holds the farthest depth below it.
+		{
+			OcclusionCuller culler(200, 100);
+			culler.Begin(viewProjection);
+			culler.AddOccluder(MakeWall(5.0f, 10.0f, 1), mathfu::Matrix4x4f::Identity());
+			culler.RenderOccluders();
+
+			TestAssert(culler.GetLevelCount() == 9);
+			unsigned width = 200, height = 100;
+			for (size_t level = 1; level < culler.GetLevelCount(); ++level) {
+				unsigned sourceWidth = width, sourceHeight = height;
+				width = (width + 1) / 2;
+				height = (height + 1) / 2;
+				for (unsigned y = 0; y < height; ++y) {
+					for (unsigned x = 0; x < width; ++x) {
+						float cell = culler.GetDepth(x, y, level);
+						for (unsigned child = 0; child < 4; ++child) {
+							unsigned childX = std::min(2 * x + (child & 1), sourceWidth - 1);
+							unsigned childY = std::min(2 * y + (child >> 1), sourceHeight - 1);
+							TestAssert(cell >= culler.GetDepth(childX, childY, level - 1));
+						}
+					}
+				}
+			}
+			TestAssert(culler.GetDepth(0, 0, culler.GetLevelCount() - 1) == 1.0f);
+		}
+
+		// Many triangles are rendered on multiple threads, the result is the same.
+		{
+			OcclusionCuller single(256, 128);
+			single.Begin(viewProjection);
+			single.AddOccluder(MakeWall(5.0f, 10.0f, 1), mathfu::Matrix4x4f::Identity());
+			single.RenderOccluders();
+
+			OcclusionCuller multi(256, 128);
+			multi.Begin(viewProjection);
+			multi.AddOccluder(MakeWall(5.0f, 10.0f, 40), mathfu::Matrix4x4f::Identity());
+			multi.RenderOccluders();
+
+			TestAssert(multi.GetStatistics().triangleCount == 3200);
+			for (unsigned y = 0; y < 128; ++y) {
+				for (unsigned x = 0; x < 256; ++x) {
+					TestAssert(std::abs(single.GetDepth(x, y) - multi.GetDepth(x, y)) < 1e-4f);
+				}
+			}
+		}
+
+		// Triangles crossing the near plane are clipped, not dropped.
+		{
+			OccluderMesh floor;
+			floor.positions = { { -50, -1, 10 }, { 50, -1, 10 }, { 50, -1, -50 }, { -50, -1, -50 } };
+			floor.indices = { 0, 1, 2, 0, 2, 3 };
+
+			OcclusionCuller culler(256, 128);
+			culler.Begin(viewProjection);
+			culler.AddOccluder(floor, mathfu::Matrix4x4f::Identity());
+			culler.RenderOccluders();
+
+			TestAssert(culler.GetStatistics().triangleCount > 2);
+			TestAssert(culler.GetDepth(128, 127) < 1.0f);
+			TestAssert(!IsBoxVisible(culler, { 0, -3, -10 }, 0.5f));
+			TestAssert(IsBoxVisible(culler, { 0, 1, -10 }, 0.5f));
+		}
+
+		// Begin clears the previous frame, and bad indices are rejected.
+		{
+			OcclusionCuller culler(64, 64);
+			culler.Begin(viewProjection);
+			culler.AddOccluder(MakeWall(5.0f, 10.0f, 1), mathfu::Matrix4x4f::Identity());
+			culler.RenderOccluders();
+			culler.Begin(viewProjection);
+			culler.RenderOccluders();
+			TestAssert(culler.GetDepth(32, 32) == 1.0f);
+			TestAssert(IsBoxVisible(culler, { 0, 0, -20 }, 1.0f));
+
+			OccluderMesh bad;
+			bad.positions = { { 0, 0, 0 } };
+			bad.indices = { 0, 0, 1 };
+			bool thrown = false;
+			try { culler.AddOccluder(bad, mathfu::Matrix4x4f::Identity()); }
+			catch (std::invalid_argument&) { thrown = true; }
+			TestAssert(thrown);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Occlusion culler works." << endl;
+	return 0;
+}
@@ -0,0 +1,126 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "GraphicsEngine_LL/PipelineEventDispatcher.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+class CountingListener : public PipelineEventListener {
+public:
+	void OnFrameBeginDevice(uint64_t frameId) override { ++beginDevice; lastDevice = frameId; }
+	void OnFrameBeginHost(uint64_t frameId) override { ++beginHost; }
+	void OnFrameCompleteDevice(uint64_t frameId) override { ++completeDevice; lastDevice = frameId; }
+	void OnFrameCompleteHost(uint64_t frameId) override { ++completeHost; }
+
+	std::atomic_int beginDevice{ 0 }, beginHost{ 0 }, completeDevice{ 0 }, completeHost{ 0 };
+	std::atomic<uint64_t> lastDevice{ 0 };
+};
+
+
+// Waits for the dispatcher's thread, which gets no other way to report back.
+template <class Pred>
+static bool WaitFor(Pred pred) {
+	for (int i = 0; i < 2000 && !pred(); ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return pred();
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestPipelineEventDispatcher : public AutoRegisterTest<TestPipelineEventDispatcher> {
+public:
+	TestPipelineEventDispatcher() {}
+
+	static std::string Name() {
+		return "Pipeline Event Dispatcher";
+	}
+	int Run() override;
+};
+
+
+
+int TestPipelineEventDispatcher::Run() {
+	try {
+		// Host events are called before dispatch returns, each listener once.
+		{
+			PipelineEventDispatcher dispatcher;
+			CountingListener a, b;
+			dispatcher += &a;
+			dispatcher += &a;
+			dispatcher += &b;
+
+			dispatcher.DispatchFrameBegin(1);
+			dispatcher.DispatchFrameEnd(1);
+			TestAssert(a.beginHost == 1 && a.completeHost == 1);
+			TestAssert(b.beginHost == 1 && b.completeHost == 1);
+
+			dispatcher -= &a;
+			dispatcher.DispatchFrameBegin(2);
+			TestAssert(a.beginHost == 1 && b.beginHost == 2);
+		}
+
+		// Device events arrive in order once their sync point is reached.
+		{
+			PipelineEventDispatcher dispatcher;
+			CountingListener a;
+			dispatcher += &a;
+
+			for (uint64_t frame = 1; frame <= 100; ++frame) {
+				dispatcher.DispatchDeviceFrameBegin(SyncPoint{}, frame);
+				dispatcher.DispatchDeviceFrameEnd(SyncPoint{}, frame);
+			}
+			TestAssert(WaitFor([&a] { return a.completeDevice == 100; }));
+			TestAssert(a.beginDevice == 100 && a.lastDevice == 100);
+
+			// Not called after removal returns.
+			dispatcher -= &a;
+			dispatcher.DispatchDeviceFrameEnd(SyncPoint{}, 101);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			TestAssert(a.completeDevice == 100);
+		}
+
+		// Pending events are dropped at destruction.
+		{
+			CountingListener a;
+			{
+				PipelineEventDispatcher dispatcher;
+				dispatcher += &a;
+				for (uint64_t frame = 1; frame <= 100; ++frame) {
+					dispatcher.DispatchDeviceFrameEnd(SyncPoint{}, frame);
+				}
+			}
+			TestAssert(a.completeDevice <= 100);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Pipeline event dispatcher works." << endl;
+	return 0;
+}
@@ -0,0 +1,290 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include "GraphicsEngine_LL/PipelineStateCache.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+class MockRootSignature : public inl::gxapi::IRootSignature {};
+
+
+class MockPipelineState : public inl::gxapi::IPipelineState {
+public:
+	MockPipelineState(std::vector<uint8_t> blob, bool failBlob) : blob(std::move(blob)), failBlob(failBlob) {}
+	std::vector<uint8_t> GetCachedBlob() const override {
+		if (failBlob) {
+			throw std::runtime_error("Device removed.");
+		}
+		return blob;
+	}
+	std::vector<uint8_t> blob;
+	bool failBlob;
+};
+
+
+// Stands in for the driver: the blob of a PSO is its first shader, blobs that don't match are rejected.
+class MockCache : public PipelineStateCache {
+public:
+	MockCache() : PipelineStateCache(nullptr) {}
+
+	std::atomic<int> createCount{ 0 };
+	std::atomic<int> blobCount{ 0 };
+	bool rejectBlobs = false;
+	bool failBlobs = false; // PSOs created from now on throw when asked for their blob.
+protected:
+	inl::gxapi::IRootSignature* CreateRootSignature(const inl::gxapi::RootSignatureDesc&) override {
+		++createCount;
+		return new MockRootSignature();
+	}
+	inl::gxapi::IPipelineState* CreatePipelineState(const inl::gxapi::GraphicsPipelineStateDesc& desc) override {
+		return Create(desc.vs, desc.cachedBlob, desc.cachedBlobSize);
+	}
+	inl::gxapi::IPipelineState* CreatePipelineState(const inl::gxapi::ComputePipelineStateDesc& desc) override {
+		return Create(desc.cs, desc.cachedBlob, desc.cachedBlobSize);
+	}
+private:
+	inl::gxapi::IPipelineState* Create(inl::gxapi::ShaderByteCodeDesc shader, const void* blob, size_t blobSize) {
+		auto begin = static_cast<const uint8_t*>(shader.shaderByteCode);
+		std::vector<uint8_t> compiled(begin, begin + shader.sizeOfByteCode);
+		if (blob != nullptr) {
+			auto blobBegin = static_cast<const uint8_t*>(blob);
+			if (rejectBlobs || std::vector<uint8_t>(blobBegin, blobBegin + blobSize) != compiled) {
+				throw std::runtime_error("Cached blob does not match.");
+			}
+			++blobCount;
+		}
+		++createCount;
+		return new MockPipelineState(compiled, failBlobs);
+	}
+};
+
+
+static inl::gxapi::RootSignatureDesc MakeRootSignatureDesc(unsigned numConstants) {
+	inl::gxapi::RootSignatureDesc desc;
+	desc.rootParameters.push_back(inl::gxapi::RootParameterDesc::Constant(numConstants, 0));
+	desc.rootParameters.push_back(inl::gxapi::RootParameterDesc::DescriptorTable({ inl::gxapi::DescriptorRange{ inl::gxapi::DescriptorRange::SRV, 4, 0, 0 } }));
+	desc.staticSamplers.push_back(inl::gxapi::StaticSamplerDesc(0));
+	return desc;
+}
+
+
+static inl::gxapi::GraphicsPipelineStateDesc MakePipelineStateDesc(inl::gxapi::IRootSignature* rootSignature, const std::vector<uint8_t>& vs) {
+	inl::gxapi::GraphicsPipelineStateDesc desc;
+	desc.rootSignature = rootSignature;
+	desc.vs = { vs.data(), vs.size() };
+	desc.primitiveTopologyType = inl::gxapi::ePrimitiveTopologyType::TRIANGLE;
+	desc.renderTargetFormats[0] = inl::gxapi::eFormat::R16G16B16A16_FLOAT;
+	return desc;
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestPipelineStateCache : public AutoRegisterTest<TestPipelineStateCache> {
+public:
+	TestPipelineStateCache() {}
+
+	static std::string Name() {
+		return "Pipeline State Cache";
+	}
+	int Run() override;
+};
+
+
+
+int TestPipelineStateCache::Run() {
+	const std::string cachePath = "./Test_PipelineStateCache.pack";
+
+	try {
+		// Equal descriptions share objects, shaders are compared by content.
+		{
+			MockCache cache;
+			auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+			TestAssert(cache.GetRootSignature(MakeRootSignatureDesc(4)) == rootSignature);
+			TestAssert(cache.GetRootSignature(MakeRootSignatureDesc(8)) != rootSignature);
+
+			std::vector<uint8_t> vs = { 1, 2, 3, 4, 5 };
+			std::vector<uint8_t> vsCopy = vs;
+			auto pso = cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs));
+			TestAssert(cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vsCopy)) == pso);
+
+			std::vector<uint8_t> otherVs = { 1, 2, 3, 4, 6 };
+			TestAssert(cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), otherVs)) != pso);
+
+			auto culledDesc = MakePipelineStateDesc(rootSignature.get(), vs);
+			culledDesc.rasterization.cullMode = inl::gxapi::eCullMode::DRAW_CCW;
+			TestAssert(cache.GetPipelineState(culledDesc) != pso);
+
+			// Formats of unused render targets don't matter.
+			auto unusedTargetDesc = MakePipelineStateDesc(rootSignature.get(), vs);
+			unusedTargetDesc.renderTargetFormats[3] = inl::gxapi::eFormat::R8G8B8A8_UNORM;
+			TestAssert(cache.GetPipelineState(unusedTargetDesc) == pso);
+
+			inl::gxapi::ComputePipelineStateDesc computeDesc(rootSignature.get(), { vs.data(), vs.size() });
+			auto cso = cache.GetPipelineState(computeDesc);
+			TestAssert(cso != pso);
+			TestAssert(cache.GetPipelineState(computeDesc) == cso);
+
+			auto statistics = cache.GetStatistics();
+			TestAssert(statistics.rootSignatureCount == 2);
+			TestAssert(statistics.pipelineStateCount == 4);
+			TestAssert(statistics.missCount == 6);
+			TestAssert(statistics.hitCount == 4);
+			TestAssert(cache.createCount == 6);
+		}
+
+		// Threads asking for the same PSO at once get the same object.
+		{
+			constexpr int threadCount = 4;
+			constexpr int requestCount = 1000;
+
+			MockCache cache;
+			auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+			std::vector<uint8_t> vs = { 1, 2, 3 };
+
+			std::vector<std::vector<inl::gxapi::IPipelineState*>> results(threadCount);
+			std::vector<std::thread> threads;
+			for (int i = 0; i < threadCount; ++i) {
+				threads.emplace_back([&, i] {
+					for (int j = 0; j < requestCount; ++j) {
+						results[i].push_back(cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs)).get());
+					}
+				});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			for (const auto& result : results) {
+				for (auto pso : result) {
+					TestAssert(pso == results[0][0]);
+				}
+			}
+			TestAssert(cache.GetStatistics().pipelineStateCount == 1);
+		}
+
+		// Blobs saved in one run are passed to the driver in the next.
+		{
+			std::vector<uint8_t> vs = { 7, 8, 9 };
+			std::vector<uint8_t> unusedVs = { 10, 11 };
+			{
+				MockCache cache;
+				auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs));
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), unusedVs));
+				TestAssert(cache.Save(cachePath));
+			}
+			{
+				MockCache cache;
+				TestAssert(cache.Load(cachePath));
+				auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs));
+				TestAssert(cache.blobCount == 1);
+
+				// Another root signature makes it another PSO.
+				auto otherRootSignature = cache.GetRootSignature(MakeRootSignatureDesc(8));
+				cache.GetPipelineState(MakePipelineStateDesc(otherRootSignature.get(), unusedVs));
+				TestAssert(cache.blobCount == 1);
+
+				// Blobs not used in this run are kept.
+				TestAssert(cache.Save(cachePath));
+			}
+			{
+				MockCache cache;
+				cache.rejectBlobs = true;
+				TestAssert(cache.Load(cachePath));
+				auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+				auto pso = cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), unusedVs));
+				TestAssert(pso != nullptr);
+				TestAssert(cache.blobCount == 0);
+				TestAssert(cache.GetStatistics().blobRejectCount == 1);
+			}
+		}
+
+		// PSOs no one holds are dropped, and created again when requested.
+		{
+			MockCache cache;
+			auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+			std::vector<uint8_t> vs = { 1, 2 };
+			std::vector<uint8_t> reloadedVs = { 1, 3 };
+			auto held = cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs));
+			cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), reloadedVs));
+
+			cache.ReleaseUnused();
+			TestAssert(cache.GetStatistics().pipelineStateCount == 1);
+			TestAssert(cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs)) == held);
+
+			auto recreated = cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), reloadedVs));
+			TestAssert(recreated != nullptr);
+			TestAssert(cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), reloadedVs)) == recreated);
+			TestAssert(cache.GetStatistics().pipelineStateCount == 2);
+			TestAssert(cache.createCount == 4);
+		}
+
+		// Saving skips PSOs whose blob can't be had, and does not throw.
+		{
+			std::vector<uint8_t> vs = { 4, 5 };
+			std::vector<uint8_t> failingVs = { 4, 6 };
+			{
+				MockCache cache;
+				auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs));
+				cache.failBlobs = true;
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), failingVs));
+				TestAssert(cache.Save(cachePath));
+			}
+			{
+				MockCache cache;
+				TestAssert(cache.Load(cachePath));
+				auto rootSignature = cache.GetRootSignature(MakeRootSignatureDesc(4));
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), vs));
+				cache.GetPipelineState(MakePipelineStateDesc(rootSignature.get(), failingVs));
+				TestAssert(cache.blobCount == 1);
+			}
+		}
+
+		// Corrupt files are ignored.
+		{
+			{
+				FILE* file = std::fopen(cachePath.c_str(), "wb");
+				std::fputs("INLPSOC garbage", file);
+				std::fclose(file);
+			}
+			MockCache cache;
+			TestAssert(!cache.Load(cachePath));
+			TestAssert(!cache.Load(cachePath + ".missing"));
+		}
+	}
+	catch (std::exception& ex) {
+		std::remove(cachePath.c_str());
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	std::remove(cachePath.c_str());
+	cout << "Pipeline state cache works." << endl;
+	return 0;
+}
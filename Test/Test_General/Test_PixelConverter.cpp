@@ -0,0 +1,136 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include "GraphicsEngine_LL/PixelConverter.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestPixelConverter : public AutoRegisterTest<TestPixelConverter> {
+public:
+	TestPixelConverter() {}
+
+	static std::string Name() {
+		return "Pixel Converter";
+	}
+	int Run() override;
+};
+
+
+
+int TestPixelConverter::Run() {
+	try {
+		const PixelFormat rgb8{ ePixelChannelType::INT8_NORM, 3, ePixelClass::LINEAR };
+		const PixelFormat rgba8{ ePixelChannelType::INT8_NORM, 4, ePixelClass::LINEAR };
+		const PixelFormat rgba16{ ePixelChannelType::INT16_NORM, 4, ePixelClass::LINEAR };
+		const PixelFormat rgbFloat{ ePixelChannelType::FLOAT32, 3, ePixelClass::LINEAR };
+		const PixelFormat rgbaFloat{ ePixelChannelType::FLOAT32, 4, ePixelClass::LINEAR };
+
+		// Unsupported conversions.
+		TestAssert(PixelConverter::Find(rgba8, rgb8) == nullptr);
+		TestAssert(PixelConverter::Find(rgb8, { ePixelChannelType::INT8_NORM, 3, ePixelClass::VALUE_EXPONENT }) == nullptr);
+		TestAssert(PixelConverter::Find({ ePixelChannelType::INT32, 4, ePixelClass::LINEAR }, rgbaFloat) == nullptr);
+
+		// RGB8 to RGBA8, the width is not a multiple of the four pixels done at once.
+		{
+			std::vector<uint8_t> source = { 1, 2, 3,  4, 5, 6,  7, 8, 9,  10, 11, 12,  13, 14, 15,  16, 17, 18 };
+			std::vector<uint8_t> result(6 * 4);
+			PixelConverter::Find(rgb8, rgba8)(source.data(), result.data(), 6);
+			std::vector<uint8_t> expected = { 1, 2, 3, 255,  4, 5, 6, 255,  7, 8, 9, 255,  10, 11, 12, 255,  13, 14, 15, 255,  16, 17, 18, 255 };
+			TestAssert(result == expected);
+		}
+
+		// Channel types, rounding and saturation.
+		{
+			float source[] = { 0.0f, 0.5f, 1.0f,  -1.0f, 2.0f, 0.2f };
+			uint8_t result[8];
+			PixelConverter::Find(rgbFloat, rgba8)(source, result, 2);
+			TestAssert(result[0] == 0 && result[1] == 128 && result[2] == 255 && result[3] == 255);
+			TestAssert(result[4] == 0 && result[5] == 255 && result[6] == 51 && result[7] == 255);
+
+			uint8_t source8[] = { 0, 1, 128, 255 };
+			uint16_t result16[4];
+			PixelConverter::Find(rgba8, rgba16)(source8, result16, 1);
+			TestAssert(result16[0] == 0 && result16[1] == 257 && result16[2] == 128 * 257 && result16[3] == 65535);
+
+			uint8_t back8[4];
+			PixelConverter::Find(rgba16, rgba8)(result16, back8, 1);
+			TestAssert(memcmp(source8, back8, sizeof(source8)) == 0);
+
+			float resultFloat[4];
+			PixelConverter::Find(rgba8, rgbaFloat)(source8, resultFloat, 1);
+			TestAssert(resultFloat[0] == 0.0f && resultFloat[3] == 1.0f && std::abs(resultFloat[2] - 128.f / 255.f) < 1e-6f);
+
+			// NaN and infinities are clamped like any other value.
+			float special[] = { NAN, INFINITY, -INFINITY, 1e30f };
+			uint16_t clamped16[4];
+			PixelConverter::Find(rgbaFloat, rgba16)(special, clamped16, 1);
+			TestAssert(clamped16[0] == 0 && clamped16[1] == 65535 && clamped16[2] == 0 && clamped16[3] == 65535);
+		}
+
+		// A large image with padded rows, split among threads.
+		const size_t width = 1531, height = 1024;
+		const size_t srcPitch = width * 3 + 5, dstPitch = (width * 4 + 255) / 256 * 256;
+		std::vector<uint8_t> source(srcPitch * height);
+		for (size_t i = 0; i < source.size(); ++i) {
+			source[i] = uint8_t(i * 7 + i / 5);
+		}
+		std::vector<uint8_t> converted(dstPitch * height, 0);
+
+		using Clock = std::chrono::high_resolution_clock;
+		auto startTime = Clock::now();
+		PixelConverter::Convert(PixelConverter::Find(rgb8, rgba8), source.data(), srcPitch, converted.data(), dstPitch, width, height);
+		auto kernelTime = Clock::now() - startTime;
+
+		// The way Image::Update did it before.
+		std::vector<uint8_t> reference(dstPitch * height, 0);
+		startTime = Clock::now();
+		for (size_t y = 0; y < height; ++y) {
+			for (size_t x = 0; x < width; ++x) {
+				uint8_t* dst = reference.data() + (y * dstPitch + x * 4);
+				memcpy(dst, source.data() + (y * srcPitch + x * 3), 3);
+				memset(dst + 3, 255, 1);
+			}
+		}
+		auto referenceTime = Clock::now() - startTime;
+
+		TestAssert(converted == reference);
+
+		auto Milliseconds = [](Clock::duration duration) {
+			return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+		};
+		cout << width << "x" << height << " RGB8 to RGBA8: kernels " << Milliseconds(kernelTime) << " ms, "
+			<< "per pixel " << Milliseconds(referenceTime) << " ms." << endl;
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Pixel converter works." << endl;
+	return 0;
+}
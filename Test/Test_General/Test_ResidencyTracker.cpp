@@ -0,0 +1,223 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "GraphicsEngine_LL/ResidencyTracker.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+using inl::gxapi::IPageable;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// The tracker never dereferences the resources, any distinct address will do.
+static IPageable* FakeResource(std::vector<char>& storage, size_t index) {
+	return reinterpret_cast<IPageable*>(storage.data() + index);
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestResidencyTracker : public AutoRegisterTest<TestResidencyTracker> {
+public:
+	TestResidencyTracker() {}
+
+	static std::string Name() {
+		return "Residency Tracker";
+	}
+	int Run() override;
+};
+
+
+
+int TestResidencyTracker::Run() {
+	try {
+		std::vector<char> storage(64);
+
+		// Least recently used resources are evicted first, locked ones are never evicted.
+		{
+			ResidencyTracker tracker(300);
+			IPageable* a = FakeResource(storage, 0);
+			IPageable* b = FakeResource(storage, 1);
+			IPageable* c = FakeResource(storage, 2);
+			tracker.Add(a, 100);
+			tracker.Add(b, 100);
+			tracker.Add(c, 100);
+			TestAssert(tracker.GetStatistics().residentBytes == 300);
+
+			// Never used resources are not evicted.
+			tracker.SetBudget(0);
+			TestAssert(tracker.SelectEvictions().empty());
+			tracker.SetBudget(200);
+
+			tracker.BeginFrame(1);
+			TestAssert(tracker.Lock({ b }).empty());
+			tracker.Unlock({ b });
+			TestAssert(tracker.Lock({ a, c }).empty());
+			tracker.Unlock({ a, c });
+
+			// Used in the current frame, can't evict yet.
+			TestAssert(tracker.SelectEvictions().empty());
+
+			tracker.BeginFrame(2);
+			tracker.Lock({ a });
+			auto evicted = tracker.SelectEvictions();
+			TestAssert(evicted.size() == 1 && evicted[0] == b);
+			TestAssert(!tracker.IsResident(b));
+			TestAssert(tracker.GetStatistics().residentBytes == 200);
+
+			// Evicting everything possible keeps the locked resource.
+			TestAssert(tracker.SelectEvictions(0).size() == 1); // only c, a is locked
+			TestAssert(tracker.IsResident(a));
+			tracker.Unlock({ a });
+
+			// Evicted resources have to be made resident again.
+			tracker.BeginFrame(3);
+			auto toMakeResident = tracker.Lock({ b, c, a });
+			std::sort(toMakeResident.begin(), toMakeResident.end());
+			TestAssert(toMakeResident.size() == 2 && toMakeResident[0] == b && toMakeResident[1] == c);
+			TestAssert(tracker.GetStatistics().makeResidentCount == 2);
+			TestAssert(tracker.GetStatistics().makeResidentBatches == 1);
+			tracker.Unlock({ b, c, a });
+
+			tracker.Remove(b);
+			tracker.Remove(b); // unknown, ignored
+			TestAssert(tracker.GetStatistics().trackedBytes == 200);
+			TestAssert(tracker.GetStatistics().residentBytes == 200);
+
+			// Untracked resources are always resident.
+			TestAssert(tracker.Lock({ b }).empty());
+			tracker.Unlock({ b });
+
+			bool thrown = false;
+			try {
+				tracker.Add(a, 1);
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+
+		// A cancelled lock leaves the resources evicted and unlocked, as they were before.
+		{
+			ResidencyTracker tracker(100);
+			IPageable* a = FakeResource(storage, 0);
+			IPageable* b = FakeResource(storage, 1);
+			tracker.Add(a, 100);
+			tracker.Add(b, 100);
+
+			tracker.BeginFrame(1);
+			tracker.Lock({ a, b });
+			tracker.Unlock({ a, b });
+			tracker.BeginFrame(2);
+			TestAssert(tracker.SelectEvictions().size() == 1);
+			IPageable* evicted = tracker.IsResident(a) ? b : a;
+			IPageable* kept = evicted == a ? b : a;
+
+			auto toMakeResident = tracker.Lock({ a, b });
+			TestAssert(toMakeResident.size() == 1 && toMakeResident[0] == evicted);
+			tracker.CancelLock({ a, b }, toMakeResident);
+			TestAssert(!tracker.IsResident(evicted));
+			TestAssert(tracker.GetStatistics().residentBytes == 100);
+			TestAssert(tracker.GetStatistics().makeResidentCount == 0);
+
+			// Nothing is locked, so the other one can be evicted, and the next lock pages the first one in.
+			tracker.BeginFrame(3);
+			auto evictedNow = tracker.SelectEvictions(0);
+			TestAssert(evictedNow.size() == 1 && evictedNow[0] == kept);
+			TestAssert(tracker.Lock({ evicted }).size() == 1);
+			tracker.Unlock({ evicted });
+		}
+
+		// Simulate a scene where the working set moves around a set of resources larger than the budget.
+		{
+			constexpr size_t resourceCount = 40;
+			constexpr size_t resourceSize = 1000;
+			constexpr size_t budget = 16 * resourceSize;
+			constexpr size_t workingSetSize = 8;
+
+			ResidencyTracker tracker(budget);
+			std::vector<IPageable*> resources;
+			for (size_t i = 0; i < resourceCount; ++i) {
+				resources.push_back(FakeResource(storage, i));
+				tracker.Add(resources.back(), resourceSize);
+			}
+
+			// Loading the scene touches every resource once.
+			tracker.Lock(resources);
+			tracker.Unlock(resources);
+
+			std::vector<bool> resident(resourceCount, true);
+			std::vector<std::vector<IPageable*>> inFlight; // The GPU lags behind a frame.
+			size_t pageIns = 0;
+
+			for (uint64_t frame = 1; frame <= 200; ++frame) {
+				tracker.BeginFrame(frame);
+
+				std::vector<IPageable*> used;
+				for (size_t i = 0; i < workingSetSize; ++i) {
+					used.push_back(resources[(frame / 4 + i * 3) % resourceCount]);
+				}
+				std::sort(used.begin(), used.end());
+				used.erase(std::unique(used.begin(), used.end()), used.end());
+
+				for (IPageable* resource : tracker.Lock(used)) {
+					size_t index = reinterpret_cast<char*>(resource) - storage.data();
+					TestAssert(!resident[index]);
+					resident[index] = true;
+					++pageIns;
+				}
+				for (IPageable* resource : tracker.SelectEvictions()) {
+					size_t index = reinterpret_cast<char*>(resource) - storage.data();
+					TestAssert(resident[index]);
+					TestAssert(std::find(used.begin(), used.end(), resource) == used.end());
+					for (auto& frameResources : inFlight) {
+						TestAssert(std::find(frameResources.begin(), frameResources.end(), resource) == frameResources.end());
+					}
+					resident[index] = false;
+				}
+				for (IPageable* resource : used) {
+					TestAssert(tracker.IsResident(resource));
+				}
+
+				inFlight.push_back(used);
+				if (inFlight.size() > 1) {
+					tracker.Unlock(inFlight.front());
+					inFlight.erase(inFlight.begin());
+				}
+
+				TestAssert(tracker.GetStatistics().residentBytes <= budget);
+			}
+
+			auto statistics = tracker.GetStatistics();
+			TestAssert(statistics.evictionCount > 0);
+			TestAssert(statistics.makeResidentCount == pageIns);
+			cout << "Simulated 200 frames, " << statistics.evictionCount << " evictions, " << pageIns << " resources paged back in." << endl;
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Residency tracker works." << endl;
+	return 0;
+}
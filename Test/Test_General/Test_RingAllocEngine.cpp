@@ -117,6 +117,19 @@ public:
 			
 			allocator.Reset();
 
+			// Wrapped allocation must not jump over a live range
+			{
+				exc::RingAllocationEngine wrapAllocator(10);
+				size_t first = wrapAllocator.Allocate(5);
+				wrapAllocator.Allocate(3);
+				wrapAllocator.Deallocate(first);
+				try {
+					wrapAllocator.Allocate(9);
+					throw std::runtime_error("New allocation has overriden an existing allocation");
+				}
+				catch (const std::bad_alloc&) {}
+			}
+
 			// Random sized allocations 
 			{
 				// Repeat it 10 times to maximize safety
@@ -0,0 +1,123 @@
+#include "Test.hpp"
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "GraphicsEngine_LL/ShaderCache.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+static ShaderCache::Key MakeKey(const std::string& source, const std::string& macros) {
+	return ShaderCache::KeyBuilder().Add(source).Add(macros).Finish();
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestShaderCache : public AutoRegisterTest<TestShaderCache> {
+public:
+	TestShaderCache() {}
+
+	static std::string Name() {
+		return "Shader Cache";
+	}
+	int Run() override;
+};
+
+
+
+int TestShaderCache::Run() {
+	const std::string packPath = "ShaderCacheTest.pack";
+	std::remove(packPath.c_str());
+
+	try {
+		// Keys differ when the data is split differently.
+		TestAssert(MakeKey("ab", "c") == MakeKey("ab", "c"));
+		TestAssert(!(MakeKey("ab", "c") == MakeKey("a", "bc")));
+		TestAssert(!(MakeKey("float4 main()", "") == MakeKey("float4 main() ", "")));
+
+		std::vector<uint8_t> binaryA = { 1, 2, 3, 4, 5 };
+		std::vector<uint8_t> binaryB(1000, 7);
+		ShaderCache::Key keyA = MakeKey("shader A", "");
+		ShaderCache::Key keyB = MakeKey("shader B", "FOO=1");
+		std::vector<uint8_t> found;
+
+		// Binaries stored in one run are found in the next one.
+		{
+			ShaderCache cache(packPath, "compiler 1");
+			TestAssert(!cache.Find(keyA, found));
+			cache.Store(keyA, binaryA);
+			cache.Store(keyB, binaryB);
+			TestAssert(cache.Find(keyA, found) && found == binaryA);
+		}
+		{
+			ShaderCache cache(packPath, "compiler 1");
+			TestAssert(cache.GetStatistics().packedEntries == 2);
+			TestAssert(cache.Find(keyA, found) && found == binaryA);
+			TestAssert(cache.Find(keyB, found) && found == binaryB);
+			TestAssert(!cache.Find(MakeKey("shader A", "FOO=1"), found));
+			TestAssert(cache.GetStatistics().hits == 2 && cache.GetStatistics().misses == 1);
+		}
+
+		// Entries that are not used for many runs are dropped, used ones are kept.
+		for (uint32_t run = 0; run <= ShaderCache::MaxUnusedGenerations; ++run) {
+			ShaderCache cache(packPath, "compiler 1");
+			TestAssert(cache.Find(keyA, found));
+		}
+		{
+			ShaderCache cache(packPath, "compiler 1");
+			TestAssert(cache.Find(keyA, found) && found == binaryA);
+			TestAssert(!cache.Find(keyB, found));
+		}
+
+		// A new compiler invalidates everything.
+		{
+			ShaderCache cache(packPath, "compiler 2");
+			TestAssert(cache.GetStatistics().packedEntries == 0);
+			TestAssert(!cache.Find(keyA, found));
+		}
+
+		// A corrupt file is ignored, and replaced on the next flush.
+		{
+			std::ofstream file(packPath, std::ios::binary | std::ios::trunc);
+			file << "definitely not a shader pack, but long enough to contain a header";
+		}
+		{
+			ShaderCache cache(packPath, "compiler 1");
+			TestAssert(cache.GetStatistics().packedEntries == 0);
+			cache.Store(keyB, binaryB);
+			TestAssert(cache.Flush());
+			TestAssert(cache.GetStatistics().packedEntries == 1);
+			TestAssert(cache.Find(keyB, found) && found == binaryB);
+		}
+	}
+	catch (std::exception& ex) {
+		std::remove(packPath.c_str());
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	std::remove(packPath.c_str());
+	cout << "Shader cache works." << endl;
+	return 0;
+}
@@ -0,0 +1,240 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "GraphicsEngine_LL/ShadowCascades.hpp"
+#include "GraphicsEngine_LL/Camera.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+static bool IsNear(float a, float b, float tolerance = 1e-3f) {
+	return std::abs(a - b) <= tolerance * std::max(1.0f, std::abs(b));
+}
+
+
+static bool IsOnTexel(float coordinate, float texelSize) {
+	float texels = coordinate / texelSize;
+	return std::abs(texels - std::round(texels)) < 1e-2f;
+}
+
+
+static float GetTexelSize(const ShadowCascadeFitter::Cascade& cascade) {
+	// The projection maps two units of clip space onto the whole map.
+	return 2.0f / cascade.projection(0, 0) / 1024.0f;
+}
+
+
+static ShadowCascadeFitter::Caster MakeBox(mathfu::Vector3f center, float halfSize) {
+	mathfu::Vector3f extent(halfSize, halfSize, halfSize);
+	return { -extent, extent, mathfu::Matrix4x4f::FromTranslationVector(center) };
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestShadowCascades : public AutoRegisterTest<TestShadowCascades> {
+public:
+	TestShadowCascades() {}
+
+	static std::string Name() {
+		return "Shadow Cascades";
+	}
+	int Run() override;
+};
+
+
+
+int TestShadowCascades::Run() {
+	Camera camera;
+	camera.SetPosition({ 0, 0, 0 });
+	camera.SetLookDirection({ 0, 0, -1 });
+	camera.SetUpVector({ 0, 1, 0 });
+	camera.SetFOVAxis(1.6f, 0.9f);
+	camera.SetNearPlane(0.1f);
+	camera.SetFarPlane(100.0f);
+
+	const mathfu::Vector3f sunDown(0, -1, 0);
+	const mathfu::Vector3f sunSlanted = mathfu::Vector3f(0.3f, -1.0f, 0.4f).Normalized();
+
+	try {
+		// Splits blend from uniform to logarithmic, and always start at near and end at far.
+		{
+			std::vector<float> uniform = ShadowCascadeFitter::CalculateSplits(1.0f, 101.0f, 4, 0.0f);
+			TestAssert(uniform.size() == 5);
+			TestAssert(IsNear(uniform[1], 26.0f) && IsNear(uniform[2], 51.0f) && IsNear(uniform[3], 76.0f));
+
+			std::vector<float> logarithmic = ShadowCascadeFitter::CalculateSplits(1.0f, 1000.0f, 3, 1.0f);
+			TestAssert(IsNear(logarithmic[1], 10.0f) && IsNear(logarithmic[2], 100.0f));
+			TestAssert(logarithmic.front() == 1.0f && logarithmic.back() == 1000.0f);
+
+			std::vector<float> practical = ShadowCascadeFitter::CalculateSplits(0.1f, 100.0f, 5, 0.75f);
+			for (size_t i = 1; i < practical.size(); ++i) {
+				TestAssert(practical[i] > practical[i - 1]);
+			}
+
+			bool thrown = false;
+			try { ShadowCascadeFitter::CalculateSplits(10.0f, 1.0f, 4, 0.5f); }
+			catch (std::invalid_argument&) { thrown = true; }
+			TestAssert(thrown);
+		}
+
+		// Each cascade's projection contains its whole slice of the frustum.
+		{
+			ShadowCascadeFitter fitter(4, 1024);
+			fitter.Fit(camera, sunSlanted);
+			TestAssert(fitter.GetCascades().size() == 4);
+			TestAssert(fitter.GetCascades().front().nearDistance == camera.GetNearPlane());
+			TestAssert(fitter.GetCascades().back().farDistance == camera.GetFarPlane());
+
+			mathfu::Matrix4x4f projection = camera.GetPerspectiveMatrixRH();
+			mathfu::Matrix4x4f inverseViewProjection = (projection * camera.GetViewMatrixRH()).Inverse();
+			for (const auto& cascade : fitter.GetCascades()) {
+				for (float distance : { cascade.nearDistance, cascade.farDistance }) {
+					mathfu::Vector4f clip = projection * mathfu::Vector4f(0, 0, -distance, 1);
+					for (int i = 0; i < 4; ++i) {
+						mathfu::Vector4f corner = inverseViewProjection * mathfu::Vector4f(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, clip.z() / clip.w(), 1.0f);
+						mathfu::Vector4f shadow = cascade.viewProjection * mathfu::Vector4f(corner.xyz() / corner.w(), 1.0f);
+						TestAssert(std::abs(shadow.x()) <= 1.0f && std::abs(shadow.y()) <= 1.0f);
+						TestAssert(shadow.z() >= -1e-4f && shadow.z() <= 1.0f + 1e-4f);
+					}
+				}
+			}
+		}
+
+
+		// Moving the camera moves the cascades by whole texels, turning it leaves their size alone.
+		{
+			ShadowCascadeFitter fitter(4, 1024);
+			fitter.Fit(camera, sunSlanted);
+			auto reference = fitter.GetCascades();
+
+			Camera moved = camera;
+			for (int step = 1; step <= 10; ++step) {
+				moved.SetPosition({ 0.013f * step, 0.002f * step, -0.031f * step });
+				moved.SetLookDirection(mathfu::Vector3f(0.05f * step, 0.0f, -1.0f).Normalized());
+				fitter.Fit(moved, sunSlanted);
+				for (size_t i = 0; i < reference.size(); ++i) {
+					const auto& cascade = fitter.GetCascades()[i];
+					TestAssert(cascade.radius == reference[i].radius);
+					float texelSize = GetTexelSize(cascade);
+					TestAssert(IsNear(texelSize, GetTexelSize(reference[i]), 1e-5f));
+					TestAssert(IsOnTexel(cascade.center.x() - reference[i].center.x(), texelSize));
+					TestAssert(IsOnTexel(cascade.center.y() - reference[i].center.y(), texelSize));
+				}
+			}
+		}
+
+		// Each cascade keeps the casters over it and toward the light, and its depth range follows them.
+		{
+			ShadowCascadeFitter fitter(4, 1024);
+			fitter.Fit(camera, sunDown);
+			const auto& first = fitter.GetCascades()[0];
+
+			// The light looks straight down: light space x is world x, y is world -z and z is world y.
+			mathfu::Vector3f over(first.center.x(), 0.0f, -first.center.y());
+			std::vector<ShadowCascadeFitter::Caster> casters = {
+				MakeBox(over, 0.1f),
+				MakeBox(over + mathfu::Vector3f(0, 50, 0), 0.1f),
+				MakeBox(over + mathfu::Vector3f(0, -500, 0), 0.1f),
+				MakeBox(over + mathfu::Vector3f(500, 0, 0), 0.1f),
+			};
+			fitter.Cull(casters);
+
+			const auto& cascades = fitter.GetCascades();
+			TestAssert(cascades[0].casters == std::vector<uint32_t>({ 0, 1 }));
+			TestAssert(IsNear(cascades[0].nearZ, 50.1f));
+			TestAssert(IsNear(cascades[0].farZ, cascades[0].center.z() - cascades[0].radius));
+			for (const auto& cascade : cascades) {
+				for (uint32_t index : cascade.casters) {
+					TestAssert(index < 2);
+				}
+			}
+
+			// Without casters, the depth range is the bounding sphere's.
+			fitter.Cull({});
+			TestAssert(fitter.GetCascades()[0].casters.empty());
+			TestAssert(IsNear(fitter.GetCascades()[0].nearZ, first.center.z() + first.radius));
+
+			// Receivers pull the far depth to the lowest of them, but leave the slices and their texels alone.
+			auto sphere = fitter.GetCascades();
+			std::vector<ShadowCascadeFitter::Receiver> receivers = {
+				MakeBox(over + mathfu::Vector3f(0, -2, 0), 0.1f),
+				MakeBox(over + mathfu::Vector3f(500, -3, 0), 0.1f),
+			};
+			fitter.Cull(casters, receivers);
+			TestAssert(IsNear(fitter.GetCascades()[0].farZ, -2.1f));
+			TestAssert(fitter.GetCascades()[0].casters == std::vector<uint32_t>({ 0, 1 }));
+			for (size_t i = 0; i < sphere.size(); ++i) {
+				TestAssert(fitter.GetCascades()[i].radius == sphere[i].radius);
+				TestAssert(fitter.GetCascades()[i].center == sphere[i].center);
+				TestAssert(fitter.GetCascades()[i].nearDistance == sphere[i].nearDistance);
+			}
+
+			// A receiver above a caster hides it from the cascade.
+			fitter.Cull(casters, { MakeBox(over + mathfu::Vector3f(0, 1, 0), 0.1f) });
+			TestAssert(fitter.GetCascades()[0].casters == std::vector<uint32_t>({ 1 }));
+		}
+
+		// Many casters are culled on multiple threads, each cascade still gets the boxes over it.
+		{
+			ShadowCascadeFitter fitter(4, 1024);
+			fitter.Fit(camera, sunSlanted);
+
+			std::vector<ShadowCascadeFitter::Caster> casters;
+			for (int z = 0; z < 40; ++z) {
+				for (int x = 0; x < 50; ++x) {
+					casters.push_back(MakeBox({ -100.0f + 4.0f * x, 0.0f, 10.0f - 3.0f * z }, 0.5f));
+				}
+			}
+			fitter.Cull(casters);
+			auto multi = fitter.GetCascades();
+
+			for (size_t i = 0; i < multi.size(); ++i) {
+				float halfSize = 1.0f / multi[i].projection(0, 0);
+				for (size_t j = 0; j < casters.size(); ++j) {
+					mathfu::Vector3f center = (fitter.GetLightView() * casters[j].world * mathfu::Vector4f(0, 0, 0, 1)).xyz();
+					// Boxes are small against the cascades, so testing their centers with a margin gives the same answer unless they straddle an edge.
+					bool inside = std::abs(center.x() - multi[i].center.x()) < halfSize - 1.0f
+						&& std::abs(center.y() - multi[i].center.y()) < halfSize - 1.0f
+						&& center.z() > multi[i].farZ + 1.0f;
+					bool outside = std::abs(center.x() - multi[i].center.x()) > halfSize + 1.0f
+						|| std::abs(center.y() - multi[i].center.y()) > halfSize + 1.0f
+						|| center.z() < multi[i].farZ - 1.0f;
+					bool found = std::find(multi[i].casters.begin(), multi[i].casters.end(), uint32_t(j)) != multi[i].casters.end();
+					TestAssert(!inside || found);
+					TestAssert(!outside || !found);
+				}
+				TestAssert(std::is_sorted(multi[i].casters.begin(), multi[i].casters.end()));
+			}
+			TestAssert(!multi[0].casters.empty());
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Shadow cascades work." << endl;
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "GraphicsEngine_LL/StagingRingAllocator.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestStagingRingAllocator : public AutoRegisterTest<TestStagingRingAllocator> {
+public:
+	TestStagingRingAllocator() {}
+
+	static std::string Name() {
+		return "Staging Ring Allocator";
+	}
+	int Run() override;
+};
+
+
+
+int TestStagingRingAllocator::Run() {
+	try {
+		constexpr size_t alignment = 512;
+		constexpr size_t ringSize = 16 * alignment;
+
+		// Alignment and basic bookkeeping.
+		{
+			StagingRingAllocator ring(ringSize, alignment);
+			TestAssert(ring.GetSize() == ringSize);
+
+			size_t offset1, offset2;
+			TestAssert(ring.TryAllocate(1, offset1));
+			TestAssert(ring.TryAllocate(alignment + 1, offset2));
+			TestAssert(offset1 % alignment == 0);
+			TestAssert(offset2 % alignment == 0);
+			TestAssert(offset2 == offset1 + alignment);
+			TestAssert(ring.GetUsedSize() == 3 * alignment);
+
+			// Nothing is retired, so nothing can be released.
+			TestAssert(!ring.HasRetiredAllocations());
+			TestAssert(ring.ReleaseFrames(100) == 0);
+			TestAssert(ring.GetUsedSize() == 3 * alignment);
+		}
+
+		// Space is recycled only when the frame that uses it has finished.
+		{
+			StagingRingAllocator ring(ringSize, alignment);
+			size_t offset0, offset1, offset2;
+
+			TestAssert(ring.TryAllocate(8 * alignment, offset0));
+			ring.Retire(offset0, 0);
+			TestAssert(ring.TryAllocate(6 * alignment, offset1));
+			ring.Retire(offset1, 1);
+			TestAssert(ring.HasRetiredAllocations());
+
+			// Ring is full for this size until frame 0 completes.
+			TestAssert(!ring.TryAllocate(4 * alignment, offset2));
+			TestAssert(ring.ReleaseFrames(0) == 8 * alignment);
+			TestAssert(ring.TryAllocate(4 * alignment, offset2));
+			TestAssert(offset2 == 0); // wrapped around
+
+			// The wrapped allocation must not overlap frame 1, which is still in flight.
+			size_t offset;
+			TestAssert(!ring.TryAllocate(6 * alignment, offset));
+
+			TestAssert(ring.ReleaseFrames(1) == 6 * alignment);
+			ring.Retire(offset2, 2);
+			TestAssert(ring.ReleaseFrames(2) == 4 * alignment);
+			TestAssert(ring.GetUsedSize() == 0);
+			TestAssert(!ring.HasRetiredAllocations());
+			TestAssert(ring.TryAllocate(ringSize, offset));
+
+			bool thrown = false;
+			try {
+				ring.Retire(alignment, 3);
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+
+		// Simulate a few hundred frames with a varying upload load, checking that
+		// live ranges never overlap. Some of the uploads are deferred to the next frame,
+		// so they are retired out of order.
+		{
+			StagingRingAllocator ring(ringSize, alignment);
+			constexpr uint64_t framesInFlight = 2;
+			struct Range { size_t offset, size; uint64_t frame; };
+			std::vector<Range> live;
+			std::vector<Range> deferred;
+			size_t stalls = 0;
+
+			for (uint64_t frame = 0; frame < 300; ++frame) {
+				for (auto& range : deferred) {
+					ring.Retire(range.offset, frame);
+					range.frame = frame;
+					live.push_back(range);
+				}
+				deferred.clear();
+
+				for (int i = 0; i < int(frame % 5); ++i) {
+					size_t size = 100 + (frame * 37 + i * 911) % (3 * alignment);
+					size_t offset;
+					if (!ring.TryAllocate(size, offset)) {
+						++stalls;
+						continue;
+					}
+					TestAssert(offset + size <= ringSize);
+					for (auto* ranges : { &live, &deferred }) {
+						for (auto& range : *ranges) {
+							TestAssert(offset + size <= range.offset || range.offset + range.size <= offset);
+						}
+					}
+					if ((frame + i) % 3 == 0) {
+						deferred.push_back({ offset, size, 0 });
+					}
+					else {
+						ring.Retire(offset, frame);
+						live.push_back({ offset, size, frame });
+					}
+				}
+
+				// The GPU lags behind by a couple of frames.
+				if (frame >= framesInFlight) {
+					uint64_t finished = frame - framesInFlight;
+					ring.ReleaseFrames(finished);
+					live.erase(std::remove_if(live.begin(), live.end(), [finished](const Range& range) { return range.frame <= finished; }), live.end());
+				}
+			}
+			for (auto& range : deferred) {
+				ring.Retire(range.offset, 300);
+			}
+			ring.ReleaseFrames(1000);
+			TestAssert(ring.GetUsedSize() == 0);
+			cout << "Simulated 300 frames, " << stalls << " allocations had to wait." << endl;
+		}
+
+		// Invalid arguments.
+		{
+			bool thrown = false;
+			try {
+				StagingRingAllocator ring(ringSize, 500);
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Staging ring allocator works." << endl;
+	return 0;
+}
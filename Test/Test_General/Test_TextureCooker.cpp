@@ -0,0 +1,202 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include "AssetLibrary/TextureCooker.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::asset;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// Root mean square error of the channels, alpha included if requested.
+static double RmsError(const TextureCooker::MipLevel& a, const TextureCooker::MipLevel& b, int channelCount) {
+	double sum = 0;
+	for (size_t i = 0; i < a.pixels.size(); i += 4) {
+		for (int c = 0; c < channelCount; ++c) {
+			double diff = double(a.pixels[i + c]) - double(b.pixels[i + c]);
+			sum += diff * diff;
+		}
+	}
+	return std::sqrt(sum / (a.pixels.size() / 4 * channelCount));
+}
+
+
+// Smooth gradients with a few sharp edges, like a photo.
+static TextureCooker::MipLevel MakeImage(uint32_t width, uint32_t height) {
+	TextureCooker::MipLevel image{ width, height, std::vector<uint8_t>(size_t(width) * height * 4) };
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint8_t* pixel = image.pixels.data() + (size_t(y) * width + x) * 4;
+			pixel[0] = uint8_t(x * 255 / width);
+			pixel[1] = uint8_t(y * 255 / height);
+			pixel[2] = uint8_t(((x / 16 + y / 16) % 2) * 160 + 40);
+			pixel[3] = uint8_t(255 - (x + y) * 255 / (width + height));
+		}
+	}
+	return image;
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestTextureCooker : public AutoRegisterTest<TestTextureCooker> {
+public:
+	TestTextureCooker() {}
+
+	static std::string Name() {
+		return "Texture Cooker";
+	}
+	int Run() override;
+};
+
+
+
+int TestTextureCooker::Run() {
+	try {
+		// Mip chain sizes, odd sizes round down.
+		auto mips = TextureCooker::GenerateMips(MakeImage(20, 7), eMipFilter::BOX);
+		TestAssert(mips.size() == 5);
+		TestAssert(mips[1].width == 10 && mips[1].height == 3);
+		TestAssert(mips[3].width == 2 && mips[3].height == 1);
+		TestAssert(mips[4].width == 1 && mips[4].height == 1);
+		TestAssert(TextureCooker::GenerateMips(MakeImage(20, 7), eMipFilter::KAISER, 2).size() == 2);
+
+		// Filters keep the average of flat areas.
+		{
+			TextureCooker::MipLevel flat{ 8, 8, std::vector<uint8_t>(8 * 8 * 4, 100) };
+			for (auto filter : { eMipFilter::BOX, eMipFilter::KAISER }) {
+				auto flatMips = TextureCooker::GenerateMips(flat, filter);
+				TestAssert(flatMips.back().pixels == std::vector<uint8_t>(4, 100));
+			}
+		}
+
+		// Encoding roundtrips within the formats' usual error.
+		const auto image = MakeImage(64, 64);
+		const struct {
+			eTextureCompression compression;
+			int channelCount;
+			double maxError;
+		} formats[] = {
+			{ eTextureCompression::BC1, 3, 6.0 },
+			{ eTextureCompression::BC3, 4, 6.0 },
+			{ eTextureCompression::BC5, 2, 2.0 },
+			{ eTextureCompression::BC7, 4, 4.0 },
+		};
+		for (const auto& format : formats) {
+			auto blocks = TextureCooker::Compress(image, format.compression);
+			TestAssert(blocks.size() == TextureCooker::GetRowPitch(format.compression, 64) * 16);
+			auto decoded = TextureCooker::Decompress(blocks.data(), 64, 64, format.compression);
+			double error = RmsError(image, decoded, format.channelCount);
+			cout << "RMS error of format " << (int)format.compression << ": " << error << endl;
+			TestAssert(error < format.maxError);
+		}
+
+		// Solid blocks are exact where the format can represent them.
+		{
+			TextureCooker::MipLevel solid{ 4, 4, std::vector<uint8_t>(16 * 4) };
+			for (size_t i = 0; i < solid.pixels.size(); i += 4) {
+				solid.pixels[i] = 10; solid.pixels[i + 1] = 200; solid.pixels[i + 2] = 77; solid.pixels[i + 3] = 255;
+			}
+			auto decoded = TextureCooker::Decompress(TextureCooker::Compress(solid, eTextureCompression::BC7).data(), 4, 4, eTextureCompression::BC7);
+			TestAssert(RmsError(solid, decoded, 4) < 1.0);
+		}
+
+		// Container roundtrip.
+		{
+			std::vector<uint8_t> pixels(size_t(32) * 16 * 3 + 16 * 5);
+			for (size_t i = 0; i < pixels.size(); ++i) {
+				pixels[i] = uint8_t(i * 13);
+			}
+			TextureCooker::Options options;
+			options.compression = eTextureCompression::BC3;
+			options.filter = eMipFilter::KAISER;
+			options.sourceStamp = 0x1234;
+			auto cooked = TextureCooker::Cook(pixels.data(), 32, 16, 3, 32 * 3 + 5, options);
+
+			CookedTexture texture = CookedTexture::Parse(cooked.data(), cooked.size());
+			TestAssert(texture.GetSourceStamp() == 0x1234);
+			TestAssert(texture.GetCompression() == eTextureCompression::BC3);
+			TestAssert(texture.GetWidth() == 32 && texture.GetHeight() == 16);
+			TestAssert(texture.GetMipCount() == 6);
+			TestAssert(texture.GetMip(5).width == 1 && texture.GetMip(5).size == 16);
+			TestAssert(texture.GetMip(2).rowPitch == 2 * 16 && texture.GetMip(2).size == 2 * 16);
+			for (int level = 0; level < texture.GetMipCount(); ++level) {
+				TestAssert(texture.GetMip(level).offset % 16 == 0);
+			}
+
+			bool thrown = false;
+			try {
+				cooked.resize(cooked.size() - 1);
+				CookedTexture::Parse(cooked.data(), cooked.size());
+			}
+			catch (std::runtime_error&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+
+			thrown = false;
+			try {
+				TextureCooker::Cook(pixels.data(), 30, 16, 3, 0, options);
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+
+
+		// Benchmark: cooked size and time compared to the single uncompressed level that was uploaded before.
+		const uint32_t size = 2048;
+		const auto large = MakeImage(size, size);
+		TextureCooker::Options options;
+		options.compression = eTextureCompression::BC1;
+
+		using Clock = std::chrono::high_resolution_clock;
+		auto startTime = Clock::now();
+		auto cooked = TextureCooker::Cook(large.pixels.data(), size, size, 4, 0, options);
+		auto cookTime = Clock::now() - startTime;
+
+		startTime = Clock::now();
+		CookedTexture texture = CookedTexture::Parse(cooked.data(), cooked.size());
+		size_t loadedBytes = 0;
+		for (int level = 0; level < texture.GetMipCount(); ++level) {
+			loadedBytes += texture.GetMip(level).size;
+		}
+		auto parseTime = Clock::now() - startTime;
+		TestAssert(loadedBytes * 5 < large.pixels.size()); // 8:1, the mips add a third.
+
+		auto Milliseconds = [](Clock::duration duration) {
+			return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+		};
+		cout << size << "x" << size << " BC1 with " << texture.GetMipCount() << " mips: "
+			<< loadedBytes / 1024 << " KiB instead of " << large.pixels.size() / 1024 << " KiB, "
+			<< "cooked in " << Milliseconds(cookTime) << " ms, parsed in " << Milliseconds(parseTime) << " ms." << endl;
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Texture cooker works." << endl;
+	return 0;
+}
@@ -0,0 +1,139 @@
+#include "Test.hpp"
+
+#include <BaseLibrary/Memory/TlsfAllocationEngine.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+static void ExpectAllocationFail(exc::TlsfAllocationEngine& allocator, size_t size) {
+	try {
+		allocator.Allocate(size);
+		throw std::runtime_error("Expected allocation error!");
+	}
+	catch (std::bad_alloc&) {} // OK!
+}
+
+
+class Test_TlsfAllocationEngine : public AutoRegisterTest<Test_TlsfAllocationEngine> {
+public:
+	Test_TlsfAllocationEngine() {}
+
+	static std::string Name() {
+		return "TLSF Allocation Engine";
+	}
+	int Run() override;
+};
+
+
+int Test_TlsfAllocationEngine::Run() {
+	try {
+		// Splitting and merging.
+		{
+			exc::TlsfAllocationEngine allocator(100);
+			size_t a = allocator.Allocate(30);
+			size_t b = allocator.Allocate(30);
+			size_t c = allocator.Allocate(40);
+			TestAssert(a == 0 && b == 30 && c == 60);
+			TestAssert(allocator.GetFreeSize() == 0);
+			ExpectAllocationFail(allocator, 1);
+
+			// Freeing the middle leaves a hole that does not fit a larger request.
+			allocator.Deallocate(b);
+			TestAssert(allocator.GetLargestFreeBlock() == 30);
+			ExpectAllocationFail(allocator, 31);
+
+			// Neighbours merge back into a single block.
+			allocator.Deallocate(a);
+			allocator.Deallocate(c);
+			TestAssert(allocator.GetFreeBlockCount() == 1);
+			TestAssert(allocator.GetLargestFreeBlock() == 100);
+			TestAssert(allocator.Allocate(100) == 0);
+
+			bool thrown = false;
+			try {
+				allocator.Deallocate(5);
+			}
+			catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			TestAssert(thrown);
+		}
+
+		// Random allocations never overlap and everything is recovered at the end.
+		{
+			constexpr size_t poolSize = 1 << 16;
+			exc::TlsfAllocationEngine allocator(poolSize);
+			std::vector<uint8_t> occupied(poolSize, 0);
+			std::vector<std::pair<size_t, size_t>> live;
+			std::mt19937 rne(1234);
+			size_t failures = 0;
+
+			for (int iteration = 0; iteration < 20000; ++iteration) {
+				if (live.empty() || rne() % 3 != 0) {
+					size_t size = rne() % 700 + 1;
+					try {
+						size_t index = allocator.Allocate(size);
+						TestAssert(index + size <= poolSize);
+						for (size_t i = index; i < index + size; ++i) {
+							TestAssert(occupied[i] == 0);
+							occupied[i] = 1;
+						}
+						live.push_back({ index, size });
+					}
+					catch (std::bad_alloc&) {
+						++failures;
+					}
+				}
+				else {
+					size_t pick = rne() % live.size();
+					auto allocation = live[pick];
+					live[pick] = live.back();
+					live.pop_back();
+					allocator.Deallocate(allocation.first);
+					std::fill(occupied.begin() + allocation.first, occupied.begin() + allocation.first + allocation.second, uint8_t(0));
+				}
+
+				TestAssert(allocator.GetAllocationCount() == live.size());
+			}
+
+			size_t usedSize = 0;
+			for (auto& allocation : live) {
+				usedSize += allocation.second;
+			}
+			TestAssert(allocator.GetFreeSize() == poolSize - usedSize);
+
+			for (auto& allocation : live) {
+				allocator.Deallocate(allocation.first);
+			}
+			TestAssert(allocator.GetFreeSize() == poolSize);
+			TestAssert(allocator.GetFreeBlockCount() == 1);
+			cout << "Random allocations OK, " << failures << " requests did not fit." << endl;
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "TLSF allocation engine works." << endl;
+	return 0;
+}
@@ -0,0 +1,179 @@
+#include "Test.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "GraphicsEngine_LL/TransientHeapLayout.hpp"
+
+using namespace std::string_literals;
+
+using std::cout;
+using std::endl;
+
+using namespace inl::gxeng;
+
+
+static void TestAssertFunc(bool val, const char* expression) {
+	if (!val) {
+		throw std::runtime_error("Assertion failed while evaluating the following expression:\n"s + expression);
+	}
+}
+
+#define TestAssert(x) TestAssertFunc(x, #x)
+
+
+// Pass order of a chain of passes, each depending on the previous.
+static std::vector<std::vector<bool>> ChainOrder(unsigned count) {
+	std::vector<std::vector<bool>> order(count, std::vector<bool>(count, false));
+	for (unsigned before = 0; before < count; ++before) {
+		for (unsigned after = before + 1; after < count; ++after) {
+			order[before][after] = true;
+		}
+	}
+	return order;
+}
+
+
+//------------------------------------------------------------------------------
+// Test class
+//------------------------------------------------------------------------------
+
+
+class TestTransientHeapLayout : public AutoRegisterTest<TestTransientHeapLayout> {
+public:
+	TestTransientHeapLayout() {}
+
+	static std::string Name() {
+		return "Transient Heap Layout";
+	}
+	int Run() override;
+};
+
+
+
+int TestTransientHeapLayout::Run() {
+	constexpr uint64_t KiB = 1024;
+	constexpr uint64_t MiB = 1024 * KiB;
+
+	try {
+		// Users follow the dependencies.
+		{
+			TransientHeapLayout layout;
+			layout.SetPassOrder(ChainOrder(4));
+			TestAssert(layout.GetUsers(1, eTransientScope::NODE) == std::vector<unsigned>({ 1 }));
+			TestAssert(layout.GetUsers(1, eTransientScope::DOWNSTREAM) == std::vector<unsigned>({ 1, 2, 3 }));
+			TestAssert(!layout.IsConflicting({ 0 }, { 1, 2 }));
+			TestAssert(layout.IsConflicting({ 0, 1 }, { 1 }));
+			TestAssert(layout.IsConflicting({ 2 }, { 2 }));
+			TestAssert(layout.IsConflicting({ 0 }, { 7 })); // Unknown passes conflict.
+		}
+
+		// Only the passes reading the outputs use a downstream resource, not everything after it.
+		{
+			TransientHeapLayout layout;
+			layout.SetPassOrder(ChainOrder(4), { { 1 }, { 2, 3 }, { 3 }, {} });
+			TestAssert(layout.GetUsers(0, eTransientScope::DOWNSTREAM) == std::vector<unsigned>({ 0, 1 }));
+			TestAssert(layout.GetUsers(1, eTransientScope::DOWNSTREAM) == std::vector<unsigned>({ 1, 2, 3 }));
+			uint64_t newPageSize;
+
+			auto a = layout.Allocate(16 * MiB, 64 * KiB, layout.GetUsers(0, eTransientScope::DOWNSTREAM), newPageSize);
+			auto b = layout.Allocate(16 * MiB, 64 * KiB, layout.GetUsers(2, eTransientScope::DOWNSTREAM), newPageSize);
+			TestAssert(a.page == b.page && a.offset == b.offset);
+			auto c = layout.Allocate(16 * MiB, 64 * KiB, layout.GetUsers(1, eTransientScope::DOWNSTREAM), newPageSize);
+			TestAssert(c.offset != a.offset);
+		}
+
+		// Resources used one after the other share memory, overlapping ones don't.
+		{
+			TransientHeapLayout layout;
+			layout.SetPassOrder(ChainOrder(4));
+			uint64_t newPageSize;
+
+			auto a = layout.Allocate(16 * MiB, 64 * KiB, layout.GetUsers(0, eTransientScope::NODE), newPageSize);
+			TestAssert(newPageSize == 64 * MiB);
+			auto b = layout.Allocate(16 * MiB, 64 * KiB, layout.GetUsers(1, eTransientScope::DOWNSTREAM), newPageSize);
+			TestAssert(newPageSize == 0);
+			TestAssert(a.page == b.page && a.offset == b.offset);
+
+			auto c = layout.Allocate(8 * MiB, 64 * KiB, layout.GetUsers(2, eTransientScope::NODE), newPageSize);
+			TestAssert(c.page == a.page && c.offset == 16 * MiB);
+
+			auto statistics = layout.GetStatistics();
+			TestAssert(statistics.reservedBytes == 64 * MiB);
+			TestAssert(statistics.allocatedBytes == 40 * MiB);
+			TestAssert(statistics.allocationCount == 3);
+
+			// A gap left by a released resource is reused.
+			layout.Deallocate(c);
+			auto d = layout.Allocate(4 * MiB, 64 * KiB, layout.GetUsers(3, eTransientScope::NODE), newPageSize);
+			TestAssert(d.offset == 16 * MiB);
+			TestAssert(layout.GetStatistics().peakAllocatedBytes == 40 * MiB);
+		}
+
+		// Passes that don't depend on each other may run in any order, so they can't share.
+		{
+			TransientHeapLayout layout;
+			std::vector<std::vector<bool>> order = {
+				{ false, true, true },
+				{ false, false, false },
+				{ false, false, false },
+			};
+			layout.SetPassOrder(order);
+			uint64_t newPageSize;
+
+			auto a = layout.Allocate(1 * MiB, 64 * KiB, layout.GetUsers(1, eTransientScope::NODE), newPageSize);
+			auto b = layout.Allocate(1 * MiB, 64 * KiB, layout.GetUsers(2, eTransientScope::NODE), newPageSize);
+			TestAssert(a.page == b.page && a.offset != b.offset);
+			auto c = layout.Allocate(1 * MiB, 64 * KiB, layout.GetUsers(0, eTransientScope::NODE), newPageSize);
+			TestAssert(c.offset == a.offset);
+		}
+
+		// Alignment is respected, large resources get their own page.
+		{
+			TransientHeapLayout layout;
+			layout.SetPassOrder(ChainOrder(2));
+			uint64_t newPageSize;
+
+			auto a = layout.Allocate(100 * KiB, 64 * KiB, { 0 }, newPageSize);
+			auto b = layout.Allocate(1 * MiB, 4 * MiB, { 0 }, newPageSize);
+			TestAssert(b.offset == 4 * MiB);
+			TestAssert(a.offset == 0);
+
+			auto c = layout.Allocate(100 * MiB, 64 * KiB, { 1 }, newPageSize);
+			TestAssert(newPageSize == 100 * MiB && c.page != a.page);
+			layout.Deallocate(c);
+			TestAssert(layout.ReleaseEmptyPages() == std::vector<uint32_t>({ c.page }));
+			TestAssert(layout.GetStatistics().reservedBytes == 64 * MiB);
+			TestAssert(layout.GetStatistics().peakReservedBytes == 164 * MiB);
+		}
+
+		// Errors.
+		{
+			TransientHeapLayout layout;
+			uint64_t newPageSize;
+			bool thrown = false;
+			try { layout.Allocate(0, 64 * KiB, { 0 }, newPageSize); }
+			catch (std::invalid_argument&) { thrown = true; }
+			TestAssert(thrown);
+
+			auto a = layout.Allocate(1 * MiB, 64 * KiB, { 0 }, newPageSize);
+			thrown = false;
+			try { layout.SetPassOrder(ChainOrder(2)); }
+			catch (std::logic_error&) { thrown = true; }
+			TestAssert(thrown);
+
+			layout.Deallocate(a);
+			thrown = false;
+			try { layout.Deallocate(a); }
+			catch (std::invalid_argument&) { thrown = true; }
+			TestAssert(thrown);
+		}
+	}
+	catch (std::exception& ex) {
+		cout << "Test failed: " << ex.what() << endl;
+		return 1;
+	}
+
+	cout << "Transient heap layout works." << endl;
+	return 0;
+}